@@ -0,0 +1,44 @@
+#ifndef LATENCY_RECORDER_H_
+#define LATENCY_RECORDER_H_
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+
+#include "Metrics.h"
+
+/**
+ * @brief Thread-safe latency histogram for one benchmark run.
+ *
+ * Uses the same log-linear buckets as the process metrics (see
+ * HistogramBucketFor), so percentiles are accurate to within 12.5%.
+ */
+class LatencyRecorder {
+public:
+  /**
+   * @brief Constructs an empty recorder.
+   */
+  LatencyRecorder();
+
+  LatencyRecorder(const LatencyRecorder &) = delete;
+  LatencyRecorder &operator=(const LatencyRecorder &) = delete;
+
+  /**
+   * @brief Records one latency sample. Safe to call from any thread.
+   * @param nanoseconds The sample.
+   */
+  void Record(uint64_t nanoseconds);
+
+  /**
+   * @brief Copies the samples recorded so far.
+   * @return The histogram.
+   */
+  HistogramSnapshot Snapshot() const;
+
+private:
+  std::atomic<uint64_t> count_;
+  std::atomic<uint64_t> sum_;
+  std::unique_ptr<std::atomic<uint64_t>[]> buckets_; /**< kHistogramBucketCount counters. */
+};
+
+#endif // LATENCY_RECORDER_H_
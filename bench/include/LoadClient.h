@@ -0,0 +1,187 @@
+#ifndef LOAD_CLIENT_H_
+#define LOAD_CLIENT_H_
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "BufferPool.h"
+#include "EventLoop.h"
+#include "IEventHandler.h"
+#include "ISocket.h"
+#include "LatencyRecorder.h"
+#include "MessageFramer.h"
+#include "MessageView.h"
+
+// Every measured payload ends with the sender's steady clock reading in
+// nanoseconds, 8 bytes little-endian
+const size_t kLoadTimestampSize = 8;
+
+/**
+ * @brief Writes a send timestamp into the last bytes of a payload.
+ *
+ * @param nanoseconds The timestamp, see Metrics::NowNanoseconds.
+ * @param out Destination with room for kLoadTimestampSize bytes.
+ */
+void EncodeLoadTimestamp(uint64_t nanoseconds, char *out);
+
+/**
+ * @brief Reads a send timestamp written by EncodeLoadTimestamp.
+ *
+ * @param in The kLoadTimestampSize timestamp bytes.
+ * @return The timestamp.
+ */
+uint64_t DecodeLoadTimestamp(const char *in);
+
+/**
+ * @brief One synthetic chat client driven by an EventLoop.
+ *
+ * The client completes the ID handshake in the compact wire format, then
+ * queues whatever the load generator hands it and counts the timestamped
+ * messages it receives (broadcasts, private and room messages and file chunks),
+ * recording their end-to-end latency. Thousands of them share a few loop
+ * threads.
+ */
+class LoadClient : public IEventHandler {
+public:
+  /**
+   * @brief Constructs a client over a connected socket.
+   *
+   * @param socket The socket connected to the server.
+   * @param event_loop The loop driving the connection.
+   * @param latency Receives the latency of every timestamped message.
+   */
+  LoadClient(std::unique_ptr<ISocket> socket, EventLoop *event_loop, LatencyRecorder *latency);
+
+  /**
+   * @brief Destroys the client, closing the connection.
+   */
+  ~LoadClient() override;
+
+  LoadClient(const LoadClient &) = delete;
+  LoadClient &operator=(const LoadClient &) = delete;
+
+  /**
+   * @brief Switches the socket to non-blocking mode and registers it with the loop.
+   *
+   * @return False if the socket could not be made non-blocking.
+   */
+  bool Start();
+
+  /**
+   * @brief Unregisters the connection and closes it.
+   */
+  void Stop();
+
+  /**
+   * @brief Queues a message for the server. Safe to call from any thread.
+   *
+   * @param message The message; serialized before the call returns.
+   * @return False if the connection is closed.
+   */
+  bool Send(const MessageView &message);
+
+  /**
+   * @brief Asks the server to add the client to a room.
+   * @param room_name The room name.
+   * @return False if the connection is closed.
+   */
+  bool JoinRoom(const std::string &room_name);
+
+  /**
+   * @brief Gets the room the server reported as joined.
+   * @return The room ID, or -1 before the join was answered (or if it was refused).
+   */
+  int GetRoomId() const { return room_id_.load(); }
+
+  /**
+   * @brief Checks whether the server answered the last JoinRoom.
+   * @return True once an answer arrived.
+   */
+  bool IsJoinAnswered() const { return join_answered_.load(); }
+
+  /**
+   * @brief Gets the ID the server assigned.
+   * @return The client ID, or -1 before the handshake completed.
+   */
+  int GetClientId() const { return client_id_.load(); }
+
+  /**
+   * @brief Checks whether the connection is still open.
+   * @return True if connected.
+   */
+  bool IsConnected() const { return connected_.load(); }
+
+  /**
+   * @brief Gets the number of bytes waiting to be written.
+   * @return The queued byte count.
+   */
+  size_t GetQueuedBytes() const { return queued_bytes_.load(std::memory_order_relaxed); }
+
+  /**
+   * @brief Gets the number of timestamped messages received.
+   * @return The message count.
+   */
+  uint64_t GetMessagesReceived() const { return messages_received_.load(std::memory_order_relaxed); }
+
+  /**
+   * @brief Gets the payload bytes of the timestamped messages received.
+   * @return The byte count.
+   */
+  uint64_t GetPayloadBytesReceived() const { return payload_bytes_received_.load(std::memory_order_relaxed); }
+
+  /**
+   * @brief Reactor callback: drains the readable socket.
+   */
+  void OnReadable() override;
+
+  /**
+   * @brief Reactor callback: writes queued messages.
+   */
+  void OnWritable() override;
+
+  /**
+   * @brief Reactor callback: the server hung up or the socket errored.
+   */
+  void OnHangup() override;
+
+private:
+  /**
+   * @brief Answers the ID assignment and counts measured messages.
+   * @param message The received message.
+   */
+  void HandleMessage(const MessageView &message);
+
+  /**
+   * @brief Marks the connection closed after an error or hangup (loop thread).
+   */
+  void HandleDisconnect();
+
+  std::unique_ptr<ISocket> socket_;
+  EventLoop *event_loop_;
+  NativeSocketHandle socket_handle_;
+  LatencyRecorder *latency_;
+  MessageFramer framer_;
+
+  std::mutex send_mutex_;               /**< Protects send_queue_ and front_offset_. */
+  std::deque<PooledBuffer> send_queue_; /**< Serialized frames waiting to be written. */
+  size_t front_offset_;                 /**< Bytes of send_queue_.front() already written. */
+  std::vector<IoBuffer> write_batch_;   /**< Scratch list for gathered writes (loop thread). */
+  std::atomic<size_t> queued_bytes_;
+  std::atomic<bool> write_armed_; /**< Writability is being watched. */
+
+  std::atomic<bool> connected_;
+  std::atomic<int> client_id_;
+  std::atomic<int> room_id_;
+  std::atomic<bool> join_answered_;
+  std::atomic<int> protocol_version_; /**< Wire version for outgoing frames. */
+  std::atomic<uint64_t> messages_received_;
+  std::atomic<uint64_t> payload_bytes_received_;
+};
+
+#endif // LOAD_CLIENT_H_
@@ -0,0 +1,143 @@
+#ifndef LOAD_GENERATOR_H_
+#define LOAD_GENERATOR_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "EventLoop.h"
+#include "LatencyRecorder.h"
+#include "LoadClient.h"
+
+class TlsContext;
+
+/**
+ * @brief Enum selecting the traffic a load run generates.
+ */
+enum class LoadScenario {
+  BROADCAST,     /**< Senders broadcast; measures the server's fan-out. */
+  PRIVATE,       /**< Each sender messages one peer; measures point-to-point routing. */
+  ROOM,          /**< Clients are split into rooms; senders post to their room. Measures room fan-out. */
+  FILE_TRANSFER, /**< Each sender streams file chunks to one peer, all transfers concurrent. */
+};
+
+/**
+ * @brief Settings for a load run.
+ */
+struct LoadOptions {
+  std::string host = "127.0.0.1";
+  int port = 8080;
+  LoadScenario scenario = LoadScenario::BROADCAST;
+  size_t clients = 100;                   /**< Connections opened; all of them receive. */
+  size_t senders = 1;                     /**< Connections that also send, at most clients. */
+  size_t io_threads = 1;                  /**< Event loops driving the connections. */
+  IoBackend io_backend = IoBackend::POLLER; /**< How the event loops wait. */
+  double rate = 0;                        /**< Messages per second per sender, 0 to send as fast as possible. */
+  size_t payload_size = 64;               /**< Message payload bytes, including the timestamp. */
+  size_t chunk_size = 64 * 1024;          /**< File chunk bytes in the file scenario. */
+  size_t room_size = 10;                  /**< Members per room in the room scenario. */
+  double duration_seconds = 10;           /**< How long the senders send. */
+  size_t max_queued_bytes = 1024 * 1024;  /**< Per-sender backlog beyond which sending pauses. */
+  std::shared_ptr<TlsContext> tls;        /**< Shared by every connection, so they resume; null for plaintext. */
+};
+
+/**
+ * @brief Results of a load run.
+ */
+struct LoadReport {
+  size_t connected = 0;           /**< Clients that completed the handshake. */
+  uint64_t sent = 0;              /**< Messages queued by the senders. */
+  uint64_t delivered = 0;         /**< Measured messages received by all clients. */
+  uint64_t delivered_bytes = 0;   /**< Payload bytes of the delivered messages. */
+  double elapsed_seconds = 0;     /**< From the first send until the last delivery. */
+  HistogramSnapshot latency;      /**< Send-to-receive latency in nanoseconds. */
+
+  /**
+   * @brief Renders the report as a few lines of text.
+   * @return The formatted report.
+   */
+  std::string Format() const;
+};
+
+/**
+ * @brief Drives many synthetic clients against a running server.
+ *
+ * Opens the connections, spreads them over a few event loops, makes the
+ * first clients send according to the scenario and collects delivery
+ * counts and latency from every client.
+ */
+class LoadGenerator {
+public:
+  /**
+   * @brief Constructs a generator.
+   * @param options The run settings.
+   */
+  explicit LoadGenerator(const LoadOptions &options);
+
+  /**
+   * @brief Destroys the generator, disconnecting every client.
+   */
+  ~LoadGenerator();
+
+  LoadGenerator(const LoadGenerator &) = delete;
+  LoadGenerator &operator=(const LoadGenerator &) = delete;
+
+  /**
+   * @brief Opens the connections and waits until each has its client ID.
+   * @return False if no client could connect.
+   */
+  bool Connect();
+
+  /**
+   * @brief Sends for the configured duration, then waits for deliveries to settle.
+   * @return The results.
+   */
+  LoadReport Run();
+
+  /**
+   * @brief Closes every connection and stops the event loops.
+   */
+  void Disconnect();
+
+private:
+  /**
+   * @brief Sending loop for the senders with index = first (mod stride).
+   *
+   * @param first Index of the first sender handled.
+   * @param stride Distance between the senders handled.
+   * @param sent Receives the number of messages queued.
+   */
+  void SendLoop(size_t first, size_t stride, uint64_t *sent);
+
+  /**
+   * @brief Builds and queues one measured message.
+   * @param sender Index of the sending client.
+   * @return False if the sender is disconnected.
+   */
+  bool SendOne(size_t sender);
+
+  /**
+   * @brief Sums the delivery counters of every client.
+   *
+   * @param messages Receives the delivered message count.
+   * @param bytes Receives the delivered payload bytes.
+   */
+  void CountDelivered(uint64_t &messages, uint64_t &bytes) const;
+
+  /**
+   * @brief Gets the client a sender targets in the point-to-point scenarios.
+   * @param sender Index of the sending client.
+   * @return The recipient's client ID.
+   */
+  int PeerOf(size_t sender) const;
+
+  LoadOptions options_;
+  LatencyRecorder latency_;
+  std::vector<std::unique_ptr<EventLoop>> loops_;
+  std::vector<std::unique_ptr<LoadClient>> clients_; /**< Handshaken clients; senders first. */
+  uint64_t end_ns_;                                  /**< When the send loops stop. */
+};
+
+#endif // LOAD_GENERATOR_H_
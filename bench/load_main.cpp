@@ -0,0 +1,104 @@
+#include "LoadGenerator.h"
+
+#include <iostream>
+#include <string>
+
+#ifdef CHAT_HAVE_OPENSSL
+#include "TlsContext.h"
+#endif
+
+/**
+ * @brief Main entry point for the load generator.
+ * @param argc The number of command-line arguments.
+ * @param argv An array of command-line argument strings.
+ * @return 0 on success, 1 on error.
+ */
+int main(int argc, char *argv[]) {
+  if (argc < 3) {
+    std::cerr << "Usage: " << argv[0] << " <host> <port> [--scenario broadcast|private|room|file] [--clients N]"
+              << " [--senders N] [--rate MSGS_PER_SECOND] [--payload BYTES] [--chunk BYTES] [--room-size N]"
+              << " [--duration SECONDS] [--io-threads N] [--io-backend poller|io_uring] [--max-queued-bytes N]"
+              << " [--tls]" << std::endl;
+    return 1;
+  }
+
+  LoadOptions options;
+  options.host = argv[1];
+  options.port = std::stoi(argv[2]);
+  if (options.port <= 0 || options.port > 65535) {
+    std::cerr << "Invalid port number: " << options.port << std::endl;
+    return 1;
+  }
+
+  for (int i = 3; i < argc; ++i) {
+    std::string arg = argv[i];
+    if (arg == "--scenario" && i + 1 < argc) {
+      std::string scenario = argv[++i];
+      if (scenario == "broadcast") {
+        options.scenario = LoadScenario::BROADCAST;
+      } else if (scenario == "private") {
+        options.scenario = LoadScenario::PRIVATE;
+      } else if (scenario == "room") {
+        options.scenario = LoadScenario::ROOM;
+      } else if (scenario == "file") {
+        options.scenario = LoadScenario::FILE_TRANSFER;
+      } else {
+        std::cerr << "Unknown scenario: " << scenario << std::endl;
+        return 1;
+      }
+    } else if (arg == "--clients" && i + 1 < argc) {
+      options.clients = std::stoul(argv[++i]);
+    } else if (arg == "--senders" && i + 1 < argc) {
+      options.senders = std::stoul(argv[++i]);
+    } else if (arg == "--rate" && i + 1 < argc) {
+      options.rate = std::stod(argv[++i]);
+    } else if (arg == "--payload" && i + 1 < argc) {
+      options.payload_size = std::stoul(argv[++i]);
+    } else if (arg == "--chunk" && i + 1 < argc) {
+      options.chunk_size = std::stoul(argv[++i]);
+    } else if (arg == "--room-size" && i + 1 < argc) {
+      options.room_size = std::stoul(argv[++i]);
+    } else if (arg == "--duration" && i + 1 < argc) {
+      options.duration_seconds = std::stod(argv[++i]);
+    } else if (arg == "--io-threads" && i + 1 < argc) {
+      options.io_threads = std::stoul(argv[++i]);
+    } else if (arg == "--io-backend" && i + 1 < argc) {
+      std::string backend = argv[++i];
+      if (backend == "poller") {
+        options.io_backend = IoBackend::POLLER;
+      } else if (backend == "io_uring") {
+        options.io_backend = IoBackend::IO_URING;
+      } else {
+        std::cerr << "Unknown I/O backend: " << backend << std::endl;
+        return 1;
+      }
+    } else if (arg == "--max-queued-bytes" && i + 1 < argc) {
+      options.max_queued_bytes = std::stoul(argv[++i]);
+    } else if (arg == "--tls") {
+#ifdef CHAT_HAVE_OPENSSL
+      // The server's certificate is not verified: the generator only measures
+      options.tls = TlsContext::Create(TlsRole::CLIENT, TlsOptions());
+      if (!options.tls) {
+        return 1;
+      }
+#else
+      std::cerr << "TLS is not available in this build." << std::endl;
+      return 1;
+#endif
+    } else {
+      std::cerr << "Unknown argument: " << arg << std::endl;
+      return 1;
+    }
+  }
+
+  LoadGenerator generator(options);
+  if (!generator.Connect()) {
+    std::cerr << "No load client could connect to " << options.host << ":" << options.port << "." << std::endl;
+    return 1;
+  }
+  LoadReport report = generator.Run();
+  generator.Disconnect();
+
+  std::cout << report.Format();
+  return 0;
+}
@@ -0,0 +1,116 @@
+#include <benchmark/benchmark.h>
+
+#include <algorithm>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "MessageFramer.h"
+#include "MessageSerialization.h"
+
+namespace {
+
+// Frames fed to the framer per benchmark iteration
+const size_t kFramerBatch = 256;
+
+/**
+ * @brief Builds a broadcast message with a payload of the given size.
+ * @param payload_size Payload bytes.
+ * @return The message.
+ */
+Message MakeMessage(size_t payload_size) {
+  Message message;
+  message.header = {MessageType::BROADCAST_MESSAGE, 17, -1, payload_size, 0, 0, 0};
+  message.payload.assign(payload_size, 'x');
+  return message;
+}
+
+/**
+ * @brief Adds the payload sizes and wire versions every benchmark runs with.
+ * @param benchmark The benchmark to configure.
+ */
+void MessageArguments(benchmark::internal::Benchmark *benchmark) {
+  benchmark->ArgNames({"version", "payload"});
+  for (int version : {kProtocolVersionLegacy, kProtocolVersionCompact}) {
+    for (int payload_size : {64, 4096, 65536}) {
+      benchmark->Args({version, payload_size});
+    }
+  }
+}
+
+} // namespace
+
+/**
+ * @brief Measures SerializeMessage (header encoding plus payload copy into a pooled buffer).
+ */
+static void BM_SerializeMessage(benchmark::State &state) {
+  int version = static_cast<int>(state.range(0));
+  Message message = MakeMessage(static_cast<size_t>(state.range(1)));
+  MessageView view(message);
+  size_t frame_size = 0;
+  for (auto _ : state) {
+    PooledBuffer frame = SerializeMessage(view, version);
+    frame_size = frame.size();
+    benchmark::DoNotOptimize(frame.data());
+  }
+  state.SetItemsProcessed(state.iterations());
+  state.SetBytesProcessed(state.iterations() * static_cast<int64_t>(frame_size));
+}
+BENCHMARK(BM_SerializeMessage)->Apply(MessageArguments);
+
+/**
+ * @brief Measures DeserializeMessage on a complete frame.
+ */
+static void BM_DeserializeMessage(benchmark::State &state) {
+  int version = static_cast<int>(state.range(0));
+  PooledBuffer serialized = SerializeMessage(MakeMessage(static_cast<size_t>(state.range(1))), version);
+  std::vector<char> frame(serialized.begin(), serialized.end());
+  for (auto _ : state) {
+    Message message = DeserializeMessage(frame);
+    benchmark::DoNotOptimize(message.payload.data());
+  }
+  state.SetItemsProcessed(state.iterations());
+  state.SetBytesProcessed(state.iterations() * static_cast<int64_t>(frame.size()));
+}
+BENCHMARK(BM_DeserializeMessage)->Apply(MessageArguments);
+
+/**
+ * @brief Measures the receive path: a stream of frames copied into the
+ * framer's read window in socket-read-sized pieces and split into views.
+ */
+static void BM_MessageFramer(benchmark::State &state) {
+  int version = static_cast<int>(state.range(0));
+  PooledBuffer frame = SerializeMessage(MakeMessage(static_cast<size_t>(state.range(1))), version);
+  std::string stream;
+  for (size_t i = 0; i < kFramerBatch; ++i) {
+    stream.append(frame.data(), frame.size());
+  }
+
+  MessageFramer framer;
+  for (auto _ : state) {
+    size_t offset = 0;
+    size_t messages = 0;
+    while (offset < stream.size()) {
+      size_t capacity = 0;
+      char *window = framer.PrepareRead(capacity);
+      size_t bytes = std::min(capacity, stream.size() - offset);
+      std::memcpy(window, stream.data() + offset, bytes);
+      framer.CommitRead(bytes);
+      offset += bytes;
+      MessageView view;
+      while (framer.Next(view)) {
+        benchmark::DoNotOptimize(view.payload.data());
+        ++messages;
+      }
+    }
+    if (messages != kFramerBatch || framer.HasError()) {
+      state.SkipWithError("Framer did not return every message.");
+      break;
+    }
+  }
+  state.SetItemsProcessed(state.iterations() * static_cast<int64_t>(kFramerBatch));
+  state.SetBytesProcessed(state.iterations() * static_cast<int64_t>(stream.size()));
+}
+BENCHMARK(BM_MessageFramer)->Apply(MessageArguments);
+
+BENCHMARK_MAIN();
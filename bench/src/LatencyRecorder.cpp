@@ -0,0 +1,35 @@
+#include "LatencyRecorder.h"
+
+/**
+ * @brief Constructs an empty recorder.
+ */
+LatencyRecorder::LatencyRecorder() : count_(0), sum_(0), buckets_(new std::atomic<uint64_t>[kHistogramBucketCount]) {
+  for (size_t i = 0; i < kHistogramBucketCount; ++i) {
+    buckets_[i].store(0, std::memory_order_relaxed);
+  }
+}
+
+/**
+ * @brief Records one latency sample. Safe to call from any thread.
+ * @param nanoseconds The sample.
+ */
+void LatencyRecorder::Record(uint64_t nanoseconds) {
+  count_.fetch_add(1, std::memory_order_relaxed);
+  sum_.fetch_add(nanoseconds, std::memory_order_relaxed);
+  buckets_[HistogramBucketFor(nanoseconds)].fetch_add(1, std::memory_order_relaxed);
+}
+
+/**
+ * @brief Copies the samples recorded so far.
+ * @return The histogram.
+ */
+HistogramSnapshot LatencyRecorder::Snapshot() const {
+  HistogramSnapshot snapshot;
+  snapshot.count = count_.load(std::memory_order_relaxed);
+  snapshot.sum = sum_.load(std::memory_order_relaxed);
+  snapshot.buckets.resize(kHistogramBucketCount);
+  for (size_t i = 0; i < kHistogramBucketCount; ++i) {
+    snapshot.buckets[i] = buckets_[i].load(std::memory_order_relaxed);
+  }
+  return snapshot;
+}
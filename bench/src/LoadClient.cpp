@@ -0,0 +1,291 @@
+#include "LoadClient.h"
+
+#include <algorithm>
+
+#include "Logger.h"
+#include "MessageSerialization.h"
+#include "Metrics.h"
+
+namespace {
+
+// Reads and writes per readiness event, so one busy connection cannot
+// starve the rest of the clients sharing its loop (as in ClientHandler)
+const int kMaxReadsPerEvent = 16;
+const int kMaxWritesPerEvent = 16;
+
+// Queued frames gathered into one SendV call
+const size_t kMaxWriteBatch = 64;
+
+/**
+ * @brief Checks whether a message type carries a load timestamp.
+ * @param type The message type.
+ * @return True for the message types the load generator sends.
+ */
+bool IsMeasuredType(MessageType type) {
+  return type == MessageType::BROADCAST_MESSAGE || type == MessageType::PRIVATE_MESSAGE ||
+         type == MessageType::ROOM_MESSAGE || type == MessageType::FILE_DATA_CHUNK;
+}
+
+} // namespace
+
+/**
+ * @brief Writes a send timestamp into the last bytes of a payload.
+ * @param nanoseconds The timestamp, see Metrics::NowNanoseconds.
+ * @param out Destination with room for kLoadTimestampSize bytes.
+ */
+void EncodeLoadTimestamp(uint64_t nanoseconds, char *out) {
+  for (size_t i = 0; i < kLoadTimestampSize; ++i) {
+    out[i] = static_cast<char>((nanoseconds >> (8 * i)) & 0xff);
+  }
+}
+
+/**
+ * @brief Reads a send timestamp written by EncodeLoadTimestamp.
+ * @param in The kLoadTimestampSize timestamp bytes.
+ * @return The timestamp.
+ */
+uint64_t DecodeLoadTimestamp(const char *in) {
+  uint64_t nanoseconds = 0;
+  for (size_t i = 0; i < kLoadTimestampSize; ++i) {
+    nanoseconds |= static_cast<uint64_t>(static_cast<unsigned char>(in[i])) << (8 * i);
+  }
+  return nanoseconds;
+}
+
+/**
+ * @brief Constructs a client over a connected socket.
+ * @param socket The socket connected to the server.
+ * @param event_loop The loop driving the connection.
+ * @param latency Receives the latency of every timestamped message.
+ */
+LoadClient::LoadClient(std::unique_ptr<ISocket> socket, EventLoop *event_loop, LatencyRecorder *latency)
+    : socket_(std::move(socket)), event_loop_(event_loop), socket_handle_(socket_->GetNativeHandle()),
+      latency_(latency), front_offset_(0), queued_bytes_(0), write_armed_(false), connected_(false), client_id_(-1),
+      room_id_(-1), join_answered_(false), protocol_version_(kProtocolVersionLegacy), messages_received_(0),
+      payload_bytes_received_(0) {}
+
+/**
+ * @brief Destroys the client, closing the connection.
+ */
+LoadClient::~LoadClient() {
+  Stop();
+}
+
+/**
+ * @brief Switches the socket to non-blocking mode and registers it with the loop.
+ * @return False if the socket could not be made non-blocking.
+ */
+bool LoadClient::Start() {
+  if (!socket_->SetNonBlocking(true)) {
+    CHAT_LOG_ERROR("Failed to make load client socket non-blocking.");
+    return false;
+  }
+  connected_.store(true);
+  event_loop_->Register(socket_handle_, this, kPollReadable);
+  return true;
+}
+
+/**
+ * @brief Unregisters the connection and closes it.
+ */
+void LoadClient::Stop() {
+  // Unregister even after a disconnect on the loop thread: it is a no-op
+  // then, but still waits until no callback is using the socket
+  connected_.store(false);
+  event_loop_->Unregister(socket_handle_, this);
+  if (socket_->IsValid()) {
+    socket_->Close();
+  }
+}
+
+/**
+ * @brief Queues a message for the server. Safe to call from any thread.
+ * @param message The message; serialized before the call returns.
+ * @return False if the connection is closed.
+ */
+bool LoadClient::Send(const MessageView &message) {
+  if (!connected_.load()) {
+    return false;
+  }
+  PooledBuffer frame = SerializeMessage(message, protocol_version_.load());
+  size_t frame_size = frame.size();
+  {
+    std::lock_guard<std::mutex> lock(send_mutex_);
+    send_queue_.push_back(std::move(frame));
+    // Counted under the lock so OnWritable never subtracts it first
+    queued_bytes_.fetch_add(frame_size, std::memory_order_relaxed);
+  }
+
+  if (!write_armed_.exchange(true)) {
+    event_loop_->UpdateInterest(socket_handle_, this, kPollReadable | kPollWritable);
+  }
+  return true;
+}
+
+/**
+ * @brief Asks the server to add the client to a room.
+ * @param room_name The room name.
+ * @return False if the connection is closed.
+ */
+bool LoadClient::JoinRoom(const std::string &room_name) {
+  join_answered_.store(false);
+  MessageHeader header = {MessageType::ROOM_JOIN, client_id_.load(), -1, room_name.size(), 0, 0, 0};
+  return Send(MessageView(header, PayloadView(room_name.data(), room_name.size())));
+}
+
+/**
+ * @brief Reactor callback: drains the readable socket.
+ */
+void LoadClient::OnReadable() {
+  for (int reads = 0; reads < kMaxReadsPerEvent && connected_.load(); ++reads) {
+    size_t capacity = 0;
+    char *read_buffer = framer_.PrepareRead(capacity);
+    int bytes_received = socket_->Receive(read_buffer, capacity);
+
+    if (bytes_received > 0) {
+      framer_.CommitRead(static_cast<size_t>(bytes_received));
+      MessageView message;
+      while (framer_.Next(message)) {
+        HandleMessage(message);
+      }
+      if (framer_.HasError()) {
+        CHAT_LOG_ERROR("Malformed frame received by load client " << client_id_.load() << ".");
+        HandleDisconnect();
+        return;
+      }
+    } else if (bytes_received == 0 || !socket_->WouldBlock()) {
+      HandleDisconnect();
+      return;
+    } else {
+      return; // Drained everything that was available
+    }
+  }
+}
+
+/**
+ * @brief Reactor callback: writes queued messages.
+ */
+void LoadClient::OnWritable() {
+  for (int writes = 0; writes < kMaxWritesPerEvent && connected_.load(); ++writes) {
+    size_t batch_bytes = 0;
+    {
+      std::lock_guard<std::mutex> lock(send_mutex_);
+      write_batch_.clear();
+      size_t offset = front_offset_;
+      for (const PooledBuffer &frame : send_queue_) {
+        if (write_batch_.size() == kMaxWriteBatch) {
+          break;
+        }
+        write_batch_.push_back({frame.data() + offset, frame.size() - offset});
+        batch_bytes += frame.size() - offset;
+        offset = 0;
+      }
+    }
+
+    if (batch_bytes == 0) {
+      // Drained: disarm, then re-check to close the race with a concurrent
+      // Send that saw write_armed_ still set.
+      write_armed_.store(false);
+      event_loop_->UpdateInterest(socket_handle_, this, kPollReadable);
+      if (queued_bytes_.load() > 0 && !write_armed_.exchange(true)) {
+        event_loop_->UpdateInterest(socket_handle_, this, kPollReadable | kPollWritable);
+      }
+      return;
+    }
+
+    int bytes_sent = socket_->SendV(write_batch_.data(), write_batch_.size());
+    if (bytes_sent < 0) {
+      if (socket_->WouldBlock()) {
+        return; // Stay armed until the socket drains
+      }
+      HandleDisconnect();
+      return;
+    }
+
+    // Pop what was written; Send only appends, so the front is still ours
+    size_t remaining = static_cast<size_t>(bytes_sent);
+    {
+      std::lock_guard<std::mutex> lock(send_mutex_);
+      while (remaining > 0 && !send_queue_.empty()) {
+        size_t front_left = send_queue_.front().size() - front_offset_;
+        if (remaining < front_left) {
+          front_offset_ += remaining;
+          break;
+        }
+        remaining -= front_left;
+        front_offset_ = 0;
+        send_queue_.pop_front();
+      }
+      queued_bytes_.fetch_sub(static_cast<size_t>(bytes_sent), std::memory_order_relaxed);
+    }
+    if (static_cast<size_t>(bytes_sent) < batch_bytes) {
+      return; // Send buffer is full
+    }
+  }
+}
+
+/**
+ * @brief Reactor callback: the server hung up or the socket errored.
+ */
+void LoadClient::OnHangup() {
+  OnReadable();
+  HandleDisconnect();
+}
+
+/**
+ * @brief Answers the ID assignment and counts measured messages.
+ * @param message The received message.
+ */
+void LoadClient::HandleMessage(const MessageView &message) {
+  if (message.header.type == MessageType::CLIENT_ID_ASSIGNMENT) {
+    int assigned_id = -1;
+    int server_version = kProtocolVersionLegacy;
+    std::vector<CompressionCodecId> offered_codecs;
+    if (!ParseClientIdAssignment(message.payload, assigned_id, server_version, offered_codecs)) {
+      CHAT_LOG_ERROR("Load client received a malformed client ID assignment.");
+      return;
+    }
+    int version = std::min(server_version, kProtocolVersionLatest);
+    if (version >= kProtocolVersionCompact) {
+      // Echo in the compact format, without compression, so the server
+      // relays transfer IDs to us and we measure the uncompressed path
+      protocol_version_.store(version);
+      std::string echo = FormatClientIdAssignment(assigned_id, version);
+      MessageHeader header = {MessageType::CLIENT_ID_ASSIGNMENT, assigned_id, -1, echo.size(), 0, 0, 0};
+      Send(MessageView(header, PayloadView(echo.data(), echo.size())));
+    }
+    // Published last: the load generator starts sending once it sees the ID
+    client_id_.store(assigned_id);
+    return;
+  }
+
+  if (message.header.type == MessageType::HEARTBEAT) {
+    MessageHeader header = {MessageType::HEARTBEAT, client_id_.load(), -1, 0, 0, 0, 0};
+    Send(MessageView(header, PayloadView()));
+    return;
+  }
+
+  if (message.header.type == MessageType::ROOM_JOIN) {
+    room_id_.store(message.header.recipient_id);
+    join_answered_.store(true);
+    return;
+  }
+
+  if (IsMeasuredType(message.header.type) && message.payload.size() >= kLoadTimestampSize) {
+    uint64_t sent = DecodeLoadTimestamp(message.payload.end() - kLoadTimestampSize);
+    uint64_t now = Metrics::NowNanoseconds();
+    latency_->Record(now > sent ? now - sent : 0);
+    messages_received_.fetch_add(1, std::memory_order_relaxed);
+    payload_bytes_received_.fetch_add(message.payload.size(), std::memory_order_relaxed);
+  }
+}
+
+/**
+ * @brief Marks the connection closed after an error or hangup (loop thread).
+ */
+void LoadClient::HandleDisconnect() {
+  if (connected_.exchange(false)) {
+    CHAT_LOG_INFO("Load client " << client_id_.load() << " disconnected.");
+    event_loop_->Unregister(socket_handle_, this);
+  }
+}
@@ -0,0 +1,348 @@
+#include "LoadGenerator.h"
+
+#include <algorithm>
+#include <chrono>
+#include <iomanip>
+#include <sstream>
+#include <thread>
+
+#include "Logger.h"
+#include "MessageSerialization.h"
+#include "Metrics.h"
+
+#ifdef _WIN32
+#include "WinsockSocket.h"
+#else
+#include "PosixSocket.h"
+#endif
+
+#ifdef CHAT_HAVE_OPENSSL
+#include "TlsSocket.h"
+#endif
+
+namespace {
+
+// How long Connect waits for the server to assign every client an ID
+const auto kHandshakeTimeout = std::chrono::seconds(10);
+
+// After sending stops, deliveries count as settled once they have not
+// changed for kSettleTime, or after kMaxDrainTime at the latest
+const auto kSettleTime = std::chrono::milliseconds(500);
+const auto kMaxDrainTime = std::chrono::seconds(5);
+
+// Sleep between pacing rounds of a send loop that had nothing to send
+const auto kPacingInterval = std::chrono::microseconds(200);
+
+// Messages one sender queues per pacing round, so the loop keeps checking
+// the clock when the server drains the sender as fast as it is filled
+const uint64_t kMaxSendsPerRound = 64;
+
+/**
+ * @brief Converts a nanosecond value to milliseconds for printing.
+ * @param nanoseconds The value.
+ * @return The value in milliseconds.
+ */
+double ToMilliseconds(uint64_t nanoseconds) {
+  return static_cast<double>(nanoseconds) / 1e6;
+}
+
+} // namespace
+
+/**
+ * @brief Renders the report as a few lines of text.
+ * @return The formatted report.
+ */
+std::string LoadReport::Format() const {
+  double seconds = elapsed_seconds > 0 ? elapsed_seconds : 1;
+  std::ostringstream out;
+  out << std::fixed << std::setprecision(1);
+  out << "clients connected: " << connected << "\n";
+  out << "messages sent:     " << sent << "\n";
+  out << "messages received: " << delivered << " in " << elapsed_seconds << " s\n";
+  out << "throughput:        " << static_cast<double>(delivered) / seconds << " msgs/s, "
+      << static_cast<double>(delivered_bytes) / seconds / (1024.0 * 1024.0) << " MB/s\n";
+  out << std::setprecision(3);
+  out << "latency (ms):      p50 " << ToMilliseconds(latency.Percentile(0.5)) << ", p99 "
+      << ToMilliseconds(latency.Percentile(0.99)) << ", p999 " << ToMilliseconds(latency.Percentile(0.999))
+      << ", max " << ToMilliseconds(latency.Percentile(1.0)) << ", mean " << latency.Mean() / 1e6 << "\n";
+  return out.str();
+}
+
+/**
+ * @brief Constructs a generator.
+ * @param options The run settings.
+ */
+LoadGenerator::LoadGenerator(const LoadOptions &options) : options_(options), end_ns_(0) {
+  options_.clients = std::max<size_t>(options_.clients, 1);
+  options_.senders = std::min(std::max<size_t>(options_.senders, 1), options_.clients);
+  options_.io_threads = std::max<size_t>(options_.io_threads, 1);
+  options_.payload_size = std::max(options_.payload_size, kLoadTimestampSize);
+  options_.chunk_size = std::max(options_.chunk_size, kLoadTimestampSize);
+  options_.room_size = std::max<size_t>(options_.room_size, 1);
+}
+
+/**
+ * @brief Destroys the generator, disconnecting every client.
+ */
+LoadGenerator::~LoadGenerator() {
+  Disconnect();
+}
+
+/**
+ * @brief Opens the connections and waits until each has its client ID.
+ * @return False if no client could connect.
+ */
+bool LoadGenerator::Connect() {
+  for (size_t i = 0; i < options_.io_threads; ++i) {
+    std::unique_ptr<EventLoop> loop(new EventLoop(options_.io_backend));
+    if (!loop->Start()) {
+      CHAT_LOG_ERROR("Failed to start load generator event loop.");
+      return false;
+    }
+    loops_.push_back(std::move(loop));
+  }
+
+  std::vector<std::unique_ptr<LoadClient>> pending;
+  for (size_t i = 0; i < options_.clients; ++i) {
+#ifdef _WIN32
+    std::unique_ptr<ISocket> socket(new WinsockSocket());
+#else
+    std::unique_ptr<ISocket> socket(new PosixSocket());
+#endif
+#ifdef CHAT_HAVE_OPENSSL
+    if (options_.tls) {
+      socket.reset(new TlsSocket(std::move(socket), options_.tls));
+    }
+#endif
+    if (!socket->IsValid() || !socket->Connect(options_.host, options_.port)) {
+      CHAT_LOG_ERROR("Load client " << i << " failed to connect to " << options_.host << ":" << options_.port << ".");
+      break;
+    }
+    socket->ApplyOptions(SocketOptions());
+    EventLoop *loop = loops_[i % loops_.size()].get();
+    std::unique_ptr<LoadClient> client(new LoadClient(std::move(socket), loop, &latency_));
+    if (client->Start()) {
+      pending.push_back(std::move(client));
+    }
+  }
+
+  auto deadline = std::chrono::steady_clock::now() + kHandshakeTimeout;
+  for (std::unique_ptr<LoadClient> &client : pending) {
+    while (client->IsConnected() && client->GetClientId() < 0 && std::chrono::steady_clock::now() < deadline) {
+      std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+  }
+  for (std::unique_ptr<LoadClient> &client : pending) {
+    if (client->IsConnected() && client->GetClientId() >= 0) {
+      clients_.push_back(std::move(client));
+    }
+  }
+
+  if (options_.scenario == LoadScenario::ROOM) {
+    // Consecutive clients share a room, so the senders (the first clients) start in the first rooms
+    for (size_t i = 0; i < clients_.size(); ++i) {
+      clients_[i]->JoinRoom("load-" + std::to_string(i / options_.room_size));
+    }
+    for (std::unique_ptr<LoadClient> &client : clients_) {
+      while (client->IsConnected() && !client->IsJoinAnswered() && std::chrono::steady_clock::now() < deadline) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+      }
+    }
+  }
+
+  if (clients_.size() < options_.clients) {
+    CHAT_LOG_WARNING("Only " << clients_.size() << " of " << options_.clients << " load clients connected.");
+  }
+  options_.senders = std::min(options_.senders, clients_.size());
+  return !clients_.empty();
+}
+
+/**
+ * @brief Sends for the configured duration, then waits for deliveries to settle.
+ * @return The results.
+ */
+LoadReport LoadGenerator::Run() {
+  LoadReport report;
+  report.connected = clients_.size();
+  if (clients_.empty()) {
+    return report;
+  }
+
+  if (options_.scenario == LoadScenario::FILE_TRANSFER) {
+    // Announce one transfer per sender; the server relays the chunks by
+    // recipient and transfer ID without tracking them
+    uint64_t expected_size = options_.rate > 0 ? static_cast<uint64_t>(options_.rate * options_.duration_seconds) *
+                                                     options_.chunk_size
+                                               : 0;
+    for (size_t i = 0; i < options_.senders; ++i) {
+      FileTransferRequest request;
+      request.recipient_id = PeerOf(i);
+      request.file_name = "load_" + std::to_string(i) + ".bin";
+      request.file_size = expected_size;
+      std::string payload = FormatFileTransferRequest(request);
+      MessageHeader header = {MessageType::FILE_TRANSFER_REQUEST, clients_[i]->GetClientId(), request.recipient_id,
+                              payload.size(), 0, static_cast<uint32_t>(i + 1), 0};
+      clients_[i]->Send(MessageView(header, PayloadView(payload.data(), payload.size())));
+    }
+  }
+
+  uint64_t start_ns = Metrics::NowNanoseconds();
+  end_ns_ = start_ns + static_cast<uint64_t>(options_.duration_seconds * 1e9);
+
+  size_t thread_count = std::min(options_.senders, loops_.size());
+  std::vector<uint64_t> sent(thread_count, 0);
+  std::vector<std::thread> threads;
+  for (size_t i = 0; i < thread_count; ++i) {
+    threads.emplace_back(&LoadGenerator::SendLoop, this, i, thread_count, &sent[i]);
+  }
+  for (std::thread &thread : threads) {
+    thread.join();
+  }
+  for (uint64_t count : sent) {
+    report.sent += count;
+  }
+
+  if (options_.scenario == LoadScenario::FILE_TRANSFER) {
+    for (size_t i = 0; i < options_.senders; ++i) {
+      MessageHeader header = {MessageType::FILE_TRANSFER_COMPLETE, clients_[i]->GetClientId(), PeerOf(i), 0, 0,
+                              static_cast<uint32_t>(i + 1), 0};
+      clients_[i]->Send(MessageView(header, PayloadView()));
+    }
+  }
+
+  // Let the queues drain; the run ends at the last delivery seen
+  uint64_t last_messages = 0;
+  uint64_t last_bytes = 0;
+  CountDelivered(last_messages, last_bytes);
+  uint64_t last_change_ns = Metrics::NowNanoseconds();
+  auto drain_deadline = std::chrono::steady_clock::now() + kMaxDrainTime;
+  auto stable_since = std::chrono::steady_clock::now();
+  while (std::chrono::steady_clock::now() < drain_deadline &&
+         std::chrono::steady_clock::now() - stable_since < kSettleTime) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    uint64_t messages = 0;
+    uint64_t bytes = 0;
+    CountDelivered(messages, bytes);
+    if (messages != last_messages) {
+      last_messages = messages;
+      last_bytes = bytes;
+      last_change_ns = Metrics::NowNanoseconds();
+      stable_since = std::chrono::steady_clock::now();
+    }
+  }
+
+  report.delivered = last_messages;
+  report.delivered_bytes = last_bytes;
+  report.elapsed_seconds = static_cast<double>(std::max(last_change_ns, end_ns_) - start_ns) / 1e9;
+  report.latency = latency_.Snapshot();
+  return report;
+}
+
+/**
+ * @brief Closes every connection and stops the event loops.
+ */
+void LoadGenerator::Disconnect() {
+  for (std::unique_ptr<LoadClient> &client : clients_) {
+    client->Stop();
+  }
+  clients_.clear();
+  for (std::unique_ptr<EventLoop> &loop : loops_) {
+    loop->Stop();
+  }
+  loops_.clear();
+}
+
+/**
+ * @brief Sending loop for the senders with index = first (mod stride).
+ * @param first Index of the first sender handled.
+ * @param stride Distance between the senders handled.
+ * @param sent Receives the number of messages queued.
+ */
+void LoadGenerator::SendLoop(size_t first, size_t stride, uint64_t *sent) {
+  size_t message_size = options_.scenario == LoadScenario::FILE_TRANSFER ? options_.chunk_size : options_.payload_size;
+  std::vector<uint64_t> sent_by(options_.senders, 0);
+  uint64_t start_ns = Metrics::NowNanoseconds();
+
+  for (;;) {
+    uint64_t now_ns = Metrics::NowNanoseconds();
+    if (now_ns >= end_ns_) {
+      break;
+    }
+    // Messages each sender is due by now; unpaced senders just keep their backlog full
+    uint64_t due = options_.rate > 0 ? static_cast<uint64_t>(static_cast<double>(now_ns - start_ns) / 1e9 *
+                                                             options_.rate) + 1
+                                     : UINT64_MAX;
+    bool progressed = false;
+    for (size_t i = first; i < options_.senders; i += stride) {
+      LoadClient &client = *clients_[i];
+      uint64_t round_end = std::min(due, sent_by[i] + kMaxSendsPerRound);
+      while (sent_by[i] < round_end && client.GetQueuedBytes() + message_size <= options_.max_queued_bytes &&
+             SendOne(i)) {
+        ++sent_by[i];
+        ++*sent;
+        progressed = true;
+      }
+    }
+    if (!progressed) {
+      std::this_thread::sleep_for(kPacingInterval);
+    }
+  }
+}
+
+/**
+ * @brief Builds and queues one measured message.
+ * @param sender Index of the sending client.
+ * @return False if the sender is disconnected.
+ */
+bool LoadGenerator::SendOne(size_t sender) {
+  MessageHeader header = {MessageType::BROADCAST_MESSAGE, clients_[sender]->GetClientId(), -1, 0, 0, 0, 0};
+  size_t size = options_.payload_size;
+  switch (options_.scenario) {
+  case LoadScenario::BROADCAST:
+    break;
+  case LoadScenario::PRIVATE:
+    header.type = MessageType::PRIVATE_MESSAGE;
+    header.recipient_id = PeerOf(sender);
+    break;
+  case LoadScenario::ROOM:
+    header.type = MessageType::ROOM_MESSAGE;
+    header.recipient_id = clients_[sender]->GetRoomId();
+    break;
+  case LoadScenario::FILE_TRANSFER:
+    header.type = MessageType::FILE_DATA_CHUNK;
+    header.recipient_id = PeerOf(sender);
+    header.transfer_id = static_cast<uint32_t>(sender + 1);
+    size = options_.chunk_size;
+    break;
+  }
+
+  // The server prefixes broadcasts and room messages, so the timestamp goes at the end
+  thread_local std::vector<char> payload;
+  payload.assign(size, 'x');
+  EncodeLoadTimestamp(Metrics::NowNanoseconds(), payload.data() + size - kLoadTimestampSize);
+  header.payload_size = size;
+  return clients_[sender]->Send(MessageView(header, PayloadView(payload.data(), payload.size())));
+}
+
+/**
+ * @brief Sums the delivery counters of every client.
+ * @param messages Receives the delivered message count.
+ * @param bytes Receives the delivered payload bytes.
+ */
+void LoadGenerator::CountDelivered(uint64_t &messages, uint64_t &bytes) const {
+  messages = 0;
+  bytes = 0;
+  for (const std::unique_ptr<LoadClient> &client : clients_) {
+    messages += client->GetMessagesReceived();
+    bytes += client->GetPayloadBytesReceived();
+  }
+}
+
+/**
+ * @brief Gets the client a sender targets in the point-to-point scenarios.
+ * @param sender Index of the sending client.
+ * @return The recipient's client ID.
+ */
+int LoadGenerator::PeerOf(size_t sender) const {
+  return clients_[(sender + 1) % clients_.size()]->GetClientId();
+}
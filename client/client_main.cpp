@@ -1,9 +1,15 @@
 #include "Client.h"
+#include "CompressionCodecs.h"
 
 #include <iostream>
 #include <limits>  // For numeric_limits
 #include <sstream> // For stringstream
 #include <string>
+#include <vector>
+
+#ifdef CHAT_HAVE_OPENSSL
+#include "TlsContext.h"
+#endif
 
 /**
  * @brief Main entry point for the client application.
@@ -12,8 +18,12 @@
  * @return 0 on success, 1 on error.
  */
 int main(int argc, char *argv[]) {
-  if (argc != 3) {
-    std::cerr << "Usage: " << argv[0] << " <server_ip> <server_port>" << std::endl;
+  if (argc < 3) {
+    std::cerr << "Usage: " << argv[0] << " <server_ip> <server_port> [--chunk-size N] [--window N] [--transfers N]"
+              << " [--no-zero-copy] [--no-mmap] [--io-backend poller|io_uring] [--compression auto|none|<codec>]"
+              << " [--no-coalesce] [--no-nodelay]"
+              << " [--keepalive] [--sndbuf N] [--rcvbuf N] [--tls [--tls-ca FILE] [--tls-server-name NAME] [--no-ktls]]"
+              << std::endl;
     return 1;
   }
 
@@ -25,8 +35,103 @@ int main(int argc, char *argv[]) {
     return 1;
   }
 
+  // Parse optional file transfer settings
+  FileTransferOptions file_transfer_options;
+  std::vector<CompressionCodecId> compression_codecs;
+  ConnectionOptions connection_options;
+  bool use_tls = false;
+  std::string tls_ca_file;
+  std::string tls_server_name;
+  bool tls_kernel_offload = true;
+  for (int i = 3; i < argc; ++i) {
+    std::string arg = argv[i];
+    if (arg == "--chunk-size" && i + 1 < argc) {
+      file_transfer_options.chunk_size = std::stoul(argv[++i]);
+      if (file_transfer_options.chunk_size == 0 || file_transfer_options.chunk_size > kMaxFileChunkSize) {
+        std::cerr << "Chunk size must be between 1 and " << kMaxFileChunkSize << " bytes." << std::endl;
+        return 1;
+      }
+    } else if (arg == "--window" && i + 1 < argc) {
+      file_transfer_options.window_chunks = std::stoul(argv[++i]);
+      if (file_transfer_options.window_chunks == 0) {
+        std::cerr << "Window must be at least one chunk." << std::endl;
+        return 1;
+      }
+    } else if (arg == "--transfers" && i + 1 < argc) {
+      file_transfer_options.max_transfers = std::stoul(argv[++i]);
+      if (file_transfer_options.max_transfers == 0) {
+        std::cerr << "At least one transfer must be allowed." << std::endl;
+        return 1;
+      }
+    } else if (arg == "--no-zero-copy") {
+      file_transfer_options.zero_copy = false;
+    } else if (arg == "--no-mmap") {
+      file_transfer_options.memory_mapped = false;
+    } else if (arg == "--io-backend" && i + 1 < argc) {
+      std::string backend = argv[++i];
+      if (backend == "poller") {
+        file_transfer_options.io_backend = IoBackend::POLLER;
+      } else if (backend == "io_uring") {
+        file_transfer_options.io_backend = IoBackend::IO_URING;
+      } else {
+        std::cerr << "Unknown I/O backend: " << backend << std::endl;
+        return 1;
+      }
+    } else if (arg == "--no-coalesce") {
+      connection_options.coalesce_sends = false;
+    } else if (arg == "--no-nodelay") {
+      connection_options.socket.no_delay = false;
+    } else if (arg == "--keepalive") {
+      connection_options.socket.keep_alive = true;
+    } else if (arg == "--sndbuf" && i + 1 < argc) {
+      connection_options.socket.send_buffer_size = std::stoi(argv[++i]);
+    } else if (arg == "--rcvbuf" && i + 1 < argc) {
+      connection_options.socket.receive_buffer_size = std::stoi(argv[++i]);
+    } else if (arg == "--tls") {
+      use_tls = true;
+    } else if (arg == "--tls-ca" && i + 1 < argc) {
+      tls_ca_file = argv[++i];
+    } else if (arg == "--tls-server-name" && i + 1 < argc) {
+      tls_server_name = argv[++i];
+    } else if (arg == "--no-ktls") {
+      tls_kernel_offload = false;
+    } else if (arg == "--compression" && i + 1 < argc) {
+      std::string codec_name = argv[++i];
+      if (codec_name == "auto") {
+        compression_codecs = GetAvailableCompressionCodecs();
+      } else if (codec_name == "none") {
+        compression_codecs.clear();
+      } else if (const ICompressionCodec *codec = FindCompressionCodec(codec_name)) {
+        compression_codecs = {codec->GetId()};
+      } else {
+        std::cerr << "Compression codec not available in this build: " << codec_name << std::endl;
+        return 1;
+      }
+    } else {
+      std::cerr << "Unknown argument: " << arg << std::endl;
+      return 1;
+    }
+  }
+
+  if (use_tls) {
+#ifdef CHAT_HAVE_OPENSSL
+    TlsOptions tls_options;
+    tls_options.ca_file = tls_ca_file;
+    tls_options.server_name = tls_server_name;
+    tls_options.kernel_offload = tls_kernel_offload;
+    connection_options.tls = TlsContext::Create(TlsRole::CLIENT, tls_options);
+    if (!connection_options.tls) {
+      std::cerr << "Failed to set up TLS." << std::endl;
+      return 1;
+    }
+#else
+    std::cerr << "TLS is not available in this build." << std::endl;
+    return 1;
+#endif
+  }
+
   // Create the client instance
-  Client client(server_ip, server_port);
+  Client client(server_ip, server_port, file_transfer_options, compression_codecs, connection_options);
 
   // Connect to the server
   if (!client.Connect()) {
@@ -35,8 +140,9 @@ int main(int argc, char *argv[]) {
 
   // The send and receive threads are started in Client::Connect()
 
-  std::cout << "Enter messages to send (type 'quit' to exit, '/sendfile <recipient_id> <filepath>' to send a file):"
-            << std::endl;
+  std::cout << "Enter messages to send (type 'quit' to exit, '/sendfile <recipient_id> <filepath>' to send a file,"
+            << " '/msg <client_id> <message>' for a private message,"
+            << " '/join <room>', '/leave <room>' and '/room <room> <message>' for rooms):" << std::endl;
 
   std::string line;
   // Read input from standard input
@@ -60,6 +166,32 @@ int main(int argc, char *argv[]) {
       } else {
         client.RequestFileTransfer(recipient_id, file_path);
       }
+    } else if (line.rfind("/msg ", 0) == 0) {
+      std::stringstream ss(line.substr(5));
+      int recipient_id;
+      std::string private_message;
+      ss >> recipient_id;
+      std::getline(ss >> std::ws, private_message);
+      if (ss.fail() || private_message.empty()) {
+        std::cerr << "Invalid /msg command format. Usage: /msg <client_id> <message>" << std::endl;
+      } else {
+        client.SendPrivateMessage(recipient_id, private_message);
+      }
+    } else if (line.rfind("/join ", 0) == 0) {
+      client.JoinRoom(line.substr(6));
+    } else if (line.rfind("/leave ", 0) == 0) {
+      client.LeaveRoom(line.substr(7));
+    } else if (line.rfind("/room ", 0) == 0) {
+      std::stringstream ss(line.substr(6));
+      std::string room_name;
+      std::string room_message;
+      ss >> room_name;
+      std::getline(ss >> std::ws, room_message);
+      if (room_name.empty() || room_message.empty()) {
+        std::cerr << "Invalid /room command format. Usage: /room <room> <message>" << std::endl;
+      } else {
+        client.SendRoomMessage(room_name, room_message);
+      }
     } else {
       // Assume it's a chat message
       client.SendChatMessage(line);
@@ -8,12 +8,29 @@
 #include <queue>
 #include <string>
 #include <thread>
+#include <unordered_map>
 #include <vector>
 
+#include "ClientFileTransferHandler.h"
 #include "IClientFileTransferHandler.h"
 #include "ISocket.h"
 #include "Message.h"
+#include "MessageFramer.h"
 #include "MessageSerialization.h"
+#include "OutgoingMessage.h"
+#include "MpscQueue.h"
+
+class TlsContext;
+
+/**
+ * @brief Settings for the client's connection to the server.
+ */
+struct ConnectionOptions {
+  SocketOptions socket;                    /**< Applied to the socket before connecting. */
+  bool coalesce_sends = true;              /**< Write everything queued with gathered writes instead of one by one. */
+  size_t max_coalesced_bytes = 256 * 1024; /**< Bytes gathered before a coalesced write is issued. */
+  std::shared_ptr<TlsContext> tls;         /**< Client context encrypting the connection; null for plaintext. */
+};
 
 /**
  * @brief The client application class.
@@ -27,8 +44,16 @@ public:
    * @brief Constructs a new Client object.
    * @param server_address The IP address or hostname of the server.
    * @param server_port The port number of the server.
+   * @param file_transfer_options Chunk size and window settings for outgoing file transfers.
+   * @param compression_codecs Codecs the client is willing to compress with,
+   * most preferred first; the first one the server offers is used in both
+   * directions. Empty disables compression.
+   * @param connection_options Socket options and send coalescing settings.
    */
-  Client(const std::string &server_address, int server_port);
+  Client(const std::string &server_address, int server_port,
+         const FileTransferOptions &file_transfer_options = FileTransferOptions(),
+         const std::vector<CompressionCodecId> &compression_codecs = {},
+         const ConnectionOptions &connection_options = ConnectionOptions());
 
   /**
    * @brief Destroys the Client object. Disconnects from the server.
@@ -64,6 +89,41 @@ public:
    */
   bool RequestFileTransfer(int recipient_id, const std::string &file_path);
 
+  /**
+   * @brief Asks the server to add the client to a room.
+   *
+   * The room can be used once the server's answer has arrived.
+   *
+   * @param room_name The room name, see IsValidRoomName.
+   * @return True if the request was queued, false otherwise.
+   */
+  bool JoinRoom(const std::string &room_name);
+
+  /**
+   * @brief Asks the server to remove the client from a joined room.
+   * @param room_name The room name.
+   * @return True if the request was queued, false if the room is not joined.
+   */
+  bool LeaveRoom(const std::string &room_name);
+
+  /**
+   * @brief Sends a chat message to the members of a joined room.
+   *
+   * @param room_name The room name.
+   * @param message The message string to send.
+   * @return True if the message was queued, false if the room is not joined.
+   */
+  bool SendRoomMessage(const std::string &room_name, const std::string &message);
+
+  /**
+   * @brief Sends a chat message to a single client.
+   *
+   * @param recipient_id The recipient's client ID.
+   * @param message The message string to send.
+   * @return True if the message was queued, false otherwise.
+   */
+  bool SendPrivateMessage(int recipient_id, const std::string &message);
+
   /**
    * @brief Starts the thread for sending messages to the server.
    */
@@ -95,6 +155,7 @@ private:
    * @brief The main loop for the send thread.
    *
    * This function sends messages from a queue and handles sending file chunks.
+   * With coalescing enabled, each wakeup takes everything queued at once.
    */
   void SendMessages();
 
@@ -111,16 +172,57 @@ private:
    *
    * Delegates handling of specific message types to appropriate handlers.
    *
-   * @param message The deserialized Message object.
+   * @param message View of the received message.
    */
-  void ProcessReceivedMessage(const Message &message);
+  void ProcessReceivedMessage(const MessageView &message);
 
   /**
-   * @brief Sends a Message object to the server.
-   * @param message The Message object to send.
-   * @return True if the message was sent successfully, false otherwise.
+   * @brief Sends a batch of queued messages to the server.
+   *
+   * Consecutive messages are serialized and written with one gathered write
+   * per max_coalesced_bytes. A file region's header joins the gathered
+   * write, and its payload then goes from the file to the socket with
+   * ISocket::SendFile. While a batch containing file regions is written the
+   * socket is corked, so headers and file data leave in full segments.
+   *
+   * @param batch The messages to send, in order; emptied by the call.
+   * @return True if everything was sent, false if the connection failed.
+   */
+  bool SendBatch(std::queue<OutgoingMessage> &batch);
+
+  /**
+   * @brief Writes buffers completely, continuing after partial writes.
+   * @param buffers The buffers to send; modified as bytes are consumed.
+   * @return True if all bytes were sent, false otherwise.
+   */
+  bool SendBuffers(std::vector<IoBuffer> &buffers);
+
+  /**
+   * @brief Sends the payload of a file region with ISocket::SendFile.
+   *
+   * The header must have been sent already.
+   *
+   * @param message The queued file region.
+   * @return True if the whole payload was sent, false otherwise.
+   */
+  bool SendFileData(const OutgoingMessage &message);
+
+  /**
+   * @brief Queues a room request, room message or private message for the send thread.
+   *
+   * @param type The message type.
+   * @param recipient_id The room or client ID (-1 for a room join).
+   * @param payload The payload.
+   * @return True if the message was queued, false if not connected.
    */
-  bool SendMessage(const Message &message);
+  bool QueueMessage(MessageType type, int recipient_id, const std::string &payload);
+
+  /**
+   * @brief Gets the ID of a joined room.
+   * @param room_name The room name.
+   * @return The room ID, or -1 if the room is not joined.
+   */
+  int FindRoomId(const std::string &room_name) const;
 
   std::string server_address_;             /**< Server IP address or hostname. */
   int server_port_;                        /**< Server port number. */
@@ -128,15 +230,22 @@ private:
 
   std::thread send_thread_;               /**< Thread for sending messages. */
   std::atomic<bool> sending_;             /**< Flag to control the send thread loop. */
-  std::queue<Message> send_queue_;        /**< Queue for outgoing messages. */
-  std::mutex send_queue_mutex_;           /**< Mutex to protect the send queue. */
-  std::condition_variable send_queue_cv_; /**< Condition variable to signal the send thread. */
+  MpscQueue<OutgoingMessage> send_queue_; /**< Messages handed to the send thread. */
 
   std::thread receive_thread_;       /**< Thread for receiving messages. */
   std::atomic<bool> receiving_;      /**< Flag to control the receive thread loop. */
-  std::vector<char> receive_buffer_; /**< Buffer to accumulate incoming data. */
+  MessageFramer framer_;             /**< Receive buffer and in-place message framing. */
+
+  std::atomic<int> client_id_;        /**< The client's assigned ID from the server. */
+  std::atomic<int> protocol_version_; /**< Wire version negotiated with the server. */
+
+  std::vector<CompressionCodecId> compression_codecs_;   /**< Acceptable codecs, most preferred first. */
+  std::atomic<CompressionCodecId> compression_codec_;    /**< Codec negotiated with the server. */
+
+  ConnectionOptions connection_options_; /**< Socket, send coalescing and TLS settings. */
 
-  std::atomic<int> client_id_; /**< The client's assigned ID from the server. */
+  mutable std::mutex rooms_mutex_;                    /**< Protects joined_rooms_. */
+  std::unordered_map<std::string, int> joined_rooms_; /**< Room IDs of joined rooms by name. */
 
   // File transfer handler
   std::unique_ptr<IClientFileTransferHandler> file_transfer_handler_;
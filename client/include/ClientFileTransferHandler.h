@@ -1,139 +1,347 @@
-#ifndef CLIENT_FILE_TRANSFER_HANDLER_H_
-#define CLIENT_FILE_TRANSFER_HANDLER_H_
-
-#include "IClientFileTransferHandler.h"
-
-#include <atomic>
-#include <condition_variable>
-#include <fstream>
-#include <memory>
-#include <mutex>
-#include <queue>
-#include <string>
-#include <vector>
-
-#include "Message.h"
-#include "MessageSerialization.h"
-
-/**
- * @brief Handles file transfer operations on the client side.
- *
- * This class implements the IClientFileTransferHandler interface and manages
- * the state and logic for initiating, sending, and receiving file transfers.
- * It interacts with the Client's send queue to send file-related messages.
- */
-class ClientFileTransferHandler : public IClientFileTransferHandler {
-public:
-  /**
-   * @brief Constructs a new ClientFileTransferHandler.
-   * @param send_queue A reference to the client's message send queue.
-   * @param send_queue_mutex A reference to the mutex protecting the send queue.
-   * @param send_queue_cv A reference to the condition variable for the send queue.
-   * @param client_id A reference to the client's atomic ID.
-   */
-  ClientFileTransferHandler(std::queue<Message> &send_queue, std::mutex &send_queue_mutex,
-                            std::condition_variable &send_queue_cv, std::atomic<int> &client_id);
-
-  /**
-   * @brief Destroys the ClientFileTransferHandler. Closes any open file streams.
-   */
-  ~ClientFileTransferHandler() override;
-
-  /**
-   * @brief Initiates a file transfer request to a recipient.
-   *
-   * This method is called by the Client when the user requests a file transfer.
-   * It prepares the file transfer request message and adds it to the send queue.
-   *
-   * @param recipient_id The ID of the client to send the file to.
-   * @param file_path The path to the file to send.
-   * @return True if the request was successfully initiated, false otherwise.
-   */
-  bool RequestFileTransfer(int recipient_id, const std::string &file_path) override;
-
-  /**
-   * @brief Handles an incoming message related to file transfer.
-   *
-   * This method is called by the Client's receive logic when a file-transfer-related
-   * message is received. It processes the message based on its type
-   * (request, data chunk, complete, error).
-   *
-   * @param message The deserialized Message object.
-   */
-  void HandleMessage(const Message &message) override;
-
-private:
-  /**
-   * @brief Handles an incoming file transfer request.
-   * @param message The file transfer request message.
-   */
-  void HandleFileTransferRequest(const Message &message);
-
-  /**
-   * @brief Handles an incoming file data chunk.
-   * @param message The file data chunk message.
-   */
-  void HandleFileDataChunk(const Message &message);
-
-  /**
-   * @brief Handles a file transfer complete message.
-   * @param message The file transfer complete message.
-   */
-  void HandleFileTransferComplete(const Message &message);
-
-  /**
-   * @brief Handles a file transfer error message.
-   * @param message The file transfer error message.
-   */
-  void HandleFileTransferError(const Message &message);
-
-  /**
-   * @brief Sends the next file data chunk by adding it to the send queue.
-   *
-   * Called internally when the outgoing transfer is ready.
-   * @return True if a chunk was successfully added to the queue, false otherwise.
-   */
-  bool SendNextFileChunkToQueue();
-
-  /**
-   * @brief Adds a Message object to the client's send queue.
-   * @param message The Message object to add to the queue.
-   * @return True if the message was added to the queue, false otherwise.
-   */
-  bool AddMessageToSendQueue(const Message &message);
-
-  // State for outgoing file transfers (client sending a file)
-  struct OutgoingFileTransfer {
-    std::string file_path;
-    size_t total_size;
-    size_t sent_size;
-    std::ifstream file_stream;
-    int recipient_id;
-
-    OutgoingFileTransfer() : total_size(0), sent_size(0), recipient_id(-1) {}
-  };
-  std::unique_ptr<OutgoingFileTransfer> outgoing_transfer_;
-  std::mutex outgoing_transfer_mutex_;
-
-  // State for incoming file transfers (client receiving a file)
-  struct IncomingFileTransfer {
-    std::string file_name;
-    size_t total_size;
-    size_t received_size;
-    std::ofstream file_stream;
-    int sender_id;
-
-    IncomingFileTransfer() : total_size(0), received_size(0), sender_id(-1) {}
-  };
-  std::unique_ptr<IncomingFileTransfer> incoming_transfer_;
-  std::mutex incoming_transfer_mutex_;
-
-  const size_t kFileChunkSize = 4096;
-
-  std::queue<Message> &send_queue_;
-  std::mutex &send_queue_mutex_;
-  std::condition_variable &send_queue_cv_;
-  std::atomic<int> &client_id_;
-};
-
-#endif // CLIENT_FILE_TRANSFER_HANDLER_H_
+#ifndef CLIENT_FILE_TRANSFER_HANDLER_H_
+#define CLIENT_FILE_TRANSFER_HANDLER_H_
+
+#include "IClientFileTransferHandler.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <fstream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "EventLoop.h"
+#include "Message.h"
+#include "MessageSerialization.h"
+#include "OutgoingMessage.h"
+#include "MpscQueue.h"
+
+// Largest payload a single FILE_DATA_CHUNK may carry
+const size_t kMaxFileChunkSize = 1024 * 1024;
+
+/**
+ * @brief Tuning knobs for outgoing file transfers.
+ *
+ * The sender keeps at most window_chunks * chunk_size unacknowledged bytes in
+ * flight, so throughput is limited by the bandwidth-delay product rather than
+ * by one round trip per chunk, while a slow receiver still pushes back.
+ */
+struct FileTransferOptions {
+  size_t chunk_size = 64 * 1024; /**< Payload bytes per chunk, clamped to (0, kMaxFileChunkSize]. */
+  size_t window_chunks = 16;     /**< Chunks that may be sent ahead of the receiver's acks (at least 1). */
+  bool zero_copy = true;         /**< Send chunk payloads straight from the file with ISocket::SendFile. */
+  bool memory_mapped = true;     /**< Scan the file, and without zero_copy slice the chunks, from mapped views. */
+  size_t max_transfers = 8;      /**< Outgoing transfers that may run at once (at least 1). */
+  IoBackend io_backend = IoBackend::POLLER; /**< IO_URING reads and writes the files on a completion loop. */
+};
+
+/**
+ * @brief Handles file transfer operations on the client side.
+ *
+ * This class implements the IClientFileTransferHandler interface and manages
+ * the state and logic for initiating, sending, and receiving file transfers.
+ * It interacts with the Client's send queue to send file-related messages.
+ *
+ * Transfers use a sliding window: once the receiver acknowledges the request
+ * (a FILE_TRANSFER_ACK of 0 bytes), the sender queues chunks until the window
+ * is full, and every cumulative ack from the receiver (or the server, for
+ * uploads to the server) slides the window forward. Only a window's worth of
+ * chunks sits in the shared send queue at any time, so chat messages are not
+ * stuck behind a whole file.
+ *
+ * Several transfers can run at once in each direction. Every file message
+ * carries a transfer ID in its header, chosen by the sending client, so
+ * outgoing transfers are keyed by that ID and incoming ones by (sender, ID).
+ * Each transfer has its own window, and windows are filled round-robin one
+ * chunk at a time, so concurrent transfers share the connection evenly.
+ * Transfer IDs need the compact wire format; over a legacy connection the
+ * handler falls back to one outgoing transfer with ID 0.
+ *
+ * Before a request goes out the file is read once to compute its XXH64
+ * content hash and the CRC-32C of every chunk. The hash lets the server
+ * deduplicate and resume uploads: its first ack may be a non-zero offset, and
+ * the sender then starts there (or, for an offset equal to the file size,
+ * only sends the completion). Each chunk carries its checksum in the header,
+ * and receivers drop a transfer whose data does not match.
+ *
+ * Chunk payloads never pass through a buffer of their own: with zero_copy the
+ * send thread hands file regions to ISocket::SendFile, and with memory_mapped
+ * it gathers slices of a read-only view of the file into its writes, which
+ * also suits a TLS socket that has to encrypt in user space. Views cover a
+ * few megabytes at a time, so a huge file never is mapped as a whole.
+ *
+ * With the IO_URING backend the handler runs an EventLoop of its own, and
+ * the files are read and written on its ring instead of through streams:
+ * received chunks are queued per transfer and written one at a time, each
+ * acked once it is on disk, and copied chunks are read one at a time into
+ * their payloads. The receive thread then never waits for the disk. The
+ * scan before a request still reads the file on the calling thread.
+ */
+class ClientFileTransferHandler : public IClientFileTransferHandler {
+public:
+  /**
+   * @brief Constructs a new ClientFileTransferHandler.
+   * @param send_queue A reference to the client's message send queue.
+   * @param client_id A reference to the client's atomic ID.
+   * @param protocol_version A reference to the wire version negotiated with the server.
+   * @param options Chunk size, window and concurrency settings for outgoing transfers.
+   */
+  ClientFileTransferHandler(MpscQueue<OutgoingMessage> &send_queue, std::atomic<int> &client_id,
+                            std::atomic<int> &protocol_version,
+                            const FileTransferOptions &options = FileTransferOptions());
+
+  /**
+   * @brief Destroys the ClientFileTransferHandler. Closes any open file streams.
+   */
+  ~ClientFileTransferHandler() override;
+
+  /**
+   * @brief Initiates a file transfer request to a recipient.
+   *
+   * This method is called by the Client when the user requests a file transfer.
+   * It prepares the file transfer request message and adds it to the send queue.
+   *
+   * @param recipient_id The ID of the client to send the file to.
+   * @param file_path The path to the file to send.
+   * @return True if the request was successfully initiated, false otherwise.
+   */
+  bool RequestFileTransfer(int recipient_id, const std::string &file_path) override;
+
+  /**
+   * @brief Handles an incoming message related to file transfer.
+   *
+   * This method is called by the Client's receive logic when a file-transfer-related
+   * message is received. It processes the message based on its type
+   * (request, data chunk, complete, error).
+   *
+   * @param message View of the received message.
+   */
+  void HandleMessage(const MessageView &message) override;
+
+private:
+  /**
+   * @brief Handles an incoming file transfer request.
+   * @param message The file transfer request message.
+   */
+  void HandleFileTransferRequest(const MessageView &message);
+
+  /**
+   * @brief Handles an incoming file data chunk.
+   * @param message The file data chunk message.
+   */
+  void HandleFileDataChunk(const MessageView &message);
+
+  /**
+   * @brief Handles a file transfer complete message.
+   * @param message The file transfer complete message.
+   */
+  void HandleFileTransferComplete(const MessageView &message);
+
+  /**
+   * @brief Handles a file transfer error message.
+   * @param message The file transfer error message.
+   */
+  void HandleFileTransferError(const MessageView &message);
+
+  /**
+   * @brief Handles a cumulative acknowledgement for an outgoing transfer.
+   * @param message The file transfer ack message.
+   */
+  void HandleFileTransferAck(const MessageView &message);
+
+  struct IncomingFileTransfer;
+  struct ChunkRead;
+
+  /**
+   * @brief Writes a received chunk, or what is left of it, on file_loop_.
+   *
+   * Called without incoming_transfer_mutex_, by the owner of the write in
+   * flight, since a stopped loop completes the request at once.
+   *
+   * @param transfer The incoming transfer; writing holds the chunk.
+   * @param done Bytes of the chunk already written.
+   */
+  void WriteChunkOnLoop(const std::shared_ptr<IncomingFileTransfer> &transfer, size_t done);
+
+  /**
+   * @brief Handles the outcome of a write from WriteChunkOnLoop.
+   *
+   * Acks the chunk once it is whole on disk, then takes the next queued
+   * chunk, or finishes the transfer if its completion already arrived.
+   *
+   * @param transfer The incoming transfer.
+   * @param done Bytes of the chunk written before this request.
+   * @param result The bytes written, or a negated errno.
+   */
+  void HandleChunkWritten(const std::shared_ptr<IncomingFileTransfer> &transfer, size_t done, int result);
+
+  /**
+   * @brief Reports a finished incoming transfer and removes it.
+   *
+   * Caller holds incoming_transfer_mutex_.
+   *
+   * @param key The transfer's (sender ID, transfer ID).
+   */
+  void FinishIncomingTransferLocked(const std::pair<int, uint32_t> &key);
+
+  /**
+   * @brief Reads an outgoing chunk, or what is left of it, on file_loop_.
+   *
+   * Called without outgoing_transfer_mutex_, since a stopped loop completes
+   * the request at once.
+   *
+   * @param read The chunk being read.
+   */
+  void ReadChunkOnLoop(const std::shared_ptr<ChunkRead> &read);
+
+  /**
+   * @brief Handles the outcome of a read from ReadChunkOnLoop.
+   *
+   * Queues the chunk once it is whole and fills the windows again, which
+   * may start the next read.
+   *
+   * @param read The chunk being read.
+   * @param result The bytes read, or a negated errno.
+   */
+  void HandleChunkRead(const std::shared_ptr<ChunkRead> &read, int result);
+
+  /**
+   * @brief Starts the reads SendNextFileChunkLocked queued.
+   *
+   * @param lock The held lock on outgoing_transfer_mutex_, released before the reads start.
+   */
+  void StartChunkReads(std::unique_lock<std::mutex> &lock);
+
+  // State for outgoing file transfers (client sending a file)
+  struct OutgoingFileTransfer {
+    std::string file_path;
+    size_t total_size;
+    size_t sent_size;  // Bytes queued for sending
+    size_t acked_size; // Bytes the receiver confirmed
+    bool receiver_ready; // The receiver acked the request
+    bool complete_sent;
+    std::ifstream file_stream;                   // Used when chunks are copied
+    std::shared_ptr<SendFileSource> file_source; // Used when chunks are sent zero-copy or mapped
+    bool memory_mapped;                          // Chunks are slices of mapping instead of SendFile regions
+    bool ring_reads;                             // Chunks are copied by reads of file_source on file_loop_
+    bool read_in_flight;                         // A chunk read on file_loop_ has not completed yet
+    std::shared_ptr<const FileMapping> mapping;  // View of file_source the next mapped chunks come from
+    std::vector<uint32_t> chunk_checksums;       // CRC-32C of each chunk_size_ chunk, computed up front
+    int recipient_id;
+    uint32_t transfer_id;
+
+    OutgoingFileTransfer()
+        : total_size(0), sent_size(0), acked_size(0), receiver_ready(false), complete_sent(false),
+          memory_mapped(false), ring_reads(false), read_in_flight(false), recipient_id(-1), transfer_id(0) {}
+  };
+
+  // An outgoing chunk being read on file_loop_
+  struct ChunkRead {
+    std::shared_ptr<SendFileSource> file_source; // Also tells whether the transfer is still the same
+    uint32_t transfer_id;
+    uint64_t offset;  // Where the chunk starts in the file
+    size_t done;      // Bytes read so far
+    Message message;  // The chunk, its payload sized to the chunk
+  };
+
+  /**
+   * @brief Queues chunks for every ready transfer until all windows are full
+   * or all files are sent.
+   *
+   * Transfers take turns, one chunk each, starting after the transfer that
+   * was served last. The completion message is queued after a transfer's
+   * last chunk. Caller holds outgoing_transfer_mutex_.
+   */
+  void FillSendWindowsLocked();
+
+  /**
+   * @brief Sends the next file data chunk of a transfer by adding it to the send queue.
+   *
+   * Caller holds outgoing_transfer_mutex_. On failure an error is queued for
+   * the recipient and the transfer is removed, which invalidates it.
+   *
+   * @param transfer The outgoing transfer.
+   * @return True if a chunk was successfully added to the queue, false otherwise.
+   */
+  bool SendNextFileChunkLocked(OutgoingFileTransfer &transfer);
+
+  /**
+   * @brief Queues a file transfer error for the peer of a transfer.
+   * @param recipient_id The ID of the peer (-1 for the server).
+   * @param transfer_id The transfer the error is about.
+   * @param error_message The error description.
+   */
+  void SendFileTransferError(int recipient_id, uint32_t transfer_id, const std::string &error_message);
+
+  /**
+   * @brief Adds a message to the client's send queue.
+   * @param message The message, or file region, to add to the queue (moved in).
+   * @return True if the message was added to the queue, false otherwise.
+   */
+  bool AddMessageToSendQueue(OutgoingMessage message);
+
+  /**
+   * @brief Queues a cumulative FILE_TRANSFER_ACK for the sender of an incoming transfer.
+   * @param sender_id The ID of the client sending the file.
+   * @param transfer_id The sender's ID for the transfer.
+   * @param acked_bytes The number of bytes received and written so far.
+   */
+  void SendFileTransferAck(int sender_id, uint32_t transfer_id, size_t acked_bytes);
+
+  // Outgoing transfers by transfer ID
+  std::map<uint32_t, std::unique_ptr<OutgoingFileTransfer>> outgoing_transfers_;
+  uint32_t next_transfer_id_; // Next ID handed out, never 0
+  uint32_t next_fill_id_;     // Transfer whose turn it is in FillSendWindowsLocked
+  std::vector<std::shared_ptr<ChunkRead>> chunk_reads_; // Queued by SendNextFileChunkLocked for StartChunkReads
+  std::mutex outgoing_transfer_mutex_;
+
+  // State for incoming file transfers (client receiving a file)
+  struct IncomingFileTransfer {
+    std::string file_name;
+    size_t total_size;
+    size_t received_size;
+    std::ofstream file_stream; // Used unless chunks are written on file_loop_
+    std::string file_path; // Where the file is being written
+    int sender_id;
+    uint32_t transfer_id;
+
+    // Used when chunks are written on file_loop_
+    NativeFileHandle file;
+    bool file_open;
+    std::deque<PooledBuffer> pending_chunks; // Received while a write was in flight
+    PooledBuffer writing;                    // The chunk being written
+    size_t written_size;                     // Bytes on disk, which is what gets acked
+    bool write_in_flight;
+    bool complete_received; // The completion arrived before the writes drained
+
+    IncomingFileTransfer()
+        : total_size(0), received_size(0), sender_id(-1), transfer_id(0), file(), file_open(false), written_size(0),
+          write_in_flight(false), complete_received(false) {}
+    ~IncomingFileTransfer();
+  };
+  // Incoming transfers by (sender ID, sender's transfer ID); writes in flight share them
+  std::map<std::pair<int, uint32_t>, std::shared_ptr<IncomingFileTransfer>> incoming_transfers_;
+  std::mutex incoming_transfer_mutex_;
+
+  size_t chunk_size_;      /**< Payload bytes per outgoing chunk. */
+  size_t window_bytes_;    /**< Maximum unacknowledged bytes in flight per transfer. */
+  bool zero_copy_;         /**< Whether chunks reference the file instead of copying it. */
+  bool memory_mapped_;     /**< Whether files are scanned from, and chunks sliced out of, mapped views. */
+  size_t map_window_bytes_;/**< Length of those views, a multiple of chunk_size_. */
+  size_t max_transfers_;   /**< Maximum concurrent outgoing transfers. */
+
+  MpscQueue<OutgoingMessage> &send_queue_;
+  std::atomic<int> &client_id_;
+  std::atomic<int> &protocol_version_;
+
+  // Runs the ring reads and writes with IoBackend::IO_URING, null otherwise.
+  // Declared last and stopped first, so its callbacks see the state above.
+  std::unique_ptr<EventLoop> file_loop_;
+};
+
+#endif // CLIENT_FILE_TRANSFER_HANDLER_H_
@@ -3,7 +3,8 @@
 
 #include <string>
 
-#include "Message.h"
+#include "Message.h"
+#include "MessageView.h"
 
 // Forward declare Client to avoid circular dependency
 class Client;
@@ -40,9 +41,9 @@ public:
    * message is received. The handler should process the message based on its type
    * (request, data chunk, complete, error).
    *
-   * @param message The deserialized Message object.
+   * @param message View of the received message.
    */
-  virtual void HandleMessage(const Message &message) = 0;
+  virtual void HandleMessage(const MessageView &message) = 0;
 
   // Potentially add methods for getting transfer progress, cancelling, etc.
 };
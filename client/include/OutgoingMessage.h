@@ -0,0 +1,176 @@
+#ifndef OUTGOING_MESSAGE_H_
+#define OUTGOING_MESSAGE_H_
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <utility>
+
+#include "ISocket.h"
+#include "Message.h"
+
+/**
+ * @brief A read-only view of a region of a file, made by SendFileSource::Map.
+ *
+ * Queued file chunks that are slices of the view share ownership of it, so
+ * it is unmapped once the transfer has moved on to the next view and the
+ * last of these chunks has been written.
+ */
+class FileMapping {
+public:
+  /**
+   * @brief Takes ownership of a mapped view.
+   *
+   * @param base Start of the view, aligned as the system requires.
+   * @param map_size Length of the view.
+   * @param offset File offset of the first byte the view was made for (at or after base).
+   * @param size Number of bytes the view was made for, from offset.
+   */
+  FileMapping(void *base, size_t map_size, uint64_t offset, size_t size);
+
+  /**
+   * @brief Destroys the FileMapping. Unmaps the view.
+   */
+  ~FileMapping();
+
+  FileMapping(const FileMapping &) = delete;
+  FileMapping &operator=(const FileMapping &) = delete;
+
+  /**
+   * @brief Checks whether a region of the file lies within the view.
+   *
+   * @param offset File offset of the region.
+   * @param size Length of the region.
+   * @return True if every byte of the region is mapped.
+   */
+  bool Contains(uint64_t offset, size_t size) const;
+
+  /**
+   * @brief Gets the mapped bytes at a file offset.
+   *
+   * @param offset A file offset within the view.
+   * @return Pointer to the byte at offset.
+   */
+  const char *GetData(uint64_t offset) const;
+
+private:
+  void *base_;
+  size_t map_size_;
+  uint64_t offset_; /**< File offset of data_[0]. */
+  size_t size_;
+  const char *data_;
+};
+
+/**
+ * @brief A read-only file whose bytes can be sent straight to a socket.
+ *
+ * Wraps the native handle needed by ISocket::SendFile, and makes the views
+ * memory-mapped transfers slice their chunks from. Queued file chunks share
+ * ownership of it, so the file stays open until the last chunk has been
+ * written even if the transfer state is gone by then.
+ */
+class SendFileSource {
+public:
+  /**
+   * @brief Opens a file for reading.
+   * @param file_path The path of the file; check IsOpen afterwards.
+   */
+  explicit SendFileSource(const std::string &file_path);
+
+  /**
+   * @brief Destroys the SendFileSource. Closes the file.
+   */
+  ~SendFileSource();
+
+  SendFileSource(const SendFileSource &) = delete;
+  SendFileSource &operator=(const SendFileSource &) = delete;
+
+  /**
+   * @brief Checks whether the file was opened successfully.
+   * @return True if the file is open.
+   */
+  bool IsOpen() const;
+
+  /**
+   * @brief Gets the native handle of the open file.
+   * @return The native file handle.
+   */
+  NativeFileHandle GetNativeHandle() const;
+
+  /**
+   * @brief Maps a region of the file for reading, advising sequential access.
+   *
+   * The file must still be at least offset + size bytes long: reading a view
+   * past the end of a file truncated since is fatal on POSIX systems.
+   *
+   * @param offset File offset of the region.
+   * @param size Length of the region, not 0.
+   * @return The view, or null if the file is shorter or cannot be mapped.
+   */
+  std::shared_ptr<const FileMapping> Map(uint64_t offset, size_t size);
+
+private:
+  NativeFileHandle handle_;
+  bool open_;
+#ifdef _WIN32
+  NativeFileHandle mapping_; /**< File mapping object the views are made of, created by the first Map. */
+#endif
+};
+
+/**
+ * @brief An entry of the client's send queue.
+ *
+ * Usually just a Message. A file data chunk may instead leave the payload
+ * empty and reference a region of a SendFileSource: the send thread then
+ * writes the header followed by file_size bytes taken directly from the file
+ * with ISocket::SendFile, so the chunk never passes through a user-space
+ * buffer. Or it references a slice of a FileMapping, which the send thread
+ * gathers into its write like any other buffer, so the chunk is neither
+ * read nor copied before the socket (or TLS) takes it.
+ */
+struct OutgoingMessage {
+  Message message;                            /**< The message, or only its header for a file region. */
+  std::shared_ptr<SendFileSource> file;       /**< File supplying the payload, or null. */
+  std::shared_ptr<const FileMapping> mapping; /**< Mapped view holding the payload, or null. */
+  uint64_t file_offset;                       /**< Offset of the payload within file or mapping. */
+  size_t file_size;                           /**< Payload bytes taken from file or mapping. */
+
+  /**
+   * @brief Default constructor: an empty message.
+   */
+  OutgoingMessage() : file_offset(0), file_size(0) {}
+
+  /**
+   * @brief Wraps a complete message. Implicit, so Messages can be queued directly.
+   * @param msg The message to send (moved in).
+   */
+  OutgoingMessage(Message msg) : message(std::move(msg)), file_offset(0), file_size(0) {}
+
+  /**
+   * @brief Creates a message whose payload is a region of a file.
+   * @param header The message header; payload_size is set to size.
+   * @param source The file supplying the payload.
+   * @param offset Offset of the payload within the file.
+   * @param size Number of payload bytes.
+   */
+  OutgoingMessage(const MessageHeader &header, std::shared_ptr<SendFileSource> source, uint64_t offset, size_t size)
+      : file(std::move(source)), file_offset(offset), file_size(size) {
+    message.header = header;
+    message.header.payload_size = size;
+  }
+
+  /**
+   * @brief Creates a message whose payload is a slice of a mapped file.
+   * @param header The message header; payload_size is set to size.
+   * @param view The view holding the payload.
+   * @param offset File offset of the payload, within the view.
+   * @param size Number of payload bytes.
+   */
+  OutgoingMessage(const MessageHeader &header, std::shared_ptr<const FileMapping> view, uint64_t offset, size_t size)
+      : mapping(std::move(view)), file_offset(offset), file_size(size) {
+    message.header = header;
+    message.header.payload_size = size;
+  }
+};
+
+#endif // OUTGOING_MESSAGE_H_
@@ -0,0 +1,50 @@
+#ifndef SEND_QUEUE_H_
+#define SEND_QUEUE_H_
+
+#include <cstddef>
+
+#include "OutgoingMessage.h"
+#include "PriorityScheduler.h"
+
+/**
+ * @brief The client's queue of messages waiting for the send thread.
+ *
+ * Schedules by the MessagePriority of each message header, so a chat line or
+ * a transfer ack typed or produced while file chunks are queued goes out
+ * next instead of behind them, and concurrent transfers share the
+ * connection fairly. Not thread-safe; the client guards it with its send
+ * queue mutex.
+ */
+class SendQueue {
+public:
+  /**
+   * @brief Constructs an empty queue.
+   * @param bulk_quantum Bytes a file transfer may send per round robin turn.
+   */
+  explicit SendQueue(size_t bulk_quantum = PriorityScheduler<OutgoingMessage>::kDefaultBulkQuantum);
+
+  /**
+   * @brief Queues a message according to its priority class.
+   * @param message The message (moved in).
+   */
+  void Push(OutgoingMessage message);
+
+  /**
+   * @brief Removes the message that should be sent next.
+   *
+   * @param message Receives the message.
+   * @return False if the queue is empty.
+   */
+  bool Pop(OutgoingMessage &message);
+
+  /**
+   * @brief Checks whether any messages are queued.
+   * @return True if the queue is empty.
+   */
+  bool Empty() const;
+
+private:
+  PriorityScheduler<OutgoingMessage> scheduler_;
+};
+
+#endif // SEND_QUEUE_H_
@@ -1,26 +1,38 @@
 #include "Client.h"
 
+#include <algorithm>
 #include <filesystem>
 #include <iostream>
 #include <limits>
 #include <sstream>
 #include <string>
+#include <utility>
 #include <vector>
 
+#include "CompressionCodecs.h"
+#include "SendQueue.h"
+
 #ifdef _WIN32
 #include "WinsockSocket.h"
 #else
 #include "PosixSocket.h"
 #endif
 
-#include "ClientFileTransferHandler.h"
+#ifdef CHAT_HAVE_OPENSSL
+#include "TlsSocket.h"
+#endif
 
 /**
  * @brief Constructs a new Client object.
  * @param server_address The IP address or hostname of the server.
  * @param server_port The port number of the server.
+ * @param file_transfer_options Chunk size and window settings for outgoing file transfers.
+ * @param compression_codecs Codecs the client is willing to compress with, most preferred first.
+ * @param connection_options Socket options, send coalescing and TLS settings.
  */
-Client::Client(const std::string &server_address, int server_port)
+Client::Client(const std::string &server_address, int server_port, const FileTransferOptions &file_transfer_options,
+               const std::vector<CompressionCodecId> &compression_codecs,
+               const ConnectionOptions &connection_options)
     : server_address_(server_address), server_port_(server_port),
 // Instantiate the correct socket type based on the platform
 #ifdef _WIN32
@@ -28,11 +40,13 @@ Client::Client(const std::string &server_address, int server_port)
 #else
       server_socket_(std::make_unique<PosixSocket>()),
 #endif
-      sending_(false), receiving_(false), client_id_(-1) // Initialize client ID to -1
+      sending_(false), receiving_(false), client_id_(-1), // Initialize client ID to -1
+      protocol_version_(kProtocolVersionLegacy), compression_codecs_(compression_codecs),
+      compression_codec_(CompressionCodecId::NONE), connection_options_(connection_options)
 {
-  // Create the file transfer handler and inject dependencies (references to queue, mutex, CV, ID)
+  // Create the file transfer handler and inject dependencies (references to queue, ID, version)
   file_transfer_handler_ =
-      std::make_unique<ClientFileTransferHandler>(send_queue_, send_queue_mutex_, send_queue_cv_, client_id_);
+      std::make_unique<ClientFileTransferHandler>(send_queue_, client_id_, protocol_version_, file_transfer_options);
 }
 
 /**
@@ -47,6 +61,17 @@ Client::~Client() {
  * @return True if connection is successful, false otherwise.
  */
 bool Client::Connect() {
+  // Buffer sizes only shape the TCP window if they are set before the handshake
+  if (!server_socket_->ApplyOptions(connection_options_.socket)) {
+    std::cerr << "Some socket options could not be applied." << std::endl;
+  }
+#ifdef CHAT_HAVE_OPENSSL
+  if (connection_options_.tls) {
+    // Connect also performs the handshake, resuming an earlier session if the context has one
+    server_socket_ = std::make_unique<TlsSocket>(std::move(server_socket_), connection_options_.tls);
+  }
+#endif
+
   if (server_socket_->Connect(server_address_, server_port_)) {
     std::cout << "Connected to server at " << server_address_ << ":" << server_port_ << std::endl;
     // Start the send and receive threads after successful connection
@@ -90,11 +115,7 @@ bool Client::SendChatMessage(const std::string &message) {
   chat_msg.header.payload_size = chat_msg.payload.size();
 
   // Add the message to the send queue
-  {
-    std::lock_guard<std::mutex> lock(send_queue_mutex_);
-    send_queue_.push(chat_msg);
-  }
-  send_queue_cv_.notify_one(); // Notify the send thread
+  send_queue_.Push(std::move(chat_msg));
 
   return true;
 }
@@ -117,6 +138,92 @@ bool Client::RequestFileTransfer(int recipient_id, const std::string &file_path)
   return file_transfer_handler_->RequestFileTransfer(recipient_id, file_path);
 }
 
+/**
+ * @brief Asks the server to add the client to a room.
+ * @param room_name The room name, see IsValidRoomName.
+ * @return True if the request was queued, false otherwise.
+ */
+bool Client::JoinRoom(const std::string &room_name) {
+  if (!IsValidRoomName(room_name)) {
+    std::cerr << "Invalid room name: " << room_name << std::endl;
+    return false;
+  }
+  return QueueMessage(MessageType::ROOM_JOIN, -1, room_name);
+}
+
+/**
+ * @brief Asks the server to remove the client from a joined room.
+ * @param room_name The room name.
+ * @return True if the request was queued, false if the room is not joined.
+ */
+bool Client::LeaveRoom(const std::string &room_name) {
+  int room_id = FindRoomId(room_name);
+  if (room_id < 0) {
+    std::cerr << "Not in room " << room_name << "." << std::endl;
+    return false;
+  }
+  return QueueMessage(MessageType::ROOM_LEAVE, room_id, std::string());
+}
+
+/**
+ * @brief Sends a chat message to the members of a joined room.
+ * @param room_name The room name.
+ * @param message The message string to send.
+ * @return True if the message was queued, false if the room is not joined.
+ */
+bool Client::SendRoomMessage(const std::string &room_name, const std::string &message) {
+  int room_id = FindRoomId(room_name);
+  if (room_id < 0) {
+    std::cerr << "Not in room " << room_name << ". Join it with /join " << room_name << "." << std::endl;
+    return false;
+  }
+  return QueueMessage(MessageType::ROOM_MESSAGE, room_id, message);
+}
+
+/**
+ * @brief Sends a chat message to a single client.
+ * @param recipient_id The recipient's client ID.
+ * @param message The message string to send.
+ * @return True if the message was queued, false otherwise.
+ */
+bool Client::SendPrivateMessage(int recipient_id, const std::string &message) {
+  return QueueMessage(MessageType::PRIVATE_MESSAGE, recipient_id, message);
+}
+
+/**
+ * @brief Queues a room request, room message or private message for the send thread.
+ * @param type The message type.
+ * @param recipient_id The room or client ID (-1 for a room join).
+ * @param payload The payload.
+ * @return True if the message was queued, false if not connected.
+ */
+bool Client::QueueMessage(MessageType type, int recipient_id, const std::string &payload) {
+  if (!server_socket_ || !server_socket_->IsValid() || client_id_.load() == -1) {
+    std::cerr << "Error: Not connected to server or client ID not assigned." << std::endl;
+    return false;
+  }
+
+  Message msg;
+  msg.header.type = type;
+  msg.header.sender_id = client_id_.load();
+  msg.header.recipient_id = recipient_id;
+  msg.payload.assign(payload.begin(), payload.end());
+  msg.header.payload_size = msg.payload.size();
+  send_queue_.Push(std::move(msg));
+  return true;
+}
+
+/**
+ * @brief Gets the ID of a joined room.
+ * @param room_name The room name.
+ * @return The room ID, or -1 if the room is not joined.
+ */
+int Client::FindRoomId(const std::string &room_name) const {
+  std::lock_guard<std::mutex> lock(rooms_mutex_);
+  auto it = joined_rooms_.find(room_name);
+  return it != joined_rooms_.end() ? it->second : -1;
+}
+
 /**
  * @brief Starts the thread for sending messages to the server.
  */
@@ -133,7 +240,7 @@ void Client::StartSendThread() {
 void Client::StopSendThread() {
   if (sending_.load()) {
     sending_.store(false);
-    send_queue_cv_.notify_one(); // Notify the send thread to wake up and exit
+    send_queue_.Wakeup(); // Wake the send thread so it sees the flag and exits
     if (send_thread_.joinable()) {
       send_thread_.join();
     }
@@ -156,9 +263,10 @@ void Client::StartReceiveThread() {
 void Client::StopReceiveThread() {
   if (receiving_.load()) {
     receiving_.store(false);
-    // Close the socket to unblock the Receive call in the thread
+    // Shut the socket down to unblock the Receive call in the thread; closing
+    // it from here would not wake a thread blocked in recv
     if (server_socket_ && server_socket_->IsValid()) {
-      server_socket_->Close();
+      server_socket_->Shutdown();
     }
     if (receive_thread_.joinable()) {
       receive_thread_.join();
@@ -182,41 +290,41 @@ int Client::GetClientId() const {
 void Client::SendMessages() {
   std::cout << "Send thread started." << std::endl;
 
+  SendQueue scheduled; // Owned by this thread, so scheduling needs no lock
+  std::queue<OutgoingMessage> batch;
   while (sending_.load() && server_socket_ && server_socket_->IsValid()) {
-    Message message_to_send;
-    bool has_message = false;
-
-    // Wait for a message in the queue or for the thread to stop
-    {
-      std::unique_lock<std::mutex> lock(send_queue_mutex_);
-      // Wait for a message or for the sending flag to become false
-      send_queue_cv_.wait(lock, [&] { return !send_queue_.empty() || !sending_.load(); });
-
-      if (!sending_.load()) {
-        break; // Exit the loop if the thread is stopping
-      }
-
-      if (!send_queue_.empty()) {
-        message_to_send = send_queue_.front();
-        send_queue_.pop();
-        has_message = true;
-      }
+    if (scheduled.Empty()) {
+      // Wait for a message or for StopSendThread
+      send_queue_.Wait();
+    }
+    if (!sending_.load()) {
+      break; // Exit the loop if the thread is stopping
     }
 
-    if (has_message) {
-      // Send the message
-      if (!SendMessage(message_to_send)) {
-        std::cerr << "Failed to send message of type " << static_cast<int>(message_to_send.header.type) << std::endl;
-        // In a real application, you might want to retry sending or handle the error.
+    // Everything queued since the last batch competes for the next one
+    send_queue_.PopAll([&](OutgoingMessage &&message) { scheduled.Push(std::move(message)); });
+
+    // Take messages in priority order, but no more than one coalesced
+    // write's worth, so anything urgent queued meanwhile waits at most that
+    size_t batch_bytes = 0;
+    OutgoingMessage message;
+    while (batch_bytes < connection_options_.max_coalesced_bytes && scheduled.Pop(message)) {
+      batch_bytes += kMaxWireHeaderSize + message.message.header.payload_size;
+      batch.push(std::move(message));
+      if (!connection_options_.coalesce_sends) {
+        break;
       }
     }
-  }
 
-  // Ensure socket is closed when the thread exits
-  if (server_socket_ && server_socket_->IsValid()) {
-    server_socket_->Close();
+    size_t message_count = batch.size();
+    if (message_count > 0 && !SendBatch(batch)) {
+      std::cerr << "Failed to send " << message_count << " queued message(s)." << std::endl;
+      // In a real application, you might want to retry sending or handle the error.
+      std::queue<OutgoingMessage>().swap(batch);
+    }
   }
 
+  // The socket is closed by Disconnect once the receive thread has exited too
   std::cout << "Send thread stopped." << std::endl;
 }
 
@@ -229,40 +337,23 @@ void Client::SendMessages() {
 void Client::ReceiveMessages() {
   std::cout << "Receive thread started." << std::endl;
 
-  std::vector<char> buffer(1024); // Temporary buffer for receiving data
-
   while (receiving_.load() && server_socket_ && server_socket_->IsValid()) {
-    int bytes_received = server_socket_->Receive(buffer.data(), buffer.size());
+    // Receive straight into the framer's buffer
+    size_t capacity = 0;
+    char *read_buffer = framer_.PrepareRead(capacity);
+    int bytes_received = server_socket_->Receive(read_buffer, capacity);
 
     if (bytes_received > 0) {
-      receive_buffer_.insert(receive_buffer_.end(), buffer.begin(), buffer.begin() + bytes_received);
-
-      // Process messages from the receive buffer
-      while (receive_buffer_.size() >= kMessageHeaderSize) {
-        // Peek at the header to get the payload size
-        MessageHeader header;
-        std::memcpy(&header, receive_buffer_.data(), kMessageHeaderSize);
-
-        size_t total_message_size = kMessageHeaderSize + header.payload_size;
-
-        if (receive_buffer_.size() >= total_message_size) {
-          // We have a complete message
-          std::vector<char> complete_message_data(receive_buffer_.begin(),
-                                                  receive_buffer_.begin() + total_message_size);
-
-          // Deserialize the message
-          Message received_message = DeserializeMessage(complete_message_data);
-
-          // Remove the processed message from the buffer
-          receive_buffer_.erase(receive_buffer_.begin(), receive_buffer_.begin() + total_message_size);
-
-          // Process the received message
-          ProcessReceivedMessage(received_message);
+      framer_.CommitRead(static_cast<size_t>(bytes_received));
 
-        } else {
-          // Not enough data for a complete message yet, wait for more
-          break;
-        }
+      // Process every complete message in place
+      MessageView received_message;
+      while (framer_.Next(received_message)) {
+        ProcessReceivedMessage(received_message);
+      }
+      if (framer_.HasError()) {
+        std::cerr << "Protocol error: invalid message header from server. Disconnecting." << std::endl;
+        receiving_.store(false);
       }
     } else if (bytes_received == 0) {
       // Connection closed by server
@@ -303,14 +394,15 @@ void Client::ReceiveMessages() {
  *
  * Delegates handling of specific message types to appropriate handlers.
  *
- * @param message The deserialized Message object.
+ * @param message View of the received message.
  */
-void Client::ProcessReceivedMessage(const Message &message) {
+void Client::ProcessReceivedMessage(const MessageView &message) {
   // Check if the message is for file transfer and delegate if it is
   if (message.header.type == MessageType::FILE_TRANSFER_REQUEST ||
       message.header.type == MessageType::FILE_DATA_CHUNK ||
       message.header.type == MessageType::FILE_TRANSFER_COMPLETE ||
-      message.header.type == MessageType::FILE_TRANSFER_ERROR) {
+      message.header.type == MessageType::FILE_TRANSFER_ERROR ||
+      message.header.type == MessageType::FILE_TRANSFER_ACK) {
 
     if (file_transfer_handler_) {
       file_transfer_handler_->HandleMessage(message);
@@ -323,13 +415,41 @@ void Client::ProcessReceivedMessage(const Message &message) {
   switch (message.header.type) {
   case MessageType::CLIENT_ID_ASSIGNMENT: { // Handle client ID assignment
     if (!message.payload.empty()) {
-      std::string id_str(message.payload.begin(), message.payload.end());
-      try {
-        int assigned_id = std::stoi(id_str);
+      int assigned_id = -1;
+      int server_version = kProtocolVersionLegacy;
+      std::vector<CompressionCodecId> offered_codecs;
+      if (ParseClientIdAssignment(message.payload, assigned_id, server_version, offered_codecs)) {
+        // Talk the newest protocol both sides understand from now on
+        protocol_version_.store(std::min(server_version, kProtocolVersionLatest));
         client_id_.store(assigned_id);
         std::cout << "Assigned Client ID: " << assigned_id << std::endl;
-      } catch (const std::exception &e) {
-        std::cerr << "Error processing client ID assignment message: " << e.what() << std::endl;
+
+        if (protocol_version_.load() >= kProtocolVersionCompact) {
+          // Only the compact format can flag compressed payloads
+          std::vector<CompressionCodecId> chosen_codec;
+          for (CompressionCodecId codec : compression_codecs_) {
+            if (std::find(offered_codecs.begin(), offered_codecs.end(), codec) != offered_codecs.end()) {
+              chosen_codec.push_back(codec);
+              compression_codec_.store(codec);
+              std::cout << "Compressing messages with " << FindCompressionCodec(codec)->GetName() << "." << std::endl;
+              break;
+            }
+          }
+
+          // Echo the assignment in the new format, so the server relays
+          // compact-only fields (such as transfer IDs) to us before we have
+          // sent anything else. It also tells the server our codec.
+          std::string echo_payload = FormatClientIdAssignment(assigned_id, protocol_version_.load(), chosen_codec);
+          Message echo_msg;
+          echo_msg.header.type = MessageType::CLIENT_ID_ASSIGNMENT;
+          echo_msg.header.sender_id = assigned_id;
+          echo_msg.header.recipient_id = -1;
+          echo_msg.payload.assign(echo_payload.begin(), echo_payload.end());
+          echo_msg.header.payload_size = echo_msg.payload.size();
+          send_queue_.Push(std::move(echo_msg));
+        }
+      } else {
+        std::cerr << "Error processing client ID assignment message." << std::endl;
       }
     } else {
       std::cerr << "Received empty payload for client ID assignment." << std::endl;
@@ -342,10 +462,56 @@ void Client::ProcessReceivedMessage(const Message &message) {
     std::cout << chat_message << std::endl;
     break;
   }
+  case MessageType::ROOM_JOIN: {
+    std::string room_name(message.payload.begin(), message.payload.end());
+    if (message.header.recipient_id < 0) {
+      std::cerr << "Could not join room " << room_name << "." << std::endl;
+    } else {
+      std::lock_guard<std::mutex> lock(rooms_mutex_);
+      joined_rooms_[room_name] = message.header.recipient_id;
+      std::cout << "Joined room " << room_name << "." << std::endl;
+    }
+    break;
+  }
+  case MessageType::ROOM_LEAVE: {
+    std::string room_name(message.payload.begin(), message.payload.end());
+    std::lock_guard<std::mutex> lock(rooms_mutex_);
+    joined_rooms_.erase(room_name);
+    std::cout << "Left room " << room_name << "." << std::endl;
+    break;
+  }
+  case MessageType::ROOM_MESSAGE: {
+    std::string room_name;
+    {
+      std::lock_guard<std::mutex> lock(rooms_mutex_);
+      for (const auto &room : joined_rooms_) {
+        if (room.second == message.header.recipient_id) {
+          room_name = room.first;
+          break;
+        }
+      }
+    }
+    std::string room_message(message.payload.begin(), message.payload.end());
+    std::cout << "[" << room_name << "] " << room_message << std::endl;
+    break;
+  }
+  case MessageType::HEARTBEAT: {
+    // Answer the server's keep-alive probe so it does not time us out
+    Message heartbeat;
+    heartbeat.header.type = MessageType::HEARTBEAT;
+    heartbeat.header.sender_id = client_id_.load();
+    heartbeat.header.recipient_id = -1;
+    send_queue_.Push(std::move(heartbeat));
+    break;
+  }
   case MessageType::PRIVATE_MESSAGE: {
-    // Not implemented yet, but would handle private messages here
     std::string private_msg_content(message.payload.begin(), message.payload.end());
-    std::cout << "Private message from Client " << message.header.sender_id << ": " << private_msg_content << std::endl;
+    if (message.header.sender_id == -1) {
+      std::cout << "Server: " << private_msg_content << std::endl; // E.g. the recipient was not connected
+    } else {
+      std::cout << "Private message from Client " << message.header.sender_id << ": " << private_msg_content
+                << std::endl;
+    }
     break;
   }
   default:
@@ -356,29 +522,118 @@ void Client::ProcessReceivedMessage(const Message &message) {
 }
 
 /**
- * @brief Sends a Message object to the server.
- * @param message The Message object to send.
- * @return True if the message was sent successfully, false otherwise.
+ * @brief Sends a batch of queued messages to the server.
+ *
+ * @param batch The messages to send, in order; emptied by the call.
+ * @return True if everything was sent, false if the connection failed.
  */
-bool Client::SendMessage(const Message &message) {
+bool Client::SendBatch(std::queue<OutgoingMessage> &batch) {
   if (!server_socket_ || !server_socket_->IsValid()) {
     std::cerr << "Error: Not connected to server." << std::endl;
     return false;
   }
 
-  // Serialize the message into a byte vector
-  std::vector<char> data_to_send = SerializeMessage(message);
+  int protocol_version = protocol_version_.load();
+  CompressionCodecId codec = compression_codec_.load();
+  std::vector<PooledBuffer> frames;
+  std::vector<std::shared_ptr<const FileMapping>> views; // Keep gathered mapped payloads mapped until written
+  std::vector<IoBuffer> buffers;
+  size_t gathered_bytes = 0;
+  bool corked = false;
+  bool sent = true;
+
+  while (sent && !batch.empty()) {
+    OutgoingMessage message = std::move(batch.front());
+    batch.pop();
+
+    if (message.file || message.mapping) {
+      if (message.file && !corked) {
+        // Keep the kernel from sending the header on its own
+        corked = server_socket_->SetOption(SocketOption::CORK, 1);
+      }
+      // The header joins the gathered write; the payload comes from the file
+      PooledBuffer header(kMaxWireHeaderSize);
+      header.resize(EncodeMessageHeader(message.message.header, protocol_version, header.data()));
+      frames.push_back(std::move(header));
+    } else {
+      frames.push_back(SerializeMessage(message.message, protocol_version, codec));
+    }
+    // Moving a frame into the vector keeps its storage, so the pointer stays valid
+    buffers.push_back({frames.back().data(), frames.back().size()});
+    gathered_bytes += frames.back().size();
+    if (message.mapping) {
+      buffers.push_back({message.mapping->GetData(message.file_offset), message.file_size});
+      gathered_bytes += message.file_size;
+      views.push_back(std::move(message.mapping));
+    }
+
+    if (message.file || gathered_bytes >= connection_options_.max_coalesced_bytes || batch.empty()) {
+      sent = SendBuffers(buffers);
+      buffers.clear();
+      frames.clear();
+      views.clear();
+      gathered_bytes = 0;
+    }
+    if (sent && message.file) {
+      sent = SendFileData(message);
+    }
+  }
 
-  // Send the serialized data. In a real application, you would handle partial sends.
-  int bytes_sent = server_socket_->Send(data_to_send.data(), data_to_send.size());
+  if (corked) {
+    server_socket_->SetOption(SocketOption::CORK, 0); // Flush the last partial segment
+  }
+  return sent;
+}
 
-  if (bytes_sent < 0) {
-    std::cerr << "Error sending message." << std::endl;
-    // Disconnect() is called by the receive thread on socket error
-    return false;
+/**
+ * @brief Writes buffers completely, continuing after partial writes.
+ * @param buffers The buffers to send; modified as bytes are consumed.
+ * @return True if all bytes were sent, false otherwise.
+ */
+bool Client::SendBuffers(std::vector<IoBuffer> &buffers) {
+  size_t index = 0;
+  while (index < buffers.size()) {
+    int bytes_sent = server_socket_->SendV(buffers.data() + index, buffers.size() - index);
+    if (bytes_sent <= 0) {
+      std::cerr << "Error sending message." << std::endl;
+      // Disconnect() is called by the receive thread on socket error
+      return false;
+    }
+
+    // Skip the buffers that went out completely and trim a partial one
+    size_t remaining = static_cast<size_t>(bytes_sent);
+    while (index < buffers.size() && remaining >= buffers[index].size) {
+      remaining -= buffers[index].size;
+      ++index;
+    }
+    if (remaining > 0) {
+      buffers[index].data = static_cast<const char *>(buffers[index].data) + remaining;
+      buffers[index].size -= remaining;
+    }
+  }
+  return true;
+}
+
+/**
+ * @brief Sends the payload of a file region with ISocket::SendFile.
+ *
+ * @param message The queued file region.
+ * @return True if the whole payload was sent, false otherwise.
+ */
+bool Client::SendFileData(const OutgoingMessage &message) {
+  size_t total_sent = 0;
+  while (total_sent < message.file_size) {
+    int bytes_sent = server_socket_->SendFile(message.file->GetNativeHandle(), message.file_offset + total_sent,
+                                              message.file_size - total_sent);
+    if (bytes_sent <= 0) {
+      // The header promised file_size bytes; without them the stream cannot be framed any more
+      std::cerr << (bytes_sent == 0 ? "File ended early" : "Error sending file data")
+                << " during transfer. Disconnecting." << std::endl;
+      server_socket_->Shutdown();
+      return false;
+    }
+    total_sent += static_cast<size_t>(bytes_sent);
   }
-  // Note: bytes_sent could be less than the data_to_send size in case of partial
-  // sends. For simplicity, we assume full send or error for now.
 
   return true;
 }
@@ -1,493 +1,1052 @@
-#include "ClientFileTransferHandler.h"
-
-#include <filesystem> // For file size (C++17)
-#include <iostream>
-#include <limits>  // For numeric_limits
-#include <sstream> // For stringstream
-#include <string>  // For std::string
-#include <vector>
-
-
-// Define a directory to store incoming files on the client side
-const std::string kClientIncomingFilesDir = "client_incoming_files";
-
-/**
- * @brief Constructs a new ClientFileTransferHandler.
- * @param send_queue A reference to the client's message send queue.
- * @param send_queue_mutex A reference to the mutex protecting the send queue.
- * @param send_queue_cv A reference to the condition variable for the send queue.
- * @param client_id A reference to the client's atomic ID.
- */
-ClientFileTransferHandler::ClientFileTransferHandler(std::queue<Message> &send_queue, std::mutex &send_queue_mutex,
-                                                     std::condition_variable &send_queue_cv,
-                                                     std::atomic<int> &client_id)
-    : send_queue_(send_queue), send_queue_mutex_(send_queue_mutex), send_queue_cv_(send_queue_cv),
-      client_id_(client_id) {}
-
-/**
- * @brief Destroys the ClientFileTransferHandler. Closes any open file streams.
- */
-ClientFileTransferHandler::~ClientFileTransferHandler() {
-  // Close any open file streams for ongoing transfers
-  std::lock_guard<std::mutex> outgoing_lock(outgoing_transfer_mutex_);
-  if (outgoing_transfer_ && outgoing_transfer_->file_stream.is_open()) {
-    outgoing_transfer_->file_stream.close();
-  }
-
-  std::lock_guard<std::mutex> incoming_lock(incoming_transfer_mutex_);
-  if (incoming_transfer_ && incoming_transfer_->file_stream.is_open()) {
-    incoming_transfer_->file_stream.close();
-  }
-}
-
-/**
- * @brief Initiates a file transfer request to a recipient.
- *
- * This method is called by the Client when the user requests a file transfer.
- * It prepares the file transfer request message and adds it to the send queue.
- *
- * @param recipient_id The ID of the client to send the file to.
- * @param file_path The path to the file to send.
- * @return True if the request was successfully initiated, false otherwise.
- */
-bool ClientFileTransferHandler::RequestFileTransfer(int recipient_id, const std::string &file_path) {
-  if (client_id_.load() == -1) {
-    std::cerr << "Error: Client ID not assigned. Cannot initiate file transfer." << std::endl;
-    return false;
-  }
-
-  // Check if an outgoing transfer is already in progress
-  {
-    std::lock_guard<std::mutex> lock(outgoing_transfer_mutex_);
-    if (outgoing_transfer_) {
-      std::cerr << "Error: An outgoing file transfer is already in progress." << std::endl;
-      return false;
-    }
-  }
-
-  // Check if the file exists and get its size
-  std::filesystem::path file_system_path(file_path);
-  if (!std::filesystem::exists(file_system_path)) {
-    std::cerr << "Error: File not found: " << file_path << std::endl;
-    return false;
-  }
-  if (!std::filesystem::is_regular_file(file_system_path)) {
-    std::cerr << "Error: Path is not a regular file: " << file_path << std::endl;
-    return false;
-  }
-
-  size_t file_size = std::filesystem::file_size(file_system_path);
-  std::string file_name = file_system_path.filename().string();
-
-  // Prepare the file transfer request message payload: "recipient_id:file_name:file_size"
-  std::stringstream payload_stream;
-  payload_stream << recipient_id << ":" << file_name << ":" << file_size;
-  std::string payload_str = payload_stream.str();
-
-  Message request_msg;
-  request_msg.header.type = MessageType::FILE_TRANSFER_REQUEST;
-  request_msg.header.sender_id = client_id_.load();
-  request_msg.header.recipient_id = recipient_id; // The intended recipient
-  request_msg.payload.assign(payload_str.begin(), payload_str.end());
-  request_msg.header.payload_size = request_msg.payload.size();
-
-  // Add the request message to the send queue
-  if (AddMessageToSendQueue(request_msg)) {
-    std::cout << "Sent file transfer request for '" << file_name << "' to client " << recipient_id << std::endl;
-
-    // Store the state for the outgoing transfer (will be fully set up on READY signal)
-    {
-      std::lock_guard<std::mutex> lock(outgoing_transfer_mutex_);
-      outgoing_transfer_ = std::make_unique<OutgoingFileTransfer>();
-      outgoing_transfer_->file_path = file_path;
-      outgoing_transfer_->total_size = file_size;
-      outgoing_transfer_->recipient_id = recipient_id;
-      // File stream will be opened when the server sends the READY signal
-    }
-    return true;
-  } else {
-    std::cerr << "Failed to add file transfer request to send queue." << std::endl;
-    return false;
-  }
-}
-
-/**
- * @brief Handles an incoming message related to file transfer.
- *
- * This method is called by the Client's receive logic when a file-transfer-related
- * message is received. It processes the message based on its type
- * (request, data chunk, complete, error).
- *
- * @param message The deserialized Message object.
- */
-void ClientFileTransferHandler::HandleMessage(const Message &message) {
-  // Ensure the message is actually for this client (either recipient or sender of error)
-  // or a server-sent message (sender_id -1)
-  if (message.header.recipient_id != client_id_.load() && message.header.recipient_id != -1 &&
-      message.header.sender_id != -1) {
-    // Message is not for this client, ignore
-    return;
-  }
-
-  switch (message.header.type) {
-  case MessageType::FILE_TRANSFER_REQUEST:
-    HandleFileTransferRequest(message);
-    break;
-  case MessageType::FILE_DATA_CHUNK:
-    HandleFileDataChunk(message);
-    break;
-  case MessageType::FILE_TRANSFER_COMPLETE:
-    HandleFileTransferComplete(message);
-    break;
-  case MessageType::FILE_TRANSFER_ERROR:
-    HandleFileTransferError(message);
-    break;
-  default:
-    // Not a file transfer message type handled by this handler
-    // The Client::ProcessReceivedMessage will handle other types
-    break;
-  }
-}
-
-/**
- * @brief Sends the next file data chunk by adding it to the send queue.
- *
- * Called internally when the outgoing transfer is ready.
- * @return True if a chunk was successfully added to the queue, false otherwise.
- */
-bool ClientFileTransferHandler::SendNextFileChunkToQueue() {
-  std::lock_guard<std::mutex> lock(outgoing_transfer_mutex_);
-  if (outgoing_transfer_ && outgoing_transfer_->file_stream.is_open() &&
-      outgoing_transfer_->sent_size < outgoing_transfer_->total_size) {
-
-    std::vector<char> chunk_data(kFileChunkSize);
-    size_t bytes_to_read = std::min(kFileChunkSize, outgoing_transfer_->total_size - outgoing_transfer_->sent_size);
-
-    outgoing_transfer_->file_stream.read(chunk_data.data(), bytes_to_read);
-    size_t bytes_read = outgoing_transfer_->file_stream.gcount();
-
-    if (bytes_read > 0) {
-      Message chunk_msg;
-      chunk_msg.header.type = MessageType::FILE_DATA_CHUNK;
-      chunk_msg.header.sender_id = client_id_.load();
-      chunk_msg.header.recipient_id = outgoing_transfer_->recipient_id;
-      chunk_msg.payload.assign(chunk_data.begin(), chunk_data.begin() + bytes_read);
-      chunk_msg.header.payload_size = chunk_msg.payload.size();
-
-      // Add the data chunk message to the send queue
-      if (AddMessageToSendQueue(chunk_msg)) {
-        outgoing_transfer_->sent_size += bytes_read;
-        // std::cout << "Queued chunk: " << outgoing_transfer_->sent_size << "/"
-        //           << outgoing_transfer_->total_size << std::endl;
-
-        if (outgoing_transfer_->sent_size == outgoing_transfer_->total_size) {
-          // File transfer complete
-          std::cout << "File transfer complete for '" << outgoing_transfer_->file_path << "'" << std::endl;
-
-          Message complete_msg;
-          complete_msg.header.type = MessageType::FILE_TRANSFER_COMPLETE;
-          complete_msg.header.sender_id = client_id_.load();
-          complete_msg.header.recipient_id = outgoing_transfer_->recipient_id;
-          complete_msg.header.payload_size = 0; // No payload for completion message
-
-          // Add the completion message to the queue to be sent
-          AddMessageToSendQueue(complete_msg);
-
-          // Clean up outgoing transfer state
-          outgoing_transfer_->file_stream.close();
-          outgoing_transfer_.reset();
-        }
-        return true; // A chunk was successfully queued
-      } else {
-        std::cerr << "Failed to add file data chunk to send queue." << std::endl;
-        // Handle send error during file transfer (e.g., send error message)
-        Message error_msg;
-        error_msg.header.type = MessageType::FILE_TRANSFER_ERROR;
-        error_msg.header.sender_id = client_id_.load();
-        error_msg.header.recipient_id = outgoing_transfer_->recipient_id;      // Error related to this recipient
-        std::string error_payload = "Client failed to queue file data chunk."; // Declare string variable
-        error_msg.payload.assign(error_payload.begin(), error_payload.end());
-        error_msg.header.payload_size = error_msg.payload.size();
-        AddMessageToSendQueue(error_msg);
-
-        outgoing_transfer_->file_stream.close();
-        outgoing_transfer_.reset(); // Clean up state
-        return false;               // Failed to queue chunk
-      }
-    } else if (outgoing_transfer_->file_stream.eof()) {
-      // Reached end of file unexpectedly (should be caught by sent_size == total_size)
-      std::cerr << "Unexpected end of file while reading for transfer." << std::endl;
-      // Handle error
-      Message error_msg;
-      error_msg.header.type = MessageType::FILE_TRANSFER_ERROR;
-      error_msg.header.sender_id = client_id_.load();
-      error_msg.header.recipient_id = outgoing_transfer_->recipient_id;      // Error related to this recipient
-      std::string error_payload = "Unexpected end of file during transfer."; // Declare string variable
-      error_msg.payload.assign(error_payload.begin(), error_payload.end());
-      error_msg.header.payload_size = error_msg.payload.size();
-      AddMessageToSendQueue(error_msg);
-
-      outgoing_transfer_->file_stream.close();
-      outgoing_transfer_.reset(); // Clean up state
-      return false;               // Failed to queue chunk
-    } else if (outgoing_transfer_->file_stream.fail()) {
-      std::cerr << "File stream failed while reading for transfer." << std::endl;
-      // Handle error
-      Message error_msg;
-      error_msg.header.type = MessageType::FILE_TRANSFER_ERROR;
-      error_msg.header.sender_id = client_id_.load();
-      error_msg.header.recipient_id = outgoing_transfer_->recipient_id;  // Error related to this recipient
-      std::string error_payload = "File stream failed during transfer."; // Declare string variable
-      error_msg.payload.assign(error_payload.begin(), error_payload.end());
-      error_msg.header.payload_size = error_msg.payload.size();
-      AddMessageToSendQueue(error_msg);
-
-      outgoing_transfer_->file_stream.close();
-      outgoing_transfer_.reset(); // Clean up state
-      return false;               // Failed to queue chunk
-    }
-  }
-  return false; // No chunk was queued
-}
-
-/**
- * @brief Handles an incoming file transfer request.
- * @param message The file transfer request message.
- */
-void ClientFileTransferHandler::HandleFileTransferRequest(const Message &message) {
-  // This is a file transfer request received by the intended recipient client
-  // The check for recipient_id is done in HandleMessage, but double-check here
-  if (message.header.recipient_id != client_id_.load()) {
-    // This request is not for this client, ignore it
-    return;
-  }
-
-  if (message.payload.empty()) {
-    std::cerr << "Invalid incoming file transfer request: empty payload." << std::endl;
-    // Send error back to sender via server?
-    return;
-  }
-
-  // Payload is expected to be "recipient_id:file_name:file_size" from the original sender
-  std::string payload_str(message.payload.begin(), message.payload.end());
-  size_t first_colon = payload_str.find(':');
-  size_t second_colon = payload_str.find(':', first_colon + 1);
-
-  if (first_colon == std::string::npos || second_colon == std::string::npos) {
-    std::cerr << "Invalid incoming file transfer request format." << std::endl;
-    // Send error back to sender via server?
-    return;
-  }
-
-  try {
-    // We already know the recipient_id (this client's ID)
-    std::string file_name = payload_str.substr(first_colon + 1, second_colon - first_colon - 1);
-    size_t file_size = std::stoull(payload_str.substr(second_colon + 1));
-
-    std::cout << "Received file transfer request from Client " << message.header.sender_id << " for file: " << file_name
-              << " (" << file_size << " bytes)" << std::endl;
-
-    // Check if an incoming transfer is already in progress
-    {
-      std::lock_guard<std::mutex> lock(incoming_transfer_mutex_);
-      if (incoming_transfer_) {
-        std::cerr << "Error: An incoming file transfer is already in progress. Cannot accept request for '" << file_name
-                  << "'." << std::endl;
-        // Send error back to sender via server
-        Message error_msg;
-        error_msg.header.type = MessageType::FILE_TRANSFER_ERROR;
-        error_msg.header.sender_id = client_id_.load();                         // This client is sending the error
-        error_msg.header.recipient_id = message.header.sender_id;               // Error goes to the original sender
-        std::string error_payload = "Recipient is busy with another transfer."; // Declare string variable
-        error_msg.payload.assign(error_payload.begin(), error_payload.end());
-        error_msg.header.payload_size = error_msg.payload.size();
-        AddMessageToSendQueue(error_msg);
-        return; // Handled by sending error
-      }
-
-      // Create the incoming files directory if it doesn't exist
-      std::filesystem::create_directories(kClientIncomingFilesDir); // Use client-specific constant
-
-      // Create a unique filename to save the incoming file
-      std::string unique_file_name = kClientIncomingFilesDir + "/" + // Use client-specific constant
-                                     std::to_string(message.header.sender_id) + "_" + file_name;
-      std::ofstream output_file(unique_file_name, std::ios::binary);
-
-      if (!output_file.is_open()) {
-        std::cerr << "Failed to open file for writing: " << unique_file_name << std::endl;
-        // Send error back to sender via server
-        Message error_msg;
-        error_msg.header.type = MessageType::FILE_TRANSFER_ERROR;
-        error_msg.header.sender_id = client_id_.load();                           // This client is sending the error
-        error_msg.header.recipient_id = message.header.sender_id;                 // Error goes to the original sender
-        std::string error_payload = "Recipient failed to open file for writing."; // Declare string variable
-        error_msg.payload.assign(error_payload.begin(), error_payload.end());
-        error_msg.header.payload_size = error_msg.payload.size();
-        AddMessageToSendQueue(error_msg);
-        return; // Handled by sending error
-      }
-
-      // Store the state of the incoming transfer
-      incoming_transfer_ = std::make_unique<IncomingFileTransfer>();
-      incoming_transfer_->file_name = file_name;
-      incoming_transfer_->total_size = file_size;
-      incoming_transfer_->sender_id = message.header.sender_id;
-      incoming_transfer_->file_stream = std::move(output_file);
-
-      std::cout << "Ready to receive file '" << file_name << "' from Client " << message.header.sender_id << std::endl;
-
-      // Send an acknowledgment back to the sender via the server
-      Message ack_msg;
-      ack_msg.header.type = MessageType::FILE_TRANSFER_REQUEST; // Reuse type, perhaps add a status field later
-      ack_msg.header.sender_id = client_id_.load();             // This client is sending the ack
-      ack_msg.header.recipient_id = message.header.sender_id;   // Ack goes to the original sender
-      std::string ready_payload = "READY";                      // Declare string variable
-      ack_msg.payload.assign(ready_payload.begin(), ready_payload.end()); // Simple payload indicating readiness
-      ack_msg.header.payload_size = ack_msg.payload.size();
-      AddMessageToSendQueue(ack_msg);
-    }
-  } catch (const std::exception &e) {
-    std::cerr << "Error processing incoming file transfer request: " << e.what() << std::endl;
-    // Send error back to sender via server
-    Message error_msg;
-    error_msg.header.type = MessageType::FILE_TRANSFER_ERROR;
-    error_msg.header.sender_id = client_id_.load();                        // This client is sending the error
-    error_msg.header.recipient_id = message.header.sender_id;              // Error goes to the original sender
-    std::string error_payload = "Error processing file transfer request."; // Declare string variable
-    error_msg.payload.assign(error_payload.begin(), error_payload.end());
-    error_msg.header.payload_size = error_msg.payload.size();
-    AddMessageToSendQueue(error_msg);
-  }
-}
-
-/**
- * @brief Handles an incoming file data chunk.
- * @param message The file data chunk message.
- */
-void ClientFileTransferHandler::HandleFileDataChunk(const Message &message) {
-  // This client is the recipient of the file data chunk
-  std::lock_guard<std::mutex> lock(incoming_transfer_mutex_);
-  if (incoming_transfer_ && incoming_transfer_->sender_id == message.header.sender_id) {
-    if (incoming_transfer_->file_stream.is_open()) {
-      incoming_transfer_->file_stream.write(message.payload.data(), message.payload.size());
-      incoming_transfer_->received_size += message.payload.size();
-
-      // Optional: Provide progress updates
-      // if (incoming_transfer_->received_size % 102400 == 0 || incoming_transfer_->received_size ==
-      // incoming_transfer_->total_size) {
-      //     std::cout << "Received " << incoming_transfer_->received_size << "/" << incoming_transfer_->total_size
-      //               << " bytes for file " << incoming_transfer_->file_name << " from Client "
-      //               << incoming_transfer_->sender_id << std::endl;
-      // }
-
-    } else {
-      std::cerr << "File stream not open for incoming transfer from Client " << message.header.sender_id << std::endl;
-      // Send error back to sender via server
-      Message error_msg;
-      error_msg.header.type = MessageType::FILE_TRANSFER_ERROR;
-      error_msg.header.sender_id = client_id_.load();                // This client is sending the error
-      error_msg.header.recipient_id = message.header.sender_id;      // Error goes to the original sender
-      std::string error_payload = "Recipient file stream not open."; // Declare string variable
-      error_msg.payload.assign(error_payload.begin(), error_payload.end());
-      error_msg.header.payload_size = error_msg.payload.size();
-      AddMessageToSendQueue(error_msg);
-
-      incoming_transfer_.reset(); // Clean up state
-    }
-  } else {
-    std::cerr << "Received file data chunk for unknown or mismatched transfer from Client " << message.header.sender_id
-              << std::endl;
-    // Ignore or send an error back
-  }
-}
-
-/**
- * @brief Handles a file transfer complete message.
- *
- * Finalizes a file transfer and cleans up state.
- *
- * @param message The file transfer complete message.
- */
-void ClientFileTransferHandler::HandleFileTransferComplete(const Message &message) {
-  // This client is the recipient of the completion message
-  std::lock_guard<std::mutex> lock(incoming_transfer_mutex_);
-  if (incoming_transfer_ && incoming_transfer_->sender_id == message.header.sender_id) {
-    if (incoming_transfer_->file_stream.is_open()) {
-      incoming_transfer_->file_stream.close();
-    }
-
-    std::cout << "File transfer complete for '" << incoming_transfer_->file_name << "' from Client "
-              << incoming_transfer_->sender_id << std::endl;
-
-    // Optional: Verify total size received matches expected total size
-    if (incoming_transfer_->received_size != incoming_transfer_->total_size) {
-      std::cerr << "Warning: Received size (" << incoming_transfer_->received_size << ") does not match expected size ("
-                << incoming_transfer_->total_size << ") for file '" << incoming_transfer_->file_name << "'"
-                << std::endl;
-      // Send error back to sender via server
-      Message error_msg;
-      error_msg.header.type = MessageType::FILE_TRANSFER_ERROR;
-      error_msg.header.sender_id = client_id_.load();             // This client is sending the error
-      error_msg.header.recipient_id = message.header.sender_id;   // Error goes to the original sender
-      std::string error_payload = "Received file size mismatch."; // Declare string variable
-      error_msg.payload.assign(error_payload.begin(), error_payload.end());
-      error_msg.header.payload_size = error_msg.payload.size();
-      AddMessageToSendQueue(error_msg);
-    }
-
-    incoming_transfer_.reset(); // Clean up state
-
-  } else {
-    std::cerr << "Received file transfer complete for unknown or mismatched transfer from Client "
-              << message.header.sender_id << std::endl;
-    // Ignore
-  }
-}
-
-/**
- * @brief Handles a file transfer error message.
- * @param message The file transfer error message.
- */
-void ClientFileTransferHandler::HandleFileTransferError(const Message &message) {
-  // This client is the recipient of the error message
-  std::string error_msg_content(message.payload.begin(), message.payload.end());
-  std::cerr << "File transfer error from Client " << message.header.sender_id << ": " << error_msg_content << std::endl;
-
-  // Clean up any related transfer state
-  {
-    std::lock_guard<std::mutex> lock(outgoing_transfer_mutex_);
-    if (outgoing_transfer_ && outgoing_transfer_->recipient_id == message.header.sender_id) {
-      if (outgoing_transfer_->file_stream.is_open()) {
-        outgoing_transfer_->file_stream.close();
-      }
-      outgoing_transfer_.reset();
-      std::cout << "Outgoing file transfer cancelled due to error." << std::endl;
-    }
-  }
-  {
-    std::lock_guard<std::mutex> lock(incoming_transfer_mutex_);
-    if (incoming_transfer_ && incoming_transfer_->sender_id == message.header.sender_id) {
-      if (incoming_transfer_->file_stream.is_open()) {
-        incoming_transfer_->file_stream.close();
-        // Optional: Delete partially received file
-        // std::filesystem::remove(...);
-      }
-      incoming_transfer_.reset();
-      std::cout << "Incoming file transfer cancelled due to error." << std::endl;
-    }
-  }
-}
-
-/**
- * @brief Adds a Message object to the client's send queue.
- * @param message The Message object to add to the queue.
- * @return True if the message was added to the queue, false otherwise.
- */
-bool ClientFileTransferHandler::AddMessageToSendQueue(const Message &message) {
-  {
-    std::lock_guard<std::mutex> lock(send_queue_mutex_);
-    send_queue_.push(message);
-  }
-  send_queue_cv_.notify_one(); // Notify the send thread
-  return true;
-}
+#include "ClientFileTransferHandler.h"
+
+#include "Crc32c.h"
+#include "Xxh64.h"
+
+#include <algorithm>  // For std::min, std::max
+#include <cerrno>
+#include <cstring>    // For std::strerror
+#include <filesystem> // For file size (C++17)
+#include <iostream>
+#include <limits>  // For numeric_limits
+#include <string>  // For std::string
+#include <utility> // For std::move
+#include <vector>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+// Define a directory to store incoming files on the client side
+const std::string kClientIncomingFilesDir = "client_incoming_files";
+
+// Bytes of a file mapped at a time by memory-mapped transfers; chunks still
+// queued pin at most the view they come from, so huge files stay cheap
+const size_t kMapWindowBytes = 16 * 1024 * 1024;
+
+namespace {
+
+/**
+ * @brief Computes the content hash and chunk checksums from mapped views of a file.
+ *
+ * @param source The open file.
+ * @param file_size The expected size of the file.
+ * @param chunk_size The size of every chunk but the last.
+ * @param window_size Length of each view, a multiple of chunk_size.
+ * @param content_hash Receives the XXH64 of the whole file.
+ * @param chunk_checksums Receives the CRC-32C of each chunk.
+ * @return False if a view could not be mapped.
+ */
+bool ScanMappedFile(SendFileSource &source, size_t file_size, size_t chunk_size, size_t window_size,
+                    uint64_t &content_hash, std::vector<uint32_t> &chunk_checksums) {
+  Xxh64 hasher;
+  chunk_checksums.clear();
+  chunk_checksums.reserve(file_size / chunk_size + 1);
+  size_t scanned = 0;
+  while (scanned < file_size) {
+    size_t view_size = std::min(window_size, file_size - scanned);
+    std::shared_ptr<const FileMapping> view = source.Map(scanned, view_size);
+    if (!view) {
+      return false;
+    }
+    const char *data = view->GetData(scanned);
+    hasher.Update(data, view_size);
+    for (size_t chunk = 0; chunk < view_size; chunk += chunk_size) {
+      chunk_checksums.push_back(Crc32c(data + chunk, std::min(chunk_size, view_size - chunk)));
+    }
+    scanned += view_size;
+  }
+  content_hash = hasher.Digest();
+  return true;
+}
+
+/**
+ * @brief Reads a file once to compute its content hash and chunk checksums.
+ *
+ * @param file_path The file to read.
+ * @param file_size The expected size of the file.
+ * @param chunk_size The size of every chunk but the last.
+ * @param content_hash Receives the XXH64 of the whole file.
+ * @param chunk_checksums Receives the CRC-32C of each chunk.
+ * @return False if the file could not be read completely.
+ */
+bool ScanFile(const std::string &file_path, size_t file_size, size_t chunk_size, uint64_t &content_hash,
+              std::vector<uint32_t> &chunk_checksums) {
+  std::ifstream input(file_path, std::ios::binary);
+  if (!input.is_open()) {
+    return false;
+  }
+
+  Xxh64 hasher;
+  std::vector<char> buffer(chunk_size);
+  chunk_checksums.clear();
+  chunk_checksums.reserve(file_size / chunk_size + 1);
+  size_t scanned = 0;
+  while (scanned < file_size) {
+    size_t want = std::min(chunk_size, file_size - scanned);
+    input.read(buffer.data(), want);
+    if (static_cast<size_t>(input.gcount()) != want) {
+      return false;
+    }
+    hasher.Update(buffer.data(), want);
+    chunk_checksums.push_back(Crc32c(buffer.data(), want));
+    scanned += want;
+  }
+  content_hash = hasher.Digest();
+  return true;
+}
+
+/**
+ * @brief Creates, or truncates, a file to be written on the ring.
+ *
+ * @param file_path The file to write.
+ * @param file Receives the handle.
+ * @return False if the file could not be opened.
+ */
+bool OpenFileForWriting(const std::string &file_path, NativeFileHandle &file) {
+#ifdef _WIN32
+  file = CreateFileA(file_path.c_str(), GENERIC_WRITE, 0, nullptr, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+  return file != INVALID_HANDLE_VALUE;
+#else
+  file = open(file_path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+  return file >= 0;
+#endif
+}
+
+/**
+ * @brief Describes the negated errno of a failed ring request.
+ *
+ * @param result The request's result; 0, no progress at all, counts as EIO.
+ * @return The description.
+ */
+std::string DescribeFileIoResult(int result) {
+  return std::strerror(result < 0 ? -result : EIO);
+}
+
+} // namespace
+
+/**
+ * @brief Closes the file written on the ring, once no write is in flight.
+ */
+ClientFileTransferHandler::IncomingFileTransfer::~IncomingFileTransfer() {
+  if (file_open) {
+#ifdef _WIN32
+    CloseHandle(file);
+#else
+    close(file);
+#endif
+  }
+}
+
+/**
+ * @brief Constructs a new ClientFileTransferHandler.
+ * @param send_queue A reference to the client's message send queue.
+ * @param client_id A reference to the client's atomic ID.
+ * @param protocol_version A reference to the wire version negotiated with the server.
+ * @param options Chunk size, window and concurrency settings for outgoing transfers.
+ */
+ClientFileTransferHandler::ClientFileTransferHandler(MpscQueue<OutgoingMessage> &send_queue,
+                                                     std::atomic<int> &client_id, std::atomic<int> &protocol_version,
+                                                     const FileTransferOptions &options)
+    : next_transfer_id_(1), next_fill_id_(0),
+      chunk_size_(std::min(std::max<size_t>(options.chunk_size, 1), kMaxFileChunkSize)),
+      window_bytes_(chunk_size_ * std::max<size_t>(options.window_chunks, 1)), zero_copy_(options.zero_copy),
+      memory_mapped_(options.memory_mapped),
+      map_window_bytes_(chunk_size_ * std::max<size_t>(kMapWindowBytes / chunk_size_, 1)),
+      max_transfers_(std::max<size_t>(options.max_transfers, 1)), send_queue_(send_queue),
+      client_id_(client_id), protocol_version_(protocol_version) {
+  if (options.io_backend == IoBackend::IO_URING) {
+    file_loop_ = std::make_unique<EventLoop>(IoBackend::IO_URING);
+    if (!file_loop_->SupportsFileIo() || !file_loop_->Start()) {
+      std::cerr << "Warning: File I/O on io_uring is not available, using file streams." << std::endl;
+      file_loop_.reset();
+    }
+  }
+}
+
+/**
+ * @brief Destroys the ClientFileTransferHandler. Closes any open file streams.
+ */
+ClientFileTransferHandler::~ClientFileTransferHandler() {
+  // Wait for the ring reads and writes in flight; their callbacks take the locks below
+  if (file_loop_) {
+    file_loop_->Stop();
+  }
+
+  // Close any open file streams for ongoing transfers
+  std::lock_guard<std::mutex> outgoing_lock(outgoing_transfer_mutex_);
+  for (auto &entry : outgoing_transfers_) {
+    if (entry.second->file_stream.is_open()) {
+      entry.second->file_stream.close();
+    }
+  }
+
+  std::lock_guard<std::mutex> incoming_lock(incoming_transfer_mutex_);
+  for (auto &entry : incoming_transfers_) {
+    if (entry.second->file_stream.is_open()) {
+      entry.second->file_stream.close();
+    }
+  }
+}
+
+/**
+ * @brief Initiates a file transfer request to a recipient.
+ *
+ * This method is called by the Client when the user requests a file transfer.
+ * It prepares the file transfer request message and adds it to the send queue.
+ * Requests do not wait for earlier transfers, so a batch of files is
+ * negotiated in parallel instead of one round trip after another.
+ *
+ * @param recipient_id The ID of the client to send the file to.
+ * @param file_path The path to the file to send.
+ * @return True if the request was successfully initiated, false otherwise.
+ */
+bool ClientFileTransferHandler::RequestFileTransfer(int recipient_id, const std::string &file_path) {
+  if (client_id_.load() == -1) {
+    std::cerr << "Error: Client ID not assigned. Cannot initiate file transfer." << std::endl;
+    return false;
+  }
+
+  // Check if another outgoing transfer can be started
+  {
+    std::lock_guard<std::mutex> lock(outgoing_transfer_mutex_);
+    if (outgoing_transfers_.size() >= max_transfers_) {
+      std::cerr << "Error: Too many outgoing file transfers in progress (" << max_transfers_ << ")." << std::endl;
+      return false;
+    }
+  }
+
+  // Check if the file exists and get its size
+  std::filesystem::path file_system_path(file_path);
+  if (!std::filesystem::exists(file_system_path)) {
+    std::cerr << "Error: File not found: " << file_path << std::endl;
+    return false;
+  }
+  if (!std::filesystem::is_regular_file(file_system_path)) {
+    std::cerr << "Error: Path is not a regular file: " << file_path << std::endl;
+    return false;
+  }
+
+  size_t file_size = std::filesystem::file_size(file_system_path);
+  std::string file_name = file_system_path.filename().string();
+
+  // Open the file now so that the window can be filled as soon as the receiver is ready
+  std::shared_ptr<SendFileSource> file_source;
+  std::ifstream input_file;
+  if (zero_copy_ || memory_mapped_ || file_loop_) {
+    file_source = std::make_shared<SendFileSource>(file_path);
+    if (!file_source->IsOpen()) {
+      file_source.reset();
+    }
+  }
+  if (!file_source) {
+    input_file.open(file_path, std::ios::binary);
+    if (!input_file.is_open()) {
+      std::cerr << "Error: Failed to open file for reading: " << file_path << std::endl;
+      return false;
+    }
+  }
+
+  // Hash the content, so the server can store it by content and the
+  // receiver can resume, and checksum every chunk the way it will be sent
+  FileTransferRequest request;
+  std::vector<uint32_t> chunk_checksums;
+  bool scanned = file_source && memory_mapped_
+                     ? ScanMappedFile(*file_source, file_size, chunk_size_, map_window_bytes_, request.content_hash,
+                                      chunk_checksums)
+                     : ScanFile(file_path, file_size, chunk_size_, request.content_hash, chunk_checksums);
+  if (!scanned) {
+    std::cerr << "Error: Failed to read file: " << file_path << std::endl;
+    return false;
+  }
+  request.recipient_id = recipient_id;
+  request.file_name = file_name;
+  request.file_size = file_size;
+  request.has_content_hash = true;
+  request.chunk_size = chunk_size_;
+
+  // Prepare the file transfer request message payload
+  std::string payload_str = FormatFileTransferRequest(request);
+
+  Message request_msg;
+  request_msg.header.type = MessageType::FILE_TRANSFER_REQUEST;
+  request_msg.header.sender_id = client_id_.load();
+  request_msg.header.recipient_id = recipient_id; // The intended recipient
+  request_msg.payload.assign(payload_str.begin(), payload_str.end());
+  request_msg.header.payload_size = request_msg.payload.size();
+
+  // Store the state for the outgoing transfer before the request goes out, so
+  // that the receiver's first ack cannot arrive ahead of it. Chunks are sent
+  // once the receiver acks the request.
+  uint32_t transfer_id = 0;
+  {
+    std::lock_guard<std::mutex> lock(outgoing_transfer_mutex_);
+    if (protocol_version_.load() >= kProtocolVersionCompact) {
+      // Skip IDs that are still in use after the counter wrapped around
+      do {
+        transfer_id = next_transfer_id_++;
+      } while (transfer_id == 0 || outgoing_transfers_.count(transfer_id));
+    }
+    if (outgoing_transfers_.count(transfer_id)) {
+      // Only the legacy header is available, which cannot tell transfers apart
+      std::cerr << "Error: An outgoing file transfer is already in progress." << std::endl;
+      return false;
+    }
+    if (outgoing_transfers_.size() >= max_transfers_) {
+      std::cerr << "Error: Too many outgoing file transfers in progress (" << max_transfers_ << ")." << std::endl;
+      return false;
+    }
+
+    auto transfer = std::make_unique<OutgoingFileTransfer>();
+    transfer->file_path = file_path;
+    transfer->total_size = file_size;
+    transfer->recipient_id = recipient_id;
+    transfer->transfer_id = transfer_id;
+    transfer->file_stream = std::move(input_file);
+    transfer->memory_mapped = file_source && !zero_copy_ && memory_mapped_;
+    transfer->ring_reads = file_source && !zero_copy_ && !memory_mapped_;
+    transfer->file_source = std::move(file_source);
+    transfer->chunk_checksums = std::move(chunk_checksums);
+    outgoing_transfers_.emplace(transfer_id, std::move(transfer));
+  }
+  request_msg.header.transfer_id = transfer_id;
+
+  // Add the request message to the send queue
+  if (AddMessageToSendQueue(std::move(request_msg))) {
+    std::cout << "Sent file transfer request for '" << file_name << "' to client " << recipient_id << std::endl;
+    return true;
+  } else {
+    std::cerr << "Failed to add file transfer request to send queue." << std::endl;
+    std::lock_guard<std::mutex> lock(outgoing_transfer_mutex_);
+    outgoing_transfers_.erase(transfer_id);
+    return false;
+  }
+}
+
+/**
+ * @brief Handles an incoming message related to file transfer.
+ *
+ * This method is called by the Client's receive logic when a file-transfer-related
+ * message is received. It processes the message based on its type
+ * (request, data chunk, complete, error).
+ *
+ * @param message View of the received message.
+ */
+void ClientFileTransferHandler::HandleMessage(const MessageView &message) {
+  // Ensure the message is actually for this client (either recipient or sender of error)
+  // or a server-sent message (sender_id -1)
+  if (message.header.recipient_id != client_id_.load() && message.header.recipient_id != -1 &&
+      message.header.sender_id != -1) {
+    // Message is not for this client, ignore
+    return;
+  }
+
+  switch (message.header.type) {
+  case MessageType::FILE_TRANSFER_REQUEST:
+    HandleFileTransferRequest(message);
+    break;
+  case MessageType::FILE_DATA_CHUNK:
+    HandleFileDataChunk(message);
+    break;
+  case MessageType::FILE_TRANSFER_COMPLETE:
+    HandleFileTransferComplete(message);
+    break;
+  case MessageType::FILE_TRANSFER_ERROR:
+    HandleFileTransferError(message);
+    break;
+  case MessageType::FILE_TRANSFER_ACK:
+    HandleFileTransferAck(message);
+    break;
+  default:
+    // Not a file transfer message type handled by this handler
+    // The Client::ProcessReceivedMessage will handle other types
+    break;
+  }
+}
+
+/**
+ * @brief Queues chunks for every ready transfer until all windows are full or
+ * all files are sent.
+ *
+ * Transfers take turns, one chunk each, starting after the transfer that was
+ * served last. The completion message is queued after a transfer's last chunk.
+ * Caller holds outgoing_transfer_mutex_.
+ */
+void ClientFileTransferHandler::FillSendWindowsLocked() {
+  bool queued = true;
+  while (queued) {
+    queued = false;
+
+    // One round: transfers from next_fill_id_ upwards, then the ones before it
+    std::vector<uint32_t> round;
+    round.reserve(outgoing_transfers_.size());
+    for (auto it = outgoing_transfers_.lower_bound(next_fill_id_); it != outgoing_transfers_.end(); ++it) {
+      round.push_back(it->first);
+    }
+    for (auto it = outgoing_transfers_.begin(); it != outgoing_transfers_.end() && it->first < next_fill_id_; ++it) {
+      round.push_back(it->first);
+    }
+
+    for (uint32_t transfer_id : round) {
+      auto it = outgoing_transfers_.find(transfer_id);
+      if (it == outgoing_transfers_.end()) {
+        continue;
+      }
+      OutgoingFileTransfer &transfer = *it->second;
+      if (!transfer.receiver_ready || transfer.complete_sent) {
+        continue;
+      }
+
+      if (transfer.sent_size < transfer.total_size && transfer.sent_size - transfer.acked_size < window_bytes_) {
+        if (!SendNextFileChunkLocked(transfer)) {
+          continue; // The transfer was removed, or its next chunk is still being read
+        }
+        next_fill_id_ = transfer_id + 1;
+        queued = true;
+      }
+
+      if (transfer.sent_size == transfer.total_size) {
+        // Every byte is queued; the completion message follows the last chunk
+        Message complete_msg;
+        complete_msg.header.type = MessageType::FILE_TRANSFER_COMPLETE;
+        complete_msg.header.sender_id = client_id_.load();
+        complete_msg.header.recipient_id = transfer.recipient_id;
+        complete_msg.header.transfer_id = transfer.transfer_id;
+        complete_msg.header.payload_size = 0; // No payload for completion message
+        AddMessageToSendQueue(std::move(complete_msg));
+
+        transfer.complete_sent = true;
+        transfer.file_stream.close();
+        transfer.file_source.reset(); // Queued chunks keep the file open until they are written
+        transfer.mapping.reset();
+      }
+    }
+  }
+}
+
+/**
+ * @brief Sends the next file data chunk of a transfer by adding it to the send queue.
+ *
+ * Caller holds outgoing_transfer_mutex_. On failure an error is queued for the
+ * recipient and the transfer is removed, which invalidates it. A chunk read
+ * on file_loop_ is only queued for StartChunkReads, and queued for sending
+ * by HandleChunkRead.
+ *
+ * @param transfer The outgoing transfer.
+ * @return True if a chunk was successfully added to the queue, false otherwise.
+ */
+bool ClientFileTransferHandler::SendNextFileChunkLocked(OutgoingFileTransfer &transfer) {
+  if (transfer.memory_mapped && transfer.sent_size < transfer.total_size) {
+    // Memory-mapped: queue a slice of the current view; the send thread
+    // gathers it into its write without reading or copying it first
+    size_t chunk_bytes = std::min(chunk_size_, transfer.total_size - transfer.sent_size);
+    if (!transfer.mapping || !transfer.mapping->Contains(transfer.sent_size, chunk_bytes)) {
+      // Chunks never straddle views, which are whole chunks long. The
+      // previous view goes once its last queued chunk has been written.
+      size_t view_offset = transfer.sent_size / map_window_bytes_ * map_window_bytes_;
+      transfer.mapping =
+          transfer.file_source->Map(view_offset, std::min(map_window_bytes_, transfer.total_size - view_offset));
+      if (!transfer.mapping) {
+        std::cerr << "Failed to map '" << transfer.file_path << "' at byte " << view_offset
+                  << "; was it truncated?" << std::endl;
+        SendFileTransferError(transfer.recipient_id, transfer.transfer_id, "File could not be read during transfer.");
+        outgoing_transfers_.erase(transfer.transfer_id);
+        return false;
+      }
+    }
+    MessageHeader chunk_header = {MessageType::FILE_DATA_CHUNK, client_id_.load(), transfer.recipient_id,
+                                  chunk_bytes, kCompactFlagChecksum, transfer.transfer_id,
+                                  transfer.chunk_checksums[transfer.sent_size / chunk_size_]};
+    AddMessageToSendQueue(OutgoingMessage(chunk_header, transfer.mapping, transfer.sent_size, chunk_bytes));
+    transfer.sent_size += chunk_bytes;
+    return true;
+  }
+
+  if (transfer.ring_reads && transfer.sent_size < transfer.total_size) {
+    // Ring: read the chunk into its payload on file_loop_, one read at a time
+    if (!transfer.read_in_flight) {
+      auto read = std::make_shared<ChunkRead>();
+      read->file_source = transfer.file_source;
+      read->transfer_id = transfer.transfer_id;
+      read->offset = transfer.sent_size;
+      read->done = 0;
+      read->message.payload.resize(std::min(chunk_size_, transfer.total_size - transfer.sent_size));
+      chunk_reads_.push_back(std::move(read));
+      transfer.read_in_flight = true;
+    }
+    return false;
+  }
+
+  if (transfer.file_source && transfer.sent_size < transfer.total_size) {
+    // Zero-copy: queue a reference to the file region; the send thread writes
+    // it with ISocket::SendFile
+    size_t chunk_bytes = std::min(chunk_size_, transfer.total_size - transfer.sent_size);
+    MessageHeader chunk_header = {MessageType::FILE_DATA_CHUNK, client_id_.load(), transfer.recipient_id,
+                                  chunk_bytes, kCompactFlagChecksum, transfer.transfer_id,
+                                  transfer.chunk_checksums[transfer.sent_size / chunk_size_]};
+    AddMessageToSendQueue(OutgoingMessage(chunk_header, transfer.file_source, transfer.sent_size, chunk_bytes));
+    transfer.sent_size += chunk_bytes;
+    return true;
+  }
+
+  if (transfer.file_stream.is_open() && transfer.sent_size < transfer.total_size) {
+
+    size_t bytes_to_read = std::min(chunk_size_, transfer.total_size - transfer.sent_size);
+
+    // Read the chunk straight into the (pool allocated) message payload
+    Message chunk_msg;
+    chunk_msg.payload.resize(bytes_to_read);
+    transfer.file_stream.read(chunk_msg.payload.data(), bytes_to_read);
+    size_t bytes_read = transfer.file_stream.gcount();
+
+    std::string error_payload;
+    if (bytes_read > 0) {
+      chunk_msg.header.type = MessageType::FILE_DATA_CHUNK;
+      chunk_msg.header.sender_id = client_id_.load();
+      chunk_msg.header.recipient_id = transfer.recipient_id;
+      chunk_msg.header.transfer_id = transfer.transfer_id;
+      // The checksum from the scan also catches a file modified since then
+      chunk_msg.header.flags = kCompactFlagChecksum;
+      chunk_msg.header.checksum = transfer.chunk_checksums[transfer.sent_size / chunk_size_];
+      chunk_msg.payload.resize(bytes_read);
+      chunk_msg.header.payload_size = chunk_msg.payload.size();
+
+      // Add the data chunk message to the send queue
+      if (AddMessageToSendQueue(std::move(chunk_msg))) {
+        transfer.sent_size += bytes_read;
+        return true; // A chunk was successfully queued
+      }
+      std::cerr << "Failed to add file data chunk to send queue." << std::endl;
+      error_payload = "Client failed to queue file data chunk.";
+    } else if (transfer.file_stream.eof()) {
+      // Reached end of file unexpectedly (should be caught by sent_size == total_size)
+      std::cerr << "Unexpected end of file while reading for transfer." << std::endl;
+      error_payload = "Unexpected end of file during transfer.";
+    } else if (transfer.file_stream.fail()) {
+      std::cerr << "File stream failed while reading for transfer." << std::endl;
+      error_payload = "File stream failed during transfer.";
+    } else {
+      return false;
+    }
+
+    // Tell the recipient, then clean up state
+    SendFileTransferError(transfer.recipient_id, transfer.transfer_id, error_payload);
+    transfer.file_stream.close();
+    outgoing_transfers_.erase(transfer.transfer_id);
+    return false; // Failed to queue chunk
+  }
+  return false; // No chunk was queued
+}
+
+/**
+ * @brief Handles a cumulative acknowledgement for an outgoing transfer.
+ *
+ * The first ack (0 bytes) signals that the receiver is ready; each later one
+ * frees window space for more chunks.
+ *
+ * @param message The file transfer ack message.
+ */
+void ClientFileTransferHandler::HandleFileTransferAck(const MessageView &message) {
+  uint64_t acked_bytes = 0;
+  if (!ParseFileTransferAck(message.payload, acked_bytes)) {
+    std::cerr << "Invalid file transfer ack from Client " << message.header.sender_id << std::endl;
+    return;
+  }
+
+  std::unique_lock<std::mutex> lock(outgoing_transfer_mutex_);
+  auto it = outgoing_transfers_.find(message.header.transfer_id);
+  if (it == outgoing_transfers_.end() || it->second->recipient_id != message.header.sender_id) {
+    std::cerr << "Received file transfer ack for unknown or mismatched transfer from Client "
+              << message.header.sender_id << std::endl;
+    return;
+  }
+  OutgoingFileTransfer &transfer = *it->second;
+  if (!transfer.receiver_ready && acked_bytes > 0) {
+    // The receiver already holds the first acked_bytes bytes: resume after them
+    if (acked_bytes > transfer.total_size || (acked_bytes % chunk_size_ != 0 && acked_bytes != transfer.total_size)) {
+      std::cerr << "Invalid resume offset " << acked_bytes << " for '" << transfer.file_path << "'" << std::endl;
+      SendFileTransferError(transfer.recipient_id, transfer.transfer_id, "Invalid resume offset.");
+      outgoing_transfers_.erase(it);
+      return;
+    }
+    if (transfer.file_stream.is_open()) {
+      transfer.file_stream.seekg(static_cast<std::streamoff>(acked_bytes));
+    }
+    transfer.sent_size = acked_bytes;
+    if (acked_bytes == transfer.total_size) {
+      std::cout << "Receiver already has '" << transfer.file_path << "', nothing to send." << std::endl;
+    } else {
+      std::cout << "Resuming '" << transfer.file_path << "' at byte " << acked_bytes << std::endl;
+    }
+  } else if (acked_bytes > transfer.sent_size) {
+    std::cerr << "Ignoring file transfer ack beyond the data sent (" << acked_bytes << " > " << transfer.sent_size
+              << ")." << std::endl;
+    return;
+  }
+
+  // Acks are cumulative; a reordered older one changes nothing
+  transfer.acked_size = std::max<size_t>(transfer.acked_size, acked_bytes);
+  transfer.receiver_ready = true;
+  FillSendWindowsLocked();
+
+  // Filling the windows may have removed this transfer after a read error
+  it = outgoing_transfers_.find(message.header.transfer_id);
+  if (it != outgoing_transfers_.end() && it->second->complete_sent &&
+      it->second->acked_size == it->second->total_size) {
+    std::cout << "File transfer complete for '" << it->second->file_path << "'" << std::endl;
+    outgoing_transfers_.erase(it);
+  }
+  StartChunkReads(lock);
+}
+
+/**
+ * @brief Reads an outgoing chunk, or what is left of it, on file_loop_.
+ *
+ * Called without outgoing_transfer_mutex_, since a stopped loop completes the
+ * request at once.
+ *
+ * @param read The chunk being read.
+ */
+void ClientFileTransferHandler::ReadChunkOnLoop(const std::shared_ptr<ChunkRead> &read) {
+  file_loop_->ReadFile(read->file_source->GetNativeHandle(), read->message.payload.data() + read->done,
+                       read->message.payload.size() - read->done, read->offset + read->done,
+                       [this, read](int result) { HandleChunkRead(read, result); });
+}
+
+/**
+ * @brief Handles the outcome of a read from ReadChunkOnLoop.
+ *
+ * Queues the chunk once it is whole and fills the windows again, which may
+ * start the next read.
+ *
+ * @param read The chunk being read.
+ * @param result The bytes read, or a negated errno.
+ */
+void ClientFileTransferHandler::HandleChunkRead(const std::shared_ptr<ChunkRead> &read, int result) {
+  if (result == -EINTR || result == -EAGAIN) {
+    ReadChunkOnLoop(read);
+    return;
+  }
+  if (result > 0 && read->done + result < read->message.payload.size()) {
+    read->done += result;
+    ReadChunkOnLoop(read);
+    return;
+  }
+
+  std::unique_lock<std::mutex> lock(outgoing_transfer_mutex_);
+  auto it = outgoing_transfers_.find(read->transfer_id);
+  if (it == outgoing_transfers_.end() || it->second->file_source != read->file_source) {
+    return; // Cancelled while the chunk was read
+  }
+  OutgoingFileTransfer &transfer = *it->second;
+  transfer.read_in_flight = false;
+  if (result <= 0) {
+    std::cerr << "Failed to read '" << transfer.file_path << "' at byte " << read->offset + read->done << ": "
+              << DescribeFileIoResult(result) << "; was it truncated?" << std::endl;
+    SendFileTransferError(transfer.recipient_id, transfer.transfer_id, "File could not be read during transfer.");
+    outgoing_transfers_.erase(it);
+    return;
+  }
+
+  Message &chunk_msg = read->message;
+  chunk_msg.header.type = MessageType::FILE_DATA_CHUNK;
+  chunk_msg.header.sender_id = client_id_.load();
+  chunk_msg.header.recipient_id = transfer.recipient_id;
+  chunk_msg.header.transfer_id = transfer.transfer_id;
+  chunk_msg.header.flags = kCompactFlagChecksum;
+  chunk_msg.header.checksum = transfer.chunk_checksums[read->offset / chunk_size_];
+  chunk_msg.header.payload_size = chunk_msg.payload.size();
+  transfer.sent_size += chunk_msg.payload.size();
+  AddMessageToSendQueue(std::move(chunk_msg));
+  FillSendWindowsLocked();
+  StartChunkReads(lock);
+}
+
+/**
+ * @brief Starts the reads SendNextFileChunkLocked queued.
+ *
+ * @param lock The held lock on outgoing_transfer_mutex_, released before the reads start.
+ */
+void ClientFileTransferHandler::StartChunkReads(std::unique_lock<std::mutex> &lock) {
+  std::vector<std::shared_ptr<ChunkRead>> reads;
+  reads.swap(chunk_reads_);
+  lock.unlock();
+  for (const std::shared_ptr<ChunkRead> &read : reads) {
+    ReadChunkOnLoop(read);
+  }
+}
+
+/**
+ * @brief Handles an incoming file transfer request.
+ * @param message The file transfer request message.
+ */
+void ClientFileTransferHandler::HandleFileTransferRequest(const MessageView &message) {
+  // This is a file transfer request received by the intended recipient client
+  // The check for recipient_id is done in HandleMessage, but double-check here
+  if (message.header.recipient_id != client_id_.load()) {
+    // This request is not for this client, ignore it
+    return;
+  }
+
+  if (message.payload.empty()) {
+    std::cerr << "Invalid incoming file transfer request: empty payload." << std::endl;
+    SendFileTransferError(message.header.sender_id, message.header.transfer_id, "Invalid file transfer request.");
+    return;
+  }
+
+  // Payload is expected to be "recipient_id:file_name:file_size[;options]" from the original sender
+  FileTransferRequest request;
+  if (!ParseFileTransferRequest(message.payload, request)) {
+    std::cerr << "Invalid incoming file transfer request format." << std::endl;
+    SendFileTransferError(message.header.sender_id, message.header.transfer_id,
+                          "Invalid file transfer request format.");
+    return;
+  }
+
+  try {
+    // We already know the recipient_id (this client's ID)
+    std::string file_name = request.file_name;
+    size_t file_size = request.file_size;
+
+    std::cout << "Received file transfer request from Client " << message.header.sender_id << " for file: " << file_name
+              << " (" << file_size << " bytes)" << std::endl;
+
+    std::pair<int, uint32_t> key(message.header.sender_id, message.header.transfer_id);
+    // Create a unique filename to save the incoming file
+    std::string unique_file_name = kClientIncomingFilesDir + "/" + // Use client-specific constant
+                                   std::to_string(message.header.sender_id) + "_" + file_name;
+
+    // Check that this transfer does not clash with one already in progress
+    {
+      std::lock_guard<std::mutex> lock(incoming_transfer_mutex_);
+      std::string busy_reason;
+      if (incoming_transfers_.count(key)) {
+        busy_reason = "Recipient is busy with another transfer.";
+      }
+      for (const auto &entry : incoming_transfers_) {
+        if (entry.second->file_path == unique_file_name) {
+          busy_reason = "Recipient is already receiving a file with this name.";
+        }
+      }
+      if (!busy_reason.empty()) {
+        std::cerr << "Error: Cannot accept request for '" << file_name << "': " << busy_reason << std::endl;
+        // Send error back to sender via server
+        SendFileTransferError(message.header.sender_id, message.header.transfer_id, busy_reason);
+        return; // Handled by sending error
+      }
+
+      // Create the incoming files directory if it doesn't exist
+      std::filesystem::create_directories(kClientIncomingFilesDir); // Use client-specific constant
+
+      // On the ring the file is written through a handle of its own
+      std::ofstream output_file;
+      NativeFileHandle file = NativeFileHandle();
+      bool opened = false;
+      if (file_loop_) {
+        opened = OpenFileForWriting(unique_file_name, file);
+      } else {
+        output_file.open(unique_file_name, std::ios::binary);
+        opened = output_file.is_open();
+      }
+
+      if (!opened) {
+        std::cerr << "Failed to open file for writing: " << unique_file_name << std::endl;
+        // Send error back to sender via server
+        SendFileTransferError(message.header.sender_id, message.header.transfer_id,
+                              "Recipient failed to open file for writing.");
+        return; // Handled by sending error
+      }
+
+      // Store the state of the incoming transfer
+      auto transfer = std::make_shared<IncomingFileTransfer>();
+      transfer->file_name = file_name;
+      transfer->file_path = unique_file_name;
+      transfer->total_size = file_size;
+      transfer->sender_id = message.header.sender_id;
+      transfer->transfer_id = message.header.transfer_id;
+      transfer->file_stream = std::move(output_file);
+      transfer->file = file;
+      transfer->file_open = file_loop_ != nullptr;
+      incoming_transfers_.emplace(key, std::move(transfer));
+
+      std::cout << "Ready to receive file '" << file_name << "' from Client " << message.header.sender_id << std::endl;
+
+      // Acknowledge 0 bytes back to the sender via the server: we are ready
+      SendFileTransferAck(message.header.sender_id, message.header.transfer_id, 0);
+    }
+  } catch (const std::exception &e) {
+    std::cerr << "Error processing incoming file transfer request: " << e.what() << std::endl;
+    // Send error back to sender via server
+    SendFileTransferError(message.header.sender_id, message.header.transfer_id,
+                          "Error processing file transfer request.");
+  }
+}
+
+/**
+ * @brief Handles an incoming file data chunk.
+ * @param message The file data chunk message.
+ */
+void ClientFileTransferHandler::HandleFileDataChunk(const MessageView &message) {
+  std::shared_ptr<IncomingFileTransfer> start_write; // Set when this chunk is the next to write on file_loop_
+  {
+    // This client is the recipient of the file data chunk
+    std::lock_guard<std::mutex> lock(incoming_transfer_mutex_);
+    auto it = incoming_transfers_.find({message.header.sender_id, message.header.transfer_id});
+    if (it != incoming_transfers_.end()) {
+      IncomingFileTransfer &transfer = *it->second;
+      if ((message.header.flags & kCompactFlagChecksum) &&
+          Crc32c(message.payload.data(), message.payload.size()) != message.header.checksum) {
+        std::cerr << "Checksum mismatch in file data chunk from Client " << message.header.sender_id << std::endl;
+        SendFileTransferError(message.header.sender_id, message.header.transfer_id, "Chunk checksum mismatch.");
+        incoming_transfers_.erase(it); // Clean up state
+      } else if (transfer.file_open) {
+        // Written on file_loop_ after the chunks before it, and acked once it is on disk
+        transfer.received_size += message.payload.size();
+        if (transfer.write_in_flight) {
+          transfer.pending_chunks.emplace_back(message.payload.begin(), message.payload.end());
+        } else {
+          transfer.writing.assign(message.payload.begin(), message.payload.end());
+          transfer.write_in_flight = true;
+          start_write = it->second;
+        }
+      } else if (transfer.file_stream.is_open()) {
+        transfer.file_stream.write(message.payload.data(), message.payload.size());
+        transfer.received_size += message.payload.size();
+
+        // Cumulative ack so the sender can slide its window forward
+        SendFileTransferAck(message.header.sender_id, message.header.transfer_id, transfer.received_size);
+
+        // Optional: Provide progress updates
+        // if (transfer.received_size % 102400 == 0 || transfer.received_size == transfer.total_size) {
+        //     std::cout << "Received " << transfer.received_size << "/" << transfer.total_size
+        //               << " bytes for file " << transfer.file_name << " from Client "
+        //               << transfer.sender_id << std::endl;
+        // }
+
+      } else {
+        std::cerr << "File stream not open for incoming transfer from Client " << message.header.sender_id << std::endl;
+        // Send error back to sender via server
+        SendFileTransferError(message.header.sender_id, message.header.transfer_id, "Recipient file stream not open.");
+
+        incoming_transfers_.erase(it); // Clean up state
+      }
+    } else {
+      std::cerr << "Received file data chunk for unknown or mismatched transfer from Client "
+                << message.header.sender_id << std::endl;
+      // Ignore or send an error back
+    }
+  }
+
+  if (start_write) {
+    WriteChunkOnLoop(start_write, 0);
+  }
+}
+
+/**
+ * @brief Writes a received chunk, or what is left of it, on file_loop_.
+ *
+ * Called without incoming_transfer_mutex_, by the owner of the write in
+ * flight, since a stopped loop completes the request at once.
+ *
+ * @param transfer The incoming transfer; writing holds the chunk.
+ * @param done Bytes of the chunk already written.
+ */
+void ClientFileTransferHandler::WriteChunkOnLoop(const std::shared_ptr<IncomingFileTransfer> &transfer, size_t done) {
+  file_loop_->WriteFile(transfer->file, transfer->writing.data() + done, transfer->writing.size() - done,
+                        transfer->written_size + done,
+                        [this, transfer, done](int result) { HandleChunkWritten(transfer, done, result); });
+}
+
+/**
+ * @brief Handles the outcome of a write from WriteChunkOnLoop.
+ *
+ * Acks the chunk once it is whole on disk, then takes the next queued chunk,
+ * or finishes the transfer if its completion already arrived.
+ *
+ * @param transfer The incoming transfer.
+ * @param done Bytes of the chunk written before this request.
+ * @param result The bytes written, or a negated errno.
+ */
+void ClientFileTransferHandler::HandleChunkWritten(const std::shared_ptr<IncomingFileTransfer> &transfer, size_t done,
+                                                   int result) {
+  if (result == -EINTR || result == -EAGAIN) {
+    WriteChunkOnLoop(transfer, done);
+    return;
+  }
+  if (result > 0 && done + result < transfer->writing.size()) {
+    WriteChunkOnLoop(transfer, done + result);
+    return;
+  }
+
+  {
+    std::lock_guard<std::mutex> lock(incoming_transfer_mutex_);
+    std::pair<int, uint32_t> key(transfer->sender_id, transfer->transfer_id);
+    auto it = incoming_transfers_.find(key);
+    if (it == incoming_transfers_.end() || it->second != transfer) {
+      return; // Cancelled while the chunk was written; the last reference closes the file
+    }
+    if (result <= 0) {
+      std::cerr << "Failed to write '" << transfer->file_path << "': " << DescribeFileIoResult(result) << std::endl;
+      SendFileTransferError(key.first, key.second, "Recipient failed to write file.");
+      incoming_transfers_.erase(it);
+      return;
+    }
+
+    // Cumulative ack so the sender can slide its window forward
+    transfer->written_size += transfer->writing.size();
+    SendFileTransferAck(key.first, key.second, transfer->written_size);
+    if (transfer->pending_chunks.empty()) {
+      transfer->writing.clear();
+      transfer->write_in_flight = false;
+      if (transfer->complete_received) {
+        FinishIncomingTransferLocked(key);
+      }
+      return;
+    }
+    transfer->writing = std::move(transfer->pending_chunks.front());
+    transfer->pending_chunks.pop_front();
+  }
+  WriteChunkOnLoop(transfer, 0);
+}
+
+/**
+ * @brief Handles a file transfer complete message.
+ *
+ * Finalizes a file transfer and cleans up state, once the chunks still being
+ * written on file_loop_ are on disk.
+ *
+ * @param message The file transfer complete message.
+ */
+void ClientFileTransferHandler::HandleFileTransferComplete(const MessageView &message) {
+  // This client is the recipient of the completion message
+  std::lock_guard<std::mutex> lock(incoming_transfer_mutex_);
+  auto it = incoming_transfers_.find({message.header.sender_id, message.header.transfer_id});
+  if (it != incoming_transfers_.end()) {
+    if (it->second->write_in_flight) {
+      it->second->complete_received = true; // HandleChunkWritten finishes it
+    } else {
+      FinishIncomingTransferLocked(it->first);
+    }
+  } else if (message.header.sender_id == -1) {
+    // The server confirms that an upload to it was stored
+    std::cout << "Server confirmed file transfer." << std::endl;
+  } else {
+    std::cerr << "Received file transfer complete for unknown or mismatched transfer from Client "
+              << message.header.sender_id << std::endl;
+    // Ignore
+  }
+}
+
+/**
+ * @brief Reports a finished incoming transfer and removes it.
+ *
+ * Caller holds incoming_transfer_mutex_.
+ *
+ * @param key The transfer's (sender ID, transfer ID).
+ */
+void ClientFileTransferHandler::FinishIncomingTransferLocked(const std::pair<int, uint32_t> &key) {
+  auto it = incoming_transfers_.find(key);
+  IncomingFileTransfer &transfer = *it->second;
+  if (transfer.file_stream.is_open()) {
+    transfer.file_stream.close();
+  }
+
+  std::cout << "File transfer complete for '" << transfer.file_name << "' from Client " << transfer.sender_id
+            << std::endl;
+
+  // Optional: Verify total size received matches expected total size
+  if (transfer.received_size != transfer.total_size) {
+    std::cerr << "Warning: Received size (" << transfer.received_size << ") does not match expected size ("
+              << transfer.total_size << ") for file '" << transfer.file_name << "'" << std::endl;
+    // Send error back to sender via server
+    SendFileTransferError(key.first, key.second, "Received file size mismatch.");
+  }
+
+  incoming_transfers_.erase(it); // Clean up state, which closes a file written on the ring
+}
+
+/**
+ * @brief Handles a file transfer error message.
+ * @param message The file transfer error message.
+ */
+void ClientFileTransferHandler::HandleFileTransferError(const MessageView &message) {
+  // This client is the recipient of the error message
+  std::string error_msg_content(message.payload.begin(), message.payload.end());
+  std::cerr << "File transfer error from Client " << message.header.sender_id << ": " << error_msg_content << std::endl;
+
+  // Clean up the transfer the error is about, whichever direction it runs in
+  {
+    std::lock_guard<std::mutex> lock(outgoing_transfer_mutex_);
+    auto it = outgoing_transfers_.find(message.header.transfer_id);
+    if (it != outgoing_transfers_.end() && it->second->recipient_id == message.header.sender_id) {
+      if (it->second->file_stream.is_open()) {
+        it->second->file_stream.close();
+      }
+      std::cout << "Outgoing file transfer of '" << it->second->file_path << "' cancelled due to error." << std::endl;
+      outgoing_transfers_.erase(it);
+    }
+  }
+  {
+    std::lock_guard<std::mutex> lock(incoming_transfer_mutex_);
+    auto it = incoming_transfers_.find({message.header.sender_id, message.header.transfer_id});
+    if (it != incoming_transfers_.end()) {
+      if (it->second->file_stream.is_open()) {
+        it->second->file_stream.close();
+        // Optional: Delete partially received file
+        // std::filesystem::remove(...);
+      }
+      std::cout << "Incoming file transfer of '" << it->second->file_name << "' cancelled due to error." << std::endl;
+      incoming_transfers_.erase(it);
+    }
+  }
+}
+
+/**
+ * @brief Adds a message to the client's send queue.
+ * @param message The message, or file region, to add to the queue (moved in).
+ * @return True if the message was added to the queue, false otherwise.
+ */
+bool ClientFileTransferHandler::AddMessageToSendQueue(OutgoingMessage message) {
+  send_queue_.Push(std::move(message)); // Wakes the send thread if it is idle
+  return true;
+}
+
+/**
+ * @brief Queues a cumulative FILE_TRANSFER_ACK for the sender of an incoming transfer.
+ * @param sender_id The ID of the client sending the file.
+ * @param transfer_id The sender's ID for the transfer.
+ * @param acked_bytes The number of bytes received and written so far.
+ */
+void ClientFileTransferHandler::SendFileTransferAck(int sender_id, uint32_t transfer_id, size_t acked_bytes) {
+  std::string ack_payload = FormatFileTransferAck(acked_bytes);
+
+  Message ack_msg;
+  ack_msg.header.type = MessageType::FILE_TRANSFER_ACK;
+  ack_msg.header.sender_id = client_id_.load(); // This client is sending the ack
+  ack_msg.header.recipient_id = sender_id;      // Ack goes to the original sender
+  ack_msg.header.transfer_id = transfer_id;
+  ack_msg.payload.assign(ack_payload.begin(), ack_payload.end());
+  ack_msg.header.payload_size = ack_msg.payload.size();
+  AddMessageToSendQueue(std::move(ack_msg));
+}
+
+/**
+ * @brief Queues a file transfer error for the peer of a transfer.
+ * @param recipient_id The ID of the peer (-1 for the server).
+ * @param transfer_id The transfer the error is about.
+ * @param error_message The error description.
+ */
+void ClientFileTransferHandler::SendFileTransferError(int recipient_id, uint32_t transfer_id,
+                                                      const std::string &error_message) {
+  Message error_msg;
+  error_msg.header.type = MessageType::FILE_TRANSFER_ERROR;
+  error_msg.header.sender_id = client_id_.load(); // This client is sending the error
+  error_msg.header.recipient_id = recipient_id;
+  error_msg.header.transfer_id = transfer_id;
+  error_msg.payload.assign(error_message.begin(), error_message.end());
+  error_msg.header.payload_size = error_msg.payload.size();
+  AddMessageToSendQueue(std::move(error_msg));
+}
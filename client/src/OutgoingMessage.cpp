@@ -0,0 +1,179 @@
+#include "OutgoingMessage.h"
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#ifndef _WIN32
+#ifdef MAP_POPULATE
+// Fault the whole view in with one call instead of a page fault per few pages
+const int kMapFlags = MAP_SHARED | MAP_POPULATE;
+#else
+const int kMapFlags = MAP_SHARED;
+#endif
+#endif
+
+namespace {
+
+/**
+ * @brief Gets the alignment the start of a mapped view needs.
+ * @return The allocation granularity on Windows, the page size elsewhere.
+ */
+uint64_t GetMappingGranularity() {
+#ifdef _WIN32
+  SYSTEM_INFO info;
+  GetSystemInfo(&info);
+  return info.dwAllocationGranularity;
+#else
+  return static_cast<uint64_t>(sysconf(_SC_PAGESIZE));
+#endif
+}
+
+} // namespace
+
+/**
+ * @brief Takes ownership of a mapped view.
+ *
+ * @param base Start of the view, aligned as the system requires.
+ * @param map_size Length of the view.
+ * @param offset File offset of the first byte the view was made for (at or after base).
+ * @param size Number of bytes the view was made for, from offset.
+ */
+FileMapping::FileMapping(void *base, size_t map_size, uint64_t offset, size_t size)
+    : base_(base), map_size_(map_size), offset_(offset), size_(size),
+      data_(static_cast<const char *>(base) + (map_size - size)) {}
+
+/**
+ * @brief Destroys the FileMapping. Unmaps the view.
+ */
+FileMapping::~FileMapping() {
+#ifdef _WIN32
+  UnmapViewOfFile(base_);
+#else
+  munmap(base_, map_size_);
+#endif
+}
+
+/**
+ * @brief Checks whether a region of the file lies within the view.
+ *
+ * @param offset File offset of the region.
+ * @param size Length of the region.
+ * @return True if every byte of the region is mapped.
+ */
+bool FileMapping::Contains(uint64_t offset, size_t size) const {
+  return offset >= offset_ && offset - offset_ <= size_ && size <= size_ - (offset - offset_);
+}
+
+/**
+ * @brief Gets the mapped bytes at a file offset.
+ *
+ * @param offset A file offset within the view.
+ * @return Pointer to the byte at offset.
+ */
+const char *FileMapping::GetData(uint64_t offset) const {
+  return data_ + (offset - offset_);
+}
+
+/**
+ * @brief Opens a file for reading.
+ * @param file_path The path of the file; check IsOpen afterwards.
+ */
+SendFileSource::SendFileSource(const std::string &file_path) : open_(false) {
+#ifdef _WIN32
+  mapping_ = nullptr;
+  handle_ = CreateFileA(file_path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+                        FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+  open_ = (handle_ != INVALID_HANDLE_VALUE);
+#else
+  handle_ = open(file_path.c_str(), O_RDONLY | O_CLOEXEC);
+  open_ = (handle_ >= 0);
+#endif
+}
+
+/**
+ * @brief Destroys the SendFileSource. Closes the file.
+ */
+SendFileSource::~SendFileSource() {
+  if (open_) {
+#ifdef _WIN32
+    if (mapping_ != nullptr) {
+      CloseHandle(mapping_); // Views still mapped keep the mapping object alive
+    }
+    CloseHandle(handle_);
+#else
+    close(handle_);
+#endif
+  }
+}
+
+/**
+ * @brief Checks whether the file was opened successfully.
+ * @return True if the file is open.
+ */
+bool SendFileSource::IsOpen() const {
+  return open_;
+}
+
+/**
+ * @brief Gets the native handle of the open file.
+ * @return The native file handle.
+ */
+NativeFileHandle SendFileSource::GetNativeHandle() const {
+  return handle_;
+}
+
+/**
+ * @brief Maps a region of the file for reading, advising sequential access.
+ *
+ * The file must still be at least offset + size bytes long: reading a view
+ * past the end of a file truncated since is fatal on POSIX systems.
+ *
+ * @param offset File offset of the region.
+ * @param size Length of the region, not 0.
+ * @return The view, or null if the file is shorter or cannot be mapped.
+ */
+std::shared_ptr<const FileMapping> SendFileSource::Map(uint64_t offset, size_t size) {
+  if (!open_ || size == 0) {
+    return nullptr;
+  }
+  // Views start at a multiple of the granularity; the bytes before offset come along
+  uint64_t base_offset = offset - offset % GetMappingGranularity();
+  size_t map_size = size + static_cast<size_t>(offset - base_offset);
+
+#ifdef _WIN32
+  LARGE_INTEGER file_size;
+  if (!GetFileSizeEx(handle_, &file_size) || static_cast<uint64_t>(file_size.QuadPart) < offset + size) {
+    return nullptr;
+  }
+  if (mapping_ == nullptr) {
+    mapping_ = CreateFileMappingA(handle_, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if (mapping_ == nullptr) {
+      return nullptr;
+    }
+  }
+  // The file was opened with FILE_FLAG_SEQUENTIAL_SCAN, which also drives the view's read-ahead
+  void *base = MapViewOfFile(mapping_, FILE_MAP_READ, static_cast<DWORD>(base_offset >> 32),
+                             static_cast<DWORD>(base_offset & 0xFFFFFFFFu), map_size);
+  if (base == nullptr) {
+    return nullptr;
+  }
+#else
+  struct stat file_stat;
+  if (fstat(handle_, &file_stat) != 0 || static_cast<uint64_t>(file_stat.st_size) < offset + size) {
+    return nullptr;
+  }
+  void *base = mmap(nullptr, map_size, PROT_READ, kMapFlags, handle_, static_cast<off_t>(base_offset));
+  if (base == MAP_FAILED) {
+    return nullptr;
+  }
+  // Read ahead aggressively and drop pages behind us: the view is read once, front to back
+  madvise(base, map_size, MADV_SEQUENTIAL);
+#endif
+  return std::make_shared<FileMapping>(base, map_size, offset, size);
+}
@@ -0,0 +1,45 @@
+#include "SendQueue.h"
+
+#include <utility>
+
+#include "MessagePriority.h"
+
+/**
+ * @brief Constructs an empty queue.
+ * @param bulk_quantum Bytes a file transfer may send per round robin turn.
+ */
+SendQueue::SendQueue(size_t bulk_quantum) : scheduler_(bulk_quantum) {}
+
+/**
+ * @brief Queues a message according to its priority class.
+ * @param message The message (moved in).
+ */
+void SendQueue::Push(OutgoingMessage message) {
+  const MessageHeader &header = message.message.header;
+  MessagePriority priority = GetMessagePriority(header.type);
+  uint64_t flow = GetMessageFlow(header);
+  size_t size = header.payload_size;
+  scheduler_.Push(std::move(message), priority, flow, size);
+}
+
+/**
+ * @brief Removes the message that should be sent next.
+ * @param message Receives the message.
+ * @return False if the queue is empty.
+ */
+bool SendQueue::Pop(OutgoingMessage &message) {
+  PriorityScheduler<OutgoingMessage>::Entry entry;
+  if (!scheduler_.Pop(entry)) {
+    return false;
+  }
+  message = std::move(entry.item);
+  return true;
+}
+
+/**
+ * @brief Checks whether any messages are queued.
+ * @return True if the queue is empty.
+ */
+bool SendQueue::Empty() const {
+  return scheduler_.Empty();
+}
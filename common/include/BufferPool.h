@@ -0,0 +1,163 @@
+#ifndef BUFFER_POOL_H_
+#define BUFFER_POOL_H_
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <vector>
+
+/**
+ * @brief Process-wide, size-classed pool of raw byte blocks.
+ *
+ * Requests are rounded up to one of kSizeClassCount power-of-four classes
+ * (64 B .. 4 MiB). Each thread keeps a small cache of free blocks per class,
+ * so a block released and re-acquired on the same thread never touches a
+ * lock. Caches spill to and refill from a bounded, mutex-protected global
+ * free list in batches, which lets blocks freed by one thread (e.g. the
+ * writer that sent a frame) be reused by another (the reader that builds the
+ * next one). Requests above the largest class go straight to the heap.
+ *
+ * The pool is a leaked singleton so it stays usable from static and
+ * thread-local destructors during shutdown.
+ */
+class BufferPool {
+public:
+  /**
+   * @brief Counters describing how well the pool is doing.
+   */
+  struct Stats {
+    uint64_t allocations = 0; /**< Total Allocate calls. */
+    uint64_t local_hits = 0;  /**< Served from the calling thread's cache. */
+    uint64_t global_hits = 0; /**< Served by refilling from the global free list. */
+    uint64_t misses = 0;      /**< Pooled size, but a fresh heap block was needed. */
+    uint64_t oversize = 0;    /**< Larger than the largest class, never pooled. */
+    uint64_t releases = 0;    /**< Total Deallocate calls. */
+
+    /**
+     * @brief Fraction of allocations served without a heap allocation.
+     * @return The hit rate in [0, 1].
+     */
+    double HitRate() const;
+  };
+
+  /**
+   * @brief Gets the process-wide pool.
+   * @return The pool instance.
+   */
+  static BufferPool &Instance();
+
+  BufferPool(const BufferPool &) = delete;
+  BufferPool &operator=(const BufferPool &) = delete;
+
+  /**
+   * @brief Allocates a block of at least the given size.
+   *
+   * @param size The number of bytes needed.
+   * @return The block; aligned like ::operator new.
+   */
+  void *Allocate(size_t size);
+
+  /**
+   * @brief Returns a block obtained from Allocate.
+   *
+   * @param block The block.
+   * @param size The size that was passed to Allocate.
+   */
+  void Deallocate(void *block, size_t size);
+
+  /**
+   * @brief Gets a snapshot of the pool counters.
+   * @return The statistics.
+   */
+  Stats GetStats() const;
+
+  /**
+   * @brief Gets the size class serving a request.
+   *
+   * @param size The requested size.
+   * @return The class index, or kSizeClassCount if the size is not pooled.
+   */
+  static size_t SizeClassFor(size_t size);
+
+  /**
+   * @brief Gets the block size of a size class.
+   *
+   * @param size_class The class index.
+   * @return The block size in bytes.
+   */
+  static size_t ClassBlockSize(size_t size_class);
+
+  static const size_t kSizeClassCount = 9; // 64 B * 4^0 .. 64 B * 4^8 (4 MiB)
+  static const size_t kMinBlockSize = 64;
+  static const size_t kRefillBatch = 8; // Blocks moved from the global list to a cache at once
+
+private:
+  friend class BufferPoolThreadCache;
+
+  BufferPool();
+
+  /**
+   * @brief Moves up to count free blocks of a class from the global list.
+   *
+   * @param size_class The class index.
+   * @param out Receives the blocks.
+   * @param count Maximum number of blocks to take.
+   */
+  void TakeFromGlobal(size_t size_class, std::vector<void *> &out, size_t count);
+
+  /**
+   * @brief Gives a free block back to the global list, freeing it if the
+   * list is already at its limit.
+   *
+   * @param size_class The class index.
+   * @param block The block.
+   */
+  void ReturnToGlobal(size_t size_class, void *block);
+
+  /**
+   * @brief Global free list of one size class.
+   */
+  struct GlobalFreeList {
+    std::mutex mutex;
+    std::vector<void *> blocks;
+    size_t max_blocks = 0;
+  };
+
+  GlobalFreeList global_[kSizeClassCount];
+
+  std::atomic<uint64_t> allocations_;
+  std::atomic<uint64_t> local_hits_;
+  std::atomic<uint64_t> global_hits_;
+  std::atomic<uint64_t> misses_;
+  std::atomic<uint64_t> oversize_;
+  std::atomic<uint64_t> releases_;
+};
+
+/**
+ * @brief Standard allocator drawing from BufferPool.
+ *
+ * Stateless, so all instances compare equal and containers can swap and move
+ * buffers freely.
+ */
+template <typename T> class PoolAllocator {
+public:
+  using value_type = T;
+
+  PoolAllocator() noexcept = default;
+  template <typename U> PoolAllocator(const PoolAllocator<U> &) noexcept {}
+
+  T *allocate(size_t count) { return static_cast<T *>(BufferPool::Instance().Allocate(count * sizeof(T))); }
+
+  void deallocate(T *block, size_t count) noexcept { BufferPool::Instance().Deallocate(block, count * sizeof(T)); }
+
+  template <typename U> bool operator==(const PoolAllocator<U> &) const noexcept { return true; }
+  template <typename U> bool operator!=(const PoolAllocator<U> &) const noexcept { return false; }
+};
+
+/**
+ * @brief Byte buffer whose storage comes from BufferPool.
+ */
+using PooledBuffer = std::vector<char, PoolAllocator<char>>;
+
+#endif // BUFFER_POOL_H_
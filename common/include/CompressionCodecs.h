@@ -0,0 +1,34 @@
+#ifndef COMPRESSION_CODECS_H_
+#define COMPRESSION_CODECS_H_
+
+#include <string>
+#include <vector>
+
+#include "ICompressionCodec.h"
+
+/**
+ * @brief Looks up a codec compiled into this build.
+ *
+ * @param id The codec's wire identifier.
+ * @return The shared codec instance, or nullptr if it is not available
+ * (always for CompressionCodecId::NONE).
+ */
+const ICompressionCodec *FindCompressionCodec(CompressionCodecId id);
+
+/**
+ * @brief Looks up a codec compiled into this build by name.
+ *
+ * @param name The codec's name, e.g. "lz4".
+ * @return The shared codec instance, or nullptr if it is not available.
+ */
+const ICompressionCodec *FindCompressionCodec(const std::string &name);
+
+/**
+ * @brief Lists the codecs compiled into this build.
+ *
+ * @return The codec IDs, fastest first (LZ4, zstd, zlib), which is also the
+ * order in which they are preferred.
+ */
+std::vector<CompressionCodecId> GetAvailableCompressionCodecs();
+
+#endif // COMPRESSION_CODECS_H_
@@ -0,0 +1,22 @@
+#ifndef CRC32C_H_
+#define CRC32C_H_
+
+#include <cstddef>
+#include <cstdint>
+
+/**
+ * @brief Computes the CRC-32C (Castagnoli) checksum of a buffer.
+ *
+ * Uses the SSE4.2 crc32 instruction when the CPU supports it (checked once
+ * at run time) and a slicing-by-8 table implementation otherwise. Both give
+ * identical results, so peers with and without the instruction interoperate.
+ *
+ * @param data The bytes to checksum.
+ * @param size Number of bytes.
+ * @param crc The checksum of the preceding bytes, to continue a running
+ * checksum, or 0 to start a new one.
+ * @return The checksum of all bytes so far.
+ */
+uint32_t Crc32c(const void *data, size_t size, uint32_t crc = 0);
+
+#endif // CRC32C_H_
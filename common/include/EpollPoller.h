@@ -0,0 +1,97 @@
+#ifndef EPOLL_POLLER_H_
+#define EPOLL_POLLER_H_
+
+#ifdef __linux__
+
+#include "IPoller.h"
+
+#include <vector>
+
+#include <sys/epoll.h>
+
+/**
+ * @brief Linux epoll implementation of the IPoller interface.
+ *
+ * Uses level-triggered epoll so that a handler which stops reading early is
+ * notified again on the next Wait. Wakeups are delivered through an eventfd
+ * registered with the epoll instance.
+ */
+class EpollPoller : public IPoller {
+public:
+  /**
+   * @brief Constructs a new EpollPoller, creating the epoll instance and wakeup eventfd.
+   */
+  EpollPoller();
+
+  /**
+   * @brief Destroys the EpollPoller and closes its descriptors.
+   */
+  ~EpollPoller() override;
+
+  EpollPoller(const EpollPoller &) = delete;
+  EpollPoller &operator=(const EpollPoller &) = delete;
+
+  /**
+   * @brief Starts watching a socket.
+   *
+   * @param handle The socket file descriptor.
+   * @param events Bitmask of PollEventFlags to watch for.
+   * @return True if the socket was added, false otherwise.
+   */
+  bool Add(NativeSocketHandle handle, uint32_t events) override;
+
+  /**
+   * @brief Changes the set of events watched for a socket.
+   *
+   * @param handle The socket file descriptor.
+   * @param events Bitmask of PollEventFlags to watch for.
+   * @return True if the interest set was updated, false otherwise.
+   */
+  bool Modify(NativeSocketHandle handle, uint32_t events) override;
+
+  /**
+   * @brief Stops watching a socket.
+   *
+   * @param handle The socket file descriptor.
+   * @return True if the socket was removed, false otherwise.
+   */
+  bool Remove(NativeSocketHandle handle) override;
+
+  /**
+   * @brief Waits for readiness on the watched sockets.
+   *
+   * @param events Output vector that receives the ready sockets.
+   * @param timeout_ms Maximum time to wait in milliseconds, or -1 to wait indefinitely.
+   * @return The number of ready sockets, or -1 on error.
+   */
+  int Wait(std::vector<PollEvent> &events, int timeout_ms) override;
+
+  /**
+   * @brief Interrupts Wait by signalling the eventfd.
+   */
+  void Wakeup() override;
+
+  /**
+   * @brief Checks if the epoll instance was created successfully.
+   *
+   * @return True if the poller is usable, false otherwise.
+   */
+  bool IsValid() const override;
+
+private:
+  /**
+   * @brief Translates PollEventFlags into epoll event bits.
+   *
+   * @param events Bitmask of PollEventFlags.
+   * @return The corresponding EPOLL* bitmask.
+   */
+  static uint32_t ToEpollEvents(uint32_t events);
+
+  int epoll_fd_;                           /**< The epoll instance. */
+  int wakeup_fd_;                          /**< eventfd used to interrupt Wait. */
+  std::vector<epoll_event> ready_events_; /**< Scratch buffer for epoll_wait. */
+};
+
+#endif // __linux__
+
+#endif // EPOLL_POLLER_H_
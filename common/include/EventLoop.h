@@ -0,0 +1,340 @@
+#ifndef EVENT_LOOP_H_
+#define EVENT_LOOP_H_
+
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "IEventHandler.h"
+#include "IPoller.h"
+#include "ISocket.h"
+#include "TimerWheel.h"
+
+/**
+ * @brief Mechanism an EventLoop waits for readiness with.
+ */
+enum class IoBackend {
+  POLLER,   /**< The platform's readiness multiplexer: epoll, poll(2) or WSAPoll. */
+  IO_URING, /**< io_uring, batched with the wait, with completion-mode sockets (Linux); falls back to POLLER. */
+};
+
+/**
+ * @brief A single-threaded reactor multiplexing many non-blocking sockets.
+ *
+ * The loop owns an IPoller and a thread that waits for readiness and invokes
+ * the IEventHandler registered for each ready socket. All changes to the set
+ * of registered sockets are executed on the loop thread between poll
+ * iterations, so a handler never receives a callback after Unregister returns.
+ *
+ * Each registration also has one timer (ScheduleTimer), kept in a
+ * TimerWheel, so connection timeouts cost no thread and no system call of
+ * their own: the poll simply wakes up when the next tick is due.
+ *
+ * Where the poller supports it (SupportsCompletionIo), a socket can instead
+ * be registered in completion mode: the loop receives into its own buffers
+ * and hands the bytes to OnReceived, and writes started with Send report
+ * back through OnSent, so the socket costs no readiness poll at all.
+ *
+ * Such a loop also reads and writes files (SupportsFileIo): ReadFile and
+ * WriteFile queue a request on the loop's ring, and its callback runs on the
+ * loop thread once the kernel completed it, so disk I/O neither blocks the
+ * loop nor needs a thread pool of its own.
+ */
+class EventLoop {
+public:
+  /**
+   * @brief Receives the outcome of a ReadFile or WriteFile: the bytes
+   * transferred, 0 at the end of the file, or -errno.
+   */
+  using FileIoCallback = std::function<void(int result)>;
+
+  /**
+   * @brief Constructs a new EventLoop.
+   *
+   * @param backend How to wait for readiness. IO_URING falls back to the
+   * platform's poller, with a warning, where it is not built or the kernel
+   * does not offer it.
+   */
+  explicit EventLoop(IoBackend backend = IoBackend::POLLER);
+
+  /**
+   * @brief Destroys the EventLoop. Stops the loop thread if running.
+   */
+  ~EventLoop();
+
+  EventLoop(const EventLoop &) = delete;
+  EventLoop &operator=(const EventLoop &) = delete;
+
+  /**
+   * @brief Starts the loop thread.
+   *
+   * @return True if the loop is running, false if the poller could not be created.
+   */
+  bool Start();
+
+  /**
+   * @brief Stops the loop thread and waits for it to exit.
+   *
+   * Handlers that are still registered are dropped without being notified.
+   */
+  void Stop();
+
+  /**
+   * @brief Registers a socket with the loop.
+   *
+   * Safe to call from any thread; the registration takes effect on the next
+   * loop iteration.
+   *
+   * @param handle The native socket handle (must be in non-blocking mode).
+   * @param handler The handler receiving callbacks for this socket.
+   * @param events Bitmask of PollEventFlags to watch for.
+   */
+  void Register(NativeSocketHandle handle, IEventHandler *handler, uint32_t events);
+
+  /**
+   * @brief Checks whether sockets can be registered in completion mode.
+   * @return True if RegisterCompletion and Send are available.
+   */
+  bool SupportsCompletionIo() const;
+
+  /**
+   * @brief Registers a socket whose reads and writes the loop completes itself.
+   *
+   * Safe to call from any thread. A watched kPollReadable delivers what the
+   * socket receives to OnReceived; a watched kPollWritable calls OnWritable
+   * while no Send is in flight, and the handler then writes with Send.
+   * Requires SupportsCompletionIo.
+   *
+   * @param handle The native socket handle (must be in non-blocking mode).
+   * @param handler The handler receiving callbacks for this socket.
+   * @param events Bitmask of PollEventFlags to watch for.
+   */
+  void RegisterCompletion(NativeSocketHandle handle, IEventHandler *handler, uint32_t events);
+
+  /**
+   * @brief Starts a gathered write on a socket registered in completion mode.
+   *
+   * Loop thread only. The result arrives in OnSent; until then, or until
+   * Unregister returns, the bytes must stay valid and no other Send may be
+   * started for the socket.
+   *
+   * @param handle The native socket handle.
+   * @param handler The handler the socket was registered with.
+   * @param buffers The regions to write, in order.
+   * @param count Number of regions.
+   * @return True if the write was queued.
+   */
+  bool Send(NativeSocketHandle handle, IEventHandler *handler, const IoBuffer *buffers, size_t count);
+
+  /**
+   * @brief Checks whether files can be read and written through the loop.
+   * @return True if ReadFile and WriteFile complete on the loop thread.
+   */
+  bool SupportsFileIo() const;
+
+  /**
+   * @brief Starts a positional read from a file.
+   *
+   * Safe to call from any thread. on_done runs on the loop thread once the
+   * read completed; until then the buffer must stay valid. Reads may be
+   * short. If the loop is stopped, or its poller refuses the request,
+   * on_done gets -ECANCELED instead. Requires SupportsFileIo.
+   *
+   * @param file The open file.
+   * @param data Receives the bytes.
+   * @param size Number of bytes to read at most.
+   * @param offset File offset of the first byte.
+   * @param on_done Receives the outcome.
+   */
+  void ReadFile(NativeFileHandle file, char *data, size_t size, uint64_t offset, FileIoCallback on_done);
+
+  /**
+   * @brief Starts a positional write to a file.
+   *
+   * Like ReadFile; the bytes must stay valid until on_done runs, and writes
+   * may be short as well.
+   *
+   * @param file The open file.
+   * @param data The bytes to write.
+   * @param size Number of bytes.
+   * @param offset File offset of the first byte.
+   * @param on_done Receives the outcome.
+   */
+  void WriteFile(NativeFileHandle file, const char *data, size_t size, uint64_t offset, FileIoCallback on_done);
+
+  /**
+   * @brief Changes the set of events watched for a registered socket.
+   *
+   * Safe to call from any thread.
+   *
+   * @param handle The native socket handle.
+   * @param handler The handler the socket was registered with.
+   * @param events Bitmask of PollEventFlags to watch for.
+   */
+  void UpdateInterest(NativeSocketHandle handle, IEventHandler *handler, uint32_t events);
+
+  /**
+   * @brief Unregisters a socket from the loop.
+   *
+   * When called from another thread, blocks until the loop thread has
+   * processed the removal, which guarantees that no callback for the handler
+   * is running or will run afterwards. The registration is only removed if it
+   * still belongs to the given handler, so a stale handle that was reused by
+   * a newer connection is left untouched.
+   *
+   * @param handle The native socket handle.
+   * @param handler The handler the socket was registered with.
+   */
+  void Unregister(NativeSocketHandle handle, IEventHandler *handler);
+
+  /**
+   * @brief Arms the timer of a registered socket, replacing any earlier deadline.
+   *
+   * The handler's OnTimer runs on the loop thread once the delay has passed
+   * (rounded up to the wheel's tick; a delay of 0 runs it on the next loop
+   * iteration), unless the socket is unregistered or the timer re-armed
+   * first. Safe to call from any thread.
+   *
+   * @param handle The native socket handle.
+   * @param handler The handler the socket was registered with.
+   * @param delay_ms Milliseconds from now.
+   */
+  void ScheduleTimer(NativeSocketHandle handle, IEventHandler *handler, uint64_t delay_ms);
+
+  /**
+   * @brief Checks whether the caller is running on the loop thread.
+   *
+   * @return True if called from within a loop callback.
+   */
+  bool IsInLoopThread() const;
+
+private:
+  /**
+   * @brief A registered socket.
+   */
+  struct Registration {
+    IEventHandler *handler; /**< Receives the callbacks. */
+    uint64_t timer_id;      /**< The armed timer, 0 if none. */
+  };
+
+  /**
+   * @brief A timer in the wheel; stale once its registration has another timer_id.
+   */
+  struct Timer {
+    NativeSocketHandle handle;
+    uint64_t timer_id;
+  };
+
+  /**
+   * @brief A file read or write on its way to the poller.
+   */
+  struct FileIo {
+    bool write;
+    NativeFileHandle file;
+    char *data; /**< Only read from by a write. */
+    size_t size;
+    uint64_t offset;
+    FileIoCallback on_done;
+  };
+
+  /**
+   * @brief The main loop: waits for readiness and dispatches callbacks.
+   */
+  void Run();
+
+  /**
+   * @brief Hands a file request to the poller, from the loop thread.
+   *
+   * Safe to call from any thread.
+   *
+   * @param io The request.
+   */
+  void SubmitFileIo(FileIo io);
+
+  /**
+   * @brief Starts a file request on the poller. Loop thread only; on any
+   * other thread the loop is stopped and the request is cancelled.
+   *
+   * @param io The request.
+   */
+  void StartFileIo(FileIo io);
+
+  /**
+   * @brief Runs the callback of a finished file request.
+   *
+   * @param request The request's tag.
+   * @param result Its outcome.
+   */
+  void CompleteFileIo(uint64_t request, int result);
+
+  /**
+   * @brief Waits for the file requests still in flight, once the loop is stopping.
+   *
+   * Their callbacks own the buffers the kernel is using.
+   */
+  void DrainFileIo();
+
+  /**
+   * @brief Queues a task to be executed on the loop thread and wakes the loop.
+   *
+   * If the loop is not running, the task is executed immediately on the
+   * calling thread.
+   *
+   * @param task The task to execute.
+   */
+  void RunInLoop(std::function<void()> task);
+
+  /**
+   * @brief Executes all tasks queued by RunInLoop.
+   */
+  void RunPendingTasks();
+
+  /**
+   * @brief Removes a registration if it still belongs to the given handler.
+   *
+   * Must be called on the loop thread (or when the loop is stopped).
+   *
+   * @param handle The native socket handle.
+   * @param handler The handler the socket was registered with.
+   */
+  void RemoveRegistration(NativeSocketHandle handle, IEventHandler *handler);
+
+  /**
+   * @brief Arms a registration's timer. Must be called on the loop thread.
+   *
+   * @param handle The native socket handle.
+   * @param handler The handler the socket was registered with.
+   * @param deadline_ms Time the timer is due, in milliseconds of the
+   * Metrics::NowNanoseconds clock.
+   */
+  void ArmTimer(NativeSocketHandle handle, IEventHandler *handler, uint64_t deadline_ms);
+
+  /**
+   * @brief Calls OnTimer for every registration whose timer is due.
+   */
+  void RunTimers();
+
+  // Declared before poller_, so that the buffers the callbacks keep alive outlive the ring
+  std::unordered_map<uint64_t, FileIoCallback> file_requests_; /**< Loop-thread owned file requests in flight. */
+  uint64_t next_file_request_;                                  /**< Loop-thread owned tag of the next one. */
+
+  std::unique_ptr<IPoller> poller_;                                /**< Platform readiness multiplexer. */
+  std::unordered_map<NativeSocketHandle, Registration> handlers_; /**< Loop-thread owned registrations. */
+  TimerWheel<Timer> timers_;                                       /**< Loop-thread owned registration timers. */
+  std::vector<Timer> due_timers_; /**< Loop-thread owned timers armed already due, run without waiting for a tick. */
+  uint64_t next_timer_id_;                                         /**< Loop-thread owned timer generation. */
+
+  std::mutex tasks_mutex_;                         /**< Protects pending_tasks_ and running_ transitions. */
+  std::vector<std::function<void()>> pending_tasks_; /**< Work queued for the loop thread. */
+
+  std::thread loop_thread_;          /**< Thread executing Run. */
+  std::thread::id loop_thread_id_;   /**< Id of loop_thread_, for IsInLoopThread. */
+  std::atomic<bool> running_;        /**< True between Start and the end of Stop. */
+  std::atomic<bool> stop_requested_; /**< Flag to make the loop thread exit. */
+};
+
+#endif // EVENT_LOOP_H_
@@ -0,0 +1,77 @@
+#ifndef ICOMPRESSION_CODEC_H_
+#define ICOMPRESSION_CODEC_H_
+
+#include <cstddef>
+#include <cstdint>
+
+/**
+ * @brief Wire identifiers of the payload compression codecs.
+ *
+ * The value is sent in front of every compressed payload, so it must never
+ * change for an existing codec.
+ */
+enum class CompressionCodecId : uint8_t {
+  NONE = 0, /**< Payloads are sent as is. */
+  ZLIB = 1, /**< zlib (deflate). */
+  LZ4 = 2,  /**< LZ4 block format. */
+  ZSTD = 3, /**< Zstandard. */
+};
+
+// Number of CompressionCodecId values, for tables indexed by codec
+const size_t kCompressionCodecCount = 4;
+
+/**
+ * @brief Interface for a block compression algorithm used on message payloads.
+ *
+ * Codecs are stateless and shared by all connections, so every method must be
+ * safe to call from several threads at once. Implementations are obtained
+ * through FindCompressionCodec and only exist for the libraries the build
+ * found.
+ */
+class ICompressionCodec {
+public:
+  virtual ~ICompressionCodec() = default;
+
+  /**
+   * @brief Gets the codec's wire identifier.
+   * @return The codec ID.
+   */
+  virtual CompressionCodecId GetId() const = 0;
+
+  /**
+   * @brief Gets the codec's name, as used in the connection handshake.
+   * @return The lowercase name, e.g. "zlib".
+   */
+  virtual const char *GetName() const = 0;
+
+  /**
+   * @brief Gets the worst-case compressed size of an input.
+   * @param size The input size in bytes.
+   * @return The capacity Compress needs to never fail for lack of room.
+   */
+  virtual size_t GetMaxCompressedSize(size_t size) const = 0;
+
+  /**
+   * @brief Compresses a block.
+   *
+   * @param data The input bytes.
+   * @param size Number of input bytes.
+   * @param out Destination buffer.
+   * @param capacity Size of the destination buffer.
+   * @return The compressed size, or 0 on failure.
+   */
+  virtual size_t Compress(const char *data, size_t size, char *out, size_t capacity) const = 0;
+
+  /**
+   * @brief Decompresses a block whose original size is known.
+   *
+   * @param data The compressed bytes.
+   * @param size Number of compressed bytes.
+   * @param out Destination buffer of exactly original_size bytes.
+   * @param original_size The size of the uncompressed block.
+   * @return False if the data is corrupt or does not expand to original_size bytes.
+   */
+  virtual bool Decompress(const char *data, size_t size, char *out, size_t original_size) const = 0;
+};
+
+#endif // ICOMPRESSION_CODEC_H_
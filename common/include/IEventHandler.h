@@ -0,0 +1,55 @@
+#ifndef IEVENT_HANDLER_H_
+#define IEVENT_HANDLER_H_
+
+/**
+ * @brief Interface for objects that react to socket readiness events.
+ *
+ * Implementations are registered with an EventLoop together with a socket
+ * handle. The callbacks are always invoked on the loop's own thread.
+ */
+class IEventHandler {
+public:
+  /**
+   * @brief Virtual destructor.
+   */
+  virtual ~IEventHandler() = default;
+
+  /**
+   * @brief Called when the socket has data available to read.
+   */
+  virtual void OnReadable() = 0;
+
+  /**
+   * @brief Called when the socket can accept more outgoing data.
+   */
+  virtual void OnWritable() = 0;
+
+  /**
+   * @brief Called when the peer hung up or the socket reported an error.
+   */
+  virtual void OnHangup() = 0;
+
+  /**
+   * @brief Called when the timer armed with EventLoop::ScheduleTimer expires.
+   */
+  virtual void OnTimer() {}
+
+  /**
+   * @brief Completion mode: called with bytes the loop received on the socket.
+   *
+   * See EventLoop::RegisterCompletion.
+   *
+   * @param data The bytes, valid only during the call.
+   * @param result Number of bytes, 0 once the peer closed the stream, or -errno.
+   */
+  virtual void OnReceived(const char * /*data*/, int /*result*/) {}
+
+  /**
+   * @brief Completion mode: called when a write started with EventLoop::Send finished.
+   *
+   * @param result Number of bytes written, or -errno.
+   */
+  virtual void OnSent(int /*result*/) {}
+};
+
+#endif // IEVENT_HANDLER_H_
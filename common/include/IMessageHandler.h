@@ -5,6 +5,7 @@
 #include <vector>
 
 #include "Message.h"
+#include "MessageView.h"
 
 // Forward declarations to avoid circular dependencies
 class IClientHandler;
@@ -30,14 +31,58 @@ public:
    *
    * This method is called by the client handler when a complete message is
    * received. The handler should process the message based on its type.
+   * The payload points into the connection's receive buffer and is only
+   * valid for the duration of the call.
    *
-   * @param message The deserialized Message object received.
+   * @param message View of the received message.
    * @param sender The client handler that received the message.
    * @param server A pointer to the Server instance (for actions like
    * broadcasting).
    * @return True if the message was handled successfully, false otherwise.
    */
-  virtual bool HandleMessage(const Message &message, IClientHandler *sender, Server *server) = 0;
+  virtual bool HandleMessage(const MessageView &message, IClientHandler *sender, Server *server) = 0;
+
+  /**
+   * @brief Gets the message types this handler consumes.
+   *
+   * A dispatcher such as CompositeMessageHandler routes these types straight
+   * to the handler. Handlers that return an empty list (the default) are
+   * treated as legacy handlers and offered every message in order.
+   *
+   * @return The handled message types.
+   */
+  virtual std::vector<MessageType> GetHandledTypes() const { return {}; }
+
+  /**
+   * @brief Tells whether a message type is cheap enough to handle on the I/O thread.
+   *
+   * When the server hands messages to worker threads (see
+   * ServerOptions::worker_threads), types for which this returns true are
+   * handled right on the receiving thread as long as none of the
+   * connection's earlier messages is still waiting for a worker. Only claim
+   * types handled without blocking or heavy work; the default is false.
+   *
+   * @param type The message type.
+   * @return True if the type may be handled inline.
+   */
+  virtual bool IsInlineSafe(MessageType type) const {
+    (void)type;
+    return false;
+  }
+
+  /**
+   * @brief Called once a client has disconnected and was removed from the server.
+   *
+   * Lets handlers release (or keep aside) per-client state. May be called
+   * on any thread; the default does nothing.
+   *
+   * @param client_id The ID of the disconnected client.
+   * @param server A pointer to the Server instance.
+   */
+  virtual void OnClientDisconnected(int client_id, Server *server) {
+    (void)client_id;
+    (void)server;
+  }
 };
 
 #endif // IMESSAGE_HANDLER_H_
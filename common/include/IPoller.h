@@ -0,0 +1,174 @@
+#ifndef IPOLLER_H_
+#define IPOLLER_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "ISocket.h"
+
+/**
+ * @brief Readiness flags reported and requested through an IPoller.
+ */
+enum PollEventFlags : uint32_t {
+  kPollReadable = 1u << 0, /**< Data (or an incoming connection) can be read. */
+  kPollWritable = 1u << 1, /**< The send buffer has room for more data. */
+  kPollHangup = 1u << 2,   /**< The peer hung up or the socket is in an error state. */
+  kPollReceived = 1u << 3, /**< Completion mode: a receive finished; see PollEvent::data and result. */
+  kPollSent = 1u << 4,     /**< Completion mode: a Send finished; see PollEvent::result. */
+  kPollFileDone = 1u << 5, /**< A ReadFile or WriteFile finished; see PollEvent::request and result. */
+};
+
+/**
+ * @brief A single readiness notification returned by IPoller::Wait.
+ */
+struct PollEvent {
+  NativeSocketHandle handle;  /**< The socket that became ready. */
+  uint32_t events;            /**< Bitmask of PollEventFlags. */
+  const char *data = nullptr; /**< kPollReceived: the bytes, valid until the next Wait. */
+  int result = 0;             /**< kPollReceived/kPollSent/kPollFileDone: bytes transferred, 0 at end, or -errno. */
+  uint64_t request = 0;       /**< kPollFileDone: the tag the file request was started with. */
+};
+
+/**
+ * @brief Interface for an OS readiness multiplexer (epoll, poll, WSAPoll).
+ *
+ * This interface abstracts the platform-specific mechanism used to wait for
+ * readiness on many non-blocking sockets at once. Add, Modify, Remove and Wait
+ * must all be called from the same thread; only Wakeup may be called from any
+ * thread.
+ *
+ * A poller may also complete socket I/O itself (see SupportsCompletion). A
+ * socket added with AddCompletion then reports what it received instead of
+ * readability: a watched kPollReadable keeps a receive in flight whose data
+ * arrives as kPollReceived events. A watched kPollWritable is reported while
+ * no Send is in flight, and each Send ends in a kPollSent event.
+ *
+ * Such a poller may read and write files, too (see SupportsFileIo): each
+ * ReadFile or WriteFile ends in a kPollFileDone event carrying the tag it was
+ * started with, so disk I/O completes in the same Wait as the sockets.
+ */
+class IPoller {
+public:
+  virtual ~IPoller() = default;
+
+  /**
+   * @brief Starts watching a socket.
+   *
+   * @param handle The native socket handle.
+   * @param events Bitmask of PollEventFlags to watch for.
+   * @return true if the socket was added, false otherwise.
+   */
+  virtual bool Add(NativeSocketHandle handle, uint32_t events) = 0;
+
+  /**
+   * @brief Changes the set of events watched for a socket.
+   *
+   * @param handle The native socket handle.
+   * @param events Bitmask of PollEventFlags to watch for.
+   * @return true if the interest set was updated, false otherwise.
+   */
+  virtual bool Modify(NativeSocketHandle handle, uint32_t events) = 0;
+
+  /**
+   * @brief Stops watching a socket.
+   *
+   * @param handle The native socket handle.
+   * @return true if the socket was removed, false otherwise.
+   */
+  virtual bool Remove(NativeSocketHandle handle) = 0;
+
+  /**
+   * @brief Waits until at least one watched socket is ready, the timeout
+   * expires or Wakeup is called.
+   *
+   * @param events Output vector that receives the ready sockets (cleared first).
+   * @param timeout_ms Maximum time to wait in milliseconds, or -1 to wait indefinitely.
+   * @return The number of ready sockets, or -1 if an error occurred.
+   */
+  virtual int Wait(std::vector<PollEvent> &events, int timeout_ms) = 0;
+
+  /**
+   * @brief Interrupts a concurrent or the next call to Wait.
+   *
+   * Safe to call from any thread.
+   */
+  virtual void Wakeup() = 0;
+
+  /**
+   * @brief Checks whether the poller can complete socket I/O itself.
+   * @return True if AddCompletion and Send are available.
+   */
+  virtual bool SupportsCompletion() const { return false; }
+
+  /**
+   * @brief Starts watching a socket whose reads and writes go through the poller.
+   *
+   * @param handle The native socket handle.
+   * @param events Bitmask of PollEventFlags to watch for.
+   * @return true if the socket was added, false otherwise.
+   */
+  virtual bool AddCompletion(NativeSocketHandle /*handle*/, uint32_t /*events*/) { return false; }
+
+  /**
+   * @brief Starts a gathered write on a socket added with AddCompletion.
+   *
+   * At most one Send may be in flight per socket. The bytes must stay valid
+   * until its kPollSent event, or until Remove returns if that comes first.
+   *
+   * @param handle The native socket handle.
+   * @param buffers The regions to write, in order.
+   * @param count Number of regions.
+   * @return true if the write was queued, false otherwise.
+   */
+  virtual bool Send(NativeSocketHandle /*handle*/, const IoBuffer * /*buffers*/, size_t /*count*/) { return false; }
+
+  /**
+   * @brief Checks whether the poller can read and write files itself.
+   * @return True if ReadFile and WriteFile are available.
+   */
+  virtual bool SupportsFileIo() const { return false; }
+
+  /**
+   * @brief Starts a positional read from a file.
+   *
+   * The buffer must stay valid until the request's kPollFileDone event.
+   *
+   * @param file The open file.
+   * @param data Receives the bytes.
+   * @param size Number of bytes to read at most.
+   * @param offset File offset of the first byte.
+   * @param request Tag the kPollFileDone event carries back.
+   * @return true if the read was queued, false otherwise.
+   */
+  virtual bool ReadFile(NativeFileHandle /*file*/, char * /*data*/, size_t /*size*/, uint64_t /*offset*/,
+                        uint64_t /*request*/) {
+    return false;
+  }
+
+  /**
+   * @brief Starts a positional write to a file.
+   *
+   * The bytes must stay valid until the request's kPollFileDone event.
+   *
+   * @param file The open file.
+   * @param data The bytes to write.
+   * @param size Number of bytes.
+   * @param offset File offset of the first byte.
+   * @param request Tag the kPollFileDone event carries back.
+   * @return true if the write was queued, false otherwise.
+   */
+  virtual bool WriteFile(NativeFileHandle /*file*/, const char * /*data*/, size_t /*size*/, uint64_t /*offset*/,
+                         uint64_t /*request*/) {
+    return false;
+  }
+
+  /**
+   * @brief Checks if the poller was created successfully.
+   *
+   * @return true if the poller is usable, false otherwise.
+   */
+  virtual bool IsValid() const = 0;
+};
+
+#endif // IPOLLER_H_
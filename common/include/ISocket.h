@@ -1,9 +1,63 @@
 #ifndef ISOCKET_H
 #define ISOCKET_H
 
+#include <cstdint>
 #include <string>
 #include <vector>
 
+/**
+ * @brief Platform-specific handle type of the underlying OS socket.
+ *
+ * On Windows this holds a SOCKET value, on POSIX systems a file descriptor.
+ */
+#ifdef _WIN32
+using NativeSocketHandle = uintptr_t;
+#else
+using NativeSocketHandle = int;
+#endif
+
+/**
+ * @brief Platform-specific handle type of an open file.
+ *
+ * On Windows this holds a HANDLE, on POSIX systems a file descriptor.
+ */
+#ifdef _WIN32
+using NativeFileHandle = void *;
+#else
+using NativeFileHandle = int;
+#endif
+
+/**
+ * @brief A contiguous region of bytes used for scatter/gather I/O.
+ */
+struct IoBuffer {
+  const void *data; /**< Start of the region. */
+  size_t size;      /**< Length of the region in bytes. */
+};
+
+/**
+ * @brief Socket options settable through ISocket::SetOption.
+ */
+enum class SocketOption {
+  NO_DELAY,            /**< Boolean: send small segments at once, disabling Nagle's algorithm (TCP_NODELAY). */
+  CORK,                /**< Boolean: hold back partial segments until cleared (TCP_CORK / TCP_NOPUSH). */
+  KEEP_ALIVE,          /**< Boolean: probe idle connections (SO_KEEPALIVE). */
+  SEND_BUFFER_SIZE,    /**< Kernel send buffer size in bytes (SO_SNDBUF). */
+  RECEIVE_BUFFER_SIZE, /**< Kernel receive buffer size in bytes (SO_RCVBUF). */
+  REUSE_PORT,          /**< Boolean, before Bind: let several sockets listen on one port (SO_REUSEPORT). */
+  SEND_TIMEOUT,        /**< Milliseconds a blocking send may wait without progress, 0 for ever (SO_SNDTIMEO). */
+};
+
+/**
+ * @brief A set of socket options applied together with ISocket::ApplyOptions.
+ */
+struct SocketOptions {
+  bool no_delay = true;        /**< Favour small-message latency; writes are coalesced by the callers. */
+  bool keep_alive = false;     /**< Detect dead peers on idle connections. */
+  int send_buffer_size = 0;    /**< SO_SNDBUF in bytes, 0 to keep the OS default. */
+  int receive_buffer_size = 0; /**< SO_RCVBUF in bytes, 0 to keep the OS default. */
+};
+
 /**
  * @brief The ISocket class is an interface for socket communication.
  *
@@ -63,6 +117,33 @@ public:
    */
   virtual int Send(const void *data, size_t size) = 0;
 
+  /**
+   * @brief Sends several buffers with a single gathered write.
+   *
+   * Like Send, this may write fewer bytes than the total size of all buffers;
+   * the caller is responsible for resubmitting the remainder.
+   *
+   * @param buffers Array of buffers to send, in order.
+   * @param count Number of entries in the array.
+   * @return The number of bytes sent, or -1 if an error occurred.
+   */
+  virtual int SendV(const IoBuffer *buffers, size_t count) = 0;
+
+  /**
+   * @brief Sends a region of an open file through the socket.
+   *
+   * Implementations hand the file to the kernel where possible (sendfile,
+   * TransmitFile), so the bytes are never copied into user space. Like Send,
+   * this may write fewer bytes than requested; the caller resubmits the rest.
+   *
+   * @param file The file to read from; its file position is not relied upon.
+   * @param offset Offset of the first byte to send.
+   * @param size Number of bytes to send.
+   * @return The number of bytes sent, 0 if the file ends at offset, or -1 if
+   * an error occurred.
+   */
+  virtual int SendFile(NativeFileHandle file, uint64_t offset, size_t size) = 0;
+
   /**
    * @brief Receives data from the socket.
    *
@@ -78,12 +159,105 @@ public:
    */
   virtual void Close() = 0;
 
+  /**
+   * @brief Shuts down both directions of the connection without releasing
+   * the socket handle.
+   *
+   * Unlike Close, this is safe to call while another thread is blocked in
+   * Receive on the same socket: that call returns 0 as if the peer had
+   * disconnected.
+   */
+  virtual void Shutdown() = 0;
+
   /**
    * @brief Checks if the socket is valid/open.
    *
    * @return true if the socket is valid, false otherwise.
    */
   virtual bool IsValid() const = 0;
+
+  /**
+   * @brief Switches the socket between blocking and non-blocking mode.
+   *
+   * @param non_blocking True to enable non-blocking mode, false to restore blocking mode.
+   * @return true if the mode was changed successfully, false otherwise.
+   */
+  virtual bool SetNonBlocking(bool non_blocking) = 0;
+
+  /**
+   * @brief Checks whether the last failed Send/Receive on the calling thread
+   * failed only because the operation would have blocked.
+   *
+   * Only meaningful for non-blocking sockets, immediately after Send or
+   * Receive returned -1.
+   *
+   * @return true if the operation should be retried once the socket is ready.
+   */
+  virtual bool WouldBlock() const = 0;
+
+  /**
+   * @brief Gets the native OS handle of the socket.
+   *
+   * Used to register the socket with an event poller.
+   *
+   * @return The native socket handle.
+   */
+  virtual NativeSocketHandle GetNativeHandle() const = 0;
+
+  /**
+   * @brief Checks whether the native handle carries the bytes of Send and
+   * Receive as they are.
+   *
+   * True for a plain TCP socket, whose reads and writes an event loop may
+   * then complete itself; false for layers such as TLS that transform the
+   * stream.
+   *
+   * @return true if the stream on the native handle is untransformed.
+   */
+  virtual bool HasPlainStream() const { return false; }
+
+  /**
+   * @brief Sets a socket option.
+   *
+   * Buffer sizes should be set before Connect or Listen, since the TCP
+   * window scale is fixed during the handshake.
+   *
+   * @param option The option to set.
+   * @param value The new value (0 or 1 for boolean options).
+   * @return true if the option was set, false if it failed or the platform
+   * does not support it (e.g. CORK on Windows).
+   */
+  virtual bool SetOption(SocketOption option, int value) = 0;
+
+  /**
+   * @brief Reads a socket option.
+   *
+   * @param option The option to read.
+   * @param value Receives the current value. Linux reports buffer sizes
+   * doubled, including its bookkeeping overhead.
+   * @return true if the option was read, false otherwise.
+   */
+  virtual bool GetOption(SocketOption option, int &value) const = 0;
+
+  /**
+   * @brief Applies a set of options, skipping buffer sizes left at 0.
+   *
+   * A failure does not stop the remaining options from being applied.
+   *
+   * @param options The options to apply.
+   * @return true if every option was set.
+   */
+  bool ApplyOptions(const SocketOptions &options) {
+    bool applied = SetOption(SocketOption::NO_DELAY, options.no_delay ? 1 : 0);
+    applied = SetOption(SocketOption::KEEP_ALIVE, options.keep_alive ? 1 : 0) && applied;
+    if (options.send_buffer_size > 0) {
+      applied = SetOption(SocketOption::SEND_BUFFER_SIZE, options.send_buffer_size) && applied;
+    }
+    if (options.receive_buffer_size > 0) {
+      applied = SetOption(SocketOption::RECEIVE_BUFFER_SIZE, options.receive_buffer_size) && applied;
+    }
+    return applied;
+  }
 };
 
 #endif // ISOCKET_H
\ No newline at end of file
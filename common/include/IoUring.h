@@ -0,0 +1,141 @@
+#ifndef IO_URING_H_
+#define IO_URING_H_
+
+#ifdef __linux__
+
+#include <cstddef>
+#include <cstdint>
+
+#include <linux/io_uring.h>
+
+/**
+ * @brief A minimal io_uring instance, driven with the raw system calls.
+ *
+ * Owns the ring file descriptor and the shared submission and completion
+ * queues. Requests are prepared in place with GetSqe and handed to the
+ * kernel in batches by Submit or SubmitAndWait, so preparing any number of
+ * requests costs no system call of its own; completions are consumed with
+ * ForEachCompletion.
+ *
+ * Not thread-safe: one thread prepares, submits and reaps.
+ */
+class IoUring {
+public:
+  /**
+   * @brief Creates the ring.
+   * @param entries Submission queue size (rounded up to a power of two by the kernel).
+   */
+  explicit IoUring(unsigned entries);
+
+  /**
+   * @brief Unmaps the queues and closes the ring.
+   */
+  ~IoUring();
+
+  IoUring(const IoUring &) = delete;
+  IoUring &operator=(const IoUring &) = delete;
+
+  /**
+   * @brief Checks if the ring was created and supports what SubmitAndWait needs.
+   * @return True if the ring is usable.
+   */
+  bool IsValid() const;
+
+  /**
+   * @brief Gets a zeroed submission queue entry to fill in.
+   *
+   * If the queue is full, what it holds is submitted first.
+   *
+   * @return The entry, or nullptr if the kernel takes nothing (the caller
+   * should reap completions and retry).
+   */
+  io_uring_sqe *GetSqe();
+
+  /**
+   * @brief Submits the prepared entries without waiting.
+   * @return The number of entries the kernel took, or -1 on error.
+   */
+  int Submit();
+
+  /**
+   * @brief Submits the prepared entries and waits for at least one completion.
+   *
+   * @param timeout_ms Maximum time to wait in milliseconds, or -1 to wait indefinitely.
+   * @return 0 if completions are ready or the wait timed out or was interrupted, -1 on error.
+   */
+  int SubmitAndWait(int timeout_ms);
+
+#ifdef IORING_RECV_MULTISHOT
+  /**
+   * @brief Registers a ring of provided buffers for receives to pick from.
+   *
+   * @param ring The ring: page aligned, with room for entries io_uring_buf slots.
+   * @param entries Number of slots, a power of two.
+   * @param group_id Buffer group that receives name in sqe->buf_group.
+   * @return True if the kernel took the ring (Linux 5.19 and later).
+   */
+  bool RegisterBufferRing(io_uring_buf_ring *ring, unsigned entries, uint16_t group_id);
+#endif
+
+  /**
+   * @brief Consumes every completion ready now.
+   *
+   * @param handler Called as handler(const io_uring_cqe &) for each completion, in order.
+   * @return The number of completions consumed.
+   */
+  template <typename Handler> size_t ForEachCompletion(Handler handler) {
+    unsigned head = *cq_head_;
+    unsigned tail = __atomic_load_n(cq_tail_, __ATOMIC_ACQUIRE);
+    size_t count = 0;
+    while (head != tail) {
+      handler(cqes_[head & *cq_mask_]);
+      ++head;
+      ++count;
+      if (head == tail) {
+        // Release the slots before looking again, so a full queue refills
+        __atomic_store_n(cq_head_, head, __ATOMIC_RELEASE);
+        tail = __atomic_load_n(cq_tail_, __ATOMIC_ACQUIRE);
+      }
+    }
+    __atomic_store_n(cq_head_, head, __ATOMIC_RELEASE);
+    return count;
+  }
+
+private:
+  /**
+   * @brief Calls io_uring_enter for the prepared entries.
+   *
+   * @param min_complete Completions to wait for.
+   * @param flags IORING_ENTER_* flags.
+   * @param arg Extended argument, or nullptr.
+   * @param arg_size Size of arg.
+   * @return The kernel's result, -errno on failure.
+   */
+  int Enter(unsigned min_complete, unsigned flags, const void *arg, size_t arg_size);
+
+  int ring_fd_;
+  unsigned features_; /**< IORING_FEAT_* bits reported by the kernel. */
+
+  void *sq_ring_;
+  size_t sq_ring_size_;
+  void *cq_ring_; /**< Same mapping as sq_ring_ where the kernel supports a single mmap. */
+  size_t cq_ring_size_;
+  io_uring_sqe *sqes_;
+  size_t sqes_size_;
+
+  unsigned *sq_head_;
+  unsigned *sq_tail_;
+  unsigned *sq_mask_;
+  unsigned *sq_array_;
+  unsigned sq_entries_;
+  unsigned sqe_tail_; /**< Entries prepared so far; published to *sq_tail_ on submission. */
+
+  unsigned *cq_head_;
+  unsigned *cq_tail_;
+  unsigned *cq_mask_;
+  io_uring_cqe *cqes_;
+};
+
+#endif // __linux__
+
+#endif // IO_URING_H_
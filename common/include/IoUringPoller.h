@@ -0,0 +1,354 @@
+#ifndef IO_URING_POLLER_H_
+#define IO_URING_POLLER_H_
+
+#ifdef __linux__
+
+#include "IPoller.h"
+#include "IoUring.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+#include <sys/socket.h>
+#include <sys/uio.h>
+
+/**
+ * @brief IPoller implementation on io_uring (Linux 5.11+), with
+ * completion-mode sockets where the kernel has provided buffer rings (5.19+).
+ *
+ * Each watched socket has one one-shot IORING_OP_POLL_ADD in flight. A poll
+ * that fires is re-armed at the next Wait, and arming checks readiness at
+ * once, so sockets report readiness level-triggered, like EpollPoller.
+ *
+ * What the poller saves is system calls: arming, re-arming and widening an
+ * interest set are queued in the submission ring and handed to the kernel by
+ * the same io_uring_enter that waits, instead of one epoll_ctl each.
+ * Narrowing an interest set (a connection whose send queue drained) costs
+ * nothing at all: events nobody watches any more are dropped when they
+ * arrive. Only Remove enters the kernel at once, so a socket closed right
+ * after it is not kept open by its poll request.
+ *
+ * A socket added with AddCompletion has no poll request at all. While its
+ * readability is watched, a multishot IORING_OP_RECV stays armed that picks
+ * buffers from a ring registered with the kernel, so one request receives
+ * for as long as the connection is read, and each completion brings its
+ * data along; buffers go back to the ring at the next Wait. Sends are
+ * IORING_OP_SENDMSG requests gathering straight from the caller's buffers;
+ * the kernel waits for room in the socket itself, so writability needs no
+ * poll either and is simply reported while no send is in flight. Kernels
+ * without multishot receives (5.19) fall back to one receive per completion.
+ *
+ * File reads and writes are IORING_OP_READ and IORING_OP_WRITE requests at an
+ * explicit offset. The kernel completes them from its own workers where the
+ * page cache cannot, so the loop thread never blocks on the disk.
+ */
+class IoUringPoller : public IPoller {
+public:
+  /**
+   * @brief Constructs a new IoUringPoller, creating the ring and wakeup eventfd.
+   */
+  IoUringPoller();
+
+  /**
+   * @brief Destroys the IoUringPoller and closes its descriptors.
+   */
+  ~IoUringPoller() override;
+
+  IoUringPoller(const IoUringPoller &) = delete;
+  IoUringPoller &operator=(const IoUringPoller &) = delete;
+
+  /**
+   * @brief Starts watching a socket.
+   *
+   * @param handle The socket file descriptor.
+   * @param events Bitmask of PollEventFlags to watch for.
+   * @return True; a socket the kernel rejects reports a hangup instead.
+   */
+  bool Add(NativeSocketHandle handle, uint32_t events) override;
+
+  /**
+   * @brief Changes the set of events watched for a socket.
+   *
+   * @param handle The socket file descriptor.
+   * @param events Bitmask of PollEventFlags to watch for.
+   * @return True if the socket is watched, false otherwise.
+   */
+  bool Modify(NativeSocketHandle handle, uint32_t events) override;
+
+  /**
+   * @brief Stops watching a socket.
+   *
+   * @param handle The socket file descriptor.
+   * @return True if the socket was removed, false otherwise.
+   */
+  bool Remove(NativeSocketHandle handle) override;
+
+  /**
+   * @brief Submits the queued poll requests and waits for readiness.
+   *
+   * @param events Output vector that receives the ready sockets.
+   * @param timeout_ms Maximum time to wait in milliseconds, or -1 to wait indefinitely.
+   * @return The number of ready sockets, or -1 on error.
+   */
+  int Wait(std::vector<PollEvent> &events, int timeout_ms) override;
+
+  /**
+   * @brief Interrupts Wait by signalling the eventfd.
+   */
+  void Wakeup() override;
+
+  /**
+   * @brief Checks if the ring and the eventfd were created successfully.
+   *
+   * @return True if the poller is usable, false otherwise.
+   */
+  bool IsValid() const override;
+
+  /**
+   * @brief Checks whether the provided buffer ring was registered.
+   * @return True if AddCompletion and Send are available.
+   */
+  bool SupportsCompletion() const override;
+
+  /**
+   * @brief Starts watching a socket whose reads and writes go through the ring.
+   *
+   * @param handle The socket file descriptor.
+   * @param events Bitmask of PollEventFlags to watch for.
+   * @return True if completion mode is supported.
+   */
+  bool AddCompletion(NativeSocketHandle handle, uint32_t events) override;
+
+  /**
+   * @brief Queues a gathered write on a completion-mode socket.
+   *
+   * @param handle The socket file descriptor.
+   * @param buffers The regions to write, in order.
+   * @param count Number of regions.
+   * @return False if the socket is not in completion mode, a send is in
+   * flight already or the submission queue is full.
+   */
+  bool Send(NativeSocketHandle handle, const IoBuffer *buffers, size_t count) override;
+
+  /**
+   * @brief Checks whether file requests are available.
+   * @return True if the ring is usable.
+   */
+  bool SupportsFileIo() const override;
+
+  /**
+   * @brief Queues a positional read from a file.
+   *
+   * @param file The file descriptor.
+   * @param data Receives the bytes.
+   * @param size Number of bytes to read at most.
+   * @param offset File offset of the first byte.
+   * @param request Tag the kPollFileDone event carries back.
+   * @return True; a request the ring cannot take now goes to the kernel with the next Wait.
+   */
+  bool ReadFile(NativeFileHandle file, char *data, size_t size, uint64_t offset, uint64_t request) override;
+
+  /**
+   * @brief Queues a positional write to a file.
+   *
+   * @param file The file descriptor.
+   * @param data The bytes to write.
+   * @param size Number of bytes.
+   * @param offset File offset of the first byte.
+   * @param request Tag the kPollFileDone event carries back.
+   * @return True; a request the ring cannot take now goes to the kernel with the next Wait.
+   */
+  bool WriteFile(NativeFileHandle file, const char *data, size_t size, uint64_t offset, uint64_t request) override;
+
+private:
+  /**
+   * @brief The message of a socket's send request; the kernel reads it until the request completes.
+   */
+  struct PendingSend {
+    msghdr header;
+    std::vector<iovec> iovecs;
+  };
+
+  /**
+   * @brief An anonymous memory mapping, unmapped when destroyed.
+   */
+  struct Mapping {
+    Mapping() = default;
+    ~Mapping();
+    Mapping(const Mapping &) = delete;
+    Mapping &operator=(const Mapping &) = delete;
+
+    void *address = nullptr; /**< Start of the mapping, nullptr if none. */
+    size_t size = 0;
+  };
+
+  /**
+   * @brief A completion copied out of the ring to be handled by the next Wait.
+   */
+  struct Completion {
+    uint64_t user_data;
+    int32_t res;
+    uint32_t flags;
+  };
+
+  /**
+   * @brief A file read or write waiting for a submission queue slot.
+   */
+  struct FileRequest {
+    uint8_t opcode; /**< IORING_OP_READ or IORING_OP_WRITE. */
+    int fd;
+    uint64_t address;
+    uint32_t size;
+    uint64_t offset;
+    uint64_t request; /**< Caller's tag. */
+  };
+
+  /**
+   * @brief A watched socket.
+   */
+  struct Watch {
+    uint32_t events = 0;               /**< PollEventFlags the caller watches. */
+    uint32_t generation = 0;           /**< Identifies the current poll or receive request; older ones are stale. */
+    uint32_t armed_events = 0;         /**< Poll mask of the request in flight (kPollReadable for a receive) or 0. */
+    bool completion = false;           /**< Added with AddCompletion. */
+    bool sending = false;              /**< Completion mode: a send request is in flight. */
+    bool end_of_stream = false;        /**< Completion mode: the peer closed, nothing more to receive. */
+    bool writable_queued = false;      /**< Completion mode: listed in to_report_. */
+    std::unique_ptr<PendingSend> send; /**< Completion mode: message of the last send, kept for the next one. */
+  };
+
+  /**
+   * @brief Queues a poll request for a socket with its current interest set.
+   *
+   * @param handle The socket file descriptor.
+   * @param watch Its state.
+   * @return False if the submission queue is full.
+   */
+  bool Arm(NativeSocketHandle handle, Watch &watch);
+
+  /**
+   * @brief Queues a receive request for a completion-mode socket.
+   *
+   * @param handle The socket file descriptor.
+   * @param watch Its state.
+   * @return False if the submission queue is full.
+   */
+  bool ArmReceive(NativeSocketHandle handle, Watch &watch);
+
+  /**
+   * @brief Lists a completion-mode socket for a writability report if it is due one.
+   *
+   * @param handle The socket file descriptor.
+   * @param watch Its state.
+   */
+  void QueueWritable(NativeSocketHandle handle, Watch &watch);
+
+  /**
+   * @brief Queues a file read or write, or keeps it for the next Wait if the queue is full.
+   * @param request The request.
+   */
+  void QueueFileRequest(const FileRequest &request);
+
+  /**
+   * @brief Hands the kept file requests to the ring, as far as it has slots.
+   */
+  void SubmitFileRequests();
+
+  /**
+   * @brief Queues the cancellation of a receive or send request.
+   * @param user_data Tag of the request.
+   */
+  void QueueCancel(uint64_t user_data);
+
+  /**
+   * @brief Waits until the kernel is done with a socket's send request.
+   *
+   * Other completions that arrive meanwhile are kept for the next Wait.
+   *
+   * @param handle The socket file descriptor.
+   * @param watch Its state.
+   */
+  void DrainSend(NativeSocketHandle handle, Watch &watch);
+
+  /**
+   * @brief Turns a completion into ready events.
+   *
+   * @param completion The completion.
+   * @param events Receives the events it reports.
+   */
+  void HandleCompletion(const Completion &completion, std::vector<PollEvent> &events);
+
+  /**
+   * @brief Turns the completion of a receive request into ready events.
+   *
+   * @param handle The socket file descriptor.
+   * @param watch Its state.
+   * @param completion The completion.
+   * @param events Receives the events it reports.
+   */
+  void HandleReceive(NativeSocketHandle handle, Watch &watch, const Completion &completion,
+                     std::vector<PollEvent> &events);
+
+  /**
+   * @brief Hands the buffers of dispatched receives back to the kernel.
+   */
+  void RecycleBuffers();
+
+  /**
+   * @brief Allocates the receive buffers and registers their ring.
+   * @return True if completion mode is available.
+   */
+  bool SetUpBuffers();
+
+  /**
+   * @brief Takes the generation for the next request.
+   * @return A generation that is neither 0 nor has either of the top two bits set.
+   */
+  uint32_t NextGeneration();
+
+  /**
+   * @brief Queues the cancellation of the poll request in flight for a socket.
+   *
+   * @param handle The socket file descriptor.
+   * @param watch Its state.
+   */
+  void Cancel(NativeSocketHandle handle, Watch &watch);
+
+  /**
+   * @brief Queues a poll request for the wakeup eventfd.
+   */
+  void ArmWakeup();
+
+  /**
+   * @brief Translates PollEventFlags into poll(2) event bits.
+   *
+   * @param events Bitmask of PollEventFlags.
+   * @return The corresponding POLL* bitmask.
+   */
+  static uint32_t ToPollMask(uint32_t events);
+
+  // Declared before ring_, so that they are destroyed after it: the kernel uses
+  // both until the ring is closed
+  Mapping buffer_ring_;             /**< The provided buffer ring. */
+  std::unique_ptr<char[]> buffers_; /**< The receive buffers, kReceiveBufferCount of kReceiveBufferSize bytes. */
+
+  IoUring ring_;                                      /**< The ring the requests go through. */
+  int wakeup_fd_;                                     /**< eventfd used to interrupt Wait. */
+  std::unordered_map<NativeSocketHandle, Watch> watches_; /**< Watched sockets. */
+  std::vector<NativeSocketHandle> to_arm_;            /**< Sockets whose poll or receive is queued at the next Wait. */
+  std::vector<NativeSocketHandle> to_report_;         /**< Completion-mode sockets to report writable. */
+  std::vector<uint16_t> to_recycle_;                  /**< Buffers handed out by the last Wait. */
+  std::vector<Completion> deferred_;                  /**< Completions reaped by DrainSend. */
+  std::vector<FileRequest> to_submit_;                /**< File requests waiting for a queue slot, oldest first. */
+  uint32_t next_generation_;                          /**< Generation given to the next request. */
+  uint16_t buffer_tail_;                              /**< Our copy of the buffer ring's tail. */
+  bool multishot_;                                    /**< Receives stay armed; cleared on kernels without. */
+  bool completion_supported_;                         /**< The buffer ring is registered. */
+};
+
+#endif // __linux__
+
+#endif // IO_URING_POLLER_H_
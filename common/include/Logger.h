@@ -0,0 +1,231 @@
+#ifndef LOGGER_H_
+#define LOGGER_H_
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <thread>
+
+/**
+ * @brief Enum defining the severity of a log message.
+ */
+enum class LogLevel : int {
+  DEBUG = 0, /**< Per-message tracing, compiled out by default. */
+  INFO,      /**< Connection and transfer lifecycle events. Written to stdout. */
+  WARNING,   /**< Recoverable problems. Written to stderr. */
+  ERROR,     /**< Failures that drop a message or a connection. Written to stderr. */
+  NONE,      /**< Not a level: threshold that disables all logging. */
+};
+
+// Messages below this level are removed at compile time; set it with
+// -DCHAT_LOG_MIN_LEVEL=<0..4> (see CHAT_LOG_MIN_LEVEL in common/CMakeLists.txt)
+#ifndef CHAT_LOG_MIN_LEVEL
+#define CHAT_LOG_MIN_LEVEL 1
+#endif
+
+/**
+ * @brief Asynchronous process-wide logger.
+ *
+ * Callers format their message and push it into a bounded lock-free ring
+ * buffer; a background thread writes the messages out in order and flushes
+ * once per batch, so logging neither blocks on the console nor serializes
+ * threads on a stream lock. If the ring is full the message is dropped and
+ * counted rather than stalling the caller.
+ *
+ * Use the CHAT_LOG_* macros rather than calling Write directly: they skip
+ * formatting for disabled levels and compile out levels below
+ * CHAT_LOG_MIN_LEVEL.
+ */
+class Logger {
+public:
+  static const size_t kDefaultCapacity = 8192;
+
+  /**
+   * @brief Gets the process-wide logger, starting its thread on first use.
+   *
+   * The logger is never destroyed; it is drained and stopped at exit.
+   *
+   * @return The logger.
+   */
+  static Logger &Instance();
+
+  Logger(const Logger &) = delete;
+  Logger &operator=(const Logger &) = delete;
+
+  /**
+   * @brief Sets the runtime threshold; messages below it are discarded.
+   * @param level The lowest level that is still logged.
+   */
+  void SetLevel(LogLevel level) { level_.store(level, std::memory_order_relaxed); }
+
+  /**
+   * @brief Checks whether messages of a level are logged.
+   * @param level The level.
+   * @return True if the level is at or above the runtime threshold.
+   */
+  bool IsEnabled(LogLevel level) const {
+    return static_cast<int>(level) >= static_cast<int>(level_.load(std::memory_order_relaxed));
+  }
+
+  /**
+   * @brief Queues a formatted message. Never blocks.
+   *
+   * After Shutdown, the message is written synchronously instead.
+   *
+   * @param level The message level.
+   * @param text The message, without a trailing newline.
+   */
+  void Write(LogLevel level, std::string text);
+
+  /**
+   * @brief Blocks until every message queued before the call is written.
+   */
+  void Flush();
+
+  /**
+   * @brief Writes out everything queued and stops the background thread.
+   */
+  void Shutdown();
+
+  /**
+   * @brief Gets the number of messages dropped because the ring was full.
+   * @return The dropped message count.
+   */
+  uint64_t GetDroppedCount() const { return dropped_.load(std::memory_order_relaxed); }
+
+private:
+  /**
+   * @brief One ring buffer cell; sequence tells producers and the consumer whose turn it is.
+   */
+  struct Slot {
+    std::atomic<size_t> sequence;
+    LogLevel level;
+    std::string text;
+  };
+
+  /**
+   * @brief Constructs the logger and starts its thread.
+   * @param capacity Ring size, rounded up to a power of two.
+   */
+  explicit Logger(size_t capacity);
+
+  /**
+   * @brief The main loop for the logging thread.
+   */
+  void Run();
+
+  /**
+   * @brief Writes out every published message. Logging thread only.
+   * @return The number of messages written.
+   */
+  size_t Drain();
+
+  /**
+   * @brief Writes one message to stdout or stderr, depending on its level.
+   *
+   * @param level The message level.
+   * @param text The message.
+   */
+  static void Emit(LogLevel level, const std::string &text);
+
+  std::unique_ptr<Slot[]> slots_;
+  size_t mask_;                        /**< Ring size minus one. */
+  std::atomic<size_t> enqueue_pos_;    /**< Next cell producers claim. */
+  size_t dequeue_pos_;                 /**< Next cell the logging thread reads. */
+  std::atomic<size_t> written_pos_;    /**< Messages written out so far, for Flush. */
+  std::atomic<LogLevel> level_;        /**< Runtime threshold. */
+  std::atomic<uint64_t> dropped_;      /**< Messages lost to a full ring. */
+  std::atomic<bool> running_;          /**< False once Shutdown has started. */
+  std::atomic<bool> consumer_waiting_; /**< The logging thread is (about to be) asleep. */
+  std::mutex mutex_;                   /**< Only taken to sleep, to wake up, or by Flush. */
+  std::condition_variable consumer_cv_;
+  std::condition_variable flushed_cv_;
+  std::thread thread_;
+};
+
+/**
+ * @brief Lets a log call site through a limited number of times per period.
+ *
+ * Used by CHAT_LOG_RATE_LIMITED so that an error repeated in a tight loop
+ * (e.g. accept failing while out of file descriptors) cannot flood the log;
+ * the next message that gets through reports how many were suppressed.
+ */
+class LogRateLimiter {
+public:
+  static const uint32_t kDefaultBurst = 10;
+  static const uint64_t kDefaultPeriodMs = 1000;
+
+  /**
+   * @brief Constructs a limiter.
+   *
+   * @param burst Messages allowed per period.
+   * @param period_ms Length of a period in milliseconds.
+   */
+  explicit LogRateLimiter(uint32_t burst = kDefaultBurst, uint64_t period_ms = kDefaultPeriodMs)
+      : burst_(burst), period_ms_(period_ms), period_start_ms_(0), count_(0), suppressed_(0) {}
+
+  /**
+   * @brief Checks whether one more message may be logged.
+   *
+   * @param suppressed Receives the number of messages suppressed since the
+   * last one that was allowed.
+   * @return True if the message may be logged.
+   */
+  bool Allow(uint64_t &suppressed);
+
+private:
+  uint32_t burst_;
+  uint64_t period_ms_;
+  std::atomic<uint64_t> period_start_ms_;
+  std::atomic<uint32_t> count_;
+  std::atomic<uint64_t> suppressed_;
+};
+
+/**
+ * @brief Evaluates to true if messages of a level are logged.
+ */
+#define CHAT_LOG_ENABLED(level)                                                                                        \
+  (static_cast<int>(level) >= CHAT_LOG_MIN_LEVEL && Logger::Instance().IsEnabled(level))
+
+/**
+ * @brief Logs a message built with stream insertions, e.g. CHAT_LOG(LogLevel::INFO, "Client " << id).
+ */
+#define CHAT_LOG(level, message)                                                                                       \
+  do {                                                                                                                 \
+    if (CHAT_LOG_ENABLED(level)) {                                                                                     \
+      std::ostringstream chat_log_stream;                                                                              \
+      chat_log_stream << message;                                                                                      \
+      Logger::Instance().Write(level, chat_log_stream.str());                                                          \
+    }                                                                                                                  \
+  } while (0)
+
+/**
+ * @brief Like CHAT_LOG, but at most LogRateLimiter::kDefaultBurst times per second for this call site.
+ */
+#define CHAT_LOG_RATE_LIMITED(level, message)                                                                          \
+  do {                                                                                                                 \
+    if (CHAT_LOG_ENABLED(level)) {                                                                                     \
+      static LogRateLimiter chat_log_limiter;                                                                          \
+      uint64_t chat_log_suppressed = 0;                                                                                \
+      if (chat_log_limiter.Allow(chat_log_suppressed)) {                                                               \
+        std::ostringstream chat_log_stream;                                                                            \
+        chat_log_stream << message;                                                                                    \
+        if (chat_log_suppressed > 0) {                                                                                 \
+          chat_log_stream << " (" << chat_log_suppressed << " similar messages suppressed)";                          \
+        }                                                                                                              \
+        Logger::Instance().Write(level, chat_log_stream.str());                                                        \
+      }                                                                                                                \
+    }                                                                                                                  \
+  } while (0)
+
+#define CHAT_LOG_DEBUG(message) CHAT_LOG(LogLevel::DEBUG, message)
+#define CHAT_LOG_INFO(message) CHAT_LOG(LogLevel::INFO, message)
+#define CHAT_LOG_WARNING(message) CHAT_LOG(LogLevel::WARNING, message)
+#define CHAT_LOG_ERROR(message) CHAT_LOG(LogLevel::ERROR, message)
+
+#endif // LOGGER_H_
@@ -2,10 +2,13 @@
 #define MESSAGE_H_
 
 #include <cstddef> // For size_t
+#include <cstdint> // For fixed-width integers
 #include <cstring> // For memcpy
 #include <string>
+#include <utility>
 #include <vector>
 
+#include "BufferPool.h"
 #include "MessageType.h"
 
 /**
@@ -16,30 +19,47 @@ struct MessageHeader {
   int sender_id;       /**< The ID of the client sending the message. */
   int recipient_id;    /**< The ID of the target client (or a special value for broadcast). */
   size_t payload_size; /**< The size of the message payload in bytes. */
+  uint8_t flags;       /**< Optional per-message flags (compact wire format only). */
+  uint32_t transfer_id; /**< File transfer the message belongs to, 0 if none (compact wire format only). */
+  uint32_t checksum;    /**< CRC-32C of the payload if flags has kCompactFlagChecksum (compact wire format only). */
 };
 
-// Define a fixed-size header for all messages
-const size_t kMessageHeaderSize = sizeof(MessageHeader);
+/**
+ * @brief Fixed-size header of the legacy (version 1) wire format.
+ *
+ * The original protocol memcpy'd this native struct, so its size and byte
+ * order depend on the platform. It is still accepted from, and sent to,
+ * peers that have not negotiated the compact format.
+ */
+struct LegacyWireHeader {
+  MessageType type;
+  int sender_id;
+  int recipient_id;
+  size_t payload_size;
+};
+
+// Size of the legacy (version 1) fixed header
+const size_t kMessageHeaderSize = sizeof(LegacyWireHeader);
 
 /**
  * @brief Structure representing a complete message (header + payload).
  */
 struct Message {
-  MessageHeader header;      /**< The message header. */
-  std::vector<char> payload; /**< The message payload data. */
+  MessageHeader header; /**< The message header. */
+  PooledBuffer payload; /**< The message payload data (pool allocated). */
 
   /**
    * @brief Default constructor.
    */
-  Message() : header({MessageType::UNKNOWN, -1, -1, 0}) {}
+  Message() : header({MessageType::UNKNOWN, -1, -1, 0, 0, 0, 0}) {}
 
   /**
    * @brief Constructor with header and payload.
    * @param msg_header The message header.
    * @param msg_payload The message payload data.
    */
-  Message(const MessageHeader &msg_header, const std::vector<char> &msg_payload)
-      : header(msg_header), payload(msg_payload) {}
+  Message(const MessageHeader &msg_header, PooledBuffer msg_payload)
+      : header(msg_header), payload(std::move(msg_payload)) {}
 };
 
 #endif // MESSAGE_H_
@@ -0,0 +1,166 @@
+#ifndef MESSAGE_FRAMER_H_
+#define MESSAGE_FRAMER_H_
+
+#include <cstddef>
+#include <vector>
+
+#include "BufferPool.h"
+#include "MessageView.h"
+
+/**
+ * @brief Enum describing why a MessageFramer stopped framing.
+ */
+enum class FramingError {
+  NONE,            /**< The stream is fine so far. */
+  INVALID_HEADER,  /**< A header could not be decoded. */
+  FRAME_TOO_LARGE, /**< A frame (or its expanded payload) exceeds the maximum frame size. */
+  INVALID_PAYLOAD, /**< A compressed payload did not expand. */
+};
+
+/**
+ * @brief Splits a received byte stream into messages without copying them.
+ *
+ * The framer owns a single contiguous receive buffer. Callers ask it for a
+ * write window (PrepareRead), receive straight into it (CommitRead) and then
+ * pull complete messages with Next. Messages are returned as MessageViews
+ * pointing into the buffer, and consuming one only advances an offset, so a
+ * frame is never copied or shifted on the way to its handler. Unconsumed
+ * bytes are moved to the front of the buffer only when the free tail is too
+ * small for the next read, which then moves at most one partial frame.
+ *
+ * The read window adapts to the traffic: it doubles (up to a limit) whenever
+ * a read fills it completely and shrinks again after a run of small reads.
+ *
+ * Frames of at least kMinDetachedFrameSize bytes are received into a buffer
+ * of their own that ends exactly at the frame boundary. Next then hands that
+ * buffer over in MessageView::frame instead of recycling it, so a large frame
+ * (typically a file chunk) can be relayed to another connection as is.
+ *
+ * Both wire formats are accepted and detected per frame (see
+ * DecodeMessageHeader), so a peer may switch to the compact format at any
+ * frame boundary.
+ *
+ * A compressed payload is expanded into a second buffer owned by the framer
+ * and the view describes the original message, so handlers never see the
+ * compression. Such a view is only valid until the next call to Next.
+ *
+ * Frames larger than the maximum frame size are rejected as soon as their
+ * header is in, before any buffer is grown for them, so a peer cannot make
+ * the framer allocate whatever a header claims.
+ *
+ * Not thread-safe; each connection owns its own framer.
+ */
+class MessageFramer {
+public:
+  /**
+   * @brief Constructs a new MessageFramer.
+   *
+   * @param min_read_size Smallest read window offered by PrepareRead.
+   * @param max_read_size Largest read window offered by PrepareRead.
+   * @param max_frame_size Largest frame accepted, header included; also caps
+   * an expanded payload.
+   */
+  explicit MessageFramer(size_t min_read_size = kDefaultMinReadSize, size_t max_read_size = kDefaultMaxReadSize,
+                         size_t max_frame_size = kDefaultMaxFrameSize);
+
+  /**
+   * @brief Provides the buffer region for the next receive call.
+   *
+   * Invalidates all MessageViews previously returned by Next.
+   *
+   * @param capacity Receives the number of bytes that may be written.
+   * @return Pointer to the writable region.
+   */
+  char *PrepareRead(size_t &capacity);
+
+  /**
+   * @brief Records how many bytes the receive call wrote.
+   *
+   * @param bytes_received Number of bytes written into the PrepareRead region.
+   */
+  void CommitRead(size_t bytes_received);
+
+  /**
+   * @brief Extracts the next complete message, if any.
+   *
+   * @param view Receives the message; valid until the next PrepareRead call
+   * (until the next Next call if it was compressed).
+   * @return True if a complete message was extracted.
+   */
+  bool Next(MessageView &view);
+
+  /**
+   * @brief Gets the number of received bytes not yet returned by Next.
+   * @return The buffered byte count.
+   */
+  size_t BufferedBytes() const;
+
+  /**
+   * @brief Gets the highest wire protocol version seen from the peer.
+   * @return The protocol version, or 0 if no message was received yet.
+   */
+  int GetPeerProtocolVersion() const;
+
+  /**
+   * @brief Checks whether the stream contained an undecodable header.
+   *
+   * Once set, Next returns no further messages. A compressed payload that
+   * does not expand and an oversized frame count as framing errors too.
+   *
+   * @return True if framing failed; the connection should be dropped.
+   */
+  bool HasError() const;
+
+  /**
+   * @brief Gets the reason framing failed.
+   * @return The error, or FramingError::NONE if HasError is false.
+   */
+  FramingError GetError() const;
+
+  /**
+   * @brief Gets the current adaptive read window size.
+   * @return The read size in bytes.
+   */
+  size_t GetReadSize() const;
+
+  /**
+   * @brief Frees the receive buffers while no partial message is buffered.
+   *
+   * For connections that have gone quiet: the next PrepareRead allocates a
+   * buffer of the minimum read size again. Invalidates all MessageViews
+   * previously returned by Next.
+   *
+   * @return The number of bytes of buffer capacity released.
+   */
+  size_t ReleaseMemory();
+
+  static const size_t kDefaultMinReadSize = 16 * 1024;
+  static const size_t kDefaultMaxReadSize = 256 * 1024;
+  static const size_t kMinDetachedFrameSize = 32 * 1024;
+  static const size_t kDefaultMaxFrameSize = 16 * 1024 * 1024;
+
+private:
+  /**
+   * @brief Checks a decoded header against the maximum frame size.
+   *
+   * @param header The decoded header.
+   * @param header_size Encoded size of the header.
+   * @return True if the frame must be refused.
+   */
+  bool IsTooLarge(const MessageHeader &header, size_t header_size) const;
+
+  PooledBuffer buffer_;
+  PooledBuffer decompressed_; /**< Payload of the last compressed message returned by Next. */
+  size_t read_pos_;           /**< Start of unconsumed data. */
+  size_t write_pos_;          /**< End of received data. */
+  size_t min_read_size_;
+  size_t max_read_size_;
+  size_t max_frame_size_;
+  size_t read_size_;          /**< Current read window. */
+  size_t offered_size_;       /**< Window handed out by the last PrepareRead. */
+  int small_reads_;           /**< Consecutive reads that used little of the window. */
+  int peer_protocol_version_; /**< Highest wire version decoded so far. */
+  FramingError error_;        /**< Why framing stopped, if it did. */
+};
+
+#endif // MESSAGE_FRAMER_H_
@@ -0,0 +1,43 @@
+#ifndef MESSAGE_PRIORITY_H_
+#define MESSAGE_PRIORITY_H_
+
+#include <cstddef>
+#include <cstdint>
+
+#include "Message.h"
+
+/**
+ * @brief Enum defining the scheduling classes of outgoing messages, most urgent first.
+ */
+enum class MessagePriority : uint8_t {
+  CONTROL = 0, /**< Small protocol messages that keep the connection and transfers moving. */
+  CHAT,        /**< Interactive chat lines. */
+  BULK,        /**< File transfer data, scheduled fairly across transfers. */
+};
+
+// Number of priority classes, e.g. for tables indexed by MessagePriority
+const size_t kMessagePriorityCount = 3;
+
+/**
+ * @brief Gets the scheduling class of a message.
+ *
+ * FILE_TRANSFER_COMPLETE is bulk like the chunks it follows, so it can never
+ * overtake them; requests, acks and errors are control traffic.
+ *
+ * @param type The message type.
+ * @return The priority class.
+ */
+MessagePriority GetMessagePriority(MessageType type);
+
+/**
+ * @brief Gets the flow a message belongs to for fair scheduling of bulk traffic.
+ *
+ * Messages of one file transfer share a flow, identified by the sending
+ * client and the transfer ID, so they stay in order among themselves.
+ *
+ * @param header The message header.
+ * @return The flow key.
+ */
+uint64_t GetMessageFlow(const MessageHeader &header);
+
+#endif // MESSAGE_PRIORITY_H_
@@ -1,25 +1,181 @@
 #ifndef MESSAGE_SERIALIZATION_H_
 #define MESSAGE_SERIALIZATION_H_
 
+#include "ICompressionCodec.h"
 #include "Message.h"
+#include "MessageView.h"
 
+#include <cstdint>
+#include <memory>
 #include <string>
 #include <vector>
 
+// Wire protocol versions
+const int kProtocolVersionLegacy = 1;  // Native MessageHeader image (LegacyWireHeader)
+const int kProtocolVersionCompact = 2; // Packed, little-endian varint header
+const int kProtocolVersionLatest = kProtocolVersionCompact;
+
+// Largest compact header: type byte, flags byte, two 5-byte and one 10-byte varint, 5-byte transfer ID,
+// 4-byte checksum
+const size_t kMaxCompactHeaderSize = 31;
+
+// Upper bound of an encoded header in any supported version
+const size_t kMaxWireHeaderSize =
+    kMessageHeaderSize > kMaxCompactHeaderSize ? kMessageHeaderSize : kMaxCompactHeaderSize;
+
+// Compact header, first byte: marker bit, flags-present bit and 6-bit type
+const uint8_t kCompactHeaderMarker = 0x80;
+const uint8_t kCompactHeaderHasFlags = 0x40;
+const uint8_t kCompactHeaderTypeMask = 0x3F;
+
+// Compact header, flags byte: a varint transfer ID follows the payload size
+const uint8_t kCompactFlagTransferId = 0x01;
+// Compact header, flags byte: a 4-byte little-endian CRC-32C of the payload ends the header
+const uint8_t kCompactFlagChecksum = 0x02;
+// Compact header, flags byte: the payload is compressed (see CompressPayload)
+const uint8_t kCompactFlagCompressed = 0x04;
+
+// Payloads smaller than this are never compressed; the saving would not pay for the work
+const size_t kMinCompressedPayloadSize = 256;
+
+// Largest payload a compressed frame may expand to
+const size_t kMaxDecompressedPayloadSize = 64 * 1024 * 1024;
+
+// Longest room name a ROOM_JOIN may carry
+const size_t kMaxRoomNameLength = 64;
+
+/**
+ * @brief Contents of a FILE_TRANSFER_REQUEST payload.
+ */
+struct FileTransferRequest {
+  int recipient_id = -1;         /**< Receiving client, or -1 for an upload to the server. */
+  std::string file_name;         /**< Name of the file, without directories. */
+  uint64_t file_size = 0;        /**< Size of the file in bytes. */
+  bool has_content_hash = false; /**< Whether content_hash and chunk_size are set. */
+  uint64_t content_hash = 0;     /**< XXH64 of the whole file. */
+  uint64_t chunk_size = 0;       /**< Sender's chunk size; a resume offset must be a multiple of it. */
+};
+
+/**
+ * @brief Enum describing the outcome of decoding a wire header.
+ */
+enum class HeaderDecodeStatus {
+  OK,         /**< A complete header was decoded. */
+  INCOMPLETE, /**< More bytes are needed. */
+  INVALID,    /**< The bytes are not a valid header. */
+};
+
+/**
+ * @brief Enum describing the outcome of expanding a compressed payload.
+ */
+enum class DecompressStatus {
+  OK,        /**< The original payload was restored. */
+  TOO_LARGE, /**< The original size exceeds the caller's limit; nothing was allocated. */
+  INVALID,   /**< The codec is not available or the data is corrupt. */
+};
+
+/**
+ * @brief Encodes a message header.
+ *
+ * Version 1 writes the native LegacyWireHeader image. Version 2 writes the
+ * compact format: one byte holding kCompactHeaderMarker, kCompactHeaderHasFlags
+ * and the type, an optional flags byte, the zigzag varint sender and
+ * recipient IDs, and the varint payload size. A non-zero transfer ID sets
+ * kCompactFlagTransferId and is appended as a varint, and a header with
+ * kCompactFlagChecksum in its flags ends with the 4-byte payload checksum.
+ * All multi-byte values are little-endian, so the encoding is the same on
+ * every platform. The legacy format has no room for either field and drops
+ * them.
+ *
+ * @param header The header to encode (type must be below 64 for version 2).
+ * @param protocol_version The wire protocol version to use.
+ * @param out Destination with room for at least kMaxWireHeaderSize bytes.
+ * @return The number of bytes written.
+ */
+size_t EncodeMessageHeader(const MessageHeader &header, int protocol_version, char *out);
+
+/**
+ * @brief Decodes a message header in either wire format.
+ *
+ * The format is detected from the first byte: legacy headers start with the
+ * low byte of a small native enum value (or a zero byte on big-endian
+ * machines), which never has the compact marker bit set.
+ *
+ * @param data The received bytes, starting at a frame boundary.
+ * @param size The number of available bytes.
+ * @param header Receives the decoded header.
+ * @param header_size Receives the encoded size of the header.
+ * @param protocol_version Receives the version the header was encoded with.
+ * @return The decode status.
+ */
+HeaderDecodeStatus DecodeMessageHeader(const char *data, size_t size, MessageHeader &header, size_t &header_size,
+                                       int &protocol_version);
+
+/**
+ * @brief Compresses a payload for a frame with kCompactFlagCompressed.
+ *
+ * The compressed payload is the codec ID byte, the varint size of the
+ * original payload and the codec's output, so a receiver can expand it
+ * without knowing which codec the sender picked.
+ *
+ * @param payload The original payload.
+ * @param codec The codec to use.
+ * @param out Receives the compressed payload.
+ * @return False if the codec is not available, the payload is below
+ * kMinCompressedPayloadSize or it did not get smaller; out is then unusable.
+ */
+bool CompressPayload(const PayloadView &payload, CompressionCodecId codec, PooledBuffer &out);
+
+/**
+ * @brief Expands a payload received with kCompactFlagCompressed.
+ *
+ * The original size the sender claims is checked against max_size before
+ * out is allocated, so a tiny frame cannot make the receiver reserve more.
+ *
+ * @param payload The compressed payload (see CompressPayload).
+ * @param out Receives the original payload.
+ * @param max_size Largest original payload accepted; never above
+ * kMaxDecompressedPayloadSize.
+ * @return OK, TOO_LARGE if the original size exceeds max_size, or INVALID
+ * if the codec is not available or the data is corrupt.
+ */
+DecompressStatus DecompressPayload(const PayloadView &payload, PooledBuffer &out,
+                                   size_t max_size = kMaxDecompressedPayloadSize);
+
 /**
- * @brief Serializes a Message object into a byte vector.
+ * @brief Serializes a message into a byte vector.
  *
- * The serialized format is: MessageHeader (binary) followed by Payload (binary).
+ * The serialized format is: the encoded header followed by the payload.
+ * Accepts both owning messages and views. With a codec and the compact
+ * format, a payload that compresses is sent compressed and flagged; the
+ * legacy format cannot flag it and always sends the payload as is.
  *
- * @param message The Message object to serialize.
- * @return A vector of bytes representing the serialized message.
+ * @param message The message to serialize.
+ * @param protocol_version The wire protocol version to use.
+ * @param codec The compression codec negotiated with the peer.
+ * @return A pool-allocated buffer holding the serialized message.
  */
-std::vector<char> SerializeMessage(const Message &message);
+PooledBuffer SerializeMessage(const MessageView &message, int protocol_version = kProtocolVersionLegacy,
+                              CompressionCodecId codec = CompressionCodecId::NONE);
+
+/**
+ * @brief Serializes a message into a shareable immutable frame.
+ *
+ * Both the bytes and the shared control block come from BufferPool.
+ *
+ * @param message The message to serialize.
+ * @param protocol_version The wire protocol version to use.
+ * @param codec The compression codec negotiated with the peer.
+ * @return A reference-counted frame holding the serialized message.
+ */
+SharedFrame SerializeMessageShared(const MessageView &message, int protocol_version = kProtocolVersionLegacy,
+                                   CompressionCodecId codec = CompressionCodecId::NONE);
 
 /**
  * @brief Deserializes a byte vector into a Message object.
  *
- * Assumes the byte vector starts with a valid MessageHeader followed by the payload.
+ * Assumes the byte vector starts with a valid header (in either wire format)
+ * followed by the payload. A compressed payload is expanded.
  *
  * @param data The byte vector to deserialize.
  * @return The deserialized Message object. Returns a Message with type UNKNOWN
@@ -27,4 +183,90 @@ std::vector<char> SerializeMessage(const Message &message);
  */
 Message DeserializeMessage(const std::vector<char> &data);
 
+/**
+ * @brief Builds the CLIENT_ID_ASSIGNMENT payload.
+ *
+ * The payload is "<id>;v=<version>", followed by ";c=<name>,<name>..." when
+ * compression codecs are listed. Sent by the server, the list holds the
+ * codecs it offers; in the client's echo, the one codec it picked. Clients
+ * that predate versioning parse the payload with std::stoi, which stops at
+ * the ';', so they keep working.
+ *
+ * @param client_id The assigned client ID.
+ * @param protocol_version The highest protocol version the server speaks.
+ * @param codecs The compression codecs to list.
+ * @return The payload string.
+ */
+std::string FormatClientIdAssignment(int client_id, int protocol_version,
+                                     const std::vector<CompressionCodecId> &codecs = {});
+
+/**
+ * @brief Parses a CLIENT_ID_ASSIGNMENT payload.
+ *
+ * @param payload The payload bytes.
+ * @param client_id Receives the assigned client ID.
+ * @param protocol_version Receives the advertised version (legacy if absent).
+ * @param codecs Receives the listed codecs this build supports, in the
+ * listed order; unknown names are skipped.
+ * @return False if the payload does not contain a client ID.
+ */
+bool ParseClientIdAssignment(const PayloadView &payload, int &client_id, int &protocol_version,
+                             std::vector<CompressionCodecId> &codecs);
+
+/**
+ * @brief Builds the FILE_TRANSFER_REQUEST payload.
+ *
+ * The payload is "<recipient>:<name>:<size>", followed by
+ * ";xxh64=<16 hex digits>;chunk=<bytes>" when the content hash is known.
+ * Receivers that predate the hash read the size with std::stoull, which
+ * stops at the ';', so they keep working.
+ *
+ * @param request The request to encode.
+ * @return The payload string.
+ */
+std::string FormatFileTransferRequest(const FileTransferRequest &request);
+
+/**
+ * @brief Parses a FILE_TRANSFER_REQUEST payload.
+ *
+ * @param payload The payload bytes.
+ * @param request Receives the request.
+ * @return False if the payload is malformed.
+ */
+bool ParseFileTransferRequest(const PayloadView &payload, FileTransferRequest &request);
+
+/**
+ * @brief Builds the FILE_TRANSFER_ACK payload.
+ *
+ * The payload is the decimal count of file bytes received so far. Acks are
+ * cumulative, so a lost or coalesced ack is covered by the next one. The
+ * first ack tells the sender the receiver is ready: 0 to start from the
+ * beginning, or the number of bytes the receiver already holds, in which
+ * case the sender resumes from there.
+ *
+ * @param acked_bytes The number of bytes received and written.
+ * @return The payload string.
+ */
+std::string FormatFileTransferAck(uint64_t acked_bytes);
+
+/**
+ * @brief Parses a FILE_TRANSFER_ACK payload.
+ *
+ * @param payload The payload bytes.
+ * @param acked_bytes Receives the acknowledged byte count.
+ * @return False if the payload is not a byte count.
+ */
+bool ParseFileTransferAck(const PayloadView &payload, uint64_t &acked_bytes);
+
+/**
+ * @brief Checks whether a string may be used as a room name.
+ *
+ * Names are 1 to kMaxRoomNameLength printable ASCII characters without
+ * spaces, so they can be typed as a single command argument.
+ *
+ * @param name The candidate name.
+ * @return True if the name is valid.
+ */
+bool IsValidRoomName(const std::string &name);
+
 #endif // MESSAGE_SERIALIZATION_H_
@@ -1,6 +1,8 @@
 #ifndef MESSAGE_TYPE_H_
 #define MESSAGE_TYPE_H_
 
+#include <cstddef>
+
 /**
  * @brief Enum defining the different types of messages exchanged between client and server.
  */
@@ -13,7 +15,16 @@ enum class MessageType : int {
   FILE_DATA_CHUNK,
   FILE_TRANSFER_COMPLETE,
   FILE_TRANSFER_ERROR,
+  FILE_TRANSFER_ACK, /**< Cumulative acknowledgement of received file bytes. */
+  ROOM_JOIN,         /**< Join a room by name; answered with the room ID in recipient_id (-1 if refused). */
+  ROOM_LEAVE,        /**< Leave the room in recipient_id; answered once the membership is gone. */
+  ROOM_MESSAGE,      /**< Chat message to every member of the room in recipient_id. */
+  HEARTBEAT,         /**< Keep-alive probe; a client answers one from the server (sender -1) with its own. */
   // Add other message types as needed
+  MESSAGE_TYPE_COUNT, /**< Not a message type: number of types, keep last. */
 };
 
+// Number of message types, e.g. for tables indexed by MessageType
+const size_t kMessageTypeCount = static_cast<size_t>(MessageType::MESSAGE_TYPE_COUNT);
+
 #endif // MESSAGE_TYPE_H_
@@ -0,0 +1,111 @@
+#ifndef MESSAGE_VIEW_H_
+#define MESSAGE_VIEW_H_
+
+#include <cstddef>
+#include <memory>
+#include <vector>
+
+#include "Message.h"
+
+/**
+ * @brief A serialized, immutable, reference-counted message frame.
+ *
+ * Used to fan one serialized message out to many connections without copying
+ * it: every recipient's send queue holds a reference to the same bytes.
+ */
+using SharedFrame = std::shared_ptr<const PooledBuffer>;
+
+/**
+ * @brief Non-owning, read-only view of a message payload.
+ *
+ * Offers the subset of the std::vector<char> interface that message handlers
+ * use (begin/end/data/size/empty/operator[]), so code written against
+ * Message::payload works unchanged on a view.
+ */
+class PayloadView {
+public:
+  /**
+   * @brief Constructs an empty view.
+   */
+  PayloadView() : data_(nullptr), size_(0) {}
+
+  /**
+   * @brief Constructs a view over a byte range.
+   * @param data Pointer to the first payload byte.
+   * @param size Number of payload bytes.
+   */
+  PayloadView(const char *data, size_t size) : data_(data), size_(size) {}
+
+  /**
+   * @brief Constructs a view over an owned payload.
+   * @param payload The payload bytes; must outlive the view.
+   */
+  PayloadView(const PooledBuffer &payload) : data_(payload.data()), size_(payload.size()) {}
+
+  /**
+   * @brief Constructs a view over a plain byte vector.
+   * @param payload The payload bytes; must outlive the view.
+   */
+  PayloadView(const std::vector<char> &payload) : data_(payload.data()), size_(payload.size()) {}
+
+  const char *begin() const { return data_; }
+  const char *end() const { return data_ + size_; }
+  const char *data() const { return data_; }
+  size_t size() const { return size_; }
+  bool empty() const { return size_ == 0; }
+  char operator[](size_t index) const { return data_[index]; }
+
+private:
+  const char *data_;
+  size_t size_;
+};
+
+/**
+ * @brief A message whose payload points into a buffer owned by someone else.
+ *
+ * Produced by MessageFramer directly over the receive buffer, so dispatching
+ * a received message does not copy its payload. The view is only valid while
+ * the underlying buffer is; handlers that need to keep a message must copy
+ * it with ToMessage(). A Message converts implicitly, so functions taking a
+ * MessageView accept both.
+ *
+ * For large frames the framer may instead hand over the received bytes
+ * themselves in `frame`, which keeps them alive and lets a relay put them on
+ * another connection's send queue unchanged. Either way `wire` describes the
+ * received frame (header and payload), so a relay can also forward the bytes
+ * of smaller frames without re-serializing them.
+ */
+struct MessageView {
+  MessageHeader header; /**< The message header (copied, it is small). */
+  PayloadView payload;  /**< The message payload (not owned, unless by frame). */
+  SharedFrame frame;    /**< The exact received wire bytes, if the framer detached them; otherwise null. */
+  PayloadView wire;     /**< The received frame, valid like payload; empty if it was not received as is. */
+  int frame_version;    /**< Wire protocol version `wire` and `frame` are encoded with (0 without either). */
+
+  /**
+   * @brief Default constructor: an UNKNOWN message with an empty payload.
+   */
+  MessageView() : header({MessageType::UNKNOWN, -1, -1, 0, 0, 0, 0}), frame_version(0) {}
+
+  /**
+   * @brief Constructs a view from a header and a payload range.
+   * @param msg_header The message header.
+   * @param msg_payload The payload bytes.
+   */
+  MessageView(const MessageHeader &msg_header, PayloadView msg_payload)
+      : header(msg_header), payload(msg_payload), frame_version(0) {}
+
+  /**
+   * @brief Constructs a view over an owned message.
+   * @param message The message; must outlive the view.
+   */
+  MessageView(const Message &message) : header(message.header), payload(message.payload), frame_version(0) {}
+
+  /**
+   * @brief Copies the viewed message into an owning Message.
+   * @return The copied message.
+   */
+  Message ToMessage() const { return Message(header, PooledBuffer(payload.begin(), payload.end())); }
+};
+
+#endif // MESSAGE_VIEW_H_
@@ -0,0 +1,182 @@
+#ifndef METRICS_H_
+#define METRICS_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "MessageType.h"
+
+/**
+ * @brief Enum defining the process-wide event counters.
+ */
+enum class MetricCounter : size_t {
+  BYTES_RECEIVED,            /**< Bytes read from client sockets. */
+  BYTES_SENT,                /**< Bytes written to client sockets. */
+  CONNECTIONS_ACCEPTED,      /**< Connections accepted by any listener. */
+  CONNECTIONS_CLOSED,        /**< Clients removed from the server. */
+  FRAMES_DROPPED,            /**< Frames discarded by a DROP_OLDEST outbound queue. */
+  HEARTBEATS_SENT,           /**< Heartbeat probes sent to quiet clients. */
+  CONNECTIONS_TIMED_OUT,     /**< Clients disconnected by a read, write or idle timeout. */
+  CONNECTIONS_TRIMMED,       /**< Times a quiet connection released its buffers. */
+  READS_THROTTLED,           /**< Times a client over one of its rate limits stopped being read. */
+  ADMISSION_PAUSES,          /**< Times admission control paused reading from a noisy client. */
+  FRAMES_TOO_LARGE,          /**< Clients disconnected for sending a frame over the maximum size. */
+  CLUSTER_FRAMES_FORWARDED,  /**< Frames queued on a link to another cluster node. */
+  CLUSTER_MESSAGES_RECEIVED, /**< Messages read from the links of other cluster nodes. */
+  TLS_HANDSHAKES,            /**< TLS handshakes completed, full or resumed. */
+  TLS_SESSIONS_RESUMED,      /**< TLS handshakes that resumed an earlier session. */
+  TLS_KERNEL_OFFLOADS,       /**< TLS connections whose sends the kernel encrypts (kTLS). */
+  METRIC_COUNTER_COUNT,      /**< Not a counter: number of counters, keep last. */
+};
+
+/**
+ * @brief Enum defining the process-wide value distributions.
+ */
+enum class MetricHistogram : size_t {
+  BROADCAST_FANOUT_NS,    /**< Time to queue one broadcast on every recipient. */
+  BROADCAST_RECIPIENTS,   /**< Recipients of one broadcast. */
+  ROOM_FANOUT_NS,         /**< Time to queue one room message on every member. */
+  ROOM_RECIPIENTS,        /**< Recipients of one room message. */
+  PRIVATE_BATCH_MESSAGES, /**< Private messages queued on one recipient at once. */
+  OUTBOUND_QUEUE_BYTES,   /**< Bytes already queued for a client when a frame is pushed. */
+  WORKER_QUEUE_NS,        /**< Time a received message waits for a worker thread. */
+  METRIC_HISTOGRAM_COUNT, /**< Not a histogram: number of histograms, keep last. */
+};
+
+const size_t kMetricCounterCount = static_cast<size_t>(MetricCounter::METRIC_COUNTER_COUNT);
+const size_t kMetricHistogramCount = static_cast<size_t>(MetricHistogram::METRIC_HISTOGRAM_COUNT);
+
+/**
+ * @brief Merged copy of one histogram.
+ *
+ * Buckets are log-linear like an HDR histogram: values below 16 are exact,
+ * larger ones fall into one of 8 buckets per power of two, so every
+ * percentile is accurate to within 12.5% whatever the magnitude.
+ */
+struct HistogramSnapshot {
+  uint64_t count = 0;            /**< Number of recorded values. */
+  uint64_t sum = 0;              /**< Sum of the recorded values. */
+  std::vector<uint64_t> buckets; /**< Values per bucket, see HistogramBucketFor. */
+
+  /**
+   * @brief Gets an upper bound of a percentile.
+   *
+   * @param fraction The percentile as a fraction in [0, 1], e.g. 0.99.
+   * @return The upper edge of the bucket holding that percentile, or 0 if empty.
+   */
+  uint64_t Percentile(double fraction) const;
+
+  /**
+   * @brief Gets the mean of the recorded values.
+   * @return The mean, or 0 if empty.
+   */
+  double Mean() const;
+};
+
+/**
+ * @brief Point-in-time copy of every metric.
+ */
+struct MetricsSnapshot {
+  std::vector<uint64_t> counters;                    /**< Indexed by MetricCounter. */
+  std::vector<uint64_t> messages_received;           /**< Indexed by MessageType. */
+  std::vector<HistogramSnapshot> histograms;         /**< Indexed by MetricHistogram. */
+  std::vector<HistogramSnapshot> handler_latency_ns; /**< Indexed by MessageType. */
+
+  /**
+   * @brief Gets a counter value.
+   * @param counter The counter.
+   * @return Its value.
+   */
+  uint64_t Get(MetricCounter counter) const { return counters[static_cast<size_t>(counter)]; }
+
+  /**
+   * @brief Formats the snapshot as human-readable lines.
+   * @return The text, one metric per line; empty histograms are left out.
+   */
+  std::string Format() const;
+};
+
+/**
+ * @brief Low-overhead process-wide metrics.
+ *
+ * Counters are thread-local: each thread increments plain slots that only it
+ * writes, and a snapshot sums the slots of all threads (plus the totals of
+ * threads that have exited). Histograms go to one of a fixed number of
+ * shards picked per thread, which bounds their memory even with a thread
+ * per client, using relaxed atomic increments. Nothing on the recording path
+ * takes a lock, except the first use on each thread.
+ */
+class Metrics {
+public:
+  /**
+   * @brief Adds to a counter.
+   *
+   * @param counter The counter.
+   * @param amount The amount to add.
+   */
+  static void Add(MetricCounter counter, uint64_t amount = 1);
+
+  /**
+   * @brief Counts a received message of the given type.
+   * @param type The message type.
+   */
+  static void CountMessageReceived(MessageType type);
+
+  /**
+   * @brief Records a value in a histogram.
+   *
+   * @param histogram The histogram.
+   * @param value The value.
+   */
+  static void Record(MetricHistogram histogram, uint64_t value);
+
+  /**
+   * @brief Records how long the handler for a message type took.
+   *
+   * @param type The message type.
+   * @param nanoseconds The handler's run time.
+   */
+  static void RecordHandlerLatency(MessageType type, uint64_t nanoseconds);
+
+  /**
+   * @brief Collects the current value of every metric.
+   * @return The snapshot.
+   */
+  static MetricsSnapshot Snapshot();
+
+  /**
+   * @brief Reads a monotonic clock for latency measurements.
+   * @return Nanoseconds since an arbitrary epoch.
+   */
+  static uint64_t NowNanoseconds();
+
+  /**
+   * @brief Gets the name a message type is reported under.
+   * @param type The message type.
+   * @return The name, e.g. "broadcast_message".
+   */
+  static const char *GetMessageTypeName(MessageType type);
+};
+
+/**
+ * @brief Gets the histogram bucket of a value.
+ *
+ * @param value The value.
+ * @return The bucket index, below kHistogramBucketCount.
+ */
+size_t HistogramBucketFor(uint64_t value);
+
+/**
+ * @brief Gets the largest value that falls into a histogram bucket.
+ *
+ * @param bucket The bucket index.
+ * @return The bucket's upper edge.
+ */
+uint64_t HistogramBucketUpperBound(size_t bucket);
+
+// Buckets cover the full uint64_t range: 16 exact ones, then 8 per power of two
+const size_t kHistogramBucketCount = 16 + 60 * 8;
+
+#endif // METRICS_H_
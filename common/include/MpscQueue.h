@@ -0,0 +1,225 @@
+#ifndef MPSC_QUEUE_H_
+#define MPSC_QUEUE_H_
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <mutex>
+#include <utility>
+
+/**
+ * @brief Unbounded lock-free multi-producer, single-consumer queue.
+ *
+ * Producers push with a single compare-and-swap onto an intrusive stack; the
+ * consumer takes the whole stack with one exchange and reverses it, so the
+ * values of one PopAll come out in push order. Values are moved in and out,
+ * never copied, and T only needs to be move-constructible.
+ *
+ * Wakeups are batched: the consumer announces that it is about to block, and
+ * only the first push after that touches the mutex and condition variable.
+ * While the consumer is busy, pushes are plain atomic operations.
+ */
+template <typename T> class MpscQueue {
+public:
+  MpscQueue() : head_(nullptr), consumer_waiting_(false), wakeup_requested_(false) {}
+
+  /**
+   * @brief Destroys the queue and any values still in it.
+   */
+  ~MpscQueue() { FreeList(head_.exchange(nullptr)); }
+
+  MpscQueue(const MpscQueue &) = delete;
+  MpscQueue &operator=(const MpscQueue &) = delete;
+
+  /**
+   * @brief Appends a value. Safe to call from any thread.
+   * @param value The value (moved in).
+   */
+  void Push(T value);
+
+  /**
+   * @brief Removes everything pushed so far. Consumer only.
+   *
+   * @param consume Called with each value (as an rvalue), oldest first.
+   * @return The number of values removed.
+   */
+  template <typename Consume> size_t PopAll(Consume &&consume);
+
+  /**
+   * @brief Checks whether the queue holds no values.
+   *
+   * Exact for the consumer with respect to pushes that happened before the
+   * call; a concurrent push may not be seen.
+   *
+   * @return True if the queue is empty.
+   */
+  bool Empty() const { return head_.load() == nullptr; }
+
+  /**
+   * @brief Blocks until the queue is non-empty or Wakeup is called. Consumer only.
+   */
+  void Wait();
+
+  /**
+   * @brief Like Wait, but gives up at a deadline. Consumer only.
+   *
+   * @param deadline When to stop waiting.
+   * @return False if the deadline passed with the queue still empty and no
+   * Wakeup call.
+   */
+  bool WaitUntil(std::chrono::steady_clock::time_point deadline);
+
+  /**
+   * @brief Makes the current or next Wait return even if nothing was pushed.
+   */
+  void Wakeup();
+
+private:
+  /**
+   * @brief A pushed value linked to the one pushed before it.
+   */
+  struct Node {
+    T value;
+    Node *next;
+  };
+
+  /**
+   * @brief Wakes the consumer if it is blocked in Wait.
+   */
+  void NotifyConsumer();
+
+  /**
+   * @brief Deletes a list of nodes.
+   * @param node The first node, or nullptr.
+   */
+  static void FreeList(Node *node);
+
+  std::atomic<Node *> head_;            /**< Most recently pushed node. */
+  std::atomic<bool> consumer_waiting_;  /**< The consumer is blocked (or about to block) in Wait. */
+  std::atomic<bool> wakeup_requested_;  /**< Wakeup was called since the last Wait returned. */
+  std::mutex mutex_;                    /**< Only taken to block or to wake a blocked consumer. */
+  std::condition_variable consumer_cv_;
+};
+
+/**
+ * @brief Appends a value. Safe to call from any thread.
+ * @param value The value (moved in).
+ */
+template <typename T> void MpscQueue<T>::Push(T value) {
+  Node *node = new Node{std::move(value), head_.load(std::memory_order_relaxed)};
+  while (!head_.compare_exchange_weak(node->next, node, std::memory_order_seq_cst, std::memory_order_relaxed)) {
+  }
+  NotifyConsumer();
+}
+
+/**
+ * @brief Removes everything pushed so far. Consumer only.
+ * @param consume Called with each value (as an rvalue), oldest first.
+ * @return The number of values removed.
+ */
+template <typename T> template <typename Consume> size_t MpscQueue<T>::PopAll(Consume &&consume) {
+  if (Empty()) {
+    return 0;
+  }
+
+  // The stack is newest first; reverse it into push order
+  Node *oldest = nullptr;
+  Node *node = head_.exchange(nullptr, std::memory_order_acquire);
+  while (node) {
+    Node *next = node->next;
+    node->next = oldest;
+    oldest = node;
+    node = next;
+  }
+
+  size_t count = 0;
+  while (oldest) {
+    Node *next = oldest->next;
+    consume(std::move(oldest->value));
+    delete oldest;
+    oldest = next;
+    ++count;
+  }
+  return count;
+}
+
+/**
+ * @brief Blocks until the queue is non-empty or Wakeup is called. Consumer only.
+ */
+template <typename T> void MpscQueue<T>::Wait() {
+  std::unique_lock<std::mutex> lock(mutex_);
+  while (true) {
+    // Announce the wait before every check: a producer either sees the flag
+    // or pushed early enough for the check to see its node. Re-announce after
+    // each wakeup, since a late notify from an earlier round may have been
+    // the one that cleared it.
+    consumer_waiting_.store(true, std::memory_order_seq_cst);
+    if (head_.load(std::memory_order_seq_cst) != nullptr || wakeup_requested_.load(std::memory_order_seq_cst)) {
+      break;
+    }
+    consumer_cv_.wait(lock);
+  }
+  consumer_waiting_.store(false, std::memory_order_relaxed);
+  wakeup_requested_.store(false, std::memory_order_relaxed);
+}
+
+/**
+ * @brief Like Wait, but gives up at a deadline. Consumer only.
+ *
+ * @param deadline When to stop waiting.
+ * @return False if the deadline passed with the queue still empty and no
+ * Wakeup call.
+ */
+template <typename T> bool MpscQueue<T>::WaitUntil(std::chrono::steady_clock::time_point deadline) {
+  std::unique_lock<std::mutex> lock(mutex_);
+  bool ready = false;
+  while (true) {
+    // Same handshake as Wait
+    consumer_waiting_.store(true, std::memory_order_seq_cst);
+    ready = head_.load(std::memory_order_seq_cst) != nullptr || wakeup_requested_.load(std::memory_order_seq_cst);
+    if (ready || consumer_cv_.wait_until(lock, deadline) == std::cv_status::timeout) {
+      break;
+    }
+  }
+  if (!ready) {
+    // Timed out: a push may have landed after the last check
+    ready = head_.load(std::memory_order_seq_cst) != nullptr || wakeup_requested_.load(std::memory_order_seq_cst);
+  }
+  consumer_waiting_.store(false, std::memory_order_relaxed);
+  wakeup_requested_.store(false, std::memory_order_relaxed);
+  return ready;
+}
+
+/**
+ * @brief Makes the current or next Wait return even if nothing was pushed.
+ */
+template <typename T> void MpscQueue<T>::Wakeup() {
+  wakeup_requested_.store(true, std::memory_order_seq_cst);
+  NotifyConsumer();
+}
+
+/**
+ * @brief Wakes the consumer if it is blocked in Wait.
+ */
+template <typename T> void MpscQueue<T>::NotifyConsumer() {
+  // Only the first producer after the consumer started waiting pays for the lock
+  if (consumer_waiting_.load(std::memory_order_seq_cst) && consumer_waiting_.exchange(false)) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    consumer_cv_.notify_one();
+  }
+}
+
+/**
+ * @brief Deletes a list of nodes.
+ * @param node The first node, or nullptr.
+ */
+template <typename T> void MpscQueue<T>::FreeList(Node *node) {
+  while (node) {
+    Node *next = node->next;
+    delete node;
+    node = next;
+  }
+}
+
+#endif // MPSC_QUEUE_H_
@@ -0,0 +1,89 @@
+#ifndef POLL_POLLER_H_
+#define POLL_POLLER_H_
+
+#if !defined(_WIN32)
+
+#include "IPoller.h"
+
+#include <unordered_map>
+#include <vector>
+
+#include <poll.h>
+
+/**
+ * @brief Portable POSIX poll(2) implementation of the IPoller interface.
+ *
+ * Used on POSIX systems without epoll (e.g. macOS, the BSDs). Wakeups are
+ * delivered through a non-blocking self-pipe.
+ */
+class PollPoller : public IPoller {
+public:
+  /**
+   * @brief Constructs a new PollPoller and its wakeup pipe.
+   */
+  PollPoller();
+
+  /**
+   * @brief Destroys the PollPoller and closes the wakeup pipe.
+   */
+  ~PollPoller() override;
+
+  PollPoller(const PollPoller &) = delete;
+  PollPoller &operator=(const PollPoller &) = delete;
+
+  /**
+   * @brief Starts watching a socket.
+   *
+   * @param handle The socket file descriptor.
+   * @param events Bitmask of PollEventFlags to watch for.
+   * @return True if the socket was added, false otherwise.
+   */
+  bool Add(NativeSocketHandle handle, uint32_t events) override;
+
+  /**
+   * @brief Changes the set of events watched for a socket.
+   *
+   * @param handle The socket file descriptor.
+   * @param events Bitmask of PollEventFlags to watch for.
+   * @return True if the interest set was updated, false otherwise.
+   */
+  bool Modify(NativeSocketHandle handle, uint32_t events) override;
+
+  /**
+   * @brief Stops watching a socket.
+   *
+   * @param handle The socket file descriptor.
+   * @return True if the socket was removed, false otherwise.
+   */
+  bool Remove(NativeSocketHandle handle) override;
+
+  /**
+   * @brief Waits for readiness on the watched sockets.
+   *
+   * @param events Output vector that receives the ready sockets.
+   * @param timeout_ms Maximum time to wait in milliseconds, or -1 to wait indefinitely.
+   * @return The number of ready sockets, or -1 on error.
+   */
+  int Wait(std::vector<PollEvent> &events, int timeout_ms) override;
+
+  /**
+   * @brief Interrupts Wait by writing to the self-pipe.
+   */
+  void Wakeup() override;
+
+  /**
+   * @brief Checks if the wakeup pipe was created successfully.
+   *
+   * @return True if the poller is usable, false otherwise.
+   */
+  bool IsValid() const override;
+
+private:
+  std::vector<pollfd> poll_fds_;                                /**< Entry 0 is the wakeup pipe. */
+  std::unordered_map<NativeSocketHandle, size_t> fd_to_index_; /**< Position of each fd in poll_fds_. */
+  int wakeup_pipe_[2];                                          /**< Self-pipe: [0] read end, [1] write end. */
+};
+
+#endif // !_WIN32
+
+#endif // POLL_POLLER_H_
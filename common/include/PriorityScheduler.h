@@ -0,0 +1,264 @@
+#ifndef PRIORITY_SCHEDULER_H_
+#define PRIORITY_SCHEDULER_H_
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <unordered_map>
+#include <utility>
+
+#include "MessagePriority.h"
+
+/**
+ * @brief Orders outgoing items by MessagePriority class.
+ *
+ * Control items always go first and chat items before bulk ones, each class
+ * in FIFO order. Bulk items are grouped into flows (one per file transfer)
+ * that are served by deficit round robin: every turn a flow may send up to
+ * bulk_quantum bytes, so one large transfer cannot monopolise the connection
+ * and several transfers progress at the same rate. Items within a flow keep
+ * their order.
+ *
+ * Not thread-safe; the owner serializes access.
+ */
+template <typename Item> class PriorityScheduler {
+public:
+  /**
+   * @brief A queued item with its scheduling attributes.
+   */
+  struct Entry {
+    Item item;                                           /**< The queued item. */
+    MessagePriority priority = MessagePriority::CONTROL; /**< Its scheduling class. */
+    uint64_t flow = 0;                                   /**< Flow key; only used for bulk items. */
+    size_t size = 0;                                     /**< Bytes the item puts on the wire. */
+  };
+
+  static const size_t kDefaultBulkQuantum = 64 * 1024;
+
+  /**
+   * @brief Constructs an empty scheduler.
+   * @param bulk_quantum Bytes a bulk flow may send per round robin turn.
+   */
+  explicit PriorityScheduler(size_t bulk_quantum = kDefaultBulkQuantum)
+      : bulk_quantum_(std::max<size_t>(1, bulk_quantum)), size_(0) {}
+
+  /**
+   * @brief Queues an item behind the others of its class (or flow).
+   *
+   * @param item The item (moved in).
+   * @param priority Its scheduling class.
+   * @param flow Flow key for bulk items, see GetMessageFlow.
+   * @param size Bytes the item puts on the wire.
+   */
+  void Push(Item item, MessagePriority priority, uint64_t flow, size_t size);
+
+  /**
+   * @brief Puts an entry returned by Pop back where it was taken from.
+   *
+   * Entries popped together must be returned in reverse order.
+   *
+   * @param entry The entry (moved in).
+   */
+  void PushFront(Entry entry);
+
+  /**
+   * @brief Removes the item that should be sent next.
+   *
+   * @param entry Receives the item and its attributes.
+   * @return False if the scheduler is empty.
+   */
+  bool Pop(Entry &entry);
+
+  /**
+   * @brief Removes the oldest item of one class without sending it.
+   *
+   * For bulk, the oldest item of the flow that is next in turn is removed.
+   *
+   * @param priority The class to drop from.
+   * @param entry Receives the dropped item and its attributes.
+   * @return False if the class is empty.
+   */
+  bool DropOldest(MessagePriority priority, Entry &entry);
+
+  /**
+   * @brief Checks whether any items are queued.
+   * @return True if the scheduler is empty.
+   */
+  bool Empty() const { return size_ == 0; }
+
+  /**
+   * @brief Gets the number of queued items.
+   * @return The item count.
+   */
+  size_t Size() const { return size_; }
+
+private:
+  /**
+   * @brief Bulk items of one flow and its round robin credit.
+   */
+  struct Flow {
+    std::deque<Entry> entries;
+    size_t deficit = 0; /**< Bytes the flow may still send in its current turn. */
+  };
+
+  /**
+   * @brief Removes the front entry of the flow that is next in turn. Flow must be non-empty.
+   *
+   * @param entry Receives the entry.
+   * @param charge True to charge the entry against the flow's credit.
+   */
+  void TakeFrontFlowEntry(Entry &entry, bool charge);
+
+  std::deque<Entry> control_;
+  std::deque<Entry> chat_;
+  std::unordered_map<uint64_t, Flow> flows_; /**< Bulk flows with queued items. */
+  std::deque<uint64_t> active_flows_;        /**< Keys of flows_, in round robin order. */
+  size_t bulk_quantum_;
+  size_t size_;
+};
+
+template <typename Item> const size_t PriorityScheduler<Item>::kDefaultBulkQuantum;
+
+/**
+ * @brief Queues an item behind the others of its class (or flow).
+ * @param item The item (moved in).
+ * @param priority Its scheduling class.
+ * @param flow Flow key for bulk items.
+ * @param size Bytes the item puts on the wire.
+ */
+template <typename Item>
+void PriorityScheduler<Item>::Push(Item item, MessagePriority priority, uint64_t flow, size_t size) {
+  Entry entry{std::move(item), priority, flow, size};
+  ++size_;
+  switch (priority) {
+  case MessagePriority::CONTROL:
+    control_.push_back(std::move(entry));
+    return;
+  case MessagePriority::CHAT:
+    chat_.push_back(std::move(entry));
+    return;
+  case MessagePriority::BULK:
+    break;
+  }
+
+  Flow &bulk_flow = flows_[flow];
+  if (bulk_flow.entries.empty()) {
+    active_flows_.push_back(flow); // A new flow waits for its turn
+  }
+  bulk_flow.entries.push_back(std::move(entry));
+}
+
+/**
+ * @brief Puts an entry returned by Pop back where it was taken from.
+ * @param entry The entry (moved in).
+ */
+template <typename Item> void PriorityScheduler<Item>::PushFront(Entry entry) {
+  ++size_;
+  switch (entry.priority) {
+  case MessagePriority::CONTROL:
+    control_.push_front(std::move(entry));
+    return;
+  case MessagePriority::CHAT:
+    chat_.push_front(std::move(entry));
+    return;
+  case MessagePriority::BULK:
+    break;
+  }
+
+  Flow &bulk_flow = flows_[entry.flow];
+  if (bulk_flow.entries.empty()) {
+    active_flows_.push_front(entry.flow); // It was being served when the entry was taken
+  }
+  bulk_flow.deficit += entry.size; // Refund the credit Pop charged
+  bulk_flow.entries.push_front(std::move(entry));
+}
+
+/**
+ * @brief Removes the item that should be sent next.
+ * @param entry Receives the item and its attributes.
+ * @return False if the scheduler is empty.
+ */
+template <typename Item> bool PriorityScheduler<Item>::Pop(Entry &entry) {
+  if (!control_.empty()) {
+    entry = std::move(control_.front());
+    control_.pop_front();
+    --size_;
+    return true;
+  }
+  if (!chat_.empty()) {
+    entry = std::move(chat_.front());
+    chat_.pop_front();
+    --size_;
+    return true;
+  }
+
+  while (!active_flows_.empty()) {
+    Flow &bulk_flow = flows_[active_flows_.front()];
+    if (bulk_flow.deficit >= bulk_flow.entries.front().size) {
+      TakeFrontFlowEntry(entry, true);
+      return true;
+    }
+    // Out of credit: top up and let the next flow have its turn
+    bulk_flow.deficit += bulk_quantum_;
+    active_flows_.push_back(active_flows_.front());
+    active_flows_.pop_front();
+  }
+  return false;
+}
+
+/**
+ * @brief Removes the oldest item of one class without sending it.
+ * @param priority The class to drop from.
+ * @param entry Receives the dropped item and its attributes.
+ * @return False if the class is empty.
+ */
+template <typename Item> bool PriorityScheduler<Item>::DropOldest(MessagePriority priority, Entry &entry) {
+  std::deque<Entry> *queue = nullptr;
+  switch (priority) {
+  case MessagePriority::CONTROL:
+    queue = &control_;
+    break;
+  case MessagePriority::CHAT:
+    queue = &chat_;
+    break;
+  case MessagePriority::BULK:
+    if (active_flows_.empty()) {
+      return false;
+    }
+    TakeFrontFlowEntry(entry, false);
+    return true;
+  }
+
+  if (queue->empty()) {
+    return false;
+  }
+  entry = std::move(queue->front());
+  queue->pop_front();
+  --size_;
+  return true;
+}
+
+/**
+ * @brief Removes the front entry of the flow that is next in turn.
+ * @param entry Receives the entry.
+ * @param charge True to charge the entry against the flow's credit.
+ */
+template <typename Item> void PriorityScheduler<Item>::TakeFrontFlowEntry(Entry &entry, bool charge) {
+  uint64_t flow = active_flows_.front();
+  Flow &bulk_flow = flows_[flow];
+  entry = std::move(bulk_flow.entries.front());
+  bulk_flow.entries.pop_front();
+  --size_;
+  if (charge) {
+    bulk_flow.deficit -= std::min(bulk_flow.deficit, entry.size);
+  }
+
+  if (bulk_flow.entries.empty()) {
+    // An idle flow does not bank credit
+    flows_.erase(flow);
+    active_flows_.pop_front();
+  }
+}
+
+#endif // PRIORITY_SCHEDULER_H_
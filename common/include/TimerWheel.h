@@ -0,0 +1,167 @@
+#ifndef TIMER_WHEEL_H_
+#define TIMER_WHEEL_H_
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+#include <utility>
+#include <vector>
+
+/**
+ * @brief Hashed timing wheel for large numbers of coarse timeouts.
+ *
+ * Time is cut into ticks, and a timer goes into the slot of the tick it is
+ * due in, modulo the number of slots; timers more than one revolution away
+ * simply stay in their slot until their tick comes round. Adding a timer is
+ * O(1), and advancing the wheel only visits the slots of the elapsed ticks,
+ * so the cost does not depend on how many timers are pending elsewhere.
+ *
+ * Timers cannot be cancelled. Owners that re-arm or drop a timer tag the
+ * value (e.g. with a generation number) and ignore stale expiries instead,
+ * which keeps every operation allocation-free once the slots have grown.
+ * A timer fires on the first Advance at or after its deadline, never
+ * before, and at most one tick late.
+ *
+ * Not thread-safe; the owning thread adds and advances.
+ */
+template <typename T> class TimerWheel {
+public:
+  /**
+   * @brief Constructs an empty wheel.
+   *
+   * @param tick_ms Resolution of the wheel in milliseconds.
+   * @param slot_count Number of slots, i.e. ticks per revolution.
+   */
+  explicit TimerWheel(uint64_t tick_ms = kDefaultTickMs, size_t slot_count = kDefaultSlotCount);
+
+  /**
+   * @brief Adds a timer.
+   *
+   * @param deadline_ms Time the timer is due, in milliseconds of the clock
+   * passed to Advance.
+   * @param value Passed to the expiry callback (moved in).
+   */
+  void Add(uint64_t deadline_ms, T value);
+
+  /**
+   * @brief Fires every timer that is due.
+   *
+   * The callback may add timers, including to the slot being expired; those
+   * fire on a later call.
+   *
+   * @param now_ms The current time in milliseconds.
+   * @param expire Called with each due value (as an rvalue).
+   * @return The number of timers fired.
+   */
+  template <typename Expire> size_t Advance(uint64_t now_ms, Expire &&expire);
+
+  /**
+   * @brief Gets how long the owner may sleep before calling Advance again.
+   *
+   * @param now_ms The current time in milliseconds.
+   * @return Milliseconds until the next tick, or -1 if no timer is pending.
+   */
+  int GetTimeout(uint64_t now_ms) const;
+
+  /**
+   * @brief Gets the number of pending timers, stale ones included.
+   * @return The timer count.
+   */
+  size_t Size() const { return size_; }
+
+  static const uint64_t kDefaultTickMs = 100;
+  static const size_t kDefaultSlotCount = 512;
+
+private:
+  /**
+   * @brief A pending timer.
+   */
+  struct Timer {
+    uint64_t tick; /**< Tick the timer is due in. */
+    T value;
+  };
+
+  std::vector<std::vector<Timer>> slots_;
+  std::vector<Timer> expired_; /**< Scratch list of Advance, kept for its capacity. */
+  uint64_t tick_ms_;
+  uint64_t current_tick_; /**< Last tick Advance has processed. */
+  size_t size_;
+};
+
+template <typename T> const uint64_t TimerWheel<T>::kDefaultTickMs;
+template <typename T> const size_t TimerWheel<T>::kDefaultSlotCount;
+
+/**
+ * @brief Constructs an empty wheel.
+ *
+ * @param tick_ms Resolution of the wheel in milliseconds.
+ * @param slot_count Number of slots, i.e. ticks per revolution.
+ */
+template <typename T>
+TimerWheel<T>::TimerWheel(uint64_t tick_ms, size_t slot_count)
+    : slots_(std::max<size_t>(1, slot_count)), tick_ms_(std::max<uint64_t>(1, tick_ms)), current_tick_(0),
+      size_(0) {}
+
+/**
+ * @brief Adds a timer.
+ *
+ * @param deadline_ms Time the timer is due, in milliseconds.
+ * @param value Passed to the expiry callback (moved in).
+ */
+template <typename T> void TimerWheel<T>::Add(uint64_t deadline_ms, T value) {
+  // Round up so a timer never fires early, and never into a processed tick
+  uint64_t tick = std::max((deadline_ms + tick_ms_ - 1) / tick_ms_, current_tick_ + 1);
+  slots_[tick % slots_.size()].push_back(Timer{tick, std::move(value)});
+  ++size_;
+}
+
+/**
+ * @brief Fires every timer that is due.
+ *
+ * @param now_ms The current time in milliseconds.
+ * @param expire Called with each due value (as an rvalue).
+ * @return The number of timers fired.
+ */
+template <typename T> template <typename Expire> size_t TimerWheel<T>::Advance(uint64_t now_ms, Expire &&expire) {
+  uint64_t now_tick = now_ms / tick_ms_;
+  if (now_tick <= current_tick_) {
+    return 0;
+  }
+
+  // After a long pause every slot is due once; later revolutions stay put
+  uint64_t elapsed = std::min<uint64_t>(now_tick - current_tick_, slots_.size());
+  for (uint64_t i = 1; i <= elapsed; ++i) {
+    std::vector<Timer> &slot = slots_[(current_tick_ + i) % slots_.size()];
+    auto due =
+        std::partition(slot.begin(), slot.end(), [now_tick](const Timer &timer) { return timer.tick > now_tick; });
+    std::move(due, slot.end(), std::back_inserter(expired_));
+    slot.erase(due, slot.end());
+  }
+  current_tick_ = now_tick;
+
+  // Fire outside the slot loop, the callbacks may add timers
+  size_t fired = expired_.size();
+  size_ -= fired;
+  for (Timer &timer : expired_) {
+    expire(std::move(timer.value));
+  }
+  expired_.clear();
+  return fired;
+}
+
+/**
+ * @brief Gets how long the owner may sleep before calling Advance again.
+ *
+ * @param now_ms The current time in milliseconds.
+ * @return Milliseconds until the next tick, or -1 if no timer is pending.
+ */
+template <typename T> int TimerWheel<T>::GetTimeout(uint64_t now_ms) const {
+  if (size_ == 0) {
+    return -1;
+  }
+  uint64_t next_tick_ms = (current_tick_ + 1) * tick_ms_;
+  return next_tick_ms > now_ms ? static_cast<int>(std::min<uint64_t>(next_tick_ms - now_ms, tick_ms_)) : 0;
+}
+
+#endif // TIMER_WHEEL_H_
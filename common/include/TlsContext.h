@@ -0,0 +1,123 @@
+#ifndef TLS_CONTEXT_H_
+#define TLS_CONTEXT_H_
+
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+#include <openssl/ssl.h>
+
+/**
+ * @brief Enum selecting which end of the TLS handshake a context serves.
+ */
+enum class TlsRole {
+  CLIENT, /**< Connects and verifies the server. */
+  SERVER, /**< Accepts and presents a certificate. */
+};
+
+/**
+ * @brief Settings of a TlsContext.
+ */
+struct TlsOptions {
+  std::string certificate_file; /**< Server: PEM certificate chain. */
+  std::string private_key_file; /**< Server: PEM private key. */
+  std::string ca_file;          /**< Client: PEM CAs the server must chain to; empty skips verification. */
+  std::string server_name;      /**< Client: name sent as SNI and verified, empty for the connect address. */
+  int session_tickets = 2;      /**< Server: tickets issued per full handshake, 0 disables resumption. */
+  bool kernel_offload = true;   /**< Hand the record layer to the kernel (kTLS) where it supports it. */
+};
+
+/**
+ * @brief Shared TLS configuration and session cache for TlsSockets.
+ *
+ * Wraps one OpenSSL SSL_CTX, so certificates are loaded once and every
+ * connection of a process shares them, and with them the ticket keys of a
+ * server: any connection to the same server process can resume a session
+ * another one obtained.
+ *
+ * A client context keeps the most recent session ticket per server it
+ * connected to, and new connections to that server offer it, so a burst of
+ * reconnects after the first one completes with an abbreviated handshake
+ * (no certificate exchange or verification).
+ *
+ * Thread-safe; create it once and share it.
+ */
+class TlsContext {
+public:
+  /**
+   * @brief Creates a context.
+   *
+   * @param role Which end of the connections the context is for.
+   * @param options Certificates, verification and session settings.
+   * @return The context, or nullptr (with the reason logged) if the
+   * certificates cannot be loaded.
+   */
+  static std::shared_ptr<TlsContext> Create(TlsRole role, const TlsOptions &options);
+
+  /**
+   * @brief Frees the SSL_CTX and the cached sessions.
+   */
+  ~TlsContext();
+
+  TlsContext(const TlsContext &) = delete;
+  TlsContext &operator=(const TlsContext &) = delete;
+
+  /**
+   * @brief Gets the role the context was created for.
+   * @return The role.
+   */
+  TlsRole GetRole() const;
+
+  /**
+   * @brief Gets the options the context was created with.
+   * @return The options.
+   */
+  const TlsOptions &GetOptions() const;
+
+  /**
+   * @brief Creates the OpenSSL state of one connection.
+   * @return The new SSL object, owned by the caller, or nullptr on failure.
+   */
+  SSL *NewConnection() const;
+
+  /**
+   * @brief Gets the session to offer when reconnecting to a server.
+   *
+   * @param server_key Address and port of the server.
+   * @return A reference the caller must release with SSL_SESSION_free, or nullptr.
+   */
+  SSL_SESSION *GetCachedSession(const std::string &server_key);
+
+  /**
+   * @brief Remembers a session (ticket) received from a server.
+   *
+   * @param server_key Address and port of the server.
+   * @param session The session; the cache takes over the caller's reference.
+   */
+  void CacheSession(const std::string &server_key, SSL_SESSION *session);
+
+  /**
+   * @brief Describes and clears the calling thread's OpenSSL error queue.
+   * @return The first queued error, or "unknown error".
+   */
+  static std::string TakeLastError();
+
+private:
+  /**
+   * @brief Constructs a context around a configured SSL_CTX.
+   *
+   * @param role The role.
+   * @param options The options.
+   * @param context The SSL_CTX; the new object owns it.
+   */
+  TlsContext(TlsRole role, const TlsOptions &options, SSL_CTX *context);
+
+  TlsRole role_;
+  TlsOptions options_;
+  SSL_CTX *context_;
+  std::unordered_map<std::string, SSL_SESSION *> sessions_; /**< Client: newest session per server. */
+  std::mutex sessions_mutex_;                               /**< Protects sessions_. */
+};
+
+#endif // TLS_CONTEXT_H_
@@ -0,0 +1,259 @@
+#ifndef TLS_SOCKET_H_
+#define TLS_SOCKET_H_
+
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include <openssl/ssl.h>
+
+#include "ISocket.h"
+#include "TlsContext.h"
+
+/**
+ * @brief TLS implementation of the ISocket interface, on top of a plain socket.
+ *
+ * Decorates a PosixSocket or WinsockSocket: connection management and
+ * options go to the wrapped socket, data goes through OpenSSL. A client's
+ * Connect completes the handshake (offering a cached session, see
+ * TlsContext); an accepted socket handshakes on its first Receive or Send,
+ * so accepting never waits for a slow peer.
+ *
+ * The wrapped socket is always non-blocking and a blocking caller waits in
+ * poll without holding OpenSSL's state, so one thread may send while another
+ * is blocked receiving, as with a plain socket. SEND_TIMEOUT bounds those
+ * waits for sends.
+ *
+ * When the kernel takes over the record layer (kTLS, Linux), SendFile still
+ * goes from the page cache to the socket with sendfile; otherwise it reads
+ * the file and encrypts it in user space.
+ *
+ * OpenSSL needs a send it could not finish to be retried with the same
+ * bytes, while a non-blocking ISocket caller only guarantees that unsent
+ * bytes come again in order. So when a record does not fit into the
+ * kernel's buffer, the socket keeps a copy of it, reports all of it but the
+ * last byte as sent, and finishes it on the next Send before accepting that
+ * byte again. The caller therefore never loses or repeats a byte.
+ * Non-blocking sends made before the handshake completes are kept until it
+ * has, so that a reactor watching writability does not spin meanwhile.
+ */
+class TlsSocket : public ISocket {
+public:
+  /**
+   * @brief Wraps a socket.
+   *
+   * @param socket The plain socket: unconnected for a client, accepted for a server.
+   * @param context Configuration and session cache; its role selects the end of the handshake.
+   */
+  TlsSocket(std::unique_ptr<ISocket> socket, std::shared_ptr<TlsContext> context);
+
+  /**
+   * @brief Destroys the TlsSocket object. Closes the socket if it's open.
+   */
+  ~TlsSocket() override;
+
+  /**
+   * @brief Connects to a server and completes the TLS handshake.
+   *
+   * @param address The IP address or hostname.
+   * @param port The port number.
+   * @return True if the connection is established and the server verified.
+   */
+  bool Connect(const std::string &address, int port) override;
+
+  /**
+   * @brief Binds the wrapped socket to a local address and port.
+   *
+   * @param address The IP address to bind to (e.g., "0.0.0.0" for any).
+   * @param port The port number.
+   * @return True if binding is successful, false otherwise.
+   */
+  bool Bind(const std::string &address, int port) override;
+
+  /**
+   * @brief Listens for incoming connections on the wrapped socket.
+   *
+   * @param backlog The maximum length of the queue of pending connections.
+   * @return True if listening starts successfully, false otherwise.
+   */
+  bool Listen(int backlog) override;
+
+  /**
+   * @brief Accepts a new incoming connection.
+   *
+   * @return A new TlsSocket sharing this socket's context, or nullptr if an
+   * error occurs. The caller owns it.
+   */
+  ISocket *Accept() override;
+
+  /**
+   * @brief Encrypts and sends data.
+   *
+   * @param data The data to send.
+   * @param size The number of bytes to send.
+   * @return The number of bytes sent, or -1 on error.
+   */
+  int Send(const void *data, size_t size) override;
+
+  /**
+   * @brief Encrypts several buffers into as few records as possible and sends them.
+   *
+   * @param buffers Array of buffers to send, in order.
+   * @param count Number of entries in the array.
+   * @return The number of bytes sent, or -1 on error.
+   */
+  int SendV(const IoBuffer *buffers, size_t count) override;
+
+  /**
+   * @brief Sends a region of an open file (sendfile under kTLS, read and encrypt otherwise).
+   *
+   * @param file The file to read from.
+   * @param offset Offset of the first byte to send.
+   * @param size Number of bytes to send.
+   * @return The number of bytes sent, 0 if the file ends at offset, or -1 on error.
+   */
+  int SendFile(NativeFileHandle file, uint64_t offset, size_t size) override;
+
+  /**
+   * @brief Receives and decrypts data.
+   *
+   * As much as the buffer holds is taken from the record being decrypted,
+   * so no received data is left where readiness polling cannot see it.
+   *
+   * @param buffer The buffer to store the received data.
+   * @param size The maximum number of bytes to receive.
+   * @return The number of bytes received, or -1 on error, 0 if the connection
+   * has been closed by the peer.
+   */
+  int Receive(void *buffer, size_t size) override;
+
+  /**
+   * @brief Sends close_notify if possible and closes the socket.
+   */
+  void Close() override;
+
+  /**
+   * @brief Shuts down both directions of the connection without releasing
+   * the socket handle.
+   */
+  void Shutdown() override;
+
+  /**
+   * @brief Checks if the socket is valid/open.
+   *
+   * @return True if the socket is valid, false otherwise.
+   */
+  bool IsValid() const override;
+
+  /**
+   * @brief Switches the socket between blocking and non-blocking mode.
+   *
+   * Only changes how calls behave; the wrapped socket stays non-blocking.
+   *
+   * @param non_blocking True to enable non-blocking mode, false to restore blocking mode.
+   * @return True.
+   */
+  bool SetNonBlocking(bool non_blocking) override;
+
+  /**
+   * @brief Checks whether the last failed operation on the calling thread would have blocked.
+   *
+   * @return True if it failed for lack of data or buffer space (in either direction).
+   */
+  bool WouldBlock() const override;
+
+  /**
+   * @brief Gets the native OS handle of the wrapped socket.
+   *
+   * @return The socket handle.
+   */
+  NativeSocketHandle GetNativeHandle() const override;
+
+  /**
+   * @brief Sets an option on the wrapped socket.
+   *
+   * @param option The option to set.
+   * @param value The new value (0 or 1 for boolean options).
+   * @return True if the option was set, false otherwise.
+   */
+  bool SetOption(SocketOption option, int value) override;
+
+  /**
+   * @brief Reads an option of the wrapped socket.
+   *
+   * @param option The option to read.
+   * @param value Receives the current value.
+   * @return True if the option was read, false otherwise.
+   */
+  bool GetOption(SocketOption option, int &value) const override;
+
+private:
+  /**
+   * @brief Binds the OpenSSL state to the connected socket and makes it non-blocking.
+   *
+   * Caller holds ssl_mutex_.
+   *
+   * @return False if OpenSSL refused the socket.
+   */
+  bool AttachLocked();
+
+  /**
+   * @brief Makes one OpenSSL call and classifies its result. Caller holds ssl_mutex_.
+   *
+   * @param operation The call.
+   * @param wait_events Receives POLLIN or POLLOUT if the call has to wait for
+   * the socket (with WouldBlock set), 0 otherwise.
+   * @return The call's positive result, 0 if the peer closed the connection, or -1.
+   */
+  template <typename Operation> int AttemptLocked(Operation operation, short &wait_events);
+
+  /**
+   * @brief Runs an OpenSSL call until it succeeds, waiting whenever it asks for I/O.
+   *
+   * Fails with WouldBlock set instead of waiting in non-blocking mode, or
+   * once a wait exceeds timeout_ms.
+   *
+   * @param operation The call, made under ssl_mutex_.
+   * @param timeout_ms Longest single wait, 0 for ever.
+   * @return The call's positive result, 0 if the peer closed the connection, or -1.
+   */
+  template <typename Operation> int Perform(Operation operation, int timeout_ms);
+
+  /**
+   * @brief Counts a completed handshake and looks for kernel offload. Caller holds ssl_mutex_.
+   */
+  void OnHandshakeDoneLocked();
+
+  /**
+   * @brief Finishes the record a previous send left with OpenSSL. Caller holds ssl_mutex_.
+   *
+   * @return -1 on error (or if it still would block), otherwise the held-back
+   * bytes now sent, which the caller is told about before anything new.
+   */
+  int FlushPendingWriteLocked();
+
+  /**
+   * @brief Sends what non-blocking sends handed over before the handshake
+   * completed, once it has. Caller holds ssl_mutex_.
+   */
+  void FlushDeferredLocked();
+
+  std::unique_ptr<ISocket> socket_;
+  std::shared_ptr<TlsContext> context_;
+  SSL *ssl_;
+  std::string server_key_; /**< Client: "host:port", the session cache key. */
+  mutable std::mutex ssl_mutex_; /**< Serializes OpenSSL calls; never held while waiting. */
+  bool attached_;
+  bool handshake_done_;
+  bool kernel_send_; /**< The kernel encrypts what we send (kTLS), so sendfile works. */
+  bool non_blocking_;
+  int send_timeout_ms_;
+
+  // Touched in non-blocking mode under ssl_mutex_, in blocking mode by the sending thread only
+  std::vector<char> write_buffer_; /**< Plaintext of the current send, or of one still pending. */
+  bool write_pending_;             /**< write_buffer_ was reported as sent but has not all gone out. */
+  size_t held_back_;               /**< Caller's bytes of write_buffer_ not reported as sent yet. */
+};
+
+#endif // TLS_SOCKET_H_
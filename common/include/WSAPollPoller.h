@@ -0,0 +1,90 @@
+#ifndef WSA_POLL_POLLER_H_
+#define WSA_POLL_POLLER_H_
+
+#ifdef _WIN32
+
+#include "IPoller.h"
+
+#include <unordered_map>
+#include <vector>
+
+#include <winsock2.h>
+
+/**
+ * @brief Winsock WSAPoll implementation of the IPoller interface.
+ *
+ * WSAPoll cannot wait on non-socket handles, so wakeups are delivered by
+ * sending a datagram to a UDP socket bound to the loopback interface.
+ */
+class WSAPollPoller : public IPoller {
+public:
+  /**
+   * @brief Constructs a new WSAPollPoller and its loopback wakeup socket.
+   */
+  WSAPollPoller();
+
+  /**
+   * @brief Destroys the WSAPollPoller and closes the wakeup socket.
+   */
+  ~WSAPollPoller() override;
+
+  WSAPollPoller(const WSAPollPoller &) = delete;
+  WSAPollPoller &operator=(const WSAPollPoller &) = delete;
+
+  /**
+   * @brief Starts watching a socket.
+   *
+   * @param handle The SOCKET handle.
+   * @param events Bitmask of PollEventFlags to watch for.
+   * @return True if the socket was added, false otherwise.
+   */
+  bool Add(NativeSocketHandle handle, uint32_t events) override;
+
+  /**
+   * @brief Changes the set of events watched for a socket.
+   *
+   * @param handle The SOCKET handle.
+   * @param events Bitmask of PollEventFlags to watch for.
+   * @return True if the interest set was updated, false otherwise.
+   */
+  bool Modify(NativeSocketHandle handle, uint32_t events) override;
+
+  /**
+   * @brief Stops watching a socket.
+   *
+   * @param handle The SOCKET handle.
+   * @return True if the socket was removed, false otherwise.
+   */
+  bool Remove(NativeSocketHandle handle) override;
+
+  /**
+   * @brief Waits for readiness on the watched sockets.
+   *
+   * @param events Output vector that receives the ready sockets.
+   * @param timeout_ms Maximum time to wait in milliseconds, or -1 to wait indefinitely.
+   * @return The number of ready sockets, or -1 on error.
+   */
+  int Wait(std::vector<PollEvent> &events, int timeout_ms) override;
+
+  /**
+   * @brief Interrupts Wait by sending a datagram to the wakeup socket.
+   */
+  void Wakeup() override;
+
+  /**
+   * @brief Checks if the wakeup socket was created successfully.
+   *
+   * @return True if the poller is usable, false otherwise.
+   */
+  bool IsValid() const override;
+
+private:
+  std::vector<WSAPOLLFD> poll_fds_;                             /**< Entry 0 is the wakeup socket. */
+  std::unordered_map<NativeSocketHandle, size_t> fd_to_index_; /**< Position of each socket in poll_fds_. */
+  SOCKET wakeup_socket_;                                        /**< UDP socket bound to 127.0.0.1. */
+  sockaddr_in wakeup_addr_;                                     /**< Address wakeup_socket_ is bound to. */
+};
+
+#endif // _WIN32
+
+#endif // WSA_POLL_POLLER_H_
@@ -9,6 +9,7 @@
 #include <mutex>
 #include <string>
 #include <winsock2.h>
+#include <mswsock.h> // For TransmitFile
 #include <ws2tcpip.h>
 
 /**
@@ -77,6 +78,25 @@ public:
    */
   int Send(const void *data, size_t size) override;
 
+  /**
+   * @brief Sends several buffers with a single gathered write (WSASend).
+   *
+   * @param buffers Array of buffers to send, in order.
+   * @param count Number of entries in the array.
+   * @return The number of bytes sent, or -1 on error.
+   */
+  int SendV(const IoBuffer *buffers, size_t count) override;
+
+  /**
+   * @brief Sends a region of an open file through the socket (TransmitFile).
+   *
+   * @param file The file to read from.
+   * @param offset Offset of the first byte to send.
+   * @param size Number of bytes to send.
+   * @return The number of bytes sent, 0 if the file ends at offset, or -1 on error.
+   */
+  int SendFile(NativeFileHandle file, uint64_t offset, size_t size) override;
+
   /**
    * @brief Receives data from the socket.
    *
@@ -92,6 +112,12 @@ public:
    */
   void Close() override;
 
+  /**
+   * @brief Shuts down both directions of the connection without releasing
+   * the socket handle.
+   */
+  void Shutdown() override;
+
   /**
    * @brief Checks if the socket is valid/open.
    *
@@ -99,6 +125,46 @@ public:
    */
   bool IsValid() const override;
 
+  /**
+   * @brief Switches the socket between blocking and non-blocking mode.
+   *
+   * @param non_blocking True to enable non-blocking mode, false to restore blocking mode.
+   * @return True if the mode was changed successfully, false otherwise.
+   */
+  bool SetNonBlocking(bool non_blocking) override;
+
+  /**
+   * @brief Checks whether the last failed operation on the calling thread would have blocked.
+   *
+   * @return True if the last error was WSAEWOULDBLOCK.
+   */
+  bool WouldBlock() const override;
+
+  /**
+   * @brief Gets the native OS handle of the socket.
+   *
+   * @return The SOCKET handle.
+   */
+  NativeSocketHandle GetNativeHandle() const override;
+
+  /**
+   * @brief Sets a socket option.
+   *
+   * @param option The option to set.
+   * @param value The new value (0 or 1 for boolean options).
+   * @return True if the option was set, false otherwise.
+   */
+  bool SetOption(SocketOption option, int value) override;
+
+  /**
+   * @brief Reads a socket option.
+   *
+   * @param option The option to read.
+   * @param value Receives the current value.
+   * @return True if the option was read, false otherwise.
+   */
+  bool GetOption(SocketOption option, int &value) const override;
+
 private:
   SOCKET socket_handle_; /**< The Winsock socket handle. */
 
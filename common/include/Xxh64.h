@@ -0,0 +1,56 @@
+#ifndef XXH64_H_
+#define XXH64_H_
+
+#include <cstddef>
+#include <cstdint>
+
+/**
+ * @brief Streaming implementation of the 64-bit xxHash (XXH64) function.
+ *
+ * XXH64 is a fast non-cryptographic hash; it identifies file contents for
+ * deduplication and resumable transfers. Feeding the data in pieces gives
+ * the same digest as hashing it in one go, so a file can be hashed while it
+ * is read block by block.
+ */
+class Xxh64 {
+public:
+  /**
+   * @brief Starts a new hash.
+   * @param seed The seed value (0 for the standard digest).
+   */
+  explicit Xxh64(uint64_t seed = 0);
+
+  /**
+   * @brief Adds bytes to the hash.
+   * @param data The bytes.
+   * @param size Number of bytes.
+   */
+  void Update(const void *data, size_t size);
+
+  /**
+   * @brief Gets the digest of all bytes added so far.
+   *
+   * Does not modify the state, so more bytes may be added afterwards.
+   *
+   * @return The 64-bit digest.
+   */
+  uint64_t Digest() const;
+
+  /**
+   * @brief Hashes a buffer in one call.
+   * @param data The bytes.
+   * @param size Number of bytes.
+   * @param seed The seed value.
+   * @return The 64-bit digest.
+   */
+  static uint64_t Hash(const void *data, size_t size, uint64_t seed = 0);
+
+private:
+  uint64_t accumulators_[4];  /**< Lane accumulators for 32-byte stripes. */
+  uint64_t seed_;
+  uint64_t total_size_;       /**< Bytes added so far. */
+  unsigned char buffer_[32];  /**< Bytes not yet forming a whole stripe. */
+  size_t buffered_;
+};
+
+#endif // XXH64_H_
@@ -0,0 +1,56 @@
+#ifndef ZLIB_CODEC_H_
+#define ZLIB_CODEC_H_
+
+#include "ICompressionCodec.h"
+
+/**
+ * @brief ICompressionCodec backed by zlib's deflate at its fastest level.
+ *
+ * Available wherever zlib is, which makes it the codec every build can fall
+ * back to.
+ */
+class ZlibCodec : public ICompressionCodec {
+public:
+  /**
+   * @brief Gets the codec's wire identifier.
+   * @return CompressionCodecId::ZLIB.
+   */
+  CompressionCodecId GetId() const override;
+
+  /**
+   * @brief Gets the codec's name.
+   * @return "zlib".
+   */
+  const char *GetName() const override;
+
+  /**
+   * @brief Gets the worst-case compressed size of an input.
+   * @param size The input size in bytes.
+   * @return The deflate bound for size bytes.
+   */
+  size_t GetMaxCompressedSize(size_t size) const override;
+
+  /**
+   * @brief Compresses a block.
+   *
+   * @param data The input bytes.
+   * @param size Number of input bytes.
+   * @param out Destination buffer.
+   * @param capacity Size of the destination buffer.
+   * @return The compressed size, or 0 on failure.
+   */
+  size_t Compress(const char *data, size_t size, char *out, size_t capacity) const override;
+
+  /**
+   * @brief Decompresses a block whose original size is known.
+   *
+   * @param data The compressed bytes.
+   * @param size Number of compressed bytes.
+   * @param out Destination buffer of exactly original_size bytes.
+   * @param original_size The size of the uncompressed block.
+   * @return False if the data is corrupt or does not expand to original_size bytes.
+   */
+  bool Decompress(const char *data, size_t size, char *out, size_t original_size) const override;
+};
+
+#endif // ZLIB_CODEC_H_
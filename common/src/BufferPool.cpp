@@ -0,0 +1,274 @@
+#include "BufferPool.h"
+
+#include <algorithm>
+#include <new>
+
+const size_t BufferPool::kSizeClassCount;
+const size_t BufferPool::kMinBlockSize;
+const size_t BufferPool::kRefillBatch;
+
+// Bytes a single thread may keep cached per size class
+const size_t kThreadCacheBytesPerClass = 1024 * 1024;
+
+// Maximum blocks a thread caches per size class, whatever their size
+const size_t kThreadCacheMaxBlocks = 64;
+
+// Bytes the global free list may hold per size class
+const size_t kGlobalBytesPerClass = 32 * 1024 * 1024;
+
+// Maximum blocks the global free list holds per size class
+const size_t kGlobalMaxBlocks = 4096;
+
+namespace {
+
+// 0 = cache not created yet, 1 = alive, 2 = destroyed. A trivially
+// destructible thread_local, so it stays readable while other thread_local
+// destructors run and may still release pooled buffers.
+thread_local int thread_cache_state = 0;
+
+/**
+ * @brief Number of blocks of a class a thread may cache.
+ * @param size_class The class index.
+ * @return The block limit.
+ */
+size_t ThreadCacheLimit(size_t size_class) {
+  size_t blocks = kThreadCacheBytesPerClass / BufferPool::ClassBlockSize(size_class);
+  return std::min(kThreadCacheMaxBlocks, std::max<size_t>(1, blocks));
+}
+
+} // namespace
+
+/**
+ * @brief Per-thread free lists in front of the global pool.
+ */
+class BufferPoolThreadCache {
+public:
+  BufferPoolThreadCache() {
+    thread_cache_state = 1;
+    for (size_t size_class = 0; size_class < BufferPool::kSizeClassCount; ++size_class) {
+      blocks_[size_class].reserve(ThreadCacheLimit(size_class) + 1);
+    }
+  }
+
+  /**
+   * @brief Hands all cached blocks back to the global lists.
+   */
+  ~BufferPoolThreadCache() {
+    thread_cache_state = 2;
+    BufferPool &pool = BufferPool::Instance();
+    for (size_t size_class = 0; size_class < BufferPool::kSizeClassCount; ++size_class) {
+      for (void *block : blocks_[size_class]) {
+        pool.ReturnToGlobal(size_class, block);
+      }
+    }
+  }
+
+  std::vector<void *> blocks_[BufferPool::kSizeClassCount];
+};
+
+namespace {
+
+/**
+ * @brief Gets the calling thread's cache.
+ * @return The cache, or nullptr while the thread is shutting down.
+ */
+BufferPoolThreadCache *GetThreadCache() {
+  if (thread_cache_state == 2) {
+    return nullptr;
+  }
+  thread_local BufferPoolThreadCache cache;
+  return &cache;
+}
+
+} // namespace
+
+/**
+ * @brief Fraction of allocations served without a heap allocation.
+ * @return The hit rate in [0, 1].
+ */
+double BufferPool::Stats::HitRate() const {
+  if (allocations == 0) {
+    return 0.0;
+  }
+  return static_cast<double>(local_hits + global_hits) / static_cast<double>(allocations);
+}
+
+/**
+ * @brief Gets the process-wide pool.
+ * @return The pool instance.
+ */
+BufferPool &BufferPool::Instance() {
+  // Intentionally leaked: buffers may be released by static destructors
+  static BufferPool *instance = new BufferPool();
+  return *instance;
+}
+
+/**
+ * @brief Constructs the pool with empty free lists.
+ */
+BufferPool::BufferPool()
+    : allocations_(0), local_hits_(0), global_hits_(0), misses_(0), oversize_(0), releases_(0) {
+  for (size_t size_class = 0; size_class < kSizeClassCount; ++size_class) {
+    size_t blocks = kGlobalBytesPerClass / ClassBlockSize(size_class);
+    global_[size_class].max_blocks = std::min(kGlobalMaxBlocks, std::max<size_t>(4, blocks));
+  }
+}
+
+/**
+ * @brief Allocates a block of at least the given size.
+ *
+ * @param size The number of bytes needed.
+ * @return The block; aligned like ::operator new.
+ */
+void *BufferPool::Allocate(size_t size) {
+  allocations_.fetch_add(1, std::memory_order_relaxed);
+
+  size_t size_class = SizeClassFor(size);
+  if (size_class == kSizeClassCount) {
+    oversize_.fetch_add(1, std::memory_order_relaxed);
+    return ::operator new(size);
+  }
+
+  BufferPoolThreadCache *cache = GetThreadCache();
+  if (cache) {
+    std::vector<void *> &blocks = cache->blocks_[size_class];
+    if (!blocks.empty()) {
+      local_hits_.fetch_add(1, std::memory_order_relaxed);
+      void *block = blocks.back();
+      blocks.pop_back();
+      return block;
+    }
+
+    // Refill a batch so the next few allocations stay thread-local
+    TakeFromGlobal(size_class, blocks, std::min(kRefillBatch, ThreadCacheLimit(size_class)));
+    if (!blocks.empty()) {
+      global_hits_.fetch_add(1, std::memory_order_relaxed);
+      void *block = blocks.back();
+      blocks.pop_back();
+      return block;
+    }
+  } else {
+    std::vector<void *> taken;
+    TakeFromGlobal(size_class, taken, 1);
+    if (!taken.empty()) {
+      global_hits_.fetch_add(1, std::memory_order_relaxed);
+      return taken.back();
+    }
+  }
+
+  misses_.fetch_add(1, std::memory_order_relaxed);
+  return ::operator new(ClassBlockSize(size_class));
+}
+
+/**
+ * @brief Returns a block obtained from Allocate.
+ *
+ * @param block The block.
+ * @param size The size that was passed to Allocate.
+ */
+void BufferPool::Deallocate(void *block, size_t size) {
+  if (!block) {
+    return;
+  }
+  releases_.fetch_add(1, std::memory_order_relaxed);
+
+  size_t size_class = SizeClassFor(size);
+  if (size_class == kSizeClassCount) {
+    ::operator delete(block);
+    return;
+  }
+
+  BufferPoolThreadCache *cache = GetThreadCache();
+  if (!cache) {
+    ReturnToGlobal(size_class, block);
+    return;
+  }
+
+  std::vector<void *> &blocks = cache->blocks_[size_class];
+  if (blocks.size() >= ThreadCacheLimit(size_class)) {
+    // Spill half of the cache so other threads can reuse it
+    size_t keep = blocks.size() / 2;
+    for (size_t i = keep; i < blocks.size(); ++i) {
+      ReturnToGlobal(size_class, blocks[i]);
+    }
+    blocks.resize(keep);
+  }
+  blocks.push_back(block);
+}
+
+/**
+ * @brief Gets a snapshot of the pool counters.
+ * @return The statistics.
+ */
+BufferPool::Stats BufferPool::GetStats() const {
+  Stats stats;
+  stats.allocations = allocations_.load(std::memory_order_relaxed);
+  stats.local_hits = local_hits_.load(std::memory_order_relaxed);
+  stats.global_hits = global_hits_.load(std::memory_order_relaxed);
+  stats.misses = misses_.load(std::memory_order_relaxed);
+  stats.oversize = oversize_.load(std::memory_order_relaxed);
+  stats.releases = releases_.load(std::memory_order_relaxed);
+  return stats;
+}
+
+/**
+ * @brief Gets the size class serving a request.
+ *
+ * @param size The requested size.
+ * @return The class index, or kSizeClassCount if the size is not pooled.
+ */
+size_t BufferPool::SizeClassFor(size_t size) {
+  size_t size_class = 0;
+  size_t block_size = kMinBlockSize;
+  while (block_size < size) {
+    block_size <<= 2;
+    if (++size_class == kSizeClassCount) {
+      break;
+    }
+  }
+  return size_class;
+}
+
+/**
+ * @brief Gets the block size of a size class.
+ *
+ * @param size_class The class index.
+ * @return The block size in bytes.
+ */
+size_t BufferPool::ClassBlockSize(size_t size_class) {
+  return kMinBlockSize << (2 * size_class);
+}
+
+/**
+ * @brief Moves up to count free blocks of a class from the global list.
+ *
+ * @param size_class The class index.
+ * @param out Receives the blocks.
+ * @param count Maximum number of blocks to take.
+ */
+void BufferPool::TakeFromGlobal(size_t size_class, std::vector<void *> &out, size_t count) {
+  GlobalFreeList &list = global_[size_class];
+  std::lock_guard<std::mutex> lock(list.mutex);
+  size_t take = std::min(count, list.blocks.size());
+  out.insert(out.end(), list.blocks.end() - take, list.blocks.end());
+  list.blocks.resize(list.blocks.size() - take);
+}
+
+/**
+ * @brief Gives a free block back to the global list, freeing it if the list
+ * is already at its limit.
+ *
+ * @param size_class The class index.
+ * @param block The block.
+ */
+void BufferPool::ReturnToGlobal(size_t size_class, void *block) {
+  GlobalFreeList &list = global_[size_class];
+  {
+    std::lock_guard<std::mutex> lock(list.mutex);
+    if (list.blocks.size() < list.max_blocks) {
+      list.blocks.push_back(block);
+      return;
+    }
+  }
+  ::operator delete(block);
+}
@@ -0,0 +1,82 @@
+#include "CompressionCodecs.h"
+
+#ifdef CHAT_HAVE_LZ4
+#include "Lz4Codec.h"
+#endif
+#ifdef CHAT_HAVE_ZSTD
+#include "ZstdCodec.h"
+#endif
+#ifdef CHAT_HAVE_ZLIB
+#include "ZlibCodec.h"
+#endif
+
+namespace {
+
+/**
+ * @brief Gets the codecs compiled into this build, in order of preference.
+ * @return The shared codec instances.
+ */
+const std::vector<const ICompressionCodec *> &AvailableCodecs() {
+  static const std::vector<const ICompressionCodec *> codecs = [] {
+    std::vector<const ICompressionCodec *> list;
+#ifdef CHAT_HAVE_LZ4
+    static const Lz4Codec lz4_codec;
+    list.push_back(&lz4_codec);
+#endif
+#ifdef CHAT_HAVE_ZSTD
+    static const ZstdCodec zstd_codec;
+    list.push_back(&zstd_codec);
+#endif
+#ifdef CHAT_HAVE_ZLIB
+    static const ZlibCodec zlib_codec;
+    list.push_back(&zlib_codec);
+#endif
+    return list;
+  }();
+  return codecs;
+}
+
+} // namespace
+
+/**
+ * @brief Looks up a codec compiled into this build.
+ *
+ * @param id The codec's wire identifier.
+ * @return The shared codec instance, or nullptr if it is not available.
+ */
+const ICompressionCodec *FindCompressionCodec(CompressionCodecId id) {
+  for (const ICompressionCodec *codec : AvailableCodecs()) {
+    if (codec->GetId() == id) {
+      return codec;
+    }
+  }
+  return nullptr;
+}
+
+/**
+ * @brief Looks up a codec compiled into this build by name.
+ *
+ * @param name The codec's name, e.g. "lz4".
+ * @return The shared codec instance, or nullptr if it is not available.
+ */
+const ICompressionCodec *FindCompressionCodec(const std::string &name) {
+  for (const ICompressionCodec *codec : AvailableCodecs()) {
+    if (name == codec->GetName()) {
+      return codec;
+    }
+  }
+  return nullptr;
+}
+
+/**
+ * @brief Lists the codecs compiled into this build.
+ *
+ * @return The codec IDs, in order of preference.
+ */
+std::vector<CompressionCodecId> GetAvailableCompressionCodecs() {
+  std::vector<CompressionCodecId> ids;
+  for (const ICompressionCodec *codec : AvailableCodecs()) {
+    ids.push_back(codec->GetId());
+  }
+  return ids;
+}
@@ -0,0 +1,135 @@
+#include "Crc32c.h"
+
+#include <cstring>
+
+#if defined(__x86_64__) || defined(_M_X64)
+#define CRC32C_HAVE_SSE42 1
+#include <nmmintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+#endif
+
+namespace {
+
+// Reflected CRC-32C polynomial
+const uint32_t kCrc32cPolynomial = 0x82F63B78u;
+
+/**
+ * @brief Lookup tables for the slicing-by-8 implementation.
+ */
+struct Crc32cTables {
+  uint32_t table[8][256];
+
+  Crc32cTables() {
+    for (uint32_t i = 0; i < 256; ++i) {
+      uint32_t crc = i;
+      for (int bit = 0; bit < 8; ++bit) {
+        crc = (crc >> 1) ^ ((crc & 1) ? kCrc32cPolynomial : 0);
+      }
+      table[0][i] = crc;
+    }
+    for (uint32_t i = 0; i < 256; ++i) {
+      for (int slice = 1; slice < 8; ++slice) {
+        table[slice][i] = (table[slice - 1][i] >> 8) ^ table[0][table[slice - 1][i] & 0xFF];
+      }
+    }
+  }
+};
+
+/**
+ * @brief Table based CRC-32C, eight bytes per step.
+ * @param data The bytes to checksum.
+ * @param size Number of bytes.
+ * @param crc The running (inverted) checksum.
+ * @return The updated (inverted) checksum.
+ */
+uint32_t Crc32cSoftware(const unsigned char *data, size_t size, uint32_t crc) {
+  static const Crc32cTables tables;
+  const uint32_t(&t)[8][256] = tables.table;
+
+  while (size >= 8) {
+    uint32_t low;
+    uint32_t high;
+    std::memcpy(&low, data, 4);
+    std::memcpy(&high, data + 4, 4);
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+    low = __builtin_bswap32(low);
+    high = __builtin_bswap32(high);
+#endif
+    low ^= crc;
+    crc = t[7][low & 0xFF] ^ t[6][(low >> 8) & 0xFF] ^ t[5][(low >> 16) & 0xFF] ^ t[4][low >> 24] ^
+          t[3][high & 0xFF] ^ t[2][(high >> 8) & 0xFF] ^ t[1][(high >> 16) & 0xFF] ^ t[0][high >> 24];
+    data += 8;
+    size -= 8;
+  }
+  while (size-- > 0) {
+    crc = (crc >> 8) ^ t[0][(crc ^ *data++) & 0xFF];
+  }
+  return crc;
+}
+
+#ifdef CRC32C_HAVE_SSE42
+
+/**
+ * @brief CRC-32C using the SSE4.2 crc32 instruction.
+ * @param data The bytes to checksum.
+ * @param size Number of bytes.
+ * @param crc The running (inverted) checksum.
+ * @return The updated (inverted) checksum.
+ */
+#if defined(__GNUC__) || defined(__clang__)
+__attribute__((target("sse4.2")))
+#endif
+uint32_t Crc32cHardware(const unsigned char *data, size_t size, uint32_t crc) {
+  uint64_t crc64 = crc;
+  while (size >= 8) {
+    uint64_t word;
+    std::memcpy(&word, data, 8);
+    crc64 = _mm_crc32_u64(crc64, word);
+    data += 8;
+    size -= 8;
+  }
+  crc = static_cast<uint32_t>(crc64);
+  while (size-- > 0) {
+    crc = _mm_crc32_u8(crc, *data++);
+  }
+  return crc;
+}
+
+/**
+ * @brief Checks whether the CPU implements SSE4.2.
+ * @return True if Crc32cHardware may be used.
+ */
+bool CpuHasSse42() {
+#ifdef _MSC_VER
+  int info[4];
+  __cpuid(info, 1);
+  return (info[2] & (1 << 20)) != 0;
+#else
+  return __builtin_cpu_supports("sse4.2");
+#endif
+}
+
+#endif // CRC32C_HAVE_SSE42
+
+} // namespace
+
+/**
+ * @brief Computes the CRC-32C (Castagnoli) checksum of a buffer.
+ *
+ * @param data The bytes to checksum.
+ * @param size Number of bytes.
+ * @param crc The checksum of the preceding bytes, or 0 to start a new one.
+ * @return The checksum of all bytes so far.
+ */
+uint32_t Crc32c(const void *data, size_t size, uint32_t crc) {
+  const unsigned char *bytes = static_cast<const unsigned char *>(data);
+#ifdef CRC32C_HAVE_SSE42
+  static const bool has_sse42 = CpuHasSse42();
+  if (has_sse42) {
+    return ~Crc32cHardware(bytes, size, ~crc);
+  }
+#endif
+  return ~Crc32cSoftware(bytes, size, ~crc);
+}
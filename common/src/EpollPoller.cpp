@@ -0,0 +1,191 @@
+#ifdef __linux__
+
+#include "EpollPoller.h"
+
+#include <cerrno>
+#include <cstring> // For strerror
+
+#include <sys/eventfd.h>
+#include <unistd.h>
+
+#include "Logger.h"
+
+// Maximum number of ready events fetched per epoll_wait call
+const size_t kMaxEpollEvents = 256;
+
+/**
+ * @brief Constructs a new EpollPoller, creating the epoll instance and wakeup eventfd.
+ */
+EpollPoller::EpollPoller() : epoll_fd_(-1), wakeup_fd_(-1), ready_events_(kMaxEpollEvents) {
+  epoll_fd_ = epoll_create1(EPOLL_CLOEXEC);
+  if (epoll_fd_ < 0) {
+    CHAT_LOG_ERROR("Error creating epoll instance: " << strerror(errno));
+    return;
+  }
+
+  wakeup_fd_ = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+  if (wakeup_fd_ < 0) {
+    CHAT_LOG_ERROR("Error creating wakeup eventfd: " << strerror(errno));
+    close(epoll_fd_);
+    epoll_fd_ = -1;
+    return;
+  }
+
+  epoll_event event;
+  std::memset(&event, 0, sizeof(event));
+  event.events = EPOLLIN;
+  event.data.fd = wakeup_fd_;
+  if (epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, wakeup_fd_, &event) < 0) {
+    CHAT_LOG_ERROR("Error registering wakeup eventfd: " << strerror(errno));
+  }
+}
+
+/**
+ * @brief Destroys the EpollPoller and closes its descriptors.
+ */
+EpollPoller::~EpollPoller() {
+  if (wakeup_fd_ >= 0) {
+    close(wakeup_fd_);
+  }
+  if (epoll_fd_ >= 0) {
+    close(epoll_fd_);
+  }
+}
+
+/**
+ * @brief Translates PollEventFlags into epoll event bits.
+ *
+ * @param events Bitmask of PollEventFlags.
+ * @return The corresponding EPOLL* bitmask.
+ */
+uint32_t EpollPoller::ToEpollEvents(uint32_t events) {
+  uint32_t epoll_events = EPOLLRDHUP;
+  if (events & kPollReadable) {
+    epoll_events |= EPOLLIN;
+  }
+  if (events & kPollWritable) {
+    epoll_events |= EPOLLOUT;
+  }
+  return epoll_events;
+}
+
+/**
+ * @brief Starts watching a socket.
+ *
+ * @param handle The socket file descriptor.
+ * @param events Bitmask of PollEventFlags to watch for.
+ * @return True if the socket was added, false otherwise.
+ */
+bool EpollPoller::Add(NativeSocketHandle handle, uint32_t events) {
+  epoll_event event;
+  std::memset(&event, 0, sizeof(event));
+  event.events = ToEpollEvents(events);
+  event.data.fd = handle;
+  if (epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, handle, &event) < 0) {
+    CHAT_LOG_ERROR("Error adding fd " << handle << " to epoll: " << strerror(errno));
+    return false;
+  }
+  return true;
+}
+
+/**
+ * @brief Changes the set of events watched for a socket.
+ *
+ * @param handle The socket file descriptor.
+ * @param events Bitmask of PollEventFlags to watch for.
+ * @return True if the interest set was updated, false otherwise.
+ */
+bool EpollPoller::Modify(NativeSocketHandle handle, uint32_t events) {
+  epoll_event event;
+  std::memset(&event, 0, sizeof(event));
+  event.events = ToEpollEvents(events);
+  event.data.fd = handle;
+  if (epoll_ctl(epoll_fd_, EPOLL_CTL_MOD, handle, &event) < 0) {
+    CHAT_LOG_ERROR("Error modifying fd " << handle << " in epoll: " << strerror(errno));
+    return false;
+  }
+  return true;
+}
+
+/**
+ * @brief Stops watching a socket.
+ *
+ * @param handle The socket file descriptor.
+ * @return True if the socket was removed, false otherwise.
+ */
+bool EpollPoller::Remove(NativeSocketHandle handle) {
+  if (epoll_ctl(epoll_fd_, EPOLL_CTL_DEL, handle, nullptr) < 0) {
+    // The fd may already have been closed, which removes it implicitly
+    if (errno != EBADF && errno != ENOENT) {
+      CHAT_LOG_ERROR("Error removing fd " << handle << " from epoll: " << strerror(errno));
+    }
+    return false;
+  }
+  return true;
+}
+
+/**
+ * @brief Waits for readiness on the watched sockets.
+ *
+ * @param events Output vector that receives the ready sockets.
+ * @param timeout_ms Maximum time to wait in milliseconds, or -1 to wait indefinitely.
+ * @return The number of ready sockets, or -1 on error.
+ */
+int EpollPoller::Wait(std::vector<PollEvent> &events, int timeout_ms) {
+  events.clear();
+
+  int ready = epoll_wait(epoll_fd_, ready_events_.data(), static_cast<int>(ready_events_.size()), timeout_ms);
+  if (ready < 0) {
+    if (errno == EINTR) {
+      return 0; // Interrupted by a signal, report no events
+    }
+    CHAT_LOG_ERROR("Error waiting on epoll: " << strerror(errno));
+    return -1;
+  }
+
+  for (int i = 0; i < ready; ++i) {
+    const epoll_event &ready_event = ready_events_[i];
+    if (ready_event.data.fd == wakeup_fd_) {
+      // Drain the eventfd counter so the next Wait blocks again
+      uint64_t counter;
+      while (read(wakeup_fd_, &counter, sizeof(counter)) > 0) {
+      }
+      continue;
+    }
+
+    uint32_t flags = 0;
+    if (ready_event.events & EPOLLIN) {
+      flags |= kPollReadable;
+    }
+    if (ready_event.events & EPOLLOUT) {
+      flags |= kPollWritable;
+    }
+    if (ready_event.events & (EPOLLERR | EPOLLHUP | EPOLLRDHUP)) {
+      flags |= kPollHangup;
+    }
+    events.push_back({ready_event.data.fd, flags});
+  }
+
+  return static_cast<int>(events.size());
+}
+
+/**
+ * @brief Interrupts Wait by signalling the eventfd.
+ */
+void EpollPoller::Wakeup() {
+  uint64_t one = 1;
+  if (write(wakeup_fd_, &one, sizeof(one)) < 0 && errno != EAGAIN) {
+    CHAT_LOG_ERROR("Error signalling epoll wakeup: " << strerror(errno));
+  }
+}
+
+/**
+ * @brief Checks if the epoll instance was created successfully.
+ *
+ * @return True if the poller is usable, false otherwise.
+ */
+bool EpollPoller::IsValid() const {
+  return epoll_fd_ >= 0 && wakeup_fd_ >= 0;
+}
+
+#endif // __linux__
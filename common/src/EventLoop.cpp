@@ -0,0 +1,511 @@
+#include "EventLoop.h"
+
+#include <cerrno>
+#include <future>
+#include <utility>
+
+#include "Logger.h"
+#include "Metrics.h"
+
+#if defined(_WIN32)
+#include "WSAPollPoller.h"
+#elif defined(__linux__)
+#include "EpollPoller.h"
+#else
+#include "PollPoller.h"
+#endif
+
+#ifdef CHAT_HAVE_IO_URING
+#include "IoUringPoller.h"
+#endif
+
+namespace {
+
+/**
+ * @brief Reads the clock the timers run on.
+ * @return Milliseconds of Metrics::NowNanoseconds.
+ */
+uint64_t NowMilliseconds() {
+  return Metrics::NowNanoseconds() / 1000000;
+}
+
+/**
+ * @brief Creates the poller for a backend.
+ *
+ * @param backend The requested backend.
+ * @return The poller; the platform's own one if the backend is not available.
+ */
+std::unique_ptr<IPoller> CreatePoller(IoBackend backend) {
+  if (backend == IoBackend::IO_URING) {
+#ifdef CHAT_HAVE_IO_URING
+    auto poller = std::make_unique<IoUringPoller>();
+    if (poller->IsValid()) {
+      return poller;
+    }
+    CHAT_LOG_WARNING("io_uring is not usable on this kernel, using the default poller.");
+#else
+    CHAT_LOG_WARNING("io_uring is not built in, using the default poller.");
+#endif
+  }
+
+  // The best poller available on this platform
+#if defined(_WIN32)
+  return std::make_unique<WSAPollPoller>();
+#elif defined(__linux__)
+  return std::make_unique<EpollPoller>();
+#else
+  return std::make_unique<PollPoller>();
+#endif
+}
+
+} // namespace
+
+/**
+ * @brief Constructs a new EventLoop.
+ * @param backend How to wait for readiness; IO_URING falls back to the platform's poller.
+ */
+EventLoop::EventLoop(IoBackend backend)
+    : next_file_request_(1), poller_(CreatePoller(backend)), next_timer_id_(1), running_(false),
+      stop_requested_(false) {
+}
+
+/**
+ * @brief Destroys the EventLoop. Stops the loop thread if running.
+ */
+EventLoop::~EventLoop() {
+  Stop();
+}
+
+/**
+ * @brief Starts the loop thread.
+ *
+ * @return True if the loop is running, false if the poller could not be created.
+ */
+bool EventLoop::Start() {
+  if (!poller_ || !poller_->IsValid()) {
+    CHAT_LOG_ERROR("Cannot start event loop: poller is not valid.");
+    return false;
+  }
+
+  std::lock_guard<std::mutex> lock(tasks_mutex_);
+  if (!running_.load()) {
+    running_.store(true);
+    stop_requested_.store(false);
+    loop_thread_ = std::thread(&EventLoop::Run, this);
+    loop_thread_id_ = loop_thread_.get_id();
+  }
+  return true;
+}
+
+/**
+ * @brief Stops the loop thread and waits for it to exit.
+ *
+ * Handlers that are still registered are dropped without being notified.
+ */
+void EventLoop::Stop() {
+  if (!running_.load() || stop_requested_.exchange(true)) {
+    return;
+  }
+
+  poller_->Wakeup();
+  if (loop_thread_.joinable()) {
+    loop_thread_.join();
+  }
+
+  {
+    std::lock_guard<std::mutex> lock(tasks_mutex_);
+    running_.store(false);
+  }
+
+  // Execute anything queued after the last iteration (e.g. waiting Unregister calls)
+  RunPendingTasks();
+  handlers_.clear();
+}
+
+/**
+ * @brief Registers a socket with the loop.
+ *
+ * @param handle The native socket handle (must be in non-blocking mode).
+ * @param handler The handler receiving callbacks for this socket.
+ * @param events Bitmask of PollEventFlags to watch for.
+ */
+void EventLoop::Register(NativeSocketHandle handle, IEventHandler *handler, uint32_t events) {
+  RunInLoop([this, handle, handler, events] {
+    if (poller_->Add(handle, events)) {
+      handlers_[handle] = Registration{handler, 0};
+    }
+  });
+}
+
+/**
+ * @brief Checks whether sockets can be registered in completion mode.
+ * @return True if RegisterCompletion and Send are available.
+ */
+bool EventLoop::SupportsCompletionIo() const {
+  return poller_ && poller_->SupportsCompletion();
+}
+
+/**
+ * @brief Registers a socket whose reads and writes the loop completes itself.
+ *
+ * @param handle The native socket handle (must be in non-blocking mode).
+ * @param handler The handler receiving callbacks for this socket.
+ * @param events Bitmask of PollEventFlags to watch for.
+ */
+void EventLoop::RegisterCompletion(NativeSocketHandle handle, IEventHandler *handler, uint32_t events) {
+  RunInLoop([this, handle, handler, events] {
+    if (poller_->AddCompletion(handle, events)) {
+      handlers_[handle] = Registration{handler, 0};
+    }
+  });
+}
+
+/**
+ * @brief Starts a gathered write on a socket registered in completion mode.
+ *
+ * @param handle The native socket handle.
+ * @param handler The handler the socket was registered with.
+ * @param buffers The regions to write, in order.
+ * @param count Number of regions.
+ * @return True if the write was queued.
+ */
+bool EventLoop::Send(NativeSocketHandle handle, IEventHandler *handler, const IoBuffer *buffers, size_t count) {
+  auto it = handlers_.find(handle);
+  return it != handlers_.end() && it->second.handler == handler && poller_->Send(handle, buffers, count);
+}
+
+/**
+ * @brief Checks whether files can be read and written through the loop.
+ * @return True if ReadFile and WriteFile complete on the loop thread.
+ */
+bool EventLoop::SupportsFileIo() const {
+  return poller_ && poller_->SupportsFileIo();
+}
+
+/**
+ * @brief Starts a positional read from a file.
+ *
+ * @param file The open file.
+ * @param data Receives the bytes.
+ * @param size Number of bytes to read at most.
+ * @param offset File offset of the first byte.
+ * @param on_done Receives the outcome, on the loop thread.
+ */
+void EventLoop::ReadFile(NativeFileHandle file, char *data, size_t size, uint64_t offset, FileIoCallback on_done) {
+  SubmitFileIo(FileIo{false, file, data, size, offset, std::move(on_done)});
+}
+
+/**
+ * @brief Starts a positional write to a file.
+ *
+ * @param file The open file.
+ * @param data The bytes to write.
+ * @param size Number of bytes.
+ * @param offset File offset of the first byte.
+ * @param on_done Receives the outcome, on the loop thread.
+ */
+void EventLoop::WriteFile(NativeFileHandle file, const char *data, size_t size, uint64_t offset,
+                          FileIoCallback on_done) {
+  SubmitFileIo(FileIo{true, file, const_cast<char *>(data), size, offset, std::move(on_done)});
+}
+
+/**
+ * @brief Changes the set of events watched for a registered socket.
+ *
+ * @param handle The native socket handle.
+ * @param handler The handler the socket was registered with.
+ * @param events Bitmask of PollEventFlags to watch for.
+ */
+void EventLoop::UpdateInterest(NativeSocketHandle handle, IEventHandler *handler, uint32_t events) {
+  if (IsInLoopThread()) {
+    auto it = handlers_.find(handle);
+    if (it != handlers_.end() && it->second.handler == handler) {
+      poller_->Modify(handle, events);
+    }
+    return;
+  }
+
+  RunInLoop([this, handle, handler, events] {
+    auto it = handlers_.find(handle);
+    if (it != handlers_.end() && it->second.handler == handler) {
+      poller_->Modify(handle, events);
+    }
+  });
+}
+
+/**
+ * @brief Unregisters a socket from the loop.
+ *
+ * @param handle The native socket handle.
+ * @param handler The handler the socket was registered with.
+ */
+void EventLoop::Unregister(NativeSocketHandle handle, IEventHandler *handler) {
+  if (IsInLoopThread()) {
+    RemoveRegistration(handle, handler);
+    return;
+  }
+
+  // Wait until the loop thread has processed the removal so that no callback
+  // for this handler can be in flight once we return.
+  std::promise<void> removed;
+  std::future<void> removed_future = removed.get_future();
+  RunInLoop([this, handle, handler, &removed] {
+    RemoveRegistration(handle, handler);
+    removed.set_value();
+  });
+  removed_future.wait();
+}
+
+/**
+ * @brief Arms the timer of a registered socket, replacing any earlier deadline.
+ *
+ * @param handle The native socket handle.
+ * @param handler The handler the socket was registered with.
+ * @param delay_ms Milliseconds from now.
+ */
+void EventLoop::ScheduleTimer(NativeSocketHandle handle, IEventHandler *handler, uint64_t delay_ms) {
+  uint64_t deadline_ms = NowMilliseconds() + delay_ms;
+  if (IsInLoopThread()) {
+    ArmTimer(handle, handler, deadline_ms);
+    return;
+  }
+  RunInLoop([this, handle, handler, deadline_ms] { ArmTimer(handle, handler, deadline_ms); });
+}
+
+/**
+ * @brief Checks whether the caller is running on the loop thread.
+ *
+ * @return True if called from within a loop callback.
+ */
+bool EventLoop::IsInLoopThread() const {
+  return running_.load() && std::this_thread::get_id() == loop_thread_id_;
+}
+
+/**
+ * @brief The main loop: waits for readiness and dispatches callbacks.
+ */
+void EventLoop::Run() {
+  std::vector<PollEvent> ready_events;
+
+  while (!stop_requested_.load()) {
+    RunPendingTasks();
+
+    // Sleep until the next timer tick at most
+    int ready = poller_->Wait(ready_events, due_timers_.empty() ? timers_.GetTimeout(NowMilliseconds()) : 0);
+    if (ready < 0) {
+      CHAT_LOG_ERROR("Event loop poller failed, stopping loop.");
+      break;
+    }
+
+    for (const PollEvent &event : ready_events) {
+      if (event.events & kPollFileDone) {
+        CompleteFileIo(event.request, event.result);
+        continue;
+      }
+
+      // Look the handler up per event: an earlier callback in this batch may
+      // have unregistered it.
+      auto it = handlers_.find(event.handle);
+      if (it == handlers_.end()) {
+        continue;
+      }
+      IEventHandler *handler = it->second.handler;
+
+      if (event.events & kPollHangup) {
+        handler->OnHangup();
+        continue;
+      }
+      if (event.events & kPollReceived) {
+        handler->OnReceived(event.data, event.result);
+        continue;
+      }
+      if (event.events & kPollSent) {
+        handler->OnSent(event.result);
+        continue;
+      }
+      if (event.events & kPollWritable) {
+        handler->OnWritable();
+      }
+      if (event.events & kPollReadable) {
+        // OnWritable may have unregistered the handler after a send error
+        it = handlers_.find(event.handle);
+        if (it != handlers_.end() && it->second.handler == handler) {
+          handler->OnReadable();
+        }
+      }
+    }
+    RunTimers();
+  }
+  DrainFileIo();
+}
+
+/**
+ * @brief Hands a file request to the poller, from the loop thread.
+ *
+ * @param io The request.
+ */
+void EventLoop::SubmitFileIo(FileIo io) {
+  if (IsInLoopThread()) {
+    StartFileIo(std::move(io));
+    return;
+  }
+  // Tasks are copyable, the callback need not be
+  auto shared_io = std::make_shared<FileIo>(std::move(io));
+  RunInLoop([this, shared_io] { StartFileIo(std::move(*shared_io)); });
+}
+
+/**
+ * @brief Starts a file request on the poller. Loop thread only; on any other
+ * thread the loop is stopped and the request is cancelled.
+ *
+ * @param io The request.
+ */
+void EventLoop::StartFileIo(FileIo io) {
+  // Only the loop thread reaps completions, so a stopped loop would never report this one
+  if (!IsInLoopThread()) {
+    io.on_done(-ECANCELED);
+    return;
+  }
+  uint64_t request = next_file_request_++;
+  bool queued = io.write ? poller_->WriteFile(io.file, io.data, io.size, io.offset, request)
+                         : poller_->ReadFile(io.file, io.data, io.size, io.offset, request);
+  if (!queued) {
+    io.on_done(-ECANCELED);
+    return;
+  }
+  file_requests_.emplace(request, std::move(io.on_done));
+}
+
+/**
+ * @brief Runs the callback of a finished file request.
+ *
+ * @param request The request's tag.
+ * @param result Its outcome.
+ */
+void EventLoop::CompleteFileIo(uint64_t request, int result) {
+  auto it = file_requests_.find(request);
+  if (it == file_requests_.end()) {
+    return;
+  }
+  FileIoCallback on_done = std::move(it->second);
+  file_requests_.erase(it);
+  on_done(result);
+}
+
+/**
+ * @brief Waits for the file requests still in flight, once the loop is stopping.
+ *
+ * Sockets are no longer served; callbacks may still start further requests,
+ * which are waited for as well.
+ */
+void EventLoop::DrainFileIo() {
+  std::vector<PollEvent> ready_events;
+  while (!file_requests_.empty()) {
+    if (poller_->Wait(ready_events, -1) < 0) {
+      CHAT_LOG_ERROR("Event loop poller failed with " << file_requests_.size() << " file requests in flight.");
+      return;
+    }
+    for (const PollEvent &event : ready_events) {
+      if (event.events & kPollFileDone) {
+        CompleteFileIo(event.request, event.result);
+      }
+    }
+  }
+}
+
+/**
+ * @brief Queues a task to be executed on the loop thread and wakes the loop.
+ *
+ * @param task The task to execute.
+ */
+void EventLoop::RunInLoop(std::function<void()> task) {
+  {
+    std::lock_guard<std::mutex> lock(tasks_mutex_);
+    if (running_.load()) {
+      pending_tasks_.push_back(std::move(task));
+      task = nullptr;
+    }
+  }
+
+  if (task) {
+    // The loop is not running, so nothing can race with us
+    task();
+  } else {
+    poller_->Wakeup();
+  }
+}
+
+/**
+ * @brief Executes all tasks queued by RunInLoop.
+ */
+void EventLoop::RunPendingTasks() {
+  std::vector<std::function<void()>> tasks;
+  {
+    std::lock_guard<std::mutex> lock(tasks_mutex_);
+    tasks.swap(pending_tasks_);
+  }
+  for (auto &task : tasks) {
+    task();
+  }
+}
+
+/**
+ * @brief Removes a registration if it still belongs to the given handler.
+ *
+ * @param handle The native socket handle.
+ * @param handler The handler the socket was registered with.
+ */
+void EventLoop::RemoveRegistration(NativeSocketHandle handle, IEventHandler *handler) {
+  auto it = handlers_.find(handle);
+  if (it != handlers_.end() && it->second.handler == handler) {
+    poller_->Remove(handle);
+    handlers_.erase(it); // Its timer, if any, goes stale
+  }
+}
+
+/**
+ * @brief Arms a registration's timer. Must be called on the loop thread.
+ *
+ * @param handle The native socket handle.
+ * @param handler The handler the socket was registered with.
+ * @param deadline_ms Time the timer is due, in milliseconds.
+ */
+void EventLoop::ArmTimer(NativeSocketHandle handle, IEventHandler *handler, uint64_t deadline_ms) {
+  auto it = handlers_.find(handle);
+  if (it == handlers_.end() || it->second.handler != handler) {
+    return;
+  }
+  // A new generation makes any earlier timer of this socket (or of a stale
+  // registration with the same handle) stale
+  it->second.timer_id = next_timer_id_++;
+  if (deadline_ms <= NowMilliseconds()) {
+    // Due already (e.g. "resume now" from another thread): not worth a wheel tick of delay
+    due_timers_.push_back(Timer{handle, it->second.timer_id});
+    return;
+  }
+  timers_.Add(deadline_ms, Timer{handle, it->second.timer_id});
+}
+
+/**
+ * @brief Calls OnTimer for every registration whose timer is due.
+ */
+void EventLoop::RunTimers() {
+  std::vector<Timer> due;
+  due.swap(due_timers_);
+  for (const Timer &timer : due) {
+    auto it = handlers_.find(timer.handle);
+    if (it != handlers_.end() && it->second.timer_id == timer.timer_id) {
+      it->second.timer_id = 0;
+      it->second.handler->OnTimer();
+    }
+  }
+  timers_.Advance(NowMilliseconds(), [this](Timer &&timer) {
+    // Look up per timer: an earlier OnTimer may have unregistered this socket
+    auto it = handlers_.find(timer.handle);
+    if (it == handlers_.end() || it->second.timer_id != timer.timer_id) {
+      return;
+    }
+    it->second.timer_id = 0;
+    it->second.handler->OnTimer();
+  });
+}
@@ -0,0 +1,249 @@
+#ifdef __linux__
+
+#include "IoUring.h"
+
+#include <algorithm> // For std::max
+#include <cerrno>
+#include <csignal>
+#include <cstring> // For strerror
+
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "Logger.h"
+
+namespace {
+
+/**
+ * @brief io_uring_setup(2); glibc has no wrapper.
+ *
+ * @param entries Submission queue size.
+ * @param params In: setup flags, out: queue offsets and features.
+ * @return The ring descriptor, or -1 with errno set.
+ */
+int IoUringSetup(unsigned entries, io_uring_params *params) {
+  return static_cast<int>(syscall(__NR_io_uring_setup, entries, params));
+}
+
+/**
+ * @brief Creates the ring, with the cheaper completion signalling where the kernel has it.
+ *
+ * @param entries Submission queue size.
+ * @param params Receives the queue offsets and features.
+ * @return The ring descriptor, or -1 with errno set.
+ */
+int CreateRing(unsigned entries, io_uring_params &params) {
+#ifdef IORING_SETUP_COOP_TASKRUN
+  // Completions are only reaped in io_uring_enter anyway, so they need no
+  // interrupt of the loop thread (Linux 5.19)
+  std::memset(&params, 0, sizeof(params));
+  params.flags = IORING_SETUP_COOP_TASKRUN;
+  int ring_fd = IoUringSetup(entries, &params);
+  if (ring_fd >= 0 || errno != EINVAL) {
+    return ring_fd;
+  }
+#endif
+  std::memset(&params, 0, sizeof(params));
+  return IoUringSetup(entries, &params);
+}
+
+} // namespace
+
+/**
+ * @brief Creates the ring.
+ * @param entries Submission queue size (rounded up to a power of two by the kernel).
+ */
+IoUring::IoUring(unsigned entries)
+    : ring_fd_(-1), features_(0), sq_ring_(MAP_FAILED), sq_ring_size_(0), cq_ring_(MAP_FAILED), cq_ring_size_(0),
+      sqes_(static_cast<io_uring_sqe *>(MAP_FAILED)), sqes_size_(0), sq_head_(nullptr), sq_tail_(nullptr),
+      sq_mask_(nullptr), sq_array_(nullptr), sq_entries_(0), sqe_tail_(0), cq_head_(nullptr), cq_tail_(nullptr),
+      cq_mask_(nullptr), cqes_(nullptr) {
+  io_uring_params params;
+  ring_fd_ = CreateRing(entries, params);
+  if (ring_fd_ < 0) {
+    CHAT_LOG_WARNING("io_uring is not available: " << strerror(errno));
+    return;
+  }
+  features_ = params.features;
+
+  sq_ring_size_ = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+  cq_ring_size_ = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+  bool single_mmap = (features_ & IORING_FEAT_SINGLE_MMAP) != 0;
+  if (single_mmap) {
+    sq_ring_size_ = cq_ring_size_ = std::max(sq_ring_size_, cq_ring_size_);
+  }
+  sq_ring_ = mmap(nullptr, sq_ring_size_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring_fd_,
+                  IORING_OFF_SQ_RING);
+  if (sq_ring_ != MAP_FAILED) {
+    cq_ring_ = single_mmap ? sq_ring_
+                           : mmap(nullptr, cq_ring_size_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring_fd_,
+                                  IORING_OFF_CQ_RING);
+  }
+  sqes_size_ = params.sq_entries * sizeof(io_uring_sqe);
+  if (cq_ring_ != MAP_FAILED) {
+    sqes_ = static_cast<io_uring_sqe *>(
+        mmap(nullptr, sqes_size_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring_fd_, IORING_OFF_SQES));
+  }
+  if (sq_ring_ == MAP_FAILED || cq_ring_ == MAP_FAILED || sqes_ == MAP_FAILED) {
+    CHAT_LOG_WARNING("Cannot map the io_uring queues: " << strerror(errno));
+    return;
+  }
+
+  char *sq = static_cast<char *>(sq_ring_);
+  sq_head_ = reinterpret_cast<unsigned *>(sq + params.sq_off.head);
+  sq_tail_ = reinterpret_cast<unsigned *>(sq + params.sq_off.tail);
+  sq_mask_ = reinterpret_cast<unsigned *>(sq + params.sq_off.ring_mask);
+  sq_array_ = reinterpret_cast<unsigned *>(sq + params.sq_off.array);
+  sq_entries_ = params.sq_entries;
+  sqe_tail_ = *sq_tail_;
+
+  char *cq = static_cast<char *>(cq_ring_);
+  cq_head_ = reinterpret_cast<unsigned *>(cq + params.cq_off.head);
+  cq_tail_ = reinterpret_cast<unsigned *>(cq + params.cq_off.tail);
+  cq_mask_ = reinterpret_cast<unsigned *>(cq + params.cq_off.ring_mask);
+  cqes_ = reinterpret_cast<io_uring_cqe *>(cq + params.cq_off.cqes);
+}
+
+/**
+ * @brief Unmaps the queues and closes the ring.
+ */
+IoUring::~IoUring() {
+  if (sqes_ != MAP_FAILED) {
+    munmap(sqes_, sqes_size_);
+  }
+  if (cq_ring_ != MAP_FAILED && cq_ring_ != sq_ring_) {
+    munmap(cq_ring_, cq_ring_size_);
+  }
+  if (sq_ring_ != MAP_FAILED) {
+    munmap(sq_ring_, sq_ring_size_);
+  }
+  if (ring_fd_ >= 0) {
+    close(ring_fd_);
+  }
+}
+
+/**
+ * @brief Checks if the ring was created and supports what SubmitAndWait needs.
+ *
+ * Timed waits take their timeout as an extended argument (Linux 5.11),
+ * and completions must never be dropped when the queue overflows (5.5).
+ *
+ * @return True if the ring is usable.
+ */
+bool IoUring::IsValid() const {
+  return cqes_ != nullptr && (features_ & IORING_FEAT_EXT_ARG) != 0 && (features_ & IORING_FEAT_NODROP) != 0;
+}
+
+/**
+ * @brief Gets a zeroed submission queue entry to fill in.
+ *
+ * If the queue is full, what it holds is submitted first.
+ *
+ * @return The entry, or nullptr if the kernel takes nothing.
+ */
+io_uring_sqe *IoUring::GetSqe() {
+  unsigned head = __atomic_load_n(sq_head_, __ATOMIC_ACQUIRE);
+  if (sqe_tail_ - head >= sq_entries_) {
+    if (Submit() <= 0) {
+      return nullptr;
+    }
+    head = __atomic_load_n(sq_head_, __ATOMIC_ACQUIRE);
+    if (sqe_tail_ - head >= sq_entries_) {
+      return nullptr;
+    }
+  }
+  unsigned index = sqe_tail_ & *sq_mask_;
+  io_uring_sqe *sqe = &sqes_[index];
+  std::memset(sqe, 0, sizeof(*sqe));
+  sq_array_[index] = index;
+  ++sqe_tail_;
+  return sqe;
+}
+
+/**
+ * @brief Submits the prepared entries without waiting.
+ * @return The number of entries the kernel took, or -1 on error.
+ */
+int IoUring::Submit() {
+  int result = Enter(0, 0, nullptr, 0);
+  if (result < 0) {
+    if (result == -EINTR || result == -EAGAIN || result == -EBUSY) {
+      return 0; // Left in the queue for the next call
+    }
+    CHAT_LOG_ERROR("Error submitting to io_uring: " << strerror(-result));
+    return -1;
+  }
+  return result;
+}
+
+/**
+ * @brief Submits the prepared entries and waits for at least one completion.
+ *
+ * @param timeout_ms Maximum time to wait in milliseconds, or -1 to wait indefinitely.
+ * @return 0 if completions are ready or the wait timed out or was interrupted, -1 on error.
+ */
+int IoUring::SubmitAndWait(int timeout_ms) {
+  __kernel_timespec timeout;
+  io_uring_getevents_arg arg;
+  std::memset(&arg, 0, sizeof(arg));
+  arg.sigmask_sz = _NSIG / 8;
+  if (timeout_ms >= 0) {
+    timeout.tv_sec = timeout_ms / 1000;
+    timeout.tv_nsec = static_cast<long long>(timeout_ms % 1000) * 1000000;
+    arg.ts = reinterpret_cast<uint64_t>(&timeout);
+  }
+
+  int result = Enter(1, IORING_ENTER_GETEVENTS | IORING_ENTER_EXT_ARG, &arg, sizeof(arg));
+  if (result < 0 && result != -ETIME && result != -EINTR && result != -EAGAIN && result != -EBUSY) {
+    CHAT_LOG_ERROR("Error waiting on io_uring: " << strerror(-result));
+    return -1;
+  }
+  return 0;
+}
+
+#ifdef IORING_RECV_MULTISHOT
+/**
+ * @brief Registers a ring of provided buffers for receives to pick from.
+ *
+ * @param ring The ring: page aligned, with room for entries io_uring_buf slots.
+ * @param entries Number of slots, a power of two.
+ * @param group_id Buffer group that receives name in sqe->buf_group.
+ * @return True if the kernel took the ring.
+ */
+bool IoUring::RegisterBufferRing(io_uring_buf_ring *ring, unsigned entries, uint16_t group_id) {
+  io_uring_buf_reg registration;
+  std::memset(&registration, 0, sizeof(registration));
+  registration.ring_addr = reinterpret_cast<uint64_t>(ring);
+  registration.ring_entries = entries;
+  registration.bgid = group_id;
+  if (syscall(__NR_io_uring_register, ring_fd_, IORING_REGISTER_PBUF_RING, &registration, 1) < 0) {
+    CHAT_LOG_WARNING("io_uring provided buffer rings are not available: " << strerror(errno));
+    return false;
+  }
+  return true;
+}
+#endif
+
+/**
+ * @brief Calls io_uring_enter for the prepared entries.
+ *
+ * @param min_complete Completions to wait for.
+ * @param flags IORING_ENTER_* flags.
+ * @param arg Extended argument, or nullptr.
+ * @param arg_size Size of arg.
+ * @return The kernel's result, -errno on failure.
+ */
+int IoUring::Enter(unsigned min_complete, unsigned flags, const void *arg, size_t arg_size) {
+  // Publish what was prepared; the kernel takes everything between its head and our tail
+  __atomic_store_n(sq_tail_, sqe_tail_, __ATOMIC_RELEASE);
+  unsigned to_submit = sqe_tail_ - __atomic_load_n(sq_head_, __ATOMIC_ACQUIRE);
+  if (to_submit == 0 && min_complete == 0) {
+    return 0;
+  }
+  long result = syscall(__NR_io_uring_enter, ring_fd_, to_submit, min_complete, flags, arg, arg_size);
+  return result < 0 ? -errno : static_cast<int>(result);
+}
+
+#endif // __linux__
@@ -0,0 +1,777 @@
+#ifdef __linux__
+
+#include "IoUringPoller.h"
+
+#include <algorithm> // For std::min
+#include <cerrno>
+#include <cstdint>
+#include <cstring> // For strerror
+
+#include <endian.h>
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include "Logger.h"
+
+// Submission queue size; a Wait that re-arms more sockets than this submits in several steps
+const unsigned kRingEntries = 1024;
+
+// user_data of poll removals and cancellations, whose completions carry nothing of interest
+const uint64_t kCancelUserData = ~0ull;
+
+// Marks the user_data of send requests; generations never have the top bit set
+const uint64_t kSendTag = 1ull << 63;
+
+// Marks the user_data of file requests, whose lower bits are the caller's tag; nor do generations have this bit
+const uint64_t kFileTag = 1ull << 62;
+
+// Provided receive buffers, shared by all completion-mode sockets of the ring
+const unsigned kReceiveBufferCount = 256; // A power of two
+const size_t kReceiveBufferSize = 16 * 1024;
+const uint16_t kBufferGroup = 0;
+
+namespace {
+
+/**
+ * @brief Builds the user_data identifying a poll request.
+ *
+ * @param handle The polled descriptor.
+ * @param generation The request's generation (0 for the wakeup eventfd).
+ * @return The tag the completion carries back.
+ */
+uint64_t ToUserData(int handle, uint32_t generation) {
+  return (static_cast<uint64_t>(generation) << 32) | static_cast<uint32_t>(handle);
+}
+
+/**
+ * @brief Queues a one-shot poll request.
+ *
+ * @param ring The ring.
+ * @param handle The descriptor to poll.
+ * @param mask POLL* bits to wait for.
+ * @param user_data Tag of the completion.
+ * @return False if the submission queue is full.
+ */
+bool QueuePoll(IoUring &ring, int handle, uint32_t mask, uint64_t user_data) {
+  io_uring_sqe *sqe = ring.GetSqe();
+  if (sqe == nullptr) {
+    return false;
+  }
+  sqe->opcode = IORING_OP_POLL_ADD;
+  sqe->fd = handle;
+#if __BYTE_ORDER == __BIG_ENDIAN
+  // The kernel reads the 32-bit mask as two swapped halves (the old 16-bit field comes first)
+  mask = (mask << 16) | (mask >> 16);
+#endif
+  sqe->poll32_events = mask;
+  sqe->user_data = user_data;
+  return true;
+}
+
+} // namespace
+
+/**
+ * @brief Constructs a new IoUringPoller, creating the ring and wakeup eventfd.
+ */
+IoUringPoller::IoUringPoller()
+    : ring_(kRingEntries), wakeup_fd_(-1), next_generation_(1), buffer_tail_(0),
+      multishot_(true), completion_supported_(false) {
+  if (!ring_.IsValid()) {
+    return;
+  }
+  completion_supported_ = SetUpBuffers();
+
+  wakeup_fd_ = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+  if (wakeup_fd_ < 0) {
+    CHAT_LOG_ERROR("Error creating wakeup eventfd: " << strerror(errno));
+    return;
+  }
+  ArmWakeup();
+}
+
+/**
+ * @brief Destroys the IoUringPoller and closes its descriptors.
+ *
+ * Closing the ring cancels the poll requests still in flight.
+ */
+IoUringPoller::~IoUringPoller() {
+  if (wakeup_fd_ >= 0) {
+    close(wakeup_fd_);
+  }
+  // The buffer ring is unmapped by its member, once ring_ is closed
+}
+
+/**
+ * @brief Unmaps the mapping, if any.
+ */
+IoUringPoller::Mapping::~Mapping() {
+  if (address != nullptr) {
+    munmap(address, size);
+  }
+}
+
+/**
+ * @brief Allocates the receive buffers and registers their ring.
+ *
+ * Every buffer starts out in the ring.
+ *
+ * @return True if completion mode is available.
+ */
+bool IoUringPoller::SetUpBuffers() {
+#ifdef IORING_RECV_MULTISHOT
+  size_t size = kReceiveBufferCount * sizeof(io_uring_buf);
+  void *address = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  if (address == MAP_FAILED) {
+    CHAT_LOG_WARNING("Cannot map the io_uring buffer ring: " << strerror(errno));
+    return false;
+  }
+  buffer_ring_.address = address;
+  buffer_ring_.size = size;
+  if (!ring_.RegisterBufferRing(static_cast<io_uring_buf_ring *>(address), kReceiveBufferCount, kBufferGroup)) {
+    return false;
+  }
+  buffers_.reset(new char[kReceiveBufferCount * kReceiveBufferSize]);
+  for (unsigned id = 0; id < kReceiveBufferCount; ++id) {
+    to_recycle_.push_back(static_cast<uint16_t>(id));
+  }
+  RecycleBuffers();
+  return true;
+#else
+  return false;
+#endif
+}
+
+/**
+ * @brief Hands the buffers of dispatched receives back to the kernel.
+ */
+void IoUringPoller::RecycleBuffers() {
+#ifdef IORING_RECV_MULTISHOT
+  if (to_recycle_.empty()) {
+    return;
+  }
+  // The slots start at the mapping itself; in C++ the header's bufs member sits behind an empty struct
+  io_uring_buf *slots = static_cast<io_uring_buf *>(buffer_ring_.address);
+  io_uring_buf_ring *ring = static_cast<io_uring_buf_ring *>(buffer_ring_.address);
+  for (uint16_t id : to_recycle_) {
+    // Field by field: the first slot's resv is the ring's tail
+    io_uring_buf &slot = slots[buffer_tail_ & (kReceiveBufferCount - 1)];
+    slot.addr = reinterpret_cast<uint64_t>(buffers_.get() + id * kReceiveBufferSize);
+    slot.len = static_cast<uint32_t>(kReceiveBufferSize);
+    slot.bid = id;
+    ++buffer_tail_;
+  }
+  __atomic_store_n(&ring->tail, buffer_tail_, __ATOMIC_RELEASE);
+  to_recycle_.clear();
+#endif
+}
+
+/**
+ * @brief Takes the generation for the next request.
+ * @return A generation that is neither 0 nor has either of the top two bits set.
+ */
+uint32_t IoUringPoller::NextGeneration() {
+  uint32_t generation = next_generation_;
+  next_generation_ = (next_generation_ + 1) & 0x3fffffffu;
+  if (next_generation_ == 0) {
+    next_generation_ = 1; // 0 tags the wakeup eventfd
+  }
+  return generation;
+}
+
+/**
+ * @brief Translates PollEventFlags into poll(2) event bits.
+ *
+ * @param events Bitmask of PollEventFlags.
+ * @return The corresponding POLL* bitmask.
+ */
+uint32_t IoUringPoller::ToPollMask(uint32_t events) {
+  uint32_t mask = POLLRDHUP;
+  if (events & kPollReadable) {
+    mask |= POLLIN;
+  }
+  if (events & kPollWritable) {
+    mask |= POLLOUT;
+  }
+  return mask;
+}
+
+/**
+ * @brief Queues a poll request for a socket with its current interest set.
+ *
+ * @param handle The socket file descriptor.
+ * @param watch Its state.
+ * @return False if the submission queue is full.
+ */
+bool IoUringPoller::Arm(NativeSocketHandle handle, Watch &watch) {
+  uint32_t generation = NextGeneration();
+  uint32_t mask = ToPollMask(watch.events);
+  if (!QueuePoll(ring_, handle, mask, ToUserData(handle, generation))) {
+    return false;
+  }
+  watch.generation = generation;
+  watch.armed_events = mask;
+  return true;
+}
+
+/**
+ * @brief Queues the cancellation of the poll request in flight for a socket.
+ *
+ * Whatever the cancelled request still completes with is stale from now on.
+ *
+ * @param handle The socket file descriptor.
+ * @param watch Its state.
+ */
+void IoUringPoller::Cancel(NativeSocketHandle handle, Watch &watch) {
+  io_uring_sqe *sqe = ring_.GetSqe();
+  if (sqe != nullptr) {
+    sqe->opcode = IORING_OP_POLL_REMOVE;
+    sqe->fd = -1;
+    sqe->addr = ToUserData(handle, watch.generation);
+    sqe->user_data = kCancelUserData;
+  }
+  // Without a slot the request stays in flight; its completion is ignored like a cancelled one
+  watch.armed_events = 0;
+  ++watch.generation;
+}
+
+/**
+ * @brief Queues a receive request for a completion-mode socket.
+ *
+ * The receive picks a buffer from the ring for each completion.
+ *
+ * @param handle The socket file descriptor.
+ * @param watch Its state.
+ * @return False if the submission queue is full.
+ */
+bool IoUringPoller::ArmReceive(NativeSocketHandle handle, Watch &watch) {
+#ifdef IORING_RECV_MULTISHOT
+  io_uring_sqe *sqe = ring_.GetSqe();
+  if (sqe == nullptr) {
+    return false;
+  }
+  uint32_t generation = NextGeneration();
+  sqe->opcode = IORING_OP_RECV;
+  sqe->fd = handle;
+  sqe->flags = IOSQE_BUFFER_SELECT;
+  sqe->buf_group = kBufferGroup;
+  sqe->ioprio = multishot_ ? IORING_RECV_MULTISHOT : 0;
+  sqe->user_data = ToUserData(handle, generation);
+  watch.generation = generation;
+  watch.armed_events = kPollReadable;
+  return true;
+#else
+  (void)handle;
+  (void)watch;
+  return false;
+#endif
+}
+
+/**
+ * @brief Lists a completion-mode socket for a writability report if it is due one.
+ *
+ * The kernel waits for room in the socket itself, so a socket is writable
+ * whenever no send request is in flight.
+ *
+ * @param handle The socket file descriptor.
+ * @param watch Its state.
+ */
+void IoUringPoller::QueueWritable(NativeSocketHandle handle, Watch &watch) {
+  if ((watch.events & kPollWritable) && !watch.sending && !watch.writable_queued) {
+    watch.writable_queued = true;
+    to_report_.push_back(handle);
+  }
+}
+
+/**
+ * @brief Queues the cancellation of a receive or send request.
+ * @param user_data Tag of the request.
+ */
+void IoUringPoller::QueueCancel(uint64_t user_data) {
+  io_uring_sqe *sqe = ring_.GetSqe();
+  if (sqe == nullptr) {
+    CHAT_LOG_ERROR("Error cancelling an io_uring request: the submission queue is full");
+    return;
+  }
+  sqe->opcode = IORING_OP_ASYNC_CANCEL;
+  sqe->fd = -1;
+  sqe->addr = user_data;
+  sqe->user_data = kCancelUserData;
+}
+
+/**
+ * @brief Waits until the kernel is done with a socket's send request.
+ *
+ * The caller frees the bytes being sent once the socket is removed, so the
+ * request must not outlive it; a cancelled send completes at once. Other
+ * completions that arrive meanwhile are kept for the next Wait.
+ *
+ * @param handle The socket file descriptor.
+ * @param watch Its state.
+ */
+void IoUringPoller::DrainSend(NativeSocketHandle handle, Watch &watch) {
+  uint64_t send_user_data = kSendTag | static_cast<uint32_t>(handle);
+  QueueCancel(send_user_data);
+  while (watch.sending) {
+    if (ring_.SubmitAndWait(-1) < 0) {
+      break;
+    }
+    ring_.ForEachCompletion([this, &watch, send_user_data](const io_uring_cqe &cqe) {
+      if (cqe.user_data == send_user_data) {
+        watch.sending = false;
+      } else {
+        deferred_.push_back({cqe.user_data, cqe.res, cqe.flags});
+      }
+    });
+  }
+}
+
+/**
+ * @brief Queues a poll request for the wakeup eventfd.
+ */
+void IoUringPoller::ArmWakeup() {
+  if (!QueuePoll(ring_, wakeup_fd_, POLLIN, ToUserData(wakeup_fd_, 0))) {
+    CHAT_LOG_ERROR("Error arming the io_uring wakeup eventfd");
+  }
+}
+
+/**
+ * @brief Starts watching a socket.
+ *
+ * The poll request goes to the kernel with the next Wait.
+ *
+ * @param handle The socket file descriptor.
+ * @param events Bitmask of PollEventFlags to watch for.
+ * @return True; a socket the kernel rejects reports a hangup instead.
+ */
+bool IoUringPoller::Add(NativeSocketHandle handle, uint32_t events) {
+  Watch &watch = watches_[handle];
+  watch = Watch();
+  watch.events = events;
+  to_arm_.push_back(handle);
+  return true;
+}
+
+/**
+ * @brief Starts watching a socket whose reads and writes go through the ring.
+ *
+ * The receive request goes to the kernel with the next Wait, which also
+ * reports the socket writable if that is watched.
+ *
+ * @param handle The socket file descriptor.
+ * @param events Bitmask of PollEventFlags to watch for.
+ * @return True if completion mode is supported.
+ */
+bool IoUringPoller::AddCompletion(NativeSocketHandle handle, uint32_t events) {
+  if (!completion_supported_) {
+    return false;
+  }
+  Watch &watch = watches_[handle];
+  watch = Watch();
+  watch.events = events;
+  watch.completion = true;
+  to_arm_.push_back(handle);
+  QueueWritable(handle, watch);
+  return true;
+}
+
+/**
+ * @brief Queues a gathered write on a completion-mode socket.
+ *
+ * The bytes are sent straight from the caller's buffers; the request
+ * completes once the kernel took them all or the socket failed.
+ *
+ * @param handle The socket file descriptor.
+ * @param buffers The regions to write, in order.
+ * @param count Number of regions.
+ * @return False if the socket is not in completion mode, a send is in
+ * flight already or the submission queue is full.
+ */
+bool IoUringPoller::Send(NativeSocketHandle handle, const IoBuffer *buffers, size_t count) {
+  auto it = watches_.find(handle);
+  if (it == watches_.end() || !it->second.completion || it->second.sending || count == 0) {
+    return false;
+  }
+  Watch &watch = it->second;
+  if (!watch.send) {
+    watch.send = std::make_unique<PendingSend>();
+  }
+  PendingSend &send = *watch.send;
+  send.iovecs.resize(count);
+  for (size_t i = 0; i < count; ++i) {
+    send.iovecs[i].iov_base = const_cast<void *>(buffers[i].data);
+    send.iovecs[i].iov_len = buffers[i].size;
+  }
+  std::memset(&send.header, 0, sizeof(send.header));
+  send.header.msg_iov = send.iovecs.data();
+  send.header.msg_iovlen = count;
+
+  io_uring_sqe *sqe = ring_.GetSqe();
+  if (sqe == nullptr) {
+    return false;
+  }
+  sqe->opcode = IORING_OP_SENDMSG;
+  sqe->fd = handle;
+  sqe->addr = reinterpret_cast<uint64_t>(&send.header);
+  sqe->len = 1;
+  sqe->msg_flags = MSG_NOSIGNAL;
+  sqe->user_data = kSendTag | static_cast<uint32_t>(handle);
+  watch.sending = true;
+  return true;
+}
+
+/**
+ * @brief Checks whether file requests are available.
+ * @return True if the ring is usable.
+ */
+bool IoUringPoller::SupportsFileIo() const {
+  return IsValid();
+}
+
+/**
+ * @brief Queues a positional read from a file.
+ *
+ * @param file The file descriptor.
+ * @param data Receives the bytes.
+ * @param size Number of bytes to read at most.
+ * @param offset File offset of the first byte.
+ * @param request Tag the kPollFileDone event carries back.
+ * @return True; a request the ring cannot take now goes to the kernel with the next Wait.
+ */
+bool IoUringPoller::ReadFile(NativeFileHandle file, char *data, size_t size, uint64_t offset, uint64_t request) {
+  // Larger requests are simply short reads, which callers handle anyway
+  QueueFileRequest({IORING_OP_READ, file, reinterpret_cast<uint64_t>(data),
+                    static_cast<uint32_t>(std::min<size_t>(size, UINT32_MAX)), offset, request});
+  return true;
+}
+
+/**
+ * @brief Queues a positional write to a file.
+ *
+ * @param file The file descriptor.
+ * @param data The bytes to write.
+ * @param size Number of bytes.
+ * @param offset File offset of the first byte.
+ * @param request Tag the kPollFileDone event carries back.
+ * @return True; a request the ring cannot take now goes to the kernel with the next Wait.
+ */
+bool IoUringPoller::WriteFile(NativeFileHandle file, const char *data, size_t size, uint64_t offset,
+                              uint64_t request) {
+  QueueFileRequest({IORING_OP_WRITE, file, reinterpret_cast<uint64_t>(data),
+                    static_cast<uint32_t>(std::min<size_t>(size, UINT32_MAX)), offset, request});
+  return true;
+}
+
+/**
+ * @brief Queues a file read or write, or keeps it for the next Wait if the queue is full.
+ * @param request The request.
+ */
+void IoUringPoller::QueueFileRequest(const FileRequest &request) {
+  to_submit_.push_back(request); // Behind any kept ones, so that requests keep their order
+  SubmitFileRequests();
+}
+
+/**
+ * @brief Hands the kept file requests to the ring, as far as it has slots.
+ */
+void IoUringPoller::SubmitFileRequests() {
+  size_t submitted = 0;
+  for (; submitted < to_submit_.size(); ++submitted) {
+    io_uring_sqe *sqe = ring_.GetSqe();
+    if (sqe == nullptr) {
+      break; // The rest waits for the next Wait
+    }
+    const FileRequest &request = to_submit_[submitted];
+    sqe->opcode = request.opcode;
+    sqe->fd = request.fd;
+    sqe->addr = request.address;
+    sqe->len = request.size;
+    sqe->off = request.offset;
+    sqe->user_data = kFileTag | request.request;
+  }
+  to_submit_.erase(to_submit_.begin(), to_submit_.begin() + static_cast<std::ptrdiff_t>(submitted));
+}
+
+/**
+ * @brief Changes the set of events watched for a socket.
+ *
+ * Only an event the request in flight does not wait for needs it replaced;
+ * events no longer watched are filtered out when they arrive.
+ *
+ * @param handle The socket file descriptor.
+ * @param events Bitmask of PollEventFlags to watch for.
+ * @return True if the socket is watched, false otherwise.
+ */
+bool IoUringPoller::Modify(NativeSocketHandle handle, uint32_t events) {
+  auto it = watches_.find(handle);
+  if (it == watches_.end()) {
+    return false;
+  }
+  Watch &watch = it->second;
+  watch.events = events;
+  if (watch.completion) {
+    // A receive that is no longer wanted is cancelled, but what it already received is still reported
+    if (!(events & kPollReadable) && watch.armed_events != 0) {
+      QueueCancel(ToUserData(handle, watch.generation));
+    } else if ((events & kPollReadable) && watch.armed_events == 0) {
+      to_arm_.push_back(handle);
+    }
+    QueueWritable(handle, watch);
+    return true;
+  }
+  if (watch.armed_events != 0 && (ToPollMask(events) & ~watch.armed_events) != 0) {
+    Cancel(handle, watch);
+    to_arm_.push_back(handle);
+  }
+  return true;
+}
+
+/**
+ * @brief Stops watching a socket.
+ *
+ * Enters the kernel at once, so that the poll request does not keep a socket
+ * open that the caller closes next. A send in flight is cancelled and
+ * waited for, since the caller may free its bytes next.
+ *
+ * @param handle The socket file descriptor.
+ * @return True if the socket was removed, false otherwise.
+ */
+bool IoUringPoller::Remove(NativeSocketHandle handle) {
+  auto it = watches_.find(handle);
+  if (it == watches_.end()) {
+    return false;
+  }
+  Watch &watch = it->second;
+  if (watch.completion) {
+    if (watch.armed_events != 0) {
+      QueueCancel(ToUserData(handle, watch.generation));
+    }
+    if (watch.sending) {
+      DrainSend(handle, watch);
+    } else {
+      ring_.Submit();
+    }
+  } else if (watch.armed_events != 0) {
+    Cancel(handle, watch);
+    ring_.Submit();
+  }
+  watches_.erase(it);
+  return true;
+}
+
+/**
+ * @brief Submits the queued requests and waits for readiness or completions.
+ *
+ * Sockets that were reported are re-armed by the next call, after their
+ * handlers had the chance to drain them or change what they watch; the
+ * data of receives stays valid until then, too.
+ *
+ * @param events Output vector that receives the ready sockets.
+ * @param timeout_ms Maximum time to wait in milliseconds, or -1 to wait indefinitely.
+ * @return The number of ready sockets, or -1 on error.
+ */
+int IoUringPoller::Wait(std::vector<PollEvent> &events, int timeout_ms) {
+  events.clear();
+  RecycleBuffers();
+  SubmitFileRequests();
+
+  size_t armed = 0;
+  for (; armed < to_arm_.size(); ++armed) {
+    NativeSocketHandle handle = to_arm_[armed];
+    auto it = watches_.find(handle);
+    if (it == watches_.end() || it->second.armed_events != 0) {
+      continue; // Removed, or queued twice
+    }
+    Watch &watch = it->second;
+    if (watch.completion && (!(watch.events & kPollReadable) || watch.end_of_stream)) {
+      continue; // Reading paused, or nothing left to read
+    }
+    if (!(watch.completion ? ArmReceive(handle, watch) : Arm(handle, watch))) {
+      break; // The rest waits for the next call
+    }
+  }
+  to_arm_.erase(to_arm_.begin(), to_arm_.begin() + static_cast<std::ptrdiff_t>(armed));
+
+  // Events that are known already must not wait for new ones
+  if (!deferred_.empty() || !to_report_.empty()) {
+    timeout_ms = 0;
+  }
+  if (ring_.SubmitAndWait(timeout_ms) < 0) {
+    return -1;
+  }
+
+  for (const Completion &completion : deferred_) {
+    HandleCompletion(completion, events);
+  }
+  deferred_.clear();
+  ring_.ForEachCompletion([this, &events](const io_uring_cqe &cqe) {
+    HandleCompletion({cqe.user_data, cqe.res, cqe.flags}, events);
+  });
+
+  for (NativeSocketHandle handle : to_report_) {
+    auto it = watches_.find(handle);
+    if (it == watches_.end() || !it->second.writable_queued) {
+      continue;
+    }
+    it->second.writable_queued = false;
+    if ((it->second.events & kPollWritable) && !it->second.sending) {
+      events.push_back({handle, kPollWritable});
+    }
+  }
+  to_report_.clear();
+
+  return static_cast<int>(events.size());
+}
+
+/**
+ * @brief Turns a completion into ready events.
+ *
+ * @param completion The completion.
+ * @param events Receives the events it reports.
+ */
+void IoUringPoller::HandleCompletion(const Completion &completion, std::vector<PollEvent> &events) {
+  if (completion.user_data == kCancelUserData) {
+    return;
+  }
+#ifdef IORING_RECV_MULTISHOT
+  if (completion.flags & IORING_CQE_F_BUFFER) {
+    // Back to the ring once this batch is dispatched, whoever the data was for
+    to_recycle_.push_back(static_cast<uint16_t>(completion.flags >> IORING_CQE_BUFFER_SHIFT));
+  }
+#endif
+  NativeSocketHandle handle = static_cast<int>(static_cast<uint32_t>(completion.user_data));
+  if ((completion.user_data & (kSendTag | kFileTag)) == kFileTag) {
+    PollEvent event{-1, kPollFileDone, nullptr, completion.res};
+    event.request = completion.user_data & ~kFileTag;
+    events.push_back(event);
+    return;
+  }
+  if (completion.user_data & kSendTag) {
+    auto it = watches_.find(handle);
+    if (it != watches_.end() && it->second.sending) {
+      it->second.sending = false;
+      events.push_back({handle, kPollSent, nullptr, completion.res});
+    }
+    return;
+  }
+
+  uint32_t generation = static_cast<uint32_t>(completion.user_data >> 32);
+  if (generation == 0) {
+    // Drain the eventfd counter so the next Wait blocks again
+    uint64_t counter;
+    while (read(wakeup_fd_, &counter, sizeof(counter)) > 0) {
+    }
+    ArmWakeup();
+    return;
+  }
+
+  auto it = watches_.find(handle);
+  if (it == watches_.end() || it->second.generation != generation) {
+    return; // Outlived its socket or its interest set
+  }
+  Watch &watch = it->second;
+  if (watch.completion) {
+    HandleReceive(handle, watch, completion, events);
+    return;
+  }
+  if (completion.res == -ECANCELED) {
+    return;
+  }
+  watch.armed_events = 0;
+  if (completion.res < 0) {
+    // Not pollable (closed behind our back, say); report it once and let the owner remove it
+    events.push_back({handle, kPollHangup});
+    return;
+  }
+
+  uint32_t flags = 0;
+  if (completion.res & POLLIN) {
+    flags |= kPollReadable;
+  }
+  if (completion.res & POLLOUT) {
+    flags |= kPollWritable;
+  }
+  if (completion.res & (POLLERR | POLLHUP | POLLRDHUP)) {
+    flags |= kPollHangup;
+  }
+  flags &= watch.events | kPollHangup;
+  if (flags != 0) {
+    events.push_back({handle, flags});
+  }
+  to_arm_.push_back(handle);
+}
+
+/**
+ * @brief Turns the completion of a receive request into ready events.
+ *
+ * Data is reported even after readability stopped being watched: it was
+ * taken off the socket already. A receive that ended is re-armed by the
+ * next Wait while readability is watched.
+ *
+ * @param handle The socket file descriptor.
+ * @param watch Its state.
+ * @param completion The completion.
+ * @param events Receives the events it reports.
+ */
+void IoUringPoller::HandleReceive(NativeSocketHandle handle, Watch &watch, const Completion &completion,
+                                  std::vector<PollEvent> &events) {
+#ifdef IORING_RECV_MULTISHOT
+  bool more = (completion.flags & IORING_CQE_F_MORE) != 0;
+  if (!more) {
+    watch.armed_events = 0;
+  }
+  if (completion.res > 0 && (completion.flags & IORING_CQE_F_BUFFER)) {
+    size_t id = completion.flags >> IORING_CQE_BUFFER_SHIFT;
+    events.push_back({handle, kPollReceived, buffers_.get() + id * kReceiveBufferSize, completion.res});
+  } else if (completion.res == 0) {
+    watch.end_of_stream = true;
+    events.push_back({handle, kPollReceived, nullptr, 0});
+    return;
+  } else if (completion.res == -EINVAL && multishot_) {
+    CHAT_LOG_INFO("io_uring has no multishot receives on this kernel, re-arming each receive.");
+    multishot_ = false;
+  } else if (completion.res < 0 && completion.res != -ENOBUFS && completion.res != -ECANCELED) {
+    events.push_back({handle, kPollReceived, nullptr, completion.res});
+    return;
+  }
+  // Out of buffers, cancelled, or a single-shot receive: the next Wait re-arms if still wanted
+  if (!more && (watch.events & kPollReadable)) {
+    to_arm_.push_back(handle);
+  }
+#else
+  (void)handle;
+  (void)watch;
+  (void)completion;
+  (void)events;
+#endif
+}
+
+/**
+ * @brief Interrupts Wait by signalling the eventfd.
+ */
+void IoUringPoller::Wakeup() {
+  uint64_t one = 1;
+  if (write(wakeup_fd_, &one, sizeof(one)) < 0 && errno != EAGAIN) {
+    CHAT_LOG_ERROR("Error signalling io_uring wakeup: " << strerror(errno));
+  }
+}
+
+/**
+ * @brief Checks if the ring and the eventfd were created successfully.
+ *
+ * @return True if the poller is usable, false otherwise.
+ */
+bool IoUringPoller::IsValid() const {
+  return ring_.IsValid() && wakeup_fd_ >= 0;
+}
+
+/**
+ * @brief Checks whether the provided buffer ring was registered.
+ * @return True if AddCompletion and Send are available.
+ */
+bool IoUringPoller::SupportsCompletion() const {
+  return completion_supported_;
+}
+
+#endif // __linux__
@@ -0,0 +1,229 @@
+#include "Logger.h"
+
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+
+const size_t Logger::kDefaultCapacity;
+const uint32_t LogRateLimiter::kDefaultBurst;
+const uint64_t LogRateLimiter::kDefaultPeriodMs;
+
+namespace {
+
+// How long the logging thread sleeps when idle; bounds the delay of a
+// message whose wakeup raced with the thread falling asleep
+const auto kIdleWait = std::chrono::milliseconds(50);
+
+/**
+ * @brief Drains and stops the logger at process exit.
+ */
+void ShutdownLoggerAtExit() {
+  Logger::Instance().Shutdown();
+}
+
+/**
+ * @brief Reads a monotonic clock.
+ * @return Milliseconds since an arbitrary epoch.
+ */
+uint64_t NowMilliseconds() {
+  return static_cast<uint64_t>(
+      std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now().time_since_epoch())
+          .count());
+}
+
+} // namespace
+
+/**
+ * @brief Gets the process-wide logger, starting its thread on first use.
+ * @return The logger.
+ */
+Logger &Logger::Instance() {
+  // Leaked so that threads still running during exit never see it destroyed
+  static Logger *logger = [] {
+    Logger *instance = new Logger(kDefaultCapacity);
+    std::atexit(ShutdownLoggerAtExit);
+    return instance;
+  }();
+  return *logger;
+}
+
+/**
+ * @brief Constructs the logger and starts its thread.
+ * @param capacity Ring size, rounded up to a power of two.
+ */
+Logger::Logger(size_t capacity)
+    : mask_(0), enqueue_pos_(0), dequeue_pos_(0), written_pos_(0), level_(LogLevel::INFO), dropped_(0),
+      running_(true), consumer_waiting_(false) {
+  size_t size = 2;
+  while (size < capacity) {
+    size <<= 1;
+  }
+  mask_ = size - 1;
+  slots_.reset(new Slot[size]);
+  for (size_t i = 0; i < size; ++i) {
+    slots_[i].sequence.store(i, std::memory_order_relaxed);
+  }
+  thread_ = std::thread(&Logger::Run, this);
+}
+
+/**
+ * @brief Queues a formatted message. Never blocks.
+ *
+ * Producers claim a cell by advancing enqueue_pos_, fill it, then publish it
+ * through the cell's sequence number (a bounded MPMC ring used with a single
+ * consumer).
+ *
+ * @param level The message level.
+ * @param text The message, without a trailing newline.
+ */
+void Logger::Write(LogLevel level, std::string text) {
+  if (!running_.load(std::memory_order_acquire)) {
+    Emit(level, text);
+    return;
+  }
+
+  size_t pos = enqueue_pos_.load(std::memory_order_relaxed);
+  Slot *slot = nullptr;
+  for (;;) {
+    slot = &slots_[pos & mask_];
+    size_t sequence = slot->sequence.load(std::memory_order_acquire);
+    intptr_t difference = static_cast<intptr_t>(sequence) - static_cast<intptr_t>(pos);
+    if (difference == 0) {
+      if (enqueue_pos_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+        break;
+      }
+    } else if (difference < 0) {
+      // Full: the logging thread has not read this cell since the last lap
+      dropped_.fetch_add(1, std::memory_order_relaxed);
+      return;
+    } else {
+      pos = enqueue_pos_.load(std::memory_order_relaxed);
+    }
+  }
+
+  slot->level = level;
+  slot->text = std::move(text);
+  slot->sequence.store(pos + 1, std::memory_order_seq_cst);
+
+  // Only the first message after the thread went idle pays for the lock
+  if (consumer_waiting_.load(std::memory_order_seq_cst) && consumer_waiting_.exchange(false)) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    consumer_cv_.notify_one();
+  }
+}
+
+/**
+ * @brief Blocks until every message queued before the call is written.
+ */
+void Logger::Flush() {
+  size_t target = enqueue_pos_.load();
+  std::unique_lock<std::mutex> lock(mutex_);
+  consumer_waiting_.store(false);
+  consumer_cv_.notify_one();
+  flushed_cv_.wait(lock, [&] { return written_pos_.load() >= target || !running_.load(); });
+}
+
+/**
+ * @brief Writes out everything queued and stops the background thread.
+ */
+void Logger::Shutdown() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (!running_.exchange(false)) {
+      return;
+    }
+    consumer_cv_.notify_one();
+  }
+  if (thread_.joinable()) {
+    thread_.join();
+  }
+  // Messages claimed just before running_ was cleared
+  Drain();
+  flushed_cv_.notify_all();
+}
+
+/**
+ * @brief The main loop for the logging thread.
+ */
+void Logger::Run() {
+  while (running_.load()) {
+    if (Drain() > 0) {
+      continue;
+    }
+    std::unique_lock<std::mutex> lock(mutex_);
+    // Announce the wait before the final check, as in MpscQueue::Wait
+    consumer_waiting_.store(true, std::memory_order_seq_cst);
+    consumer_cv_.wait_for(lock, kIdleWait, [this] {
+      return !running_.load() ||
+             slots_[dequeue_pos_ & mask_].sequence.load(std::memory_order_seq_cst) == dequeue_pos_ + 1;
+    });
+    consumer_waiting_.store(false, std::memory_order_relaxed);
+  }
+  Drain();
+}
+
+/**
+ * @brief Writes out every published message. Logging thread only.
+ * @return The number of messages written.
+ */
+size_t Logger::Drain() {
+  size_t count = 0;
+  bool wrote_stdout = false;
+  bool wrote_stderr = false;
+  for (;;) {
+    Slot &slot = slots_[dequeue_pos_ & mask_];
+    if (slot.sequence.load(std::memory_order_acquire) != dequeue_pos_ + 1) {
+      break;
+    }
+    Emit(slot.level, slot.text);
+    (slot.level >= LogLevel::WARNING ? wrote_stderr : wrote_stdout) = true;
+    slot.text.clear();
+    // Hand the cell back to producers for the next lap
+    slot.sequence.store(dequeue_pos_ + mask_ + 1, std::memory_order_release);
+    ++dequeue_pos_;
+    ++count;
+  }
+
+  if (count > 0) {
+    // One flush per batch instead of one per line
+    if (wrote_stdout) {
+      std::cout.flush();
+    }
+    if (wrote_stderr) {
+      std::cerr.flush();
+    }
+    std::lock_guard<std::mutex> lock(mutex_);
+    written_pos_.store(dequeue_pos_);
+    flushed_cv_.notify_all();
+  }
+  return count;
+}
+
+/**
+ * @brief Writes one message to stdout or stderr, depending on its level.
+ * @param level The message level.
+ * @param text The message.
+ */
+void Logger::Emit(LogLevel level, const std::string &text) {
+  std::ostream &stream = level >= LogLevel::WARNING ? std::cerr : std::cout;
+  stream << text << '\n';
+}
+
+/**
+ * @brief Checks whether one more message may be logged.
+ * @param suppressed Receives the number of messages suppressed since the last one that was allowed.
+ * @return True if the message may be logged.
+ */
+bool LogRateLimiter::Allow(uint64_t &suppressed) {
+  uint64_t now = NowMilliseconds();
+  uint64_t start = period_start_ms_.load(std::memory_order_relaxed);
+  if (now - start >= period_ms_ && period_start_ms_.compare_exchange_strong(start, now)) {
+    count_.store(0, std::memory_order_relaxed);
+  }
+  if (count_.fetch_add(1, std::memory_order_relaxed) < burst_) {
+    suppressed = suppressed_.exchange(0, std::memory_order_relaxed);
+    return true;
+  }
+  suppressed_.fetch_add(1, std::memory_order_relaxed);
+  return false;
+}
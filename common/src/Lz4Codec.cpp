@@ -0,0 +1,70 @@
+#include "Lz4Codec.h"
+
+#include <lz4.h>
+
+#include <algorithm>
+#include <climits>
+
+/**
+ * @brief Gets the codec's wire identifier.
+ * @return CompressionCodecId::LZ4.
+ */
+CompressionCodecId Lz4Codec::GetId() const {
+  return CompressionCodecId::LZ4;
+}
+
+/**
+ * @brief Gets the codec's name.
+ * @return "lz4".
+ */
+const char *Lz4Codec::GetName() const {
+  return "lz4";
+}
+
+/**
+ * @brief Gets the worst-case compressed size of an input.
+ * @param size The input size in bytes.
+ * @return The LZ4 bound for size bytes.
+ */
+size_t Lz4Codec::GetMaxCompressedSize(size_t size) const {
+  if (size > static_cast<size_t>(LZ4_MAX_INPUT_SIZE)) {
+    return 0;
+  }
+  return static_cast<size_t>(LZ4_compressBound(static_cast<int>(size)));
+}
+
+/**
+ * @brief Compresses a block.
+ *
+ * @param data The input bytes.
+ * @param size Number of input bytes.
+ * @param out Destination buffer.
+ * @param capacity Size of the destination buffer.
+ * @return The compressed size, or 0 on failure.
+ */
+size_t Lz4Codec::Compress(const char *data, size_t size, char *out, size_t capacity) const {
+  if (size > static_cast<size_t>(LZ4_MAX_INPUT_SIZE)) {
+    return 0;
+  }
+  int dst_capacity = static_cast<int>(std::min<size_t>(capacity, INT_MAX));
+  int compressed_size = LZ4_compress_default(data, out, static_cast<int>(size), dst_capacity);
+  return compressed_size > 0 ? static_cast<size_t>(compressed_size) : 0;
+}
+
+/**
+ * @brief Decompresses a block whose original size is known.
+ *
+ * @param data The compressed bytes.
+ * @param size Number of compressed bytes.
+ * @param out Destination buffer of exactly original_size bytes.
+ * @param original_size The size of the uncompressed block.
+ * @return False if the data is corrupt or does not expand to original_size bytes.
+ */
+bool Lz4Codec::Decompress(const char *data, size_t size, char *out, size_t original_size) const {
+  if (size > static_cast<size_t>(LZ4_MAX_INPUT_SIZE) || original_size > static_cast<size_t>(LZ4_MAX_INPUT_SIZE)) {
+    return false;
+  }
+  int decompressed_size =
+      LZ4_decompress_safe(data, out, static_cast<int>(size), static_cast<int>(original_size));
+  return decompressed_size >= 0 && static_cast<size_t>(decompressed_size) == original_size;
+}
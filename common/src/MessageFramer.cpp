@@ -0,0 +1,260 @@
+#include "MessageFramer.h"
+
+#include <algorithm>
+#include <cstring>
+
+#include "MessageSerialization.h"
+
+// A read counts as small if it used less than 1/kSmallReadDivisor of the window
+const size_t kSmallReadDivisor = 4;
+
+// Number of consecutive small reads after which the read window is halved
+const int kSmallReadsBeforeShrink = 8;
+
+/**
+ * @brief Constructs a new MessageFramer.
+ *
+ * @param min_read_size Smallest read window offered by PrepareRead.
+ * @param max_read_size Largest read window offered by PrepareRead.
+ * @param max_frame_size Largest frame accepted, header included.
+ */
+MessageFramer::MessageFramer(size_t min_read_size, size_t max_read_size, size_t max_frame_size)
+    : read_pos_(0), write_pos_(0), min_read_size_(std::max<size_t>(1, min_read_size)),
+      max_read_size_(std::max(min_read_size_, max_read_size)), max_frame_size_(max_frame_size),
+      read_size_(min_read_size_), offered_size_(0), small_reads_(0), peer_protocol_version_(0),
+      error_(FramingError::NONE) {}
+
+/**
+ * @brief Provides the buffer region for the next receive call.
+ *
+ * @param capacity Receives the number of bytes that may be written.
+ * @return Pointer to the writable region.
+ */
+char *MessageFramer::PrepareRead(size_t &capacity) {
+  size_t pending = write_pos_ - read_pos_;
+  if (pending == 0) {
+    // Everything was consumed: start over at the front for free
+    read_pos_ = 0;
+    write_pos_ = 0;
+  }
+
+  // Make sure a partially received large frame fits in one piece, so it can
+  // be handed out as a single view
+  size_t wanted = read_size_;
+  MessageHeader header;
+  size_t header_size = 0;
+  int protocol_version = 0;
+  if (error_ == FramingError::NONE &&
+      DecodeMessageHeader(buffer_.data() + read_pos_, pending, header, header_size, protocol_version) ==
+          HeaderDecodeStatus::OK) {
+    size_t frame_size = header_size + header.payload_size;
+    if (IsTooLarge(header, header_size)) {
+      // Refuse before growing the buffer; Next reports the error
+      error_ = FramingError::FRAME_TOO_LARGE;
+    } else if (frame_size > pending && frame_size >= kMinDetachedFrameSize) {
+      // Give the frame a buffer of its own and stop reading at its end, so
+      // Next can detach the buffer instead of copying the frame out
+      if (read_pos_ > 0) {
+        std::memmove(buffer_.data(), buffer_.data() + read_pos_, pending);
+        read_pos_ = 0;
+        write_pos_ = pending;
+      }
+      if (buffer_.size() < frame_size) {
+        buffer_.resize(frame_size);
+      }
+      offered_size_ = frame_size - write_pos_;
+      capacity = offered_size_;
+      return buffer_.data() + write_pos_;
+    }
+    if (error_ == FramingError::NONE && frame_size > pending) {
+      wanted = std::max(wanted, frame_size - pending);
+    }
+  }
+
+  if (buffer_.size() - write_pos_ < wanted) {
+    if (read_pos_ > 0) {
+      // Compact: move the (at most one partial) unconsumed frame to the front
+      std::memmove(buffer_.data(), buffer_.data() + read_pos_, pending);
+      read_pos_ = 0;
+      write_pos_ = pending;
+    }
+    if (buffer_.size() - write_pos_ < wanted) {
+      buffer_.resize(write_pos_ + wanted);
+    }
+  }
+
+  offered_size_ = buffer_.size() - write_pos_;
+  capacity = offered_size_;
+  return buffer_.data() + write_pos_;
+}
+
+/**
+ * @brief Records how many bytes the receive call wrote.
+ *
+ * @param bytes_received Number of bytes written into the PrepareRead region.
+ */
+void MessageFramer::CommitRead(size_t bytes_received) {
+  bytes_received = std::min(bytes_received, offered_size_);
+  write_pos_ += bytes_received;
+
+  if (bytes_received == offered_size_) {
+    // The socket had more to give: read bigger chunks
+    read_size_ = std::min(read_size_ * 2, max_read_size_);
+    small_reads_ = 0;
+  } else if (bytes_received < read_size_ / kSmallReadDivisor) {
+    if (++small_reads_ >= kSmallReadsBeforeShrink) {
+      read_size_ = std::max(read_size_ / 2, min_read_size_);
+      small_reads_ = 0;
+    }
+  } else {
+    small_reads_ = 0;
+  }
+}
+
+/**
+ * @brief Extracts the next complete message, if any.
+ *
+ * @param view Receives the message; valid until the next PrepareRead call.
+ * @return True if a complete message was extracted.
+ */
+bool MessageFramer::Next(MessageView &view) {
+  if (error_ != FramingError::NONE) {
+    return false;
+  }
+
+  // Decode only the header out of the buffer; the payload stays in place
+  size_t pending = write_pos_ - read_pos_;
+  MessageHeader header;
+  size_t header_size = 0;
+  int protocol_version = 0;
+  HeaderDecodeStatus status =
+      DecodeMessageHeader(buffer_.data() + read_pos_, pending, header, header_size, protocol_version);
+  if (status == HeaderDecodeStatus::INVALID) {
+    error_ = FramingError::INVALID_HEADER;
+    return false;
+  }
+  // Checked before waiting for the payload, which is never buffered
+  if (status == HeaderDecodeStatus::OK && IsTooLarge(header, header_size)) {
+    error_ = FramingError::FRAME_TOO_LARGE;
+    return false;
+  }
+  if (status == HeaderDecodeStatus::INCOMPLETE || header.payload_size > pending - header_size) {
+    return false; // Not enough data for a complete message yet
+  }
+
+  peer_protocol_version_ = std::max(peer_protocol_version_, protocol_version);
+  view.header = header;
+
+  size_t frame_size = header_size + header.payload_size;
+  if (header.flags & kCompactFlagCompressed) {
+    // Expand into the framer's own buffer; handlers see the original message.
+    // IsTooLarge guarantees header_size <= max_frame_size_, and the expanded
+    // frame must fit the same limit as a plain one.
+    DecompressStatus decompress_status =
+        DecompressPayload(PayloadView(buffer_.data() + read_pos_ + header_size, header.payload_size), decompressed_,
+                          max_frame_size_ - header_size);
+    if (decompress_status != DecompressStatus::OK) {
+      error_ = decompress_status == DecompressStatus::TOO_LARGE ? FramingError::FRAME_TOO_LARGE
+                                                                : FramingError::INVALID_PAYLOAD;
+      return false;
+    }
+    view.header.flags &= static_cast<uint8_t>(~kCompactFlagCompressed);
+    view.header.payload_size = decompressed_.size();
+    view.frame.reset();
+    view.wire = PayloadView();
+    view.frame_version = 0;
+    view.payload = PayloadView(decompressed_);
+    read_pos_ += frame_size;
+    return true;
+  }
+
+  if (frame_size >= kMinDetachedFrameSize && read_pos_ == 0 && write_pos_ == frame_size) {
+    // The buffer holds exactly this frame (see PrepareRead): hand it over
+    buffer_.resize(frame_size);
+    view.frame = std::allocate_shared<const PooledBuffer>(PoolAllocator<PooledBuffer>(), std::move(buffer_));
+    view.wire = PayloadView(*view.frame);
+    view.frame_version = protocol_version;
+    view.payload = PayloadView(view.frame->data() + header_size, header.payload_size);
+    buffer_ = PooledBuffer();
+    write_pos_ = 0;
+    return true;
+  }
+
+  view.frame.reset();
+  view.wire = PayloadView(buffer_.data() + read_pos_, frame_size);
+  view.frame_version = protocol_version;
+  view.payload = PayloadView(buffer_.data() + read_pos_ + header_size, header.payload_size);
+  read_pos_ += frame_size;
+  return true;
+}
+
+/**
+ * @brief Gets the number of received bytes not yet returned by Next.
+ * @return The buffered byte count.
+ */
+size_t MessageFramer::BufferedBytes() const {
+  return write_pos_ - read_pos_;
+}
+
+/**
+ * @brief Gets the highest wire protocol version seen from the peer.
+ * @return The protocol version, or 0 if no message was received yet.
+ */
+int MessageFramer::GetPeerProtocolVersion() const {
+  return peer_protocol_version_;
+}
+
+/**
+ * @brief Checks whether the stream contained an undecodable header.
+ * @return True if framing failed; the connection should be dropped.
+ */
+bool MessageFramer::HasError() const {
+  return error_ != FramingError::NONE;
+}
+
+/**
+ * @brief Gets the reason framing failed.
+ * @return The error, or FramingError::NONE if HasError is false.
+ */
+FramingError MessageFramer::GetError() const {
+  return error_;
+}
+
+/**
+ * @brief Gets the current adaptive read window size.
+ * @return The read size in bytes.
+ */
+size_t MessageFramer::GetReadSize() const {
+  return read_size_;
+}
+
+/**
+ * @brief Checks a decoded header against the maximum frame size.
+ *
+ * @param header The decoded header.
+ * @param header_size Encoded size of the header.
+ * @return True if the frame must be refused.
+ */
+bool MessageFramer::IsTooLarge(const MessageHeader &header, size_t header_size) const {
+  // Compared without adding, a hostile payload_size could overflow the sum
+  return header_size > max_frame_size_ || header.payload_size > max_frame_size_ - header_size;
+}
+
+/**
+ * @brief Frees the receive buffers while no partial message is buffered.
+ * @return The number of bytes of buffer capacity released.
+ */
+size_t MessageFramer::ReleaseMemory() {
+  if (BufferedBytes() > 0) {
+    return 0; // Part of a message is still on its way
+  }
+  size_t released = buffer_.capacity() + decompressed_.capacity();
+  PooledBuffer().swap(buffer_);
+  PooledBuffer().swap(decompressed_);
+  read_pos_ = 0;
+  write_pos_ = 0;
+  // A quiet connection starts over with small reads
+  read_size_ = min_read_size_;
+  small_reads_ = 0;
+  return released;
+}
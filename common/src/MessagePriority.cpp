@@ -0,0 +1,29 @@
+#include "MessagePriority.h"
+
+/**
+ * @brief Gets the scheduling class of a message.
+ * @param type The message type.
+ * @return The priority class.
+ */
+MessagePriority GetMessagePriority(MessageType type) {
+  switch (type) {
+  case MessageType::BROADCAST_MESSAGE:
+  case MessageType::PRIVATE_MESSAGE:
+  case MessageType::ROOM_MESSAGE:
+    return MessagePriority::CHAT;
+  case MessageType::FILE_DATA_CHUNK:
+  case MessageType::FILE_TRANSFER_COMPLETE:
+    return MessagePriority::BULK;
+  default:
+    return MessagePriority::CONTROL;
+  }
+}
+
+/**
+ * @brief Gets the flow a message belongs to for fair scheduling of bulk traffic.
+ * @param header The message header.
+ * @return The flow key.
+ */
+uint64_t GetMessageFlow(const MessageHeader &header) {
+  return (static_cast<uint64_t>(static_cast<uint32_t>(header.sender_id)) << 32) | header.transfer_id;
+}
@@ -1,36 +1,327 @@
 #include "MessageSerialization.h"
 
-#include <iostream>
+#include <algorithm>
+#include <cstdio>
+
+#include "CompressionCodecs.h"
+#include "Logger.h"
+
+namespace {
+
+/**
+ * @brief Appends an unsigned LEB128 varint.
+ * @param value The value to encode.
+ * @param out Destination pointer, advanced past the written bytes.
+ */
+void WriteVarint(uint64_t value, char *&out) {
+  while (value >= 0x80) {
+    *out++ = static_cast<char>((value & 0x7F) | 0x80);
+    value >>= 7;
+  }
+  *out++ = static_cast<char>(value);
+}
+
+/**
+ * @brief Reads an unsigned LEB128 varint.
+ * @param data Source pointer, advanced past the consumed bytes.
+ * @param end End of the available bytes.
+ * @param max_bytes Maximum encoded length accepted.
+ * @param value Receives the decoded value.
+ * @return The decode status.
+ */
+HeaderDecodeStatus ReadVarint(const char *&data, const char *end, size_t max_bytes, uint64_t &value) {
+  value = 0;
+  for (size_t i = 0; i < max_bytes; ++i) {
+    if (data == end) {
+      return HeaderDecodeStatus::INCOMPLETE;
+    }
+    uint8_t byte = static_cast<uint8_t>(*data++);
+    value |= static_cast<uint64_t>(byte & 0x7F) << (7 * i);
+    if ((byte & 0x80) == 0) {
+      return HeaderDecodeStatus::OK;
+    }
+  }
+  return HeaderDecodeStatus::INVALID;
+}
+
+/**
+ * @brief Maps a signed 32-bit value to an unsigned one so that small
+ * magnitudes (including -1, the broadcast/server ID) encode in one byte.
+ * @param value The signed value.
+ * @return The zigzag encoded value.
+ */
+uint32_t ZigZagEncode(int32_t value) {
+  return (static_cast<uint32_t>(value) << 1) ^ static_cast<uint32_t>(value >> 31);
+}
+
+/**
+ * @brief Inverse of ZigZagEncode.
+ * @param value The zigzag encoded value.
+ * @return The signed value.
+ */
+int32_t ZigZagDecode(uint32_t value) {
+  return static_cast<int32_t>((value >> 1) ^ (~(value & 1) + 1));
+}
+
+// Longest varint of a 64-bit value
+const size_t kMaxVarintSize = 10;
+
+} // namespace
+
+/**
+ * @brief Encodes a message header.
+ *
+ * @param header The header to encode (type must be below 64 for version 2).
+ * @param protocol_version The wire protocol version to use.
+ * @param out Destination with room for at least kMaxWireHeaderSize bytes.
+ * @return The number of bytes written.
+ */
+size_t EncodeMessageHeader(const MessageHeader &header, int protocol_version, char *out) {
+  if (protocol_version < kProtocolVersionCompact) {
+    // Zero the struct first so padding bytes do not leak onto the wire
+    LegacyWireHeader legacy;
+    std::memset(&legacy, 0, sizeof(legacy));
+    legacy.type = header.type;
+    legacy.sender_id = header.sender_id;
+    legacy.recipient_id = header.recipient_id;
+    legacy.payload_size = header.payload_size;
+    std::memcpy(out, &legacy, kMessageHeaderSize);
+    return kMessageHeaderSize;
+  }
+
+  char *start = out;
+  uint8_t flags = header.flags & static_cast<uint8_t>(~kCompactFlagTransferId);
+  if (header.transfer_id != 0) {
+    flags |= kCompactFlagTransferId;
+  }
+  uint8_t first = kCompactHeaderMarker | (static_cast<uint8_t>(header.type) & kCompactHeaderTypeMask);
+  if (flags != 0) {
+    first |= kCompactHeaderHasFlags;
+  }
+  *out++ = static_cast<char>(first);
+  if (flags != 0) {
+    *out++ = static_cast<char>(flags);
+  }
+  WriteVarint(ZigZagEncode(header.sender_id), out);
+  WriteVarint(ZigZagEncode(header.recipient_id), out);
+  WriteVarint(header.payload_size, out);
+  if (header.transfer_id != 0) {
+    WriteVarint(header.transfer_id, out);
+  }
+  if (flags & kCompactFlagChecksum) {
+    for (int shift = 0; shift < 32; shift += 8) {
+      *out++ = static_cast<char>((header.checksum >> shift) & 0xFF);
+    }
+  }
+  return static_cast<size_t>(out - start);
+}
+
+/**
+ * @brief Decodes a message header in either wire format.
+ *
+ * @param data The received bytes, starting at a frame boundary.
+ * @param size The number of available bytes.
+ * @param header Receives the decoded header.
+ * @param header_size Receives the encoded size of the header.
+ * @param protocol_version Receives the version the header was encoded with.
+ * @return The decode status.
+ */
+HeaderDecodeStatus DecodeMessageHeader(const char *data, size_t size, MessageHeader &header, size_t &header_size,
+                                       int &protocol_version) {
+  if (size == 0) {
+    return HeaderDecodeStatus::INCOMPLETE;
+  }
+
+  uint8_t first = static_cast<uint8_t>(data[0]);
+  if ((first & kCompactHeaderMarker) == 0) {
+    if (size < kMessageHeaderSize) {
+      return HeaderDecodeStatus::INCOMPLETE;
+    }
+    LegacyWireHeader legacy;
+    std::memcpy(&legacy, data, kMessageHeaderSize);
+    header = {legacy.type, legacy.sender_id, legacy.recipient_id, legacy.payload_size, 0, 0, 0};
+    header_size = kMessageHeaderSize;
+    protocol_version = kProtocolVersionLegacy;
+    return HeaderDecodeStatus::OK;
+  }
+
+  const char *cursor = data + 1;
+  const char *end = data + size;
+  uint8_t flags = 0;
+  if (first & kCompactHeaderHasFlags) {
+    if (cursor == end) {
+      return HeaderDecodeStatus::INCOMPLETE;
+    }
+    flags = static_cast<uint8_t>(*cursor++);
+  }
+
+  uint64_t sender = 0;
+  uint64_t recipient = 0;
+  uint64_t payload_size = 0;
+  HeaderDecodeStatus status = ReadVarint(cursor, end, 5, sender);
+  if (status == HeaderDecodeStatus::OK) {
+    status = ReadVarint(cursor, end, 5, recipient);
+  }
+  if (status == HeaderDecodeStatus::OK) {
+    status = ReadVarint(cursor, end, 10, payload_size);
+  }
+  uint64_t transfer_id = 0;
+  if (status == HeaderDecodeStatus::OK && (flags & kCompactFlagTransferId)) {
+    status = ReadVarint(cursor, end, 5, transfer_id);
+  }
+  uint32_t checksum = 0;
+  if (status == HeaderDecodeStatus::OK && (flags & kCompactFlagChecksum)) {
+    if (end - cursor < 4) {
+      return HeaderDecodeStatus::INCOMPLETE;
+    }
+    for (int shift = 0; shift < 32; shift += 8) {
+      checksum |= static_cast<uint32_t>(static_cast<uint8_t>(*cursor++)) << shift;
+    }
+  }
+  if (status != HeaderDecodeStatus::OK) {
+    return status;
+  }
+  if (sender > UINT32_MAX || recipient > UINT32_MAX || payload_size > SIZE_MAX || transfer_id > UINT32_MAX) {
+    return HeaderDecodeStatus::INVALID;
+  }
+
+  header.type = static_cast<MessageType>(first & kCompactHeaderTypeMask);
+  header.sender_id = ZigZagDecode(static_cast<uint32_t>(sender));
+  header.recipient_id = ZigZagDecode(static_cast<uint32_t>(recipient));
+  header.payload_size = static_cast<size_t>(payload_size);
+  header.flags = flags & static_cast<uint8_t>(~kCompactFlagTransferId);
+  header.transfer_id = static_cast<uint32_t>(transfer_id);
+  header.checksum = checksum;
+  header_size = static_cast<size_t>(cursor - data);
+  protocol_version = kProtocolVersionCompact;
+  return HeaderDecodeStatus::OK;
+}
+
+/**
+ * @brief Compresses a payload for a frame with kCompactFlagCompressed.
+ *
+ * @param payload The original payload.
+ * @param codec The codec to use.
+ * @param out Receives the compressed payload: codec ID byte, varint original
+ * size, codec output.
+ * @return False if the payload was not compressed; out is then unusable.
+ */
+bool CompressPayload(const PayloadView &payload, CompressionCodecId codec, PooledBuffer &out) {
+  const ICompressionCodec *compressor = FindCompressionCodec(codec);
+  if (!compressor || payload.size() < kMinCompressedPayloadSize) {
+    return false;
+  }
+  size_t max_compressed_size = compressor->GetMaxCompressedSize(payload.size());
+  if (max_compressed_size == 0) {
+    return false;
+  }
+
+  out.resize(1 + kMaxVarintSize + max_compressed_size);
+  char *cursor = out.data();
+  *cursor++ = static_cast<char>(codec);
+  WriteVarint(payload.size(), cursor);
+  size_t prefix_size = static_cast<size_t>(cursor - out.data());
+
+  size_t compressed_size = compressor->Compress(payload.data(), payload.size(), cursor, out.size() - prefix_size);
+  if (compressed_size == 0 || prefix_size + compressed_size >= payload.size()) {
+    return false; // Incompressible (e.g. an already compressed file)
+  }
+  out.resize(prefix_size + compressed_size);
+  return true;
+}
+
+/**
+ * @brief Expands a payload received with kCompactFlagCompressed.
+ *
+ * @param payload The compressed payload.
+ * @param out Receives the original payload.
+ * @param max_size Largest original payload accepted.
+ * @return OK, TOO_LARGE if the claimed original size exceeds max_size
+ * (checked before out grows), or INVALID if the payload cannot be expanded.
+ */
+DecompressStatus DecompressPayload(const PayloadView &payload, PooledBuffer &out, size_t max_size) {
+  if (payload.empty()) {
+    return DecompressStatus::INVALID;
+  }
+  const ICompressionCodec *codec = FindCompressionCodec(static_cast<CompressionCodecId>(payload[0]));
+  if (!codec) {
+    return DecompressStatus::INVALID;
+  }
+
+  const char *cursor = payload.data() + 1;
+  uint64_t original_size = 0;
+  if (ReadVarint(cursor, payload.end(), kMaxVarintSize, original_size) != HeaderDecodeStatus::OK) {
+    return DecompressStatus::INVALID;
+  }
+  // The size comes from the peer: refuse it before out is zero-filled to that length
+  if (original_size > std::min(max_size, kMaxDecompressedPayloadSize)) {
+    return DecompressStatus::TOO_LARGE;
+  }
+
+  out.resize(static_cast<size_t>(original_size));
+  if (!codec->Decompress(cursor, static_cast<size_t>(payload.end() - cursor), out.data(), out.size())) {
+    return DecompressStatus::INVALID;
+  }
+  return DecompressStatus::OK;
+}
 
 /**
- * @brief Serializes a Message object into a byte vector.
+ * @brief Serializes a message into a byte vector.
  *
- * The serialized format is: MessageHeader (binary) followed by Payload
- * (binary).
+ * The serialized format is: the encoded header followed by the payload.
  *
- * @param message The Message object to serialize.
- * @return A vector of bytes representing the serialized message.
+ * @param message The message to serialize.
+ * @param protocol_version The wire protocol version to use.
+ * @param codec The compression codec negotiated with the peer.
+ * @return A pool-allocated buffer holding the serialized message.
  */
-std::vector<char> SerializeMessage(const Message &message) {
-  std::vector<char> data;
-  data.resize(kMessageHeaderSize + message.payload.size());
+PooledBuffer SerializeMessage(const MessageView &message, int protocol_version, CompressionCodecId codec) {
+  MessageHeader header = message.header;
+  PayloadView payload = message.payload;
+
+  PooledBuffer compressed_payload;
+  if (protocol_version >= kProtocolVersionCompact && codec != CompressionCodecId::NONE &&
+      (header.flags & kCompactFlagCompressed) == 0 && CompressPayload(payload, codec, compressed_payload)) {
+    header.flags |= kCompactFlagCompressed;
+    payload = PayloadView(compressed_payload);
+  }
+  header.payload_size = payload.size();
+
+  char encoded_header[kMaxWireHeaderSize];
+  size_t header_size = EncodeMessageHeader(header, protocol_version, encoded_header);
+
+  PooledBuffer data;
+  data.resize(header_size + payload.size());
 
   // Copy header data
-  std::memcpy(data.data(), &message.header, kMessageHeaderSize);
+  std::memcpy(data.data(), encoded_header, header_size);
 
   // Copy payload data
-  if (!message.payload.empty()) {
-    std::memcpy(data.data() + kMessageHeaderSize, message.payload.data(), message.payload.size());
+  if (!payload.empty()) {
+    std::memcpy(data.data() + header_size, payload.data(), payload.size());
   }
 
   return data;
 }
 
+/**
+ * @brief Serializes a message into a shareable immutable frame.
+ *
+ * @param message The message to serialize.
+ * @param protocol_version The wire protocol version to use.
+ * @param codec The compression codec negotiated with the peer.
+ * @return A reference-counted frame holding the serialized message.
+ */
+SharedFrame SerializeMessageShared(const MessageView &message, int protocol_version, CompressionCodecId codec) {
+  return std::allocate_shared<const PooledBuffer>(PoolAllocator<PooledBuffer>(),
+                                                 SerializeMessage(message, protocol_version, codec));
+}
+
 /**
  * @brief Deserializes a byte vector into a Message object.
  *
- * Assumes the byte vector starts with a valid MessageHeader followed by the
- * payload.
+ * Assumes the byte vector starts with a valid header (in either wire format)
+ * followed by the payload.
  *
  * @param data The byte vector to deserialize.
  * @return The deserialized Message object. Returns a Message with type UNKNOWN
@@ -39,27 +330,201 @@ std::vector<char> SerializeMessage(const Message &message) {
 Message DeserializeMessage(const std::vector<char> &data) {
   Message message;
 
-  if (data.size() < kMessageHeaderSize) {
-    std::cerr << "Error deserializing message: Data size less than header size." << std::endl;
-    return message;
+  size_t header_size = 0;
+  int protocol_version = 0;
+  if (DecodeMessageHeader(data.data(), data.size(), message.header, header_size, protocol_version) !=
+      HeaderDecodeStatus::OK) {
+    CHAT_LOG_ERROR("Error deserializing message: Invalid or incomplete header.");
+    return Message();
   }
 
-  // Copy header data
-  std::memcpy(&message.header, data.data(), kMessageHeaderSize);
-
   // Check if the reported payload size matches the remaining data size
-  if (data.size() < kMessageHeaderSize + message.header.payload_size) {
-    std::cerr << "Error deserializing message: Reported payload size exceeds "
-                 "remaining data."
-              << std::endl;
+  if (data.size() - header_size < message.header.payload_size) {
+    CHAT_LOG_ERROR("Error deserializing message: Reported payload size exceeds remaining data.");
     return Message();
   }
 
+  if (message.header.flags & kCompactFlagCompressed) {
+    PooledBuffer payload;
+    if (DecompressPayload(PayloadView(data.data() + header_size, message.header.payload_size), payload) !=
+        DecompressStatus::OK) {
+      CHAT_LOG_ERROR("Error deserializing message: Corrupt compressed payload.");
+      return Message();
+    }
+    message.header.flags &= static_cast<uint8_t>(~kCompactFlagCompressed);
+    message.header.payload_size = payload.size();
+    message.payload = std::move(payload);
+    return message;
+  }
+
   // Copy payload data
   message.payload.resize(message.header.payload_size);
   if (!message.payload.empty()) {
-    std::memcpy(message.payload.data(), data.data() + kMessageHeaderSize, message.header.payload_size);
+    std::memcpy(message.payload.data(), data.data() + header_size, message.header.payload_size);
   }
 
   return message;
 }
+
+/**
+ * @brief Builds the CLIENT_ID_ASSIGNMENT payload.
+ *
+ * @param client_id The assigned client ID.
+ * @param protocol_version The highest protocol version the server speaks.
+ * @param codecs The compression codecs to list.
+ * @return The payload string.
+ */
+std::string FormatClientIdAssignment(int client_id, int protocol_version,
+                                     const std::vector<CompressionCodecId> &codecs) {
+  std::string payload = std::to_string(client_id) + ";v=" + std::to_string(protocol_version);
+  std::string separator = ";c=";
+  for (CompressionCodecId id : codecs) {
+    if (const ICompressionCodec *codec = FindCompressionCodec(id)) {
+      payload += separator + codec->GetName();
+      separator = ",";
+    }
+  }
+  return payload;
+}
+
+/**
+ * @brief Parses a CLIENT_ID_ASSIGNMENT payload.
+ *
+ * @param payload The payload bytes.
+ * @param client_id Receives the assigned client ID.
+ * @param protocol_version Receives the advertised version (legacy if absent).
+ * @param codecs Receives the listed codecs this build supports.
+ * @return False if the payload does not contain a client ID.
+ */
+bool ParseClientIdAssignment(const PayloadView &payload, int &client_id, int &protocol_version,
+                             std::vector<CompressionCodecId> &codecs) {
+  std::string text(payload.begin(), payload.end());
+  protocol_version = kProtocolVersionLegacy;
+  codecs.clear();
+  try {
+    client_id = std::stoi(text);
+    size_t version_pos = text.find(";v=");
+    if (version_pos != std::string::npos) {
+      protocol_version = std::stoi(text.substr(version_pos + 3));
+    }
+  } catch (const std::exception &) {
+    return false;
+  }
+
+  size_t codecs_pos = text.find(";c=");
+  if (codecs_pos != std::string::npos) {
+    std::string list = text.substr(codecs_pos + 3, text.find(';', codecs_pos + 3) - (codecs_pos + 3));
+    size_t start = 0;
+    while (start <= list.size()) {
+      size_t end = std::min(list.find(',', start), list.size());
+      if (const ICompressionCodec *codec = FindCompressionCodec(list.substr(start, end - start))) {
+        codecs.push_back(codec->GetId());
+      }
+      start = end + 1;
+    }
+  }
+  return true;
+}
+
+/**
+ * @brief Builds the FILE_TRANSFER_REQUEST payload.
+ *
+ * @param request The request to encode.
+ * @return The payload string.
+ */
+std::string FormatFileTransferRequest(const FileTransferRequest &request) {
+  std::string payload =
+      std::to_string(request.recipient_id) + ":" + request.file_name + ":" + std::to_string(request.file_size);
+  if (request.has_content_hash) {
+    char hash_hex[17];
+    std::snprintf(hash_hex, sizeof(hash_hex), "%016llx", static_cast<unsigned long long>(request.content_hash));
+    payload += ";xxh64=" + std::string(hash_hex) + ";chunk=" + std::to_string(request.chunk_size);
+  }
+  return payload;
+}
+
+/**
+ * @brief Parses a FILE_TRANSFER_REQUEST payload.
+ *
+ * @param payload The payload bytes.
+ * @param request Receives the request.
+ * @return False if the payload is malformed.
+ */
+bool ParseFileTransferRequest(const PayloadView &payload, FileTransferRequest &request) {
+  std::string text(payload.begin(), payload.end());
+  size_t first_colon = text.find(':');
+  size_t second_colon = first_colon == std::string::npos ? std::string::npos : text.find(':', first_colon + 1);
+  if (second_colon == std::string::npos) {
+    return false;
+  }
+
+  request = FileTransferRequest();
+  try {
+    request.recipient_id = std::stoi(text.substr(0, first_colon));
+    request.file_name = text.substr(first_colon + 1, second_colon - first_colon - 1);
+    size_t options_pos = text.find(';', second_colon + 1);
+    request.file_size = std::stoull(text.substr(second_colon + 1, options_pos - second_colon - 1));
+
+    bool has_hash = false;
+    bool has_chunk = false;
+    while (options_pos != std::string::npos) {
+      size_t next = text.find(';', options_pos + 1);
+      std::string option = text.substr(options_pos + 1, next - options_pos - 1);
+      if (option.rfind("xxh64=", 0) == 0) {
+        request.content_hash = std::stoull(option.substr(6), nullptr, 16);
+        has_hash = true;
+      } else if (option.rfind("chunk=", 0) == 0) {
+        request.chunk_size = std::stoull(option.substr(6));
+        has_chunk = true;
+      } // Unknown options come from newer peers and are skipped
+      options_pos = next;
+    }
+    request.has_content_hash = has_hash && has_chunk && request.chunk_size > 0;
+  } catch (const std::exception &) {
+    return false;
+  }
+  return true;
+}
+
+/**
+ * @brief Builds the FILE_TRANSFER_ACK payload.
+ *
+ * @param acked_bytes The number of bytes received and written.
+ * @return The payload string.
+ */
+std::string FormatFileTransferAck(uint64_t acked_bytes) {
+  return std::to_string(acked_bytes);
+}
+
+/**
+ * @brief Parses a FILE_TRANSFER_ACK payload.
+ *
+ * @param payload The payload bytes.
+ * @param acked_bytes Receives the acknowledged byte count.
+ * @return False if the payload is not a byte count.
+ */
+bool ParseFileTransferAck(const PayloadView &payload, uint64_t &acked_bytes) {
+  std::string text(payload.begin(), payload.end());
+  if (text.empty() || text.find_first_not_of("0123456789") != std::string::npos) {
+    return false;
+  }
+  try {
+    acked_bytes = std::stoull(text);
+  } catch (const std::exception &) {
+    return false;
+  }
+  return true;
+}
+
+/**
+ * @brief Checks whether a string may be used as a room name.
+ *
+ * @param name The candidate name.
+ * @return True if the name is valid.
+ */
+bool IsValidRoomName(const std::string &name) {
+  if (name.empty() || name.size() > kMaxRoomNameLength) {
+    return false;
+  }
+  return std::all_of(name.begin(), name.end(), [](char c) { return c > ' ' && c < 0x7f; });
+}
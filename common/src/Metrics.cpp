@@ -0,0 +1,365 @@
+#include "Metrics.h"
+
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <sstream>
+#include <vector>
+
+namespace {
+
+// Histograms are plain metrics followed by one handler latency histogram per message type
+const size_t kHistogramSlotCount = kMetricHistogramCount + kMessageTypeCount;
+// Counters are plain metrics followed by one received-messages counter per message type
+const size_t kCounterSlotCount = kMetricCounterCount + kMessageTypeCount;
+// Threads share this many copies of every histogram
+const size_t kHistogramShardCount = 8;
+
+const char *const kCounterNames[kMetricCounterCount] = {
+    "bytes_received",  "bytes_sent",            "connections_accepted",  "connections_closed", "frames_dropped",
+    "heartbeats_sent", "connections_timed_out", "connections_trimmed",   "reads_throttled",    "admission_pauses",
+    "frames_too_large", "cluster_frames_forwarded", "cluster_messages_received", "tls_handshakes",
+    "tls_sessions_resumed", "tls_kernel_offloads",
+};
+
+const char *const kHistogramNames[kMetricHistogramCount] = {
+    "broadcast_fanout_ns",
+    "broadcast_recipients",
+    "room_fanout_ns",
+    "room_recipients",
+    "private_batch_messages",
+    "outbound_queue_bytes",
+    "worker_queue_ns",
+};
+
+const char *const kMessageTypeNames[kMessageTypeCount] = {
+    "unknown",          "client_id_assignment", "broadcast_message",      "private_message",
+    "file_request",     "file_data_chunk",      "file_transfer_complete", "file_transfer_error",
+    "file_transfer_ack", "room_join",            "room_leave",             "room_message",
+    "heartbeat",
+};
+
+/**
+ * @brief One copy of a histogram, updated with relaxed atomic increments.
+ */
+struct HistogramShard {
+  std::atomic<uint64_t> count{0};
+  std::atomic<uint64_t> sum{0};
+  std::atomic<uint64_t> buckets[kHistogramBucketCount] = {};
+};
+
+class ThreadCounters;
+
+/**
+ * @brief Owner of all metric storage. Leaked so thread exit can still report to it.
+ */
+class MetricsRegistry {
+public:
+  static MetricsRegistry &Instance() {
+    static MetricsRegistry *registry = new MetricsRegistry();
+    return *registry;
+  }
+
+  void Register(ThreadCounters *counters) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    threads_.push_back(counters);
+  }
+
+  void Unregister(ThreadCounters *counters);
+
+  MetricsSnapshot Snapshot();
+
+  HistogramShard &Shard(size_t shard, size_t histogram) { return histograms_[shard][histogram]; }
+
+private:
+  MetricsRegistry() : exited_totals_(kCounterSlotCount, 0) {}
+
+  std::mutex mutex_;                      /**< Protects threads_ and exited_totals_. */
+  std::vector<ThreadCounters *> threads_; /**< Counters of the live threads. */
+  std::vector<uint64_t> exited_totals_;   /**< Counters of threads that have exited. */
+  HistogramShard histograms_[kHistogramShardCount][kHistogramSlotCount];
+};
+
+/**
+ * @brief Counter slots written only by their own thread.
+ */
+class ThreadCounters {
+public:
+  ThreadCounters() { MetricsRegistry::Instance().Register(this); }
+  ~ThreadCounters() { MetricsRegistry::Instance().Unregister(this); }
+
+  void Add(size_t slot, uint64_t amount) {
+    // Single writer: a load and a store, no read-modify-write needed
+    slots_[slot].store(slots_[slot].load(std::memory_order_relaxed) + amount, std::memory_order_relaxed);
+  }
+
+  uint64_t Get(size_t slot) const { return slots_[slot].load(std::memory_order_relaxed); }
+
+private:
+  std::atomic<uint64_t> slots_[kCounterSlotCount] = {};
+};
+
+/**
+ * @brief Unregisters a thread that is exiting, keeping its totals.
+ * @param counters The thread's counters.
+ */
+void MetricsRegistry::Unregister(ThreadCounters *counters) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  for (size_t slot = 0; slot < kCounterSlotCount; ++slot) {
+    exited_totals_[slot] += counters->Get(slot);
+  }
+  for (auto it = threads_.begin(); it != threads_.end(); ++it) {
+    if (*it == counters) {
+      threads_.erase(it);
+      break;
+    }
+  }
+}
+
+/**
+ * @brief Copies one set of histogram shards into a snapshot.
+ * @param registry The registry.
+ * @param histogram The histogram slot.
+ * @return The merged histogram.
+ */
+HistogramSnapshot MergeHistogram(MetricsRegistry &registry, size_t histogram) {
+  HistogramSnapshot merged;
+  merged.buckets.assign(kHistogramBucketCount, 0);
+  for (size_t shard = 0; shard < kHistogramShardCount; ++shard) {
+    HistogramShard &source = registry.Shard(shard, histogram);
+    merged.count += source.count.load(std::memory_order_relaxed);
+    merged.sum += source.sum.load(std::memory_order_relaxed);
+    for (size_t bucket = 0; bucket < kHistogramBucketCount; ++bucket) {
+      merged.buckets[bucket] += source.buckets[bucket].load(std::memory_order_relaxed);
+    }
+  }
+  return merged;
+}
+
+/**
+ * @brief Collects the current value of every metric.
+ * @return The snapshot.
+ */
+MetricsSnapshot MetricsRegistry::Snapshot() {
+  std::vector<uint64_t> totals;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    totals = exited_totals_;
+    for (const ThreadCounters *counters : threads_) {
+      for (size_t slot = 0; slot < kCounterSlotCount; ++slot) {
+        totals[slot] += counters->Get(slot);
+      }
+    }
+  }
+
+  MetricsSnapshot snapshot;
+  snapshot.counters.assign(totals.begin(), totals.begin() + kMetricCounterCount);
+  snapshot.messages_received.assign(totals.begin() + kMetricCounterCount, totals.end());
+  for (size_t histogram = 0; histogram < kHistogramSlotCount; ++histogram) {
+    HistogramSnapshot merged = MergeHistogram(*this, histogram);
+    if (histogram < kMetricHistogramCount) {
+      snapshot.histograms.push_back(std::move(merged));
+    } else {
+      snapshot.handler_latency_ns.push_back(std::move(merged));
+    }
+  }
+  return snapshot;
+}
+
+/**
+ * @brief Gets the calling thread's counters.
+ * @return The counters.
+ */
+ThreadCounters &LocalCounters() {
+  thread_local ThreadCounters counters;
+  return counters;
+}
+
+/**
+ * @brief Gets the histogram shard the calling thread records into.
+ * @return The shard index.
+ */
+size_t LocalShard() {
+  static std::atomic<size_t> next_shard{0};
+  thread_local size_t shard = next_shard.fetch_add(1, std::memory_order_relaxed) % kHistogramShardCount;
+  return shard;
+}
+
+/**
+ * @brief Records a value in a histogram slot.
+ * @param histogram The histogram slot.
+ * @param value The value.
+ */
+void RecordInSlot(size_t histogram, uint64_t value) {
+  HistogramShard &shard = MetricsRegistry::Instance().Shard(LocalShard(), histogram);
+  shard.count.fetch_add(1, std::memory_order_relaxed);
+  shard.sum.fetch_add(value, std::memory_order_relaxed);
+  shard.buckets[HistogramBucketFor(value)].fetch_add(1, std::memory_order_relaxed);
+}
+
+/**
+ * @brief Appends one histogram line to a report.
+ * @param out The report.
+ * @param name The histogram name.
+ * @param histogram The histogram.
+ */
+void FormatHistogram(std::ostringstream &out, const std::string &name, const HistogramSnapshot &histogram) {
+  if (histogram.count == 0) {
+    return;
+  }
+  out << name << ": count=" << histogram.count << " mean=" << static_cast<uint64_t>(histogram.Mean())
+      << " p50=" << histogram.Percentile(0.5) << " p90=" << histogram.Percentile(0.9)
+      << " p99=" << histogram.Percentile(0.99) << " max=" << histogram.Percentile(1.0) << "\n";
+}
+
+} // namespace
+
+/**
+ * @brief Gets an upper bound of a percentile.
+ * @param fraction The percentile as a fraction in [0, 1].
+ * @return The upper edge of the bucket holding that percentile, or 0 if empty.
+ */
+uint64_t HistogramSnapshot::Percentile(double fraction) const {
+  if (count == 0) {
+    return 0;
+  }
+  fraction = fraction < 0.0 ? 0.0 : (fraction > 1.0 ? 1.0 : fraction);
+  uint64_t rank = static_cast<uint64_t>(fraction * static_cast<double>(count - 1)) + 1;
+  uint64_t seen = 0;
+  for (size_t bucket = 0; bucket < buckets.size(); ++bucket) {
+    seen += buckets[bucket];
+    if (seen >= rank) {
+      return HistogramBucketUpperBound(bucket);
+    }
+  }
+  return HistogramBucketUpperBound(buckets.size() - 1);
+}
+
+/**
+ * @brief Gets the mean of the recorded values.
+ * @return The mean, or 0 if empty.
+ */
+double HistogramSnapshot::Mean() const {
+  return count == 0 ? 0.0 : static_cast<double>(sum) / static_cast<double>(count);
+}
+
+/**
+ * @brief Formats the snapshot as human-readable lines.
+ * @return The text, one metric per line.
+ */
+std::string MetricsSnapshot::Format() const {
+  std::ostringstream out;
+  for (size_t counter = 0; counter < counters.size() && counter < kMetricCounterCount; ++counter) {
+    out << kCounterNames[counter] << ": " << counters[counter] << "\n";
+  }
+  for (size_t type = 0; type < messages_received.size() && type < kMessageTypeCount; ++type) {
+    if (messages_received[type] > 0) {
+      out << "messages_received." << kMessageTypeNames[type] << ": " << messages_received[type] << "\n";
+    }
+  }
+  for (size_t histogram = 0; histogram < histograms.size() && histogram < kMetricHistogramCount; ++histogram) {
+    FormatHistogram(out, kHistogramNames[histogram], histograms[histogram]);
+  }
+  for (size_t type = 0; type < handler_latency_ns.size() && type < kMessageTypeCount; ++type) {
+    FormatHistogram(out, std::string("handler_latency_ns.") + kMessageTypeNames[type], handler_latency_ns[type]);
+  }
+  return out.str();
+}
+
+/**
+ * @brief Adds to a counter.
+ * @param counter The counter.
+ * @param amount The amount to add.
+ */
+void Metrics::Add(MetricCounter counter, uint64_t amount) {
+  LocalCounters().Add(static_cast<size_t>(counter), amount);
+}
+
+/**
+ * @brief Counts a received message of the given type.
+ * @param type The message type.
+ */
+void Metrics::CountMessageReceived(MessageType type) {
+  size_t index = static_cast<size_t>(type);
+  LocalCounters().Add(kMetricCounterCount + (index < kMessageTypeCount ? index : 0), 1);
+}
+
+/**
+ * @brief Records a value in a histogram.
+ * @param histogram The histogram.
+ * @param value The value.
+ */
+void Metrics::Record(MetricHistogram histogram, uint64_t value) {
+  RecordInSlot(static_cast<size_t>(histogram), value);
+}
+
+/**
+ * @brief Records how long the handler for a message type took.
+ * @param type The message type.
+ * @param nanoseconds The handler's run time.
+ */
+void Metrics::RecordHandlerLatency(MessageType type, uint64_t nanoseconds) {
+  size_t index = static_cast<size_t>(type);
+  RecordInSlot(kMetricHistogramCount + (index < kMessageTypeCount ? index : 0), nanoseconds);
+}
+
+/**
+ * @brief Collects the current value of every metric.
+ * @return The snapshot.
+ */
+MetricsSnapshot Metrics::Snapshot() {
+  return MetricsRegistry::Instance().Snapshot();
+}
+
+/**
+ * @brief Reads a monotonic clock for latency measurements.
+ * @return Nanoseconds since an arbitrary epoch.
+ */
+uint64_t Metrics::NowNanoseconds() {
+  return static_cast<uint64_t>(
+      std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch())
+          .count());
+}
+
+/**
+ * @brief Gets the name a message type is reported under.
+ * @param type The message type.
+ * @return The name, e.g. "broadcast_message".
+ */
+const char *Metrics::GetMessageTypeName(MessageType type) {
+  size_t index = static_cast<size_t>(type);
+  return kMessageTypeNames[index < kMessageTypeCount ? index : 0];
+}
+
+/**
+ * @brief Gets the histogram bucket of a value.
+ * @param value The value.
+ * @return The bucket index.
+ */
+size_t HistogramBucketFor(uint64_t value) {
+  if (value < 16) {
+    return static_cast<size_t>(value);
+  }
+  int msb = 63;
+  while (!(value >> msb)) {
+    --msb;
+  }
+  // The three bits below the most significant one pick the sub-bucket
+  uint64_t top = value >> (msb - 3); // 8..15
+  return 16 + static_cast<size_t>(msb - 4) * 8 + static_cast<size_t>(top - 8);
+}
+
+/**
+ * @brief Gets the largest value that falls into a histogram bucket.
+ * @param bucket The bucket index.
+ * @return The bucket's upper edge.
+ */
+uint64_t HistogramBucketUpperBound(size_t bucket) {
+  if (bucket < 16) {
+    return bucket;
+  }
+  size_t offset = bucket - 16;
+  int shift = static_cast<int>(offset / 8) + 1; // msb - 3
+  uint64_t top = 8 + offset % 8;
+  return (top << shift) + ((uint64_t(1) << shift) - 1);
+}
@@ -0,0 +1,186 @@
+#if !defined(_WIN32)
+
+#include "PollPoller.h"
+
+#include <cerrno>
+#include <cstring> // For strerror
+#include <fcntl.h>
+
+#include <unistd.h>
+
+#include "Logger.h"
+
+namespace {
+
+/**
+ * @brief Translates PollEventFlags into poll(2) event bits.
+ *
+ * @param events Bitmask of PollEventFlags.
+ * @return The corresponding POLL* bitmask.
+ */
+short ToPollEvents(uint32_t events) {
+  short poll_events = 0;
+  if (events & kPollReadable) {
+    poll_events |= POLLIN;
+  }
+  if (events & kPollWritable) {
+    poll_events |= POLLOUT;
+  }
+  return poll_events;
+}
+
+} // namespace
+
+/**
+ * @brief Constructs a new PollPoller and its wakeup pipe.
+ */
+PollPoller::PollPoller() : wakeup_pipe_{-1, -1} {
+  if (pipe(wakeup_pipe_) < 0) {
+    CHAT_LOG_ERROR("Error creating wakeup pipe: " << strerror(errno));
+    wakeup_pipe_[0] = wakeup_pipe_[1] = -1;
+    return;
+  }
+
+  for (int fd : wakeup_pipe_) {
+    fcntl(fd, F_SETFL, fcntl(fd, F_GETFL, 0) | O_NONBLOCK);
+    fcntl(fd, F_SETFD, FD_CLOEXEC);
+  }
+
+  poll_fds_.push_back({wakeup_pipe_[0], POLLIN, 0});
+}
+
+/**
+ * @brief Destroys the PollPoller and closes the wakeup pipe.
+ */
+PollPoller::~PollPoller() {
+  for (int fd : wakeup_pipe_) {
+    if (fd >= 0) {
+      close(fd);
+    }
+  }
+}
+
+/**
+ * @brief Starts watching a socket.
+ *
+ * @param handle The socket file descriptor.
+ * @param events Bitmask of PollEventFlags to watch for.
+ * @return True if the socket was added, false otherwise.
+ */
+bool PollPoller::Add(NativeSocketHandle handle, uint32_t events) {
+  if (fd_to_index_.count(handle)) {
+    CHAT_LOG_ERROR("fd " << handle << " is already registered with the poller.");
+    return false;
+  }
+  fd_to_index_[handle] = poll_fds_.size();
+  poll_fds_.push_back({handle, ToPollEvents(events), 0});
+  return true;
+}
+
+/**
+ * @brief Changes the set of events watched for a socket.
+ *
+ * @param handle The socket file descriptor.
+ * @param events Bitmask of PollEventFlags to watch for.
+ * @return True if the interest set was updated, false otherwise.
+ */
+bool PollPoller::Modify(NativeSocketHandle handle, uint32_t events) {
+  auto it = fd_to_index_.find(handle);
+  if (it == fd_to_index_.end()) {
+    return false;
+  }
+  poll_fds_[it->second].events = ToPollEvents(events);
+  return true;
+}
+
+/**
+ * @brief Stops watching a socket.
+ *
+ * The last entry is moved into the freed slot so removal stays O(1).
+ *
+ * @param handle The socket file descriptor.
+ * @return True if the socket was removed, false otherwise.
+ */
+bool PollPoller::Remove(NativeSocketHandle handle) {
+  auto it = fd_to_index_.find(handle);
+  if (it == fd_to_index_.end()) {
+    return false;
+  }
+
+  size_t index = it->second;
+  fd_to_index_.erase(it);
+  if (index != poll_fds_.size() - 1) {
+    poll_fds_[index] = poll_fds_.back();
+    fd_to_index_[poll_fds_[index].fd] = index;
+  }
+  poll_fds_.pop_back();
+  return true;
+}
+
+/**
+ * @brief Waits for readiness on the watched sockets.
+ *
+ * @param events Output vector that receives the ready sockets.
+ * @param timeout_ms Maximum time to wait in milliseconds, or -1 to wait indefinitely.
+ * @return The number of ready sockets, or -1 on error.
+ */
+int PollPoller::Wait(std::vector<PollEvent> &events, int timeout_ms) {
+  events.clear();
+
+  int ready = poll(poll_fds_.data(), poll_fds_.size(), timeout_ms);
+  if (ready < 0) {
+    if (errno == EINTR) {
+      return 0; // Interrupted by a signal, report no events
+    }
+    CHAT_LOG_ERROR("Error waiting on poll: " << strerror(errno));
+    return -1;
+  }
+
+  for (const pollfd &entry : poll_fds_) {
+    if (entry.revents == 0) {
+      continue;
+    }
+    if (entry.fd == wakeup_pipe_[0]) {
+      // Drain the pipe so the next Wait blocks again
+      char drain[64];
+      while (read(wakeup_pipe_[0], drain, sizeof(drain)) > 0) {
+      }
+      continue;
+    }
+
+    uint32_t flags = 0;
+    if (entry.revents & POLLIN) {
+      flags |= kPollReadable;
+    }
+    if (entry.revents & POLLOUT) {
+      flags |= kPollWritable;
+    }
+    if (entry.revents & (POLLERR | POLLHUP | POLLNVAL)) {
+      flags |= kPollHangup;
+    }
+    events.push_back({entry.fd, flags});
+  }
+
+  return static_cast<int>(events.size());
+}
+
+/**
+ * @brief Interrupts Wait by writing to the self-pipe.
+ */
+void PollPoller::Wakeup() {
+  char byte = 1;
+  if (write(wakeup_pipe_[1], &byte, sizeof(byte)) < 0 && errno != EAGAIN) {
+    CHAT_LOG_ERROR("Error signalling poll wakeup: " << strerror(errno));
+  }
+}
+
+/**
+ * @brief Checks if the wakeup pipe was created successfully.
+ *
+ * @return True if the poller is usable, false otherwise.
+ */
+bool PollPoller::IsValid() const {
+  return wakeup_pipe_[0] >= 0 && wakeup_pipe_[1] >= 0;
+}
+
+#endif // !_WIN32
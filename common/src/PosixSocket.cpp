@@ -1,7 +1,84 @@
 #include "PosixSocket.h"
 
-#include <cstring> // For strerror
-#include <iostream>
+#include <algorithm> // For std::min
+#include <cstring>   // For strerror
+#include <fcntl.h>   // For fcntl
+
+#include <csignal>   // For blocking SIGPIPE around sendfile
+#include <pthread.h> // For pthread_sigmask
+#include <netinet/tcp.h> // For TCP_NODELAY and TCP_CORK
+#include <sys/time.h>    // For timeval
+#include <sys/uio.h>     // For iovec
+
+#ifdef __linux__
+#include <sys/sendfile.h>
+#endif
+
+#include "Logger.h"
+
+// Maximum number of buffers submitted by a single SendV call
+const size_t kMaxSendVBuffers = 64;
+
+// Bounce buffer used by SendFile when the kernel cannot send the file directly
+const size_t kSendFileBounceSize = 64 * 1024;
+
+namespace {
+
+/**
+ * @brief Maps a SocketOption to its setsockopt level and name.
+ *
+ * @param option The option.
+ * @param level Receives the protocol level.
+ * @param name Receives the option name.
+ * @return False if the platform has no equivalent.
+ */
+bool ToNativeOption(SocketOption option, int &level, int &name) {
+  switch (option) {
+  case SocketOption::NO_DELAY:
+    level = IPPROTO_TCP;
+    name = TCP_NODELAY;
+    return true;
+  case SocketOption::CORK:
+#if defined(TCP_CORK)
+    level = IPPROTO_TCP;
+    name = TCP_CORK;
+    return true;
+#elif defined(TCP_NOPUSH)
+    level = IPPROTO_TCP;
+    name = TCP_NOPUSH;
+    return true;
+#else
+    return false;
+#endif
+  case SocketOption::KEEP_ALIVE:
+    level = SOL_SOCKET;
+    name = SO_KEEPALIVE;
+    return true;
+  case SocketOption::SEND_BUFFER_SIZE:
+    level = SOL_SOCKET;
+    name = SO_SNDBUF;
+    return true;
+  case SocketOption::RECEIVE_BUFFER_SIZE:
+    level = SOL_SOCKET;
+    name = SO_RCVBUF;
+    return true;
+  case SocketOption::REUSE_PORT:
+#if defined(SO_REUSEPORT)
+    level = SOL_SOCKET;
+    name = SO_REUSEPORT;
+    return true;
+#else
+    return false;
+#endif
+  case SocketOption::SEND_TIMEOUT:
+    level = SOL_SOCKET;
+    name = SO_SNDTIMEO;
+    return true;
+  }
+  return false;
+}
+
+} // namespace
 
 /**
  * @brief Constructs a new PosixSocket object.
@@ -13,7 +90,7 @@ PosixSocket::PosixSocket(int socket_fd) : socket_fd_(socket_fd) {
     // Create a new socket if one was not provided
     socket_fd_ = socket(AF_INET, SOCK_STREAM, 0);
     if (socket_fd_ < 0) {
-      std::cerr << "Error creating socket: " << strerror(errno) << std::endl;
+      CHAT_LOG_ERROR("Error creating socket: " << strerror(errno));
     }
   }
 }
@@ -34,7 +111,7 @@ PosixSocket::~PosixSocket() {
  */
 bool PosixSocket::Connect(const std::string &address, int port) {
   if (!IsValid()) {
-    std::cerr << "Socket is not valid." << std::endl;
+    CHAT_LOG_ERROR("Socket is not valid.");
     return false;
   }
 
@@ -47,14 +124,14 @@ bool PosixSocket::Connect(const std::string &address, int port) {
   if (inet_pton(AF_INET, address.c_str(), &server_addr.sin_addr) <= 0) {
     struct hostent *host = gethostbyname(address.c_str());
     if (host == nullptr) {
-      std::cerr << "Error resolving hostname " << address << ": " << hstrerror(h_errno) << std::endl;
+      CHAT_LOG_ERROR("Error resolving hostname " << address << ": " << hstrerror(h_errno));
       return false;
     }
     std::memcpy(&server_addr.sin_addr, host->h_addr_list[0], host->h_length);
   }
 
   if (connect(socket_fd_, (struct sockaddr *)&server_addr, sizeof(server_addr)) < 0) {
-    std::cerr << "Error connecting to " << address << ":" << port << ": " << strerror(errno) << std::endl;
+    CHAT_LOG_ERROR("Error connecting to " << address << ":" << port << ": " << strerror(errno));
     return false;
   }
 
@@ -70,7 +147,7 @@ bool PosixSocket::Connect(const std::string &address, int port) {
  */
 bool PosixSocket::Bind(const std::string &address, int port) {
   if (!IsValid()) {
-    std::cerr << "Socket is not valid." << std::endl;
+    CHAT_LOG_ERROR("Socket is not valid.");
     return false;
   }
 
@@ -83,7 +160,7 @@ bool PosixSocket::Bind(const std::string &address, int port) {
     server_addr.sin_addr.s_addr = INADDR_ANY;
   } else {
     if (inet_pton(AF_INET, address.c_str(), &server_addr.sin_addr) <= 0) {
-      std::cerr << "Invalid address: " << address << std::endl;
+      CHAT_LOG_ERROR("Invalid address: " << address);
       return false;
     }
   }
@@ -91,11 +168,11 @@ bool PosixSocket::Bind(const std::string &address, int port) {
   // Allow reuse of the address
   int opt = 1;
   if (setsockopt(socket_fd_, SOL_SOCKET, SO_REUSEADDR, &opt, sizeof(opt)) < 0) {
-    std::cerr << "Error setting SO_REUSEADDR: " << strerror(errno) << std::endl;
+    CHAT_LOG_ERROR("Error setting SO_REUSEADDR: " << strerror(errno));
   }
 
   if (bind(socket_fd_, (struct sockaddr *)&server_addr, sizeof(server_addr)) < 0) {
-    std::cerr << "Error binding to " << address << ":" << port << ": " << strerror(errno) << std::endl;
+    CHAT_LOG_ERROR("Error binding to " << address << ":" << port << ": " << strerror(errno));
     return false;
   }
 
@@ -110,12 +187,12 @@ bool PosixSocket::Bind(const std::string &address, int port) {
  */
 bool PosixSocket::Listen(int backlog) {
   if (!IsValid()) {
-    std::cerr << "Socket is not valid." << std::endl;
+    CHAT_LOG_ERROR("Socket is not valid.");
     return false;
   }
 
   if (listen(socket_fd_, backlog) < 0) {
-    std::cerr << "Error listening on socket: " << strerror(errno) << std::endl;
+    CHAT_LOG_ERROR("Error listening on socket: " << strerror(errno));
     return false;
   }
 
@@ -130,7 +207,7 @@ bool PosixSocket::Listen(int backlog) {
  */
 ISocket *PosixSocket::Accept() {
   if (!IsValid()) {
-    std::cerr << "Socket is not valid." << std::endl;
+    CHAT_LOG_ERROR("Socket is not valid.");
     return nullptr;
   }
 
@@ -144,7 +221,7 @@ ISocket *PosixSocket::Accept() {
     if (errno == EINTR) {
       return Accept(); // Retry accept
     }
-    std::cerr << "Error accepting connection: " << strerror(errno) << std::endl;
+    CHAT_LOG_RATE_LIMITED(LogLevel::ERROR, "Error accepting connection: " << strerror(errno));
     return nullptr;
   }
 
@@ -160,19 +237,128 @@ ISocket *PosixSocket::Accept() {
  */
 int PosixSocket::Send(const void *data, size_t size) {
   if (!IsValid()) {
-    std::cerr << "Socket is not valid." << std::endl;
+    CHAT_LOG_ERROR("Socket is not valid.");
     return -1;
   }
 
   // Use MSG_NOSIGNAL to prevent SIGPIPE on broken pipes
   int bytes_sent = send(socket_fd_, data, size, MSG_NOSIGNAL);
-  if (bytes_sent < 0) {
-    std::cerr << "Error sending data: " << strerror(errno) << std::endl;
+  if (bytes_sent < 0 && !WouldBlock()) {
+    CHAT_LOG_RATE_LIMITED(LogLevel::ERROR, "Error sending data: " << strerror(errno));
   }
 
   return bytes_sent;
 }
 
+/**
+ * @brief Sends several buffers with a single gathered write (sendmsg).
+ *
+ * At most kMaxSendVBuffers buffers are submitted per call; the return value
+ * tells the caller how far the write got.
+ *
+ * @param buffers Array of buffers to send, in order.
+ * @param count Number of entries in the array.
+ * @return The number of bytes sent, or -1 on error.
+ */
+int PosixSocket::SendV(const IoBuffer *buffers, size_t count) {
+  if (!IsValid()) {
+    CHAT_LOG_ERROR("Socket is not valid.");
+    return -1;
+  }
+
+  struct iovec iov[kMaxSendVBuffers];
+  size_t iov_count = std::min(count, kMaxSendVBuffers);
+  for (size_t i = 0; i < iov_count; ++i) {
+    iov[i].iov_base = const_cast<void *>(buffers[i].data);
+    iov[i].iov_len = buffers[i].size;
+  }
+
+  struct msghdr msg;
+  std::memset(&msg, 0, sizeof(msg));
+  msg.msg_iov = iov;
+  msg.msg_iovlen = iov_count;
+
+  // Use MSG_NOSIGNAL to prevent SIGPIPE on broken pipes
+  ssize_t bytes_sent = sendmsg(socket_fd_, &msg, MSG_NOSIGNAL);
+  if (bytes_sent < 0) {
+    if (errno == EINTR) {
+      return SendV(buffers, count); // Retry send
+    }
+    if (!WouldBlock()) {
+      CHAT_LOG_RATE_LIMITED(LogLevel::ERROR, "Error sending data: " << strerror(errno));
+    }
+  }
+
+  return static_cast<int>(bytes_sent);
+}
+
+/**
+ * @brief Sends a region of an open file through the socket.
+ *
+ * On Linux the bytes go from the page cache to the socket with sendfile(2).
+ * Elsewhere, or if the file does not support it, they are copied through a
+ * bounce buffer with pread and send.
+ *
+ * @param file The file to read from.
+ * @param offset Offset of the first byte to send.
+ * @param size Number of bytes to send.
+ * @return The number of bytes sent, 0 if the file ends at offset, or -1 on error.
+ */
+int PosixSocket::SendFile(NativeFileHandle file, uint64_t offset, size_t size) {
+  if (!IsValid()) {
+    CHAT_LOG_ERROR("Socket is not valid.");
+    return -1;
+  }
+
+#ifdef __linux__
+  // sendfile has no MSG_NOSIGNAL: block SIGPIPE so a broken pipe is reported
+  // as EPIPE instead of killing the process, and discard the pending signal
+  sigset_t pipe_set;
+  sigset_t old_set;
+  sigemptyset(&pipe_set);
+  sigaddset(&pipe_set, SIGPIPE);
+  pthread_sigmask(SIG_BLOCK, &pipe_set, &old_set);
+
+  off_t file_offset = static_cast<off_t>(offset);
+  ssize_t bytes_sent;
+  do {
+    bytes_sent = sendfile(socket_fd_, file, &file_offset, size);
+  } while (bytes_sent < 0 && errno == EINTR);
+  int error_code = errno;
+
+  if (bytes_sent < 0 && error_code == EPIPE) {
+    struct timespec no_wait = {0, 0};
+    sigtimedwait(&pipe_set, nullptr, &no_wait);
+  }
+  pthread_sigmask(SIG_SETMASK, &old_set, nullptr);
+
+  if (bytes_sent >= 0 || (error_code != EINVAL && error_code != ENOSYS)) {
+    if (bytes_sent < 0) {
+      errno = error_code;
+      if (!WouldBlock()) {
+        CHAT_LOG_ERROR("Error sending file data: " << strerror(error_code));
+      }
+    }
+    return static_cast<int>(bytes_sent);
+  }
+  // The file type does not support sendfile; copy it instead
+#endif
+
+  char bounce_buffer[kSendFileBounceSize];
+  ssize_t bytes_read;
+  do {
+    bytes_read = pread(file, bounce_buffer, std::min(size, kSendFileBounceSize), static_cast<off_t>(offset));
+  } while (bytes_read < 0 && errno == EINTR);
+  if (bytes_read <= 0) {
+    if (bytes_read < 0) {
+      CHAT_LOG_ERROR("Error reading file data: " << strerror(errno));
+    }
+    return static_cast<int>(bytes_read);
+  }
+
+  return Send(bounce_buffer, static_cast<size_t>(bytes_read));
+}
+
 /**
  * @brief Receives data from the socket.
  *
@@ -182,7 +368,7 @@ int PosixSocket::Send(const void *data, size_t size) {
  */
 int PosixSocket::Receive(void *buffer, size_t size) {
   if (!IsValid()) {
-    std::cerr << "Socket is not valid." << std::endl;
+    CHAT_LOG_ERROR("Socket is not valid.");
     return -1;
   }
 
@@ -192,7 +378,10 @@ int PosixSocket::Receive(void *buffer, size_t size) {
     if (errno == EINTR) {
       return Receive(buffer, size); // Retry receive
     }
-    std::cerr << "Error receiving data: " << strerror(errno) << std::endl;
+    if (WouldBlock()) {
+      return bytes_received; // No data available on a non-blocking socket
+    }
+    CHAT_LOG_RATE_LIMITED(LogLevel::ERROR, "Error receiving data: " << strerror(errno));
   }
 
   return bytes_received;
@@ -208,6 +397,15 @@ void PosixSocket::Close() {
   }
 }
 
+/**
+ * @brief Shuts down both directions of the connection without releasing the socket handle.
+ */
+void PosixSocket::Shutdown() {
+  if (IsValid()) {
+    shutdown(socket_fd_, SHUT_RDWR);
+  }
+}
+
 /**
  * @brief Checks if the socket is valid/open.
  *
@@ -216,3 +414,114 @@ void PosixSocket::Close() {
 bool PosixSocket::IsValid() const {
   return socket_fd_ >= 0;
 }
+
+/**
+ * @brief Switches the socket between blocking and non-blocking mode.
+ *
+ * @param non_blocking True to enable non-blocking mode, false to restore blocking mode.
+ * @return True if the mode was changed successfully, false otherwise.
+ */
+bool PosixSocket::SetNonBlocking(bool non_blocking) {
+  if (!IsValid()) {
+    CHAT_LOG_ERROR("Socket is not valid.");
+    return false;
+  }
+
+  int flags = fcntl(socket_fd_, F_GETFL, 0);
+  if (flags < 0) {
+    CHAT_LOG_ERROR("Error reading socket flags: " << strerror(errno));
+    return false;
+  }
+
+  flags = non_blocking ? (flags | O_NONBLOCK) : (flags & ~O_NONBLOCK);
+  if (fcntl(socket_fd_, F_SETFL, flags) < 0) {
+    CHAT_LOG_ERROR("Error setting socket blocking mode: " << strerror(errno));
+    return false;
+  }
+
+  return true;
+}
+
+/**
+ * @brief Checks whether the last failed operation on the calling thread would have blocked.
+ *
+ * @return True if the last error was EAGAIN/EWOULDBLOCK.
+ */
+bool PosixSocket::WouldBlock() const {
+  return errno == EAGAIN || errno == EWOULDBLOCK;
+}
+
+/**
+ * @brief Gets the native OS handle of the socket.
+ *
+ * @return The socket file descriptor.
+ */
+NativeSocketHandle PosixSocket::GetNativeHandle() const {
+  return socket_fd_;
+}
+
+/**
+ * @brief Checks whether the native handle carries the bytes of Send and Receive as they are.
+ *
+ * @return True; a plain socket does not transform its stream.
+ */
+bool PosixSocket::HasPlainStream() const {
+  return true;
+}
+
+/**
+ * @brief Sets a socket option.
+ *
+ * @param option The option to set.
+ * @param value The new value (0 or 1 for boolean options).
+ * @return True if the option was set, false otherwise.
+ */
+bool PosixSocket::SetOption(SocketOption option, int value) {
+  int level = 0;
+  int name = 0;
+  if (!IsValid() || !ToNativeOption(option, level, name)) {
+    return false;
+  }
+  if (option == SocketOption::SEND_TIMEOUT) {
+    // The only option that takes a timeval rather than an int
+    struct timeval timeout;
+    timeout.tv_sec = value / 1000;
+    timeout.tv_usec = (value % 1000) * 1000;
+    if (setsockopt(socket_fd_, level, name, &timeout, sizeof(timeout)) < 0) {
+      CHAT_LOG_ERROR("Error setting socket option: " << strerror(errno));
+      return false;
+    }
+    return true;
+  }
+  if (setsockopt(socket_fd_, level, name, &value, sizeof(value)) < 0) {
+    CHAT_LOG_ERROR("Error setting socket option: " << strerror(errno));
+    return false;
+  }
+  return true;
+}
+
+/**
+ * @brief Reads a socket option.
+ *
+ * @param option The option to read.
+ * @param value Receives the current value.
+ * @return True if the option was read, false otherwise.
+ */
+bool PosixSocket::GetOption(SocketOption option, int &value) const {
+  int level = 0;
+  int name = 0;
+  if (!IsValid() || !ToNativeOption(option, level, name)) {
+    return false;
+  }
+  if (option == SocketOption::SEND_TIMEOUT) {
+    struct timeval timeout;
+    socklen_t timeout_size = sizeof(timeout);
+    if (getsockopt(socket_fd_, level, name, &timeout, &timeout_size) != 0) {
+      return false;
+    }
+    value = static_cast<int>(timeout.tv_sec * 1000 + timeout.tv_usec / 1000);
+    return true;
+  }
+  socklen_t value_size = sizeof(value);
+  return getsockopt(socket_fd_, level, name, &value, &value_size) == 0;
+}
@@ -0,0 +1,202 @@
+#include "TlsContext.h"
+
+#ifndef _WIN32
+#include <csignal> // For ignoring SIGPIPE
+#endif
+
+#include <openssl/err.h>
+
+#include "Logger.h"
+
+namespace {
+
+// Identifies our sessions in the server's cache
+const unsigned char kSessionIdContext[] = "chat";
+
+/**
+ * @brief OpenSSL callback: a client connection received a session ticket.
+ *
+ * @param ssl The connection; its app data is the server key.
+ * @param session The new session.
+ * @return 1 if the cache took the reference, 0 to let OpenSSL free it.
+ */
+int OnNewSession(SSL *ssl, SSL_SESSION *session) {
+  TlsContext *context = static_cast<TlsContext *>(SSL_CTX_get_app_data(SSL_get_SSL_CTX(ssl)));
+  const std::string *server_key = static_cast<const std::string *>(SSL_get_app_data(ssl));
+  if (!context || !server_key) {
+    return 0;
+  }
+  context->CacheSession(*server_key, session);
+  return 1;
+}
+
+} // namespace
+
+/**
+ * @brief Creates a context.
+ *
+ * @param role Which end of the connections the context is for.
+ * @param options Certificates, verification and session settings.
+ * @return The context, or nullptr if the certificates cannot be loaded.
+ */
+std::shared_ptr<TlsContext> TlsContext::Create(TlsRole role, const TlsOptions &options) {
+#ifndef _WIN32
+  // OpenSSL writes to sockets with write(2) and sendfile(2), which raise
+  // SIGPIPE on a reset connection; leave a handler the application installed
+  struct sigaction pipe_action;
+  if (sigaction(SIGPIPE, nullptr, &pipe_action) == 0 && pipe_action.sa_handler == SIG_DFL) {
+    signal(SIGPIPE, SIG_IGN);
+  }
+#endif
+  SSL_CTX *context = SSL_CTX_new(role == TlsRole::SERVER ? TLS_server_method() : TLS_client_method());
+  if (!context) {
+    CHAT_LOG_ERROR("Failed to create TLS context: " << TakeLastError());
+    return nullptr;
+  }
+  SSL_CTX_set_min_proto_version(context, TLS1_2_VERSION);
+  // Sends retry with a buffer of their own, and idle connections give their
+  // record buffers back like the rest of the connection's memory
+  SSL_CTX_set_mode(context, SSL_MODE_ACCEPT_MOVING_WRITE_BUFFER | SSL_MODE_RELEASE_BUFFERS);
+  uint64_t ssl_options = 0;
+#ifdef SSL_OP_IGNORE_UNEXPECTED_EOF
+  ssl_options |= SSL_OP_IGNORE_UNEXPECTED_EOF; // A peer closing without close_notify is a disconnect, not an error
+#endif
+#ifdef SSL_OP_ENABLE_KTLS
+  if (options.kernel_offload) {
+    ssl_options |= SSL_OP_ENABLE_KTLS;
+  }
+#endif
+  SSL_CTX_set_options(context, ssl_options);
+
+  if (role == TlsRole::SERVER) {
+    if (SSL_CTX_use_certificate_chain_file(context, options.certificate_file.c_str()) != 1 ||
+        SSL_CTX_use_PrivateKey_file(context, options.private_key_file.c_str(), SSL_FILETYPE_PEM) != 1 ||
+        SSL_CTX_check_private_key(context) != 1) {
+      CHAT_LOG_ERROR("Failed to load TLS certificate " << options.certificate_file << " and key "
+                     << options.private_key_file << ": " << TakeLastError());
+      SSL_CTX_free(context);
+      return nullptr;
+    }
+    SSL_CTX_set_session_id_context(context, kSessionIdContext, sizeof(kSessionIdContext) - 1);
+    if (options.session_tickets > 0) {
+      SSL_CTX_set_num_tickets(context, static_cast<size_t>(options.session_tickets));
+    } else {
+      SSL_CTX_set_num_tickets(context, 0);
+      SSL_CTX_set_options(context, SSL_OP_NO_TICKET);
+      SSL_CTX_set_session_cache_mode(context, SSL_SESS_CACHE_OFF);
+    }
+  } else {
+    if (!options.ca_file.empty()) {
+      if (SSL_CTX_load_verify_locations(context, options.ca_file.c_str(), nullptr) != 1) {
+        CHAT_LOG_ERROR("Failed to load TLS CA file " << options.ca_file << ": " << TakeLastError());
+        SSL_CTX_free(context);
+        return nullptr;
+      }
+      SSL_CTX_set_verify(context, SSL_VERIFY_PEER, nullptr);
+    } else {
+      CHAT_LOG_WARNING("No TLS CA file given: the server's certificate will not be verified.");
+      SSL_CTX_set_verify(context, SSL_VERIFY_NONE, nullptr);
+    }
+    // Sessions are kept by server key in our own cache, not OpenSSL's
+    SSL_CTX_set_session_cache_mode(context, SSL_SESS_CACHE_CLIENT | SSL_SESS_CACHE_NO_INTERNAL_STORE);
+    SSL_CTX_sess_set_new_cb(context, OnNewSession);
+  }
+
+  return std::shared_ptr<TlsContext>(new TlsContext(role, options, context));
+}
+
+/**
+ * @brief Constructs a context around a configured SSL_CTX.
+ *
+ * @param role The role.
+ * @param options The options.
+ * @param context The SSL_CTX; the new object owns it.
+ */
+TlsContext::TlsContext(TlsRole role, const TlsOptions &options, SSL_CTX *context)
+    : role_(role), options_(options), context_(context) {
+  SSL_CTX_set_app_data(context_, this);
+}
+
+/**
+ * @brief Frees the SSL_CTX and the cached sessions.
+ */
+TlsContext::~TlsContext() {
+  for (auto &entry : sessions_) {
+    SSL_SESSION_free(entry.second);
+  }
+  SSL_CTX_free(context_);
+}
+
+/**
+ * @brief Gets the role the context was created for.
+ * @return The role.
+ */
+TlsRole TlsContext::GetRole() const {
+  return role_;
+}
+
+/**
+ * @brief Gets the options the context was created with.
+ * @return The options.
+ */
+const TlsOptions &TlsContext::GetOptions() const {
+  return options_;
+}
+
+/**
+ * @brief Creates the OpenSSL state of one connection.
+ * @return The new SSL object, owned by the caller, or nullptr on failure.
+ */
+SSL *TlsContext::NewConnection() const {
+  SSL *ssl = SSL_new(context_);
+  if (!ssl) {
+    CHAT_LOG_ERROR("Failed to create TLS connection state: " << TakeLastError());
+  }
+  return ssl;
+}
+
+/**
+ * @brief Gets the session to offer when reconnecting to a server.
+ *
+ * @param server_key Address and port of the server.
+ * @return A reference the caller must release with SSL_SESSION_free, or nullptr.
+ */
+SSL_SESSION *TlsContext::GetCachedSession(const std::string &server_key) {
+  std::lock_guard<std::mutex> lock(sessions_mutex_);
+  auto it = sessions_.find(server_key);
+  if (it == sessions_.end() || !SSL_SESSION_is_resumable(it->second)) {
+    return nullptr;
+  }
+  SSL_SESSION_up_ref(it->second);
+  return it->second;
+}
+
+/**
+ * @brief Remembers a session (ticket) received from a server.
+ *
+ * @param server_key Address and port of the server.
+ * @param session The session; the cache takes over the caller's reference.
+ */
+void TlsContext::CacheSession(const std::string &server_key, SSL_SESSION *session) {
+  std::lock_guard<std::mutex> lock(sessions_mutex_);
+  SSL_SESSION *&cached = sessions_[server_key];
+  if (cached) {
+    SSL_SESSION_free(cached);
+  }
+  cached = session;
+}
+
+/**
+ * @brief Describes and clears the calling thread's OpenSSL error queue.
+ * @return The first queued error, or "unknown error".
+ */
+std::string TlsContext::TakeLastError() {
+  unsigned long error = ERR_get_error();
+  ERR_clear_error();
+  if (error == 0) {
+    return "unknown error";
+  }
+  char text[256];
+  ERR_error_string_n(error, text, sizeof(text));
+  return text;
+}
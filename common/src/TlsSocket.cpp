@@ -0,0 +1,692 @@
+#include "TlsSocket.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <climits>
+#include <cstring>
+#include <utility>
+
+#ifdef _WIN32
+#include <winsock2.h>
+#include <windows.h>
+#else
+#include <poll.h>     // For waiting on the socket in blocking mode
+#include <sys/stat.h> // For fstat
+#include <unistd.h>   // For pread
+#endif
+
+#include <openssl/err.h>
+
+#include "Logger.h"
+#include "Metrics.h"
+
+// Plaintext encrypted by one send; OpenSSL splits it into 16 KiB records
+const size_t kMaxSendBatch = 64 * 1024;
+
+// Plaintext a non-blocking socket accepts before its handshake completes
+const size_t kMaxDeferredBytes = 256 * 1024;
+
+// Longest wait for the handshake of Connect to make progress
+const int kHandshakeTimeoutMs = 10000;
+
+// Until the handshake completes, both directions may consume handshake
+// records, so a blocked call looks again this often rather than waiting on
+// data another thread may already have taken
+const int kHandshakePollMs = 100;
+
+namespace {
+
+/**
+ * @brief Gets the calling thread's last socket error.
+ * @return errno, or WSAGetLastError() on Windows.
+ */
+int LastSocketError() {
+#ifdef _WIN32
+  return WSAGetLastError();
+#else
+  return errno;
+#endif
+}
+
+/**
+ * @brief Sets the calling thread's last socket error, as ISocket::WouldBlock reads it.
+ * @param error The error code.
+ */
+void SetSocketError(int error) {
+#ifdef _WIN32
+  WSASetLastError(error);
+#else
+  errno = error;
+#endif
+}
+
+/**
+ * @brief Makes the wrapped socket's WouldBlock report true.
+ */
+void SetWouldBlock() {
+#ifdef _WIN32
+  SetSocketError(WSAEWOULDBLOCK);
+#else
+  SetSocketError(EAGAIN);
+#endif
+}
+
+/**
+ * @brief Waits until a socket is ready.
+ *
+ * @param handle The socket.
+ * @param events POLLIN or POLLOUT.
+ * @param timeout_ms Longest wait, -1 for ever.
+ * @return Positive if ready (or failed, which the next call reports), 0 on timeout, -1 on error.
+ */
+int WaitForSocket(NativeSocketHandle handle, short events, int timeout_ms) {
+#ifdef _WIN32
+  WSAPOLLFD poll_fd;
+  poll_fd.fd = static_cast<SOCKET>(handle);
+  poll_fd.events = events;
+  poll_fd.revents = 0;
+  return WSAPoll(&poll_fd, 1, timeout_ms);
+#else
+  struct pollfd poll_fd;
+  poll_fd.fd = handle;
+  poll_fd.events = events;
+  poll_fd.revents = 0;
+  int ready;
+  do {
+    ready = poll(&poll_fd, 1, timeout_ms);
+  } while (ready < 0 && errno == EINTR);
+  return ready;
+#endif
+}
+
+/**
+ * @brief Copies buffers into a staging buffer.
+ *
+ * @param buffers Array of buffers, in order.
+ * @param count Number of entries in the array.
+ * @param limit Most bytes to copy.
+ * @param staging Receives the bytes, after what it already holds.
+ * @return The number of bytes copied.
+ */
+size_t StageBuffers(const IoBuffer *buffers, size_t count, size_t limit, std::vector<char> &staging) {
+  size_t staged = 0;
+  for (size_t i = 0; i < count && staged < limit; ++i) {
+    size_t length = std::min(buffers[i].size, limit - staged);
+    const char *data = static_cast<const char *>(buffers[i].data);
+    staging.insert(staging.end(), data, data + length);
+    staged += length;
+  }
+  return staged;
+}
+
+} // namespace
+
+/**
+ * @brief Wraps a socket.
+ *
+ * @param socket The plain socket: unconnected for a client, accepted for a server.
+ * @param context Configuration and session cache; its role selects the end of the handshake.
+ */
+TlsSocket::TlsSocket(std::unique_ptr<ISocket> socket, std::shared_ptr<TlsContext> context)
+    : socket_(std::move(socket)), context_(std::move(context)), ssl_(context_ ? context_->NewConnection() : nullptr),
+      attached_(false), handshake_done_(false), kernel_send_(false), non_blocking_(false), send_timeout_ms_(0),
+      write_pending_(false), held_back_(0) {}
+
+/**
+ * @brief Destroys the TlsSocket object. Closes the socket if it's open.
+ */
+TlsSocket::~TlsSocket() {
+  Close();
+  if (ssl_) {
+    SSL_free(ssl_);
+  }
+}
+
+/**
+ * @brief Connects to a server and completes the TLS handshake.
+ *
+ * The server's certificate must name the configured server name, or the
+ * address if none is configured, unless the context has no CA file.
+ *
+ * @param address The IP address or hostname.
+ * @param port The port number.
+ * @return True if the connection is established and the server verified.
+ */
+bool TlsSocket::Connect(const std::string &address, int port) {
+  if (!ssl_ || !socket_->Connect(address, port)) {
+    return false;
+  }
+
+  {
+    std::lock_guard<std::mutex> lock(ssl_mutex_);
+    const TlsOptions &options = context_->GetOptions();
+    const std::string &server_name = options.server_name.empty() ? address : options.server_name;
+    SSL_set_tlsext_host_name(ssl_, server_name.c_str());
+    if (!options.ca_file.empty()) {
+      SSL_set1_host(ssl_, server_name.c_str());
+    }
+    // Sessions received on this connection are cached under the server key
+    server_key_ = address + ":" + std::to_string(port);
+    SSL_set_app_data(ssl_, &server_key_);
+    SSL_SESSION *session = context_->GetCachedSession(server_key_);
+    if (session) {
+      SSL_set_session(ssl_, session);
+      SSL_SESSION_free(session);
+    }
+    if (!AttachLocked()) {
+      return false;
+    }
+  }
+
+  int result = Perform([this]() { return SSL_do_handshake(ssl_); }, kHandshakeTimeoutMs);
+  if (result != 1) {
+    long verify_result = SSL_get_verify_result(ssl_);
+    if (verify_result != X509_V_OK) {
+      CHAT_LOG_ERROR("TLS handshake with " << address << ":" << port
+                     << " failed: " << X509_verify_cert_error_string(verify_result));
+    } else {
+      CHAT_LOG_ERROR("TLS handshake with " << address << ":" << port << " failed.");
+    }
+    return false;
+  }
+  return true;
+}
+
+/**
+ * @brief Binds the wrapped socket to a local address and port.
+ *
+ * @param address The IP address to bind to (e.g., "0.0.0.0" for any).
+ * @param port The port number.
+ * @return True if binding is successful, false otherwise.
+ */
+bool TlsSocket::Bind(const std::string &address, int port) {
+  return socket_->Bind(address, port);
+}
+
+/**
+ * @brief Listens for incoming connections on the wrapped socket.
+ *
+ * @param backlog The maximum length of the queue of pending connections.
+ * @return True if listening starts successfully, false otherwise.
+ */
+bool TlsSocket::Listen(int backlog) {
+  return socket_->Listen(backlog);
+}
+
+/**
+ * @brief Accepts a new incoming connection.
+ *
+ * @return A new TlsSocket sharing this socket's context, or nullptr if an
+ * error occurs. The caller owns it.
+ */
+ISocket *TlsSocket::Accept() {
+  ISocket *accepted = socket_->Accept();
+  if (!accepted) {
+    return nullptr;
+  }
+  return new TlsSocket(std::unique_ptr<ISocket>(accepted), context_);
+}
+
+/**
+ * @brief Encrypts and sends data.
+ *
+ * @param data The data to send.
+ * @param size The number of bytes to send.
+ * @return The number of bytes sent, or -1 on error.
+ */
+int TlsSocket::Send(const void *data, size_t size) {
+  IoBuffer buffer = {data, size};
+  return SendV(&buffer, 1);
+}
+
+/**
+ * @brief Encrypts several buffers into as few records as possible and sends them.
+ *
+ * Up to kMaxSendBatch bytes are encrypted per call. In non-blocking mode and
+ * before the handshake completes, up to kMaxDeferredBytes are only copied
+ * and reported as sent; the record goes out as soon as the handshake is
+ * done, so a reactor watching writability does not spin meanwhile.
+ *
+ * @param buffers Array of buffers to send, in order.
+ * @param count Number of entries in the array.
+ * @return The number of bytes sent, or -1 on error.
+ */
+int TlsSocket::SendV(const IoBuffer *buffers, size_t count) {
+  if (!non_blocking_) {
+    // A blocking send completes every record it starts, nothing is left over
+    write_buffer_.clear();
+    if (StageBuffers(buffers, count, kMaxSendBatch, write_buffer_) == 0) {
+      return 0;
+    }
+    int result = Perform(
+        [this]() { return SSL_write(ssl_, write_buffer_.data(), static_cast<int>(write_buffer_.size())); },
+        send_timeout_ms_);
+    return result > 0 ? result : -1;
+  }
+
+  std::lock_guard<std::mutex> lock(ssl_mutex_);
+  short wait_events = 0;
+  if (!handshake_done_ && AttemptLocked([this]() { return SSL_do_handshake(ssl_); }, wait_events) <= 0 &&
+      wait_events == 0) {
+    return -1;
+  }
+  if (!handshake_done_) {
+    // Keep the bytes until the handshake completes (see FlushDeferredLocked)
+    if (!write_pending_) {
+      write_buffer_.clear();
+    }
+    size_t room = kMaxDeferredBytes - std::min(kMaxDeferredBytes, write_buffer_.size());
+    size_t staged = StageBuffers(buffers, count, room, write_buffer_);
+    if (staged == 0 && count > 0) {
+      SetWouldBlock();
+      return -1;
+    }
+    write_pending_ = write_pending_ || staged > 0;
+    return static_cast<int>(staged);
+  }
+
+  int flushed = FlushPendingWriteLocked();
+  if (flushed != 0) {
+    return flushed;
+  }
+
+  write_buffer_.clear();
+  size_t staged = StageBuffers(buffers, count, kMaxSendBatch, write_buffer_);
+  if (staged == 0) {
+    return 0;
+  }
+  int result = AttemptLocked(
+      [this]() { return SSL_write(ssl_, write_buffer_.data(), static_cast<int>(write_buffer_.size())); }, wait_events);
+  if (result > 0) {
+    return result;
+  }
+  if (wait_events == 0) {
+    return -1;
+  }
+  // OpenSSL must get these exact bytes again: keep them, and keep the
+  // caller's last byte too so that it has to call again to learn it was sent
+  write_pending_ = true;
+  held_back_ = 1;
+  if (staged == 1) {
+    SetWouldBlock();
+    return -1;
+  }
+  return static_cast<int>(staged - 1);
+}
+
+/**
+ * @brief Sends a region of an open file (sendfile under kTLS, read and encrypt otherwise).
+ *
+ * @param file The file to read from.
+ * @param offset Offset of the first byte to send.
+ * @param size Number of bytes to send.
+ * @return The number of bytes sent, 0 if the file ends at offset, or -1 on error.
+ */
+int TlsSocket::SendFile(NativeFileHandle file, uint64_t offset, size_t size) {
+  bool kernel_send = false;
+  {
+    std::lock_guard<std::mutex> lock(ssl_mutex_);
+    kernel_send = kernel_send_ && !write_pending_ && held_back_ == 0;
+  }
+
+#ifndef _WIN32
+  if (kernel_send) {
+    struct stat file_stat;
+    if (fstat(file, &file_stat) == 0 && offset >= static_cast<uint64_t>(file_stat.st_size)) {
+      return 0;
+    }
+    size_t length = std::min(size, static_cast<size_t>(INT_MAX));
+    int result = Perform(
+        [&]() {
+          return static_cast<int>(SSL_sendfile(ssl_, file, static_cast<off_t>(offset), length, 0));
+        },
+        send_timeout_ms_);
+    return result > 0 ? result : -1;
+  }
+#else
+  (void)kernel_send;
+#endif
+
+  char bounce_buffer[kMaxSendBatch];
+  size_t length = std::min(size, kMaxSendBatch);
+#ifdef _WIN32
+  OVERLAPPED overlapped;
+  std::memset(&overlapped, 0, sizeof(overlapped));
+  overlapped.Offset = static_cast<DWORD>(offset & 0xFFFFFFFF);
+  overlapped.OffsetHigh = static_cast<DWORD>(offset >> 32);
+  DWORD bytes_read = 0;
+  if (!ReadFile(file, bounce_buffer, static_cast<DWORD>(length), &bytes_read, &overlapped)) {
+    if (GetLastError() == ERROR_HANDLE_EOF) {
+      return 0;
+    }
+    CHAT_LOG_ERROR("Error reading file data: " << GetLastError());
+    return -1;
+  }
+#else
+  ssize_t bytes_read;
+  do {
+    bytes_read = pread(file, bounce_buffer, length, static_cast<off_t>(offset));
+  } while (bytes_read < 0 && errno == EINTR);
+  if (bytes_read < 0) {
+    CHAT_LOG_ERROR("Error reading file data: " << strerror(errno));
+    return -1;
+  }
+#endif
+  if (bytes_read == 0) {
+    return 0;
+  }
+  IoBuffer buffer = {bounce_buffer, static_cast<size_t>(bytes_read)};
+  return SendV(&buffer, 1);
+}
+
+/**
+ * @brief Receives and decrypts data.
+ *
+ * As much as the buffer holds is taken from the record being decrypted,
+ * so no received data is left where readiness polling cannot see it.
+ *
+ * @param buffer The buffer to store the received data.
+ * @param size The maximum number of bytes to receive.
+ * @return The number of bytes received, or -1 on error, 0 if the connection
+ * has been closed by the peer.
+ */
+int TlsSocket::Receive(void *buffer, size_t size) {
+  char *data = static_cast<char *>(buffer);
+  int capacity = static_cast<int>(std::min(size, static_cast<size_t>(INT_MAX)));
+  int result = Perform(
+      [&]() {
+        int received = SSL_read(ssl_, data, capacity);
+        while (received > 0 && received < capacity && SSL_pending(ssl_) > 0) {
+          int more = SSL_read(ssl_, data + received, capacity - received);
+          if (more <= 0) {
+            break;
+          }
+          received += more;
+        }
+        return received;
+      },
+      0);
+
+  if (non_blocking_) {
+    // The read may have completed the handshake that deferred writes wait for
+    int error = LastSocketError();
+    std::lock_guard<std::mutex> lock(ssl_mutex_);
+    FlushDeferredLocked();
+    SetSocketError(error);
+  }
+  return result;
+}
+
+/**
+ * @brief Sends close_notify if possible and closes the socket.
+ *
+ * close_notify is sent only if it fits into the send buffer right away;
+ * closing never waits for the peer.
+ */
+void TlsSocket::Close() {
+  std::lock_guard<std::mutex> lock(ssl_mutex_);
+  if (!socket_->IsValid()) {
+    return;
+  }
+  if (handshake_done_) {
+    SSL_shutdown(ssl_);
+    ERR_clear_error();
+  }
+  socket_->Close();
+}
+
+/**
+ * @brief Shuts down both directions of the connection without releasing
+ * the socket handle.
+ *
+ * Safe while another thread is blocked in Receive: that thread waits in
+ * poll, not in OpenSSL, and wakes up to find the connection closed.
+ */
+void TlsSocket::Shutdown() {
+  socket_->Shutdown();
+}
+
+/**
+ * @brief Checks if the socket is valid/open.
+ *
+ * @return True if the socket is valid, false otherwise.
+ */
+bool TlsSocket::IsValid() const {
+  return ssl_ && socket_->IsValid();
+}
+
+/**
+ * @brief Switches the socket between blocking and non-blocking mode.
+ *
+ * Only changes how calls behave; the wrapped socket stays non-blocking.
+ *
+ * @param non_blocking True to enable non-blocking mode, false to restore blocking mode.
+ * @return True.
+ */
+bool TlsSocket::SetNonBlocking(bool non_blocking) {
+  non_blocking_ = non_blocking;
+  return true;
+}
+
+/**
+ * @brief Checks whether the last failed operation on the calling thread would have blocked.
+ *
+ * @return True if it failed for lack of data or buffer space (in either direction).
+ */
+bool TlsSocket::WouldBlock() const {
+  return socket_->WouldBlock();
+}
+
+/**
+ * @brief Gets the native OS handle of the wrapped socket.
+ *
+ * @return The socket handle.
+ */
+NativeSocketHandle TlsSocket::GetNativeHandle() const {
+  return socket_->GetNativeHandle();
+}
+
+/**
+ * @brief Sets an option on the wrapped socket.
+ *
+ * SEND_TIMEOUT also bounds the waits of blocking sends here, since the
+ * wrapped socket itself never blocks.
+ *
+ * @param option The option to set.
+ * @param value The new value (0 or 1 for boolean options).
+ * @return True if the option was set, false otherwise.
+ */
+bool TlsSocket::SetOption(SocketOption option, int value) {
+  if (option == SocketOption::SEND_TIMEOUT) {
+    send_timeout_ms_ = value;
+  }
+  return socket_->SetOption(option, value);
+}
+
+/**
+ * @brief Reads an option of the wrapped socket.
+ *
+ * @param option The option to read.
+ * @param value Receives the current value.
+ * @return True if the option was read, false otherwise.
+ */
+bool TlsSocket::GetOption(SocketOption option, int &value) const {
+  return socket_->GetOption(option, value);
+}
+
+/**
+ * @brief Binds the OpenSSL state to the connected socket and makes it non-blocking.
+ *
+ * Caller holds ssl_mutex_.
+ *
+ * @return False if OpenSSL refused the socket.
+ */
+bool TlsSocket::AttachLocked() {
+  if (attached_) {
+    return true;
+  }
+  if (!ssl_ || !socket_->IsValid()) {
+    return false;
+  }
+  if (SSL_set_fd(ssl_, static_cast<int>(socket_->GetNativeHandle())) != 1) {
+    CHAT_LOG_ERROR("Failed to attach TLS to the socket: " << TlsContext::TakeLastError());
+    return false;
+  }
+  // We wait in poll ourselves, without holding OpenSSL's state
+  socket_->SetNonBlocking(true);
+  if (context_->GetRole() == TlsRole::SERVER) {
+    SSL_set_accept_state(ssl_);
+  } else {
+    SSL_set_connect_state(ssl_);
+  }
+  attached_ = true;
+  return true;
+}
+
+/**
+ * @brief Makes one OpenSSL call and classifies its result.
+ *
+ * Caller holds ssl_mutex_.
+ *
+ * @param operation The call.
+ * @param wait_events Receives POLLIN or POLLOUT if the call has to wait for
+ * the socket (with WouldBlock set), 0 otherwise.
+ * @return The call's positive result, 0 if the peer closed the connection, or -1.
+ */
+template <typename Operation> int TlsSocket::AttemptLocked(Operation operation, short &wait_events) {
+  wait_events = 0;
+  if (!AttachLocked()) {
+    return -1;
+  }
+  ERR_clear_error();
+  int result = operation();
+  int error = result > 0 ? SSL_ERROR_NONE : SSL_get_error(ssl_, result);
+  if (!handshake_done_ && SSL_is_init_finished(ssl_)) {
+    OnHandshakeDoneLocked();
+  }
+
+  switch (error) {
+  case SSL_ERROR_NONE:
+    return result;
+  case SSL_ERROR_ZERO_RETURN:
+    return 0; // close_notify, or a close without it
+  case SSL_ERROR_WANT_READ:
+    wait_events = POLLIN;
+    SetWouldBlock();
+    return -1;
+  case SSL_ERROR_WANT_WRITE:
+    wait_events = POLLOUT;
+    SetWouldBlock();
+    return -1;
+  case SSL_ERROR_SYSCALL:
+    if (result == 0 || LastSocketError() == 0) {
+      return 0; // The peer closed the connection mid-record
+    }
+    CHAT_LOG_RATE_LIMITED(LogLevel::ERROR, "TLS socket error: " << std::strerror(LastSocketError()));
+    return -1;
+  default:
+    CHAT_LOG_RATE_LIMITED(LogLevel::ERROR, "TLS error: " << TlsContext::TakeLastError());
+    return -1;
+  }
+}
+
+/**
+ * @brief Runs an OpenSSL call until it succeeds, waiting whenever it asks for I/O.
+ *
+ * Fails with WouldBlock set instead of waiting in non-blocking mode, or
+ * once a wait exceeds timeout_ms.
+ *
+ * @param operation The call, made under ssl_mutex_.
+ * @param timeout_ms Longest single wait, 0 for ever.
+ * @return The call's positive result, 0 if the peer closed the connection, or -1.
+ */
+template <typename Operation> int TlsSocket::Perform(Operation operation, int timeout_ms) {
+  int waited_ms = 0;
+  while (true) {
+    short wait_events = 0;
+    bool handshaking = false;
+    {
+      std::lock_guard<std::mutex> lock(ssl_mutex_);
+      int result = AttemptLocked(operation, wait_events);
+      if (wait_events == 0 || non_blocking_) {
+        return result;
+      }
+      handshaking = !handshake_done_;
+    }
+
+    int wait_ms = timeout_ms > 0 ? timeout_ms : -1;
+    if (handshaking && (wait_ms < 0 || wait_ms > kHandshakePollMs)) {
+      wait_ms = kHandshakePollMs;
+    }
+    int ready = WaitForSocket(socket_->GetNativeHandle(), wait_events, wait_ms);
+    if (ready < 0) {
+      CHAT_LOG_RATE_LIMITED(LogLevel::ERROR, "Error waiting for TLS socket: " << std::strerror(LastSocketError()));
+      return -1;
+    }
+    if (ready == 0 && timeout_ms > 0) {
+      waited_ms += wait_ms;
+      if (waited_ms >= timeout_ms) {
+        SetWouldBlock();
+        return -1;
+      }
+    } else if (ready > 0) {
+      waited_ms = 0;
+    }
+  }
+}
+
+/**
+ * @brief Counts a completed handshake and looks for kernel offload. Caller holds ssl_mutex_.
+ */
+void TlsSocket::OnHandshakeDoneLocked() {
+  handshake_done_ = true;
+  Metrics::Add(MetricCounter::TLS_HANDSHAKES);
+  if (SSL_session_reused(ssl_)) {
+    Metrics::Add(MetricCounter::TLS_SESSIONS_RESUMED);
+  }
+#ifdef BIO_get_ktls_send
+  kernel_send_ = BIO_get_ktls_send(SSL_get_wbio(ssl_)) != 0;
+  if (kernel_send_) {
+    Metrics::Add(MetricCounter::TLS_KERNEL_OFFLOADS);
+  }
+#endif
+}
+
+/**
+ * @brief Finishes the record a previous send left with OpenSSL. Caller holds ssl_mutex_.
+ *
+ * @return -1 on error (or if it still would block), otherwise the held-back
+ * bytes now sent, which the caller is told about before anything new.
+ */
+int TlsSocket::FlushPendingWriteLocked() {
+  if (write_pending_) {
+    short wait_events = 0;
+    int result = AttemptLocked(
+        [this]() { return SSL_write(ssl_, write_buffer_.data(), static_cast<int>(write_buffer_.size())); },
+        wait_events);
+    if (result <= 0) {
+      return -1;
+    }
+    write_pending_ = false;
+  }
+  int held_back = static_cast<int>(held_back_);
+  held_back_ = 0;
+  return held_back;
+}
+
+/**
+ * @brief Sends what non-blocking sends handed over before the handshake
+ * completed, once it has. Caller holds ssl_mutex_.
+ *
+ * If the socket's buffer is full, the bytes stay pending for the next send.
+ */
+void TlsSocket::FlushDeferredLocked() {
+  if (!write_pending_ || held_back_ != 0 || !handshake_done_) {
+    return;
+  }
+  short wait_events = 0;
+  if (AttemptLocked([this]() { return SSL_write(ssl_, write_buffer_.data(), static_cast<int>(write_buffer_.size())); },
+                    wait_events) > 0) {
+    write_pending_ = false;
+  }
+}
@@ -0,0 +1,205 @@
+#ifdef _WIN32
+
+#include "WSAPollPoller.h"
+
+#include <cstring>
+
+#include <ws2tcpip.h>
+
+#include "Logger.h"
+
+namespace {
+
+/**
+ * @brief Translates PollEventFlags into WSAPoll event bits.
+ *
+ * @param events Bitmask of PollEventFlags.
+ * @return The corresponding POLL* bitmask.
+ */
+SHORT ToPollEvents(uint32_t events) {
+  SHORT poll_events = 0;
+  if (events & kPollReadable) {
+    poll_events |= POLLRDNORM;
+  }
+  if (events & kPollWritable) {
+    poll_events |= POLLWRNORM;
+  }
+  return poll_events;
+}
+
+} // namespace
+
+/**
+ * @brief Constructs a new WSAPollPoller and its loopback wakeup socket.
+ */
+WSAPollPoller::WSAPollPoller() : wakeup_socket_(INVALID_SOCKET) {
+  WSADATA wsa_data;
+  if (WSAStartup(MAKEWORD(2, 2), &wsa_data) != 0) {
+    CHAT_LOG_ERROR("WSAStartup failed for poller.");
+    return;
+  }
+
+  wakeup_socket_ = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+  if (wakeup_socket_ == INVALID_SOCKET) {
+    CHAT_LOG_ERROR("Error creating wakeup socket: " << WSAGetLastError());
+    return;
+  }
+
+  std::memset(&wakeup_addr_, 0, sizeof(wakeup_addr_));
+  wakeup_addr_.sin_family = AF_INET;
+  wakeup_addr_.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  wakeup_addr_.sin_port = 0; // Let the OS pick a free port
+
+  int addr_len = sizeof(wakeup_addr_);
+  if (bind(wakeup_socket_, (sockaddr *)&wakeup_addr_, sizeof(wakeup_addr_)) == SOCKET_ERROR ||
+      getsockname(wakeup_socket_, (sockaddr *)&wakeup_addr_, &addr_len) == SOCKET_ERROR) {
+    CHAT_LOG_ERROR("Error binding wakeup socket: " << WSAGetLastError());
+    closesocket(wakeup_socket_);
+    wakeup_socket_ = INVALID_SOCKET;
+    return;
+  }
+
+  u_long non_blocking = 1;
+  ioctlsocket(wakeup_socket_, FIONBIO, &non_blocking);
+
+  WSAPOLLFD wakeup_entry;
+  wakeup_entry.fd = wakeup_socket_;
+  wakeup_entry.events = POLLRDNORM;
+  wakeup_entry.revents = 0;
+  poll_fds_.push_back(wakeup_entry);
+}
+
+/**
+ * @brief Destroys the WSAPollPoller and closes the wakeup socket.
+ */
+WSAPollPoller::~WSAPollPoller() {
+  if (wakeup_socket_ != INVALID_SOCKET) {
+    closesocket(wakeup_socket_);
+  }
+  WSACleanup();
+}
+
+/**
+ * @brief Starts watching a socket.
+ *
+ * @param handle The SOCKET handle.
+ * @param events Bitmask of PollEventFlags to watch for.
+ * @return True if the socket was added, false otherwise.
+ */
+bool WSAPollPoller::Add(NativeSocketHandle handle, uint32_t events) {
+  if (fd_to_index_.count(handle)) {
+    CHAT_LOG_ERROR("Socket " << handle << " is already registered with the poller.");
+    return false;
+  }
+
+  WSAPOLLFD entry;
+  entry.fd = static_cast<SOCKET>(handle);
+  entry.events = ToPollEvents(events);
+  entry.revents = 0;
+  fd_to_index_[handle] = poll_fds_.size();
+  poll_fds_.push_back(entry);
+  return true;
+}
+
+/**
+ * @brief Changes the set of events watched for a socket.
+ *
+ * @param handle The SOCKET handle.
+ * @param events Bitmask of PollEventFlags to watch for.
+ * @return True if the interest set was updated, false otherwise.
+ */
+bool WSAPollPoller::Modify(NativeSocketHandle handle, uint32_t events) {
+  auto it = fd_to_index_.find(handle);
+  if (it == fd_to_index_.end()) {
+    return false;
+  }
+  poll_fds_[it->second].events = ToPollEvents(events);
+  return true;
+}
+
+/**
+ * @brief Stops watching a socket.
+ *
+ * The last entry is moved into the freed slot so removal stays O(1).
+ *
+ * @param handle The SOCKET handle.
+ * @return True if the socket was removed, false otherwise.
+ */
+bool WSAPollPoller::Remove(NativeSocketHandle handle) {
+  auto it = fd_to_index_.find(handle);
+  if (it == fd_to_index_.end()) {
+    return false;
+  }
+
+  size_t index = it->second;
+  fd_to_index_.erase(it);
+  if (index != poll_fds_.size() - 1) {
+    poll_fds_[index] = poll_fds_.back();
+    fd_to_index_[static_cast<NativeSocketHandle>(poll_fds_[index].fd)] = index;
+  }
+  poll_fds_.pop_back();
+  return true;
+}
+
+/**
+ * @brief Waits for readiness on the watched sockets.
+ *
+ * @param events Output vector that receives the ready sockets.
+ * @param timeout_ms Maximum time to wait in milliseconds, or -1 to wait indefinitely.
+ * @return The number of ready sockets, or -1 on error.
+ */
+int WSAPollPoller::Wait(std::vector<PollEvent> &events, int timeout_ms) {
+  events.clear();
+
+  int ready = WSAPoll(poll_fds_.data(), static_cast<ULONG>(poll_fds_.size()), timeout_ms);
+  if (ready == SOCKET_ERROR) {
+    CHAT_LOG_ERROR("Error waiting on WSAPoll: " << WSAGetLastError());
+    return -1;
+  }
+
+  for (const WSAPOLLFD &entry : poll_fds_) {
+    if (entry.revents == 0) {
+      continue;
+    }
+    if (entry.fd == wakeup_socket_) {
+      // Drain pending wakeup datagrams so the next Wait blocks again
+      char drain[64];
+      while (recv(wakeup_socket_, drain, sizeof(drain), 0) > 0) {
+      }
+      continue;
+    }
+
+    uint32_t flags = 0;
+    if (entry.revents & POLLRDNORM) {
+      flags |= kPollReadable;
+    }
+    if (entry.revents & POLLWRNORM) {
+      flags |= kPollWritable;
+    }
+    if (entry.revents & (POLLERR | POLLHUP | POLLNVAL)) {
+      flags |= kPollHangup;
+    }
+    events.push_back({static_cast<NativeSocketHandle>(entry.fd), flags});
+  }
+
+  return static_cast<int>(events.size());
+}
+
+/**
+ * @brief Interrupts Wait by sending a datagram to the wakeup socket.
+ */
+void WSAPollPoller::Wakeup() {
+  char byte = 1;
+  sendto(wakeup_socket_, &byte, sizeof(byte), 0, (sockaddr *)&wakeup_addr_, sizeof(wakeup_addr_));
+}
+
+/**
+ * @brief Checks if the wakeup socket was created successfully.
+ *
+ * @return True if the poller is usable, false otherwise.
+ */
+bool WSAPollPoller::IsValid() const {
+  return wakeup_socket_ != INVALID_SOCKET;
+}
+
+#endif // _WIN32
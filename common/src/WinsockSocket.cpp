@@ -2,8 +2,58 @@
 
 #include "WinsockSocket.h"
 
+#include <algorithm>
 #include <cstring>
-#include <iostream>
+
+#include "Logger.h"
+
+// Maximum number of buffers submitted by a single SendV call
+const size_t kMaxSendVBuffers = 64;
+
+// Largest region submitted by a single TransmitFile call (it takes a DWORD, and we return an int)
+const uint64_t kMaxTransmitFileBytes = 0x7FFFFFFE;
+
+namespace {
+
+/**
+ * @brief Maps a SocketOption to its setsockopt level and name.
+ *
+ * @param option The option.
+ * @param level Receives the protocol level.
+ * @param name Receives the option name.
+ * @return False if Winsock has no equivalent (CORK, REUSE_PORT).
+ */
+bool ToNativeOption(SocketOption option, int &level, int &name) {
+  switch (option) {
+  case SocketOption::NO_DELAY:
+    level = IPPROTO_TCP;
+    name = TCP_NODELAY;
+    return true;
+  case SocketOption::CORK:
+    return false;
+  case SocketOption::KEEP_ALIVE:
+    level = SOL_SOCKET;
+    name = SO_KEEPALIVE;
+    return true;
+  case SocketOption::SEND_BUFFER_SIZE:
+    level = SOL_SOCKET;
+    name = SO_SNDBUF;
+    return true;
+  case SocketOption::RECEIVE_BUFFER_SIZE:
+    level = SOL_SOCKET;
+    name = SO_RCVBUF;
+    return true;
+  case SocketOption::REUSE_PORT:
+    return false; // SO_REUSEADDR on Windows means something else entirely
+  case SocketOption::SEND_TIMEOUT:
+    level = SOL_SOCKET;
+    name = SO_SNDTIMEO; // A DWORD of milliseconds, unlike the POSIX timeval
+    return true;
+  }
+  return false;
+}
+
+} // namespace
 
 // Static members initialization
 int WinsockSocket::winsock_init_count_ = 0;
@@ -21,7 +71,7 @@ bool WinsockSocket::InitializeWinsock() {
     WSADATA wsa_data;
     int result = WSAStartup(MAKEWORD(2, 2), &wsa_data);
     if (result != 0) {
-      std::cerr << "WSAStartup failed: " << result << std::endl;
+      CHAT_LOG_ERROR("WSAStartup failed: " << result);
       return false;
     }
   }
@@ -57,7 +107,7 @@ WinsockSocket::WinsockSocket(SOCKET socket_handle) : socket_handle_(socket_handl
     // Create a new socket if one was not provided
     socket_handle_ = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
     if (socket_handle_ == INVALID_SOCKET) {
-      std::cerr << "Error creating socket: " << WSAGetLastError() << std::endl;
+      CHAT_LOG_ERROR("Error creating socket: " << WSAGetLastError());
     }
   }
 }
@@ -79,7 +129,7 @@ WinsockSocket::~WinsockSocket() {
  */
 bool WinsockSocket::Connect(const std::string &address, int port) {
   if (!IsValid()) {
-    std::cerr << "Socket is not valid." << std::endl;
+    CHAT_LOG_ERROR("Socket is not valid.");
     return false;
   }
 
@@ -92,7 +142,7 @@ bool WinsockSocket::Connect(const std::string &address, int port) {
   // Resolve the server address and port
   int status = getaddrinfo(address.c_str(), std::to_string(port).c_str(), &hints, &result);
   if (status != 0) {
-    std::cerr << "getaddrinfo failed: " << gai_strerror(status) << std::endl;
+    CHAT_LOG_ERROR("getaddrinfo failed: " << gai_strerror(status));
     return false;
   }
 
@@ -100,7 +150,7 @@ bool WinsockSocket::Connect(const std::string &address, int port) {
   bool connected = false;
   for (struct addrinfo *ptr = result; ptr != nullptr; ptr = ptr->ai_next) {
     if (connect(socket_handle_, ptr->ai_addr, (int)ptr->ai_addrlen) == SOCKET_ERROR) {
-      std::cerr << "Connect failed with error: " << WSAGetLastError() << std::endl;
+      CHAT_LOG_ERROR("Connect failed with error: " << WSAGetLastError());
     } else {
       connected = true;
       break;
@@ -110,7 +160,7 @@ bool WinsockSocket::Connect(const std::string &address, int port) {
   freeaddrinfo(result);
 
   if (!connected) {
-    std::cerr << "Unable to connect to server." << std::endl;
+    CHAT_LOG_ERROR("Unable to connect to server.");
     return false;
   }
 
@@ -126,7 +176,7 @@ bool WinsockSocket::Connect(const std::string &address, int port) {
  */
 bool WinsockSocket::Bind(const std::string &address, int port) {
   if (!IsValid()) {
-    std::cerr << "Socket is not valid." << std::endl;
+    CHAT_LOG_ERROR("Socket is not valid.");
     return false;
   }
 
@@ -140,7 +190,7 @@ bool WinsockSocket::Bind(const std::string &address, int port) {
   } else {
     // Convert string IP to IN_ADDR structure
     if (InetPton(AF_INET, address.c_str(), &server_addr.sin_addr) != 1) {
-      std::cerr << "Invalid address: " << address << std::endl;
+      CHAT_LOG_ERROR("Invalid address: " << address);
       return false;
     }
   }
@@ -148,11 +198,11 @@ bool WinsockSocket::Bind(const std::string &address, int port) {
   // Allow reuse of the address
   int opt = 1;
   if (setsockopt(socket_handle_, SOL_SOCKET, SO_REUSEADDR, (const char *)&opt, sizeof(opt)) == SOCKET_ERROR) {
-    std::cerr << "Error setting SO_REUSEADDR: " << WSAGetLastError() << std::endl;
+    CHAT_LOG_ERROR("Error setting SO_REUSEADDR: " << WSAGetLastError());
   }
 
   if (bind(socket_handle_, (struct sockaddr *)&server_addr, sizeof(server_addr)) == SOCKET_ERROR) {
-    std::cerr << "Error binding to " << address << ":" << port << ": " << WSAGetLastError() << std::endl;
+    CHAT_LOG_ERROR("Error binding to " << address << ":" << port << ": " << WSAGetLastError());
     return false;
   }
 
@@ -167,12 +217,12 @@ bool WinsockSocket::Bind(const std::string &address, int port) {
  */
 bool WinsockSocket::Listen(int backlog) {
   if (!IsValid()) {
-    std::cerr << "Socket is not valid." << std::endl;
+    CHAT_LOG_ERROR("Socket is not valid.");
     return false;
   }
 
   if (listen(socket_handle_, backlog) == SOCKET_ERROR) {
-    std::cerr << "Error listening on socket: " << WSAGetLastError() << std::endl;
+    CHAT_LOG_ERROR("Error listening on socket: " << WSAGetLastError());
     return false;
   }
 
@@ -188,7 +238,7 @@ bool WinsockSocket::Listen(int backlog) {
  */
 ISocket *WinsockSocket::Accept() {
   if (!IsValid()) {
-    std::cerr << "Socket is not valid." << std::endl;
+    CHAT_LOG_ERROR("Socket is not valid.");
     return nullptr;
   }
 
@@ -199,7 +249,7 @@ ISocket *WinsockSocket::Accept() {
 
   if (client_socket_handle == INVALID_SOCKET) {
     int error_code = WSAGetLastError();
-    std::cerr << "Error accepting connection: " << error_code << std::endl;
+    CHAT_LOG_RATE_LIMITED(LogLevel::ERROR, "Error accepting connection: " << error_code);
     return nullptr;
   }
 
@@ -215,20 +265,100 @@ ISocket *WinsockSocket::Accept() {
  */
 int WinsockSocket::Send(const void *data, size_t size) {
   if (!IsValid()) {
-    std::cerr << "Socket is not valid." << std::endl;
+    CHAT_LOG_ERROR("Socket is not valid.");
     return -1;
   }
 
   // Use 0 flags for basic send
   int bytes_sent = send(socket_handle_, (const char *)data, (int)size, 0);
   if (bytes_sent == SOCKET_ERROR) {
-    std::cerr << "Error sending data: " << WSAGetLastError() << std::endl;
+    if (WouldBlock()) {
+      return -1; // Send buffer full on a non-blocking socket
+    }
+    CHAT_LOG_RATE_LIMITED(LogLevel::ERROR, "Error sending data: " << WSAGetLastError());
     return -1;
   }
 
   return bytes_sent;
 }
 
+/**
+ * @brief Sends several buffers with a single gathered write (WSASend).
+ *
+ * At most kMaxSendVBuffers buffers are submitted per call; the return value
+ * tells the caller how far the write got.
+ *
+ * @param buffers Array of buffers to send, in order.
+ * @param count Number of entries in the array.
+ * @return The number of bytes sent, or -1 on error.
+ */
+int WinsockSocket::SendV(const IoBuffer *buffers, size_t count) {
+  if (!IsValid()) {
+    CHAT_LOG_ERROR("Socket is not valid.");
+    return -1;
+  }
+
+  WSABUF wsa_buffers[kMaxSendVBuffers];
+  DWORD buffer_count = static_cast<DWORD>(std::min(count, kMaxSendVBuffers));
+  for (DWORD i = 0; i < buffer_count; ++i) {
+    wsa_buffers[i].buf = static_cast<CHAR *>(const_cast<void *>(buffers[i].data));
+    wsa_buffers[i].len = static_cast<ULONG>(buffers[i].size);
+  }
+
+  DWORD bytes_sent = 0;
+  if (WSASend(socket_handle_, wsa_buffers, buffer_count, &bytes_sent, 0, nullptr, nullptr) == SOCKET_ERROR) {
+    if (!WouldBlock()) {
+      CHAT_LOG_RATE_LIMITED(LogLevel::ERROR, "Error sending data: " << WSAGetLastError());
+    }
+    return -1;
+  }
+
+  return static_cast<int>(bytes_sent);
+}
+
+/**
+ * @brief Sends a region of an open file through the socket (TransmitFile).
+ *
+ * @param file The file to read from.
+ * @param offset Offset of the first byte to send.
+ * @param size Number of bytes to send.
+ * @return The number of bytes sent, 0 if the file ends at offset, or -1 on error.
+ */
+int WinsockSocket::SendFile(NativeFileHandle file, uint64_t offset, size_t size) {
+  if (!IsValid()) {
+    CHAT_LOG_ERROR("Socket is not valid.");
+    return -1;
+  }
+
+  LARGE_INTEGER file_size;
+  if (!GetFileSizeEx(file, &file_size)) {
+    CHAT_LOG_ERROR("Error querying file size: " << GetLastError());
+    return -1;
+  }
+  if (offset >= static_cast<uint64_t>(file_size.QuadPart)) {
+    return 0;
+  }
+
+  // TransmitFile reads from the current file position
+  LARGE_INTEGER position;
+  position.QuadPart = static_cast<LONGLONG>(offset);
+  if (!SetFilePointerEx(file, position, nullptr, FILE_BEGIN)) {
+    CHAT_LOG_ERROR("Error seeking file: " << GetLastError());
+    return -1;
+  }
+
+  uint64_t available = static_cast<uint64_t>(file_size.QuadPart) - offset;
+  DWORD bytes_to_send = static_cast<DWORD>(std::min<uint64_t>({size, available, kMaxTransmitFileBytes}));
+  if (!TransmitFile(socket_handle_, file, bytes_to_send, 0, nullptr, nullptr, 0)) {
+    if (!WouldBlock()) {
+      CHAT_LOG_ERROR("Error sending file data: " << WSAGetLastError());
+    }
+    return -1;
+  }
+
+  return static_cast<int>(bytes_to_send);
+}
+
 /**
  * @brief Receives data from the socket.
  *
@@ -239,7 +369,7 @@ int WinsockSocket::Send(const void *data, size_t size) {
  */
 int WinsockSocket::Receive(void *buffer, size_t size) {
   if (!IsValid()) {
-    std::cerr << "Socket is not valid." << std::endl;
+    CHAT_LOG_ERROR("Socket is not valid.");
     return -1;
   }
 
@@ -247,9 +377,10 @@ int WinsockSocket::Receive(void *buffer, size_t size) {
   int bytes_received = recv(socket_handle_, (char *)buffer, (int)size, 0);
   if (bytes_received == SOCKET_ERROR) {
     int error_code = WSAGetLastError();
-    // Ignore non-blocking errors if in non-blocking mode (not currently)
-    // For now, treat any receive error as a failure.
-    std::cerr << "Error receiving data: " << error_code << std::endl;
+    if (error_code == WSAEWOULDBLOCK) {
+      return -1; // No data available on a non-blocking socket
+    }
+    CHAT_LOG_RATE_LIMITED(LogLevel::ERROR, "Error receiving data: " << error_code);
     return -1;
   }
 
@@ -266,6 +397,15 @@ void WinsockSocket::Close() {
   }
 }
 
+/**
+ * @brief Shuts down both directions of the connection without releasing the socket handle.
+ */
+void WinsockSocket::Shutdown() {
+  if (IsValid()) {
+    shutdown(socket_handle_, SD_BOTH);
+  }
+}
+
 /**
  * @brief Checks if the socket is valid/open.
  * @return True if the socket is valid, false otherwise.
@@ -274,4 +414,80 @@ bool WinsockSocket::IsValid() const {
   return socket_handle_ != INVALID_SOCKET;
 }
 
+/**
+ * @brief Switches the socket between blocking and non-blocking mode.
+ *
+ * @param non_blocking True to enable non-blocking mode, false to restore blocking mode.
+ * @return True if the mode was changed successfully, false otherwise.
+ */
+bool WinsockSocket::SetNonBlocking(bool non_blocking) {
+  if (!IsValid()) {
+    CHAT_LOG_ERROR("Socket is not valid.");
+    return false;
+  }
+
+  u_long mode = non_blocking ? 1 : 0;
+  if (ioctlsocket(socket_handle_, FIONBIO, &mode) == SOCKET_ERROR) {
+    CHAT_LOG_ERROR("Error setting socket blocking mode: " << WSAGetLastError());
+    return false;
+  }
+
+  return true;
+}
+
+/**
+ * @brief Checks whether the last failed operation on the calling thread would have blocked.
+ *
+ * @return True if the last error was WSAEWOULDBLOCK.
+ */
+bool WinsockSocket::WouldBlock() const {
+  return WSAGetLastError() == WSAEWOULDBLOCK;
+}
+
+/**
+ * @brief Gets the native OS handle of the socket.
+ *
+ * @return The SOCKET handle.
+ */
+NativeSocketHandle WinsockSocket::GetNativeHandle() const {
+  return static_cast<NativeSocketHandle>(socket_handle_);
+}
+
+/**
+ * @brief Sets a socket option.
+ *
+ * @param option The option to set.
+ * @param value The new value (0 or 1 for boolean options).
+ * @return True if the option was set, false otherwise.
+ */
+bool WinsockSocket::SetOption(SocketOption option, int value) {
+  int level = 0;
+  int name = 0;
+  if (!IsValid() || !ToNativeOption(option, level, name)) {
+    return false;
+  }
+  if (setsockopt(socket_handle_, level, name, (const char *)&value, sizeof(value)) == SOCKET_ERROR) {
+    CHAT_LOG_ERROR("Error setting socket option: " << WSAGetLastError());
+    return false;
+  }
+  return true;
+}
+
+/**
+ * @brief Reads a socket option.
+ *
+ * @param option The option to read.
+ * @param value Receives the current value.
+ * @return True if the option was read, false otherwise.
+ */
+bool WinsockSocket::GetOption(SocketOption option, int &value) const {
+  int level = 0;
+  int name = 0;
+  if (!IsValid() || !ToNativeOption(option, level, name)) {
+    return false;
+  }
+  int value_size = sizeof(value);
+  return getsockopt(socket_handle_, level, name, (char *)&value, &value_size) == 0;
+}
+
 #endif // _WIN32
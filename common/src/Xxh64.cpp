@@ -0,0 +1,187 @@
+#include "Xxh64.h"
+
+#include <cstring>
+
+namespace {
+
+const uint64_t kPrime1 = 0x9E3779B185EBCA87ULL;
+const uint64_t kPrime2 = 0xC2B2AE3D27D4EB4FULL;
+const uint64_t kPrime3 = 0x165667B19E3779F9ULL;
+const uint64_t kPrime4 = 0x85EBCA77C2B2AE63ULL;
+const uint64_t kPrime5 = 0x27D4EB2F165667C5ULL;
+
+/**
+ * @brief Rotates a 64-bit value left.
+ * @param value The value.
+ * @param bits Rotation amount (1..63).
+ * @return The rotated value.
+ */
+inline uint64_t RotateLeft(uint64_t value, int bits) {
+  return (value << bits) | (value >> (64 - bits));
+}
+
+/**
+ * @brief Reads a little-endian 64-bit value.
+ * @param data Source bytes.
+ * @return The value.
+ */
+inline uint64_t Read64(const unsigned char *data) {
+  uint64_t value;
+  std::memcpy(&value, data, sizeof(value));
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+  value = __builtin_bswap64(value);
+#endif
+  return value;
+}
+
+/**
+ * @brief Reads a little-endian 32-bit value.
+ * @param data Source bytes.
+ * @return The value.
+ */
+inline uint32_t Read32(const unsigned char *data) {
+  uint32_t value;
+  std::memcpy(&value, data, sizeof(value));
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+  value = __builtin_bswap32(value);
+#endif
+  return value;
+}
+
+/**
+ * @brief Mixes one 8-byte lane into an accumulator.
+ * @param accumulator The accumulator.
+ * @param input The lane value.
+ * @return The new accumulator.
+ */
+inline uint64_t Round(uint64_t accumulator, uint64_t input) {
+  accumulator += input * kPrime2;
+  accumulator = RotateLeft(accumulator, 31);
+  return accumulator * kPrime1;
+}
+
+/**
+ * @brief Folds an accumulator into the converged hash.
+ * @param hash The hash so far.
+ * @param accumulator The accumulator.
+ * @return The new hash.
+ */
+inline uint64_t MergeRound(uint64_t hash, uint64_t accumulator) {
+  hash ^= Round(0, accumulator);
+  return hash * kPrime1 + kPrime4;
+}
+
+} // namespace
+
+/**
+ * @brief Starts a new hash.
+ * @param seed The seed value (0 for the standard digest).
+ */
+Xxh64::Xxh64(uint64_t seed) : seed_(seed), total_size_(0), buffered_(0) {
+  accumulators_[0] = seed + kPrime1 + kPrime2;
+  accumulators_[1] = seed + kPrime2;
+  accumulators_[2] = seed;
+  accumulators_[3] = seed - kPrime1;
+}
+
+/**
+ * @brief Adds bytes to the hash.
+ * @param data The bytes.
+ * @param size Number of bytes.
+ */
+void Xxh64::Update(const void *data, size_t size) {
+  const unsigned char *input = static_cast<const unsigned char *>(data);
+  total_size_ += size;
+
+  // Complete a stripe left over from the previous call first
+  if (buffered_ > 0) {
+    size_t take = sizeof(buffer_) - buffered_;
+    if (size < take) {
+      std::memcpy(buffer_ + buffered_, input, size);
+      buffered_ += size;
+      return;
+    }
+    std::memcpy(buffer_ + buffered_, input, take);
+    for (int lane = 0; lane < 4; ++lane) {
+      accumulators_[lane] = Round(accumulators_[lane], Read64(buffer_ + lane * 8));
+    }
+    input += take;
+    size -= take;
+    buffered_ = 0;
+  }
+
+  while (size >= sizeof(buffer_)) {
+    accumulators_[0] = Round(accumulators_[0], Read64(input));
+    accumulators_[1] = Round(accumulators_[1], Read64(input + 8));
+    accumulators_[2] = Round(accumulators_[2], Read64(input + 16));
+    accumulators_[3] = Round(accumulators_[3], Read64(input + 24));
+    input += sizeof(buffer_);
+    size -= sizeof(buffer_);
+  }
+
+  if (size > 0) {
+    std::memcpy(buffer_, input, size);
+    buffered_ = size;
+  }
+}
+
+/**
+ * @brief Gets the digest of all bytes added so far.
+ * @return The 64-bit digest.
+ */
+uint64_t Xxh64::Digest() const {
+  uint64_t hash;
+  if (total_size_ >= sizeof(buffer_)) {
+    hash = RotateLeft(accumulators_[0], 1) + RotateLeft(accumulators_[1], 7) + RotateLeft(accumulators_[2], 12) +
+           RotateLeft(accumulators_[3], 18);
+    for (int lane = 0; lane < 4; ++lane) {
+      hash = MergeRound(hash, accumulators_[lane]);
+    }
+  } else {
+    hash = seed_ + kPrime5;
+  }
+  hash += total_size_;
+
+  // Consume the tail: 8, then 4, then single bytes
+  const unsigned char *tail = buffer_;
+  size_t remaining = buffered_;
+  while (remaining >= 8) {
+    hash ^= Round(0, Read64(tail));
+    hash = RotateLeft(hash, 27) * kPrime1 + kPrime4;
+    tail += 8;
+    remaining -= 8;
+  }
+  if (remaining >= 4) {
+    hash ^= static_cast<uint64_t>(Read32(tail)) * kPrime1;
+    hash = RotateLeft(hash, 23) * kPrime2 + kPrime3;
+    tail += 4;
+    remaining -= 4;
+  }
+  while (remaining > 0) {
+    hash ^= (*tail) * kPrime5;
+    hash = RotateLeft(hash, 11) * kPrime1;
+    ++tail;
+    --remaining;
+  }
+
+  // Final avalanche
+  hash ^= hash >> 33;
+  hash *= kPrime2;
+  hash ^= hash >> 29;
+  hash *= kPrime3;
+  hash ^= hash >> 32;
+  return hash;
+}
+
+/**
+ * @brief Hashes a buffer in one call.
+ * @param data The bytes.
+ * @param size Number of bytes.
+ * @param seed The seed value.
+ * @return The 64-bit digest.
+ */
+uint64_t Xxh64::Hash(const void *data, size_t size, uint64_t seed) {
+  Xxh64 hasher(seed);
+  hasher.Update(data, size);
+  return hasher.Digest();
+}
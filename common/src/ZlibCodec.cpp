@@ -0,0 +1,70 @@
+#include "ZlibCodec.h"
+
+#include <zlib.h>
+
+#include <climits>
+
+/**
+ * @brief Gets the codec's wire identifier.
+ * @return CompressionCodecId::ZLIB.
+ */
+CompressionCodecId ZlibCodec::GetId() const {
+  return CompressionCodecId::ZLIB;
+}
+
+/**
+ * @brief Gets the codec's name.
+ * @return "zlib".
+ */
+const char *ZlibCodec::GetName() const {
+  return "zlib";
+}
+
+/**
+ * @brief Gets the worst-case compressed size of an input.
+ * @param size The input size in bytes.
+ * @return The deflate bound for size bytes.
+ */
+size_t ZlibCodec::GetMaxCompressedSize(size_t size) const {
+  return static_cast<size_t>(compressBound(static_cast<uLong>(size)));
+}
+
+/**
+ * @brief Compresses a block.
+ *
+ * @param data The input bytes.
+ * @param size Number of input bytes.
+ * @param out Destination buffer.
+ * @param capacity Size of the destination buffer.
+ * @return The compressed size, or 0 on failure.
+ */
+size_t ZlibCodec::Compress(const char *data, size_t size, char *out, size_t capacity) const {
+  if (size > ULONG_MAX || capacity > ULONG_MAX) {
+    return 0;
+  }
+  uLongf compressed_size = static_cast<uLongf>(capacity);
+  if (compress2(reinterpret_cast<Bytef *>(out), &compressed_size, reinterpret_cast<const Bytef *>(data),
+                static_cast<uLong>(size), Z_BEST_SPEED) != Z_OK) {
+    return 0;
+  }
+  return static_cast<size_t>(compressed_size);
+}
+
+/**
+ * @brief Decompresses a block whose original size is known.
+ *
+ * @param data The compressed bytes.
+ * @param size Number of compressed bytes.
+ * @param out Destination buffer of exactly original_size bytes.
+ * @param original_size The size of the uncompressed block.
+ * @return False if the data is corrupt or does not expand to original_size bytes.
+ */
+bool ZlibCodec::Decompress(const char *data, size_t size, char *out, size_t original_size) const {
+  if (size > ULONG_MAX || original_size > ULONG_MAX) {
+    return false;
+  }
+  uLongf decompressed_size = static_cast<uLongf>(original_size);
+  return uncompress(reinterpret_cast<Bytef *>(out), &decompressed_size, reinterpret_cast<const Bytef *>(data),
+                    static_cast<uLong>(size)) == Z_OK &&
+         decompressed_size == original_size;
+}
@@ -0,0 +1,59 @@
+#include "ZstdCodec.h"
+
+#include <zstd.h>
+
+// Low levels keep compression cheap enough for the network threads
+const int kZstdCompressionLevel = 1;
+
+/**
+ * @brief Gets the codec's wire identifier.
+ * @return CompressionCodecId::ZSTD.
+ */
+CompressionCodecId ZstdCodec::GetId() const {
+  return CompressionCodecId::ZSTD;
+}
+
+/**
+ * @brief Gets the codec's name.
+ * @return "zstd".
+ */
+const char *ZstdCodec::GetName() const {
+  return "zstd";
+}
+
+/**
+ * @brief Gets the worst-case compressed size of an input.
+ * @param size The input size in bytes.
+ * @return The zstd bound for size bytes.
+ */
+size_t ZstdCodec::GetMaxCompressedSize(size_t size) const {
+  return ZSTD_compressBound(size);
+}
+
+/**
+ * @brief Compresses a block.
+ *
+ * @param data The input bytes.
+ * @param size Number of input bytes.
+ * @param out Destination buffer.
+ * @param capacity Size of the destination buffer.
+ * @return The compressed size, or 0 on failure.
+ */
+size_t ZstdCodec::Compress(const char *data, size_t size, char *out, size_t capacity) const {
+  size_t compressed_size = ZSTD_compress(out, capacity, data, size, kZstdCompressionLevel);
+  return ZSTD_isError(compressed_size) ? 0 : compressed_size;
+}
+
+/**
+ * @brief Decompresses a block whose original size is known.
+ *
+ * @param data The compressed bytes.
+ * @param size Number of compressed bytes.
+ * @param out Destination buffer of exactly original_size bytes.
+ * @param original_size The size of the uncompressed block.
+ * @return False if the data is corrupt or does not expand to original_size bytes.
+ */
+bool ZstdCodec::Decompress(const char *data, size_t size, char *out, size_t original_size) const {
+  size_t decompressed_size = ZSTD_decompress(out, original_size, data, size);
+  return !ZSTD_isError(decompressed_size) && decompressed_size == original_size;
+}
@@ -0,0 +1,171 @@
+#include "EventLoop.h"
+
+#include <atomic>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <future>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+namespace {
+
+int failures = 0;
+
+#define CHECK(condition)                                                                                               \
+  do {                                                                                                                 \
+    if (!(condition)) {                                                                                                \
+      std::cerr << __FILE__ << ":" << __LINE__ << ": check failed: " #condition << std::endl;                          \
+      ++failures;                                                                                                      \
+    }                                                                                                                  \
+  } while (0)
+
+const size_t kBlockSize = 64 * 1024;
+const int kBlocks = 32;
+
+/**
+ * @brief A temporary file, removed again when it goes out of scope.
+ */
+class TempFile {
+public:
+  /**
+   * @brief Creates the file; check GetFd afterwards.
+   */
+  TempFile() : path_("/tmp/event_loop_file_io_XXXXXX") { fd_ = mkstemp(&path_[0]); }
+
+  /**
+   * @brief Closes and removes the file.
+   */
+  ~TempFile() {
+    if (fd_ >= 0) {
+      close(fd_);
+      unlink(path_.c_str());
+    }
+  }
+
+  TempFile(const TempFile &) = delete;
+  TempFile &operator=(const TempFile &) = delete;
+
+  /**
+   * @return The open file, or -1 if it could not be created.
+   */
+  int GetFd() const { return fd_; }
+
+private:
+  std::string path_;
+  int fd_;
+};
+
+/**
+ * @brief Starts a loop on io_uring, or reports why the tests cannot run.
+ *
+ * @param loop The loop.
+ * @return False if this kernel or build has no file I/O on the ring.
+ */
+bool StartFileLoop(EventLoop &loop) {
+  if (!loop.SupportsFileIo()) {
+    std::cout << "No file I/O on io_uring here, skipping the EventLoop file I/O tests." << std::endl;
+    return false;
+  }
+  CHECK(loop.Start());
+  return true;
+}
+
+/**
+ * @brief Blocks written and read back from another thread land at their
+ * offsets, and every callback runs on the loop thread.
+ */
+void TestWriteThenReadFromAnotherThread() {
+  EventLoop loop(IoBackend::IO_URING);
+  if (!StartFileLoop(loop)) {
+    return;
+  }
+  TempFile file;
+  CHECK(file.GetFd() >= 0);
+
+  std::vector<char> written(kBlockSize * kBlocks);
+  for (size_t i = 0; i < written.size(); ++i) {
+    written[i] = static_cast<char>(i * 7 + i / kBlockSize);
+  }
+
+  // Later blocks first, so only the offsets put the file in order
+  std::atomic<int> on_loop_thread(0);
+  std::vector<std::promise<int>> writes(kBlocks);
+  for (int block = kBlocks - 1; block >= 0; --block) {
+    loop.WriteFile(file.GetFd(), written.data() + block * kBlockSize, kBlockSize, block * kBlockSize,
+                   [&loop, &on_loop_thread, &writes, block](int result) {
+                     on_loop_thread += loop.IsInLoopThread() ? 1 : 0;
+                     writes[block].set_value(result);
+                   });
+  }
+  for (std::promise<int> &write : writes) {
+    CHECK(write.get_future().get() == static_cast<int>(kBlockSize));
+  }
+
+  std::vector<char> read(written.size());
+  std::promise<int> read_done;
+  loop.ReadFile(file.GetFd(), read.data(), read.size(), 0, [&loop, &on_loop_thread, &read_done](int result) {
+    on_loop_thread += loop.IsInLoopThread() ? 1 : 0;
+    read_done.set_value(result);
+  });
+  CHECK(read_done.get_future().get() == static_cast<int>(read.size()));
+  CHECK(std::memcmp(read.data(), written.data(), written.size()) == 0);
+  CHECK(on_loop_thread.load() == kBlocks + 1);
+
+  // Reading at the end of the file is not an error
+  std::promise<int> eof_done;
+  loop.ReadFile(file.GetFd(), read.data(), read.size(), written.size(),
+                [&eof_done](int result) { eof_done.set_value(result); });
+  CHECK(eof_done.get_future().get() == 0);
+}
+
+/**
+ * @brief Stop waits for the requests in flight, and a stopped loop cancels
+ * new ones at once instead of dropping them.
+ */
+void TestStopCompletesEveryRequest() {
+  EventLoop loop(IoBackend::IO_URING);
+  if (!StartFileLoop(loop)) {
+    return;
+  }
+  TempFile file;
+  CHECK(file.GetFd() >= 0);
+
+  std::vector<char> block(kBlockSize, 'x');
+  std::atomic<int> completed(0);
+  std::atomic<int> failed(0);
+  for (int i = 0; i < kBlocks; ++i) {
+    loop.WriteFile(file.GetFd(), block.data(), block.size(), i * kBlockSize, [&completed, &failed](int result) {
+      failed += result == static_cast<int>(kBlockSize) || result == -ECANCELED ? 0 : 1;
+      ++completed;
+    });
+  }
+  loop.Stop();
+  CHECK(completed.load() == kBlocks);
+  CHECK(failed.load() == 0);
+
+  int result = 0;
+  loop.WriteFile(file.GetFd(), block.data(), block.size(), 0, [&result](int done) { result = done; });
+  CHECK(result == -ECANCELED);
+}
+
+} // namespace
+
+/**
+ * @brief Runs the EventLoop file I/O tests.
+ * @return 0 if every check passed, 1 otherwise.
+ */
+int main() {
+  TestWriteThenReadFromAnotherThread();
+  TestStopCompletesEveryRequest();
+  if (failures != 0) {
+    std::cerr << failures << " check(s) failed." << std::endl;
+    return 1;
+  }
+  std::cout << "All EventLoop file I/O tests passed." << std::endl;
+  return 0;
+}
@@ -0,0 +1,134 @@
+#include "MessageFramer.h"
+
+#include <algorithm> // For std::min
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+#include <vector>
+
+#include "CompressionCodecs.h"
+#include "Message.h"
+#include "MessageSerialization.h"
+
+namespace {
+
+int failures = 0;
+
+#define CHECK(condition)                                                                                               \
+  do {                                                                                                                 \
+    if (!(condition)) {                                                                                                \
+      std::cerr << __FILE__ << ":" << __LINE__ << ": check failed: " #condition << std::endl;                          \
+      ++failures;                                                                                                      \
+    }                                                                                                                  \
+  } while (0)
+
+const size_t kMaxFrameSize = 1024 * 1024;
+
+/**
+ * @brief Builds a compact frame flagged as compressed, around a given payload.
+ *
+ * @param payload The (compressed) payload, codec byte and original size first.
+ * @return The serialized frame.
+ */
+PooledBuffer MakeCompressedFrame(const std::vector<char> &payload) {
+  Message message;
+  message.header = {MessageType::BROADCAST_MESSAGE, 1, 0, payload.size(), kCompactFlagCompressed, 0, 0};
+  message.payload.assign(payload.begin(), payload.end());
+  return SerializeMessage(message, kProtocolVersionCompact);
+}
+
+/**
+ * @brief Feeds a frame to a framer through its read windows.
+ *
+ * @param framer The framer.
+ * @param frame The bytes.
+ */
+void Feed(MessageFramer &framer, const PooledBuffer &frame) {
+  size_t offset = 0;
+  while (offset < frame.size() && !framer.HasError()) {
+    size_t capacity = 0;
+    char *window = framer.PrepareRead(capacity);
+    size_t take = std::min(capacity, frame.size() - offset);
+    std::memcpy(window, frame.data() + offset, take);
+    framer.CommitRead(take);
+    offset += take;
+  }
+}
+
+/**
+ * @brief A compressed frame claiming an original size above the frame limit.
+ *
+ * The claim alone must end the stream; expanding it first would let a
+ * 12-byte frame make the receiver zero-fill tens of megabytes.
+ */
+void TestOversizedOriginalSizeIsRefused() {
+  std::vector<CompressionCodecId> codecs = GetAvailableCompressionCodecs();
+  if (codecs.empty()) {
+    std::cout << "No compression codec built, skipping the oversized original size test." << std::endl;
+    return;
+  }
+
+  std::vector<char> payload;
+  payload.push_back(static_cast<char>(codecs.front()));
+  uint64_t original_size = 32 * 1024 * 1024; // Below kMaxDecompressedPayloadSize, above the framer's limit
+  while (original_size >= 0x80) {
+    payload.push_back(static_cast<char>((original_size & 0x7F) | 0x80));
+    original_size >>= 7;
+  }
+  payload.push_back(static_cast<char>(original_size));
+  payload.insert(payload.end(), 4, 0);
+  PooledBuffer frame = MakeCompressedFrame(payload);
+  CHECK(frame.size() < 16);
+
+  MessageFramer framer(MessageFramer::kDefaultMinReadSize, MessageFramer::kDefaultMaxReadSize, kMaxFrameSize);
+  Feed(framer, frame);
+  MessageView view;
+  CHECK(!framer.Next(view));
+  CHECK(framer.GetError() == FramingError::FRAME_TOO_LARGE);
+
+  PooledBuffer out;
+  CHECK(DecompressPayload(PayloadView(payload.data(), payload.size()), out, kMaxFrameSize) ==
+        DecompressStatus::TOO_LARGE);
+  CHECK(out.capacity() == 0); // Refused before anything was allocated
+}
+
+/**
+ * @brief A genuinely compressed frame within the limit still expands.
+ */
+void TestCompressedFrameExpands() {
+  std::vector<CompressionCodecId> codecs = GetAvailableCompressionCodecs();
+  if (codecs.empty()) {
+    return;
+  }
+
+  std::vector<char> original(64 * 1024, 'x');
+  PooledBuffer compressed;
+  CHECK(CompressPayload(PayloadView(original.data(), original.size()), codecs.front(), compressed));
+  PooledBuffer frame = MakeCompressedFrame(std::vector<char>(compressed.begin(), compressed.end()));
+
+  MessageFramer framer(MessageFramer::kDefaultMinReadSize, MessageFramer::kDefaultMaxReadSize, kMaxFrameSize);
+  Feed(framer, frame);
+  MessageView view;
+  CHECK(framer.Next(view));
+  CHECK(!framer.HasError());
+  CHECK(view.payload.size() == original.size());
+  CHECK(view.payload.size() == original.size() &&
+        std::memcmp(view.payload.data(), original.data(), original.size()) == 0);
+}
+
+} // namespace
+
+/**
+ * @brief Runs the MessageFramer tests.
+ * @return 0 if every check passed, 1 otherwise.
+ */
+int main() {
+  TestOversizedOriginalSizeIsRefused();
+  TestCompressedFrameExpands();
+  if (failures != 0) {
+    std::cerr << failures << " check(s) failed." << std::endl;
+    return 1;
+  }
+  std::cout << "All MessageFramer tests passed." << std::endl;
+  return 0;
+}
@@ -0,0 +1,108 @@
+#ifndef ADMISSION_CONTROLLER_H_
+#define ADMISSION_CONTROLLER_H_
+
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "ClientRegistry.h"
+#include "IClientHandler.h"
+
+/**
+ * @brief Settings of the server-wide admission control.
+ */
+struct AdmissionOptions {
+  size_t max_queued_bytes = 256 * 1024 * 1024; /**< Outbound bytes, all clients, that trigger pauses (0 = off). */
+  int sample_interval_ms = 50;                 /**< How often the queues and receive counters are sampled. */
+};
+
+/**
+ * @brief Pauses reading from the noisiest clients while outbound data piles up.
+ *
+ * Every client's outbound queue is bounded, but a few fast senders fanning
+ * out to many recipients can still fill all of them at once. A background
+ * thread samples the total queued bytes and each client's received bytes;
+ * when the total exceeds max_queued_bytes, the clients that sent the most
+ * since the last sample are paused (IClientHandler::SetAdmissionPaused)
+ * until together they account for half of what all clients sent. More are
+ * paused while the total stays over the limit, and all of them resume once
+ * it has fallen to half the limit.
+ *
+ * Pausing stops reading, so the excess waits in the senders' socket buffers
+ * and eventually blocks the senders themselves, instead of being buffered
+ * by the server.
+ */
+class AdmissionController {
+public:
+  /**
+   * @brief Constructs a stopped controller.
+   *
+   * @param clients The server's clients; must outlive the controller.
+   * @param options The limit and sampling interval.
+   */
+  AdmissionController(const ClientRegistry &clients, const AdmissionOptions &options);
+
+  /**
+   * @brief Stops the sampling thread.
+   */
+  ~AdmissionController();
+
+  AdmissionController(const AdmissionController &) = delete;
+  AdmissionController &operator=(const AdmissionController &) = delete;
+
+  /**
+   * @brief Starts the sampling thread.
+   */
+  void Start();
+
+  /**
+   * @brief Stops the sampling thread and resumes every paused client.
+   */
+  void Stop();
+
+private:
+  /**
+   * @brief The sampling thread's loop.
+   */
+  void Run();
+
+  /**
+   * @brief Samples every client and pauses or resumes readers as needed.
+   */
+  void Sample();
+
+  /**
+   * @brief Resumes every client paused so far.
+   */
+  void ResumeAll();
+
+  /**
+   * @brief A client that sent data since the previous sample.
+   */
+  struct Sender {
+    std::shared_ptr<IClientHandler> client;
+    uint64_t bytes; /**< Bytes received from it since the previous sample. */
+  };
+
+  using ReceivedCount = std::pair<const IClientHandler *, uint64_t>;
+
+  const ClientRegistry &clients_;
+  AdmissionOptions options_;
+  std::vector<ReceivedCount> received_;      /**< Bytes received per client at the last sample, sorted by client. */
+  std::vector<ReceivedCount> next_received_; /**< Scratch for the sample being taken, kept for its capacity. */
+  std::vector<Sender> senders_;              /**< Scratch for the sample being taken, kept for its capacity. */
+  std::vector<std::weak_ptr<IClientHandler>> paused_;
+  bool overloaded_; /**< Over the limit and not yet back below half of it. */
+
+  std::thread thread_;
+  std::mutex mutex_;           /**< Guards the thread's sleep. */
+  std::condition_variable cv_; /**< Wakes the thread on Stop. */
+  bool stop_requested_;
+};
+
+#endif // ADMISSION_CONTROLLER_H_
@@ -26,13 +26,20 @@ public:
   /**
    * @brief Handles an incoming message by broadcasting it to all clients.
    * 
-   * @param message The deserialized Message object received.
+   * @param message View of the received message.
    * @param sender The client handler that received the message.
    * @param server A pointer to the Server instance for broadcasting.
    * @return True if the message was handled successfully, false otherwise.
    */
-  bool HandleMessage(const Message &message, IClientHandler *sender,
+  bool HandleMessage(const MessageView &message, IClientHandler *sender,
                      Server *server) override;
+
+  /**
+   * @brief Gets the message types this handler consumes.
+   *
+   * @return BROADCAST_MESSAGE.
+   */
+  std::vector<MessageType> GetHandledTypes() const override;
 };
 
 #endif // BROADCAST_MESSAGE_HANDLER_H_
@@ -5,24 +5,66 @@
 
 #include <atomic>
 #include <memory>
+#include <mutex>
 #include <thread>
 #include <vector>
 
+#include "EventLoop.h"
+#include "IEventHandler.h"
 #include "IMessageHandler.h"
 #include "ISocket.h"
 #include "Message.h"
+#include "MessageFramer.h"
 #include "MessageSerialization.h"
+#include "MessageStrand.h"
+#include "OutboundQueue.h"
+#include "PrivateMessageRouter.h"
 #include "Server.h"
+#include "TokenBucket.h"
 
 /**
  * @brief Handles communication with a single client connection.
  *
- * This class runs in a separate thread and is responsible for receiving
- * messages from a client, reassembling them if necessary, and passing
- * complete messages to the message handler. It implements the IClientHandler
- * interface.
+ * This class is responsible for receiving messages from a client,
+ * reassembling them if necessary, and passing complete messages to the
+ * message handler. It implements the IClientHandler interface.
+ *
+ * Two execution modes are supported: by default the handler runs its own
+ * blocking receive thread; when constructed with an EventLoop the socket is
+ * switched to non-blocking mode and driven by the loop's readiness callbacks
+ * (IEventHandler), so many clients share a fixed number of I/O threads.
+ * Where the loop completes socket I/O itself (EventLoop::SupportsCompletionIo)
+ * a plain socket is registered in completion mode: received bytes arrive in
+ * OnReceived and the outbound queue is written with EventLoop::Send.
+ *
+ * Outgoing frames never block the caller: SendMessage appends to a bounded
+ * per-connection OutboundQueue that is drained with gathered writes, by a
+ * dedicated writer thread in thread mode or by OnWritable in reactor mode.
+ *
+ * Given a MessageStrand, received messages are handled on worker threads
+ * instead, in order, so slow handlers do not hold up reading; see
+ * IMessageHandler::IsInlineSafe for the exceptions. Private messages skip
+ * the message handler altogether and are forwarded by a PrivateMessageRouter,
+ * on the strand while it is busy, so they keep their place in the order.
+ * A connection whose handlers fall behind by the strand's byte bound stops
+ * reading until they catch up; its neighbours on the loop are not held up.
+ *
+ * A quiet client is probed with HEARTBEAT messages and dropped once it stays
+ * silent past the read timeout (see ConnectionTimeouts). The checks run on
+ * the event loop's timer wheel in reactor mode and on the writer thread in
+ * thread mode, which also relies on the socket's send timeout. Once quiet,
+ * a reactor connection releases its send buffers and its whole receive
+ * state (framer, private message batch and rate limit buckets), leaving
+ * little more than the handler object itself.
+ *
+ * What the client sends is admitted against ConnectionLimits: a header over
+ * the maximum frame size drops the connection before its payload is
+ * buffered, and a client over one of its rate limits, or one paused by the
+ * server's AdmissionController, simply stops being read for a while. In
+ * reactor mode the pause removes readability from the poll interest and
+ * the loop timer resumes it; in thread mode the receive thread sleeps.
  */
-class ClientHandler : public IClientHandler {
+class ClientHandler : public IClientHandler, public IEventHandler {
 public:
   /**
    * @brief Constructs a new ClientHandler.
@@ -31,9 +73,23 @@ public:
    * @param client_socket The socket connected to the client.
    * @param server A pointer to the Server instance.
    * @param message_handler The message handler to process received messages.
+   * @param event_loop The event loop driving this connection, or nullptr to
+   * use dedicated receive and writer threads.
+   * @param queue_options Limits and overflow policy of the outbound queue.
+   * @param strand Strand running the message handler on worker threads, or
+   * nullptr to handle messages on the receiving thread.
+   * @param timeouts Heartbeat, timeout and buffer trimming settings.
+   * @param limits Maximum frame size and rate limits on what the client
+   * sends, usually shared by all connections; nullptr for ConnectionLimits().
    */
   ClientHandler(int client_id, std::unique_ptr<ISocket> client_socket,
-                Server *server, IMessageHandler *message_handler);
+                Server *server, IMessageHandler *message_handler,
+                EventLoop *event_loop = nullptr,
+                const OutboundQueueOptions &queue_options =
+                    OutboundQueueOptions(),
+                std::unique_ptr<MessageStrand> strand = nullptr,
+                const ConnectionTimeouts &timeouts = ConnectionTimeouts(),
+                std::shared_ptr<const ConnectionLimits> limits = nullptr);
 
   /**
    * @brief Destroys the ClientHandler object. Stops the thread if running.
@@ -41,22 +97,56 @@ public:
   ~ClientHandler() override;
 
   /**
-   * @brief Starts the client handler thread.
+   * @brief Starts the client handler thread, or registers the connection
+   * with its event loop in reactor mode.
    */
   void Start() override;
 
   /**
    * @brief Stops the client handler and closes the connection.
+   *
+   * In reactor mode, returns only once no loop callback for this handler can
+   * be running.
    */
   void Stop() override;
 
   /**
-   * @brief Sends a message to the connected client.
+   * @brief Queues a message for sending to the connected client.
    *
    * @param message The message structure to send.
-   * @return True if the message was sent successfully, false otherwise.
+   * @return True if the message was queued, false if the connection is
+   * closing or the client was disconnected as a slow consumer.
+   */
+  bool SendMessage(const MessageView &message) override;
+
+  /**
+   * @brief Queues an already serialized frame for sending.
+   *
+   * @param frame The serialized message frame (shared, not copied).
+   * @return True if the frame was queued, false if the connection is closing
+   * or the client was disconnected as a slow consumer.
    */
-  bool SendMessage(const Message &message);
+  bool SendFrame(const SharedFrame &frame) override;
+
+  /**
+   * @brief Gets the wire protocol version used for frames sent to this client.
+   *
+   * Starts at the legacy version and switches to the compact format once the
+   * client sends its first compact frame.
+   *
+   * @return The protocol version.
+   */
+  int GetProtocolVersion() const override;
+
+  /**
+   * @brief Gets the codec negotiated for payloads sent to this client.
+   *
+   * Set from the codec named in the client's echo of its ID assignment, if
+   * the server offers it; until then payloads are sent uncompressed.
+   *
+   * @return The codec, or CompressionCodecId::NONE.
+   */
+  CompressionCodecId GetCompressionCodec() const override;
 
   /**
    * @brief Gets the unique identifier for this client handler.
@@ -72,7 +162,103 @@ public:
    */
   ISocket *GetSocket() const override;
 
+  /**
+   * @brief Gets the traffic counters of this connection.
+   *
+   * @return A copy of the counters.
+   */
+  ConnectionStats GetStats() const override;
+
+  /**
+   * @brief Gets the event loop driving this connection.
+   *
+   * @return The loop, or nullptr in thread mode.
+   */
+  EventLoop *GetEventLoop() const override;
+
+  /**
+   * @brief Pauses or resumes reading from the client, for server-wide
+   * admission control.
+   *
+   * @param paused True to stop reading until called again with false.
+   */
+  void SetAdmissionPaused(bool paused) override;
+
+  /**
+   * @brief Reactor callback: drains the readable socket.
+   */
+  void OnReadable() override;
+
+  /**
+   * @brief Reactor callback: drains the outbound queue into the socket.
+   */
+  void OnWritable() override;
+
+  /**
+   * @brief Reactor callback: the peer hung up or the socket errored.
+   */
+  void OnHangup() override;
+
+  /**
+   * @brief Reactor callback: resumes paused reading and runs the heartbeat,
+   * timeout and trimming checks, whichever is due.
+   */
+  void OnTimer() override;
+
+  /**
+   * @brief Completion-mode callback: frames what the loop received.
+   *
+   * @param data The bytes, valid only during the call.
+   * @param result Number of bytes, 0 once the client closed, or -errno.
+   */
+  void OnReceived(const char *data, int result) override;
+
+  /**
+   * @brief Completion-mode callback: consumes what the loop wrote and
+   * starts the next write.
+   *
+   * @param result Number of bytes written, or -errno.
+   */
+  void OnSent(int result) override;
+
 private:
+  /**
+   * @brief What only the receiving thread uses: the framer, the private
+   * message batch and the rate limits.
+   *
+   * Kept out of line so that a quiet reactor connection can give it back
+   * whole once nothing is buffered and no limit is owed.
+   */
+  struct ReceiveState {
+    /**
+     * @brief Constructs the receive state with full buckets and no buffers.
+     *
+     * @param server The server private messages are routed through.
+     * @param limits The connection's frame size and rate limits.
+     */
+    ReceiveState(Server *server, const ConnectionLimits &limits);
+
+    /**
+     * @brief Checks whether dropping the state loses nothing.
+     *
+     * @param now_ns The current Metrics::NowNanoseconds time.
+     * @return True if no partial message is buffered and every bucket is full.
+     */
+    bool IsIdle(uint64_t now_ns) const;
+
+    MessageFramer framer;                  /**< Receive buffer and in-place message framing. */
+    PrivateMessageRouter private_router;   /**< Batches the private messages of one read burst. */
+    TokenBucket byte_bucket;               /**< ConnectionLimits::bytes. */
+    TokenBucket message_bucket;            /**< ConnectionLimits::messages. */
+    std::vector<TokenBucket> type_buckets; /**< Indexed by MessageType, empty if no type is limited. */
+  };
+
+  /**
+   * @brief Gets the receive state, creating it if a trim released it.
+   * @return The receive state.
+   */
+  ReceiveState &GetReceiveState();
+
   /**
    * @brief The main loop for the client handler thread.
    *
@@ -81,6 +267,161 @@ private:
    */
   void Run();
 
+  /**
+   * @brief Hands freshly received bytes to the framer and dispatches every
+   * complete message to the message handler.
+   *
+   * @param bytes_received Number of bytes received into the region returned
+   * by MessageFramer::PrepareRead.
+   * @return False if the stream is corrupt and the client must be dropped.
+   */
+  bool ProcessReceivedData(size_t bytes_received);
+
+  /**
+   * @brief Dispatches the complete messages in the framer until a rate
+   * limit runs into debt.
+   *
+   * Sets read_resume_ns_ if reading has to pause.
+   *
+   * @param now_ns The current Metrics::NowNanoseconds time.
+   * @param throttle_ns Pause already owed by the caller, 0 if none.
+   * @return False if the stream is corrupt and the client must be dropped.
+   */
+  bool DispatchBufferedMessages(uint64_t now_ns, uint64_t throttle_ns);
+
+  /**
+   * @brief Thread mode: sleeps until reading may resume, then dispatches the
+   * messages held back by the pause.
+   *
+   * @return False if the held-back messages are corrupt and the client must
+   * be dropped.
+   */
+  bool WaitWhileReadPaused();
+
+  /**
+   * @brief Reactor mode: gets the read part of the poll interest.
+   * @return kPollReadable, or 0 while reading is paused.
+   */
+  uint32_t GetReadInterest() const;
+
+  /**
+   * @brief Reactor mode: gets the write part of the poll interest.
+   * @return kPollWritable while writability is being watched, 0 otherwise.
+   */
+  uint32_t GetWriteInterest() const;
+
+  /**
+   * @brief Reactor mode: arms the loop timer for the earliest of the read
+   * resumption and the next timeout check.
+   *
+   * @param now_ns The current Metrics::NowNanoseconds time.
+   */
+  void ArmTimer(uint64_t now_ns);
+
+  /**
+   * @brief Passes a received message to the message handler, on the strand
+   * unless it can be handled inline.
+   *
+   * @param message View of the received message; only valid during the call.
+   */
+  void DispatchMessage(const MessageView &message);
+
+  /**
+   * @brief Queues a received message on the strand, behind the client's
+   * earlier messages; private messages are routed there too.
+   *
+   * @param message View of the received message; only valid during the call.
+   */
+  void PostToStrand(const MessageView &message);
+
+  /**
+   * @brief Runs the message handler on a message.
+   *
+   * @param message View of the message.
+   */
+  void RunMessageHandler(const MessageView &message);
+
+  /**
+   * @brief Removes this client from the server once its received messages
+   * are handled.
+   *
+   * With a strand the removal is queued behind the pending messages, so
+   * message handlers see the disconnect after the client's last message.
+   */
+  void RemoveFromServer();
+
+  /**
+   * @brief The main loop for the writer thread (thread mode only).
+   *
+   * Waits for queued frames and writes them with blocking gathered sends
+   * until the queue is closed or a send fails.
+   */
+  void WriteLoop();
+
+  /**
+   * @brief Checks whether any of the timeouts is enabled.
+   * @return True if CheckTimeouts has anything to do.
+   */
+  bool HasTimeouts() const;
+
+  /**
+   * @brief Sends a heartbeat, trims buffers or detects a timeout, whatever is due.
+   *
+   * Runs on the connection's writing side: the event loop in reactor mode,
+   * the writer thread in thread mode.
+   *
+   * @param now_ns The current Metrics::NowNanoseconds time.
+   * @param next_check_ns Receives the delay until the next check is due, or
+   * 0 if none is.
+   * @return False if the client timed out and must be disconnected.
+   */
+  bool CheckTimeouts(uint64_t now_ns, uint64_t &next_check_ns);
+
+  /**
+   * @brief Frees the buffers of a quiet connection.
+   *
+   * The outbound queue's structures and the write batch always go; the
+   * receive side is only released in reactor mode, where this runs on the
+   * thread that reads: the whole ReceiveState if it is idle, its buffers
+   * otherwise.
+   *
+   * @param now_ns The current Metrics::NowNanoseconds time.
+   * @return True if anything was released.
+   */
+  bool ReleaseIdleMemory(uint64_t now_ns);
+
+  /**
+   * @brief Completion mode: hands the next batch of the outbound queue to
+   * the event loop, or stops watching writability once the queue is empty.
+   */
+  void StartSend();
+
+  /**
+   * @brief Reactor mode: stops watching writability after the queue drained.
+   */
+  void DisarmWritable();
+
+  /**
+   * @brief Counts bytes the socket accepted, for the connection and globally.
+   *
+   * @param bytes_sent Number of bytes written.
+   */
+  void CountBytesSent(size_t bytes_sent);
+
+  /**
+   * @brief Shuts the socket down in both directions.
+   *
+   * Used to abort a connection from any thread: blocked Receive and SendV
+   * calls return, and the normal disconnect path then removes the client.
+   */
+  void ShutdownSocket();
+
+  /**
+   * @brief Reactor mode: tears the connection down after a disconnect or
+   * socket error and removes it from the server.
+   */
+  void HandleDisconnect();
+
   int client_id_;
   std::unique_ptr<ISocket> client_socket_;
   Server *server_;
@@ -88,7 +429,41 @@ private:
   std::thread handler_thread_;
   std::atomic<bool> running_;
 
-  std::vector<char> receive_buffer_;
+  EventLoop *event_loop_;            /**< Loop driving this connection, nullptr in thread mode. */
+  NativeSocketHandle socket_handle_; /**< Handle registered with event_loop_. */
+
+  std::thread writer_thread_;           /**< Thread mode: drains outbound_queue_. */
+  OutboundQueue outbound_queue_;        /**< Frames waiting to be written. */
+  std::vector<IoBuffer> write_batch_;   /**< Scratch list for gathered writes. */
+  std::atomic<bool> write_armed_;       /**< Reactor mode: writability is being watched. */
+  bool completion_io_;                  /**< Reactor mode: the loop completes reads and writes itself. */
+  bool send_in_flight_;                 /**< Completion mode: a write of the outbound queue is in flight. */
+  std::mutex socket_mutex_;             /**< Orders Shutdown from other threads against Close. */
+
+  std::shared_ptr<const ConnectionLimits> limits_; /**< What receive_ is built from. */
+  std::unique_ptr<ReceiveState> receive_; /**< Reactor mode: null until the first read, and again once trimmed. */
+  std::unique_ptr<MessageStrand> strand_; /**< Runs the message handler off the receiving thread, if set. */
+  std::atomic<int> protocol_version_; /**< Wire version for outgoing frames. */
+  std::atomic<CompressionCodecId> compression_codec_; /**< Codec for outgoing payloads. */
+
+  std::atomic<uint64_t> bytes_received_;    /**< Written by the receiving thread only. */
+  std::atomic<uint64_t> bytes_sent_;        /**< Written by the writing thread only. */
+  std::atomic<uint64_t> messages_received_; /**< Written by the receiving thread only. */
+
+  ConnectionTimeouts timeouts_;
+  std::atomic<uint64_t> last_receive_ns_; /**< Last read that returned data; receiving thread only. */
+  std::atomic<uint64_t> last_message_ns_; /**< Last message other than a heartbeat; receiving thread only. */
+  std::atomic<uint64_t> last_send_ns_;    /**< Last write that made progress; writing thread only. */
+  uint64_t last_heartbeat_ns_;            /**< Last probe sent; CheckTimeouts only. */
+  uint64_t last_trim_ns_;                 /**< Last ReleaseIdleMemory; CheckTimeouts only. */
+  uint64_t write_wait_since_ns_;          /**< First check that saw frames queued, 0 if empty; CheckTimeouts only. */
+  uint64_t next_timeout_check_ns_;        /**< Reactor mode: when OnTimer runs CheckTimeouts next, 0 for never. */
+
+  std::atomic<bool> read_paused_;         /**< Mirrors read_resume_ns_ != 0 for the other threads. */
+  std::atomic<bool> admission_paused_;    /**< Set by SetAdmissionPaused. */
+  uint64_t read_resume_ns_;               /**< When reading resumes, 0 while not paused; receiving thread only. */
+  bool strand_full_;                      /**< The last Post reported the strand full; receiving thread only. */
+  bool backlog_paused_;                   /**< Reading is paused until the strand has room; receiving thread only. */
 };
 
 #endif // CLIENT_HANDLER_H_
@@ -0,0 +1,104 @@
+#ifndef CLIENT_REGISTRY_H_
+#define CLIENT_REGISTRY_H_
+
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <shared_mutex>
+#include <unordered_map>
+#include <vector>
+
+#include "IClientHandler.h"
+
+/**
+ * @brief Thread-safe, id-indexed set of connected clients.
+ *
+ * Clients are spread over a fixed number of shards, each a hash map guarded
+ * by its own reader/writer lock. Lookups take a shared lock on a single shard
+ * and are O(1), so routing traffic does not contend with accepts, removals or
+ * lookups of clients in other shards. Handlers are reference counted: a
+ * handler returned by Find stays alive while the caller uses it, even if it
+ * is removed concurrently.
+ */
+class ClientRegistry {
+public:
+  /**
+   * @brief Constructs an empty registry.
+   *
+   * @param shard_count Number of independently locked shards (at least 1).
+   */
+  explicit ClientRegistry(size_t shard_count = kDefaultShardCount);
+
+  ClientRegistry(const ClientRegistry &) = delete;
+  ClientRegistry &operator=(const ClientRegistry &) = delete;
+
+  /**
+   * @brief Adds a client, keyed by its client ID.
+   *
+   * @param client The client handler to add.
+   * @return False if a client with the same ID is already registered.
+   */
+  bool Add(std::shared_ptr<IClientHandler> client);
+
+  /**
+   * @brief Removes a client if the entry for its ID is still that handler.
+   *
+   * @param client The client handler to remove.
+   * @return The removed handler, or nullptr if it was not registered.
+   */
+  std::shared_ptr<IClientHandler> Remove(const IClientHandler *client);
+
+  /**
+   * @brief Looks a client up by its ID.
+   *
+   * @param client_id The client ID.
+   * @return A reference to the handler, or nullptr if not found.
+   */
+  std::shared_ptr<IClientHandler> Find(int client_id) const;
+
+  /**
+   * @brief Invokes a function for every registered client.
+   *
+   * Shards are visited one after another under their shared lock, so the
+   * function must not add or remove clients.
+   *
+   * @param fn The function to invoke.
+   */
+  void ForEach(const std::function<void(const std::shared_ptr<IClientHandler> &)> &fn) const;
+
+  /**
+   * @brief Removes all clients.
+   *
+   * @return The handlers that were registered.
+   */
+  std::vector<std::shared_ptr<IClientHandler>> Clear();
+
+  /**
+   * @brief Gets the number of registered clients.
+   * @return The client count.
+   */
+  size_t Size() const;
+
+  static const size_t kDefaultShardCount = 16;
+
+private:
+  /**
+   * @brief One independently locked slice of the registry.
+   */
+  struct alignas(64) Shard {
+    mutable std::shared_mutex mutex;
+    std::unordered_map<int, std::shared_ptr<IClientHandler>> clients;
+  };
+
+  /**
+   * @brief Gets the shard responsible for a client ID.
+   * @param client_id The client ID.
+   * @return The shard.
+   */
+  const Shard &ShardFor(int client_id) const;
+  Shard &ShardFor(int client_id);
+
+  std::vector<Shard> shards_;
+};
+
+#endif // CLIENT_REGISTRY_H_
@@ -0,0 +1,70 @@
+#ifndef CLUSTER_DIRECTORY_H_
+#define CLUSTER_DIRECTORY_H_
+
+#include <atomic>
+#include <cstdint>
+
+/**
+ * @brief Allocates client IDs and tells which cluster node owns an ID.
+ *
+ * The ID space is partitioned between the nodes: node n of N hands out
+ * n + N, n + 2N, n + 3N, ..., so every node allocates on its own, without
+ * any coordination, and the owner of an ID is simply ID mod N. A single
+ * node (N = 1) allocates 1, 2, 3, ... as before. Once a node handed out its
+ * largest positive int ID it starts again at n + N, so that IDs stay
+ * positive and owned by n instead of overflowing.
+ *
+ * All methods are thread-safe.
+ */
+class ClusterDirectory {
+public:
+  /**
+   * @brief Constructs the directory of one node.
+   *
+   * @param node_id This node's ID, in [0, node_count).
+   * @param node_count Number of nodes in the cluster.
+   */
+  explicit ClusterDirectory(int node_id = 0, int node_count = 1);
+
+  /**
+   * @brief Allocates a new client ID owned by this node.
+   * @return The ID, always positive; after the largest one the sequence wraps around.
+   */
+  int AllocateClientId();
+
+  /**
+   * @brief Gets the node that owns a client ID.
+   *
+   * @param client_id The ID.
+   * @return The owner's node ID, or -1 for IDs no client can have (e.g. the server's -1).
+   */
+  int GetOwner(int client_id) const;
+
+  /**
+   * @brief Checks whether a client ID belongs to a client of this node.
+   *
+   * @param client_id The ID.
+   * @return True if this node allocated, or would allocate, the ID.
+   */
+  bool IsLocal(int client_id) const;
+
+  /**
+   * @brief Gets this node's ID.
+   * @return The node ID.
+   */
+  int GetNodeId() const;
+
+  /**
+   * @brief Gets the number of nodes in the cluster.
+   * @return The node count, at least 1.
+   */
+  int GetNodeCount() const;
+
+private:
+  int node_id_;
+  int node_count_;
+  int64_t sequence_count_;              /**< IDs n + kN this node has up to INT_MAX, for k >= 1. */
+  std::atomic<uint64_t> next_sequence_; /**< Shared by all acceptors; wraps modulo sequence_count_. */
+};
+
+#endif // CLUSTER_DIRECTORY_H_
@@ -0,0 +1,116 @@
+#ifndef CLUSTER_LINK_H_
+#define CLUSTER_LINK_H_
+
+#include <atomic>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "ISocket.h"
+#include "MessageSerialization.h"
+#include "OutboundQueue.h"
+
+/**
+ * @brief The outbound half of the internal link to one other cluster node.
+ *
+ * Frames for the peer are queued in an OutboundQueue, so any thread can send
+ * without blocking, and a writer thread drains it with gathered writes: the
+ * frames of many clients and many messages that pile up while a write is in
+ * progress go out together in the next one. The link speaks the ordinary
+ * client framing, so the peer reads it with a MessageFramer.
+ *
+ * The writer connects on its own and reconnects after any error, retrying
+ * every kReconnectDelayMs. Frames queued while the peer is unreachable wait
+ * within the queue's limit (older ones are dropped beyond it), and a frame
+ * the connection broke in the middle of is discarded, so delivery is at most
+ * once and the stream the peer sees always starts on a frame boundary.
+ */
+class ClusterLink {
+public:
+  /**
+   * @brief Constructs a stopped link.
+   *
+   * @param node_id ID of the peer node.
+   * @param host Address of the peer's cluster listener.
+   * @param port Port of the peer's cluster listener.
+   * @param queue_options Limits of the link's send queue.
+   * @param socket_options Options for the link's socket.
+   */
+  ClusterLink(int node_id, const std::string &host, int port, const OutboundQueueOptions &queue_options,
+              const SocketOptions &socket_options);
+
+  /**
+   * @brief Stops the writer thread.
+   */
+  ~ClusterLink();
+
+  ClusterLink(const ClusterLink &) = delete;
+  ClusterLink &operator=(const ClusterLink &) = delete;
+
+  /**
+   * @brief Starts the writer thread, which connects to the peer.
+   */
+  void Start();
+
+  /**
+   * @brief Stops the writer thread and closes the connection; queued frames are dropped.
+   */
+  void Stop();
+
+  /**
+   * @brief Queues a frame for the peer.
+   *
+   * @param frame The frame, in any wire format the framer accepts.
+   * @return False if the link is stopped.
+   */
+  bool Send(const SharedFrame &frame);
+
+  /**
+   * @brief Gets the ID of the peer node.
+   * @return The node ID.
+   */
+  int GetNodeId() const;
+
+private:
+  /**
+   * @brief The writer thread's loop.
+   */
+  void Run();
+
+  /**
+   * @brief Opens a connection to the peer.
+   * @return True if connected.
+   */
+  bool Connect();
+
+  /**
+   * @brief Closes the connection after an error.
+   */
+  void Disconnect();
+
+  /**
+   * @brief Sleeps before the next connection attempt.
+   * @return False if the link was stopped meanwhile.
+   */
+  bool WaitBeforeReconnect();
+
+  int node_id_;
+  std::string host_;
+  int port_;
+  SocketOptions socket_options_;
+  OutboundQueue queue_;
+  std::vector<IoBuffer> write_batch_;
+  bool frame_cut_; /**< The last write ended inside a frame. */
+
+  std::unique_ptr<ISocket> socket_;
+  std::mutex socket_mutex_; /**< Guards socket_ against Stop shutting it down. */
+  std::thread thread_;
+  std::atomic<bool> running_;
+  std::mutex wait_mutex_;           /**< Guards the writer's sleep between attempts. */
+  std::condition_variable wait_cv_; /**< Wakes the writer on Stop. */
+};
+
+#endif // CLUSTER_LINK_H_
@@ -0,0 +1,161 @@
+#ifndef CLUSTER_NODE_H_
+#define CLUSTER_NODE_H_
+
+#include <atomic>
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "ClusterDirectory.h"
+#include "ClusterLink.h"
+#include "IClientHandler.h"
+#include "ISocket.h"
+#include "MessageView.h"
+#include "PrivateMessageRouter.h"
+
+class Server;
+
+/**
+ * @brief Address of another node of the cluster.
+ */
+struct ClusterPeer {
+  int node_id = 0;  /**< The peer's ID. */
+  std::string host; /**< Address of its cluster listener. */
+  int port = 0;     /**< Port of its cluster listener. */
+};
+
+/**
+ * @brief Cluster membership of a Server.
+ *
+ * Every node lists all the others, and the node IDs are 0..N-1 for N nodes.
+ * Without peers the server runs on its own.
+ */
+struct ClusterOptions {
+  int node_id = 0;                            /**< This node's ID. */
+  int port = 0;                               /**< Port of this node's cluster listener. */
+  std::vector<ClusterPeer> peers;             /**< Every other node. */
+  size_t link_queue_bytes = 64 * 1024 * 1024; /**< Bytes each link to a peer may queue before dropping. */
+};
+
+/**
+ * @brief Connects a Server to the other nodes of its cluster.
+ *
+ * Client IDs are partitioned between the nodes (see ClusterDirectory). The
+ * node keeps a ClusterLink to every peer for what it sends and accepts one
+ * connection from every peer for what it receives, all in the ordinary
+ * client framing:
+ *
+ * - a broadcast is serialized once and the same frame is queued on every
+ *   link, so each node receives one copy however many clients it has, and
+ *   fans it out to its own clients only;
+ * - anything else addressed to a remote client reaches the owning node
+ *   through a RemoteClientHandler, which the owner hands to the local
+ *   client. Private messages go through a PrivateMessageRouter on both
+ *   sides, so a burst to one remote client crosses the link as one frame.
+ *
+ * Recipients that are not connected on their node are reported to the
+ * sender as with local ones. Nodes trust the sender IDs in what their peers
+ * send, so the cluster port must only be reachable by the other nodes.
+ */
+class ClusterNode {
+public:
+  /**
+   * @brief Constructs a stopped node.
+   *
+   * @param server The local server; must outlive the node.
+   * @param directory The server's client ID directory.
+   * @param options Membership and link settings.
+   * @param socket_options Options for the listener and the link sockets.
+   */
+  ClusterNode(Server *server, const ClusterDirectory &directory, const ClusterOptions &options,
+              const SocketOptions &socket_options);
+
+  /**
+   * @brief Stops the node.
+   */
+  ~ClusterNode();
+
+  ClusterNode(const ClusterNode &) = delete;
+  ClusterNode &operator=(const ClusterNode &) = delete;
+
+  /**
+   * @brief Starts listening for peers and connecting to them.
+   * @return False if the membership is invalid or the cluster port cannot be opened.
+   */
+  bool Start();
+
+  /**
+   * @brief Closes every link; frames not sent yet are dropped.
+   */
+  void Stop();
+
+  /**
+   * @brief Sends a broadcast to every other node, which fans it out to its own clients.
+   * @param message The broadcast.
+   */
+  void Broadcast(const MessageView &message);
+
+  /**
+   * @brief Gets a stand-in for a client of another node.
+   *
+   * @param client_id The client's ID.
+   * @return The proxy, or nullptr if no peer owns the ID.
+   */
+  std::shared_ptr<IClientHandler> GetRemoteClient(int client_id);
+
+private:
+  /**
+   * @brief A connection from a peer and the thread reading it.
+   */
+  struct InboundLink {
+    std::unique_ptr<ISocket> socket;
+    std::thread thread;
+    std::atomic<bool> finished{false}; /**< The thread is done; it can be joined without blocking. */
+  };
+
+  /**
+   * @brief Accepts connections from peers until the node stops.
+   */
+  void AcceptLoop();
+
+  /**
+   * @brief Reads and dispatches what one peer sends until it disconnects.
+   * @param link The peer's connection.
+   */
+  void ReadLoop(InboundLink *link);
+
+  /**
+   * @brief Hands a message from a peer to its local recipients.
+   *
+   * @param message The message.
+   * @param router Collects the private messages of the current read.
+   */
+  void Dispatch(const MessageView &message, PrivateMessageRouter &router);
+
+  /**
+   * @brief Delivers a message to the local client in its recipient_id.
+   * @param message The message.
+   */
+  void DeliverToClient(const MessageView &message);
+
+  /**
+   * @brief Joins and removes inbound links whose peer disconnected.
+   */
+  void ReapInboundLinks();
+
+  Server *server_;
+  const ClusterDirectory &directory_;
+  ClusterOptions options_;
+  SocketOptions socket_options_;
+  std::unique_ptr<ISocket> listener_;
+  std::thread accept_thread_;
+  std::vector<std::unique_ptr<ClusterLink>> links_; /**< Indexed by node ID; null for this node. */
+  std::vector<std::unique_ptr<InboundLink>> inbound_links_;
+  std::mutex inbound_mutex_; /**< Protects inbound_links_. */
+  std::atomic<bool> running_;
+};
+
+#endif // CLUSTER_NODE_H_
@@ -6,6 +6,7 @@
 #include "Message.h"
 #include "Server.h"
 
+#include <array>
 #include <memory>
 #include <vector>
 
@@ -13,16 +14,20 @@
  * @brief A message handler that dispatches messages to a list of other
  * handlers.
  *
- * This handler iterates through a list of registered IMessageHandler instances
- * and passes the incoming message to the first handler that indicates it
- * processed the message.
+ * Handlers that declare the message types they consume (see
+ * IMessageHandler::GetHandledTypes) are entered into a flat table indexed by
+ * MessageType, so dispatching a message is a single array lookup. Legacy
+ * handlers that declare no types keep the original behaviour: they are tried
+ * in the order they were added until one indicates it processed the message.
+ * The fallback chain is also consulted when a typed handler declines a
+ * message.
  */
 class CompositeMessageHandler : public IMessageHandler {
 public:
   /**
    * @brief Constructs a new CompositeMessageHandler.
    */
-  CompositeMessageHandler() = default;
+  CompositeMessageHandler();
 
   /**
    * @brief Destroys the CompositeMessageHandler.
@@ -32,26 +37,78 @@ public:
   /**
    * @brief Adds a message handler to the composite.
    *
-   * Handlers are tried in the order they are added.
+   * The handler is registered for the types it declares; if it declares
+   * none, it is appended to the ordered fallback chain. When two handlers
+   * declare the same type, the one added first keeps it.
    *
    * @param handler The message handler to add.
    */
   void AddHandler(std::unique_ptr<IMessageHandler> handler);
 
+  /**
+   * @brief Adds a handler to the ordered fallback chain, ignoring any types
+   * it declares.
+   *
+   * Fallback handlers are tried in the order they are added.
+   *
+   * @param handler The message handler to add.
+   */
+  void AddFallbackHandler(std::unique_ptr<IMessageHandler> handler);
+
   /**
    * @brief Handles an incoming message by dispatching it to registered
    * handlers.
    *
-   * @param message The deserialized Message object received.
+   * The time spent in the handlers is recorded per message type.
+   *
+   * @param message View of the received message.
    * @param sender The client handler that received the message.
    * @param server A pointer to the Server instance.
    * @return True if any handler processed the message, false otherwise.
    */
-  bool HandleMessage(const Message &message, IClientHandler *sender,
+  bool HandleMessage(const MessageView &message, IClientHandler *sender,
                      Server *server) override;
 
+  /**
+   * @brief Gets the union of the types handled by the typed handlers.
+   *
+   * @return The handled message types.
+   */
+  std::vector<MessageType> GetHandledTypes() const override;
+
+  /**
+   * @brief Tells whether a message type is cheap enough to handle on the I/O thread.
+   *
+   * True only if the handler registered for the type says so and so does
+   * every fallback handler, since those see the message if it declines.
+   *
+   * @param type The message type.
+   * @return True if the type may be handled inline.
+   */
+  bool IsInlineSafe(MessageType type) const override;
+
+  /**
+   * @brief Notifies every registered handler that a client disconnected.
+   *
+   * @param client_id The ID of the disconnected client.
+   * @param server A pointer to the Server instance.
+   */
+  void OnClientDisconnected(int client_id, Server *server) override;
+
 private:
-  std::vector<std::unique_ptr<IMessageHandler>> handlers_;
+  /**
+   * @brief Offers a message to the typed handler, then to the fallback chain.
+   *
+   * @param message View of the received message.
+   * @param sender The client handler that received the message.
+   * @param server A pointer to the Server instance.
+   * @return True if any handler processed the message, false otherwise.
+   */
+  bool Dispatch(const MessageView &message, IClientHandler *sender, Server *server);
+
+  std::vector<std::unique_ptr<IMessageHandler>> handlers_; /**< Owns every added handler. */
+  std::array<IMessageHandler *, kMessageTypeCount> dispatch_table_; /**< Typed handler per MessageType. */
+  std::vector<IMessageHandler *> fallback_handlers_; /**< Legacy handlers, in order. */
 };
 
 #endif // COMPOSITE_MESSAGE_HANDLER_H_
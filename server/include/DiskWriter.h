@@ -0,0 +1,71 @@
+#ifndef DISK_WRITER_H_
+#define DISK_WRITER_H_
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/**
+ * @brief A small pool of threads that performs blocking disk I/O.
+ *
+ * Network threads hand file writes to the pool instead of blocking on the
+ * disk themselves. Jobs are plain callables executed in submission order by
+ * whichever pool thread is free; jobs that must not run concurrently have to
+ * be ordered by the submitter (WriteBehindFile uses positional writes, so its
+ * batches may complete in any order).
+ */
+class DiskWriter {
+public:
+  /**
+   * @brief Constructs a new DiskWriter and starts its threads.
+   * @param thread_count Number of I/O threads (at least 1).
+   */
+  explicit DiskWriter(size_t thread_count = kDefaultThreadCount);
+
+  /**
+   * @brief Destroys the DiskWriter. Runs the remaining jobs, then joins the threads.
+   */
+  ~DiskWriter();
+
+  DiskWriter(const DiskWriter &) = delete;
+  DiskWriter &operator=(const DiskWriter &) = delete;
+
+  /**
+   * @brief Queues a job for one of the I/O threads.
+   *
+   * Jobs submitted after Shutdown has finished are executed on the calling
+   * thread.
+   *
+   * @param job The job to execute.
+   */
+  void Submit(std::function<void()> job);
+
+  /**
+   * @brief Runs the remaining jobs and joins the threads.
+   *
+   * Jobs may submit further jobs while the pool drains. Safe to call more
+   * than once.
+   */
+  void Shutdown();
+
+  static const size_t kDefaultThreadCount = 2;
+
+private:
+  /**
+   * @brief The loop executed by each I/O thread.
+   */
+  void Run();
+
+  std::mutex mutex_;
+  std::condition_variable jobs_cv_;
+  std::deque<std::function<void()>> jobs_; /**< Pending jobs, oldest first. */
+  std::vector<std::thread> threads_;
+  bool stopping_; /**< Set by Shutdown; threads exit once jobs_ is empty. */
+  bool stopped_;  /**< Set once the threads are joined; Submit then runs jobs inline. */
+};
+
+#endif // DISK_WRITER_H_
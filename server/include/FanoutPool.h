@@ -0,0 +1,68 @@
+#ifndef FANOUT_POOL_H_
+#define FANOUT_POOL_H_
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/**
+ * @brief Helper threads that split one large fan-out into parallel slices.
+ *
+ * Queuing a frame on a recipient is cheap, but a room of thousands still
+ * keeps one thread busy for a while. Run hands all slices but the first to
+ * the pool, works on the first one itself, then helps with whatever is still
+ * queued until its own slices are done. Because Run only returns once every
+ * slice has run, messages from one sender still reach each recipient in
+ * order.
+ */
+class FanoutPool {
+public:
+  /**
+   * @brief Constructs the pool and starts its threads.
+   * @param thread_count Number of helper threads (at least 1).
+   */
+  explicit FanoutPool(size_t thread_count);
+
+  /**
+   * @brief Destroys the pool. Runs the remaining slices, then joins the threads.
+   */
+  ~FanoutPool();
+
+  FanoutPool(const FanoutPool &) = delete;
+  FanoutPool &operator=(const FanoutPool &) = delete;
+
+  /**
+   * @brief Runs slice(0) .. slice(count - 1) in parallel and waits for all of them.
+   *
+   * May be called from any number of threads at once. After Shutdown, the
+   * slices run on the calling thread.
+   *
+   * @param count Number of slices.
+   * @param slice The work for one slice, given its index.
+   */
+  void Run(size_t count, const std::function<void(size_t)> &slice);
+
+  /**
+   * @brief Runs the remaining slices and joins the threads. Safe to call more than once.
+   */
+  void Shutdown();
+
+private:
+  /**
+   * @brief The loop executed by each helper thread.
+   */
+  void WorkerLoop();
+
+  std::mutex mutex_;
+  std::condition_variable work_cv_; /**< Signals queued slices to the helpers. */
+  std::condition_variable done_cv_; /**< Signals finished slices to waiting Run calls. */
+  std::deque<std::function<void()>> work_; /**< Slices not picked up yet, oldest first. */
+  std::vector<std::thread> threads_;
+  bool stopping_;
+};
+
+#endif // FANOUT_POOL_H_
@@ -1,48 +1,109 @@
 #ifndef FILE_TRANSFER_HANDLER_H_
 #define FILE_TRANSFER_HANDLER_H_
 
+#include "DiskWriter.h"
 #include "IClientHandler.h"
 #include "IMessageHandler.h"
 #include "Message.h"
 #include "Server.h"
+#include "WriteBehindFile.h"
 
-#include <fstream> // For file operations
-#include <map>     // To track ongoing transfers
-#include <mutex>   // For thread safety
+#include <array>
+#include <functional>
+#include <memory>
+#include <mutex> // For thread safety
 #include <string>
+#include <unordered_map> // To track ongoing transfers
+#include <unordered_set>
 
 /**
  * @brief Message handler for handling file transfer related messages.
  *
  * This class processes messages of type FILE_TRANSFER_REQUEST, FILE_DATA_CHUNK,
- * and FILE_TRANSFER_COMPLETE on the server side. It manages the state of
- * ongoing file transfers.
+ * FILE_TRANSFER_COMPLETE and FILE_TRANSFER_ACK on the server side. It manages
+ * the state of ongoing file transfers to the server and relays client-to-client
+ * transfers, including the receiver's cumulative acknowledgements that drive
+ * the sender's window.
+ *
+ * Uploads to the server never touch the disk on the network thread: chunks
+ * are staged per transfer and written behind in large batches (see
+ * WriteBehindFile), by a DiskWriter pool or, for a connection whose event
+ * loop runs on io_uring, by that loop's ring. Such an upload is also read
+ * back for its content hash through the ring. Acks to the uploader run at most
+ * kMaxUnwrittenUploadBytes ahead of what is on disk, so a slow disk pushes
+ * back through the sender's window instead of piling up in memory.
+ *
+ * A client may run up to kMaxUploadsPerClient uploads at once. Every file
+ * message carries the transfer ID chosen by the sending client in its header,
+ * so uploads are keyed by (client, transfer ID) and client-to-client messages
+ * are relayed with the ID untouched. Transfer state is sharded by uploading
+ * client, so concurrent uploads only share a lock when their clients hash to
+ * the same shard, and then only for lookups.
+ *
+ * When a request announces the file's content hash, the upload is content
+ * addressed: finished files live once in a store under incoming_files and the
+ * upload's name is a hard link to it. A file the store already holds is
+ * acknowledged in full straight away, and an upload that was interrupted
+ * (error or disconnect) is kept as a partial file whose length the next
+ * upload of the same content gets as its first ack, so the client resumes
+ * from there. Chunks flagged with a CRC32C are verified on arrival and the
+ * whole file is hashed again before it enters the store.
  */
 class FileTransferHandler : public IMessageHandler {
 public:
   /**
    * @brief Constructs a new FileTransferHandler.
+   *
+   * @param disk_threads Number of I/O threads writing uploads to disk.
    */
-  FileTransferHandler() = default;
+  explicit FileTransferHandler(size_t disk_threads = DiskWriter::kDefaultThreadCount);
 
   /**
-   * @brief Destroys the FileTransferHandler. Closes any open file streams.
+   * @brief Destroys the FileTransferHandler. Finishes pending disk writes
+   * and closes any open files.
    */
   ~FileTransferHandler() override;
 
+  static const size_t kMaxUnwrittenUploadBytes = 8 * 1024 * 1024;
+  static const size_t kMaxUploadsPerClient = 64;
+
   /**
    * @brief Handles an incoming message related to file transfer.
    *
    * Processes messages based on their type (request, data chunk, complete).
    *
-   * @param message The deserialized Message object received.
+   * @param message View of the received message.
    * @param sender The client handler that received the message.
    * @param server A pointer to the Server instance for interactions.
    * @return True if the message was handled by this handler, false otherwise.
    */
-  bool HandleMessage(const Message &message, IClientHandler *sender,
+  bool HandleMessage(const MessageView &message, IClientHandler *sender,
                      Server *server) override;
 
+  /**
+   * @brief Gets the message types this handler consumes.
+   *
+   * @return The file transfer message types.
+   */
+  std::vector<MessageType> GetHandledTypes() const override;
+
+  /**
+   * @brief Tells whether a message type is cheap enough to handle on the I/O thread.
+   *
+   * @param type The message type.
+   * @return True for FILE_TRANSFER_ACK, which is only relayed.
+   */
+  bool IsInlineSafe(MessageType type) const override;
+
+  /**
+   * @brief Handles a client disconnecting: its unfinished uploads are kept
+   * aside so that the same content can resume after a reconnect.
+   *
+   * @param client_id The ID of the disconnected client.
+   * @param server A pointer to the Server instance.
+   */
+  void OnClientDisconnected(int client_id, Server *server) override;
+
 private:
   /**
    * @brief Handles a file transfer request message.
@@ -54,7 +115,7 @@ private:
    * @param server A pointer to the Server instance.
    * @return True if the request was processed successfully, false otherwise.
    */
-  bool HandleFileTransferRequest(const Message &message, IClientHandler *sender,
+  bool HandleFileTransferRequest(const MessageView &message, IClientHandler *sender,
                                  Server *server);
 
   /**
@@ -67,7 +128,7 @@ private:
    * @param server A pointer to the Server instance.
    * @return True if the chunk was processed successfully, false otherwise.
    */
-  bool HandleFileDataChunk(const Message &message, IClientHandler *sender,
+  bool HandleFileDataChunk(const MessageView &message, IClientHandler *sender,
                            Server *server);
 
   /**
@@ -81,7 +142,7 @@ private:
    * @return True if the completion message was processed successfully, false
    * otherwise.
    */
-  bool HandleFileTransferComplete(const Message &message,
+  bool HandleFileTransferComplete(const MessageView &message,
                                   IClientHandler *sender, Server *server);
 
   /**
@@ -94,17 +155,40 @@ private:
    * @param server A pointer to the Server instance.
    * @return True if the error was processed successfully, false otherwise.
    */
-  bool HandleFileTransferError(const Message &message, IClientHandler *sender,
+  bool HandleFileTransferError(const MessageView &message, IClientHandler *sender,
                                Server *server);
 
+  /**
+   * @brief Handles a file transfer acknowledgement.
+   *
+   * Routes the receiver's cumulative ack back to the sending client.
+   *
+   * @param message The file transfer ack message.
+   * @param sender The client handler that sent the ack.
+   * @param server A pointer to the Server instance.
+   * @return True if the ack was processed, false otherwise.
+   */
+  bool HandleFileTransferAck(const MessageView &message, IClientHandler *sender,
+                             Server *server);
+
+  /**
+   * @brief Sends a cumulative file transfer ack from the server to a client.
+   *
+   * @param sender The client handler uploading the file.
+   * @param transfer_id The client's ID for the upload.
+   * @param acked_bytes The number of bytes accepted so far.
+   */
+  void SendFileTransferAck(IClientHandler *sender, uint32_t transfer_id, size_t acked_bytes);
+
   /**
    * @brief Sends a file transfer error message to a client.
    *
    * @param recipient_id The ID of the client to send the error to.
+   * @param transfer_id The transfer the error is about.
    * @param error_message The error description.
    * @param server A pointer to the Server instance.
    */
-  void SendFileTransferError(int recipient_id, const std::string &error_message,
+  void SendFileTransferError(int recipient_id, uint32_t transfer_id, const std::string &error_message,
                              Server *server);
 
   /**
@@ -115,20 +199,167 @@ private:
     std::string file_name;
     size_t total_size;
     size_t received_size;
-    std::ofstream file_stream;
+    size_t acked_size; // Largest ack sent to the uploader
+    std::shared_ptr<WriteBehindFile> file;
+    EventLoop *event_loop; // Writes and reads back the file on its ring; nullptr if disk_writer_ does
     int sender_id;
     int recipient_id;
+    uint32_t transfer_id; // Chosen by the uploading client
+    bool complete;     // FILE_TRANSFER_COMPLETE received, flush in progress
+    std::mutex mutex;  // Protects the sizes and keeps acks in order
+    std::string final_path;  // Where the finished upload appears
+    std::string part_path;   // File being written
+    std::string content_key; // Store key; empty if the upload is not content addressed
+    uint64_t content_hash;   // Announced XXH64 of the file
+    bool deduplicated;       // The store already held the content, nothing is written
 
     // Constructor
     IncomingFileTransfer(const std::string &name, size_t size, int sender,
-                         int recipient)
-        : file_name(name), total_size(size), received_size(0),
-          sender_id(sender), recipient_id(recipient) {}
+                         int recipient, uint32_t id)
+        : file_name(name), total_size(size), received_size(0), acked_size(0), event_loop(nullptr),
+          sender_id(sender), recipient_id(recipient), transfer_id(id), complete(false),
+          content_hash(0), deduplicated(false) {}
   };
 
-  // Map to track incoming file transfers: recipient_id -> IncomingFileTransfer
-  std::map<int, IncomingFileTransfer> incoming_transfers_;
-  std::mutex transfers_mutex_; // Mutex to protect access to incoming_transfers_
+  /**
+   * @brief One independently locked slice of the upload table.
+   */
+  struct alignas(64) TransferShard {
+    std::mutex mutex;
+    // UploadKey(client ID, transfer ID) -> transfer
+    std::unordered_map<uint64_t, std::shared_ptr<IncomingFileTransfer>> transfers;
+  };
+
+  /**
+   * @brief Combines a client ID and its transfer ID into an upload table key.
+   * @param sender_id The uploading client's ID.
+   * @param transfer_id The client's ID for the upload.
+   * @return The key.
+   */
+  static uint64_t UploadKey(int sender_id, uint32_t transfer_id);
+
+  /**
+   * @brief Gets the shard holding a client's uploads.
+   * @param sender_id The uploading client's ID.
+   * @return The shard.
+   */
+  TransferShard &ShardFor(int sender_id);
+
+  /**
+   * @brief Looks up an upload.
+   * @param sender_id The uploading client's ID.
+   * @param transfer_id The client's ID for the upload.
+   * @return The transfer, or nullptr if there is none.
+   */
+  std::shared_ptr<IncomingFileTransfer> FindTransfer(int sender_id, uint32_t transfer_id);
+
+  /**
+   * @brief Removes an upload if its table entry is still that transfer.
+   * @param transfer The transfer to remove.
+   */
+  void EraseTransfer(const std::shared_ptr<IncomingFileTransfer> &transfer);
+
+  /**
+   * @brief Acks as much of an upload as the disk backlog allows.
+   *
+   * Safe to call from network and I/O threads; acks are only ever sent in
+   * increasing order.
+   *
+   * @param transfer The upload.
+   * @param server A pointer to the Server instance.
+   */
+  void SendUploadAck(IncomingFileTransfer &transfer, Server *server);
+
+  /**
+   * @brief Reports the outcome of an upload once its last write completed.
+   *
+   * @param transfer The finished upload.
+   * @param success Whether every write succeeded.
+   * @param server A pointer to the Server instance.
+   */
+  void FinishUpload(const std::shared_ptr<IncomingFileTransfer> &transfer, bool success, Server *server);
+
+  /**
+   * @brief Moves a finished upload into the store, if it is content addressed, and reports the outcome.
+   *
+   * @param transfer The finished upload.
+   * @param success Whether every write (and the check of its hash, if done already) succeeded.
+   * @param hash_checked Whether the file was verified against its content hash already.
+   * @param server A pointer to the Server instance.
+   */
+  void StoreUpload(const std::shared_ptr<IncomingFileTransfer> &transfer, bool success, bool hash_checked,
+                   Server *server);
+
+  /**
+   * @brief Reads a finished content-addressed upload back through its event
+   * loop's ring and checks it against the announced size and hash.
+   *
+   * @param transfer The upload; its event_loop is set.
+   * @param on_done Receives whether the file matches, on the loop thread.
+   */
+  void VerifyContentOnLoop(const std::shared_ptr<IncomingFileTransfer> &transfer,
+                           std::function<void(bool matches)> on_done);
+
+  /**
+   * @brief Builds the store name of a file's content.
+   * @param content_hash The XXH64 of the file.
+   * @param file_size The size of the file.
+   * @return The key, "<16 hex digits>-<size>".
+   */
+  static std::string ContentKey(uint64_t content_hash, uint64_t file_size);
+
+  /**
+   * @brief Stops receiving an upload that did not complete.
+   *
+   * @param transfer The upload.
+   * @param keep_partial Whether the received bytes may be resumed later.
+   */
+  void AbandonUpload(const std::shared_ptr<IncomingFileTransfer> &transfer, bool keep_partial);
+
+  /**
+   * @brief Ends a content-addressed upload's claim on its content.
+   *
+   * @param transfer The upload.
+   * @param keep_partial Whether to remember the received bytes for a resume
+   * instead of deleting the partial file.
+   */
+  void ReleaseContent(const IncomingFileTransfer &transfer, bool keep_partial);
+
+  /**
+   * @brief Forgets a partial upload whose data turned out to be unusable.
+   *
+   * @param content_key The key of the content.
+   * @param part_path The partial file.
+   */
+  void DropPartialUpload(const std::string &content_key, const std::string &part_path);
+
+  /**
+   * @brief Verifies a finished content-addressed upload and moves it into the store.
+   *
+   * Unless hash_checked, reads the file back, so it must run on an I/O thread.
+   *
+   * @param transfer The upload.
+   * @param hash_checked Whether the file was verified already.
+   * @return False if the file does not match the announced size and hash.
+   */
+  bool CommitToStore(const IncomingFileTransfer &transfer, bool hash_checked);
+
+  /**
+   * @brief Makes stored content available under the upload's file name.
+   *
+   * @param transfer The upload.
+   * @return False if the file could not be created.
+   */
+  bool LinkStoredContent(const IncomingFileTransfer &transfer);
+
+  static const size_t kTransferShardCount = 16;
+
+  std::array<TransferShard, kTransferShardCount> transfer_shards_;
+
+  std::mutex store_mutex_;                                    // Protects the two members below
+  std::unordered_set<std::string> active_content_;            // Keys with an upload in progress
+  std::unordered_map<std::string, uint64_t> partial_uploads_; // Key -> bytes kept for a resume
+  DiskWriter disk_writer_; // Declared last so it is drained before the transfers go away
 };
 
 #endif // FILE_TRANSFER_HANDLER_H_
@@ -1,14 +1,58 @@
 #ifndef ICLIENT_HANDLER_H_
 #define ICLIENT_HANDLER_H_
 
+#include <cstddef>
+#include <cstdint>
 #include <string>
 #include <thread>
 
 #include "IMessageHandler.h"
 #include "ISocket.h"
+#include "MessageSerialization.h"
+#include "MessageType.h"
+#include "TokenBucket.h"
 
+class EventLoop;
 class Server;
 
+/**
+ * @brief Traffic counters of one client connection.
+ */
+struct ConnectionStats {
+  uint64_t bytes_received = 0;    /**< Bytes read from the client. */
+  uint64_t bytes_sent = 0;        /**< Bytes written to the client. */
+  uint64_t messages_received = 0; /**< Complete messages read from the client. */
+  size_t queued_bytes = 0;        /**< Bytes waiting in the outbound queue. */
+  size_t dropped_frames = 0;      /**< Frames the outbound queue discarded. */
+};
+
+/**
+ * @brief Liveness and memory settings of client connections, in milliseconds.
+ *
+ * A value of 0 disables the corresponding check.
+ */
+struct ConnectionTimeouts {
+  int heartbeat_interval_ms = 30000; /**< Silence from the client before it is sent a HEARTBEAT probe. */
+  int read_timeout_ms = 90000;       /**< Silence (probes unanswered) after which the client is presumed dead. */
+  int write_timeout_ms = 60000;      /**< Time queued frames may wait without a byte being written. */
+  int idle_timeout_ms = 0;           /**< Time without any message but heartbeats before disconnecting. */
+  int trim_after_ms = 10000;         /**< Time without traffic after which the connection frees its buffers. */
+};
+
+/**
+ * @brief Admission limits on what one client sends.
+ *
+ * A client over one of its rates is neither disconnected nor does it lose
+ * anything it sent: the server stops reading from it until the bucket has
+ * refilled, so the excess waits in the client's own socket buffers.
+ */
+struct ConnectionLimits {
+  size_t max_frame_size = 16 * 1024 * 1024; /**< Largest frame accepted; a larger header disconnects the client. */
+  RateLimit bytes;                          /**< Bytes per second, all traffic. */
+  RateLimit messages;                       /**< Messages per second, all types. */
+  RateLimit message_types[kMessageTypeCount]; /**< Messages per second of each type, indexed by MessageType. */
+};
+
 /**
  * @brief Interface for handling a single client connection on the server.
  *
@@ -42,7 +86,36 @@ public:
    * @param message The message structure to send.
    * @return True if the message was sent successfully, false otherwise.
    */
-  virtual bool SendMessage(const Message &message) = 0;
+  virtual bool SendMessage(const MessageView &message) = 0;
+
+  /**
+   * @brief Sends an already serialized frame to the connected client.
+   *
+   * The frame is shared, not copied, so the same frame can be handed to many
+   * clients (e.g. for a broadcast).
+   *
+   * @param frame The serialized message frame.
+   * @return True if the frame was sent successfully, false otherwise.
+   */
+  virtual bool SendFrame(const SharedFrame &frame) = 0;
+
+  /**
+   * @brief Gets the wire protocol version used for frames sent to this client.
+   *
+   * Frames passed to SendFrame must be serialized with this version.
+   *
+   * @return The protocol version.
+   */
+  virtual int GetProtocolVersion() const = 0;
+
+  /**
+   * @brief Gets the codec negotiated for payloads sent to this client.
+   *
+   * Frames passed to SendFrame may be compressed with this codec.
+   *
+   * @return The codec, or CompressionCodecId::NONE.
+   */
+  virtual CompressionCodecId GetCompressionCodec() const = 0;
 
   /**
    * @brief Gets the unique identifier for this client handler.
@@ -55,6 +128,32 @@ public:
    * @return A pointer to the ISocket instance.
    */
   virtual ISocket *GetSocket() const = 0;
+
+  /**
+   * @brief Gets the traffic counters of this connection.
+   * @return A copy of the counters.
+   */
+  virtual ConnectionStats GetStats() const = 0;
+
+  /**
+   * @brief Gets the event loop driving this connection.
+   *
+   * Work for the connection that must not block, such as its file writes,
+   * can complete on this loop.
+   *
+   * @return The loop, or nullptr if the connection has none.
+   */
+  virtual EventLoop *GetEventLoop() const = 0;
+
+  /**
+   * @brief Pauses or resumes reading from the client, for server-wide admission control.
+   *
+   * A paused client stops being read shortly after the call; what it already
+   * sent is still handled.
+   *
+   * @param paused True to stop reading until called again with false.
+   */
+  virtual void SetAdmissionPaused(bool paused) = 0;
 };
 
 #endif // ICLIENT_HANDLER_H_
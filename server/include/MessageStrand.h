@@ -0,0 +1,131 @@
+#ifndef MESSAGE_STRAND_H_
+#define MESSAGE_STRAND_H_
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <mutex>
+
+#include "WorkStealingExecutor.h"
+
+/**
+ * @brief Runs one connection's tasks in order on a shared WorkStealingExecutor.
+ *
+ * Posted tasks run one at a time, in the order they were posted, on
+ * whichever worker picks the strand up; different strands run in parallel.
+ * A strand gives up its worker after a batch of tasks so a busy connection
+ * cannot keep one to itself. The queued work is bounded in bytes: Post never
+ * waits, but once the bound is reached it reports the strand full, and the
+ * connection stops reading until the space callback says the strand caught
+ * up. Only that connection is held back, never the thread posting for it.
+ */
+class MessageStrand {
+public:
+  using Task = std::function<void()>;
+
+  /**
+   * @brief Enum describing the outcome of Post.
+   */
+  enum class PostResult {
+    QUEUED, /**< The task is queued. */
+    FULL,   /**< The task is queued, but the bound is reached: stop posting until the space callback runs. */
+    CLOSED, /**< The strand is closed; the task is dropped. */
+  };
+
+  /**
+   * @brief Constructs an idle strand.
+   *
+   * @param executor The executor running the tasks; must outlive the strand.
+   * @param max_queued_bytes Queued bytes at which Post reports FULL (0 = unbounded).
+   */
+  MessageStrand(WorkStealingExecutor *executor, size_t max_queued_bytes);
+
+  /**
+   * @brief Destroys the strand after closing it.
+   */
+  ~MessageStrand();
+
+  MessageStrand(const MessageStrand &) = delete;
+  MessageStrand &operator=(const MessageStrand &) = delete;
+
+  /**
+   * @brief Sets what runs once a strand that reported FULL drained to half its bound.
+   *
+   * The callback runs on a worker thread, between two tasks. Must be set
+   * before the first Post.
+   *
+   * @param callback The callback.
+   */
+  void SetSpaceCallback(Task callback);
+
+  /**
+   * @brief Queues a task behind the ones already posted, without waiting.
+   *
+   * @param task The task to run.
+   * @param bytes Size of the data the task holds, counted against the bound;
+   * bookkeeping tasks pass 0 and never fill the strand.
+   * @return QUEUED, FULL if the queued bytes reached the bound, or CLOSED.
+   */
+  PostResult Post(Task task, size_t bytes);
+
+  /**
+   * @brief Checks whether a Post reported FULL and the space callback has
+   * not run since.
+   *
+   * @return True if the poster should hold back.
+   */
+  bool IsFull() const;
+
+  /**
+   * @brief Waits until IsFull is false or the strand is closed.
+   *
+   * For a poster that has a thread of its own to block.
+   */
+  void WaitForSpace();
+
+  /**
+   * @brief Checks whether no task is queued or running.
+   *
+   * Only meaningful to the single thread posting to the strand: nobody else
+   * can make a strand busy again.
+   *
+   * @return True if the strand is idle.
+   */
+  bool IsIdle() const;
+
+  /**
+   * @brief Drops the queued tasks and waits for the running one to finish.
+   *
+   * Later Post calls fail. Safe to call more than once, but not from one of
+   * the strand's own tasks.
+   */
+  void Close();
+
+private:
+  /**
+   * @brief A posted task and the bytes it accounts for.
+   */
+  struct Entry {
+    Task task;
+    size_t bytes;
+  };
+
+  /**
+   * @brief Runs a batch of queued tasks on an executor thread.
+   */
+  void RunBatch();
+
+  WorkStealingExecutor *executor_;
+  size_t max_queued_bytes_;
+  mutable std::mutex mutex_;
+  std::condition_variable state_cv_; /**< Signals freed space and the strand going idle. */
+  std::deque<Entry> queue_;          /**< Tasks not started yet, in posting order. */
+  Task space_callback_;              /**< Run once a full strand has room again. */
+  size_t queued_bytes_;
+  bool scheduled_; /**< A RunBatch is queued on the executor or running. */
+  bool full_;      /**< Post reported FULL; cleared when the space callback runs. */
+  bool closed_;
+};
+
+#endif // MESSAGE_STRAND_H_
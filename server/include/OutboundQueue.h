@@ -0,0 +1,200 @@
+#ifndef OUTBOUND_QUEUE_H_
+#define OUTBOUND_QUEUE_H_
+
+#include <atomic>
+#include <cstddef>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "ISocket.h"
+#include "MessageSerialization.h"
+#include "MpscQueue.h"
+#include "PriorityScheduler.h"
+
+/**
+ * @brief Enum defining what happens when a client's outbound queue is full.
+ */
+enum class OverflowPolicy {
+  DROP_OLDEST, /**< Discard the oldest chat frames that have not started sending yet. */
+  DISCONNECT,  /**< Treat the client as a slow consumer and disconnect it. */
+};
+
+/**
+ * @brief Limits and batching settings for a per-connection outbound queue.
+ */
+struct OutboundQueueOptions {
+  size_t max_queued_bytes = 8 * 1024 * 1024;             /**< Soft limit on bytes waiting to be sent. */
+  size_t max_batch_frames = 64;                          /**< Maximum frames coalesced into one gathered write. */
+  size_t bulk_quantum_bytes = PriorityScheduler<SharedFrame>::kDefaultBulkQuantum; /**< Fair share per transfer turn. */
+  OverflowPolicy overflow_policy = OverflowPolicy::DROP_OLDEST; /**< Behaviour when the limit is exceeded. */
+};
+
+/**
+ * @brief Bounded queue of serialized frames waiting to be written to one client.
+ *
+ * Frames are shared and immutable, so a broadcast enqueues the same buffer on
+ * every recipient's queue instead of copying it.
+ *
+ * Any number of threads may Push; exactly one writer (the client's writer
+ * thread or its event loop) drains the queue with Gather/Consume, which lets
+ * it coalesce several frames into a single gathered write. Pushes go through
+ * a lock-free MpscQueue and only check an atomic byte count, so producers
+ * do not contend with each other or with the writer; the writer moves them
+ * into its scheduler before every batch. Only a push that finds the queue
+ * over its limit takes the writer's lock, to apply the overflow policy even
+ * while the writer is stalled. Frames handed out
+ * by Gather stay valid until the matching Consume call and are never dropped
+ * by the overflow policy, and neither is a partially sent frame, so the byte
+ * stream on the wire is never corrupted.
+ *
+ * Pending frames are scheduled by the MessagePriority of their header (see
+ * PriorityScheduler), so chat and control messages overtake queued file
+ * chunks. Only frame boundaries are preemption points: frames gathered but
+ * not written yet go back to the scheduler on Consume, while a partially
+ * written frame is always finished first. The overflow policy drops only
+ * chat frames: a file chunk or completion that vanished from the middle of
+ * a relayed transfer would corrupt it without either end noticing, so file
+ * traffic, like control traffic, is only ever throttled, by the sender's
+ * window of unacknowledged chunks.
+ */
+class OutboundQueue {
+public:
+  /**
+   * @brief Enum describing the outcome of a Push call.
+   */
+  enum class PushResult {
+    QUEUED,            /**< The frame was queued. */
+    QUEUED_AFTER_DROP, /**< The frame was queued after dropping older frames. */
+    LIMIT_EXCEEDED,    /**< The queue is full and the policy is DISCONNECT. */
+    CLOSED,            /**< The queue was closed; the connection is going away. */
+  };
+
+  /**
+   * @brief Constructs a new OutboundQueue.
+   * @param options The queue limits and overflow policy.
+   */
+  explicit OutboundQueue(const OutboundQueueOptions &options);
+
+  /**
+   * @brief Appends a serialized frame to the queue.
+   *
+   * Lock-free unless the queue is over its limit; wakes the writer thread if
+   * it is waiting for data.
+   *
+   * @param frame The frame to queue (shared, never modified).
+   * @return The outcome of the push.
+   */
+  PushResult Push(SharedFrame frame);
+
+  /**
+   * @brief Collects the next batch of pending bytes for a gathered write.
+   *
+   * Writer side only. The returned buffers remain valid until Consume.
+   *
+   * @param buffers Output vector receiving up to max_batch_frames buffers (cleared first).
+   * @return The total number of bytes described by the buffers.
+   */
+  size_t Gather(std::vector<IoBuffer> &buffers);
+
+  /**
+   * @brief Releases bytes that were written after a Gather call.
+   *
+   * Writer side only. Fully written frames are removed; a partially written
+   * frame stays at the front and resumes from where the write stopped, and
+   * frames the write did not reach are rescheduled.
+   *
+   * @param bytes_sent Number of bytes the socket accepted.
+   */
+  void Consume(size_t bytes_sent);
+
+  /**
+   * @brief Blocks until there is something to write, the queue is closed or
+   * the timeout expires.
+   *
+   * Writer side only.
+   *
+   * @param timeout_ms Maximum time to wait in milliseconds, or -1 to wait indefinitely.
+   * @return False if the queue was closed; otherwise frames are pending or
+   * the timeout expired (see IsEmpty).
+   */
+  bool WaitForData(int timeout_ms = -1);
+
+  /**
+   * @brief Closes the queue: further pushes are rejected and waiters wake up.
+   */
+  void Close();
+
+  /**
+   * @brief Checks whether any bytes are waiting to be written.
+   * @return True if the queue is empty.
+   */
+  bool IsEmpty() const;
+
+  /**
+   * @brief Gets the number of frames discarded by the DROP_OLDEST policy.
+   * @return The dropped frame count.
+   */
+  size_t GetDroppedFrameCount() const;
+
+  /**
+   * @brief Gets the number of bytes waiting to be written.
+   * @return The queued byte count.
+   */
+  size_t GetQueuedBytes() const;
+
+  /**
+   * @brief Frees the writer's scheduling structures while nothing is queued.
+   *
+   * Writer side only. They are allocated again by the next frame, so this
+   * is meant for connections that have gone quiet.
+   *
+   * @return True if memory was released, false if frames are pending or it
+   * already was.
+   */
+  bool ReleaseMemory();
+
+private:
+  using FrameScheduler = PriorityScheduler<SharedFrame>;
+
+  /**
+   * @brief The writer's containers, which allocate even while empty.
+   */
+  struct Schedule {
+    explicit Schedule(size_t bulk_quantum) : pending(bulk_quantum) {}
+
+    FrameScheduler pending;                      /**< Frames not handed out yet. */
+    std::deque<FrameScheduler::Entry> in_flight; /**< Frames handed out by Gather, in wire order. */
+  };
+
+  /**
+   * @brief Moves pushed frames into the scheduler. Caller holds writer_mutex_.
+   */
+  void TakeIncomingLocked();
+
+  /**
+   * @brief Drops chat frames until the new frame fits. Caller holds writer_mutex_.
+   *
+   * @param incoming_size Size of the frame about to be queued.
+   * @return The number of frames dropped.
+   */
+  size_t DropOldestLocked(size_t incoming_size);
+
+  /**
+   * @brief Checks whether any bytes are waiting to be written. Caller holds writer_mutex_.
+   * @return True if the queue is empty.
+   */
+  bool IsEmptyLocked() const;
+
+  OutboundQueueOptions options_;
+  MpscQueue<SharedFrame> incoming_;             /**< Frames pushed but not yet seen by the writer. */
+  mutable std::mutex writer_mutex_;             /**< Protects the members below; uncontended unless overflowing. */
+  std::unique_ptr<Schedule> schedule_;          /**< Created by the first frame, null after ReleaseMemory. */
+  size_t front_offset_;                         /**< Bytes of schedule_->in_flight.front() already written. */
+  std::atomic<size_t> queued_bytes_;            /**< Unwritten bytes across all frames. */
+  std::atomic<size_t> dropped_frames_;
+  std::atomic<bool> closed_;
+};
+
+#endif // OUTBOUND_QUEUE_H_
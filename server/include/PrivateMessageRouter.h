@@ -0,0 +1,111 @@
+#ifndef PRIVATE_MESSAGE_ROUTER_H_
+#define PRIVATE_MESSAGE_ROUTER_H_
+
+#include <cstddef>
+#include <unordered_map>
+#include <vector>
+
+#include "BufferPool.h"
+#include "IClientHandler.h"
+#include "MessageView.h"
+
+class Server;
+
+/**
+ * @brief Routes one connection's private messages straight to their recipients.
+ *
+ * A PRIVATE_MESSAGE names its recipient in recipient_id and needs no other
+ * handling, so the connection passes each one it receives to Add instead of
+ * the message handler. Once the read burst is dispatched, Flush looks every
+ * distinct recipient up once and queues all of its messages as a single
+ * frame holding the received wire bytes back to back, so a burst costs one
+ * lookup and one queue push per recipient rather than per message.
+ *
+ * Messages that cannot be forwarded byte for byte (decompressed on receipt,
+ * carrying another sender's ID, or in a wire format the recipient has not
+ * negotiated) are serialized for the recipient instead. Messages to one
+ * recipient keep their order. Not thread-safe; each connection owns its
+ * router.
+ */
+class PrivateMessageRouter {
+public:
+  /**
+   * @brief Constructs a router with nothing pending.
+   * @param server The server to look recipients up in.
+   */
+  explicit PrivateMessageRouter(Server *server);
+
+  /**
+   * @brief Queues a received private message until the next Flush.
+   *
+   * Copies what it needs, so the view may be invalidated right after.
+   *
+   * @param message View of the received message.
+   * @param sender_id ID of the connection it was received on, which
+   * replaces whatever sender ID the client put in the header.
+   */
+  void Add(const MessageView &message, int sender_id);
+
+  /**
+   * @brief Delivers the queued messages, one batch per recipient.
+   *
+   * Recipients that are not connected are reported back to the sender.
+   *
+   * @param sender The connection the messages were received on, or nullptr
+   * for messages relayed from another cluster node, whose senders are then
+   * looked up by the IDs in their headers.
+   */
+  void Flush(IClientHandler *sender);
+
+  /**
+   * @brief Frees the memory kept from earlier bursts.
+   *
+   * For connections that have gone quiet; must not be called between Add
+   * and Flush.
+   */
+  void ReleaseMemory();
+
+private:
+  /**
+   * @brief One queued message.
+   */
+  struct Entry {
+    MessageHeader header;  /**< Header with the verified sender ID. */
+    SharedFrame frame;     /**< Detached received frame, forwarded as is; otherwise null. */
+    size_t offset;         /**< Start of the message in the recipient's bytes. */
+    size_t size;           /**< Bytes at offset: the wire frame, or just the payload if version is 0. */
+    size_t payload_offset; /**< Payload start relative to offset (or to frame's data). */
+    int version;           /**< Wire version of the kept frame, 0 if only the payload was kept. */
+  };
+
+  /**
+   * @brief The messages of the current burst for one recipient.
+   */
+  struct Target {
+    int recipient_id;
+    PooledBuffer bytes;         /**< Wire frames (and kept payloads) in arrival order. */
+    std::vector<Entry> entries; /**< The messages, in arrival order. */
+  };
+
+  /**
+   * @brief Queues a target's messages on its recipient.
+   *
+   * @param target The recipient's batch; its bytes may be moved out.
+   * @param sender The connection the messages were received on, or nullptr.
+   */
+  void Deliver(Target &target, IClientHandler *sender);
+
+  /**
+   * @brief Tells the sender that a recipient is not connected.
+   *
+   * @param recipient_id The unreachable client ID.
+   * @param sender The connection to notify.
+   */
+  static void NotifyUnreachable(int recipient_id, IClientHandler *sender);
+
+  Server *server_;
+  std::vector<Target> targets_;                  /**< Recipients of the current burst, first seen first. */
+  std::unordered_map<int, size_t> target_index_; /**< recipient_id -> index in targets_. */
+};
+
+#endif // PRIVATE_MESSAGE_ROUTER_H_
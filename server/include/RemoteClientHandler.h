@@ -0,0 +1,104 @@
+#ifndef REMOTE_CLIENT_HANDLER_H_
+#define REMOTE_CLIENT_HANDLER_H_
+
+#include "ClusterLink.h"
+#include "IClientHandler.h"
+
+/**
+ * @brief Stand-in for a client connected to another cluster node.
+ *
+ * Server::GetClientHandler returns one for every ID owned by another node,
+ * so message handlers relay private messages and file transfers to remote
+ * clients exactly as to local ones. Whatever is sent to it goes over the
+ * link to the owning node, which delivers it to the client (or reports back
+ * that the client is not connected there).
+ *
+ * The link always carries the latest wire format uncompressed; the owning
+ * node converts for the client. Lifecycle, socket and admission calls do
+ * nothing, since the connection is not ours. Proxies are created on demand
+ * and never registered, so broadcasts do not reach them.
+ */
+class RemoteClientHandler : public IClientHandler {
+public:
+  /**
+   * @brief Constructs a proxy.
+   *
+   * @param client_id ID of the remote client.
+   * @param link Link to the node owning it; must outlive the proxy.
+   */
+  RemoteClientHandler(int client_id, ClusterLink *link);
+
+  /**
+   * @brief Does nothing; the owning node runs the connection.
+   */
+  void Start() override;
+
+  /**
+   * @brief Does nothing; the owning node runs the connection.
+   */
+  void Stop() override;
+
+  /**
+   * @brief Forwards a message to the client's node.
+   *
+   * @param message The message to send.
+   * @return True if the message was queued on the link.
+   */
+  bool SendMessage(const MessageView &message) override;
+
+  /**
+   * @brief Forwards a serialized frame to the client's node.
+   *
+   * @param frame The frame, serialized for GetProtocolVersion and GetCompressionCodec.
+   * @return True if the frame was queued on the link.
+   */
+  bool SendFrame(const SharedFrame &frame) override;
+
+  /**
+   * @brief Gets the wire protocol version of the link.
+   * @return kProtocolVersionLatest.
+   */
+  int GetProtocolVersion() const override;
+
+  /**
+   * @brief Gets the codec of the link.
+   * @return CompressionCodecId::NONE.
+   */
+  CompressionCodecId GetCompressionCodec() const override;
+
+  /**
+   * @brief Gets the ID of the remote client.
+   * @return The client ID.
+   */
+  int GetClientId() const override;
+
+  /**
+   * @brief Gets the socket, which lives on another node.
+   * @return nullptr.
+   */
+  ISocket *GetSocket() const override;
+
+  /**
+   * @brief Gets the traffic counters, which are kept by the owning node.
+   * @return Zeroed counters.
+   */
+  ConnectionStats GetStats() const override;
+
+  /**
+   * @brief Gets the event loop, which lives on another node.
+   * @return nullptr.
+   */
+  EventLoop *GetEventLoop() const override;
+
+  /**
+   * @brief Does nothing; admission control is per node.
+   * @param paused Ignored.
+   */
+  void SetAdmissionPaused(bool paused) override;
+
+private:
+  int client_id_;
+  ClusterLink *link_;
+};
+
+#endif // REMOTE_CLIENT_HANDLER_H_
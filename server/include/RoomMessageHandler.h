@@ -0,0 +1,104 @@
+#ifndef ROOM_MESSAGE_HANDLER_H_
+#define ROOM_MESSAGE_HANDLER_H_
+
+#include <string>
+
+#include "IMessageHandler.h"
+#include "Message.h"
+#include "RoomRegistry.h"
+
+/**
+ * @brief Message handler for chat rooms.
+ *
+ * Handles ROOM_JOIN (payload: room name), ROOM_LEAVE and ROOM_MESSAGE
+ * (recipient_id: room ID). Joins and leaves are answered with a message of
+ * the same type carrying the room ID in recipient_id and the room name as
+ * payload; a refused join carries -1. Room messages go to the other members
+ * only, prefixed like broadcasts, through Server::SendToClients.
+ */
+class RoomMessageHandler : public IMessageHandler {
+public:
+  /**
+   * @brief Constructs a new RoomMessageHandler with no rooms.
+   */
+  RoomMessageHandler() = default;
+
+  /**
+   * @brief Destroys the RoomMessageHandler.
+   */
+  ~RoomMessageHandler() override = default;
+
+  /**
+   * @brief Handles a room join, leave or message.
+   *
+   * @param message View of the received message.
+   * @param sender The client handler that received the message.
+   * @param server A pointer to the Server instance for the fan-out.
+   * @return True if the message was handled, false otherwise.
+   */
+  bool HandleMessage(const MessageView &message, IClientHandler *sender, Server *server) override;
+
+  /**
+   * @brief Gets the message types this handler consumes.
+   *
+   * @return ROOM_JOIN, ROOM_LEAVE and ROOM_MESSAGE.
+   */
+  std::vector<MessageType> GetHandledTypes() const override;
+
+  /**
+   * @brief Tells whether a message type is cheap enough to handle on the I/O thread.
+   *
+   * @param type The message type.
+   * @return True for ROOM_JOIN and ROOM_LEAVE.
+   */
+  bool IsInlineSafe(MessageType type) const override;
+
+  /**
+   * @brief Drops the disconnected client from all its rooms.
+   *
+   * @param client_id The ID of the disconnected client.
+   * @param server A pointer to the Server instance.
+   */
+  void OnClientDisconnected(int client_id, Server *server) override;
+
+private:
+  /**
+   * @brief Adds the sender to the room named in the payload and answers it.
+   *
+   * @param message The ROOM_JOIN message.
+   * @param sender The joining client.
+   * @param server A pointer to the Server instance.
+   */
+  void HandleJoin(const MessageView &message, IClientHandler *sender, Server *server);
+
+  /**
+   * @brief Removes the sender from the room in recipient_id and answers it.
+   *
+   * @param message The ROOM_LEAVE message.
+   * @param sender The leaving client.
+   */
+  void HandleLeave(const MessageView &message, IClientHandler *sender);
+
+  /**
+   * @brief Sends a room message to the other members of the room.
+   *
+   * @param message The ROOM_MESSAGE message.
+   * @param sender The posting client.
+   * @param server A pointer to the Server instance.
+   */
+  void HandleRoomMessage(const MessageView &message, IClientHandler *sender, Server *server);
+
+  /**
+   * @brief Sends a join or leave answer to a client.
+   *
+   * @param client The client to answer.
+   * @param type ROOM_JOIN or ROOM_LEAVE.
+   * @param room_id The room ID, or -1 for a refused join.
+   * @param room_name The room name.
+   */
+  static void SendRoomReply(IClientHandler *client, MessageType type, int room_id, const std::string &room_name);
+
+  RoomRegistry rooms_;
+};
+
+#endif // ROOM_MESSAGE_HANDLER_H_
@@ -0,0 +1,115 @@
+#ifndef ROOM_REGISTRY_H_
+#define ROOM_REGISTRY_H_
+
+#include <cstddef>
+#include <memory>
+#include <shared_mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "IClientHandler.h"
+
+/**
+ * @brief Thread-safe set of chat rooms and their members.
+ *
+ * Each room keeps its members as a flat, immutable array of handler
+ * references. Joins and leaves build a new array and swap it in, so a room
+ * message only takes a shared lock long enough to copy one reference to the
+ * current array and then walks contiguous memory without any lock; fan-out
+ * cost depends on the room's size, not on the number of connected clients.
+ * A per-client index of joined rooms makes the membership check and the
+ * clean-up on disconnect independent of the number of rooms.
+ *
+ * Rooms are created by their first join and removed with their last member.
+ */
+class RoomRegistry {
+public:
+  using Members = std::vector<std::shared_ptr<IClientHandler>>;
+
+  /**
+   * @brief Constructs an empty registry.
+   */
+  RoomRegistry();
+
+  RoomRegistry(const RoomRegistry &) = delete;
+  RoomRegistry &operator=(const RoomRegistry &) = delete;
+
+  /**
+   * @brief Adds a client to a room, creating the room if needed.
+   *
+   * Joining a room the client is already in succeeds without change.
+   *
+   * @param name The room name, see IsValidRoomName.
+   * @param client The joining client.
+   * @return The room ID, or -1 if the name is invalid or the client is in
+   * kMaxRoomsPerClient rooms already.
+   */
+  int Join(const std::string &name, const std::shared_ptr<IClientHandler> &client);
+
+  /**
+   * @brief Removes a client from a room.
+   *
+   * @param room_id The room ID.
+   * @param client_id The leaving client's ID.
+   * @return False if the client was not in the room.
+   */
+  bool Leave(int room_id, int client_id);
+
+  /**
+   * @brief Removes a client from every room it joined.
+   * @param client_id The client's ID.
+   */
+  void LeaveAll(int client_id);
+
+  /**
+   * @brief Gets the members of a room, if a client may post to it.
+   *
+   * @param room_id The room ID.
+   * @param client_id The posting client's ID.
+   * @return The current member array, or nullptr if the room does not exist
+   * or the client is not a member.
+   */
+  std::shared_ptr<const Members> GetMembersFor(int room_id, int client_id) const;
+
+  /**
+   * @brief Gets the name of a room.
+   *
+   * @param room_id The room ID.
+   * @return The name, or an empty string if the room does not exist.
+   */
+  std::string GetRoomName(int room_id) const;
+
+  /**
+   * @brief Gets the number of rooms.
+   * @return The room count.
+   */
+  size_t Size() const;
+
+  static const size_t kMaxRoomsPerClient = 64;
+
+private:
+  /**
+   * @brief One room: its name and the current member array.
+   */
+  struct Room {
+    std::string name;
+    std::shared_ptr<const Members> members; /**< Replaced, never modified, on join and leave. */
+  };
+
+  /**
+   * @brief Removes a client from a room with the lock held.
+   *
+   * @param room_id The room ID.
+   * @param client_id The leaving client's ID.
+   */
+  void RemoveMemberLocked(int room_id, int client_id);
+
+  mutable std::shared_mutex mutex_;                       /**< Guards everything below. */
+  std::unordered_map<int, Room> rooms_;                   /**< Rooms by ID. */
+  std::unordered_map<std::string, int> room_ids_;         /**< Room IDs by name. */
+  std::unordered_map<int, std::vector<int>> memberships_; /**< Joined room IDs by client ID. */
+  int next_room_id_;
+};
+
+#endif // ROOM_REGISTRY_H_
@@ -2,15 +2,63 @@
 #define SERVER_H_
 
 #include <atomic>
+#include <condition_variable>
+#include <cstddef>
 #include <memory>
 #include <mutex>
 #include <string>
+#include <thread>
 #include <vector>
 
+#include "AdmissionController.h"
+#include "ClientRegistry.h"
+#include "ClusterDirectory.h"
+#include "ClusterNode.h"
+#include "CompressionCodecs.h"
+#include "EventLoop.h"
+#include "FanoutPool.h"
 #include "IClientHandler.h"
 #include "IMessageHandler.h"
 #include "ISocket.h"
 #include "Message.h" // Include Message
+#include "MpscQueue.h"
+#include "OutboundQueue.h"
+#include "WorkStealingExecutor.h"
+
+class TlsContext;
+
+/**
+ * @brief Enum selecting how client connections are serviced.
+ */
+enum class ServerMode {
+  THREAD_PER_CLIENT, /**< Each ClientHandler runs its own blocking receive thread. */
+  REACTOR,           /**< Non-blocking sockets multiplexed by a fixed pool of event loops. */
+};
+
+/**
+ * @brief Tunable settings for a Server instance.
+ */
+struct ServerOptions {
+  ServerMode mode = ServerMode::THREAD_PER_CLIENT; /**< Connection servicing model. */
+  size_t io_threads = 0; /**< Number of event loops in REACTOR mode (0 = hardware concurrency). */
+  IoBackend io_backend = IoBackend::POLLER; /**< How the event loops wait in REACTOR mode. */
+  size_t acceptor_threads = 1; /**< Threads accepting connections, each with its own listener where supported. */
+  int listen_backlog = 1024;   /**< Pending connection queue length of each listener. */
+  OutboundQueueOptions outbound_queue; /**< Per-client send queue limits and overflow policy. */
+  SocketOptions socket;                /**< Options for the listening socket and every accepted one. */
+  std::vector<CompressionCodecId> compression_codecs =
+      GetAvailableCompressionCodecs(); /**< Codecs offered to clients; empty disables compression. */
+  int stats_interval_seconds = 0; /**< Period of the metrics dump on stdout (0 = never). */
+  size_t fanout_threads = 0;      /**< Helper threads for splitting large room fan-outs (0 = sender's thread only). */
+  size_t fanout_slice_size = 512; /**< Recipients per parallel fan-out slice. */
+  size_t worker_threads = 0; /**< Threads running the message handlers (0 = on each connection's receiving thread). */
+  size_t worker_backlog_bytes = 4 * 1024 * 1024; /**< Unhandled bytes per connection before its reads pause. */
+  ConnectionTimeouts timeouts; /**< Heartbeats, dead-peer detection and idle buffer trimming. */
+  ConnectionLimits limits;     /**< Maximum frame size and per-client rate limits. */
+  AdmissionOptions admission;  /**< Server-wide pausing of the noisiest readers. */
+  ClusterOptions cluster;      /**< Other nodes of the cluster; none to run on its own. */
+  std::shared_ptr<TlsContext> tls; /**< Server context encrypting client connections; null for plaintext. */
+};
 
 /**
  * @brief The main server class.
@@ -30,9 +78,11 @@ public:
    * @param server_socket The socket to use for listening (dependency injected).
    * @param message_handler The message handler to use for processing client
    * messages (dependency injected).
+   * @param options Server settings such as the connection servicing mode.
    */
   Server(int port, std::unique_ptr<ISocket> server_socket,
-         std::unique_ptr<IMessageHandler> message_handler);
+         std::unique_ptr<IMessageHandler> message_handler,
+         const ServerOptions &options = ServerOptions());
 
   /**
    * @brief Destroys the Server object. Stops the server and cleans up clients.
@@ -41,6 +91,10 @@ public:
 
   /**
    * @brief Starts the server, binds to the port, and begins listening.
+   *
+   * Acceptors beyond the first start accepting on their own threads right
+   * away; the first one runs in AcceptConnections.
+   *
    * @return True if the server starts successfully, false otherwise.
    */
   bool Start();
@@ -53,21 +107,56 @@ public:
   /**
    * @brief Main loop for accepting incoming client connections.
    *
-   * This method runs indefinitely until the server is stopped.
+   * Runs the first acceptor on the calling thread until the server is
+   * stopped. Accepted connections get their ID at once and are registered
+   * by a separate thread, so accepting never waits for handler setup.
    */
   void AcceptConnections();
 
   /**
    * @brief Broadcasts a message to all connected clients except the sender.
    *
+   * The message is serialized once per wire protocol version in use and the
+   * resulting frames are shared by all recipients' send queues. In a cluster
+   * every other node also gets one copy, which it fans out to its clients.
+   *
    * @param message The message to broadcast.
    * @param sender The client handler that sent the message (can be nullptr).
    */
-  void BroadcastMessage(const Message &message, IClientHandler *sender);
+  void BroadcastMessage(const MessageView &message, IClientHandler *sender);
+
+  /**
+   * @brief Broadcasts a message to this node's clients only.
+   *
+   * Used for broadcasts relayed by other cluster nodes.
+   *
+   * @param message The message to broadcast.
+   * @param sender The client handler that sent the message (can be nullptr).
+   */
+  void BroadcastLocally(const MessageView &message, IClientHandler *sender);
+
+  /**
+   * @brief Sends a message to a list of clients, e.g. the members of a room.
+   *
+   * Serializes like BroadcastMessage. Long lists are split into slices that
+   * run in parallel on the fan-out pool (see ServerOptions::fanout_threads);
+   * the call returns once the message is queued for every recipient, so one
+   * sender's messages stay in order.
+   *
+   * @param message The message to send.
+   * @param recipients The clients to send it to.
+   * @param sender The client to skip (can be nullptr).
+   */
+  void SendToClients(const MessageView &message, const std::vector<std::shared_ptr<IClientHandler>> &recipients,
+                     IClientHandler *sender);
 
   /**
    * @brief Removes a client handler from the server's list.
    *
+   * May be called by the handler itself from its own thread; the handler is
+   * kept alive until the next ReapRetiredClients call stops it from another
+   * thread.
+   *
    * @param client_handler The client handler to remove.
    */
   void RemoveClient(IClientHandler *client_handler);
@@ -75,19 +164,117 @@ public:
   /**
    * @brief Gets a client handler by its ID.
    *
+   * The returned reference keeps the handler alive while the caller uses it,
+   * even if the client disconnects in the meantime. For an ID owned by
+   * another cluster node it is a RemoteClientHandler, which relays whatever
+   * is sent to it to that node, whether the client is connected there or not.
+   *
    * @param client_id The ID of the client handler to retrieve.
-   * @return A pointer to the ClientHandler if found, nullptr otherwise.
+   * @return The client handler if found, nullptr otherwise.
+   */
+  std::shared_ptr<IClientHandler> GetClientHandler(int client_id);
+
+  /**
+   * @brief Checks whether clients may pick a codec for their connection.
+   *
+   * @param codec The codec a client asked for.
+   * @return True if the server offers the codec.
+   */
+  bool IsCompressionCodecOffered(CompressionCodecId codec) const;
+
+  /**
+   * @brief Formats the process metrics and the busiest connections.
+   *
+   * @return Human-readable report, one metric per line.
    */
-  IClientHandler *GetClientHandler(int client_id);
+  std::string FormatStats() const;
 
 private:
+  /**
+   * @brief A connection accepted but not registered yet.
+   */
+  struct PendingConnection {
+    int client_id;                   /**< ID allocated at accept time. */
+    std::unique_ptr<ISocket> socket; /**< The accepted socket. */
+  };
+
+  /**
+   * @brief Binds a listening socket to the server port and starts listening.
+   *
+   * @param listener The socket to set up.
+   * @return True if the socket is listening.
+   */
+  bool OpenListener(ISocket &listener);
+
+  /**
+   * @brief Accepts connections on one listener until the server stops.
+   *
+   * @param listener The listening socket.
+   */
+  void AcceptLoop(ISocket *listener);
+
+  /**
+   * @brief The main loop for the registration thread.
+   *
+   * Registers accepted connections and reaps removed clients until the
+   * server stops.
+   */
+  void RegisterConnections();
+
+  /**
+   * @brief Creates, announces and starts the handler for an accepted connection.
+   *
+   * @param connection The accepted connection.
+   */
+  void RegisterClient(PendingConnection connection);
+
+  /**
+   * @brief Gets every listening socket, the shared one first.
+   * @return The listeners.
+   */
+  std::vector<ISocket *> GetListeners() const;
+
+  /**
+   * @brief Stops and destroys client handlers removed by RemoveClient.
+   */
+  void ReapRetiredClients();
+
+  /**
+   * @brief The main loop for the stats thread: dumps FormatStats periodically.
+   */
+  void StatsLoop();
+
+  /**
+   * @brief Picks the event loop for a new connection in REACTOR mode.
+   *
+   * @return The next event loop in round-robin order, or nullptr in
+   * THREAD_PER_CLIENT mode.
+   */
+  EventLoop *NextEventLoop();
+
   int port_;
+  ServerOptions options_;
+  std::shared_ptr<const ConnectionLimits> limits_; /**< options_.limits, shared with the client handlers. */
   std::unique_ptr<ISocket> server_socket_;
-  std::vector<std::unique_ptr<IClientHandler>> clients_;
-  std::mutex clients_mutex_;
+  std::vector<std::unique_ptr<ISocket>> extra_listeners_; /**< SO_REUSEPORT listeners of acceptors 2..N. */
+  std::vector<std::thread> acceptor_threads_;             /**< Acceptors 2..N; the first runs in AcceptConnections. */
+  MpscQueue<PendingConnection> pending_connections_;      /**< Accepted, waiting for the registration thread. */
+  std::thread registration_thread_;                       /**< Runs RegisterConnections. */
+  ClientRegistry clients_;                                       /**< Connected clients, indexed by ID. */
+  std::vector<std::shared_ptr<IClientHandler>> retired_clients_; /**< Removed but not yet stopped. */
+  std::mutex retired_mutex_;                                     /**< Protects retired_clients_. */
+  std::vector<std::unique_ptr<EventLoop>> event_loops_; /**< I/O threads in REACTOR mode. */
+  std::unique_ptr<FanoutPool> fanout_pool_;             /**< Splits large fan-outs, if fanout_threads is set. */
+  std::unique_ptr<WorkStealingExecutor> worker_pool_;   /**< Runs the message handlers, if worker_threads is set. */
+  std::unique_ptr<AdmissionController> admission_;      /**< Samples the clients, if admission is enabled. */
+  ClusterDirectory directory_;                          /**< Allocates client IDs; shared by all acceptors. */
+  std::unique_ptr<ClusterNode> cluster_;                /**< Links to the other nodes, if there are any. */
+  size_t next_event_loop_;
   std::unique_ptr<IMessageHandler> message_handler_;
   std::atomic<bool> running_;
-  int next_client_id_;
+  std::thread stats_thread_;         /**< Runs StatsLoop if stats_interval_seconds is set. */
+  std::mutex stats_mutex_;           /**< Guards the stats thread's sleep. */
+  std::condition_variable stats_cv_; /**< Wakes the stats thread on Stop. */
 };
 
 #endif // SERVER_H_
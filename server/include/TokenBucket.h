@@ -0,0 +1,65 @@
+#ifndef TOKEN_BUCKET_H_
+#define TOKEN_BUCKET_H_
+
+#include <cstdint>
+
+/**
+ * @brief A sustained rate with a burst allowance, for a TokenBucket.
+ */
+struct RateLimit {
+  double rate = 0;  /**< Tokens added per second; 0 means unlimited. */
+  double burst = 0; /**< Bucket capacity; 0 means one second's worth of rate. */
+};
+
+/**
+ * @brief Token bucket that runs into debt instead of refusing.
+ *
+ * Consume always takes the tokens, so a single item larger than the burst is
+ * still admitted, and reports how long the caller has to wait until the debt
+ * is paid off. A reader that stops reading for that long keeps its peer at
+ * the configured rate on average without ever dropping what was already
+ * received, and the excess waits in the peer's own socket buffers.
+ *
+ * The bucket starts full. Not thread-safe; each owner has its own.
+ */
+class TokenBucket {
+public:
+  /**
+   * @brief Constructs a full bucket.
+   * @param limit The rate and burst; a zero rate makes the bucket unlimited.
+   */
+  explicit TokenBucket(const RateLimit &limit = RateLimit());
+
+  /**
+   * @brief Checks whether the bucket limits anything at all.
+   * @return False for an unlimited bucket, whose Consume always returns 0.
+   */
+  bool IsLimited() const;
+
+  /**
+   * @brief Checks whether the bucket has refilled to its burst.
+   *
+   * A full bucket is indistinguishable from a newly constructed one.
+   *
+   * @param now_ns The current Metrics::NowNanoseconds time.
+   * @return True if the bucket is full or unlimited.
+   */
+  bool IsFull(uint64_t now_ns) const;
+
+  /**
+   * @brief Takes tokens, going into debt if the bucket holds too few.
+   *
+   * @param tokens Number of tokens to take (e.g. bytes or messages).
+   * @param now_ns The current Metrics::NowNanoseconds time.
+   * @return Nanoseconds until the bucket is out of debt, 0 if it is not in debt.
+   */
+  uint64_t Consume(double tokens, uint64_t now_ns);
+
+private:
+  double rate_per_ns_;
+  double burst_;
+  double tokens_;           /**< Current balance; negative while in debt. */
+  uint64_t last_refill_ns_; /**< Time the balance was last brought up to date. */
+};
+
+#endif // TOKEN_BUCKET_H_
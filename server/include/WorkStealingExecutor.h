@@ -0,0 +1,97 @@
+#ifndef WORK_STEALING_EXECUTOR_H_
+#define WORK_STEALING_EXECUTOR_H_
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/**
+ * @brief Fixed pool of threads running submitted tasks, with one queue per thread.
+ *
+ * Tasks submitted from outside the pool are dealt round-robin over the
+ * workers' queues; tasks submitted by a worker go to its own queue. A worker
+ * takes from the front of its queue and, once that is empty, steals from the
+ * back of the others', so a burst landing on one queue still spreads over
+ * every core. Tasks are not ordered with respect to each other; see
+ * MessageStrand for serial execution on top of the pool.
+ */
+class WorkStealingExecutor {
+public:
+  using Task = std::function<void()>;
+
+  /**
+   * @brief Constructs the executor and starts its threads.
+   * @param thread_count Number of worker threads (at least 1).
+   */
+  explicit WorkStealingExecutor(size_t thread_count);
+
+  /**
+   * @brief Destroys the executor. Runs the remaining tasks, then joins the threads.
+   */
+  ~WorkStealingExecutor();
+
+  WorkStealingExecutor(const WorkStealingExecutor &) = delete;
+  WorkStealingExecutor &operator=(const WorkStealingExecutor &) = delete;
+
+  /**
+   * @brief Queues a task for one of the workers.
+   *
+   * May be called from any thread. Once Shutdown has started, tasks
+   * submitted from outside the pool run on the calling thread instead.
+   *
+   * @param task The task to run.
+   */
+  void Submit(Task task);
+
+  /**
+   * @brief Runs the remaining tasks and joins the threads. Safe to call more than once.
+   */
+  void Shutdown();
+
+  /**
+   * @brief Gets the number of worker threads.
+   * @return The thread count.
+   */
+  size_t GetThreadCount() const;
+
+private:
+  /**
+   * @brief One worker's queue and thread.
+   */
+  struct Worker {
+    std::mutex mutex;
+    std::deque<Task> tasks; /**< Own tasks at the front, stolen from the back. */
+    std::thread thread;
+  };
+
+  /**
+   * @brief The loop executed by each worker thread.
+   * @param index Index of the worker in workers_.
+   */
+  void WorkerLoop(size_t index);
+
+  /**
+   * @brief Takes a task from a worker's own queue, or steals one from another's.
+   *
+   * @param index Index of the worker looking for work.
+   * @param task Receives the task.
+   * @return False if every queue was empty.
+   */
+  bool TakeTask(size_t index, Task &task);
+
+  std::vector<std::unique_ptr<Worker>> workers_;
+  std::atomic<size_t> next_worker_; /**< Round-robin position for outside submissions. */
+  std::atomic<size_t> pending_;     /**< Tasks queued but not taken yet. */
+  std::atomic<size_t> sleepers_;    /**< Workers waiting on idle_cv_, so Submit can skip the wakeup. */
+  std::mutex idle_mutex_;
+  std::condition_variable idle_cv_; /**< Wakes idle workers on new tasks or shutdown. */
+  std::atomic<bool> stopping_;
+};
+
+#endif // WORK_STEALING_EXECUTOR_H_
@@ -0,0 +1,180 @@
+#ifndef WRITE_BEHIND_FILE_H_
+#define WRITE_BEHIND_FILE_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+
+#include "BufferPool.h"
+#include "DiskWriter.h"
+#include "EventLoop.h"
+
+/**
+ * @brief A file written sequentially by a network thread and flushed to disk
+ * by a DiskWriter.
+ *
+ * Append only copies the data into a staging buffer. Whenever the buffer
+ * holds kWriteBatchSize bytes it is handed to the DiskWriter as one
+ * positional write (pwrite, or WriteFile with an offset on Windows), so every
+ * write but the last is a full batch starting at a batch-aligned offset.
+ * Batches are independent and may be written concurrently by different I/O
+ * threads.
+ *
+ * Given an EventLoop that supports file I/O, the batches are written by that
+ * loop's io_uring instead: each is one write request completing on the loop
+ * thread, so the disk costs no pool thread and no blocking system call.
+ *
+ * Progress and completion are reported through callbacks invoked on an I/O
+ * thread or the loop thread (or, for a file with no pending writes, on the
+ * thread calling Finish). Always created through Open, since pending writes
+ * keep the object alive through shared ownership.
+ */
+class WriteBehindFile : public std::enable_shared_from_this<WriteBehindFile> {
+public:
+  /**
+   * @brief Callback reporting the number of bytes written to disk so far.
+   */
+  using ProgressCallback = std::function<void(size_t written_bytes)>;
+
+  /**
+   * @brief Callback invoked once after Finish, when all data is written and
+   * the file is closed.
+   */
+  using CompletionCallback = std::function<void(bool success)>;
+
+  /**
+   * @brief Creates (or truncates) a file for writing, or reopens one to continue it.
+   *
+   * With a non-zero start_offset the existing contents are kept and appends
+   * continue at that offset, which also counts as already written.
+   *
+   * @param file_path The path of the file.
+   * @param disk_writer The pool performing the writes; must outlive the file's pending writes.
+   * @param on_progress Optional callback invoked after each completed batch.
+   * @param start_offset Offset of the first appended byte.
+   * @param event_loop Optional loop writing the batches on its ring instead of disk_writer, used if it
+   * supports file I/O; must outlive the file's pending writes.
+   * @return The file, or nullptr if it could not be opened.
+   */
+  static std::shared_ptr<WriteBehindFile> Open(const std::string &file_path, DiskWriter &disk_writer,
+                                               ProgressCallback on_progress = nullptr, uint64_t start_offset = 0,
+                                               EventLoop *event_loop = nullptr);
+
+  /**
+   * @brief Destroys the WriteBehindFile. Closes the file if still open.
+   */
+  ~WriteBehindFile();
+
+  WriteBehindFile(const WriteBehindFile &) = delete;
+  WriteBehindFile &operator=(const WriteBehindFile &) = delete;
+
+  /**
+   * @brief Appends data to the end of the file.
+   *
+   * @param data The bytes to append (copied).
+   * @param size Number of bytes.
+   * @return False if an earlier write failed or Finish was already called.
+   */
+  bool Append(const char *data, size_t size);
+
+  /**
+   * @brief Flushes the staged data and closes the file once every write completed.
+   *
+   * @param on_complete Callback receiving whether all writes succeeded.
+   */
+  void Finish(CompletionCallback on_complete);
+
+  /**
+   * @brief Gets the number of bytes already written to disk.
+   * @return The written byte count.
+   */
+  size_t GetWrittenBytes() const;
+
+  static const size_t kWriteBatchSize = 1024 * 1024;
+
+private:
+  /**
+   * @brief Constructs a WriteBehindFile around an open native file.
+   * @param disk_writer The pool performing the writes.
+   * @param on_progress Optional progress callback.
+   */
+  WriteBehindFile(DiskWriter &disk_writer, ProgressCallback on_progress);
+
+  /**
+   * @brief Turns the staging buffer into a write job. Caller holds mutex_.
+   *
+   * The job is submitted by the caller after unlocking, so that a DiskWriter
+   * running it inline cannot deadlock on mutex_.
+   *
+   * @return The job writing the staged bytes.
+   */
+  std::function<void()> TakeStagedLocked();
+
+  /**
+   * @brief Starts a job from TakeStagedLocked: on the ring at once, or on the DiskWriter.
+   * @param job The job.
+   */
+  void SubmitJob(std::function<void()> job);
+
+  /**
+   * @brief Writes one batch at its offset. Runs on an I/O thread.
+   *
+   * @param batch The bytes to write.
+   * @param offset File offset of the first byte.
+   */
+  void WriteBatch(const PooledBuffer &batch, uint64_t offset);
+
+  /**
+   * @brief Writes the rest of a batch through event_loop_, continuing after short writes.
+   *
+   * @param batch The bytes to write; kept alive until the write completed.
+   * @param offset File offset of the batch's first byte.
+   * @param done Bytes of the batch already written.
+   */
+  void WriteBatchOnLoop(const std::shared_ptr<PooledBuffer> &batch, uint64_t offset, size_t done);
+
+  /**
+   * @brief Accounts for a finished batch and reports progress and completion.
+   *
+   * @param size The batch's size.
+   * @param success Whether all of it was written.
+   */
+  void CompleteBatch(size_t size, bool success);
+
+  /**
+   * @brief Closes the file and reports completion if Finish was called and
+   * nothing is pending. Caller holds mutex_; returns the callback to invoke
+   * after unlocking, if any.
+   *
+   * @return The completion callback to run, or nullptr.
+   */
+  CompletionCallback TakeCompletionLocked();
+
+  /**
+   * @brief Closes the native file handle. Caller holds mutex_.
+   */
+  void CloseLocked();
+
+  DiskWriter &disk_writer_;
+  EventLoop *event_loop_; /**< Writes the batches instead of disk_writer_, if set. */
+  ProgressCallback on_progress_;
+  CompletionCallback on_complete_;
+
+  mutable std::mutex mutex_;
+#ifdef _WIN32
+  void *file_handle_; /**< Windows HANDLE of the open file. */
+#else
+  int file_fd_; /**< Descriptor of the open file, or -1. */
+#endif
+  PooledBuffer staging_;  /**< Appended bytes not yet submitted. */
+  uint64_t next_offset_;  /**< File offset of staging_'s first byte. */
+  size_t written_bytes_;  /**< Bytes whose writes completed (batches may finish out of order). */
+  size_t pending_writes_; /**< Batches submitted but not yet written. */
+  bool failed_;           /**< A write failed; the file is incomplete. */
+  bool finishing_;        /**< Finish was called. */
+};
+
+#endif // WRITE_BEHIND_FILE_H_
@@ -1,6 +1,7 @@
 #include "BroadcastMessageHandler.h"
 #include "CompositeMessageHandler.h" 
 #include "FileTransferHandler.h"     
+#include "RoomMessageHandler.h"
 #include "Server.h"
 
 #ifdef _WIN32
@@ -9,10 +10,73 @@
 #include "PosixSocket.h"
 #endif
 
+#include <algorithm>
 #include <iostream>
 #include <memory> 
 #include <string> 
 
+#include "Metrics.h"
+
+#ifdef CHAT_HAVE_OPENSSL
+#include "TlsContext.h"
+#endif
+
+namespace {
+
+/**
+ * @brief Parses a rate limit given as RATE or RATE:BURST.
+ *
+ * @param text The command-line value.
+ * @return The rate limit.
+ */
+RateLimit ParseRateLimit(const std::string &text) {
+  RateLimit limit;
+  size_t colon = text.find(':');
+  limit.rate = std::stod(text.substr(0, colon));
+  if (colon != std::string::npos) {
+    limit.burst = std::stod(text.substr(colon + 1));
+  }
+  return limit;
+}
+
+/**
+ * @brief Looks a message type up by the name it is reported under in the stats.
+ *
+ * @param name The name, e.g. "broadcast_message".
+ * @param type Receives the message type.
+ * @return False if no message type has that name.
+ */
+bool ParseMessageTypeName(const std::string &name, MessageType &type) {
+  for (size_t i = 0; i < kMessageTypeCount; ++i) {
+    if (name == Metrics::GetMessageTypeName(static_cast<MessageType>(i))) {
+      type = static_cast<MessageType>(i);
+      return true;
+    }
+  }
+  return false;
+}
+
+/**
+ * @brief Parses a cluster peer given as ID=HOST:PORT.
+ *
+ * @param text The command-line value.
+ * @param peer Receives the peer.
+ * @return False if the value is malformed.
+ */
+bool ParseClusterPeer(const std::string &text, ClusterPeer &peer) {
+  size_t equals = text.find('=');
+  size_t colon = text.rfind(':');
+  if (equals == std::string::npos || colon == std::string::npos || colon < equals) {
+    return false;
+  }
+  peer.node_id = std::stoi(text.substr(0, equals));
+  peer.host = text.substr(equals + 1, colon - equals - 1);
+  peer.port = std::stoi(text.substr(colon + 1));
+  return !peer.host.empty() && peer.port > 0 && peer.port <= 65535;
+}
+
+} // namespace
+
 /**
  * @brief Main entry point for the server application.
  * @param argc The number of command-line arguments.
@@ -20,8 +84,18 @@
  * @return 0 on success, 1 on error.
  */
 int main(int argc, char *argv[]) {
-  if (argc != 2) {
-    std::cerr << "Usage: " << argv[0] << " <port>" << std::endl;
+  if (argc < 2) {
+    std::cerr << "Usage: " << argv[0] << " <port> [--mode thread|reactor] [--io-threads N] [--acceptors N]"
+              << " [--backlog N] [--io-backend poller|io_uring] [--max-queued-bytes N]"
+              << " [--overflow drop-oldest|disconnect] [--disk-threads N]"
+              << " [--compression none|<codec>[,<codec>...]] [--no-nodelay] [--keepalive] [--sndbuf N] [--rcvbuf N]"
+              << " [--stats-interval SECONDS] [--fanout-threads N] [--fanout-slice N]"
+              << " [--worker-threads N] [--worker-backlog N] [--heartbeat-interval MS] [--read-timeout MS]"
+              << " [--write-timeout MS] [--idle-timeout MS] [--trim-after MS] [--max-frame-size N]"
+              << " [--rate-limit-bytes RATE[:BURST]] [--rate-limit-messages RATE[:BURST]]"
+              << " [--rate-limit <type>=RATE[:BURST]] [--admission-limit N]"
+              << " [--cluster-node ID --cluster-port PORT --cluster-peer ID=HOST:PORT...]"
+              << " [--tls-cert FILE --tls-key FILE] [--tls-tickets N] [--no-ktls]" << std::endl;
     return 1;
   }
 
@@ -31,6 +105,161 @@ int main(int argc, char *argv[]) {
     return 1;
   }
 
+  // Parse optional server settings
+  ServerOptions options;
+  size_t disk_threads = DiskWriter::kDefaultThreadCount;
+  std::string tls_certificate_file;
+  std::string tls_private_key_file;
+  int tls_session_tickets = 2;
+  bool tls_kernel_offload = true;
+  for (int i = 2; i < argc; ++i) {
+    std::string arg = argv[i];
+    if (arg == "--mode" && i + 1 < argc) {
+      std::string mode = argv[++i];
+      if (mode == "thread") {
+        options.mode = ServerMode::THREAD_PER_CLIENT;
+      } else if (mode == "reactor") {
+        options.mode = ServerMode::REACTOR;
+      } else {
+        std::cerr << "Unknown server mode: " << mode << std::endl;
+        return 1;
+      }
+    } else if (arg == "--io-threads" && i + 1 < argc) {
+      options.io_threads = std::stoul(argv[++i]);
+    } else if (arg == "--io-backend" && i + 1 < argc) {
+      std::string backend = argv[++i];
+      if (backend == "poller") {
+        options.io_backend = IoBackend::POLLER;
+      } else if (backend == "io_uring") {
+        options.io_backend = IoBackend::IO_URING;
+      } else {
+        std::cerr << "Unknown I/O backend: " << backend << std::endl;
+        return 1;
+      }
+    } else if (arg == "--acceptors" && i + 1 < argc) {
+      options.acceptor_threads = std::stoul(argv[++i]);
+    } else if (arg == "--backlog" && i + 1 < argc) {
+      options.listen_backlog = std::stoi(argv[++i]);
+    } else if (arg == "--max-queued-bytes" && i + 1 < argc) {
+      options.outbound_queue.max_queued_bytes = std::stoul(argv[++i]);
+    } else if (arg == "--overflow" && i + 1 < argc) {
+      std::string policy = argv[++i];
+      if (policy == "drop-oldest") {
+        options.outbound_queue.overflow_policy = OverflowPolicy::DROP_OLDEST;
+      } else if (policy == "disconnect") {
+        options.outbound_queue.overflow_policy = OverflowPolicy::DISCONNECT;
+      } else {
+        std::cerr << "Unknown overflow policy: " << policy << std::endl;
+        return 1;
+      }
+    } else if (arg == "--disk-threads" && i + 1 < argc) {
+      disk_threads = std::stoul(argv[++i]);
+    } else if (arg == "--no-nodelay") {
+      options.socket.no_delay = false;
+    } else if (arg == "--keepalive") {
+      options.socket.keep_alive = true;
+    } else if (arg == "--sndbuf" && i + 1 < argc) {
+      options.socket.send_buffer_size = std::stoi(argv[++i]);
+    } else if (arg == "--rcvbuf" && i + 1 < argc) {
+      options.socket.receive_buffer_size = std::stoi(argv[++i]);
+    } else if (arg == "--stats-interval" && i + 1 < argc) {
+      options.stats_interval_seconds = std::stoi(argv[++i]);
+    } else if (arg == "--fanout-threads" && i + 1 < argc) {
+      options.fanout_threads = std::stoul(argv[++i]);
+    } else if (arg == "--fanout-slice" && i + 1 < argc) {
+      options.fanout_slice_size = std::stoul(argv[++i]);
+    } else if (arg == "--worker-threads" && i + 1 < argc) {
+      options.worker_threads = std::stoul(argv[++i]);
+    } else if (arg == "--worker-backlog" && i + 1 < argc) {
+      options.worker_backlog_bytes = std::stoul(argv[++i]);
+    } else if (arg == "--heartbeat-interval" && i + 1 < argc) {
+      options.timeouts.heartbeat_interval_ms = std::stoi(argv[++i]);
+    } else if (arg == "--read-timeout" && i + 1 < argc) {
+      options.timeouts.read_timeout_ms = std::stoi(argv[++i]);
+    } else if (arg == "--write-timeout" && i + 1 < argc) {
+      options.timeouts.write_timeout_ms = std::stoi(argv[++i]);
+    } else if (arg == "--idle-timeout" && i + 1 < argc) {
+      options.timeouts.idle_timeout_ms = std::stoi(argv[++i]);
+    } else if (arg == "--trim-after" && i + 1 < argc) {
+      options.timeouts.trim_after_ms = std::stoi(argv[++i]);
+    } else if (arg == "--max-frame-size" && i + 1 < argc) {
+      options.limits.max_frame_size = std::stoul(argv[++i]);
+    } else if (arg == "--rate-limit-bytes" && i + 1 < argc) {
+      options.limits.bytes = ParseRateLimit(argv[++i]);
+    } else if (arg == "--rate-limit-messages" && i + 1 < argc) {
+      options.limits.messages = ParseRateLimit(argv[++i]);
+    } else if (arg == "--rate-limit" && i + 1 < argc) {
+      // Per message type, named as in the stats (e.g. broadcast_message=100:200)
+      std::string type_limit = argv[++i];
+      size_t equals = type_limit.find('=');
+      MessageType type = MessageType::UNKNOWN;
+      if (equals == std::string::npos || !ParseMessageTypeName(type_limit.substr(0, equals), type)) {
+        std::cerr << "Invalid per-type rate limit: " << type_limit << std::endl;
+        return 1;
+      }
+      options.limits.message_types[static_cast<size_t>(type)] = ParseRateLimit(type_limit.substr(equals + 1));
+    } else if (arg == "--admission-limit" && i + 1 < argc) {
+      options.admission.max_queued_bytes = std::stoul(argv[++i]);
+    } else if (arg == "--cluster-node" && i + 1 < argc) {
+      options.cluster.node_id = std::stoi(argv[++i]);
+    } else if (arg == "--cluster-port" && i + 1 < argc) {
+      options.cluster.port = std::stoi(argv[++i]);
+    } else if (arg == "--cluster-peer" && i + 1 < argc) {
+      // Once per other node; every node must list all the others
+      ClusterPeer peer;
+      if (!ParseClusterPeer(argv[++i], peer)) {
+        std::cerr << "Invalid cluster peer: " << argv[i] << std::endl;
+        return 1;
+      }
+      options.cluster.peers.push_back(peer);
+    } else if (arg == "--tls-cert" && i + 1 < argc) {
+      tls_certificate_file = argv[++i];
+    } else if (arg == "--tls-key" && i + 1 < argc) {
+      tls_private_key_file = argv[++i];
+    } else if (arg == "--tls-tickets" && i + 1 < argc) {
+      tls_session_tickets = std::stoi(argv[++i]);
+    } else if (arg == "--no-ktls") {
+      tls_kernel_offload = false;
+    } else if (arg == "--compression" && i + 1 < argc) {
+      // Codecs to offer, in order of preference
+      std::string codec_list = argv[++i];
+      options.compression_codecs.clear();
+      size_t start = 0;
+      while (codec_list != "none" && start <= codec_list.size()) {
+        size_t end = std::min(codec_list.find(',', start), codec_list.size());
+        std::string codec_name = codec_list.substr(start, end - start);
+        const ICompressionCodec *codec = FindCompressionCodec(codec_name);
+        if (!codec) {
+          std::cerr << "Compression codec not available in this build: " << codec_name << std::endl;
+          return 1;
+        }
+        options.compression_codecs.push_back(codec->GetId());
+        start = end + 1;
+      }
+    } else {
+      std::cerr << "Unknown argument: " << arg << std::endl;
+      return 1;
+    }
+  }
+
+  if (!tls_certificate_file.empty() || !tls_private_key_file.empty()) {
+#ifdef CHAT_HAVE_OPENSSL
+    TlsOptions tls_options;
+    tls_options.certificate_file = tls_certificate_file;
+    tls_options.private_key_file = tls_private_key_file.empty() ? tls_certificate_file : tls_private_key_file;
+    tls_options.session_tickets = tls_session_tickets;
+    tls_options.kernel_offload = tls_kernel_offload;
+    options.tls = TlsContext::Create(TlsRole::SERVER, tls_options);
+    if (!options.tls) {
+      std::cerr << "Failed to set up TLS." << std::endl;
+      return 1;
+    }
+#else
+    std::cerr << "TLS is not available in this build." << std::endl;
+    return 1;
+#endif
+  }
+
   // --- Dependency Creation (Composition Root) ---
 
   // Create the concrete ISocket implementation based on the platform
@@ -51,12 +280,13 @@ int main(int argc, char *argv[]) {
 
   // Add specific message handlers to the composite
   composite_message_handler->AddHandler(std::make_unique<BroadcastMessageHandler>());
-  composite_message_handler->AddHandler(std::make_unique<FileTransferHandler>());
+  composite_message_handler->AddHandler(std::make_unique<FileTransferHandler>(disk_threads));
+  composite_message_handler->AddHandler(std::make_unique<RoomMessageHandler>());
   // Add other message handlers here as needed
 
   // --- Dependency Injection ---
   // Create the server instance, injecting the dependencies
-  Server server_instance(port, std::move(server_socket), std::move(composite_message_handler));
+  Server server_instance(port, std::move(server_socket), std::move(composite_message_handler), options);
   // ---------------------------------------------
 
   // Start the server and accept connections
@@ -0,0 +1,138 @@
+#include "AdmissionController.h"
+
+#include <algorithm>
+#include <chrono>
+
+#include "Logger.h"
+#include "Metrics.h"
+
+/**
+ * @brief Constructs a stopped controller.
+ *
+ * @param clients The server's clients; must outlive the controller.
+ * @param options The limit and sampling interval.
+ */
+AdmissionController::AdmissionController(const ClientRegistry &clients, const AdmissionOptions &options)
+    : clients_(clients), options_(options), overloaded_(false), stop_requested_(false) {
+  options_.sample_interval_ms = std::max(1, options_.sample_interval_ms);
+}
+
+/**
+ * @brief Stops the sampling thread.
+ */
+AdmissionController::~AdmissionController() {
+  Stop();
+}
+
+/**
+ * @brief Starts the sampling thread.
+ */
+void AdmissionController::Start() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (!thread_.joinable()) {
+    stop_requested_ = false;
+    thread_ = std::thread(&AdmissionController::Run, this);
+  }
+}
+
+/**
+ * @brief Stops the sampling thread and resumes every paused client.
+ */
+void AdmissionController::Stop() {
+  {
+    // Under the lock, so the thread cannot miss the wakeup
+    std::lock_guard<std::mutex> lock(mutex_);
+    stop_requested_ = true;
+  }
+  cv_.notify_all();
+  if (thread_.joinable()) {
+    thread_.join();
+  }
+  ResumeAll();
+}
+
+/**
+ * @brief The sampling thread's loop.
+ */
+void AdmissionController::Run() {
+  std::unique_lock<std::mutex> lock(mutex_);
+  while (!stop_requested_) {
+    if (cv_.wait_for(lock, std::chrono::milliseconds(options_.sample_interval_ms),
+                     [this] { return stop_requested_; })) {
+      break;
+    }
+    lock.unlock();
+    Sample();
+    lock.lock();
+  }
+}
+
+/**
+ * @brief Samples every client and pauses or resumes readers as needed.
+ */
+void AdmissionController::Sample() {
+  size_t queued_bytes = 0;
+  uint64_t received_bytes = 0;
+  next_received_.clear();
+  senders_.clear();
+  clients_.ForEach([&](const std::shared_ptr<IClientHandler> &client) {
+    ConnectionStats stats = client->GetStats();
+    queued_bytes += stats.queued_bytes;
+    next_received_.emplace_back(client.get(), stats.bytes_received);
+
+    // A client new since the last sample counts from now on
+    auto previous = std::lower_bound(received_.begin(), received_.end(), ReceivedCount(client.get(), 0));
+    if (previous != received_.end() && previous->first == client.get() && stats.bytes_received > previous->second) {
+      uint64_t bytes = stats.bytes_received - previous->second;
+      senders_.push_back(Sender{client, bytes});
+      received_bytes += bytes;
+    }
+  });
+  std::sort(next_received_.begin(), next_received_.end());
+  received_.swap(next_received_);
+
+  if (!overloaded_) {
+    if (queued_bytes <= options_.max_queued_bytes) {
+      senders_.clear();
+      return;
+    }
+    overloaded_ = true;
+    CHAT_LOG_WARNING("Admission control: " << queued_bytes << " bytes queued for clients, pausing the noisiest "
+                     << "senders.");
+  } else if (queued_bytes <= options_.max_queued_bytes / 2) {
+    overloaded_ = false;
+    ResumeAll();
+    CHAT_LOG_INFO("Admission control: " << queued_bytes << " bytes queued for clients, resuming all senders.");
+    senders_.clear();
+    return;
+  } else if (queued_bytes <= options_.max_queued_bytes) {
+    senders_.clear();
+    return; // Draining: keep the current pauses
+  }
+
+  // Paused clients send nothing, so these are all still being read
+  std::sort(senders_.begin(), senders_.end(), [](const Sender &a, const Sender &b) { return a.bytes > b.bytes; });
+  uint64_t paused_bytes = 0;
+  for (const Sender &sender : senders_) {
+    if (paused_bytes * 2 >= received_bytes) {
+      break;
+    }
+    sender.client->SetAdmissionPaused(true);
+    paused_.push_back(sender.client);
+    paused_bytes += sender.bytes;
+    Metrics::Add(MetricCounter::ADMISSION_PAUSES);
+  }
+  senders_.clear(); // Do not keep the clients alive until the next sample
+}
+
+/**
+ * @brief Resumes every client paused so far.
+ */
+void AdmissionController::ResumeAll() {
+  for (const std::weak_ptr<IClientHandler> &paused : paused_) {
+    if (std::shared_ptr<IClientHandler> client = paused.lock()) {
+      client->SetAdmissionPaused(false);
+    }
+  }
+  paused_.clear();
+}
@@ -1,28 +1,26 @@
 #include "BroadcastMessageHandler.h"
 #include "IClientHandler.h" // Include IClientHandler.h
+#include "Logger.h"
 #include "Server.h"         // Include Server.h to use Server methods
 
-#include <iostream>
 #include <string> // For std::string constructor from char vector
 
 /**
  * @brief Handles an incoming message by broadcasting it to all clients.
- * @param message The deserialized Message object received.
+ * @param message View of the received message.
  * @param sender The client handler that received the message.
  * @param server A pointer to the Server instance for broadcasting.
  * @return True if the message was handled successfully, false otherwise.
  */
-bool BroadcastMessageHandler::HandleMessage(const Message &message,
+bool BroadcastMessageHandler::HandleMessage(const MessageView &message,
                                             IClientHandler *sender,
                                             Server *server) {
   if (server == nullptr) {
-    std::cerr << "Error: Server pointer is null in BroadcastMessageHandler."
-              << std::endl;
+    CHAT_LOG_ERROR("Error: Server pointer is null in BroadcastMessageHandler.");
     return false;
   }
   if (sender == nullptr) {
-    std::cerr << "Error: Sender pointer is null in BroadcastMessageHandler."
-              << std::endl;
+    CHAT_LOG_ERROR("Error: Sender pointer is null in BroadcastMessageHandler.");
     return false;
   }
 
@@ -30,14 +28,8 @@ bool BroadcastMessageHandler::HandleMessage(const Message &message,
     return false;
   }
 
-  // Assuming the payload is a simple chat message string
-  // Convert payload (vector<char>) to string
-  std::string chat_message(message.payload.begin(), message.payload.end());
-
-  std::string broadcast_message =
-      "Client " + std::to_string(sender->GetClientId()) + ": " + chat_message;
-
-  std::cout << "Broadcasting: " << broadcast_message << std::endl;
+  // Build the "Client <id>: <text>" payload directly in a pooled buffer
+  std::string prefix = "Client " + std::to_string(sender->GetClientId()) + ": ";
 
   // Broadcast the message to all connected clients
   // Need to create a new Message object for broadcasting
@@ -45,11 +37,22 @@ bool BroadcastMessageHandler::HandleMessage(const Message &message,
   broadcast_msg.header.type = MessageType::BROADCAST_MESSAGE;
   broadcast_msg.header.sender_id = sender->GetClientId();
   broadcast_msg.header.recipient_id = -1;
-  broadcast_msg.payload.assign(broadcast_message.begin(),
-                               broadcast_message.end());
+  broadcast_msg.payload.reserve(prefix.size() + message.payload.size());
+  broadcast_msg.payload.assign(prefix.begin(), prefix.end());
+  broadcast_msg.payload.insert(broadcast_msg.payload.end(),
+                               message.payload.begin(), message.payload.end());
   broadcast_msg.header.payload_size = broadcast_msg.payload.size();
 
   server->BroadcastMessage(broadcast_msg, sender);
 
   return true;
 }
+
+/**
+ * @brief Gets the message types this handler consumes.
+ *
+ * @return BROADCAST_MESSAGE.
+ */
+std::vector<MessageType> BroadcastMessageHandler::GetHandledTypes() const {
+  return {MessageType::BROADCAST_MESSAGE};
+}
@@ -1,8 +1,34 @@
 #include "ClientHandler.h"
 
-#include <iostream>
+#include <algorithm>
+#include <chrono>
+#include <cstring> // For strerror
 #include <vector>
 
+#include "Logger.h"
+#include "Metrics.h"
+
+// Maximum number of reads per readiness callback, so one busy client cannot
+// starve the other connections sharing the event loop
+const int kMaxReadsPerEvent = 16;
+
+// Maximum number of gathered writes per writability callback, for the same
+// reason
+const int kMaxWritesPerEvent = 16;
+
+const uint64_t kNanosecondsPerMillisecond = 1000000;
+
+// How often a client paused by admission control checks whether it may read
+// again
+const uint64_t kAdmissionRecheckNs = 100 * kNanosecondsPerMillisecond;
+
+// How often a reactor connection paused by a full strand checks it, should the
+// strand's space callback be missed
+const uint64_t kBacklogRecheckNs = 100 * kNanosecondsPerMillisecond;
+
+// Longest sleep of a paused receive thread, so Stop need not wait out a pause
+const uint64_t kPauseSliceNs = 50 * kNanosecondsPerMillisecond;
+
 /**
  * @brief Constructs a new ClientHandler.
  *
@@ -10,12 +36,100 @@
  * @param client_socket The socket connected to the client.
  * @param server A pointer to the Server instance.
  * @param message_handler The message handler to process received messages.
+ * @param event_loop The event loop driving this connection, or nullptr to use
+ * dedicated receive and writer threads.
+ * @param queue_options Limits and overflow policy of the outbound queue.
+ * @param strand Strand running the message handler on worker threads, or
+ * nullptr to handle messages on the receiving thread.
+ * @param timeouts Heartbeat, timeout and buffer trimming settings.
+ * @param limits Maximum frame size and rate limits on what the client
+ * sends, usually shared by all connections; nullptr for ConnectionLimits().
  */
 ClientHandler::ClientHandler(int client_id,
                              std::unique_ptr<ISocket> client_socket,
-                             Server *server, IMessageHandler *message_handler)
+                             Server *server, IMessageHandler *message_handler,
+                             EventLoop *event_loop,
+                             const OutboundQueueOptions &queue_options,
+                             std::unique_ptr<MessageStrand> strand,
+                             const ConnectionTimeouts &timeouts,
+                             std::shared_ptr<const ConnectionLimits> limits)
     : client_id_(client_id), client_socket_(std::move(client_socket)),
-      server_(server), message_handler_(message_handler), running_(false) {}
+      server_(server), message_handler_(message_handler), running_(false),
+      event_loop_(event_loop),
+      socket_handle_(client_socket_ ? client_socket_->GetNativeHandle()
+                                    : NativeSocketHandle()),
+      outbound_queue_(queue_options),
+      // Frames queued before Start are flushed by the initial registration
+      write_armed_(true), completion_io_(false), send_in_flight_(false),
+      limits_(limits ? std::move(limits) : std::make_shared<const ConnectionLimits>()), strand_(std::move(strand)),
+      protocol_version_(kProtocolVersionLegacy),
+      compression_codec_(CompressionCodecId::NONE),
+      bytes_received_(0), bytes_sent_(0), messages_received_(0), timeouts_(timeouts),
+      last_receive_ns_(Metrics::NowNanoseconds()), last_message_ns_(last_receive_ns_.load()),
+      last_send_ns_(last_receive_ns_.load()), last_heartbeat_ns_(0), last_trim_ns_(0), write_wait_since_ns_(0),
+      next_timeout_check_ns_(0), read_paused_(false), admission_paused_(false), read_resume_ns_(0),
+      strand_full_(false), backlog_paused_(false) {
+  if (!event_loop_) {
+    // The receive thread reads from the start; a reactor connection waits for its first read
+    receive_ = std::make_unique<ReceiveState>(server_, *limits_);
+  } else if (strand_) {
+    // Wakes the loop timer, which resumes reading (see OnTimer)
+    strand_->SetSpaceCallback([this] { event_loop_->ScheduleTimer(socket_handle_, this, 0); });
+  }
+}
+
+/**
+ * @brief Constructs the receive state with full buckets and no buffers.
+ *
+ * @param server The server private messages are routed through.
+ * @param limits The connection's frame size and rate limits.
+ */
+ClientHandler::ReceiveState::ReceiveState(Server *server, const ConnectionLimits &limits)
+    : framer(MessageFramer::kDefaultMinReadSize, MessageFramer::kDefaultMaxReadSize, limits.max_frame_size),
+      private_router(server), byte_bucket(limits.bytes), message_bucket(limits.messages) {
+  // Per-type buckets only cost memory when one of them is set
+  for (const RateLimit &limit : limits.message_types) {
+    if (limit.rate > 0) {
+      for (const RateLimit &type_limit : limits.message_types) {
+        type_buckets.emplace_back(type_limit);
+      }
+      break;
+    }
+  }
+}
+
+/**
+ * @brief Checks whether dropping the state loses nothing.
+ *
+ * The framer's peer protocol version need not survive: the handler keeps
+ * the negotiated version in protocol_version_, which only ever goes up.
+ *
+ * @param now_ns The current Metrics::NowNanoseconds time.
+ * @return True if no partial message is buffered and every bucket is full.
+ */
+bool ClientHandler::ReceiveState::IsIdle(uint64_t now_ns) const {
+  if (framer.BufferedBytes() > 0 || framer.HasError() || !byte_bucket.IsFull(now_ns) ||
+      !message_bucket.IsFull(now_ns)) {
+    return false;
+  }
+  for (const TokenBucket &bucket : type_buckets) {
+    if (!bucket.IsFull(now_ns)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+/**
+ * @brief Gets the receive state, creating it if a trim released it.
+ * @return The receive state.
+ */
+ClientHandler::ReceiveState &ClientHandler::GetReceiveState() {
+  if (!receive_) {
+    receive_ = std::make_unique<ReceiveState>(server_, *limits_);
+  }
+  return *receive_;
+}
 
 /**
  * @brief Destroys the ClientHandler object. Stops the thread if running.
@@ -25,62 +139,169 @@ ClientHandler::~ClientHandler() {
 }
 
 /**
- * @brief Starts the client handler thread.
+ * @brief Starts the client handler thread, or registers the connection with
+ * its event loop in reactor mode.
  */
 void ClientHandler::Start() {
   if (!running_.load()) {
     running_.store(true);
-    handler_thread_ = std::thread(&ClientHandler::Run, this);
+    if (event_loop_) {
+      if (!client_socket_ || !client_socket_->SetNonBlocking(true)) {
+        CHAT_LOG_ERROR("Error: Cannot switch socket of client " << client_id_ << " to non-blocking mode.");
+        running_.store(false);
+        return;
+      }
+      // Watch writability once so that frames queued before Start (e.g. the
+      // client ID assignment) are flushed; OnWritable disarms it when idle.
+      completion_io_ = event_loop_->SupportsCompletionIo() && client_socket_->HasPlainStream();
+      if (completion_io_) {
+        event_loop_->RegisterCompletion(socket_handle_, this, kPollReadable | kPollWritable);
+      } else {
+        event_loop_->Register(socket_handle_, this, kPollReadable | kPollWritable);
+      }
+      if (HasTimeouts()) {
+        uint64_t now_ns = Metrics::NowNanoseconds();
+        uint64_t first_check_ns = 0;
+        CheckTimeouts(now_ns, first_check_ns);
+        next_timeout_check_ns_ = first_check_ns > 0 ? now_ns + first_check_ns : 0;
+        ArmTimer(now_ns);
+      }
+    } else {
+      // A blocked send gives up once the client stops taking data, which
+      // also ends the write timeout in thread mode
+      if (timeouts_.write_timeout_ms > 0 && client_socket_) {
+        client_socket_->SetOption(SocketOption::SEND_TIMEOUT, timeouts_.write_timeout_ms);
+      }
+      handler_thread_ = std::thread(&ClientHandler::Run, this);
+      writer_thread_ = std::thread(&ClientHandler::WriteLoop, this);
+    }
   }
 }
 
 /**
  * @brief Stops the client handler and closes the connection.
+ *
+ * In reactor mode, returns only once no loop callback for this handler can be
+ * running.
  */
 void ClientHandler::Stop() {
-  if (running_.load()) {
-    running_.store(false);
-    // Close the socket to unblock the Receive call in the thread
+  bool was_running = running_.exchange(false);
+  outbound_queue_.Close();
+  if (strand_) {
+    // Unhandled messages are dropped; a handler already running finishes
+    // before we return, the socket is still open for its replies
+    strand_->Close();
+  }
+
+  if (event_loop_) {
+    // Unregister even if the connection already tore itself down: the call
+    // doubles as a barrier against a callback still executing on the loop.
+    event_loop_->Unregister(socket_handle_, this);
+    std::lock_guard<std::mutex> lock(socket_mutex_);
     if (client_socket_ && client_socket_->IsValid()) {
       client_socket_->Close();
     }
-    if (handler_thread_.joinable()) {
-      handler_thread_.join();
+    return;
+  }
+
+  if (was_running) {
+    // Shut the socket down to unblock the Receive and SendV calls in the
+    // threads; closing it would not wake a thread blocked in recv.
+    ShutdownSocket();
+  }
+
+  bool detached = false;
+  for (std::thread *thread : {&handler_thread_, &writer_thread_}) {
+    if (thread->joinable()) {
+      if (thread->get_id() == std::this_thread::get_id()) {
+        thread->detach();
+        detached = true;
+      } else {
+        thread->join();
+      }
+    }
+  }
+
+  // Only close once no thread can still be using the socket
+  if (!detached) {
+    std::lock_guard<std::mutex> lock(socket_mutex_);
+    if (client_socket_ && client_socket_->IsValid()) {
+      client_socket_->Close();
     }
   }
 }
 
 /**
- * @brief Sends a message to the connected client.
+ * @brief Queues a message for sending to the connected client.
+ *
+ * The call never blocks on the network. If the outbound queue exceeds its
+ * limit, the configured overflow policy either drops the oldest unsent frames
+ * or disconnects the client as a slow consumer.
  *
  * @param message The message structure to send.
- * @return True if the message was sent successfully, false otherwise.
+ * @return True if the message was queued, false if the connection is closing
+ * or the client was disconnected as a slow consumer.
  */
-bool ClientHandler::SendMessage(const Message &message) {
-  if (!client_socket_ || !client_socket_->IsValid()) {
-    std::cerr << "Error: Cannot send message, socket is not valid for client "
-              << client_id_ << std::endl;
-    return false;
-  }
-
-  // Serialize the message into a byte vector
-  std::vector<char> data_to_send = SerializeMessage(message);
-
-  // Send the serialized data. In a real application, you would handle partial
-  // sends.
-  int bytes_sent =
-      client_socket_->Send(data_to_send.data(), data_to_send.size());
+bool ClientHandler::SendMessage(const MessageView &message) {
+  return SendFrame(SerializeMessageShared(message, protocol_version_.load(), compression_codec_.load()));
+}
 
-  if (bytes_sent < 0) {
-    std::cerr << "Error sending message to client " << client_id_ << std::endl;
+/**
+ * @brief Queues an already serialized frame for sending.
+ *
+ * @param frame The serialized message frame (shared, not copied).
+ * @return True if the frame was queued, false if the connection is closing or
+ * the client was disconnected as a slow consumer.
+ */
+bool ClientHandler::SendFrame(const SharedFrame &frame) {
+  switch (outbound_queue_.Push(frame)) {
+  case OutboundQueue::PushResult::CLOSED:
+    CHAT_LOG_RATE_LIMITED(LogLevel::ERROR,
+                          "Error: Cannot send message, connection is closing for client " << client_id_);
+    return false;
+  case OutboundQueue::PushResult::LIMIT_EXCEEDED:
+    CHAT_LOG_ERROR("Client " << client_id_ << " is not keeping up with its outbound queue. Disconnecting.");
+    // The caller may hold the server's client list lock, so only abort the
+    // socket here and let the receive path remove the client.
+    outbound_queue_.Close();
+    ShutdownSocket();
     return false;
+  case OutboundQueue::PushResult::QUEUED_AFTER_DROP: {
+    // Log with exponential backoff, a stalled client drops on every send
+    size_t dropped = outbound_queue_.GetDroppedFrameCount();
+    if ((dropped & (dropped - 1)) == 0) {
+      CHAT_LOG_ERROR("Outbound queue full for client " << client_id_ << ", dropped oldest frames (total dropped: "
+                     << dropped << ").");
+    }
+    break;
+  }
+  case OutboundQueue::PushResult::QUEUED:
+    break;
   }
-  // Note: bytes_sent could be less than the data_to_send size in case of
-  // partial sends. For simplicity, we assume full send or error for now.
 
+  // Thread mode: the queue wakes the writer thread itself
+  if (event_loop_ && !write_armed_.exchange(true)) {
+    event_loop_->UpdateInterest(socket_handle_, this, GetReadInterest() | kPollWritable);
+  }
   return true;
 }
 
+/**
+ * @brief Gets the wire protocol version used for frames sent to this client.
+ * @return The protocol version.
+ */
+int ClientHandler::GetProtocolVersion() const {
+  return protocol_version_.load();
+}
+
+/**
+ * @brief Gets the codec negotiated for payloads sent to this client.
+ * @return The codec, or CompressionCodecId::NONE.
+ */
+CompressionCodecId ClientHandler::GetCompressionCodec() const {
+  return compression_codec_.load();
+}
+
 /**
  * @brief Gets the unique identifier for this client handler.
  * @return The client ID.
@@ -97,6 +318,40 @@ ISocket *ClientHandler::GetSocket() const {
   return client_socket_.get();
 }
 
+/**
+ * @brief Gets the traffic counters of this connection.
+ * @return A copy of the counters.
+ */
+ConnectionStats ClientHandler::GetStats() const {
+  ConnectionStats stats;
+  stats.bytes_received = bytes_received_.load(std::memory_order_relaxed);
+  stats.bytes_sent = bytes_sent_.load(std::memory_order_relaxed);
+  stats.messages_received = messages_received_.load(std::memory_order_relaxed);
+  stats.queued_bytes = outbound_queue_.GetQueuedBytes();
+  stats.dropped_frames = outbound_queue_.GetDroppedFrameCount();
+  return stats;
+}
+
+/**
+ * @brief Gets the event loop driving this connection.
+ * @return The loop, or nullptr in thread mode.
+ */
+EventLoop *ClientHandler::GetEventLoop() const {
+  return event_loop_;
+}
+
+/**
+ * @brief Pauses or resumes reading from the client, for server-wide admission control.
+ *
+ * Only sets a flag: the receiving side checks it after every read burst, and
+ * while paused every kAdmissionRecheckNs.
+ *
+ * @param paused True to stop reading until called again with false.
+ */
+void ClientHandler::SetAdmissionPaused(bool paused) {
+  admission_paused_.store(paused, std::memory_order_relaxed);
+}
+
 /**
  * @brief The main loop for the client handler thread.
  *
@@ -104,83 +359,796 @@ ISocket *ClientHandler::GetSocket() const {
  * reassembles messages, and passes them to the message handler.
  */
 void ClientHandler::Run() {
-  std::cout << "Client handler started for client " << client_id_ << std::endl;
-
-  std::vector<char> buffer(1024);
+  CHAT_LOG_INFO("Client handler started for client " << client_id_);
 
   while (running_.load() && client_socket_ && client_socket_->IsValid()) {
-    int bytes_received = client_socket_->Receive(buffer.data(), buffer.size());
+    if (read_resume_ns_ != 0 && !WaitWhileReadPaused()) {
+      running_.store(false);
+      RemoveFromServer();
+      break;
+    }
+    if (!running_.load()) {
+      break;
+    }
+
+    // Receive straight into the framer's buffer
+    size_t capacity = 0;
+    char *read_buffer = receive_->framer.PrepareRead(capacity);
+    int bytes_received = client_socket_->Receive(read_buffer, capacity);
 
     if (bytes_received > 0) {
-      receive_buffer_.insert(receive_buffer_.end(), buffer.begin(),
-                             buffer.begin() + bytes_received);
-
-      // Process messages from the receive buffer
-      while (receive_buffer_.size() >= kMessageHeaderSize) {
-        // Peek at the header to get the payload size
-        MessageHeader header;
-        std::memcpy(&header, receive_buffer_.data(), kMessageHeaderSize);
-
-        size_t total_message_size = kMessageHeaderSize + header.payload_size;
-
-        if (receive_buffer_.size() >= total_message_size) {
-          // We have a complete message
-          std::vector<char> complete_message_data(receive_buffer_.begin(),
-                                                  receive_buffer_.begin() +
-                                                      total_message_size);
-
-          // Deserialize the message
-          Message received_message = DeserializeMessage(complete_message_data);
-
-          // Remove the processed message from the buffer
-          receive_buffer_.erase(receive_buffer_.begin(),
-                                receive_buffer_.begin() + total_message_size);
-
-          // Handle the message using the message handler
-          if (message_handler_ && server_) {
-            if (!message_handler_->HandleMessage(received_message, this,
-                                                 server_)) {
-              std::cerr
-                  << "Message handler failed to process message from client "
-                  << client_id_ << std::endl;
-            }
-          } else {
-            std::cerr << "No message handler or server available for client "
-                      << client_id_ << std::endl;
-          }
-        } else {
-          // Not enough data for a complete message yet, wait for more
-          break;
-        }
+      if (!ProcessReceivedData(static_cast<size_t>(bytes_received))) {
+        running_.store(false);
+        RemoveFromServer();
       }
     } else if (bytes_received == 0) {
       // Connection closed by client
-      std::cout << "Client " << client_id_ << " disconnected." << std::endl;
+      CHAT_LOG_INFO("Client " << client_id_ << " disconnected.");
       running_.store(false);
-      if (server_) {
-        server_->RemoveClient(this);
-      }
+      RemoveFromServer();
     } else {
       // Error occurred
 #ifdef _WIN32
       int error_code = WSAGetLastError();
-      std::cerr << "Error receiving data from client " << client_id_ << ": "
-                << error_code << ". Disconnecting." << std::endl;
+      CHAT_LOG_ERROR("Error receiving data from client " << client_id_ << ": " << error_code << ". Disconnecting.");
 #else
-      std::cerr << "Error receiving data from client " << client_id_ << ": "
-                << strerror(errno) << ". Disconnecting." << std::endl;
+      CHAT_LOG_ERROR("Error receiving data from client " << client_id_ << ": " << strerror(errno)
+                                                          << ". Disconnecting.");
 #endif
       running_.store(false);
-      if (server_) {
-        server_->RemoveClient(this);
+      RemoveFromServer();
+    }
+  }
+
+  // Release the writer thread; the socket itself is closed by Stop once both
+  // threads have exited
+  outbound_queue_.Close();
+  ShutdownSocket();
+
+  CHAT_LOG_INFO("Client handler stopped for client " << client_id_);
+}
+
+/**
+ * @brief The main loop for the writer thread (thread mode only).
+ *
+ * Waits for queued frames and writes them with blocking gathered sends until
+ * the queue is closed or a send fails. While waiting it also wakes up for the
+ * timeout checks.
+ */
+void ClientHandler::WriteLoop() {
+  bool timed = HasTimeouts();
+  uint64_t next_check_ns = Metrics::NowNanoseconds();
+
+  while (true) {
+    int wait_ms = -1;
+    if (timed) {
+      uint64_t now_ns = Metrics::NowNanoseconds();
+      wait_ms = next_check_ns > now_ns
+                    ? static_cast<int>((next_check_ns - now_ns + kNanosecondsPerMillisecond - 1) /
+                                       kNanosecondsPerMillisecond)
+                    : 0;
+    }
+    if (!outbound_queue_.WaitForData(wait_ms)) {
+      break;
+    }
+
+    if (timed) {
+      uint64_t now_ns = Metrics::NowNanoseconds();
+      if (now_ns >= next_check_ns) {
+        uint64_t delay_ns = 0;
+        if (!CheckTimeouts(now_ns, delay_ns)) {
+          // Wakes the receive thread, which removes the client
+          ShutdownSocket();
+          break;
+        }
+        timed = delay_ns > 0;
+        next_check_ns = now_ns + delay_ns;
+      }
+    }
+
+    size_t batch_bytes = outbound_queue_.Gather(write_batch_);
+    if (batch_bytes == 0) {
+      continue;
+    }
+
+    int bytes_sent = client_socket_->SendV(write_batch_.data(), write_batch_.size());
+    if (bytes_sent < 0) {
+      if (client_socket_->WouldBlock()) {
+        // The send timeout expired without a byte going out
+        CHAT_LOG_WARNING("Client " << client_id_ << " timed out: no data written for "
+                         << timeouts_.write_timeout_ms << " ms. Disconnecting.");
+        Metrics::Add(MetricCounter::CONNECTIONS_TIMED_OUT);
+      } else {
+        CHAT_LOG_ERROR("Error sending data to client " << client_id_ << ". Disconnecting.");
+      }
+      // Wakes the receive thread, which removes the client
+      ShutdownSocket();
+      break;
+    }
+    outbound_queue_.Consume(static_cast<size_t>(bytes_sent));
+    CountBytesSent(static_cast<size_t>(bytes_sent));
+  }
+}
+
+/**
+ * @brief Reactor callback: drains the readable socket.
+ */
+void ClientHandler::OnReadable() {
+  if (read_resume_ns_ != 0) {
+    // An interest update from another thread raced with the pause
+    event_loop_->UpdateInterest(socket_handle_, this, GetReadInterest() | GetWriteInterest());
+    return;
+  }
+
+  for (int reads = 0; reads < kMaxReadsPerEvent && running_.load(); ++reads) {
+    size_t capacity = 0;
+    char *read_buffer = GetReceiveState().framer.PrepareRead(capacity);
+    int bytes_received = client_socket_->Receive(read_buffer, capacity);
+
+    if (bytes_received > 0) {
+      if (!ProcessReceivedData(static_cast<size_t>(bytes_received))) {
+        HandleDisconnect();
+        return;
+      }
+      if (read_resume_ns_ != 0) {
+        // Over a limit: stop watching readability until the timer resumes us
+        event_loop_->UpdateInterest(socket_handle_, this, GetWriteInterest());
+        ArmTimer(Metrics::NowNanoseconds());
+        return;
+      }
+    } else if (bytes_received == 0) {
+      CHAT_LOG_INFO("Client " << client_id_ << " disconnected.");
+      HandleDisconnect();
+      return;
+    } else if (client_socket_->WouldBlock()) {
+      return; // Drained everything that was available
+    } else {
+      CHAT_LOG_ERROR("Error receiving data from client " << client_id_ << ". Disconnecting.");
+      HandleDisconnect();
+      return;
+    }
+  }
+}
+
+/**
+ * @brief Reactor callback: drains the outbound queue into the socket.
+ *
+ * Writes batches until the socket's send buffer fills up or the queue is
+ * empty, in which case writability stops being watched.
+ */
+void ClientHandler::OnWritable() {
+  if (completion_io_) {
+    if (!send_in_flight_ && running_.load()) {
+      StartSend();
+    }
+    return;
+  }
+
+  for (int writes = 0; writes < kMaxWritesPerEvent && running_.load();
+       ++writes) {
+    size_t batch_bytes = outbound_queue_.Gather(write_batch_);
+    if (batch_bytes == 0) {
+      DisarmWritable();
+      return;
+    }
+
+    int bytes_sent =
+        client_socket_->SendV(write_batch_.data(), write_batch_.size());
+    if (bytes_sent < 0) {
+      outbound_queue_.Consume(0);
+      if (client_socket_->WouldBlock()) {
+        return; // Stay armed until the socket drains
       }
+      CHAT_LOG_ERROR("Error sending data to client " << client_id_ << ". Disconnecting.");
+      HandleDisconnect();
+      return;
+    }
+
+    outbound_queue_.Consume(static_cast<size_t>(bytes_sent));
+    CountBytesSent(static_cast<size_t>(bytes_sent));
+    if (static_cast<size_t>(bytes_sent) < batch_bytes) {
+      return; // Send buffer is full
     }
   }
+}
 
-  // Ensure socket is closed when the thread exits
+/**
+ * @brief Reactor mode: stops watching writability after the queue drained.
+ *
+ * Re-checks the queue afterwards to close the race with a concurrent
+ * SendMessage that saw write_armed_ still set.
+ */
+void ClientHandler::DisarmWritable() {
+  write_armed_.store(false);
+  event_loop_->UpdateInterest(socket_handle_, this, GetReadInterest());
+  if (!outbound_queue_.IsEmpty() && !write_armed_.exchange(true)) {
+    event_loop_->UpdateInterest(socket_handle_, this, GetReadInterest() | kPollWritable);
+  }
+}
+
+/**
+ * @brief Completion mode: hands the next batch of the outbound queue to the
+ * event loop, or stops watching writability once the queue is empty.
+ *
+ * The gathered frames stay in the queue, and so valid, until OnSent
+ * consumes what the write took.
+ */
+void ClientHandler::StartSend() {
+  if (outbound_queue_.Gather(write_batch_) == 0) {
+    DisarmWritable();
+    return;
+  }
+  if (!event_loop_->Send(socket_handle_, this, write_batch_.data(), write_batch_.size())) {
+    outbound_queue_.Consume(0);
+    CHAT_LOG_ERROR("Error queuing a write to client " << client_id_ << ". Disconnecting.");
+    HandleDisconnect();
+    return;
+  }
+  send_in_flight_ = true;
+}
+
+/**
+ * @brief Completion-mode callback: frames what the loop received.
+ *
+ * The bytes are copied into the framer, in pieces if a large frame bounds
+ * the read window. A limit that runs into debt pauses reading as in
+ * OnReadable; bytes the loop received before the pause took effect keep
+ * waiting in the framer.
+ *
+ * @param data The bytes, valid only during the call.
+ * @param result Number of bytes, 0 once the client closed, or -errno.
+ */
+void ClientHandler::OnReceived(const char *data, int result) {
+  if (result == 0) {
+    CHAT_LOG_INFO("Client " << client_id_ << " disconnected.");
+    HandleDisconnect();
+    return;
+  }
+  if (result < 0) {
+    CHAT_LOG_ERROR("Error receiving data from client " << client_id_ << ". Disconnecting.");
+    HandleDisconnect();
+    return;
+  }
+
+  bool was_paused = read_resume_ns_ != 0;
+  ReceiveState &receive = GetReceiveState();
+  size_t remaining = static_cast<size_t>(result);
+  while (remaining > 0) {
+    size_t capacity = 0;
+    char *read_buffer = receive.framer.PrepareRead(capacity);
+    size_t chunk = std::min(capacity, remaining);
+    std::memcpy(read_buffer, data, chunk);
+    if (!ProcessReceivedData(chunk)) {
+      HandleDisconnect();
+      return;
+    }
+    data += chunk;
+    remaining -= chunk;
+  }
+  if (!was_paused && read_resume_ns_ != 0) {
+    // Over a limit: stop receiving until the timer resumes us
+    event_loop_->UpdateInterest(socket_handle_, this, GetWriteInterest());
+    ArmTimer(Metrics::NowNanoseconds());
+  }
+}
+
+/**
+ * @brief Completion-mode callback: consumes what the loop wrote and starts
+ * the next write.
+ *
+ * @param result Number of bytes written, or -errno.
+ */
+void ClientHandler::OnSent(int result) {
+  send_in_flight_ = false;
+  if (result < 0) {
+    outbound_queue_.Consume(0);
+    CHAT_LOG_ERROR("Error sending data to client " << client_id_ << ". Disconnecting.");
+    HandleDisconnect();
+    return;
+  }
+  outbound_queue_.Consume(static_cast<size_t>(result));
+  CountBytesSent(static_cast<size_t>(result));
+  if (running_.load()) {
+    StartSend();
+  }
+}
+
+/**
+ * @brief Reactor callback: the peer hung up or the socket errored.
+ */
+void ClientHandler::OnHangup() {
+  // Consume whatever the peer sent before hanging up; this normally ends in
+  // a zero-byte read that tears the connection down.
+  OnReadable();
+  if (running_.load()) {
+    CHAT_LOG_INFO("Client " << client_id_ << " disconnected.");
+    HandleDisconnect();
+  }
+}
+
+/**
+ * @brief Reactor callback: resumes paused reading and runs the heartbeat,
+ * timeout and trimming checks, whichever is due.
+ */
+void ClientHandler::OnTimer() {
+  if (!running_.load()) {
+    return;
+  }
+  uint64_t now_ns = Metrics::NowNanoseconds();
+  if (read_resume_ns_ != 0 && (now_ns >= read_resume_ns_ || (backlog_paused_ && !strand_->IsFull()))) {
+    // Messages held back by the pause go first, they may pause us again
+    if (!DispatchBufferedMessages(now_ns, 0)) {
+      HandleDisconnect();
+      return;
+    }
+    if (read_resume_ns_ == 0) {
+      event_loop_->UpdateInterest(socket_handle_, this, kPollReadable | GetWriteInterest());
+    }
+  }
+  if (next_timeout_check_ns_ != 0 && now_ns >= next_timeout_check_ns_) {
+    uint64_t delay_ns = 0;
+    if (!CheckTimeouts(now_ns, delay_ns)) {
+      HandleDisconnect();
+      return;
+    }
+    next_timeout_check_ns_ = delay_ns > 0 ? now_ns + delay_ns : 0;
+  }
+  ArmTimer(now_ns);
+}
+
+/**
+ * @brief Hands freshly received bytes to the framer and dispatches every
+ * complete message to the message handler.
+ *
+ * The bytes are charged to the connection's byte rate limit first.
+ *
+ * @param bytes_received Number of bytes received into the region returned by
+ * MessageFramer::PrepareRead.
+ * @return False if the stream is corrupt and the client must be dropped.
+ */
+bool ClientHandler::ProcessReceivedData(size_t bytes_received) {
+  receive_->framer.CommitRead(bytes_received);
+  // Only this thread writes the counter, so no read-modify-write is needed
+  bytes_received_.store(bytes_received_.load(std::memory_order_relaxed) + bytes_received, std::memory_order_relaxed);
+  Metrics::Add(MetricCounter::BYTES_RECEIVED, bytes_received);
+  uint64_t now_ns = Metrics::NowNanoseconds();
+  last_receive_ns_.store(now_ns, std::memory_order_relaxed);
+
+  uint64_t throttle_ns = receive_->byte_bucket.Consume(static_cast<double>(bytes_received), now_ns);
+  if (read_resume_ns_ != 0 && !receive_->framer.HasError()) {
+    // Completion mode: received while already paused, so it waits for the resume
+    read_resume_ns_ = std::max(read_resume_ns_, now_ns + throttle_ns);
+    return true;
+  }
+  return DispatchBufferedMessages(now_ns, throttle_ns);
+}
+
+/**
+ * @brief Dispatches the complete messages in the framer until a rate limit
+ * runs into debt.
+ *
+ * Messages are dispatched as views into the framer's buffer, so the payload
+ * is not copied on the way to the handler. Private messages are collected
+ * and routed to their recipients once the whole read is framed, or before
+ * the next message for the handler; while the strand still holds earlier
+ * messages they queue behind them instead, so nothing a client sends
+ * overtakes its earlier messages. Each message
+ * is charged to the message rate limits; once one is in debt, or the strand
+ * reports itself full, the remaining messages stay in the framer and
+ * read_resume_ns_ is set, as it is while admission control holds the client
+ * back. A full strand pauses only this connection, until its space callback
+ * (or, in thread mode, WaitForSpace) lets it resume.
+ *
+ * @param now_ns The current Metrics::NowNanoseconds time.
+ * @param throttle_ns Pause already owed by the caller, 0 if none.
+ * @return False if the stream is corrupt and the client must be dropped.
+ */
+bool ClientHandler::DispatchBufferedMessages(uint64_t now_ns, uint64_t throttle_ns) {
+  ReceiveState &receive = *receive_;
+  if (strand_full_) {
+    strand_full_ = strand_->IsFull();
+  }
+  MessageView received_message;
+  while (throttle_ns == 0 && !strand_full_ && receive.framer.Next(received_message)) {
+    messages_received_.store(messages_received_.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    Metrics::CountMessageReceived(received_message.header.type);
+    throttle_ns = receive.message_bucket.Consume(1, now_ns);
+    if (!receive.type_buckets.empty()) {
+      size_t type = static_cast<size_t>(received_message.header.type);
+      throttle_ns = std::max(throttle_ns, receive.type_buckets[type < kMessageTypeCount ? type : 0].Consume(1, now_ns));
+    }
+
+    // Answer in the compact format once the client has switched to it
+    int peer_version = std::min(receive.framer.GetPeerProtocolVersion(), kProtocolVersionLatest);
+    if (peer_version > protocol_version_.load()) {
+      protocol_version_.store(peer_version);
+    }
+
+    // Any received byte proves the client alive, so a heartbeat needs no answer
+    if (received_message.header.type == MessageType::HEARTBEAT) {
+      continue;
+    }
+    last_message_ns_.store(now_ns, std::memory_order_relaxed);
+
+    // A client echoes its ID assignment to confirm the negotiated format
+    // and to name the compression codec it picked from our offer
+    if (received_message.header.type == MessageType::CLIENT_ID_ASSIGNMENT) {
+      int echoed_id = -1;
+      int echoed_version = 0;
+      std::vector<CompressionCodecId> codecs;
+      if (ParseClientIdAssignment(received_message.payload, echoed_id, echoed_version, codecs) &&
+          !codecs.empty() && server_ && server_->IsCompressionCodecOffered(codecs.front()) &&
+          protocol_version_.load() >= kProtocolVersionCompact) {
+        compression_codec_.store(codecs.front());
+        CHAT_LOG_INFO("Client " << client_id_ << " uses " << FindCompressionCodec(codecs.front())->GetName()
+                      << " compression.");
+      }
+      continue;
+    }
+
+    // Private messages need no handler: forward them, batched per recipient,
+    // unless earlier messages of this client still wait on the strand
+    if (received_message.header.type == MessageType::PRIVATE_MESSAGE) {
+      if (!strand_ || strand_->IsIdle()) {
+        receive.private_router.Add(received_message, client_id_);
+      } else {
+        PostToStrand(received_message);
+      }
+      continue;
+    }
+
+    // The batched private messages came first, so they go first
+    receive.private_router.Flush(this);
+    DispatchMessage(received_message);
+  }
+  receive.private_router.Flush(this);
+
+  if (receive.framer.HasError()) {
+    if (receive.framer.GetError() == FramingError::FRAME_TOO_LARGE) {
+      CHAT_LOG_ERROR("Protocol error: client " << client_id_ << " sent a frame over the maximum frame size. "
+                     << "Disconnecting.");
+      Metrics::Add(MetricCounter::FRAMES_TOO_LARGE);
+    } else {
+      CHAT_LOG_ERROR("Protocol error: invalid message header from client " << client_id_ << ". Disconnecting.");
+    }
+    return false;
+  }
+
+  backlog_paused_ = false;
+  if (throttle_ns > 0) {
+    Metrics::Add(MetricCounter::READS_THROTTLED);
+  } else if (strand_full_) {
+    // Only this connection waits for its handlers; the space callback resumes it
+    backlog_paused_ = true;
+    throttle_ns = kBacklogRecheckNs;
+  } else if (admission_paused_.load(std::memory_order_relaxed)) {
+    throttle_ns = kAdmissionRecheckNs;
+  }
+  read_resume_ns_ = throttle_ns > 0 ? now_ns + throttle_ns : 0;
+  read_paused_.store(read_resume_ns_ != 0, std::memory_order_relaxed);
+  return true;
+}
+
+/**
+ * @brief Thread mode: sleeps until reading may resume, then dispatches the
+ * messages held back by the pause.
+ *
+ * @return False if the held-back messages are corrupt and the client must
+ * be dropped.
+ */
+bool ClientHandler::WaitWhileReadPaused() {
+  while (running_.load() && read_resume_ns_ != 0) {
+    uint64_t now_ns = Metrics::NowNanoseconds();
+    if (backlog_paused_) {
+      // The thread is this connection's own, so it may block; Stop closes the strand
+      strand_->WaitForSpace();
+      now_ns = Metrics::NowNanoseconds();
+    } else if (now_ns < read_resume_ns_) {
+      std::this_thread::sleep_for(std::chrono::nanoseconds(std::min(read_resume_ns_ - now_ns, kPauseSliceNs)));
+      continue;
+    }
+    if (!DispatchBufferedMessages(now_ns, 0)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+/**
+ * @brief Reactor mode: gets the read part of the poll interest.
+ * @return kPollReadable, or 0 while reading is paused.
+ */
+uint32_t ClientHandler::GetReadInterest() const {
+  return read_paused_.load(std::memory_order_relaxed) ? 0u : static_cast<uint32_t>(kPollReadable);
+}
+
+/**
+ * @brief Reactor mode: gets the write part of the poll interest.
+ * @return kPollWritable while writability is being watched, 0 otherwise.
+ */
+uint32_t ClientHandler::GetWriteInterest() const {
+  return write_armed_.load() ? static_cast<uint32_t>(kPollWritable) : 0u;
+}
+
+/**
+ * @brief Reactor mode: arms the loop timer for the earliest of the read
+ * resumption and the next timeout check.
+ *
+ * @param now_ns The current Metrics::NowNanoseconds time.
+ */
+void ClientHandler::ArmTimer(uint64_t now_ns) {
+  uint64_t due_ns = UINT64_MAX;
+  for (uint64_t deadline_ns : {read_resume_ns_, next_timeout_check_ns_}) {
+    if (deadline_ns != 0) {
+      due_ns = std::min(due_ns, deadline_ns);
+    }
+  }
+  if (due_ns == UINT64_MAX) {
+    return;
+  }
+  uint64_t delay_ns = due_ns > now_ns ? due_ns - now_ns : 0;
+  event_loop_->ScheduleTimer(socket_handle_, this,
+                             (delay_ns + kNanosecondsPerMillisecond - 1) / kNanosecondsPerMillisecond);
+}
+
+/**
+ * @brief Passes a received message to the message handler, on the strand
+ * unless it can be handled inline.
+ *
+ * @param message View of the received message; only valid during the call.
+ */
+void ClientHandler::DispatchMessage(const MessageView &message) {
+  if (!message_handler_ || !server_) {
+    CHAT_LOG_ERROR("No message handler or server available for client " << client_id_);
+    return;
+  }
+  // Cheap types skip the hop, unless that would overtake an earlier message
+  if (!strand_ || (message_handler_->IsInlineSafe(message.header.type) && strand_->IsIdle())) {
+    RunMessageHandler(message);
+    return;
+  }
+  PostToStrand(message);
+}
+
+/**
+ * @brief Queues a received message on the strand, behind the client's
+ * earlier messages.
+ *
+ * The payload lives in the framer's buffer, so the task keeps a copy; a
+ * detached frame already owns its bytes. A private message is routed by the
+ * task, the others go to the message handler.
+ *
+ * @param message View of the received message; only valid during the call.
+ */
+void ClientHandler::PostToStrand(const MessageView &message) {
+  PooledBuffer payload;
+  if (!message.frame) {
+    payload.assign(message.payload.begin(), message.payload.end());
+  }
+  uint64_t queued_ns = Metrics::NowNanoseconds();
+  size_t bytes = message.payload.size() + kMessageHeaderSize;
+  MessageStrand::PostResult result = strand_->Post(
+      [this, queued = message, payload = std::move(payload), queued_ns]() mutable {
+        Metrics::Record(MetricHistogram::WORKER_QUEUE_NS, Metrics::NowNanoseconds() - queued_ns);
+        if (!queued.frame) {
+          queued.payload = PayloadView(payload);
+          queued.wire = PayloadView(); // Still points into the framer's buffer
+        }
+        if (queued.header.type == MessageType::PRIVATE_MESSAGE) {
+          PrivateMessageRouter router(server_);
+          router.Add(queued, client_id_);
+          router.Flush(this);
+        } else {
+          RunMessageHandler(queued);
+        }
+      },
+      bytes);
+  // Stops the dispatch loop; the rest stays in the framer until the strand catches up
+  strand_full_ = result == MessageStrand::PostResult::FULL;
+}
+
+/**
+ * @brief Runs the message handler on a message.
+ * @param message View of the message.
+ */
+void ClientHandler::RunMessageHandler(const MessageView &message) {
+  if (!message_handler_->HandleMessage(message, this, server_)) {
+    CHAT_LOG_RATE_LIMITED(LogLevel::ERROR, "Message handler failed to process message from client " << client_id_);
+  }
+}
+
+/**
+ * @brief Removes this client from the server once its received messages are
+ * handled.
+ */
+void ClientHandler::RemoveFromServer() {
+  if (!server_) {
+    return;
+  }
+  if (strand_ && strand_->Post([this] { server_->RemoveClient(this); }, 0) != MessageStrand::PostResult::CLOSED) {
+    return;
+  }
+  // No strand, or it was closed by Stop and nothing is pending any more
+  server_->RemoveClient(this);
+}
+
+/**
+ * @brief Checks whether any of the timeouts is enabled.
+ * @return True if CheckTimeouts has anything to do.
+ */
+bool ClientHandler::HasTimeouts() const {
+  return timeouts_.heartbeat_interval_ms > 0 || timeouts_.read_timeout_ms > 0 || timeouts_.write_timeout_ms > 0 ||
+         timeouts_.idle_timeout_ms > 0 || timeouts_.trim_after_ms > 0;
+}
+
+/**
+ * @brief Sends a heartbeat, trims buffers or detects a timeout, whatever is due.
+ *
+ * Every deadline is derived from the activity timestamps, so the data path
+ * never touches a timer: a check that finds its deadline moved simply
+ * schedules the next one for the new time.
+ *
+ * @param now_ns The current Metrics::NowNanoseconds time.
+ * @param next_check_ns Receives the delay until the next check is due, or 0
+ * if none is.
+ * @return False if the client timed out and must be disconnected.
+ */
+bool ClientHandler::CheckTimeouts(uint64_t now_ns, uint64_t &next_check_ns) {
+  uint64_t next_ns = UINT64_MAX;
+  // True if the timeout has passed since the given time; otherwise keeps
+  // its deadline as a candidate for the next check
+  auto expired = [&](int timeout_ms, uint64_t since_ns) {
+    if (timeout_ms <= 0) {
+      return false;
+    }
+    uint64_t deadline_ns = since_ns + static_cast<uint64_t>(timeout_ms) * kNanosecondsPerMillisecond;
+    if (deadline_ns <= now_ns) {
+      return true;
+    }
+    next_ns = std::min(next_ns, deadline_ns);
+    return false;
+  };
+
+  uint64_t received_ns = last_receive_ns_.load(std::memory_order_relaxed);
+  uint64_t sent_ns = last_send_ns_.load(std::memory_order_relaxed);
+  if (read_paused_.load(std::memory_order_relaxed)) {
+    // We are the ones not reading, the client's silence proves nothing
+    received_ns = now_ns;
+  }
+  if (expired(timeouts_.read_timeout_ms, received_ns)) {
+    CHAT_LOG_WARNING("Client " << client_id_ << " timed out: nothing received for " << timeouts_.read_timeout_ms
+                     << " ms. Disconnecting.");
+    Metrics::Add(MetricCounter::CONNECTIONS_TIMED_OUT);
+    return false;
+  }
+  if (expired(timeouts_.idle_timeout_ms, last_message_ns_.load(std::memory_order_relaxed))) {
+    CHAT_LOG_INFO("Client " << client_id_ << " was idle for " << timeouts_.idle_timeout_ms << " ms. Disconnecting.");
+    Metrics::Add(MetricCounter::CONNECTIONS_TIMED_OUT);
+    return false;
+  }
+
+  // Thread mode has the socket's send timeout for this, its writer is the
+  // thread that would block
+  if (event_loop_ && timeouts_.write_timeout_ms > 0) {
+    if (outbound_queue_.IsEmpty()) {
+      write_wait_since_ns_ = 0;
+      next_ns = std::min(next_ns, now_ns + static_cast<uint64_t>(timeouts_.write_timeout_ms) *
+                                               kNanosecondsPerMillisecond);
+    } else {
+      if (write_wait_since_ns_ == 0) {
+        write_wait_since_ns_ = now_ns;
+      }
+      if (expired(timeouts_.write_timeout_ms, std::max(write_wait_since_ns_, sent_ns))) {
+        CHAT_LOG_WARNING("Client " << client_id_ << " timed out: no data written for " << timeouts_.write_timeout_ms
+                         << " ms. Disconnecting.");
+        Metrics::Add(MetricCounter::CONNECTIONS_TIMED_OUT);
+        return false;
+      }
+    }
+  }
+
+  // Probe once per interval while the client is silent; its answer (or any
+  // other traffic) moves the deadline
+  if (timeouts_.heartbeat_interval_ms > 0 &&
+      expired(timeouts_.heartbeat_interval_ms, std::max(received_ns, last_heartbeat_ns_))) {
+    Message heartbeat;
+    heartbeat.header.type = MessageType::HEARTBEAT;
+    heartbeat.header.sender_id = -1; // Server is the sender
+    heartbeat.header.recipient_id = client_id_;
+    SendMessage(heartbeat);
+    Metrics::Add(MetricCounter::HEARTBEATS_SENT);
+    last_heartbeat_ns_ = now_ns;
+    expired(timeouts_.heartbeat_interval_ms, now_ns);
+  }
+
+  if (timeouts_.trim_after_ms > 0) {
+    uint64_t active_ns = std::max(received_ns, sent_ns);
+    if (last_trim_ns_ >= active_ns) {
+      // Already trimmed: look again later, in case traffic resumes
+      expired(timeouts_.trim_after_ms, now_ns);
+    } else if (expired(timeouts_.trim_after_ms, active_ns)) {
+      if (ReleaseIdleMemory(now_ns)) {
+        Metrics::Add(MetricCounter::CONNECTIONS_TRIMMED);
+      }
+      last_trim_ns_ = now_ns;
+      expired(timeouts_.trim_after_ms, now_ns);
+    }
+  }
+
+  next_check_ns = next_ns == UINT64_MAX ? 0 : next_ns - now_ns;
+  return true;
+}
+
+/**
+ * @brief Frees the buffers of a quiet connection.
+ * @param now_ns The current Metrics::NowNanoseconds time.
+ * @return True if anything was released.
+ */
+bool ClientHandler::ReleaseIdleMemory(uint64_t now_ns) {
+  bool released = outbound_queue_.ReleaseMemory();
+  if (write_batch_.capacity() > 0) {
+    std::vector<IoBuffer>().swap(write_batch_);
+    released = true;
+  }
+  if (event_loop_ && receive_) {
+    // On the loop thread, so no read is in progress
+    if (read_resume_ns_ == 0 && receive_->IsIdle(now_ns)) {
+      receive_.reset(); // The next read starts from a fresh one
+      released = true;
+    } else {
+      released = receive_->framer.ReleaseMemory() > 0 || released;
+      receive_->private_router.ReleaseMemory();
+    }
+  }
+  return released;
+}
+
+/**
+ * @brief Counts bytes the socket accepted, for the connection and globally.
+ * @param bytes_sent Number of bytes written.
+ */
+void ClientHandler::CountBytesSent(size_t bytes_sent) {
+  // Only the writing thread (or the loop) updates the counter
+  bytes_sent_.store(bytes_sent_.load(std::memory_order_relaxed) + bytes_sent, std::memory_order_relaxed);
+  Metrics::Add(MetricCounter::BYTES_SENT, bytes_sent);
+  if (bytes_sent > 0) {
+    last_send_ns_.store(Metrics::NowNanoseconds(), std::memory_order_relaxed);
+  }
+}
+
+/**
+ * @brief Shuts the socket down in both directions.
+ *
+ * Used to abort a connection from any thread: blocked Receive and SendV calls
+ * return, and the normal disconnect path then removes the client.
+ */
+void ClientHandler::ShutdownSocket() {
+  std::lock_guard<std::mutex> lock(socket_mutex_);
   if (client_socket_ && client_socket_->IsValid()) {
-    client_socket_->Close();
+    client_socket_->Shutdown();
+  }
+}
+
+/**
+ * @brief Reactor mode: tears the connection down after a disconnect or socket
+ * error and removes it from the server.
+ */
+void ClientHandler::HandleDisconnect() {
+  if (!running_.exchange(false)) {
+    return;
+  }
+
+  // Called on the loop thread, so the registration is dropped immediately
+  event_loop_->Unregister(socket_handle_, this);
+  outbound_queue_.Close();
+  {
+    std::lock_guard<std::mutex> lock(socket_mutex_);
+    if (client_socket_ && client_socket_->IsValid()) {
+      client_socket_->Close();
+    }
   }
 
-  std::cout << "Client handler stopped for client " << client_id_ << std::endl;
+  // Must be the last use of this object: the server takes ownership and
+  // destroys the handler once it is safe to do so.
+  RemoveFromServer();
 }
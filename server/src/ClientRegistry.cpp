@@ -0,0 +1,125 @@
+#include "ClientRegistry.h"
+
+#include <algorithm>
+#include <mutex>
+#include <utility>
+
+/**
+ * @brief Constructs an empty registry.
+ *
+ * @param shard_count Number of independently locked shards (at least 1).
+ */
+ClientRegistry::ClientRegistry(size_t shard_count) : shards_(std::max<size_t>(1, shard_count)) {}
+
+/**
+ * @brief Adds a client, keyed by its client ID.
+ *
+ * @param client The client handler to add.
+ * @return False if a client with the same ID is already registered.
+ */
+bool ClientRegistry::Add(std::shared_ptr<IClientHandler> client) {
+  if (!client) {
+    return false;
+  }
+  int client_id = client->GetClientId();
+  Shard &shard = ShardFor(client_id);
+  std::unique_lock<std::shared_mutex> lock(shard.mutex);
+  return shard.clients.emplace(client_id, std::move(client)).second;
+}
+
+/**
+ * @brief Removes a client if the entry for its ID is still that handler.
+ *
+ * @param client The client handler to remove.
+ * @return The removed handler, or nullptr if it was not registered.
+ */
+std::shared_ptr<IClientHandler> ClientRegistry::Remove(const IClientHandler *client) {
+  if (!client) {
+    return nullptr;
+  }
+  Shard &shard = ShardFor(client->GetClientId());
+  std::unique_lock<std::shared_mutex> lock(shard.mutex);
+  auto it = shard.clients.find(client->GetClientId());
+  if (it == shard.clients.end() || it->second.get() != client) {
+    return nullptr;
+  }
+  std::shared_ptr<IClientHandler> removed = std::move(it->second);
+  shard.clients.erase(it);
+  return removed;
+}
+
+/**
+ * @brief Looks a client up by its ID.
+ *
+ * @param client_id The client ID.
+ * @return A reference to the handler, or nullptr if not found.
+ */
+std::shared_ptr<IClientHandler> ClientRegistry::Find(int client_id) const {
+  const Shard &shard = ShardFor(client_id);
+  std::shared_lock<std::shared_mutex> lock(shard.mutex);
+  auto it = shard.clients.find(client_id);
+  return it != shard.clients.end() ? it->second : nullptr;
+}
+
+/**
+ * @brief Invokes a function for every registered client.
+ *
+ * @param fn The function to invoke.
+ */
+void ClientRegistry::ForEach(const std::function<void(const std::shared_ptr<IClientHandler> &)> &fn) const {
+  for (const Shard &shard : shards_) {
+    std::shared_lock<std::shared_mutex> lock(shard.mutex);
+    for (const auto &entry : shard.clients) {
+      fn(entry.second);
+    }
+  }
+}
+
+/**
+ * @brief Removes all clients.
+ *
+ * @return The handlers that were registered.
+ */
+std::vector<std::shared_ptr<IClientHandler>> ClientRegistry::Clear() {
+  std::vector<std::shared_ptr<IClientHandler>> removed;
+  for (Shard &shard : shards_) {
+    std::unique_lock<std::shared_mutex> lock(shard.mutex);
+    for (auto &entry : shard.clients) {
+      removed.push_back(std::move(entry.second));
+    }
+    shard.clients.clear();
+  }
+  return removed;
+}
+
+/**
+ * @brief Gets the number of registered clients.
+ * @return The client count.
+ */
+size_t ClientRegistry::Size() const {
+  size_t count = 0;
+  for (const Shard &shard : shards_) {
+    std::shared_lock<std::shared_mutex> lock(shard.mutex);
+    count += shard.clients.size();
+  }
+  return count;
+}
+
+/**
+ * @brief Gets the shard responsible for a client ID.
+ * @param client_id The client ID.
+ * @return The shard.
+ */
+const ClientRegistry::Shard &ClientRegistry::ShardFor(int client_id) const {
+  // IDs are handed out sequentially, so a plain modulo spreads them evenly
+  return shards_[static_cast<unsigned int>(client_id) % shards_.size()];
+}
+
+/**
+ * @brief Gets the shard responsible for a client ID.
+ * @param client_id The client ID.
+ * @return The shard.
+ */
+ClientRegistry::Shard &ClientRegistry::ShardFor(int client_id) {
+  return shards_[static_cast<unsigned int>(client_id) % shards_.size()];
+}
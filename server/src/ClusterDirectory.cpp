@@ -0,0 +1,69 @@
+#include "ClusterDirectory.h"
+
+#include <algorithm>
+#include <limits>
+
+/**
+ * @brief Constructs the directory of one node.
+ *
+ * @param node_id This node's ID, in [0, node_count).
+ * @param node_count Number of nodes in the cluster.
+ */
+ClusterDirectory::ClusterDirectory(int node_id, int node_count)
+    : node_id_(node_id), node_count_(std::max(1, node_count)),
+      sequence_count_((std::numeric_limits<int>::max() - static_cast<int64_t>(node_id_)) / node_count_),
+      next_sequence_(0) {}
+
+/**
+ * @brief Allocates a new client ID owned by this node.
+ *
+ * The ID is computed in 64 bits from a sequence wrapped modulo
+ * sequence_count_, so it never leaves the positive int range and stays
+ * congruent to node_id_ modulo node_count_. A node count that leaves a node
+ * no larger ID gives it node_id_ itself.
+ *
+ * @return The ID, always positive; after the largest one the sequence wraps around.
+ */
+int ClusterDirectory::AllocateClientId() {
+  if (sequence_count_ <= 0) {
+    return node_id_; // The node count leaves this node no larger ID
+  }
+  int64_t sequence = static_cast<int64_t>(next_sequence_.fetch_add(1) % static_cast<uint64_t>(sequence_count_)) + 1;
+  return static_cast<int>(node_id_ + static_cast<int64_t>(node_count_) * sequence);
+}
+
+/**
+ * @brief Gets the node that owns a client ID.
+ *
+ * @param client_id The ID.
+ * @return The owner's node ID, or -1 for IDs no client can have.
+ */
+int ClusterDirectory::GetOwner(int client_id) const {
+  return client_id > 0 ? client_id % node_count_ : -1;
+}
+
+/**
+ * @brief Checks whether a client ID belongs to a client of this node.
+ *
+ * @param client_id The ID.
+ * @return True if this node allocated, or would allocate, the ID.
+ */
+bool ClusterDirectory::IsLocal(int client_id) const {
+  return GetOwner(client_id) == node_id_;
+}
+
+/**
+ * @brief Gets this node's ID.
+ * @return The node ID.
+ */
+int ClusterDirectory::GetNodeId() const {
+  return node_id_;
+}
+
+/**
+ * @brief Gets the number of nodes in the cluster.
+ * @return The node count, at least 1.
+ */
+int ClusterDirectory::GetNodeCount() const {
+  return node_count_;
+}
@@ -0,0 +1,199 @@
+#include "ClusterLink.h"
+
+#include <chrono>
+#include <utility>
+
+#ifdef _WIN32
+#include "WinsockSocket.h"
+#else
+#include "PosixSocket.h"
+#endif
+
+#include "Logger.h"
+
+namespace {
+
+// Pause between attempts to reach an unreachable peer
+const int kReconnectDelayMs = 500;
+// A peer that takes no bytes for this long is treated as gone
+const int kSendTimeoutMs = 10000;
+
+} // namespace
+
+/**
+ * @brief Constructs a stopped link.
+ *
+ * @param node_id ID of the peer node.
+ * @param host Address of the peer's cluster listener.
+ * @param port Port of the peer's cluster listener.
+ * @param queue_options Limits of the link's send queue.
+ * @param socket_options Options for the link's socket.
+ */
+ClusterLink::ClusterLink(int node_id, const std::string &host, int port, const OutboundQueueOptions &queue_options,
+                         const SocketOptions &socket_options)
+    : node_id_(node_id), host_(host), port_(port), socket_options_(socket_options), queue_(queue_options),
+      frame_cut_(false), running_(false) {}
+
+/**
+ * @brief Stops the writer thread.
+ */
+ClusterLink::~ClusterLink() {
+  Stop();
+}
+
+/**
+ * @brief Starts the writer thread, which connects to the peer.
+ */
+void ClusterLink::Start() {
+  if (!running_.exchange(true)) {
+    thread_ = std::thread(&ClusterLink::Run, this);
+  }
+}
+
+/**
+ * @brief Stops the writer thread and closes the connection; queued frames are dropped.
+ */
+void ClusterLink::Stop() {
+  {
+    // Under the lock, so the writer cannot miss the wakeup
+    std::lock_guard<std::mutex> lock(wait_mutex_);
+    running_.store(false);
+  }
+  wait_cv_.notify_all();
+  queue_.Close();
+  {
+    // Unblocks a SendV in progress
+    std::lock_guard<std::mutex> lock(socket_mutex_);
+    if (socket_) {
+      socket_->Shutdown();
+    }
+  }
+  if (thread_.joinable()) {
+    thread_.join();
+  }
+  Disconnect();
+}
+
+/**
+ * @brief Queues a frame for the peer.
+ *
+ * @param frame The frame, in any wire format the framer accepts.
+ * @return False if the link is stopped.
+ */
+bool ClusterLink::Send(const SharedFrame &frame) {
+  return queue_.Push(frame) != OutboundQueue::PushResult::CLOSED;
+}
+
+/**
+ * @brief Gets the ID of the peer node.
+ * @return The node ID.
+ */
+int ClusterLink::GetNodeId() const {
+  return node_id_;
+}
+
+/**
+ * @brief The writer thread's loop.
+ *
+ * Connects whenever there is no connection, then writes whatever is queued
+ * in batches of up to max_batch_frames frames.
+ */
+void ClusterLink::Run() {
+  while (running_.load()) {
+    if (!socket_ && !Connect()) {
+      if (!WaitBeforeReconnect()) {
+        break;
+      }
+      continue;
+    }
+    if (!queue_.WaitForData()) {
+      break;
+    }
+
+    size_t batch_bytes = queue_.Gather(write_batch_);
+    if (batch_bytes == 0) {
+      continue;
+    }
+    int bytes_sent = socket_->SendV(write_batch_.data(), write_batch_.size());
+    if (bytes_sent < 0) {
+      if (running_.load()) {
+        CHAT_LOG_RATE_LIMITED(LogLevel::WARNING, "Cluster link to node " << node_id_ << " failed; reconnecting.");
+      }
+      Disconnect();
+      continue;
+    }
+
+    if (bytes_sent > 0) {
+      // Whether the write stopped inside a frame or right after one
+      size_t boundary = 0;
+      frame_cut_ = true;
+      for (const IoBuffer &buffer : write_batch_) {
+        boundary += buffer.size;
+        if (boundary >= static_cast<size_t>(bytes_sent)) {
+          frame_cut_ = boundary != static_cast<size_t>(bytes_sent);
+          break;
+        }
+      }
+    }
+    queue_.Consume(static_cast<size_t>(bytes_sent));
+  }
+}
+
+/**
+ * @brief Opens a connection to the peer.
+ *
+ * The rest of a frame cut off by the previous connection is discarded
+ * first, since the peer's new framer expects a frame boundary.
+ *
+ * @return True if connected.
+ */
+bool ClusterLink::Connect() {
+#ifdef _WIN32
+  auto socket = std::make_unique<WinsockSocket>();
+#else
+  auto socket = std::make_unique<PosixSocket>();
+#endif
+  if (!socket->IsValid()) {
+    return false;
+  }
+  socket->ApplyOptions(socket_options_);
+  socket->SetOption(SocketOption::SEND_TIMEOUT, kSendTimeoutMs);
+  if (!socket->Connect(host_, port_)) {
+    CHAT_LOG_RATE_LIMITED(LogLevel::WARNING, "Cannot reach cluster node " << node_id_ << " at " << host_ << ":"
+                                                                          << port_ << "; retrying.");
+    return false;
+  }
+
+  if (frame_cut_) {
+    if (queue_.Gather(write_batch_) > 0) {
+      queue_.Consume(write_batch_.front().size);
+    }
+    frame_cut_ = false;
+  }
+  {
+    std::lock_guard<std::mutex> lock(socket_mutex_);
+    socket_ = std::move(socket);
+  }
+  CHAT_LOG_INFO("Cluster link to node " << node_id_ << " at " << host_ << ":" << port_ << " connected.");
+  return true;
+}
+
+/**
+ * @brief Closes the connection after an error.
+ */
+void ClusterLink::Disconnect() {
+  std::lock_guard<std::mutex> lock(socket_mutex_);
+  if (socket_) {
+    socket_->Close();
+    socket_.reset();
+  }
+}
+
+/**
+ * @brief Sleeps before the next connection attempt.
+ * @return False if the link was stopped meanwhile.
+ */
+bool ClusterLink::WaitBeforeReconnect() {
+  std::unique_lock<std::mutex> lock(wait_mutex_);
+  return !wait_cv_.wait_for(lock, std::chrono::milliseconds(kReconnectDelayMs), [this] { return !running_.load(); });
+}
@@ -0,0 +1,341 @@
+#include "ClusterNode.h"
+
+#include <chrono>
+#include <string>
+#include <utility>
+
+#ifdef _WIN32
+#include "WinsockSocket.h"
+#else
+#include "PosixSocket.h"
+#endif
+
+#include "Logger.h"
+#include "MessageFramer.h"
+#include "Metrics.h"
+#include "RemoteClientHandler.h"
+#include "Server.h"
+
+namespace {
+
+// Frames coalesced into one write on a link; links carry many small frames
+const size_t kLinkBatchFrames = 256;
+
+/**
+ * @brief Tells the sender of a relayed file transfer that it failed.
+ *
+ * @param server The local server, which routes the error back to the sender's node.
+ * @param message The relayed request or chunk.
+ * @param text The error text.
+ */
+void SendTransferError(Server *server, const MessageView &message, const std::string &text) {
+  std::shared_ptr<IClientHandler> sender = server->GetClientHandler(message.header.sender_id);
+  if (!sender) {
+    return;
+  }
+  Message error_msg;
+  error_msg.header.type = MessageType::FILE_TRANSFER_ERROR;
+  error_msg.header.sender_id = -1; // Server is the sender
+  error_msg.header.recipient_id = message.header.sender_id;
+  error_msg.header.transfer_id = message.header.transfer_id;
+  error_msg.payload.assign(text.begin(), text.end());
+  error_msg.header.payload_size = error_msg.payload.size();
+  sender->SendMessage(error_msg);
+}
+
+} // namespace
+
+/**
+ * @brief Constructs a stopped node.
+ *
+ * @param server The local server; must outlive the node.
+ * @param directory The server's client ID directory.
+ * @param options Membership and link settings.
+ * @param socket_options Options for the listener and the link sockets.
+ */
+ClusterNode::ClusterNode(Server *server, const ClusterDirectory &directory, const ClusterOptions &options,
+                         const SocketOptions &socket_options)
+    : server_(server), directory_(directory), options_(options), socket_options_(socket_options), running_(false) {}
+
+/**
+ * @brief Stops the node.
+ */
+ClusterNode::~ClusterNode() {
+  Stop();
+}
+
+/**
+ * @brief Starts listening for peers and connecting to them.
+ *
+ * Peers may start in any order: each link keeps trying until its peer's
+ * listener is up.
+ *
+ * @return False if the membership is invalid or the cluster port cannot be opened.
+ */
+bool ClusterNode::Start() {
+  int node_count = directory_.GetNodeCount();
+  links_.clear();
+  links_.resize(static_cast<size_t>(node_count));
+  OutboundQueueOptions queue_options;
+  queue_options.max_queued_bytes = options_.link_queue_bytes;
+  queue_options.max_batch_frames = kLinkBatchFrames;
+  for (const ClusterPeer &peer : options_.peers) {
+    if (peer.node_id < 0 || peer.node_id >= node_count || peer.node_id == options_.node_id ||
+        links_[static_cast<size_t>(peer.node_id)]) {
+      CHAT_LOG_ERROR("Invalid cluster peer " << peer.node_id << ": node IDs must be 0.." << node_count - 1
+                     << ", each used once.");
+      links_.clear();
+      return false;
+    }
+    links_[static_cast<size_t>(peer.node_id)] =
+        std::make_unique<ClusterLink>(peer.node_id, peer.host, peer.port, queue_options, socket_options_);
+  }
+  if (options_.node_id < 0 || options_.node_id >= node_count) {
+    CHAT_LOG_ERROR("Invalid cluster node ID " << options_.node_id << ": must be 0.." << node_count - 1 << ".");
+    links_.clear();
+    return false;
+  }
+
+#ifdef _WIN32
+  listener_ = std::make_unique<WinsockSocket>();
+#else
+  listener_ = std::make_unique<PosixSocket>();
+#endif
+  if (!listener_->IsValid() || !listener_->Bind("0.0.0.0", options_.port) ||
+      !listener_->ApplyOptions(socket_options_) || !listener_->Listen(node_count)) {
+    CHAT_LOG_ERROR("Failed to open the cluster port " << options_.port << ".");
+    listener_.reset();
+    links_.clear();
+    return false;
+  }
+
+  running_.store(true);
+  accept_thread_ = std::thread(&ClusterNode::AcceptLoop, this);
+  for (const auto &link : links_) {
+    if (link) {
+      link->Start();
+    }
+  }
+  CHAT_LOG_INFO("Cluster node " << options_.node_id << " of " << node_count << " listening for peers on port "
+                << options_.port << ".");
+  return true;
+}
+
+/**
+ * @brief Closes every link; frames not sent yet are dropped.
+ *
+ * The links themselves are kept until destruction, since RemoteClientHandlers
+ * handed out earlier may still point to them.
+ */
+void ClusterNode::Stop() {
+  if (!running_.exchange(false)) {
+    return;
+  }
+  // Shut down to unblock Accept; closing alone does not wake it on Linux
+  listener_->Shutdown();
+  if (accept_thread_.joinable()) {
+    accept_thread_.join();
+  }
+  listener_->Close();
+
+  std::vector<std::unique_ptr<InboundLink>> inbound_links;
+  {
+    std::lock_guard<std::mutex> lock(inbound_mutex_);
+    inbound_links.swap(inbound_links_);
+  }
+  for (const auto &link : inbound_links) {
+    link->socket->Shutdown();
+  }
+  for (const auto &link : inbound_links) {
+    if (link->thread.joinable()) {
+      link->thread.join();
+    }
+    link->socket->Close();
+  }
+
+  for (const auto &link : links_) {
+    if (link) {
+      link->Stop();
+    }
+  }
+}
+
+/**
+ * @brief Sends a broadcast to every other node, which fans it out to its own clients.
+ *
+ * Serializes once; every link queues the same frame.
+ *
+ * @param message The broadcast.
+ */
+void ClusterNode::Broadcast(const MessageView &message) {
+  SharedFrame frame;
+  for (const auto &link : links_) {
+    if (link) {
+      if (!frame) {
+        frame = SerializeMessageShared(message, kProtocolVersionLatest, CompressionCodecId::NONE);
+      }
+      link->Send(frame);
+      Metrics::Add(MetricCounter::CLUSTER_FRAMES_FORWARDED);
+    }
+  }
+}
+
+/**
+ * @brief Gets a stand-in for a client of another node.
+ *
+ * @param client_id The client's ID.
+ * @return The proxy, or nullptr if no peer owns the ID.
+ */
+std::shared_ptr<IClientHandler> ClusterNode::GetRemoteClient(int client_id) {
+  int owner = directory_.GetOwner(client_id);
+  if (owner < 0 || static_cast<size_t>(owner) >= links_.size() || !links_[static_cast<size_t>(owner)]) {
+    return nullptr;
+  }
+  return std::make_shared<RemoteClientHandler>(client_id, links_[static_cast<size_t>(owner)].get());
+}
+
+/**
+ * @brief Accepts connections from peers until the node stops.
+ */
+void ClusterNode::AcceptLoop() {
+  while (running_.load()) {
+    std::unique_ptr<ISocket> socket(listener_->Accept());
+    if (!socket || !socket->IsValid()) {
+      if (!running_.load()) {
+        break;
+      }
+      CHAT_LOG_RATE_LIMITED(LogLevel::ERROR, "Error accepting a cluster connection.");
+      std::this_thread::sleep_for(std::chrono::milliseconds(10));
+      continue;
+    }
+
+    ReapInboundLinks();
+    socket->ApplyOptions(socket_options_);
+    auto link = std::make_unique<InboundLink>();
+    link->socket = std::move(socket);
+    InboundLink *inbound = link.get();
+    std::lock_guard<std::mutex> lock(inbound_mutex_);
+    inbound->thread = std::thread(&ClusterNode::ReadLoop, this, inbound);
+    inbound_links_.push_back(std::move(link));
+  }
+}
+
+/**
+ * @brief Reads and dispatches what one peer sends until it disconnects.
+ *
+ * Private messages of one read are collected and flushed together, like a
+ * client connection does with its own.
+ *
+ * @param link The peer's connection.
+ */
+void ClusterNode::ReadLoop(InboundLink *link) {
+  CHAT_LOG_INFO("Cluster peer connected.");
+  MessageFramer framer;
+  PrivateMessageRouter router(server_);
+  MessageView message;
+  while (running_.load()) {
+    size_t capacity = 0;
+    char *read_buffer = framer.PrepareRead(capacity);
+    int bytes_received = link->socket->Receive(read_buffer, capacity);
+    if (bytes_received <= 0) {
+      break;
+    }
+    framer.CommitRead(static_cast<size_t>(bytes_received));
+    while (framer.Next(message)) {
+      Metrics::Add(MetricCounter::CLUSTER_MESSAGES_RECEIVED);
+      Dispatch(message, router);
+    }
+    router.Flush(nullptr);
+    if (framer.HasError()) {
+      CHAT_LOG_ERROR("Invalid frame from a cluster peer; dropping its link.");
+      break;
+    }
+  }
+  if (running_.load()) {
+    CHAT_LOG_WARNING("Cluster peer disconnected.");
+  }
+  link->finished.store(true);
+}
+
+/**
+ * @brief Hands a message from a peer to its local recipients.
+ *
+ * Broadcasts are fanned out locally and never forwarded again, so every
+ * node sees each broadcast once.
+ *
+ * @param message The message.
+ * @param router Collects the private messages of the current read.
+ */
+void ClusterNode::Dispatch(const MessageView &message, PrivateMessageRouter &router) {
+  switch (message.header.type) {
+  case MessageType::BROADCAST_MESSAGE:
+    server_->BroadcastLocally(message, nullptr);
+    break;
+  case MessageType::PRIVATE_MESSAGE:
+    if (directory_.IsLocal(message.header.recipient_id)) {
+      router.Add(message, message.header.sender_id);
+    }
+    break;
+  default:
+    DeliverToClient(message);
+    break;
+  }
+}
+
+/**
+ * @brief Delivers a message to the local client in its recipient_id.
+ *
+ * Relayed file transfers to a client that is gone, or that cannot carry
+ * the transfer ID, fail back to the sender like local relays do.
+ *
+ * @param message The message.
+ */
+void ClusterNode::DeliverToClient(const MessageView &message) {
+  // Never route anything on again, whatever the peer thought the owner was
+  int recipient_id = message.header.recipient_id;
+  std::shared_ptr<IClientHandler> recipient =
+      directory_.IsLocal(recipient_id) ? server_->GetClientHandler(recipient_id) : nullptr;
+  bool request = message.header.type == MessageType::FILE_TRANSFER_REQUEST;
+  if (!recipient) {
+    if (request) {
+      SendTransferError(server_, message, "Recipient client not found.");
+    } else if (message.header.type == MessageType::FILE_DATA_CHUNK) {
+      SendTransferError(server_, message, "Recipient client disconnected during transfer.");
+    } else {
+      CHAT_LOG_RATE_LIMITED(LogLevel::WARNING,
+                            "Dropped a relayed message for client " << recipient_id << ", not connected here.");
+    }
+    return;
+  }
+
+  int version = recipient->GetProtocolVersion();
+  if (request && message.header.transfer_id != 0 && version < kProtocolVersionCompact) {
+    SendTransferError(server_, message, "Recipient client does not support transfer IDs.");
+  } else if (message.frame && (message.frame_version == kProtocolVersionLegacy || version >= message.frame_version)) {
+    recipient->SendFrame(message.frame);
+  } else {
+    recipient->SendMessage(message);
+  }
+}
+
+/**
+ * @brief Joins and removes inbound links whose peer disconnected.
+ */
+void ClusterNode::ReapInboundLinks() {
+  std::vector<std::unique_ptr<InboundLink>> finished;
+  {
+    std::lock_guard<std::mutex> lock(inbound_mutex_);
+    for (auto it = inbound_links_.begin(); it != inbound_links_.end();) {
+      if ((*it)->finished.load()) {
+        finished.push_back(std::move(*it));
+        it = inbound_links_.erase(it);
+      } else {
+        ++it;
+      }
+    }
+  }
+  for (const auto &link : finished) {
+    link->thread.join();
+    link->socket->Close();
+  }
+}
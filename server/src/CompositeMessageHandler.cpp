@@ -1,18 +1,63 @@
 #include "CompositeMessageHandler.h"
 
-#include <iostream>
+#include <algorithm>
 #include <utility> // For std::move
 
+#include "Logger.h"
+#include "Metrics.h"
+
+/**
+ * @brief Constructs a new CompositeMessageHandler.
+ */
+CompositeMessageHandler::CompositeMessageHandler() {
+  dispatch_table_.fill(nullptr);
+}
+
 /**
  * @brief Adds a message handler to the composite.
  *
- * Handlers are tried in the order they are added.
+ * The handler is registered for the types it declares; if it declares none,
+ * it is appended to the ordered fallback chain.
  *
  * @param handler The message handler to add.
  */
 void CompositeMessageHandler::AddHandler(
     std::unique_ptr<IMessageHandler> handler) {
+  if (!handler) {
+    return;
+  }
+
+  std::vector<MessageType> types = handler->GetHandledTypes();
+  if (types.empty()) {
+    AddFallbackHandler(std::move(handler));
+    return;
+  }
+
+  for (MessageType type : types) {
+    size_t index = static_cast<size_t>(type);
+    if (index >= kMessageTypeCount) {
+      CHAT_LOG_WARNING("Ignoring handler registration for invalid message type: " << static_cast<int>(type));
+      continue;
+    }
+    if (dispatch_table_[index]) {
+      CHAT_LOG_WARNING("Message type " << static_cast<int>(type) << " already has a handler, keeping the first one.");
+      continue;
+    }
+    dispatch_table_[index] = handler.get();
+  }
+  handlers_.push_back(std::move(handler));
+}
+
+/**
+ * @brief Adds a handler to the ordered fallback chain, ignoring any types it
+ * declares.
+ *
+ * @param handler The message handler to add.
+ */
+void CompositeMessageHandler::AddFallbackHandler(
+    std::unique_ptr<IMessageHandler> handler) {
   if (handler) {
+    fallback_handlers_.push_back(handler.get());
     handlers_.push_back(std::move(handler));
   }
 }
@@ -20,28 +65,91 @@ void CompositeMessageHandler::AddHandler(
 /**
  * @brief Handles an incoming message by dispatching it to registered handlers.
  *
- * @param message The deserialized Message object received.
+ * @param message View of the received message.
  * @param sender The client handler that received the message.
  * @param server A pointer to the Server instance.
  * @return True if any handler processed the message, false otherwise.
  */
-bool CompositeMessageHandler::HandleMessage(const Message &message,
+bool CompositeMessageHandler::HandleMessage(const MessageView &message,
                                             IClientHandler *sender,
                                             Server *server) {
-  for (const auto &handler : handlers_) {
+  uint64_t start_ns = Metrics::NowNanoseconds();
+  bool handled = Dispatch(message, sender, server);
+  Metrics::RecordHandlerLatency(message.header.type, Metrics::NowNanoseconds() - start_ns);
+  if (!handled) {
+    // No handler processed the message
+    CHAT_LOG_RATE_LIMITED(LogLevel::ERROR, "No handler processed message of type: "
+                                               << static_cast<int>(message.header.type) << " from client "
+                                               << message.header.sender_id);
+    // Optional: Send an error message back to the sender for unhandled messages
+    // This requires the Server or ClientHandler to have a way to send errors
+    // back based on the message type. For now, we'll just log it.
+  }
+  return handled;
+}
+
+/**
+ * @brief Offers a message to the typed handler, then to the fallback chain.
+ *
+ * @param message View of the received message.
+ * @param sender The client handler that received the message.
+ * @param server A pointer to the Server instance.
+ * @return True if any handler processed the message, false otherwise.
+ */
+bool CompositeMessageHandler::Dispatch(const MessageView &message, IClientHandler *sender, Server *server) {
+  // Fast path: the handler registered for this type
+  size_t index = static_cast<size_t>(message.header.type);
+  if (index < kMessageTypeCount && dispatch_table_[index] &&
+      dispatch_table_[index]->HandleMessage(message, sender, server)) {
+    return true;
+  }
+
+  for (IMessageHandler *handler : fallback_handlers_) {
     if (handler->HandleMessage(message, sender, server)) {
       return true;
     }
   }
+  return false;
+}
 
-  // No handler processed the message
-  std::cerr << "No handler processed message of type: "
-            << static_cast<int>(message.header.type) << " from client "
-            << message.header.sender_id << std::endl;
+/**
+ * @brief Gets the union of the types handled by the typed handlers.
+ *
+ * @return The handled message types.
+ */
+std::vector<MessageType> CompositeMessageHandler::GetHandledTypes() const {
+  std::vector<MessageType> types;
+  for (size_t index = 0; index < kMessageTypeCount; ++index) {
+    if (dispatch_table_[index]) {
+      types.push_back(static_cast<MessageType>(index));
+    }
+  }
+  return types;
+}
 
-  // Optional: Send an error message back to the sender for unhandled messages
-  // This requires the Server or ClientHandler to have a way to send errors
-  // back based on the message type. For now, we'll just log it.
+/**
+ * @brief Tells whether a message type is cheap enough to handle on the I/O thread.
+ *
+ * @param type The message type.
+ * @return True if the type may be handled inline.
+ */
+bool CompositeMessageHandler::IsInlineSafe(MessageType type) const {
+  size_t index = static_cast<size_t>(type);
+  if (index >= kMessageTypeCount || !dispatch_table_[index] || !dispatch_table_[index]->IsInlineSafe(type)) {
+    return false;
+  }
+  return std::all_of(fallback_handlers_.begin(), fallback_handlers_.end(),
+                     [type](const IMessageHandler *handler) { return handler->IsInlineSafe(type); });
+}
 
-  return false;
+/**
+ * @brief Notifies every registered handler that a client disconnected.
+ *
+ * @param client_id The ID of the disconnected client.
+ * @param server A pointer to the Server instance.
+ */
+void CompositeMessageHandler::OnClientDisconnected(int client_id, Server *server) {
+  for (const auto &handler : handlers_) {
+    handler->OnClientDisconnected(client_id, server);
+  }
 }
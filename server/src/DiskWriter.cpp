@@ -0,0 +1,91 @@
+#include "DiskWriter.h"
+
+#include <algorithm>
+#include <utility>
+
+/**
+ * @brief Constructs a new DiskWriter and starts its threads.
+ * @param thread_count Number of I/O threads (at least 1).
+ */
+DiskWriter::DiskWriter(size_t thread_count) : stopping_(false), stopped_(false) {
+  thread_count = std::max<size_t>(1, thread_count);
+  for (size_t i = 0; i < thread_count; ++i) {
+    threads_.emplace_back(&DiskWriter::Run, this);
+  }
+}
+
+/**
+ * @brief Destroys the DiskWriter. Runs the remaining jobs, then joins the threads.
+ */
+DiskWriter::~DiskWriter() {
+  Shutdown();
+}
+
+/**
+ * @brief Queues a job for one of the I/O threads.
+ *
+ * @param job The job to execute.
+ */
+void DiskWriter::Submit(std::function<void()> job) {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (!stopped_) {
+      jobs_.push_back(std::move(job));
+      job = nullptr;
+    }
+  }
+
+  if (job) {
+    // Already shut down: nothing else will run it
+    job();
+  } else {
+    jobs_cv_.notify_one();
+  }
+}
+
+/**
+ * @brief Runs the remaining jobs and joins the threads.
+ */
+void DiskWriter::Shutdown() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stopping_ = true;
+  }
+  jobs_cv_.notify_all();
+
+  for (std::thread &thread : threads_) {
+    if (thread.joinable()) {
+      thread.join();
+    }
+  }
+
+  // Pick up anything submitted from outside the pool after the threads left
+  std::deque<std::function<void()>> leftover;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stopped_ = true;
+    leftover.swap(jobs_);
+  }
+  for (auto &job : leftover) {
+    job();
+  }
+}
+
+/**
+ * @brief The loop executed by each I/O thread.
+ */
+void DiskWriter::Run() {
+  while (true) {
+    std::function<void()> job;
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+      jobs_cv_.wait(lock, [&] { return !jobs_.empty() || stopping_; });
+      if (jobs_.empty()) {
+        return; // Stopping and drained
+      }
+      job = std::move(jobs_.front());
+      jobs_.pop_front();
+    }
+    job();
+  }
+}
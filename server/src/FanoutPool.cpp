@@ -0,0 +1,111 @@
+#include "FanoutPool.h"
+
+#include <algorithm>
+#include <utility>
+
+/**
+ * @brief Constructs the pool and starts its threads.
+ * @param thread_count Number of helper threads (at least 1).
+ */
+FanoutPool::FanoutPool(size_t thread_count) : stopping_(false) {
+  thread_count = std::max<size_t>(1, thread_count);
+  for (size_t i = 0; i < thread_count; ++i) {
+    threads_.emplace_back(&FanoutPool::WorkerLoop, this);
+  }
+}
+
+/**
+ * @brief Destroys the pool. Runs the remaining slices, then joins the threads.
+ */
+FanoutPool::~FanoutPool() {
+  Shutdown();
+}
+
+/**
+ * @brief Runs slice(0) .. slice(count - 1) in parallel and waits for all of them.
+ *
+ * @param count Number of slices.
+ * @param slice The work for one slice, given its index.
+ */
+void FanoutPool::Run(size_t count, const std::function<void(size_t)> &slice) {
+  if (count == 0) {
+    return;
+  }
+
+  size_t pending = count - 1; // Slices handed to the pool, guarded by mutex_
+  bool run_inline = false;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (stopping_) {
+      run_inline = true;
+    } else {
+      for (size_t index = 1; index < count; ++index) {
+        work_.push_back([&slice, &pending, index, this] {
+          slice(index);
+          std::lock_guard<std::mutex> done_lock(mutex_);
+          if (--pending == 0) {
+            done_cv_.notify_all();
+          }
+        });
+      }
+    }
+  }
+  if (run_inline) {
+    for (size_t index = 0; index < count; ++index) {
+      slice(index);
+    }
+    return;
+  }
+  work_cv_.notify_all();
+
+  slice(0);
+
+  // Help instead of just waiting: the queued slices may be ours or another
+  // caller's, either way it shortens the wait
+  std::unique_lock<std::mutex> lock(mutex_);
+  while (pending > 0) {
+    if (!work_.empty()) {
+      std::function<void()> job = std::move(work_.front());
+      work_.pop_front();
+      lock.unlock();
+      job();
+      lock.lock();
+    } else {
+      done_cv_.wait(lock);
+    }
+  }
+}
+
+/**
+ * @brief Runs the remaining slices and joins the threads. Safe to call more than once.
+ */
+void FanoutPool::Shutdown() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stopping_ = true;
+  }
+  work_cv_.notify_all();
+  for (std::thread &thread : threads_) {
+    if (thread.joinable()) {
+      thread.join();
+    }
+  }
+}
+
+/**
+ * @brief The loop executed by each helper thread.
+ */
+void FanoutPool::WorkerLoop() {
+  std::unique_lock<std::mutex> lock(mutex_);
+  while (true) {
+    work_cv_.wait(lock, [this] { return !work_.empty() || stopping_; });
+    if (work_.empty()) {
+      return; // Stopping and drained
+    }
+    std::function<void()> job = std::move(work_.front());
+    work_.pop_front();
+    lock.unlock();
+    job();
+    lock.lock();
+  }
+}
@@ -1,22 +1,94 @@
 #include "FileTransferHandler.h"
 
+#include "Crc32c.h"
+#include "Logger.h"
+#include "MessageSerialization.h"
+#include "Xxh64.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstring> // For strerror
 #include <filesystem> // For creating directories (C++17)
-#include <iostream>
+#include <fstream>
+#include <vector>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#endif
 
 // Define a directory to store incoming files
 const std::string kIncomingFilesDir = "incoming_files";
+// Uploads with a content hash are stored here once, named by ContentKey
+const std::string kContentStoreDir = kIncomingFilesDir + "/store";
+
+const size_t FileTransferHandler::kMaxUnwrittenUploadBytes;
+const size_t FileTransferHandler::kMaxUploadsPerClient;
+
+namespace {
 
 /**
- * @brief Destroys the FileTransferHandler. Closes any open file streams.
+ * @brief A file being hashed through an event loop's ring, one read at a time.
  */
-FileTransferHandler::~FileTransferHandler() {
-  std::lock_guard<std::mutex> lock(transfers_mutex_);
-  for (auto &pair : incoming_transfers_) {
-    IncomingFileTransfer &transfer = pair.second;
-    if (transfer.file_stream.is_open()) {
-      transfer.file_stream.close();
-    }
+struct RingReadBack {
+  EventLoop *event_loop;
+  NativeFileHandle file; /**< Open, and closed with the read back. */
+  std::vector<char> buffer;
+  uint64_t offset = 0;
+  Xxh64 hasher;
+  std::function<void(bool complete, uint64_t file_size, uint64_t hash)> on_done;
+
+  ~RingReadBack() {
+#ifdef _WIN32
+    CloseHandle(file);
+#else
+    close(file);
+#endif
   }
+};
+
+/**
+ * @brief Reads the next part of a file on the ring, until its end or an error.
+ * @param read_back The file and what was hashed so far.
+ */
+void ReadBackNext(const std::shared_ptr<RingReadBack> &read_back) {
+  read_back->event_loop->ReadFile(
+      read_back->file, read_back->buffer.data(), read_back->buffer.size(), read_back->offset,
+      [read_back](int result) {
+        if (result == -EINTR || result == -EAGAIN) {
+          ReadBackNext(read_back);
+        } else if (result < 0) {
+          CHAT_LOG_ERROR("Error reading uploaded file back: " << strerror(-result));
+          read_back->on_done(false, read_back->offset, 0);
+        } else if (result == 0) {
+          read_back->on_done(true, read_back->offset, read_back->hasher.Digest());
+        } else {
+          read_back->hasher.Update(read_back->buffer.data(), static_cast<size_t>(result));
+          read_back->offset += static_cast<uint64_t>(result);
+          ReadBackNext(read_back);
+        }
+      });
+}
+
+} // namespace
+
+/**
+ * @brief Constructs a new FileTransferHandler.
+ *
+ * @param disk_threads Number of I/O threads writing uploads to disk.
+ */
+FileTransferHandler::FileTransferHandler(size_t disk_threads) : disk_writer_(disk_threads) {}
+
+/**
+ * @brief Destroys the FileTransferHandler. Finishes pending disk writes and
+ * closes any open files.
+ */
+FileTransferHandler::~FileTransferHandler() {
+  // Completion callbacks reference the shards, so let them run first
+  disk_writer_.Shutdown();
 }
 
 /**
@@ -24,12 +96,12 @@ FileTransferHandler::~FileTransferHandler() {
  *
  * Processes messages based on their type (request, data chunk, complete).
  *
- * @param message The deserialized Message object received.
+ * @param message View of the received message.
  * @param sender The client handler that received the message.
  * @param server A pointer to the Server instance for interactions.
  * @return True if the message was handled by this handler, false otherwise.
  */
-bool FileTransferHandler::HandleMessage(const Message &message, IClientHandler *sender, Server *server) {
+bool FileTransferHandler::HandleMessage(const MessageView &message, IClientHandler *sender, Server *server) {
   switch (message.header.type) {
   case MessageType::FILE_TRANSFER_REQUEST:
     return HandleFileTransferRequest(message, sender, server);
@@ -40,11 +112,35 @@ bool FileTransferHandler::HandleMessage(const Message &message, IClientHandler *
   case MessageType::FILE_TRANSFER_ERROR: {
     return HandleFileTransferError(message, sender, server);
   }
+  case MessageType::FILE_TRANSFER_ACK:
+    return HandleFileTransferAck(message, sender, server);
   default:
     return false;
   }
 }
 
+/**
+ * @brief Gets the message types this handler consumes.
+ *
+ * @return The file transfer message types.
+ */
+std::vector<MessageType> FileTransferHandler::GetHandledTypes() const {
+  return {MessageType::FILE_TRANSFER_REQUEST, MessageType::FILE_DATA_CHUNK, MessageType::FILE_TRANSFER_COMPLETE,
+          MessageType::FILE_TRANSFER_ERROR, MessageType::FILE_TRANSFER_ACK};
+}
+
+/**
+ * @brief Tells whether a message type is cheap enough to handle on the I/O thread.
+ *
+ * Requests, chunks and completions touch files; acks are only relayed.
+ *
+ * @param type The message type.
+ * @return True for FILE_TRANSFER_ACK.
+ */
+bool FileTransferHandler::IsInlineSafe(MessageType type) const {
+  return type == MessageType::FILE_TRANSFER_ACK;
+}
+
 /**
  * @brief Handles a file transfer request message.
  *
@@ -55,91 +151,171 @@ bool FileTransferHandler::HandleMessage(const Message &message, IClientHandler *
  * @param server A pointer to the Server instance.
  * @return True if the request was processed successfully, false otherwise.
  */
-bool FileTransferHandler::HandleFileTransferRequest(const Message &message, IClientHandler *sender, Server *server) {
+bool FileTransferHandler::HandleFileTransferRequest(const MessageView &message, IClientHandler *sender,
+                                                    Server *server) {
+  uint32_t transfer_id = message.header.transfer_id;
   if (message.payload.empty()) {
-    std::cerr << "File transfer request received with empty payload from client " << sender->GetClientId() << std::endl;
-    SendFileTransferError(sender->GetClientId(), "Invalid file transfer request.", server);
+    CHAT_LOG_ERROR("File transfer request received with empty payload from client " << sender->GetClientId());
+    SendFileTransferError(sender->GetClientId(), transfer_id, "Invalid file transfer request.", server);
     return true;
   }
 
-  // Payload is expected to be "recipient_id:file_name:file_size"
-  std::string payload_str(message.payload.begin(), message.payload.end());
-  size_t first_colon = payload_str.find(':');
-  size_t second_colon = payload_str.find(':', first_colon + 1);
-
-  if (first_colon == std::string::npos || second_colon == std::string::npos) {
-    std::cerr << "Invalid file transfer request format from client " << sender->GetClientId() << std::endl;
-    SendFileTransferError(sender->GetClientId(), "Invalid file transfer request format.", server);
+  // Payload is expected to be "recipient_id:file_name:file_size[;options]"
+  FileTransferRequest request;
+  if (!ParseFileTransferRequest(message.payload, request)) {
+    CHAT_LOG_ERROR("Invalid file transfer request format from client " << sender->GetClientId());
+    SendFileTransferError(sender->GetClientId(), transfer_id, "Invalid file transfer request format.", server);
     return true;
   }
 
   try {
-    int recipient_id = std::stoi(payload_str.substr(0, first_colon));
-    std::string file_name = payload_str.substr(first_colon + 1, second_colon - first_colon - 1);
-    size_t file_size = std::stoull(payload_str.substr(second_colon + 1));
+    int recipient_id = request.recipient_id;
+    std::string file_name = request.file_name;
+    size_t file_size = request.file_size;
 
-    std::cout << "Received file transfer request from client " << sender->GetClientId() << " to client " << recipient_id
-              << " for file: " << file_name << " (" << file_size << " bytes)" << std::endl;
+    CHAT_LOG_INFO("Received file transfer request from client " << sender->GetClientId() << " to client "
+                  << recipient_id << " for file: " << file_name << " (" << file_size << " bytes)");
 
     // Check if the recipient is the server itself (transfer to server)
     if (recipient_id == -1) { // Assuming -1 is a special ID for the server
-      std::lock_guard<std::mutex> lock(transfers_mutex_);
-      if (incoming_transfers_.count(sender->GetClientId())) {
-        std::cerr << "Client " << sender->GetClientId() << " already has an incoming transfer to server." << std::endl;
-        SendFileTransferError(sender->GetClientId(), "Another transfer is already in progress.", server);
+      TransferShard &shard = ShardFor(sender->GetClientId());
+      std::lock_guard<std::mutex> lock(shard.mutex);
+      if (shard.transfers.count(UploadKey(sender->GetClientId(), transfer_id))) {
+        CHAT_LOG_ERROR("Client " << sender->GetClientId() << " reused the ID of its upload " << transfer_id);
+        SendFileTransferError(sender->GetClientId(), transfer_id, "Transfer ID is already in use.", server);
+        return true;
+      }
+      size_t uploads_in_progress = 0;
+      for (const auto &entry : shard.transfers) {
+        if (entry.second->sender_id != sender->GetClientId()) {
+          continue;
+        }
+        ++uploads_in_progress;
+        if (entry.second->file_name == file_name) {
+          // Both uploads would write the same file
+          CHAT_LOG_ERROR("Client " << sender->GetClientId() << " is already uploading " << file_name);
+          SendFileTransferError(sender->GetClientId(), transfer_id, "A file with this name is already being uploaded.",
+                                server);
+          return true;
+        }
+      }
+      if (uploads_in_progress >= kMaxUploadsPerClient) {
+        CHAT_LOG_ERROR("Client " << sender->GetClientId() << " has too many uploads in progress.");
+        SendFileTransferError(sender->GetClientId(), transfer_id, "Too many transfers in progress.", server);
         return true;
       }
 
       // Create the incoming files directory if it doesn't exist
       std::filesystem::create_directories(kIncomingFilesDir);
+      std::filesystem::create_directories(kContentStoreDir);
 
       // Create a unique filename on the server to avoid conflicts
       std::string unique_file_name = kIncomingFilesDir + "/" + std::to_string(sender->GetClientId()) + "_" + file_name;
-      std::ofstream output_file(unique_file_name, std::ios::binary);
+      auto transfer = std::make_shared<IncomingFileTransfer>(file_name, file_size, sender->GetClientId(),
+                                                             -1, transfer_id); // Recipient -1 for server
+      transfer->final_path = unique_file_name;
+      transfer->part_path = unique_file_name;
+
+      // Content-addressed uploads are deduplicated against the store and
+      // resume from a partial upload of the same content. An identical upload
+      // that is still running is left alone; this one is then stored plainly.
+      uint64_t resume_offset = 0;
+      if (request.has_content_hash) {
+        std::string content_key = ContentKey(request.content_hash, file_size);
+        std::lock_guard<std::mutex> store_lock(store_mutex_);
+        if (!active_content_.count(content_key)) {
+          std::error_code ec;
+          std::string stored_path = kContentStoreDir + "/" + content_key;
+          if (std::filesystem::is_regular_file(stored_path, ec) &&
+              std::filesystem::file_size(stored_path, ec) == file_size) {
+            transfer->deduplicated = true;
+          } else {
+            auto partial = partial_uploads_.find(content_key);
+            if (partial != partial_uploads_.end() && request.chunk_size > 0) {
+              // Resume on a chunk boundary, so the sender's chunks line up with its checksums
+              resume_offset = std::min<uint64_t>(partial->second - partial->second % request.chunk_size, file_size);
+              partial_uploads_.erase(partial);
+            }
+          }
+          transfer->content_key = content_key;
+          transfer->content_hash = request.content_hash;
+          transfer->part_path = stored_path + ".part";
+          active_content_.insert(content_key);
+        }
+      }
 
-      if (!output_file.is_open()) {
-        std::cerr << "Failed to open file for writing: " << unique_file_name << std::endl;
-        SendFileTransferError(sender->GetClientId(), "Server failed to open file for writing.", server);
+      if (transfer->deduplicated) {
+        // Nothing to receive: the whole file is acked up front
+        transfer->received_size = file_size;
+        transfer->acked_size = file_size;
+        shard.transfers.emplace(UploadKey(sender->GetClientId(), transfer_id), std::move(transfer));
+        CHAT_LOG_INFO("Client " << sender->GetClientId() << " uploads " << file_name
+                      << ", which the server already stores.");
+        SendFileTransferAck(sender, transfer_id, file_size);
         return true;
       }
 
+      // A connection on an io_uring loop has its upload written by that ring
+      EventLoop *event_loop = sender->GetEventLoop();
+      if (event_loop && event_loop->SupportsFileIo()) {
+        transfer->event_loop = event_loop;
+      }
+
+      // Every completed disk write may free room for a further ack
+      std::weak_ptr<IncomingFileTransfer> weak_transfer = transfer;
+      transfer->file = WriteBehindFile::Open(
+          transfer->part_path, disk_writer_,
+          [this, weak_transfer, server](size_t) {
+            if (std::shared_ptr<IncomingFileTransfer> upload = weak_transfer.lock()) {
+              SendUploadAck(*upload, server);
+            }
+          },
+          resume_offset, transfer->event_loop);
+
+      if (!transfer->file) {
+        CHAT_LOG_ERROR("Failed to open file for writing: " << transfer->part_path);
+        ReleaseContent(*transfer, false);
+        SendFileTransferError(sender->GetClientId(), transfer_id, "Server failed to open file for writing.", server);
+        return true;
+      }
+      transfer->received_size = resume_offset;
+      transfer->acked_size = resume_offset;
+
       // Store the state of the incoming transfer
-      incoming_transfers_.emplace(sender->GetClientId(),
-                                  IncomingFileTransfer(file_name, file_size, sender->GetClientId(),
-                                                       -1)); // Recipient -1 for server
-      incoming_transfers_.at(sender->GetClientId()).file_stream = std::move(output_file);
-
-      std::cout << "Initiated incoming file transfer from client " << sender->GetClientId()
-                << " to server for file: " << file_name << std::endl;
-
-      // Acknowledge the request to the sender (optional, but good practice)
-      // Send a message back to the sender indicating the transfer is ready
-      Message ready_msg;
-      ready_msg.header.type = MessageType::FILE_TRANSFER_REQUEST;
-      ready_msg.header.sender_id = -1; // Server is the sender
-      ready_msg.header.recipient_id = sender->GetClientId();
-      std::string ready_payload = "READY";
-      ready_msg.payload.assign(ready_payload.begin(), ready_payload.end());
-      ready_msg.header.payload_size = ready_msg.payload.size();
-      sender->SendMessage(ready_msg);
-    } else {
-      IClientHandler *recipient_handler = server->GetClientHandler(recipient_id);
+      shard.transfers.emplace(UploadKey(sender->GetClientId(), transfer_id), std::move(transfer));
 
-      if (recipient_handler) {
+      if (resume_offset > 0) {
+        CHAT_LOG_INFO("Resuming incoming file transfer from client " << sender->GetClientId() << " for file: "
+                      << file_name << " at byte " << resume_offset);
+      } else {
+        CHAT_LOG_INFO("Initiated incoming file transfer from client " << sender->GetClientId()
+                      << " to server for file: " << file_name);
+      }
+
+      // The first ack tells the sender we are ready and where to start
+      SendFileTransferAck(sender, transfer_id, resume_offset);
+    } else {
+      std::shared_ptr<IClientHandler> recipient_handler = server->GetClientHandler(recipient_id);
+
+      if (recipient_handler && transfer_id != 0 && recipient_handler->GetProtocolVersion() < kProtocolVersionCompact) {
+        // The legacy header cannot carry the transfer ID the sender will match acks against
+        CHAT_LOG_ERROR("Recipient client " << recipient_id << " does not support transfer IDs.");
+        SendFileTransferError(sender->GetClientId(), transfer_id, "Recipient client does not support transfer IDs.",
+                              server);
+      } else if (recipient_handler) {
         // Forward the file transfer request message to the recipient
         recipient_handler->SendMessage(message);
-        std::cout << "Forwarded file transfer request from client " << sender->GetClientId() << " to client "
-                  << recipient_id << std::endl;
+        CHAT_LOG_INFO("Forwarded file transfer request from client " << sender->GetClientId() << " to client "
+                      << recipient_id);
       } else {
-        std::cerr << "Recipient client " << recipient_id << " not found for file transfer request from client "
-                  << sender->GetClientId() << std::endl;
-        SendFileTransferError(sender->GetClientId(), "Recipient client not found.", server);
+        CHAT_LOG_ERROR("Recipient client " << recipient_id << " not found for file transfer request from client "
+                       << sender->GetClientId());
+        SendFileTransferError(sender->GetClientId(), transfer_id, "Recipient client not found.", server);
       }
     }
   } catch (const std::exception &e) {
-    std::cerr << "Error parsing file transfer request from client " << sender->GetClientId() << ": " << e.what()
-              << std::endl;
-    SendFileTransferError(sender->GetClientId(), "Error processing file transfer request.", server);
+    CHAT_LOG_ERROR("Error parsing file transfer request from client " << sender->GetClientId() << ": " << e.what());
+    SendFileTransferError(sender->GetClientId(), transfer_id, "Error processing file transfer request.", server);
   }
 
   return true;
@@ -155,46 +331,71 @@ bool FileTransferHandler::HandleFileTransferRequest(const Message &message, ICli
  * @param server A pointer to the Server instance.
  * @return True if the chunk was processed successfully, false otherwise.
  */
-bool FileTransferHandler::HandleFileDataChunk(const Message &message, IClientHandler *sender, Server *server) {
+bool FileTransferHandler::HandleFileDataChunk(const MessageView &message, IClientHandler *sender, Server *server) {
   // Check if the chunk is for a transfer to the server
   if (message.header.recipient_id == -1) {
     // Incoming transfer to the server
-    std::lock_guard<std::mutex> lock(transfers_mutex_);
-    auto it = incoming_transfers_.find(message.header.sender_id);
+    std::shared_ptr<IncomingFileTransfer> transfer = FindTransfer(sender->GetClientId(), message.header.transfer_id);
 
-    if (it == incoming_transfers_.end()) {
-      std::cerr << "Received file data chunk for unknown transfer from client " << message.header.sender_id
-                << std::endl;
-      SendFileTransferError(sender->GetClientId(), "Received data for unknown transfer.", server);
+    if (!transfer) {
+      CHAT_LOG_RATE_LIMITED(LogLevel::ERROR,
+                            "Received file data chunk for unknown transfer from client " << message.header.sender_id);
+      SendFileTransferError(sender->GetClientId(), message.header.transfer_id, "Received data for unknown transfer.",
+                            server);
       return true;
     }
 
-    IncomingFileTransfer &transfer = it->second;
+    if ((message.header.flags & kCompactFlagChecksum) &&
+        Crc32c(message.payload.data(), message.payload.size()) != message.header.checksum) {
+      // Everything before this chunk was verified, so a retry can resume here
+      CHAT_LOG_RATE_LIMITED(LogLevel::ERROR,
+                            "Checksum mismatch in file data chunk from client " << sender->GetClientId());
+      SendFileTransferError(sender->GetClientId(), transfer->transfer_id, "Chunk checksum mismatch.", server);
+      AbandonUpload(transfer, true);
+      return true;
+    }
+
+    // Stage the chunk; the disk writer flushes it in the background
+    bool appended = false;
+    {
+      std::lock_guard<std::mutex> lock(transfer->mutex);
+      appended = !transfer->complete && transfer->file &&
+                 transfer->received_size + message.payload.size() <= transfer->total_size &&
+                 transfer->file->Append(message.payload.data(), message.payload.size());
+      if (appended) {
+        transfer->received_size += message.payload.size();
+      }
+    }
 
-    if (!transfer.file_stream.is_open()) {
-      std::cerr << "File stream not open for incoming transfer from client " << sender->GetClientId() << std::endl;
-      SendFileTransferError(sender->GetClientId(), "Internal server error during transfer.", server);
-      incoming_transfers_.erase(it); // Clean up state
+    if (!appended) {
+      CHAT_LOG_ERROR("Failed to write incoming transfer from client " << sender->GetClientId());
+      SendFileTransferError(sender->GetClientId(), transfer->transfer_id, "Internal server error during transfer.",
+                            server);
+      AbandonUpload(transfer, false); // Clean up state
       return true;
     }
 
-    // Write the received data chunk to the file
-    transfer.file_stream.write(message.payload.data(), message.payload.size());
-    transfer.received_size += message.payload.size();
+    SendUploadAck(*transfer, server);
   } else {
     // Client-to-client transfer, route the data chunk to the recipient
-    IClientHandler *recipient_handler =
+    std::shared_ptr<IClientHandler> recipient_handler =
         server->GetClientHandler(message.header.recipient_id); // Need a method in Server for this
 
     if (recipient_handler) {
-      // Forward the file data chunk message to the recipient
-      recipient_handler->SendMessage(message);
-      std::cout << "Forwarded file data chunk from client " << sender->GetClientId() << " to client "
-                << message.header.recipient_id << std::endl;
+      // Forward the file data chunk message to the recipient. When the framer
+      // detached the received frame and the recipient can decode its wire
+      // format, relay those bytes as they are instead of re-serializing them.
+      if (message.frame && (message.frame_version == kProtocolVersionLegacy ||
+                            recipient_handler->GetProtocolVersion() >= message.frame_version)) {
+        recipient_handler->SendFrame(message.frame);
+      } else {
+        recipient_handler->SendMessage(message);
+      }
     } else {
-      std::cerr << "Recipient client " << message.header.recipient_id << " not found for file data chunk from client "
-                << sender->GetClientId() << std::endl;
-      SendFileTransferError(sender->GetClientId(), "Recipient client disconnected during transfer.", server);
+      CHAT_LOG_RATE_LIMITED(LogLevel::ERROR, "Recipient client " << message.header.recipient_id
+                                             << " not found for file data chunk from client " << sender->GetClientId());
+      SendFileTransferError(sender->GetClientId(), message.header.transfer_id,
+                            "Recipient client disconnected during transfer.", server);
     }
   }
 
@@ -212,54 +413,50 @@ bool FileTransferHandler::HandleFileDataChunk(const Message &message, IClientHan
  * @return True if the completion message was processed successfully, false
  * otherwise.
  */
-bool FileTransferHandler::HandleFileTransferComplete(const Message &message, IClientHandler *sender, Server *server) {
+bool FileTransferHandler::HandleFileTransferComplete(const MessageView &message, IClientHandler *sender,
+                                                     Server *server) {
   // Check if the completion is for a transfer to the server
   if (message.header.recipient_id == -1) {
     // Incoming transfer to the server
-    std::lock_guard<std::mutex> lock(transfers_mutex_);
-    auto it = incoming_transfers_.find(message.header.sender_id);
+    std::shared_ptr<IncomingFileTransfer> transfer = FindTransfer(sender->GetClientId(), message.header.transfer_id);
 
-    if (it == incoming_transfers_.end()) {
-      std::cerr << "Received file transfer complete for unknown transfer from client " << message.header.sender_id
-                << std::endl;
-      SendFileTransferError(sender->GetClientId(), "Received completion for unknown transfer.", server);
+    if (!transfer) {
+      CHAT_LOG_ERROR("Received file transfer complete for unknown transfer from client " << message.header.sender_id);
+      SendFileTransferError(sender->GetClientId(), message.header.transfer_id,
+                            "Received completion for unknown transfer.", server);
       return true; // Handled, but it was for an unknown transfer
     }
 
-    IncomingFileTransfer &transfer = it->second;
-
-    if (transfer.file_stream.is_open()) {
-      transfer.file_stream.close();
+    {
+      std::lock_guard<std::mutex> lock(transfer->mutex);
+      if (transfer->complete) {
+        return true; // Already flushing
+      }
+      transfer->complete = true;
     }
 
-    std::cout << "File transfer complete from client " << sender->GetClientId()
-              << " to server for file: " << transfer.file_name << std::endl;
-
-    // Optional: Send a completion acknowledgment back to the sender
-    Message ack_msg;
-    ack_msg.header.type = MessageType::FILE_TRANSFER_COMPLETE; // Reuse type
-    ack_msg.header.sender_id = -1;                             // Server is the sender
-    ack_msg.header.recipient_id = sender->GetClientId();
-    std::string success_payload = "SUCCESS";
-    ack_msg.payload.assign(success_payload.begin(), success_payload.end());
-    ack_msg.header.payload_size = ack_msg.payload.size();
-    sender->SendMessage(ack_msg);
+    if (!transfer->file) {
+      // Deduplicated: the content is already stored
+      FinishUpload(transfer, true, server);
+      return true;
+    }
 
-    // Remove the transfer state
-    incoming_transfers_.erase(it);
+    // Confirm to the sender once everything staged has reached the disk
+    transfer->file->Finish(
+        [this, transfer, server](bool success) { FinishUpload(transfer, success, server); });
   } else {
     // Client-to-client transfer, route the completion message to the recipient
-    IClientHandler *recipient_handler =
+    std::shared_ptr<IClientHandler> recipient_handler =
         server->GetClientHandler(message.header.recipient_id); // Need a method in Server for this
 
     if (recipient_handler) {
       // Forward the file transfer complete message to the recipient
       recipient_handler->SendMessage(message);
-      std::cout << "Forwarded file transfer complete from client " << sender->GetClientId() << " to client "
-                << message.header.recipient_id << std::endl;
+      CHAT_LOG_INFO("Forwarded file transfer complete from client " << sender->GetClientId() << " to client "
+                    << message.header.recipient_id);
     } else {
-      std::cerr << "Recipient client " << message.header.recipient_id
-                << " not found for file transfer complete from client " << sender->GetClientId() << std::endl;
+      CHAT_LOG_ERROR("Recipient client " << message.header.recipient_id
+                     << " not found for file transfer complete from client " << sender->GetClientId());
     }
   }
 
@@ -276,53 +473,469 @@ bool FileTransferHandler::HandleFileTransferComplete(const Message &message, ICl
  * @param server A pointer to the Server instance.
  * @return True if the error was processed successfully, false otherwise.
  */
-bool FileTransferHandler::HandleFileTransferError(const Message &message, IClientHandler *sender, Server *server) {
+bool FileTransferHandler::HandleFileTransferError(const MessageView &message, IClientHandler *sender, Server *server) {
   std::string error_msg(message.payload.begin(), message.payload.end());
-  std::cerr << "Received file transfer error from client " << message.header.sender_id << ": " << error_msg
-            << std::endl;
-  {
-    std::lock_guard<std::mutex> lock(transfers_mutex_);
-    auto it = incoming_transfers_.find(message.header.sender_id);
-    if (it != incoming_transfers_.end()) {
-      if (it->second.file_stream.is_open()) {
-        it->second.file_stream.close();
-      }
-      incoming_transfers_.erase(it);
-      std::cout << "Cleaned up incoming transfer state for client " << message.header.sender_id << " due to error."
-                << std::endl;
+  CHAT_LOG_ERROR("Received file transfer error from client " << message.header.sender_id << ": " << error_msg);
+  if (message.header.recipient_id != -1) {
+    // Client-to-client transfer, let the other side cancel it too
+    std::shared_ptr<IClientHandler> recipient_handler = server->GetClientHandler(message.header.recipient_id);
+    if (recipient_handler) {
+      recipient_handler->SendMessage(message);
     }
+    return true;
+  }
+
+  std::shared_ptr<IncomingFileTransfer> transfer = FindTransfer(sender->GetClientId(), message.header.transfer_id);
+  if (transfer) {
+    // Let the pending writes finish, then close the partial file; it is
+    // kept for a later resume of the same content
+    AbandonUpload(transfer, true);
+    CHAT_LOG_INFO("Cleaned up incoming transfer state for client " << sender->GetClientId() << " due to error.");
+  }
+  return true;
+}
+
+/**
+ * @brief Handles a file transfer acknowledgement.
+ *
+ * Routes the receiver's cumulative ack back to the sending client.
+ *
+ * @param message The file transfer ack message.
+ * @param sender The client handler that sent the ack.
+ * @param server A pointer to the Server instance.
+ * @return True if the ack was processed, false otherwise.
+ */
+bool FileTransferHandler::HandleFileTransferAck(const MessageView &message, IClientHandler *sender, Server *server) {
+  if (message.header.recipient_id == -1) {
+    // The server never sends files, so nobody is waiting for this ack
+    CHAT_LOG_WARNING("Ignoring file transfer ack addressed to the server from client " << sender->GetClientId());
+    return true;
+  }
+
+  std::shared_ptr<IClientHandler> recipient_handler = server->GetClientHandler(message.header.recipient_id);
+  if (recipient_handler) {
+    recipient_handler->SendMessage(message);
+  } else {
+    CHAT_LOG_ERROR("Recipient client " << message.header.recipient_id
+                   << " not found for file transfer ack from client " << sender->GetClientId());
+    SendFileTransferError(sender->GetClientId(), message.header.transfer_id,
+                          "Sender client disconnected during transfer.", server);
   }
   return true;
 }
 
+/**
+ * @brief Sends a cumulative file transfer ack from the server to a client.
+ *
+ * @param sender The client handler uploading the file.
+ * @param transfer_id The client's ID for the upload.
+ * @param acked_bytes The number of bytes written so far.
+ */
+void FileTransferHandler::SendFileTransferAck(IClientHandler *sender, uint32_t transfer_id, size_t acked_bytes) {
+  std::string ack_payload = FormatFileTransferAck(acked_bytes);
+
+  Message ack_msg;
+  ack_msg.header.type = MessageType::FILE_TRANSFER_ACK;
+  ack_msg.header.sender_id = -1; // Server is the sender
+  ack_msg.header.recipient_id = sender->GetClientId();
+  ack_msg.header.transfer_id = transfer_id;
+  ack_msg.payload.assign(ack_payload.begin(), ack_payload.end());
+  ack_msg.header.payload_size = ack_msg.payload.size();
+  sender->SendMessage(ack_msg);
+}
+
 /**
  * @brief Sends a file transfer error message to a client.
  *
  * @param recipient_id The ID of the client to send the error to.
+ * @param transfer_id The transfer the error is about.
  * @param error_message The error description.
  * @param server A pointer to the Server instance.
  */
-void FileTransferHandler::SendFileTransferError(int recipient_id, const std::string &error_message, Server *server) {
+void FileTransferHandler::SendFileTransferError(int recipient_id, uint32_t transfer_id,
+                                                const std::string &error_message, Server *server) {
   if (server == nullptr) {
-    std::cerr << "Error: Server pointer is null when trying to send file "
-                 "transfer error."
-              << std::endl;
+    CHAT_LOG_ERROR("Error: Server pointer is null when trying to send file transfer error.");
     return;
   }
 
-  IClientHandler *recipient_handler = server->GetClientHandler(recipient_id); // Need a method in Server for this
+  std::shared_ptr<IClientHandler> recipient_handler = server->GetClientHandler(recipient_id);
 
   if (recipient_handler) {
     Message error_msg;
     error_msg.header.type = MessageType::FILE_TRANSFER_ERROR;
     error_msg.header.sender_id = -1; // Server is the sender
     error_msg.header.recipient_id = recipient_id;
+    error_msg.header.transfer_id = transfer_id;
     error_msg.payload.assign(error_message.begin(), error_message.end());
     error_msg.header.payload_size = error_msg.payload.size();
     recipient_handler->SendMessage(error_msg);
-    std::cerr << "Sent file transfer error to client " << recipient_id << ": " << error_message << std::endl;
+    CHAT_LOG_ERROR("Sent file transfer error to client " << recipient_id << ": " << error_message);
+  } else {
+    CHAT_LOG_ERROR("Could not find recipient client " << recipient_id << " to send file transfer error: "
+                   << error_message);
+  }
+}
+
+/**
+ * @brief Combines a client ID and its transfer ID into an upload table key.
+ * @param sender_id The uploading client's ID.
+ * @param transfer_id The client's ID for the upload.
+ * @return The key.
+ */
+uint64_t FileTransferHandler::UploadKey(int sender_id, uint32_t transfer_id) {
+  return (static_cast<uint64_t>(static_cast<uint32_t>(sender_id)) << 32) | transfer_id;
+}
+
+/**
+ * @brief Gets the shard holding a client's uploads.
+ * @param sender_id The uploading client's ID.
+ * @return The shard.
+ */
+FileTransferHandler::TransferShard &FileTransferHandler::ShardFor(int sender_id) {
+  return transfer_shards_[static_cast<unsigned int>(sender_id) % kTransferShardCount];
+}
+
+/**
+ * @brief Looks up an upload.
+ * @param sender_id The uploading client's ID.
+ * @param transfer_id The client's ID for the upload.
+ * @return The transfer, or nullptr if there is none.
+ */
+std::shared_ptr<FileTransferHandler::IncomingFileTransfer> FileTransferHandler::FindTransfer(int sender_id,
+                                                                                             uint32_t transfer_id) {
+  TransferShard &shard = ShardFor(sender_id);
+  std::lock_guard<std::mutex> lock(shard.mutex);
+  auto it = shard.transfers.find(UploadKey(sender_id, transfer_id));
+  return it != shard.transfers.end() ? it->second : nullptr;
+}
+
+/**
+ * @brief Removes an upload if its table entry is still that transfer.
+ * @param transfer The transfer to remove.
+ */
+void FileTransferHandler::EraseTransfer(const std::shared_ptr<IncomingFileTransfer> &transfer) {
+  TransferShard &shard = ShardFor(transfer->sender_id);
+  std::lock_guard<std::mutex> lock(shard.mutex);
+  auto it = shard.transfers.find(UploadKey(transfer->sender_id, transfer->transfer_id));
+  if (it != shard.transfers.end() && it->second == transfer) {
+    shard.transfers.erase(it);
+  }
+}
+
+/**
+ * @brief Acks as much of an upload as the disk backlog allows.
+ *
+ * @param transfer The upload.
+ * @param server A pointer to the Server instance.
+ */
+void FileTransferHandler::SendUploadAck(IncomingFileTransfer &transfer, Server *server) {
+  std::lock_guard<std::mutex> lock(transfer.mutex);
+  size_t written_bytes = transfer.file ? transfer.file->GetWrittenBytes() : transfer.received_size;
+  size_t ackable = std::min(transfer.received_size, written_bytes + kMaxUnwrittenUploadBytes);
+  if (ackable <= transfer.acked_size) {
+    return;
+  }
+
+  std::shared_ptr<IClientHandler> uploader = server->GetClientHandler(transfer.sender_id);
+  if (uploader) {
+    transfer.acked_size = ackable;
+    SendFileTransferAck(uploader.get(), transfer.transfer_id, ackable);
+  }
+}
+
+/**
+ * @brief Reports the outcome of an upload once its last write completed.
+ *
+ * @param transfer The finished upload.
+ * @param success Whether every write succeeded.
+ * @param server A pointer to the Server instance.
+ */
+void FileTransferHandler::FinishUpload(const std::shared_ptr<IncomingFileTransfer> &transfer, bool success,
+                                       Server *server) {
+  EraseTransfer(transfer);
+
+  if (success && !transfer->content_key.empty() && !transfer->deduplicated && transfer->event_loop) {
+    // Its last write completed on the loop thread: hash the file back through
+    // the ring, and leave the renaming and linking to an I/O thread
+    VerifyContentOnLoop(transfer, [this, transfer, server](bool matches) {
+      disk_writer_.Submit([this, transfer, server, matches] { StoreUpload(transfer, matches, true, server); });
+    });
+    return;
+  }
+  StoreUpload(transfer, success, false, server);
+}
+
+/**
+ * @brief Moves a finished upload into the store, if it is content addressed, and reports the outcome.
+ *
+ * @param transfer The finished upload.
+ * @param success Whether every write (and the check of its hash, if done already) succeeded.
+ * @param hash_checked Whether the file was verified against its content hash already.
+ * @param server A pointer to the Server instance.
+ */
+void FileTransferHandler::StoreUpload(const std::shared_ptr<IncomingFileTransfer> &transfer, bool success,
+                                      bool hash_checked, Server *server) {
+  if (!transfer->content_key.empty()) {
+    // Verify and store new content, then give the upload its usual name
+    if (success && !transfer->deduplicated) {
+      success = CommitToStore(*transfer, hash_checked);
+    }
+    if (success) {
+      success = LinkStoredContent(*transfer);
+    }
+    ReleaseContent(*transfer, false);
+  }
+
+  if (!success) {
+    CHAT_LOG_ERROR("Failed to write file " << transfer->file_name << " uploaded by client " << transfer->sender_id);
+    SendFileTransferError(transfer->sender_id, transfer->transfer_id, "Server failed to write file.", server);
+    return;
+  }
+
+  CHAT_LOG_INFO("File transfer complete from client " << transfer->sender_id << " to server for file: "
+                << transfer->file_name);
+
+  // Everything is on disk now, so the final ack covers all received bytes
+  SendUploadAck(*transfer, server);
+
+  std::shared_ptr<IClientHandler> uploader = server->GetClientHandler(transfer->sender_id);
+  if (uploader) {
+    // Optional: Send a completion acknowledgment back to the sender
+    Message ack_msg;
+    ack_msg.header.type = MessageType::FILE_TRANSFER_COMPLETE; // Reuse type
+    ack_msg.header.sender_id = -1;                             // Server is the sender
+    ack_msg.header.recipient_id = transfer->sender_id;
+    ack_msg.header.transfer_id = transfer->transfer_id;
+    std::string success_payload = "SUCCESS";
+    ack_msg.payload.assign(success_payload.begin(), success_payload.end());
+    ack_msg.header.payload_size = ack_msg.payload.size();
+    uploader->SendMessage(ack_msg);
+  }
+}
+
+/**
+ * @brief Handles a client disconnecting: its unfinished uploads are kept
+ * aside so that the same content can resume after a reconnect.
+ *
+ * @param client_id The ID of the disconnected client.
+ * @param server A pointer to the Server instance.
+ */
+void FileTransferHandler::OnClientDisconnected(int client_id, Server *server) {
+  (void)server;
+  std::vector<std::shared_ptr<IncomingFileTransfer>> uploads;
+  {
+    TransferShard &shard = ShardFor(client_id);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    for (const auto &entry : shard.transfers) {
+      if (entry.second->sender_id == client_id) {
+        uploads.push_back(entry.second);
+      }
+    }
+  }
+
+  for (const auto &upload : uploads) {
+    {
+      std::lock_guard<std::mutex> lock(upload->mutex);
+      if (upload->complete) {
+        continue; // Already flushing; FinishUpload cleans up
+      }
+    }
+    CHAT_LOG_INFO("Keeping partial upload of " << upload->file_name << " (" << upload->received_size
+                  << " bytes) from disconnected client " << client_id);
+    AbandonUpload(upload, true);
+  }
+}
+
+/**
+ * @brief Builds the store name of a file's content.
+ * @param content_hash The XXH64 of the file.
+ * @param file_size The size of the file.
+ * @return The key, "<16 hex digits>-<size>".
+ */
+std::string FileTransferHandler::ContentKey(uint64_t content_hash, uint64_t file_size) {
+  char hash_hex[17];
+  std::snprintf(hash_hex, sizeof(hash_hex), "%016llx", static_cast<unsigned long long>(content_hash));
+  return std::string(hash_hex) + "-" + std::to_string(file_size);
+}
+
+/**
+ * @brief Stops receiving an upload that did not complete.
+ *
+ * @param transfer The upload.
+ * @param keep_partial Whether the received bytes may be resumed later.
+ */
+void FileTransferHandler::AbandonUpload(const std::shared_ptr<IncomingFileTransfer> &transfer, bool keep_partial) {
+  EraseTransfer(transfer);
+  if (!transfer->file) {
+    ReleaseContent(*transfer, false);
+    return;
+  }
+  if (transfer->content_key.empty()) {
+    transfer->file->Finish(nullptr);
+    return;
+  }
+
+  if (keep_partial) {
+    // Offer the bytes for resuming right away: writes still in flight cover
+    // only offsets below the resume point, which a resumed upload never touches
+    ReleaseContent(*transfer, true);
+    transfer->file->Finish([this, transfer](bool success) {
+      if (!success) {
+        DropPartialUpload(transfer->content_key, transfer->part_path);
+      }
+    });
+  } else {
+    transfer->file->Finish([this, transfer](bool) { ReleaseContent(*transfer, false); });
+  }
+}
+
+/**
+ * @brief Ends a content-addressed upload's claim on its content.
+ *
+ * @param transfer The upload.
+ * @param keep_partial Whether to remember the received bytes for a resume
+ * instead of deleting the partial file.
+ */
+void FileTransferHandler::ReleaseContent(const IncomingFileTransfer &transfer, bool keep_partial) {
+  if (transfer.content_key.empty()) {
+    return;
+  }
+
+  std::lock_guard<std::mutex> lock(store_mutex_);
+  active_content_.erase(transfer.content_key);
+  if (transfer.deduplicated) {
+    return;
+  }
+  if (keep_partial && transfer.received_size > 0) {
+    partial_uploads_[transfer.content_key] = transfer.received_size;
   } else {
-    std::cerr << "Could not find recipient client " << recipient_id << " to send file transfer error: " << error_message
-              << std::endl;
+    std::error_code ec;
+    std::filesystem::remove(transfer.part_path, ec);
+  }
+}
+
+/**
+ * @brief Forgets a partial upload whose data turned out to be unusable.
+ *
+ * @param content_key The key of the content.
+ * @param part_path The partial file.
+ */
+void FileTransferHandler::DropPartialUpload(const std::string &content_key, const std::string &part_path) {
+  std::lock_guard<std::mutex> lock(store_mutex_);
+  if (partial_uploads_.erase(content_key) > 0) {
+    std::error_code ec;
+    std::filesystem::remove(part_path, ec);
+  }
+}
+
+/**
+ * @brief Reads a finished content-addressed upload back through its event
+ * loop's ring and checks it against the announced size and hash.
+ *
+ * One read of kWriteBatchSize bytes is in flight at a time, each completing
+ * on the loop thread, so the hash costs the loop no blocking read.
+ *
+ * @param transfer The upload; its event_loop is set.
+ * @param on_done Receives whether the file matches, on the loop thread.
+ */
+void FileTransferHandler::VerifyContentOnLoop(const std::shared_ptr<IncomingFileTransfer> &transfer,
+                                              std::function<void(bool matches)> on_done) {
+#ifdef _WIN32
+  NativeFileHandle file = CreateFileA(transfer->part_path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr,
+                                      OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+  bool opened = file != INVALID_HANDLE_VALUE;
+#else
+  NativeFileHandle file = open(transfer->part_path.c_str(), O_RDONLY | O_CLOEXEC);
+  bool opened = file >= 0;
+#endif
+  if (!opened) {
+    CHAT_LOG_ERROR("Failed to reopen uploaded file " << transfer->part_path);
+    on_done(false);
+    return;
   }
+
+  auto read_back = std::make_shared<RingReadBack>(); // Closes the file when the last read is done
+  read_back->file = file;
+  read_back->event_loop = transfer->event_loop;
+  read_back->buffer.resize(WriteBehindFile::kWriteBatchSize);
+  read_back->on_done = [transfer, on_done](bool complete, uint64_t file_size, uint64_t hash) {
+    bool matches = complete && file_size == transfer->total_size && hash == transfer->content_hash;
+    if (complete && !matches) {
+      CHAT_LOG_ERROR("Uploaded file " << transfer->file_name << " does not match its content hash.");
+    }
+    on_done(matches);
+  };
+  ReadBackNext(read_back);
+}
+
+/**
+ * @brief Verifies a finished content-addressed upload and moves it into the store.
+ *
+ * Unless hash_checked, reads the file back, so it runs on an I/O thread.
+ *
+ * @param transfer The upload.
+ * @param hash_checked Whether the file was verified already.
+ * @return False if the file does not match the announced size and hash.
+ */
+bool FileTransferHandler::CommitToStore(const IncomingFileTransfer &transfer, bool hash_checked) {
+  if (!hash_checked) {
+    std::ifstream input(transfer.part_path, std::ios::binary);
+    if (!input.is_open()) {
+      CHAT_LOG_ERROR("Failed to reopen uploaded file " << transfer.part_path);
+      return false;
+    }
+
+    Xxh64 hasher;
+    std::vector<char> buffer(WriteBehindFile::kWriteBatchSize);
+    uint64_t file_size = 0;
+    while (input) {
+      input.read(buffer.data(), buffer.size());
+      std::streamsize bytes_read = input.gcount();
+      if (bytes_read > 0) {
+        hasher.Update(buffer.data(), static_cast<size_t>(bytes_read));
+        file_size += static_cast<uint64_t>(bytes_read);
+      }
+    }
+    input.close();
+
+    if (file_size != transfer.total_size || hasher.Digest() != transfer.content_hash) {
+      CHAT_LOG_ERROR("Uploaded file " << transfer.file_name << " does not match its content hash.");
+      return false;
+    }
+  }
+
+  std::error_code ec;
+  std::filesystem::rename(transfer.part_path, kContentStoreDir + "/" + transfer.content_key, ec);
+  if (ec) {
+    CHAT_LOG_ERROR("Failed to store uploaded file " << transfer.file_name << ": " << ec.message());
+    return false;
+  }
+  return true;
+}
+
+/**
+ * @brief Makes stored content available under the upload's file name.
+ *
+ * Uses a hard link, so duplicates take no extra space, and falls back to a
+ * copy where links are not supported.
+ *
+ * @param transfer The upload.
+ * @return False if the file could not be created.
+ */
+bool FileTransferHandler::LinkStoredContent(const IncomingFileTransfer &transfer) {
+  std::string stored_path = kContentStoreDir + "/" + transfer.content_key;
+  std::error_code ec;
+  std::filesystem::remove(transfer.final_path, ec);
+  std::filesystem::create_hard_link(stored_path, transfer.final_path, ec);
+  if (ec) {
+    ec.clear();
+    std::filesystem::copy_file(stored_path, transfer.final_path, std::filesystem::copy_options::overwrite_existing,
+                               ec);
+  }
+  if (ec) {
+    CHAT_LOG_ERROR("Failed to create " << transfer.final_path << ": " << ec.message());
+    return false;
+  }
+  return true;
 }
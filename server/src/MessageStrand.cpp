@@ -0,0 +1,145 @@
+#include "MessageStrand.h"
+
+#include <utility>
+
+// Tasks run per turn on a worker before the strand queues itself again
+const int kMaxTasksPerBatch = 64;
+
+/**
+ * @brief Constructs an idle strand.
+ *
+ * @param executor The executor running the tasks; must outlive the strand.
+ * @param max_queued_bytes Queued bytes at which Post reports FULL (0 = unbounded).
+ */
+MessageStrand::MessageStrand(WorkStealingExecutor *executor, size_t max_queued_bytes)
+    : executor_(executor), max_queued_bytes_(max_queued_bytes), queued_bytes_(0), scheduled_(false), full_(false),
+      closed_(false) {}
+
+/**
+ * @brief Destroys the strand after closing it.
+ */
+MessageStrand::~MessageStrand() {
+  Close();
+}
+
+/**
+ * @brief Sets what runs once a strand that reported FULL drained to half its bound.
+ * @param callback The callback.
+ */
+void MessageStrand::SetSpaceCallback(Task callback) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  space_callback_ = std::move(callback);
+}
+
+/**
+ * @brief Queues a task behind the ones already posted, without waiting.
+ *
+ * @param task The task to run.
+ * @param bytes Size of the data the task holds, counted against the bound.
+ * @return QUEUED, FULL if the queued bytes reached the bound, or CLOSED.
+ */
+MessageStrand::PostResult MessageStrand::Post(Task task, size_t bytes) {
+  std::unique_lock<std::mutex> lock(mutex_);
+  if (closed_) {
+    return PostResult::CLOSED;
+  }
+  queue_.push_back(Entry{std::move(task), bytes});
+  queued_bytes_ += bytes;
+  if (bytes > 0 && max_queued_bytes_ > 0 && queued_bytes_ >= max_queued_bytes_) {
+    full_ = true;
+  }
+  PostResult result = full_ ? PostResult::FULL : PostResult::QUEUED;
+  if (scheduled_) {
+    return result; // The running batch picks it up
+  }
+  scheduled_ = true;
+  lock.unlock();
+
+  executor_->Submit([this] { RunBatch(); });
+  return result;
+}
+
+/**
+ * @brief Checks whether a Post reported FULL and the space callback has not
+ * run since.
+ *
+ * @return True if the poster should hold back.
+ */
+bool MessageStrand::IsFull() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return full_;
+}
+
+/**
+ * @brief Waits until IsFull is false or the strand is closed.
+ */
+void MessageStrand::WaitForSpace() {
+  std::unique_lock<std::mutex> lock(mutex_);
+  state_cv_.wait(lock, [this] { return closed_ || !full_; });
+}
+
+/**
+ * @brief Checks whether no task is queued or running.
+ * @return True if the strand is idle.
+ */
+bool MessageStrand::IsIdle() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return !scheduled_;
+}
+
+/**
+ * @brief Drops the queued tasks and waits for the running one to finish.
+ */
+void MessageStrand::Close() {
+  std::deque<Entry> dropped;
+  std::unique_lock<std::mutex> lock(mutex_);
+  closed_ = true;
+  dropped.swap(queue_);
+  queued_bytes_ = 0;
+  state_cv_.notify_all(); // Release a WaitForSpace
+  state_cv_.wait(lock, [this] { return !scheduled_; });
+  lock.unlock();
+  // The dropped tasks' captures are released outside the lock
+}
+
+/**
+ * @brief Runs a batch of queued tasks on an executor thread.
+ */
+void MessageStrand::RunBatch() {
+  for (int run = 0; run < kMaxTasksPerBatch; ++run) {
+    Entry entry;
+    bool notify_space = false;
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      if (queue_.empty()) {
+        scheduled_ = false;
+        state_cv_.notify_all(); // Idle now, for Close
+        return;
+      }
+      entry = std::move(queue_.front());
+      queue_.pop_front();
+      queued_bytes_ -= entry.bytes;
+      // Half the bound free again, so a resumed reader does not refill it at once
+      if (full_ && queued_bytes_ <= max_queued_bytes_ / 2) {
+        full_ = false;
+        notify_space = true;
+        state_cv_.notify_all(); // For WaitForSpace
+      }
+    }
+    if (notify_space && space_callback_) {
+      space_callback_();
+    }
+    entry.task();
+  }
+
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (queue_.empty()) {
+      scheduled_ = false;
+      state_cv_.notify_all();
+      return;
+    }
+  }
+  // More work left: queue up again behind the other strands
+  executor_->Submit([this] { RunBatch(); });
+}
@@ -0,0 +1,255 @@
+#include "OutboundQueue.h"
+
+#include <algorithm>
+#include <chrono>
+#include <utility>
+
+#include "MessagePriority.h"
+#include "Metrics.h"
+
+/**
+ * @brief Constructs a new OutboundQueue.
+ * @param options The queue limits and overflow policy.
+ */
+OutboundQueue::OutboundQueue(const OutboundQueueOptions &options)
+    : options_(options), front_offset_(0), queued_bytes_(0), dropped_frames_(0), closed_(false) {
+  options_.max_batch_frames = std::max<size_t>(1, options_.max_batch_frames);
+}
+
+/**
+ * @brief Appends a serialized frame to the queue.
+ *
+ * The byte limit is soft: a frame is always accepted into an otherwise empty
+ * queue, and frames that are already being written count against the limit
+ * but cannot be dropped.
+ *
+ * @param frame The frame to queue (shared, never modified).
+ * @return The outcome of the push.
+ */
+OutboundQueue::PushResult OutboundQueue::Push(SharedFrame frame) {
+  if (closed_.load()) {
+    return PushResult::CLOSED;
+  }
+
+  if (!frame || frame->empty()) {
+    return PushResult::QUEUED;
+  }
+
+  size_t size = frame->size();
+  size_t queued = queued_bytes_.load(std::memory_order_relaxed);
+  Metrics::Record(MetricHistogram::OUTBOUND_QUEUE_BYTES, queued);
+  if (queued == 0 || queued + size <= options_.max_queued_bytes) {
+    // Fast path: no lock, the writer schedules the frame with its next batch
+    queued_bytes_.fetch_add(size, std::memory_order_relaxed);
+    incoming_.Push(std::move(frame));
+    return PushResult::QUEUED;
+  }
+
+  if (options_.overflow_policy == OverflowPolicy::DISCONNECT) {
+    return PushResult::LIMIT_EXCEEDED;
+  }
+
+  // Overflow: make room now, the writer may be stalled on a slow client.
+  // Everything pushed so far is older than this frame, so take it first.
+  PushResult result = PushResult::QUEUED;
+  {
+    std::lock_guard<std::mutex> lock(writer_mutex_);
+    TakeIncomingLocked();
+    if (DropOldestLocked(size) > 0) {
+      result = PushResult::QUEUED_AFTER_DROP;
+    }
+    queued_bytes_.fetch_add(size, std::memory_order_relaxed);
+    incoming_.Push(std::move(frame));
+  }
+  return result;
+}
+
+/**
+ * @brief Collects the next batch of pending bytes for a gathered write.
+ *
+ * A partially written frame comes first, followed by frames in schedule order.
+ *
+ * @param buffers Output vector receiving up to max_batch_frames buffers.
+ * @return The total number of bytes described by the buffers.
+ */
+size_t OutboundQueue::Gather(std::vector<IoBuffer> &buffers) {
+  buffers.clear();
+
+  std::lock_guard<std::mutex> lock(writer_mutex_);
+  TakeIncomingLocked();
+  if (!schedule_) {
+    return 0;
+  }
+
+  std::deque<FrameScheduler::Entry> &in_flight = schedule_->in_flight;
+  FrameScheduler::Entry entry;
+  while (in_flight.size() < options_.max_batch_frames && schedule_->pending.Pop(entry)) {
+    in_flight.push_back(std::move(entry));
+  }
+
+  size_t total = 0;
+  for (size_t i = 0; i < in_flight.size(); ++i) {
+    const PooledBuffer &frame = *in_flight[i].item;
+    size_t offset = (i == 0) ? front_offset_ : 0;
+    buffers.push_back({frame.data() + offset, frame.size() - offset});
+    total += frame.size() - offset;
+  }
+  return total;
+}
+
+/**
+ * @brief Releases bytes that were written after a Gather call.
+ *
+ * @param bytes_sent Number of bytes the socket accepted.
+ */
+void OutboundQueue::Consume(size_t bytes_sent) {
+  std::lock_guard<std::mutex> lock(writer_mutex_);
+  queued_bytes_.fetch_sub(bytes_sent, std::memory_order_relaxed);
+  if (!schedule_) {
+    return;
+  }
+
+  std::deque<FrameScheduler::Entry> &in_flight = schedule_->in_flight;
+  while (bytes_sent > 0 && !in_flight.empty()) {
+    size_t remaining = in_flight.front().item->size() - front_offset_;
+    if (bytes_sent < remaining) {
+      front_offset_ += bytes_sent;
+      break;
+    }
+    bytes_sent -= remaining;
+    in_flight.pop_front();
+    front_offset_ = 0;
+  }
+
+  // Frames the write did not reach compete again with newer, more urgent ones
+  size_t started = front_offset_ > 0 ? 1 : 0;
+  while (in_flight.size() > started) {
+    schedule_->pending.PushFront(std::move(in_flight.back()));
+    in_flight.pop_back();
+  }
+}
+
+/**
+ * @brief Blocks until there is something to write, the queue is closed or
+ * the timeout expires.
+ *
+ * @param timeout_ms Maximum time to wait in milliseconds, or -1 to wait indefinitely.
+ * @return False if the queue was closed.
+ */
+bool OutboundQueue::WaitForData(int timeout_ms) {
+  auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeout_ms);
+  while (!closed_.load() && IsEmpty()) {
+    // Idle: sleep until a push (or Close) wakes us
+    if (timeout_ms < 0) {
+      incoming_.Wait();
+    } else if (!incoming_.WaitUntil(deadline)) {
+      break;
+    }
+  }
+  return !closed_.load();
+}
+
+/**
+ * @brief Closes the queue: further pushes are rejected and waiters wake up.
+ */
+void OutboundQueue::Close() {
+  closed_.store(true);
+  incoming_.Wakeup();
+}
+
+/**
+ * @brief Checks whether any bytes are waiting to be written.
+ * @return True if the queue is empty.
+ */
+bool OutboundQueue::IsEmpty() const {
+  std::lock_guard<std::mutex> lock(writer_mutex_);
+  return IsEmptyLocked();
+}
+
+/**
+ * @brief Gets the number of frames discarded by the DROP_OLDEST policy.
+ * @return The dropped frame count.
+ */
+size_t OutboundQueue::GetDroppedFrameCount() const {
+  return dropped_frames_.load();
+}
+
+/**
+ * @brief Gets the number of bytes waiting to be written.
+ * @return The queued byte count.
+ */
+size_t OutboundQueue::GetQueuedBytes() const {
+  return queued_bytes_.load(std::memory_order_relaxed);
+}
+
+/**
+ * @brief Frees the writer's scheduling structures while nothing is queued.
+ *
+ * @return True if memory was released, false if frames are pending or it
+ * already was.
+ */
+bool OutboundQueue::ReleaseMemory() {
+  std::lock_guard<std::mutex> lock(writer_mutex_);
+  if (!schedule_ || !IsEmptyLocked()) {
+    return false;
+  }
+  schedule_.reset();
+  return true;
+}
+
+/**
+ * @brief Moves pushed frames into the scheduler. Caller holds writer_mutex_.
+ *
+ * Each frame's priority class and flow are read from its header.
+ */
+void OutboundQueue::TakeIncomingLocked() {
+  incoming_.PopAll([this](SharedFrame &&frame) {
+    MessageHeader header;
+    size_t header_size = 0;
+    int protocol_version = 0;
+    MessagePriority priority = MessagePriority::CONTROL;
+    uint64_t flow = 0;
+    if (DecodeMessageHeader(frame->data(), frame->size(), header, header_size, protocol_version) ==
+        HeaderDecodeStatus::OK) {
+      priority = GetMessagePriority(header.type);
+      flow = GetMessageFlow(header);
+    }
+    if (!schedule_) {
+      schedule_ = std::make_unique<Schedule>(options_.bulk_quantum_bytes);
+    }
+    size_t size = frame->size();
+    schedule_->pending.Push(std::move(frame), priority, flow, size);
+  });
+}
+
+/**
+ * @brief Drops chat frames until the new frame fits. Caller holds writer_mutex_.
+ *
+ * Frames handed out by Gather and a partially written frame are kept, and so
+ * are file and control frames: the queue then stays over its soft limit.
+ *
+ * @param incoming_size Size of the frame about to be queued.
+ * @return The number of frames dropped.
+ */
+size_t OutboundQueue::DropOldestLocked(size_t incoming_size) {
+  size_t dropped = 0;
+  FrameScheduler::Entry entry;
+
+  while (schedule_ && queued_bytes_.load(std::memory_order_relaxed) + incoming_size > options_.max_queued_bytes &&
+         schedule_->pending.DropOldest(MessagePriority::CHAT, entry)) {
+    queued_bytes_.fetch_sub(entry.size, std::memory_order_relaxed);
+    ++dropped;
+  }
+
+  dropped_frames_.fetch_add(dropped);
+  Metrics::Add(MetricCounter::FRAMES_DROPPED, dropped);
+  return dropped;
+}
+
+/**
+ * @brief Checks whether any bytes are waiting to be written. Caller holds writer_mutex_.
+ * @return True if the queue is empty.
+ */
+bool OutboundQueue::IsEmptyLocked() const {
+  return incoming_.Empty() && (!schedule_ || (schedule_->pending.Empty() && schedule_->in_flight.empty()));
+}
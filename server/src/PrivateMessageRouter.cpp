@@ -0,0 +1,187 @@
+#include "PrivateMessageRouter.h"
+
+#include <memory>
+#include <string>
+#include <utility>
+
+#include "Logger.h"
+#include "Metrics.h"
+#include "Server.h"
+
+namespace {
+
+/**
+ * @brief Checks whether a recipient can decode a frame in a given wire format.
+ *
+ * @param version Wire version of the frame.
+ * @param recipient The recipient.
+ * @return True if the frame can be forwarded unchanged.
+ */
+bool CanForward(int version, const IClientHandler &recipient) {
+  // Every peer decodes legacy frames; compact ones need the negotiated version
+  return version == kProtocolVersionLegacy || (version > 0 && recipient.GetProtocolVersion() >= version);
+}
+
+} // namespace
+
+/**
+ * @brief Constructs a router with nothing pending.
+ * @param server The server to look recipients up in.
+ */
+PrivateMessageRouter::PrivateMessageRouter(Server *server) : server_(server) {}
+
+/**
+ * @brief Queues a received private message until the next Flush.
+ *
+ * @param message View of the received message.
+ * @param sender_id ID of the connection it was received on.
+ */
+void PrivateMessageRouter::Add(const MessageView &message, int sender_id) {
+  auto index = target_index_.emplace(message.header.recipient_id, targets_.size());
+  if (index.second) {
+    targets_.emplace_back();
+    targets_.back().recipient_id = message.header.recipient_id;
+  }
+  Target &target = targets_[index.first->second];
+
+  Entry entry;
+  entry.header = message.header;
+  entry.header.sender_id = sender_id;
+  entry.offset = target.bytes.size();
+  entry.size = 0;
+  entry.payload_offset = 0;
+  entry.version = 0;
+
+  // The received bytes name the sender, so only forward them if that is true
+  bool verbatim = message.header.sender_id == sender_id && message.frame_version > 0;
+  if (verbatim && message.frame) {
+    entry.frame = message.frame;
+    entry.payload_offset = static_cast<size_t>(message.payload.data() - message.frame->data());
+    entry.version = message.frame_version;
+  } else if (verbatim && !message.wire.empty()) {
+    target.bytes.insert(target.bytes.end(), message.wire.begin(), message.wire.end());
+    entry.size = message.wire.size();
+    entry.payload_offset = static_cast<size_t>(message.payload.data() - message.wire.data());
+    entry.version = message.frame_version;
+  } else {
+    target.bytes.insert(target.bytes.end(), message.payload.begin(), message.payload.end());
+    entry.size = message.payload.size();
+  }
+  target.entries.push_back(std::move(entry));
+}
+
+/**
+ * @brief Delivers the queued messages, one batch per recipient.
+ * @param sender The connection the messages were received on, or nullptr for messages relayed from another node.
+ */
+void PrivateMessageRouter::Flush(IClientHandler *sender) {
+  if (targets_.empty()) {
+    return;
+  }
+  for (Target &target : targets_) {
+    Deliver(target, sender);
+  }
+  targets_.clear();
+  target_index_.clear();
+}
+
+/**
+ * @brief Frees the memory kept from earlier bursts.
+ */
+void PrivateMessageRouter::ReleaseMemory() {
+  std::vector<Target>().swap(targets_);
+  std::unordered_map<int, size_t>().swap(target_index_);
+}
+
+/**
+ * @brief Queues a target's messages on its recipient.
+ *
+ * Consecutive forwardable frames go out as one frame; the others are
+ * serialized one by one in between, so the order is kept.
+ *
+ * @param target The recipient's batch; its bytes may be moved out.
+ * @param sender The connection the messages were received on, or nullptr.
+ */
+void PrivateMessageRouter::Deliver(Target &target, IClientHandler *sender) {
+  std::shared_ptr<IClientHandler> recipient = server_ ? server_->GetClientHandler(target.recipient_id) : nullptr;
+  if (!recipient) {
+    if (sender) {
+      NotifyUnreachable(target.recipient_id, sender);
+      return;
+    }
+    // Relayed from another node: tell every original sender, once per run
+    int notified_id = 0;
+    for (const Entry &entry : target.entries) {
+      if (entry.header.sender_id == notified_id) {
+        continue;
+      }
+      notified_id = entry.header.sender_id;
+      if (std::shared_ptr<IClientHandler> origin = server_ ? server_->GetClientHandler(notified_id) : nullptr) {
+        NotifyUnreachable(target.recipient_id, origin.get());
+      }
+    }
+    return;
+  }
+  Metrics::Record(MetricHistogram::PRIVATE_BATCH_MESSAGES, target.entries.size());
+
+  // Forwardable wire frames not queued yet, as a byte range of target.bytes
+  size_t run_start = 0;
+  size_t run_end = 0;
+  auto queue_run = [&] {
+    if (run_end == run_start) {
+      return;
+    }
+    SharedFrame frame;
+    if (run_start == 0 && run_end == target.bytes.size()) {
+      // Usual case: the whole batch is forwarded, hand the buffer over
+      frame = std::allocate_shared<const PooledBuffer>(PoolAllocator<PooledBuffer>(), std::move(target.bytes));
+    } else {
+      frame = std::allocate_shared<const PooledBuffer>(PoolAllocator<PooledBuffer>(),
+                                                       target.bytes.begin() + run_start,
+                                                       target.bytes.begin() + run_end);
+    }
+    recipient->SendFrame(frame);
+    run_start = run_end;
+  };
+
+  for (const Entry &entry : target.entries) {
+    bool forward = CanForward(entry.version, *recipient);
+    if (forward && !entry.frame) {
+      if (run_end != entry.offset) {
+        queue_run();
+        run_start = entry.offset;
+      }
+      run_end = entry.offset + entry.size;
+      continue;
+    }
+
+    queue_run();
+    if (forward) {
+      recipient->SendFrame(entry.frame);
+      continue;
+    }
+    const char *base = entry.frame ? entry.frame->data() : target.bytes.data() + entry.offset;
+    recipient->SendMessage(MessageView(entry.header, PayloadView(base + entry.payload_offset,
+                                                                 entry.header.payload_size)));
+  }
+  queue_run();
+}
+
+/**
+ * @brief Tells the sender that a recipient is not connected.
+ *
+ * @param recipient_id The unreachable client ID.
+ * @param sender The connection to notify.
+ */
+void PrivateMessageRouter::NotifyUnreachable(int recipient_id, IClientHandler *sender) {
+  CHAT_LOG_RATE_LIMITED(LogLevel::WARNING, "Client " << sender->GetClientId() << " sent a private message to client "
+                                                      << recipient_id << ", which is not connected.");
+  std::string text = "Client " + std::to_string(recipient_id) + " is not connected.";
+  Message notice;
+  notice.header.type = MessageType::PRIVATE_MESSAGE;
+  notice.header.sender_id = -1; // Server is the sender
+  notice.header.recipient_id = sender->GetClientId();
+  notice.payload.assign(text.begin(), text.end());
+  notice.header.payload_size = notice.payload.size();
+  sender->SendMessage(notice);
+}
@@ -0,0 +1,96 @@
+#include "RemoteClientHandler.h"
+
+#include "Metrics.h"
+
+/**
+ * @brief Constructs a proxy.
+ *
+ * @param client_id ID of the remote client.
+ * @param link Link to the node owning it; must outlive the proxy.
+ */
+RemoteClientHandler::RemoteClientHandler(int client_id, ClusterLink *link) : client_id_(client_id), link_(link) {}
+
+/**
+ * @brief Does nothing; the owning node runs the connection.
+ */
+void RemoteClientHandler::Start() {}
+
+/**
+ * @brief Does nothing; the owning node runs the connection.
+ */
+void RemoteClientHandler::Stop() {}
+
+/**
+ * @brief Forwards a message to the client's node.
+ *
+ * @param message The message to send.
+ * @return True if the message was queued on the link.
+ */
+bool RemoteClientHandler::SendMessage(const MessageView &message) {
+  return SendFrame(SerializeMessageShared(message, kProtocolVersionLatest, CompressionCodecId::NONE));
+}
+
+/**
+ * @brief Forwards a serialized frame to the client's node.
+ *
+ * @param frame The frame, serialized for GetProtocolVersion and GetCompressionCodec.
+ * @return True if the frame was queued on the link.
+ */
+bool RemoteClientHandler::SendFrame(const SharedFrame &frame) {
+  Metrics::Add(MetricCounter::CLUSTER_FRAMES_FORWARDED);
+  return link_->Send(frame);
+}
+
+/**
+ * @brief Gets the wire protocol version of the link.
+ * @return kProtocolVersionLatest.
+ */
+int RemoteClientHandler::GetProtocolVersion() const {
+  return kProtocolVersionLatest;
+}
+
+/**
+ * @brief Gets the codec of the link.
+ * @return CompressionCodecId::NONE.
+ */
+CompressionCodecId RemoteClientHandler::GetCompressionCodec() const {
+  return CompressionCodecId::NONE;
+}
+
+/**
+ * @brief Gets the ID of the remote client.
+ * @return The client ID.
+ */
+int RemoteClientHandler::GetClientId() const {
+  return client_id_;
+}
+
+/**
+ * @brief Gets the socket, which lives on another node.
+ * @return nullptr.
+ */
+ISocket *RemoteClientHandler::GetSocket() const {
+  return nullptr;
+}
+
+/**
+ * @brief Gets the traffic counters, which are kept by the owning node.
+ * @return Zeroed counters.
+ */
+ConnectionStats RemoteClientHandler::GetStats() const {
+  return ConnectionStats();
+}
+
+/**
+ * @brief Gets the event loop, which lives on another node.
+ * @return nullptr.
+ */
+EventLoop *RemoteClientHandler::GetEventLoop() const {
+  return nullptr;
+}
+
+/**
+ * @brief Does nothing; admission control is per node.
+ * @param paused Ignored.
+ */
+void RemoteClientHandler::SetAdmissionPaused(bool) {}
@@ -0,0 +1,154 @@
+#include "RoomMessageHandler.h"
+
+#include <algorithm>
+#include <memory>
+
+#include "IClientHandler.h"
+#include "Logger.h"
+#include "MessageSerialization.h"
+#include "Server.h"
+
+/**
+ * @brief Handles a room join, leave or message.
+ * @param message View of the received message.
+ * @param sender The client handler that received the message.
+ * @param server A pointer to the Server instance for the fan-out.
+ * @return True if the message was handled, false otherwise.
+ */
+bool RoomMessageHandler::HandleMessage(const MessageView &message, IClientHandler *sender, Server *server) {
+  if (server == nullptr || sender == nullptr) {
+    CHAT_LOG_ERROR("Error: Server or sender pointer is null in RoomMessageHandler.");
+    return false;
+  }
+
+  switch (message.header.type) {
+  case MessageType::ROOM_JOIN:
+    HandleJoin(message, sender, server);
+    return true;
+  case MessageType::ROOM_LEAVE:
+    HandleLeave(message, sender);
+    return true;
+  case MessageType::ROOM_MESSAGE:
+    HandleRoomMessage(message, sender, server);
+    return true;
+  default:
+    return false;
+  }
+}
+
+/**
+ * @brief Gets the message types this handler consumes.
+ *
+ * @return ROOM_JOIN, ROOM_LEAVE and ROOM_MESSAGE.
+ */
+std::vector<MessageType> RoomMessageHandler::GetHandledTypes() const {
+  return {MessageType::ROOM_JOIN, MessageType::ROOM_LEAVE, MessageType::ROOM_MESSAGE};
+}
+
+/**
+ * @brief Tells whether a message type is cheap enough to handle on the I/O thread.
+ *
+ * Joins and leaves update the registry and send one reply; room messages
+ * fan out and go to a worker.
+ *
+ * @param type The message type.
+ * @return True for ROOM_JOIN and ROOM_LEAVE.
+ */
+bool RoomMessageHandler::IsInlineSafe(MessageType type) const {
+  return type == MessageType::ROOM_JOIN || type == MessageType::ROOM_LEAVE;
+}
+
+/**
+ * @brief Drops the disconnected client from all its rooms.
+ * @param client_id The ID of the disconnected client.
+ * @param server A pointer to the Server instance.
+ */
+void RoomMessageHandler::OnClientDisconnected(int client_id, Server *server) {
+  (void)server;
+  rooms_.LeaveAll(client_id);
+}
+
+/**
+ * @brief Adds the sender to the room named in the payload and answers it.
+ * @param message The ROOM_JOIN message.
+ * @param sender The joining client.
+ * @param server A pointer to the Server instance.
+ */
+void RoomMessageHandler::HandleJoin(const MessageView &message, IClientHandler *sender, Server *server) {
+  std::string room_name(message.payload.begin(), message.payload.end());
+  // The registry keeps a reference, so look up the owning handle
+  std::shared_ptr<IClientHandler> client = server->GetClientHandler(sender->GetClientId());
+  int room_id = client ? rooms_.Join(room_name, client) : -1;
+  if (room_id < 0) {
+    room_name.resize(std::min(room_name.size(), kMaxRoomNameLength)); // Do not echo oversized names back
+    CHAT_LOG_RATE_LIMITED(LogLevel::WARNING, "Client " << sender->GetClientId() << " could not join room '"
+                                                        << room_name << "'.");
+  } else {
+    CHAT_LOG_INFO("Client " << sender->GetClientId() << " joined room '" << room_name << "' (" << room_id << ").");
+  }
+  SendRoomReply(sender, MessageType::ROOM_JOIN, room_id, room_name);
+}
+
+/**
+ * @brief Removes the sender from the room in recipient_id and answers it.
+ * @param message The ROOM_LEAVE message.
+ * @param sender The leaving client.
+ */
+void RoomMessageHandler::HandleLeave(const MessageView &message, IClientHandler *sender) {
+  int room_id = message.header.recipient_id;
+  std::string room_name = rooms_.GetRoomName(room_id);
+  if (!rooms_.Leave(room_id, sender->GetClientId())) {
+    CHAT_LOG_WARNING("Client " << sender->GetClientId() << " tried to leave room " << room_id
+                     << " without being a member.");
+    return;
+  }
+  CHAT_LOG_INFO("Client " << sender->GetClientId() << " left room '" << room_name << "' (" << room_id << ").");
+  SendRoomReply(sender, MessageType::ROOM_LEAVE, room_id, room_name);
+}
+
+/**
+ * @brief Sends a room message to the other members of the room.
+ * @param message The ROOM_MESSAGE message.
+ * @param sender The posting client.
+ * @param server A pointer to the Server instance.
+ */
+void RoomMessageHandler::HandleRoomMessage(const MessageView &message, IClientHandler *sender, Server *server) {
+  int room_id = message.header.recipient_id;
+  std::shared_ptr<const RoomRegistry::Members> members = rooms_.GetMembersFor(room_id, sender->GetClientId());
+  if (!members) {
+    CHAT_LOG_RATE_LIMITED(LogLevel::WARNING, "Client " << sender->GetClientId() << " posted to room " << room_id
+                                                        << " without being a member.");
+    return;
+  }
+
+  // Same "Client <id>: <text>" payload as a broadcast
+  std::string prefix = "Client " + std::to_string(sender->GetClientId()) + ": ";
+  Message room_msg;
+  room_msg.header.type = MessageType::ROOM_MESSAGE;
+  room_msg.header.sender_id = sender->GetClientId();
+  room_msg.header.recipient_id = room_id;
+  room_msg.payload.reserve(prefix.size() + message.payload.size());
+  room_msg.payload.assign(prefix.begin(), prefix.end());
+  room_msg.payload.insert(room_msg.payload.end(), message.payload.begin(), message.payload.end());
+  room_msg.header.payload_size = room_msg.payload.size();
+
+  server->SendToClients(room_msg, *members, sender);
+}
+
+/**
+ * @brief Sends a join or leave answer to a client.
+ * @param client The client to answer.
+ * @param type ROOM_JOIN or ROOM_LEAVE.
+ * @param room_id The room ID, or -1 for a refused join.
+ * @param room_name The room name.
+ */
+void RoomMessageHandler::SendRoomReply(IClientHandler *client, MessageType type, int room_id,
+                                       const std::string &room_name) {
+  Message reply;
+  reply.header.type = type;
+  reply.header.sender_id = -1; // Server is the sender
+  reply.header.recipient_id = room_id;
+  reply.payload.assign(room_name.begin(), room_name.end());
+  reply.header.payload_size = reply.payload.size();
+  client->SendMessage(reply);
+}
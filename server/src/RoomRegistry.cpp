@@ -0,0 +1,167 @@
+#include "RoomRegistry.h"
+
+#include <algorithm>
+#include <mutex>
+
+#include "MessageSerialization.h"
+
+const size_t RoomRegistry::kMaxRoomsPerClient;
+
+/**
+ * @brief Constructs an empty registry.
+ */
+RoomRegistry::RoomRegistry() : next_room_id_(1) {}
+
+/**
+ * @brief Adds a client to a room, creating the room if needed.
+ *
+ * @param name The room name, see IsValidRoomName.
+ * @param client The joining client.
+ * @return The room ID, or -1 if the name is invalid or the client is in
+ * kMaxRoomsPerClient rooms already.
+ */
+int RoomRegistry::Join(const std::string &name, const std::shared_ptr<IClientHandler> &client) {
+  if (!client || !IsValidRoomName(name)) {
+    return -1;
+  }
+  int client_id = client->GetClientId();
+
+  std::unique_lock<std::shared_mutex> lock(mutex_);
+  std::vector<int> &joined = memberships_[client_id];
+  auto existing = room_ids_.find(name);
+  if (existing != room_ids_.end() && std::find(joined.begin(), joined.end(), existing->second) != joined.end()) {
+    return existing->second;
+  }
+  if (joined.size() >= kMaxRoomsPerClient) {
+    return -1;
+  }
+
+  int room_id = 0;
+  if (existing != room_ids_.end()) {
+    room_id = existing->second;
+  } else {
+    room_id = next_room_id_++;
+    room_ids_.emplace(name, room_id);
+    rooms_[room_id] = Room{name, std::make_shared<const Members>()};
+  }
+
+  Room &room = rooms_[room_id];
+  auto members = std::make_shared<Members>();
+  members->reserve(room.members->size() + 1);
+  *members = *room.members;
+  members->push_back(client);
+  room.members = std::move(members);
+  joined.push_back(room_id);
+  return room_id;
+}
+
+/**
+ * @brief Removes a client from a room.
+ *
+ * @param room_id The room ID.
+ * @param client_id The leaving client's ID.
+ * @return False if the client was not in the room.
+ */
+bool RoomRegistry::Leave(int room_id, int client_id) {
+  std::unique_lock<std::shared_mutex> lock(mutex_);
+  auto membership = memberships_.find(client_id);
+  if (membership == memberships_.end()) {
+    return false;
+  }
+  std::vector<int> &joined = membership->second;
+  auto it = std::find(joined.begin(), joined.end(), room_id);
+  if (it == joined.end()) {
+    return false;
+  }
+  joined.erase(it);
+  if (joined.empty()) {
+    memberships_.erase(membership);
+  }
+  RemoveMemberLocked(room_id, client_id);
+  return true;
+}
+
+/**
+ * @brief Removes a client from every room it joined.
+ * @param client_id The client's ID.
+ */
+void RoomRegistry::LeaveAll(int client_id) {
+  std::unique_lock<std::shared_mutex> lock(mutex_);
+  auto membership = memberships_.find(client_id);
+  if (membership == memberships_.end()) {
+    return;
+  }
+  std::vector<int> joined = std::move(membership->second);
+  memberships_.erase(membership);
+  for (int room_id : joined) {
+    RemoveMemberLocked(room_id, client_id);
+  }
+}
+
+/**
+ * @brief Gets the members of a room, if a client may post to it.
+ *
+ * @param room_id The room ID.
+ * @param client_id The posting client's ID.
+ * @return The current member array, or nullptr if the room does not exist
+ * or the client is not a member.
+ */
+std::shared_ptr<const RoomRegistry::Members> RoomRegistry::GetMembersFor(int room_id, int client_id) const {
+  std::shared_lock<std::shared_mutex> lock(mutex_);
+  auto membership = memberships_.find(client_id);
+  if (membership == memberships_.end() ||
+      std::find(membership->second.begin(), membership->second.end(), room_id) == membership->second.end()) {
+    return nullptr;
+  }
+  auto room = rooms_.find(room_id);
+  return room != rooms_.end() ? room->second.members : nullptr;
+}
+
+/**
+ * @brief Gets the name of a room.
+ *
+ * @param room_id The room ID.
+ * @return The name, or an empty string if the room does not exist.
+ */
+std::string RoomRegistry::GetRoomName(int room_id) const {
+  std::shared_lock<std::shared_mutex> lock(mutex_);
+  auto room = rooms_.find(room_id);
+  return room != rooms_.end() ? room->second.name : std::string();
+}
+
+/**
+ * @brief Gets the number of rooms.
+ * @return The room count.
+ */
+size_t RoomRegistry::Size() const {
+  std::shared_lock<std::shared_mutex> lock(mutex_);
+  return rooms_.size();
+}
+
+/**
+ * @brief Removes a client from a room with the lock held.
+ *
+ * @param room_id The room ID.
+ * @param client_id The leaving client's ID.
+ */
+void RoomRegistry::RemoveMemberLocked(int room_id, int client_id) {
+  auto room = rooms_.find(room_id);
+  if (room == rooms_.end()) {
+    return;
+  }
+  const Members &current = *room->second.members;
+  if (current.size() <= 1) {
+    // Last member: the room goes away with it
+    room_ids_.erase(room->second.name);
+    rooms_.erase(room);
+    return;
+  }
+  auto members = std::make_shared<Members>();
+  members->reserve(current.size() - 1);
+  for (const std::shared_ptr<IClientHandler> &member : current) {
+    if (member->GetClientId() != client_id) {
+      members->push_back(member);
+    }
+  }
+  room->second.members = std::move(members);
+}
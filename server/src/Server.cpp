@@ -1,8 +1,10 @@
 #include "Server.h"
 
 #include <algorithm>
-#include <iostream>
+#include <chrono>
+#include <sstream>
 #include <string>
+#include <thread>
 #include <utility>
 #include <vector>
 
@@ -12,7 +14,56 @@
 #include "PosixSocket.h"
 #endif
 
+#include "BufferPool.h"
 #include "ClientHandler.h"
+#include "Logger.h"
+#include "Metrics.h"
+
+#ifdef CHAT_HAVE_OPENSSL
+#include "TlsSocket.h"
+#endif
+
+namespace {
+
+// Connections listed in the stats report, busiest first
+const size_t kStatsTopConnections = 5;
+
+/**
+ * @brief Lazily serialized copies of one message, one per wire protocol version and codec.
+ *
+ * Every recipient that speaks the same version with the same codec shares
+ * one immutable frame, so the cost per recipient is a reference count
+ * increment.
+ */
+class FanoutFrames {
+public:
+  /**
+   * @brief Constructs an empty cache.
+   * @param message The message to serialize; must outlive the cache.
+   */
+  explicit FanoutFrames(const MessageView &message) : message_(message) {}
+
+  /**
+   * @brief Gets the frame a client can decode, serializing it on first use.
+   * @param client The recipient.
+   * @return The shared frame.
+   */
+  const SharedFrame &For(const IClientHandler &client) {
+    int version = std::min(std::max(client.GetProtocolVersion(), kProtocolVersionLegacy), kProtocolVersionLatest);
+    CompressionCodecId codec = client.GetCompressionCodec();
+    SharedFrame &frame = frames_[version][static_cast<size_t>(codec) % kCompressionCodecCount];
+    if (!frame) {
+      frame = SerializeMessageShared(message_, version, codec);
+    }
+    return frame;
+  }
+
+private:
+  const MessageView &message_;
+  SharedFrame frames_[kProtocolVersionLatest + 1][kCompressionCodecCount];
+};
+
+} // namespace
 
 /**
  * @brief Constructs a new Server object.
@@ -20,10 +71,14 @@
  * @param port The port number the server will listen on.
  * @param server_socket The socket to use for listening (dependency injected).
  * @param message_handler The message handler to use for processing client messages (dependency injected).
+ * @param options Server settings such as the connection servicing mode.
  */
-Server::Server(int port, std::unique_ptr<ISocket> server_socket, std::unique_ptr<IMessageHandler> message_handler)
-    : port_(port), server_socket_(std::move(server_socket)), // Store the injected socket
-      message_handler_(std::move(message_handler)), running_(false), next_client_id_(1) {}
+Server::Server(int port, std::unique_ptr<ISocket> server_socket, std::unique_ptr<IMessageHandler> message_handler,
+               const ServerOptions &options)
+    : port_(port), options_(options), limits_(std::make_shared<const ConnectionLimits>(options.limits)),
+      server_socket_(std::move(server_socket)), // Store the injected socket
+      directory_(options.cluster.node_id, static_cast<int>(options.cluster.peers.size()) + 1), next_event_loop_(0),
+      message_handler_(std::move(message_handler)), running_(false) {}
 
 /**
  * @brief Destroys the Server object. Stops the server and cleans up clients.
@@ -34,21 +89,81 @@ Server::~Server() {
 
 /**
  * @brief Starts the server, binds to the port, and begins listening.
+ *
+ * With several acceptors, each gets its own SO_REUSEPORT listener so the
+ * kernel spreads incoming connections over them; where that is not
+ * supported they all accept on the one listening socket.
+ *
  * @return True if the server starts successfully, false otherwise.
  */
 bool Server::Start() {
-  if (!server_socket_->Bind("0.0.0.0", port_)) {
-    std::cerr << "Failed to bind server socket." << std::endl;
+  size_t acceptor_count = std::max<size_t>(1, options_.acceptor_threads);
+  bool reuse_port = acceptor_count > 1 && server_socket_->SetOption(SocketOption::REUSE_PORT, 1);
+  if (!OpenListener(*server_socket_)) {
     return false;
   }
 
-  if (!server_socket_->Listen(10)) {
-    std::cerr << "Failed to listen on server socket." << std::endl;
-    return false;
+  for (size_t i = 1; reuse_port && i < acceptor_count; ++i) {
+#ifdef _WIN32
+    auto listener = std::make_unique<WinsockSocket>();
+#else
+    auto listener = std::make_unique<PosixSocket>();
+#endif
+    if (!listener->IsValid() || !listener->SetOption(SocketOption::REUSE_PORT, 1) || !OpenListener(*listener)) {
+      CHAT_LOG_ERROR("Failed to open listener " << i << ".");
+      extra_listeners_.clear();
+      return false;
+    }
+    extra_listeners_.push_back(std::move(listener));
+  }
+
+  if (options_.mode == ServerMode::REACTOR) {
+    size_t loop_count = options_.io_threads;
+    if (loop_count == 0) {
+      loop_count = std::max(1u, std::thread::hardware_concurrency());
+    }
+    for (size_t i = 0; i < loop_count; ++i) {
+      auto event_loop = std::make_unique<EventLoop>(options_.io_backend);
+      if (!event_loop->Start()) {
+        CHAT_LOG_ERROR("Failed to start event loop " << i << ".");
+        event_loops_.clear();
+        return false;
+      }
+      event_loops_.push_back(std::move(event_loop));
+    }
+    CHAT_LOG_INFO("Reactor mode: " << loop_count << " I/O threads.");
+  }
+  if (options_.fanout_threads > 0) {
+    fanout_pool_ = std::make_unique<FanoutPool>(options_.fanout_threads);
+  }
+  if (options_.worker_threads > 0) {
+    worker_pool_ = std::make_unique<WorkStealingExecutor>(options_.worker_threads);
+    CHAT_LOG_INFO("Message handlers run on " << options_.worker_threads << " worker threads.");
+  }
+
+  if (!options_.cluster.peers.empty()) {
+    cluster_ = std::make_unique<ClusterNode>(this, directory_, options_.cluster, options_.socket);
+    if (!cluster_->Start()) {
+      cluster_.reset();
+      return false;
+    }
   }
 
   running_.store(true);
-  std::cout << "Server started and listening on port " << port_ << std::endl;
+  registration_thread_ = std::thread(&Server::RegisterConnections, this);
+  if (options_.stats_interval_seconds > 0) {
+    stats_thread_ = std::thread(&Server::StatsLoop, this);
+  }
+  if (options_.admission.max_queued_bytes > 0) {
+    admission_ = std::make_unique<AdmissionController>(clients_, options_.admission);
+    admission_->Start();
+  }
+  for (size_t i = 1; i < acceptor_count; ++i) {
+    ISocket *listener = reuse_port ? extra_listeners_[i - 1].get() : server_socket_.get();
+    acceptor_threads_.emplace_back(&Server::AcceptLoop, this, listener);
+  }
+  CHAT_LOG_INFO("Server started and listening on port " << port_ << " (" << acceptor_count << " acceptor(s), "
+                << (reuse_port ? "one listener each" : "shared listener") << ").");
 
   return true;
 }
@@ -58,19 +173,82 @@ bool Server::Start() {
  */
 void Server::Stop() {
   if (running_.load()) {
-    running_.store(false);
-    // Close the server socket to unblock the Accept call
-    if (server_socket_ && server_socket_->IsValid()) {
-      server_socket_->Close();
+    {
+      // Under the lock, so the stats thread cannot miss the wakeup
+      std::lock_guard<std::mutex> lock(stats_mutex_);
+      running_.store(false);
+    }
+    stats_cv_.notify_all();
+    if (stats_thread_.joinable()) {
+      stats_thread_.join();
+    }
+    if (admission_) {
+      admission_->Stop();
+    }
+    // Shut the listeners down to unblock the Accept calls; closing alone
+    // does not wake a thread blocked in accept on Linux
+    for (ISocket *listener : GetListeners()) {
+      if (listener->IsValid()) {
+        listener->Shutdown();
+      }
+    }
+    for (auto &acceptor : acceptor_threads_) {
+      if (acceptor.joinable()) {
+        acceptor.join();
+      }
+    }
+    acceptor_threads_.clear();
+    for (ISocket *listener : GetListeners()) {
+      listener->Close();
+    }
+    extra_listeners_.clear();
+    // Nothing relayed by other nodes may reach the clients being stopped
+    if (cluster_) {
+      cluster_->Stop();
+    }
+
+    // Connections accepted but not registered yet are simply closed
+    pending_connections_.Wakeup();
+    if (registration_thread_.joinable()) {
+      registration_thread_.join();
+    }
+    pending_connections_.PopAll([](PendingConnection &&) {});
+
+    // Take ownership of all handlers first: stopping a reactor-mode handler
+    // waits for its event loop, whose callbacks may need the registry locks.
+    std::vector<std::shared_ptr<IClientHandler>> clients = clients_.Clear();
+    {
+      std::lock_guard<std::mutex> lock(retired_mutex_);
+      for (auto &client : retired_clients_) {
+        clients.push_back(std::move(client));
+      }
+      retired_clients_.clear();
     }
 
     // Stop all client handlers
-    std::lock_guard<std::mutex> lock(clients_mutex_);
-    for (const auto &client : clients_) {
+    for (const auto &client : clients) {
       client->Stop();
     }
-    clients_.clear(); // Clear the list after stopping
-    std::cout << "Server stopped." << std::endl;
+    clients.clear(); // Destroy the handlers after stopping
+
+    // Handlers are gone, so no loop callback can reference them any more
+    for (auto &event_loop : event_loops_) {
+      event_loop->Stop();
+    }
+    event_loops_.clear();
+    // Every strand was closed with its handler, so the workers are idle
+    if (worker_pool_) {
+      worker_pool_->Shutdown();
+    }
+    if (fanout_pool_) {
+      fanout_pool_->Shutdown();
+    }
+
+    BufferPool::Stats pool_stats = BufferPool::Instance().GetStats();
+    CHAT_LOG_INFO("Buffer pool: " << pool_stats.allocations << " allocations, "
+                  << static_cast<int>(pool_stats.HitRate() * 100.0) << "% served from the pool, "
+                  << pool_stats.oversize << " oversize.");
+    CHAT_LOG_INFO("Server stopped.");
   }
 }
 
@@ -80,60 +258,283 @@ void Server::Stop() {
  * This method runs indefinitely until the server is stopped.
  */
 void Server::AcceptConnections() {
+  AcceptLoop(server_socket_.get());
+}
+
+/**
+ * @brief Binds a listening socket to the server port and starts listening.
+ *
+ * @param listener The socket to set up.
+ * @return True if the socket is listening.
+ */
+bool Server::OpenListener(ISocket &listener) {
+  if (!listener.Bind("0.0.0.0", port_)) {
+    CHAT_LOG_ERROR("Failed to bind server socket.");
+    return false;
+  }
+
+  // Accepted sockets inherit the buffer sizes, which must be in place before
+  // the handshake to take effect on the TCP window
+  if (!listener.ApplyOptions(options_.socket)) {
+    CHAT_LOG_WARNING("Some socket options could not be applied to the server socket.");
+  }
+
+  if (!listener.Listen(options_.listen_backlog)) {
+    CHAT_LOG_ERROR("Failed to listen on server socket.");
+    return false;
+  }
+  return true;
+}
+
+/**
+ * @brief Accepts connections on one listener until the server stops.
+ *
+ * Only allocates the ID and hands the socket over; everything else happens
+ * on the registration thread.
+ *
+ * @param listener The listening socket.
+ */
+void Server::AcceptLoop(ISocket *listener) {
   while (running_.load()) {
-    std::cout << "Waiting for connections..." << std::endl;
-    // Use the injected server_socket_ to accept connections
-    std::unique_ptr<ISocket> client_socket(server_socket_->Accept());
+    std::unique_ptr<ISocket> client_socket(listener->Accept());
 
     if (client_socket && client_socket->IsValid()) {
-      int assigned_client_id = next_client_id_++;
-      std::cout << "Accepted new connection. Assigning ID: " << assigned_client_id << std::endl;
-
-      // Create a new client handler for the accepted connection
-      auto client_handler =
-          std::make_unique<ClientHandler>(assigned_client_id, std::move(client_socket), this, message_handler_.get());
-
-      // Send the assigned client ID back to the client
-      Message id_assignment_msg;
-      id_assignment_msg.header.type = MessageType::CLIENT_ID_ASSIGNMENT;
-      id_assignment_msg.header.sender_id = -1;                    // Server is the sender (-1 indicates server)
-      id_assignment_msg.header.recipient_id = assigned_client_id; // Message is for this specific client
-
-      // Payload contains the client ID as a string
-      std::string id_str = std::to_string(assigned_client_id);
-      id_assignment_msg.payload.assign(id_str.begin(), id_str.end());
-      id_assignment_msg.header.payload_size = id_assignment_msg.payload.size();
-
-      // Send the message using the client handler's SendMessage method
-      client_handler->SendMessage(id_assignment_msg);
-
-      // Add the client handler to the list and start its thread
-      std::lock_guard<std::mutex> lock(clients_mutex_);
-      clients_.push_back(std::move(client_handler));
-      clients_.back()->Start(); // Start the thread for the new client
+      Metrics::Add(MetricCounter::CONNECTIONS_ACCEPTED);
+      pending_connections_.Push({directory_.AllocateClientId(), std::move(client_socket)});
     } else {
       // Error accepting connection or server is stopping
       if (!running_.load()) {
         break;
       }
-      std::cerr << "Error accepting connection." << std::endl;
+      CHAT_LOG_RATE_LIMITED(LogLevel::ERROR, "Error accepting connection.");
+      // Back off instead of spinning, e.g. while out of file descriptors
+      std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+  }
+}
+
+/**
+ * @brief The main loop for the registration thread.
+ */
+void Server::RegisterConnections() {
+  while (running_.load()) {
+    pending_connections_.Wait();
+    if (!running_.load()) {
+      break;
     }
+    ReapRetiredClients();
+    pending_connections_.PopAll([this](PendingConnection &&connection) { RegisterClient(std::move(connection)); });
   }
 }
 
+/**
+ * @brief Creates, announces and starts the handler for an accepted connection.
+ *
+ * @param connection The accepted connection.
+ */
+void Server::RegisterClient(PendingConnection connection) {
+  connection.socket->ApplyOptions(options_.socket);
+  int assigned_client_id = connection.client_id;
+#ifdef CHAT_HAVE_OPENSSL
+  if (options_.tls) {
+    // The handshake happens on the handler's threads, with its first read or write
+    connection.socket = std::make_unique<TlsSocket>(std::move(connection.socket), options_.tls);
+  }
+#endif
+
+  // Create a new client handler for the accepted connection
+  std::unique_ptr<MessageStrand> strand;
+  if (worker_pool_) {
+    strand = std::make_unique<MessageStrand>(worker_pool_.get(), options_.worker_backlog_bytes);
+  }
+  auto client_handler = std::make_shared<ClientHandler>(assigned_client_id, std::move(connection.socket), this,
+                                                        message_handler_.get(), NextEventLoop(),
+                                                        options_.outbound_queue, std::move(strand),
+                                                        options_.timeouts, limits_);
+
+  // Send the assigned client ID back to the client
+  Message id_assignment_msg;
+  id_assignment_msg.header.type = MessageType::CLIENT_ID_ASSIGNMENT;
+  id_assignment_msg.header.sender_id = -1;                    // Server is the sender (-1 indicates server)
+  id_assignment_msg.header.recipient_id = assigned_client_id; // Message is for this specific client
+
+  // Payload contains the client ID as a string, followed by the highest
+  // protocol version we speak and the compression codecs we offer. It is
+  // always sent in the legacy format.
+  std::string id_str =
+      FormatClientIdAssignment(assigned_client_id, kProtocolVersionLatest, options_.compression_codecs);
+  id_assignment_msg.payload.assign(id_str.begin(), id_str.end());
+  id_assignment_msg.header.payload_size = id_assignment_msg.payload.size();
+
+  // Queued only; the handler's writer sends it once started
+  client_handler->SendMessage(id_assignment_msg);
+
+  // Register the client handler and start its thread
+  clients_.Add(client_handler);
+  client_handler->Start(); // Start the thread for the new client
+}
+
+/**
+ * @brief Gets every listening socket, the shared one first.
+ * @return The listeners.
+ */
+std::vector<ISocket *> Server::GetListeners() const {
+  std::vector<ISocket *> listeners;
+  if (server_socket_) {
+    listeners.push_back(server_socket_.get());
+  }
+  for (const auto &listener : extra_listeners_) {
+    listeners.push_back(listener.get());
+  }
+  return listeners;
+}
+
 /**
  * @brief Broadcasts a message to all connected clients except the sender.
+ *
+ * Other cluster nodes get the message once each, serialized once for all
+ * of them.
+ *
+ * @param message The message to broadcast.
+ * @param sender The client handler that sent the message (can be nullptr).
+ */
+void Server::BroadcastMessage(const MessageView &message, IClientHandler *sender) {
+  BroadcastLocally(message, sender);
+  if (cluster_) {
+    cluster_->Broadcast(message);
+  }
+}
+
+/**
+ * @brief Broadcasts a message to this node's clients only.
+ *
+ * The message is serialized (and compressed) once per wire protocol version
+ * and codec in use and the same immutable frame is queued on every recipient
+ * of that combination, so the cost per recipient is a reference count
+ * increment.
+ *
  * @param message The message to broadcast.
  * @param sender The client handler that sent the message (can be nullptr).
  */
-void Server::BroadcastMessage(const Message &message, IClientHandler *sender) {
-  std::lock_guard<std::mutex> lock(clients_mutex_);
-  for (const auto &client : clients_) {
+void Server::BroadcastLocally(const MessageView &message, IClientHandler *sender) {
+  uint64_t start_ns = Metrics::NowNanoseconds();
+  uint64_t recipients = 0;
+  FanoutFrames frames(message);
+  clients_.ForEach([&](const std::shared_ptr<IClientHandler> &client) {
     // Send message to all clients except the sender
     if (client.get() != sender) {
-      client->SendMessage(message);
+      client->SendFrame(frames.For(*client));
+      ++recipients;
+    }
+  });
+  Metrics::Record(MetricHistogram::BROADCAST_FANOUT_NS, Metrics::NowNanoseconds() - start_ns);
+  Metrics::Record(MetricHistogram::BROADCAST_RECIPIENTS, recipients);
+}
+
+/**
+ * @brief Sends a message to a list of clients, e.g. the members of a room.
+ *
+ * Lists longer than fanout_slice_size are cut into slices that the fan-out
+ * pool queues in parallel, each slice with its own frame cache; the call
+ * returns once every recipient has the frame queued.
+ *
+ * @param message The message to send.
+ * @param recipients The clients to send it to.
+ * @param sender The client to skip (can be nullptr).
+ */
+void Server::SendToClients(const MessageView &message, const std::vector<std::shared_ptr<IClientHandler>> &recipients,
+                           IClientHandler *sender) {
+  uint64_t start_ns = Metrics::NowNanoseconds();
+  size_t slice_size = std::max<size_t>(1, options_.fanout_slice_size);
+  size_t slice_count = (recipients.size() + slice_size - 1) / slice_size;
+  std::atomic<uint64_t> sent(0);
+  auto send_slice = [&](size_t slice) {
+    FanoutFrames frames(message);
+    size_t end = std::min(recipients.size(), (slice + 1) * slice_size);
+    uint64_t slice_sent = 0;
+    for (size_t i = slice * slice_size; i < end; ++i) {
+      IClientHandler *client = recipients[i].get();
+      if (client != sender) {
+        client->SendFrame(frames.For(*client));
+        ++slice_sent;
+      }
+    }
+    sent.fetch_add(slice_sent, std::memory_order_relaxed);
+  };
+  if (fanout_pool_ && slice_count > 1) {
+    fanout_pool_->Run(slice_count, send_slice);
+  } else {
+    for (size_t slice = 0; slice < slice_count; ++slice) {
+      send_slice(slice);
     }
   }
+  Metrics::Record(MetricHistogram::ROOM_FANOUT_NS, Metrics::NowNanoseconds() - start_ns);
+  Metrics::Record(MetricHistogram::ROOM_RECIPIENTS, sent.load());
+}
+
+/**
+ * @brief Checks whether clients may pick a codec for their connection.
+ *
+ * @param codec The codec a client asked for.
+ * @return True if the server offers the codec.
+ */
+bool Server::IsCompressionCodecOffered(CompressionCodecId codec) const {
+  return std::find(options_.compression_codecs.begin(), options_.compression_codecs.end(), codec) !=
+         options_.compression_codecs.end();
+}
+
+/**
+ * @brief Formats the process metrics and the busiest connections.
+ *
+ * Connections are ranked by queued bytes, then by bytes sent, so slow
+ * consumers show up first.
+ *
+ * @return Human-readable report, one metric per line.
+ */
+std::string Server::FormatStats() const {
+  std::vector<std::pair<int, ConnectionStats>> connections;
+  clients_.ForEach([&](const std::shared_ptr<IClientHandler> &client) {
+    connections.emplace_back(client->GetClientId(), client->GetStats());
+  });
+  size_t listed = std::min(kStatsTopConnections, connections.size());
+  std::partial_sort(connections.begin(), connections.begin() + listed, connections.end(),
+                    [](const std::pair<int, ConnectionStats> &a, const std::pair<int, ConnectionStats> &b) {
+                      if (a.second.queued_bytes != b.second.queued_bytes) {
+                        return a.second.queued_bytes > b.second.queued_bytes;
+                      }
+                      return a.second.bytes_sent > b.second.bytes_sent;
+                    });
+
+  std::ostringstream out;
+  out << Metrics::Snapshot().Format();
+  out << "connections: " << connections.size() << "\n";
+  for (size_t i = 0; i < listed; ++i) {
+    const ConnectionStats &stats = connections[i].second;
+    out << "client " << connections[i].first << ": received=" << stats.bytes_received
+        << " messages=" << stats.messages_received << " sent=" << stats.bytes_sent << " queued=" << stats.queued_bytes
+        << " dropped=" << stats.dropped_frames << "\n";
+  }
+  return out.str();
+}
+
+/**
+ * @brief The main loop for the stats thread: dumps FormatStats periodically.
+ */
+void Server::StatsLoop() {
+  std::unique_lock<std::mutex> lock(stats_mutex_);
+  while (running_.load()) {
+    if (stats_cv_.wait_for(lock, std::chrono::seconds(options_.stats_interval_seconds),
+                           [this] { return !running_.load(); })) {
+      break;
+    }
+    lock.unlock();
+    std::string report = FormatStats();
+    if (!report.empty() && report.back() == '\n') {
+      report.pop_back();
+    }
+    CHAT_LOG_INFO("--- Server stats ---\n" << report);
+    lock.lock();
+  }
 }
 
 /**
@@ -141,27 +542,64 @@ void Server::BroadcastMessage(const Message &message, IClientHandler *sender) {
  * @param client_handler The client handler to remove.
  */
 void Server::RemoveClient(IClientHandler *client_handler) {
-  std::lock_guard<std::mutex> lock(clients_mutex_);
-  // Find and remove the client handler
-  // The unique_ptr will automatically delete the ClientHandler object when it's removed from the vector.
-  clients_.erase(
-      std::remove_if(clients_.begin(), clients_.end(),
-                     [&](const std::unique_ptr<IClientHandler> &client) { return client.get() == client_handler; }),
-      clients_.end());
-  std::cout << "Removed client " << client_handler->GetClientId() << " from the list." << std::endl;
+  // Move the client handler to the retired list. It cannot be stopped here
+  // because this is typically called from the handler's own thread (or a loop
+  // callback running on its behalf).
+  std::shared_ptr<IClientHandler> removed = clients_.Remove(client_handler);
+  if (!removed) {
+    return; // Already removed (e.g. during Stop)
+  }
+  {
+    std::lock_guard<std::mutex> lock(retired_mutex_);
+    retired_clients_.push_back(std::move(removed));
+  }
+  Metrics::Add(MetricCounter::CONNECTIONS_CLOSED);
+  CHAT_LOG_INFO("Removed client " << client_handler->GetClientId() << " from the list.");
+  pending_connections_.Wakeup(); // Let the registration thread reap it soon
+
+  if (message_handler_) {
+    message_handler_->OnClientDisconnected(client_handler->GetClientId(), this);
+  }
+}
+
+/**
+ * @brief Stops and destroys client handlers removed by RemoveClient.
+ */
+void Server::ReapRetiredClients() {
+  std::vector<std::shared_ptr<IClientHandler>> retired;
+  {
+    std::lock_guard<std::mutex> lock(retired_mutex_);
+    retired.swap(retired_clients_);
+  }
+  // Stop joins the handler thread (or synchronizes with its event loop), so
+  // it must run without holding any lock.
+  for (const auto &client : retired) {
+    client->Stop();
+  }
+}
+
+/**
+ * @brief Picks the event loop for a new connection in REACTOR mode.
+ *
+ * @return The next event loop in round-robin order, or nullptr in THREAD_PER_CLIENT mode.
+ */
+EventLoop *Server::NextEventLoop() {
+  if (event_loops_.empty()) {
+    return nullptr;
+  }
+  EventLoop *event_loop = event_loops_[next_event_loop_].get();
+  next_event_loop_ = (next_event_loop_ + 1) % event_loops_.size();
+  return event_loop;
 }
 
 /**
  * @brief Gets a client handler by its ID.
  * @param client_id The ID of the client handler to retrieve.
- * @return A pointer to the ClientHandler if found, nullptr otherwise.
+ * @return The client handler if found, nullptr otherwise.
  */
-IClientHandler *Server::GetClientHandler(int client_id) {
-  std::lock_guard<std::mutex> lock(clients_mutex_);
-  for (const auto &client : clients_) {
-    if (client->GetClientId() == client_id) {
-      return client.get();
-    }
+std::shared_ptr<IClientHandler> Server::GetClientHandler(int client_id) {
+  if (cluster_ && !directory_.IsLocal(client_id)) {
+    return cluster_->GetRemoteClient(client_id);
   }
-  return nullptr;
+  return clients_.Find(client_id);
 }
@@ -0,0 +1,52 @@
+#include "TokenBucket.h"
+
+#include <algorithm>
+#include <cmath>
+
+/**
+ * @brief Constructs a full bucket.
+ * @param limit The rate and burst; a zero rate makes the bucket unlimited.
+ */
+TokenBucket::TokenBucket(const RateLimit &limit)
+    : rate_per_ns_(std::max(0.0, limit.rate) / 1e9), burst_(limit.burst > 0 ? limit.burst : limit.rate),
+      tokens_(burst_), last_refill_ns_(0) {}
+
+/**
+ * @brief Checks whether the bucket limits anything at all.
+ * @return False for an unlimited bucket, whose Consume always returns 0.
+ */
+bool TokenBucket::IsLimited() const {
+  return rate_per_ns_ > 0;
+}
+
+/**
+ * @brief Checks whether the bucket has refilled to its burst.
+ * @param now_ns The current Metrics::NowNanoseconds time.
+ * @return True if the bucket is full or unlimited.
+ */
+bool TokenBucket::IsFull(uint64_t now_ns) const {
+  if (!IsLimited()) {
+    return true;
+  }
+  uint64_t elapsed_ns = now_ns > last_refill_ns_ ? now_ns - last_refill_ns_ : 0;
+  return tokens_ + static_cast<double>(elapsed_ns) * rate_per_ns_ >= burst_;
+}
+
+/**
+ * @brief Takes tokens, going into debt if the bucket holds too few.
+ *
+ * @param tokens Number of tokens to take (e.g. bytes or messages).
+ * @param now_ns The current Metrics::NowNanoseconds time.
+ * @return Nanoseconds until the bucket is out of debt, 0 if it is not in debt.
+ */
+uint64_t TokenBucket::Consume(double tokens, uint64_t now_ns) {
+  if (!IsLimited()) {
+    return 0;
+  }
+  if (now_ns > last_refill_ns_) {
+    tokens_ = std::min(burst_, tokens_ + static_cast<double>(now_ns - last_refill_ns_) * rate_per_ns_);
+    last_refill_ns_ = now_ns;
+  }
+  tokens_ -= tokens;
+  return tokens_ < 0 ? static_cast<uint64_t>(std::ceil(-tokens_ / rate_per_ns_)) : 0;
+}
@@ -0,0 +1,152 @@
+#include "WorkStealingExecutor.h"
+
+#include <algorithm>
+#include <utility>
+
+namespace {
+
+// Executor and worker index of the calling thread, if it is a worker
+thread_local const WorkStealingExecutor *current_executor = nullptr;
+thread_local size_t current_worker = 0;
+
+} // namespace
+
+/**
+ * @brief Constructs the executor and starts its threads.
+ * @param thread_count Number of worker threads (at least 1).
+ */
+WorkStealingExecutor::WorkStealingExecutor(size_t thread_count)
+    : next_worker_(0), pending_(0), sleepers_(0), stopping_(false) {
+  thread_count = std::max<size_t>(1, thread_count);
+  for (size_t i = 0; i < thread_count; ++i) {
+    workers_.push_back(std::make_unique<Worker>());
+  }
+  // Start the threads only once every queue exists, they steal from all of them
+  for (size_t i = 0; i < thread_count; ++i) {
+    workers_[i]->thread = std::thread(&WorkStealingExecutor::WorkerLoop, this, i);
+  }
+}
+
+/**
+ * @brief Destroys the executor. Runs the remaining tasks, then joins the threads.
+ */
+WorkStealingExecutor::~WorkStealingExecutor() {
+  Shutdown();
+}
+
+/**
+ * @brief Queues a task for one of the workers.
+ *
+ * @param task The task to run.
+ */
+void WorkStealingExecutor::Submit(Task task) {
+  bool from_worker = current_executor == this;
+  if (!from_worker && stopping_.load()) {
+    task();
+    return;
+  }
+
+  size_t index = from_worker ? current_worker : next_worker_.fetch_add(1, std::memory_order_relaxed) % workers_.size();
+  {
+    std::lock_guard<std::mutex> lock(workers_[index]->mutex);
+    workers_[index]->tasks.push_back(std::move(task));
+  }
+  // Paired with the sleepers_ increment in WorkerLoop: either this sees the
+  // sleeper, or the sleeper sees the new task before it waits
+  pending_.fetch_add(1);
+  if (sleepers_.load() > 0) {
+    std::lock_guard<std::mutex> lock(idle_mutex_);
+    idle_cv_.notify_one();
+  }
+}
+
+/**
+ * @brief Runs the remaining tasks and joins the threads. Safe to call more than once.
+ */
+void WorkStealingExecutor::Shutdown() {
+  {
+    std::lock_guard<std::mutex> lock(idle_mutex_);
+    stopping_.store(true);
+  }
+  idle_cv_.notify_all();
+  for (const std::unique_ptr<Worker> &worker : workers_) {
+    if (worker->thread.joinable()) {
+      worker->thread.join();
+    }
+  }
+
+  // An outside Submit that raced with the flag may have queued a task after
+  // the workers left; run it here rather than lose it
+  Task task;
+  while (TakeTask(0, task)) {
+    pending_.fetch_sub(1);
+    task();
+  }
+}
+
+/**
+ * @brief Gets the number of worker threads.
+ * @return The thread count.
+ */
+size_t WorkStealingExecutor::GetThreadCount() const {
+  return workers_.size();
+}
+
+/**
+ * @brief The loop executed by each worker thread.
+ * @param index Index of the worker in workers_.
+ */
+void WorkStealingExecutor::WorkerLoop(size_t index) {
+  current_executor = this;
+  current_worker = index;
+
+  Task task;
+  while (true) {
+    if (TakeTask(index, task)) {
+      pending_.fetch_sub(1);
+      task();
+      task = nullptr; // Release captures before possibly sleeping
+      continue;
+    }
+
+    std::unique_lock<std::mutex> lock(idle_mutex_);
+    sleepers_.fetch_add(1);
+    idle_cv_.wait(lock, [this] { return pending_.load() > 0 || stopping_.load(); });
+    sleepers_.fetch_sub(1);
+    if (pending_.load() == 0 && stopping_.load()) {
+      return; // Stopping and drained
+    }
+  }
+}
+
+/**
+ * @brief Takes a task from a worker's own queue, or steals one from another's.
+ *
+ * @param index Index of the worker looking for work.
+ * @param task Receives the task.
+ * @return False if every queue was empty.
+ */
+bool WorkStealingExecutor::TakeTask(size_t index, Task &task) {
+  {
+    Worker &own = *workers_[index];
+    std::lock_guard<std::mutex> lock(own.mutex);
+    if (!own.tasks.empty()) {
+      task = std::move(own.tasks.front());
+      own.tasks.pop_front();
+      return true;
+    }
+  }
+
+  // Steal the newest task of the next busy worker; the owner keeps working
+  // through its oldest ones, so the two rarely touch the same end
+  for (size_t offset = 1; offset < workers_.size(); ++offset) {
+    Worker &victim = *workers_[(index + offset) % workers_.size()];
+    std::lock_guard<std::mutex> lock(victim.mutex);
+    if (!victim.tasks.empty()) {
+      task = std::move(victim.tasks.back());
+      victim.tasks.pop_back();
+      return true;
+    }
+  }
+  return false;
+}
@@ -0,0 +1,321 @@
+#include "WriteBehindFile.h"
+
+#include <algorithm>
+#include <cstring>
+#include <utility>
+#include <vector>
+
+#include <cerrno>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+#include "Logger.h"
+
+const size_t WriteBehindFile::kWriteBatchSize;
+
+/**
+ * @brief Creates (or truncates) a file for writing, or reopens one to continue it.
+ *
+ * @param file_path The path of the file.
+ * @param disk_writer The pool performing the writes.
+ * @param on_progress Optional callback invoked after each completed batch.
+ * @param start_offset Offset of the first appended byte; non-zero keeps the existing contents.
+ * @param event_loop Optional loop writing the batches on its ring, used if it supports file I/O.
+ * @return The file, or nullptr if it could not be opened.
+ */
+std::shared_ptr<WriteBehindFile> WriteBehindFile::Open(const std::string &file_path, DiskWriter &disk_writer,
+                                                       ProgressCallback on_progress, uint64_t start_offset,
+                                                       EventLoop *event_loop) {
+  std::shared_ptr<WriteBehindFile> file(new WriteBehindFile(disk_writer, std::move(on_progress)));
+  if (event_loop && event_loop->SupportsFileIo()) {
+    file->event_loop_ = event_loop;
+  }
+  file->next_offset_ = start_offset;
+  file->written_bytes_ = static_cast<size_t>(start_offset);
+#ifdef _WIN32
+  file->file_handle_ = CreateFileA(file_path.c_str(), GENERIC_WRITE, 0, nullptr,
+                                   start_offset > 0 ? OPEN_ALWAYS : CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+  if (file->file_handle_ == INVALID_HANDLE_VALUE) {
+    file->file_handle_ = nullptr;
+    return nullptr;
+  }
+#else
+  int flags = O_WRONLY | O_CREAT | O_CLOEXEC | (start_offset > 0 ? 0 : O_TRUNC);
+  file->file_fd_ = open(file_path.c_str(), flags, 0644);
+  if (file->file_fd_ < 0) {
+    return nullptr;
+  }
+#endif
+  return file;
+}
+
+/**
+ * @brief Constructs a WriteBehindFile around an open native file.
+ * @param disk_writer The pool performing the writes.
+ * @param on_progress Optional progress callback.
+ */
+WriteBehindFile::WriteBehindFile(DiskWriter &disk_writer, ProgressCallback on_progress)
+    : disk_writer_(disk_writer), event_loop_(nullptr), on_progress_(std::move(on_progress)),
+#ifdef _WIN32
+      file_handle_(nullptr),
+#else
+      file_fd_(-1),
+#endif
+      next_offset_(0), written_bytes_(0), pending_writes_(0), failed_(false), finishing_(false) {
+}
+
+/**
+ * @brief Destroys the WriteBehindFile. Closes the file if still open.
+ */
+WriteBehindFile::~WriteBehindFile() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  CloseLocked();
+}
+
+/**
+ * @brief Appends data to the end of the file.
+ *
+ * @param data The bytes to append (copied).
+ * @param size Number of bytes.
+ * @return False if an earlier write failed or Finish was already called.
+ */
+bool WriteBehindFile::Append(const char *data, size_t size) {
+  std::vector<std::function<void()>> jobs;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (failed_ || finishing_) {
+      return false;
+    }
+
+    // Fill the staging buffer up to exactly one batch at a time, so that
+    // batches stay aligned without copying any remainder around
+    while (size > 0) {
+      if (staging_.capacity() < kWriteBatchSize) {
+        staging_.reserve(kWriteBatchSize);
+      }
+      size_t take = std::min(size, kWriteBatchSize - staging_.size());
+      staging_.insert(staging_.end(), data, data + take);
+      data += take;
+      size -= take;
+      if (staging_.size() == kWriteBatchSize) {
+        jobs.push_back(TakeStagedLocked());
+      }
+    }
+  }
+
+  for (auto &job : jobs) {
+    SubmitJob(std::move(job));
+  }
+  return true;
+}
+
+/**
+ * @brief Flushes the staged data and closes the file once every write completed.
+ *
+ * @param on_complete Callback receiving whether all writes succeeded.
+ */
+void WriteBehindFile::Finish(CompletionCallback on_complete) {
+  CompletionCallback completion;
+  std::function<void()> job;
+  bool success = false;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (finishing_) {
+      return;
+    }
+    finishing_ = true;
+    on_complete_ = std::move(on_complete);
+    if (!staging_.empty() && !failed_) {
+      job = TakeStagedLocked();
+    }
+    completion = TakeCompletionLocked();
+    success = !failed_;
+  }
+  if (job) {
+    SubmitJob(std::move(job));
+  }
+  if (completion) {
+    completion(success);
+  }
+}
+
+/**
+ * @brief Gets the number of bytes already written to disk.
+ * @return The written byte count.
+ */
+size_t WriteBehindFile::GetWrittenBytes() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return written_bytes_;
+}
+
+/**
+ * @brief Turns the staging buffer into a write job. Caller holds mutex_.
+ *
+ * @return The job writing the staged bytes.
+ */
+std::function<void()> WriteBehindFile::TakeStagedLocked() {
+  auto batch = std::make_shared<PooledBuffer>(std::move(staging_));
+  staging_ = PooledBuffer();
+  uint64_t offset = next_offset_;
+  next_offset_ += batch->size();
+  ++pending_writes_;
+
+  std::shared_ptr<WriteBehindFile> self = shared_from_this();
+  if (event_loop_) {
+    return [self, batch, offset] { self->WriteBatchOnLoop(batch, offset, 0); };
+  }
+  return [self, batch, offset] { self->WriteBatch(*batch, offset); };
+}
+
+/**
+ * @brief Starts a job from TakeStagedLocked: on the ring at once, or on the DiskWriter.
+ * @param job The job.
+ */
+void WriteBehindFile::SubmitJob(std::function<void()> job) {
+  if (event_loop_) {
+    job(); // Only queues the write request
+  } else {
+    disk_writer_.Submit(std::move(job));
+  }
+}
+
+/**
+ * @brief Writes one batch at its offset. Runs on an I/O thread.
+ *
+ * @param batch The bytes to write.
+ * @param offset File offset of the first byte.
+ */
+void WriteBehindFile::WriteBatch(const PooledBuffer &batch, uint64_t offset) {
+  // Batches never overlap, so the write itself needs no lock
+  bool success = true;
+  size_t done = 0;
+  while (done < batch.size()) {
+#ifdef _WIN32
+    OVERLAPPED overlapped;
+    std::memset(&overlapped, 0, sizeof(overlapped));
+    uint64_t position = offset + done;
+    overlapped.Offset = static_cast<DWORD>(position & 0xFFFFFFFFu);
+    overlapped.OffsetHigh = static_cast<DWORD>(position >> 32);
+    DWORD bytes_written = 0;
+    if (!WriteFile(file_handle_, batch.data() + done, static_cast<DWORD>(batch.size() - done), &bytes_written,
+                   &overlapped) ||
+        bytes_written == 0) {
+      CHAT_LOG_ERROR("Error writing file: " << GetLastError());
+      success = false;
+      break;
+    }
+#else
+    ssize_t bytes_written =
+        pwrite(file_fd_, batch.data() + done, batch.size() - done, static_cast<off_t>(offset + done));
+    if (bytes_written < 0 && errno == EINTR) {
+      continue;
+    }
+    if (bytes_written <= 0) {
+      CHAT_LOG_ERROR("Error writing file: " << strerror(errno));
+      success = false;
+      break;
+    }
+#endif
+    done += static_cast<size_t>(bytes_written);
+  }
+  CompleteBatch(batch.size(), success);
+}
+
+/**
+ * @brief Writes the rest of a batch through event_loop_, continuing after short writes.
+ *
+ * @param batch The bytes to write; kept alive until the write completed.
+ * @param offset File offset of the batch's first byte.
+ * @param done Bytes of the batch already written.
+ */
+void WriteBehindFile::WriteBatchOnLoop(const std::shared_ptr<PooledBuffer> &batch, uint64_t offset, size_t done) {
+  // The file stays open while the batch is pending, so the handle needs no lock
+#ifdef _WIN32
+  NativeFileHandle file = file_handle_;
+#else
+  NativeFileHandle file = file_fd_;
+#endif
+  std::shared_ptr<WriteBehindFile> self = shared_from_this();
+  event_loop_->WriteFile(file, batch->data() + done, batch->size() - done, offset + done,
+                         [self, batch, offset, done](int result) {
+                           if (result == -EINTR || result == -EAGAIN) {
+                             self->WriteBatchOnLoop(batch, offset, done);
+                           } else if (result <= 0) {
+                             CHAT_LOG_ERROR("Error writing file: " << strerror(result < 0 ? -result : EIO));
+                             self->CompleteBatch(batch->size(), false);
+                           } else if (done + static_cast<size_t>(result) < batch->size()) {
+                             self->WriteBatchOnLoop(batch, offset, done + static_cast<size_t>(result));
+                           } else {
+                             self->CompleteBatch(batch->size(), true);
+                           }
+                         });
+}
+
+/**
+ * @brief Accounts for a finished batch and reports progress and completion.
+ *
+ * @param size The batch's size.
+ * @param success Whether all of it was written.
+ */
+void WriteBehindFile::CompleteBatch(size_t size, bool success) {
+  CompletionCallback completion;
+  size_t written_bytes = 0;
+  bool all_succeeded = false;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    --pending_writes_;
+    if (success) {
+      written_bytes_ += size;
+    } else {
+      failed_ = true;
+    }
+    written_bytes = written_bytes_;
+    completion = TakeCompletionLocked();
+    all_succeeded = !failed_;
+  }
+
+  if (success && on_progress_) {
+    on_progress_(written_bytes);
+  }
+  if (completion) {
+    completion(all_succeeded);
+  }
+}
+
+/**
+ * @brief Closes the file and reports completion if Finish was called and
+ * nothing is pending. Caller holds mutex_.
+ *
+ * @return The completion callback to run, or nullptr.
+ */
+WriteBehindFile::CompletionCallback WriteBehindFile::TakeCompletionLocked() {
+  if (!finishing_ || pending_writes_ > 0) {
+    return nullptr;
+  }
+  CloseLocked();
+  CompletionCallback completion = std::move(on_complete_);
+  on_complete_ = nullptr;
+  return completion;
+}
+
+/**
+ * @brief Closes the native file handle. Caller holds mutex_.
+ */
+void WriteBehindFile::CloseLocked() {
+#ifdef _WIN32
+  if (file_handle_) {
+    CloseHandle(file_handle_);
+    file_handle_ = nullptr;
+  }
+#else
+  if (file_fd_ >= 0) {
+    close(file_fd_);
+    file_fd_ = -1;
+  }
+#endif
+}
@@ -0,0 +1,77 @@
+#include "ClusterDirectory.h"
+
+#include <iostream>
+#include <limits>
+
+namespace {
+
+int failures = 0;
+
+#define CHECK(condition)                                                                                               \
+  do {                                                                                                                 \
+    if (!(condition)) {                                                                                                \
+      std::cerr << __FILE__ << ":" << __LINE__ << ": check failed: " #condition << std::endl;                          \
+      ++failures;                                                                                                      \
+    }                                                                                                                  \
+  } while (0)
+
+/**
+ * @brief Nodes hand out interleaved IDs that they own.
+ */
+void TestIdsArePartitioned() {
+  ClusterDirectory single;
+  CHECK(single.AllocateClientId() == 1);
+  CHECK(single.AllocateClientId() == 2);
+
+  ClusterDirectory node(2, 3);
+  CHECK(node.AllocateClientId() == 5);
+  CHECK(node.AllocateClientId() == 8);
+  CHECK(node.IsLocal(8));
+  CHECK(!node.IsLocal(7));
+}
+
+/**
+ * @brief With a node count this large, the positive int range holds only a
+ * few IDs per node: allocation wraps back to the first one instead of
+ * overflowing, and every ID stays positive and owned by its node.
+ */
+void TestIdsWrapWithinPositiveRange() {
+  const int kNodeCount = 1000 * 1000 * 1000; // 1e9 and 2e9 fit below INT_MAX, 3e9 does not
+  ClusterDirectory first(0, kNodeCount);
+  CHECK(first.AllocateClientId() == kNodeCount);
+  CHECK(first.AllocateClientId() == 2 * kNodeCount);
+  CHECK(first.AllocateClientId() == kNodeCount);
+
+  ClusterDirectory last(kNodeCount - 1, kNodeCount);
+  for (int i = 0; i < 4; ++i) {
+    int id = last.AllocateClientId();
+    CHECK(id == 2 * kNodeCount - 1);
+    CHECK(last.GetOwner(id) == kNodeCount - 1);
+  }
+
+  // Only the node's own ID is left below INT_MAX
+  const int kMaxNodeCount = std::numeric_limits<int>::max();
+  ClusterDirectory widest(kMaxNodeCount - 1, kMaxNodeCount);
+  CHECK(widest.AllocateClientId() == kMaxNodeCount - 1);
+  CHECK(widest.IsLocal(kMaxNodeCount - 1));
+  ClusterDirectory widest_first(0, kMaxNodeCount);
+  CHECK(widest_first.AllocateClientId() == kMaxNodeCount);
+  CHECK(widest_first.AllocateClientId() == kMaxNodeCount);
+}
+
+} // namespace
+
+/**
+ * @brief Runs the ClusterDirectory tests.
+ * @return 0 if every check passed, 1 otherwise.
+ */
+int main() {
+  TestIdsArePartitioned();
+  TestIdsWrapWithinPositiveRange();
+  if (failures != 0) {
+    std::cerr << failures << " check(s) failed." << std::endl;
+    return 1;
+  }
+  std::cout << "All ClusterDirectory tests passed." << std::endl;
+  return 0;
+}
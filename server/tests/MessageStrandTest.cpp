@@ -0,0 +1,146 @@
+#include "MessageStrand.h"
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <iostream>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "WorkStealingExecutor.h"
+
+namespace {
+
+int failures = 0;
+
+#define CHECK(condition)                                                                                               \
+  do {                                                                                                                 \
+    if (!(condition)) {                                                                                                \
+      std::cerr << __FILE__ << ":" << __LINE__ << ": check failed: " #condition << std::endl;                          \
+      ++failures;                                                                                                      \
+    }                                                                                                                  \
+  } while (0)
+
+const size_t kBound = 1000;
+const size_t kTaskBytes = 100;
+
+/**
+ * @brief A gate the first task waits at, so the strand falls behind on demand.
+ */
+class Gate {
+public:
+  /**
+   * @brief Blocks until Open is called.
+   */
+  void Wait() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    cv_.wait(lock, [this] { return open_; });
+  }
+
+  /**
+   * @brief Releases every waiter.
+   */
+  void Open() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    open_ = true;
+    cv_.notify_all();
+  }
+
+private:
+  std::mutex mutex_;
+  std::condition_variable cv_;
+  bool open_ = false;
+};
+
+/**
+ * @brief Posting past the bound reports FULL at once instead of blocking the
+ * poster, and the space callback fires once the strand drained.
+ */
+void TestFullStrandDoesNotBlockPoster() {
+  WorkStealingExecutor executor(1);
+  MessageStrand strand(&executor, kBound);
+  std::atomic<int> space_callbacks(0);
+  strand.SetSpaceCallback([&space_callbacks] { ++space_callbacks; });
+
+  Gate gate;
+  std::vector<int> order;
+  std::mutex order_mutex;
+  auto record = [&order, &order_mutex](int i) {
+    std::lock_guard<std::mutex> lock(order_mutex);
+    order.push_back(i);
+  };
+
+  // Twice the bound while the worker is stuck: every Post must return at once
+  const int kTasks = static_cast<int>(2 * kBound / kTaskBytes);
+  int full_results = 0;
+  auto start = std::chrono::steady_clock::now();
+  for (int i = 0; i < kTasks; ++i) {
+    MessageStrand::PostResult result = strand.Post(
+        [&gate, &record, i] {
+          if (i == 0) {
+            gate.Wait();
+          }
+          record(i);
+        },
+        kTaskBytes);
+    CHECK(result != MessageStrand::PostResult::CLOSED);
+    full_results += result == MessageStrand::PostResult::FULL ? 1 : 0;
+  }
+  CHECK(std::chrono::steady_clock::now() - start < std::chrono::seconds(1));
+  CHECK(full_results > 0);
+  CHECK(strand.IsFull());
+  CHECK(space_callbacks.load() == 0);
+  CHECK(strand.Post([] {}, 0) == MessageStrand::PostResult::FULL); // Bookkeeping still queues
+
+  gate.Open();
+  strand.WaitForSpace();
+  CHECK(!strand.IsFull());
+  for (int i = 0; i < 100 && !strand.IsIdle(); ++i) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+  }
+  CHECK(strand.IsIdle());
+  CHECK(space_callbacks.load() == 1);
+
+  std::lock_guard<std::mutex> lock(order_mutex);
+  CHECK(order.size() == static_cast<size_t>(kTasks));
+  for (size_t i = 0; i < order.size(); ++i) {
+    CHECK(order[i] == static_cast<int>(i));
+  }
+}
+
+/**
+ * @brief Close releases a poster waiting for space and refuses later tasks.
+ */
+void TestCloseReleasesWaiter() {
+  WorkStealingExecutor executor(1);
+  MessageStrand strand(&executor, kBound);
+  Gate gate;
+  strand.Post([&gate] { gate.Wait(); }, kBound);
+  CHECK(strand.IsFull());
+
+  std::thread waiter([&strand] { strand.WaitForSpace(); });
+  std::thread closer([&strand] { strand.Close(); });
+  std::this_thread::sleep_for(std::chrono::milliseconds(50));
+  gate.Open(); // Close waits for the running task
+  waiter.join();
+  closer.join();
+  CHECK(strand.Post([] {}, 1) == MessageStrand::PostResult::CLOSED);
+}
+
+} // namespace
+
+/**
+ * @brief Runs the MessageStrand tests.
+ * @return 0 if every check passed, 1 otherwise.
+ */
+int main() {
+  TestFullStrandDoesNotBlockPoster();
+  TestCloseReleasesWaiter();
+  if (failures != 0) {
+    std::cerr << failures << " check(s) failed." << std::endl;
+    return 1;
+  }
+  std::cout << "All MessageStrand tests passed." << std::endl;
+  return 0;
+}
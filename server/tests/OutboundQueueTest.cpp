@@ -0,0 +1,139 @@
+#include "OutboundQueue.h"
+
+#include <algorithm> // For std::min
+#include <cstdint>
+#include <iostream>
+#include <vector>
+
+#include "Message.h"
+#include "MessageSerialization.h"
+
+namespace {
+
+int failures = 0;
+
+#define CHECK(condition)                                                                                               \
+  do {                                                                                                                 \
+    if (!(condition)) {                                                                                                \
+      std::cerr << __FILE__ << ":" << __LINE__ << ": check failed: " #condition << std::endl;                          \
+      ++failures;                                                                                                      \
+    }                                                                                                                  \
+  } while (0)
+
+const int kSenderId = 1;
+const int kRecipientId = 2;
+const uint32_t kTransferId = 7;
+const size_t kChunkCount = 64;
+const size_t kChunkSize = 1024;
+
+/**
+ * @brief Builds a frame in the compact format.
+ *
+ * @param type The message type.
+ * @param payload_size Payload bytes, all set to fill.
+ * @param fill The payload byte.
+ * @return The serialized frame.
+ */
+SharedFrame MakeFrame(MessageType type, size_t payload_size, char fill) {
+  Message message;
+  uint32_t transfer_id = (type == MessageType::BROADCAST_MESSAGE) ? 0 : kTransferId;
+  message.header = {type, kSenderId, kRecipientId, payload_size, 0, transfer_id, 0};
+  message.payload.assign(payload_size, fill);
+  return SerializeMessageShared(message, kProtocolVersionCompact);
+}
+
+/**
+ * @brief Drains a queue the way a slow writer would, a few hundred bytes per write.
+ *
+ * @param queue The queue.
+ * @return The bytes that went out, in order.
+ */
+std::vector<char> Drain(OutboundQueue &queue) {
+  std::vector<char> wire;
+  std::vector<IoBuffer> buffers;
+  while (queue.Gather(buffers) > 0) {
+    size_t budget = 300;
+    size_t written = 0;
+    for (const IoBuffer &buffer : buffers) {
+      size_t take = std::min(budget - written, buffer.size);
+      const char *data = static_cast<const char *>(buffer.data);
+      wire.insert(wire.end(), data, data + take);
+      written += take;
+      if (written == budget) {
+        break;
+      }
+    }
+    queue.Consume(written);
+  }
+  return wire;
+}
+
+/**
+ * @brief Overflows a DROP_OLDEST queue carrying a file transfer and chat.
+ *
+ * Chat frames may be dropped; every chunk and the completion must arrive, in
+ * order and unchanged, or the relayed file would be silently corrupted.
+ */
+void TestOverflowKeepsFileTransfer() {
+  OutboundQueueOptions options;
+  options.max_queued_bytes = 4 * 1024;
+  options.overflow_policy = OverflowPolicy::DROP_OLDEST;
+  OutboundQueue queue(options);
+
+  for (size_t i = 0; i < kChunkCount; ++i) {
+    CHECK(queue.Push(MakeFrame(MessageType::FILE_DATA_CHUNK, kChunkSize, static_cast<char>(i))) !=
+          OutboundQueue::PushResult::LIMIT_EXCEEDED);
+    queue.Push(MakeFrame(MessageType::BROADCAST_MESSAGE, 200, 'c'));
+  }
+  queue.Push(MakeFrame(MessageType::FILE_TRANSFER_COMPLETE, 0, 0));
+  CHECK(queue.GetDroppedFrameCount() > 0); // The limit was hit, chat made room
+
+  std::vector<char> wire = Drain(queue);
+  size_t offset = 0;
+  size_t chunks = 0;
+  bool complete = false;
+  while (offset < wire.size()) {
+    MessageHeader header;
+    size_t header_size = 0;
+    int protocol_version = 0;
+    if (DecodeMessageHeader(wire.data() + offset, wire.size() - offset, header, header_size, protocol_version) !=
+        HeaderDecodeStatus::OK) {
+      CHECK(!"undecodable frame on the wire");
+      return;
+    }
+    const char *payload = wire.data() + offset + header_size;
+    if (header.type == MessageType::FILE_DATA_CHUNK) {
+      CHECK(!complete);
+      CHECK(header.transfer_id == kTransferId);
+      CHECK(header.payload_size == kChunkSize);
+      bool intact = true;
+      for (size_t i = 0; i < header.payload_size; ++i) {
+        intact = intact && payload[i] == static_cast<char>(chunks);
+      }
+      CHECK(intact); // Chunk number `chunks`, nothing skipped or reordered
+      ++chunks;
+    } else if (header.type == MessageType::FILE_TRANSFER_COMPLETE) {
+      complete = true;
+    }
+    offset += header_size + header.payload_size;
+  }
+  CHECK(offset == wire.size());
+  CHECK(chunks == kChunkCount);
+  CHECK(complete);
+}
+
+} // namespace
+
+/**
+ * @brief Runs the OutboundQueue tests.
+ * @return 0 if every check passed, 1 otherwise.
+ */
+int main() {
+  TestOverflowKeepsFileTransfer();
+  if (failures != 0) {
+    std::cerr << failures << " check(s) failed." << std::endl;
+    return 1;
+  }
+  std::cout << "All OutboundQueue tests passed." << std::endl;
+  return 0;
+}